@@ -76,6 +76,7 @@ class Average {
     }
 };
 
+} // namespace
 
 #define PACKETSTAGE(x) case Trace::x: return #x
 const char* getPacketStageName (uint32 path) {
@@ -122,6 +123,8 @@ const char* getPacketStageName (uint32 path) {
     }
 }
 
+namespace {
+
 class PathPair {
   public:
     Trace::MessagePath first;
@@ -48,6 +48,9 @@ class MessageLatencyFilters {
     const ObjectMessagePort* mDestPort;
 };
 
+/** Get a human readable name for a Trace::MessagePath. */
+const char* getPacketStageName(uint32 path);
+
 void MessageLatencyAnalysis(const char* opt_name, const uint32 nservers, MessageLatencyFilters f, const String& stage_dump_file = "stage_samples.txt");
 
 } // namespace Sirikata
@@ -70,6 +70,13 @@ void InitAnalysisOptions() {
         .addOption(new OptionValue(ANALYSIS_PROX_DUMP, "", Sirikata::OptionValueType<String>(), "Run proximity dump analysis -- just dumps a textual form of all proximity events to the specified file"))
 
         .addOption(new OptionValue(ANALYSIS_FLOW_STATS, "false", Sirikata::OptionValueType<bool>(), "Get summary object pair flow statistics"))
+
+        .addOption(new OptionValue(ANALYSIS_STREAMING, "", Sirikata::OptionValueType<String>(), "Stream the traces through the comma separated list of analyses (bandwidth, latency, oseg) in parallel, using bounded memory"))
+        .addOption(new OptionValue(ANALYSIS_STREAMING_REORDER_WINDOW, "500ms", Sirikata::OptionValueType<Duration>(), "How far out of order events within a single trace file may be in streaming analysis"))
+        .addOption(new OptionValue(ANALYSIS_STREAMING_LATENCY_WINDOW, "10s", Sirikata::OptionValueType<Duration>(), "How long a message may go without new timestamps before streaming latency analysis gives up on it"))
+        .addOption(new OptionValue(ANALYSIS_STREAMING_BATCH_SIZE, "4096", Sirikata::OptionValueType<uint32>(), "Number of events handed to analysis threads at a time in streaming analysis"))
+        .addOption(new OptionValue(ANALYSIS_STREAMING_MAX_QUEUED_BATCHES, "16", Sirikata::OptionValueType<uint32>(), "Maximum number of batches waiting for each analysis thread in streaming analysis"))
+        .addOption(new OptionValue(ANALYSIS_STREAMING_BENCHMARK, "0", Sirikata::OptionValueType<uint32>(), "If non-zero, write synthetic traces with this many events per server and time streaming analysis over them"))
       ;
 }
 
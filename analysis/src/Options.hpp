@@ -49,6 +49,12 @@
 #define ANALYSIS_LOC_LATENCY "analysis.loc.latency"
 #define ANALYSIS_PROX_DUMP "analysis.prox.dump"
 #define ANALYSIS_FLOW_STATS "analysis.flow.stats"
+#define ANALYSIS_STREAMING "analysis.streaming"
+#define ANALYSIS_STREAMING_REORDER_WINDOW "analysis.streaming.reorder-window"
+#define ANALYSIS_STREAMING_LATENCY_WINDOW "analysis.streaming.latency-window"
+#define ANALYSIS_STREAMING_BATCH_SIZE "analysis.streaming.batch-size"
+#define ANALYSIS_STREAMING_MAX_QUEUED_BATCHES "analysis.streaming.max-queued-batches"
+#define ANALYSIS_STREAMING_BENCHMARK "analysis.streaming.benchmark"
 
 #define ANALYSIS_TOTAL_NUM_ALL_SERVERS "analysis.total.num.all.servers"
 
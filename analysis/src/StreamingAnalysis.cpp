@@ -0,0 +1,687 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "StreamingAnalysis.hpp"
+#include "AnalysisEvents.hpp"
+#include "MessageLatency.hpp"
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/core/network/Message.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/thread.hpp>
+#include <fstream>
+#include <queue>
+#include <list>
+
+namespace Sirikata {
+
+namespace {
+
+struct StreamEvent {
+    StreamEvent(Event* e, const ServerID& s, uint64 sq)
+     : evt(e), server(s), seq(sq)
+    {}
+
+    Event* evt;
+    ServerID server;
+    // Order the event was read in, so events with equal timestamps keep their
+    // order from the trace file
+    uint64 seq;
+};
+
+// Orders the latest event first, giving a min-heap when used with
+// std::priority_queue.
+struct StreamEventLater {
+    bool operator()(const StreamEvent& lhs, const StreamEvent& rhs) const {
+        if (lhs.evt->time == rhs.evt->time)
+            return lhs.seq > rhs.seq;
+        return rhs.evt->time < lhs.evt->time;
+    }
+};
+
+/** Reads a single server's trace file incrementally. Traces are written by
+ *  multiple threads, so they're only approximately sorted. Events are held in
+ *  a heap until an event at least reorder_window newer has been read, at
+ *  which point nothing later in the file should precede them.
+ */
+class TraceFileReader {
+public:
+    TraceFileReader(const String& filename, const ServerID& server, const Duration& reorder_window, AtomicValue<uint64>* buffered)
+     : mStream(filename.c_str(), std::ios::in | std::ios::binary),
+       mServer(server),
+       mReorderWindow(reorder_window),
+       mNewest(Time::null()),
+       mSeq(0),
+       mBuffered(buffered)
+    {
+        fill();
+    }
+
+    ~TraceFileReader() {
+        while(!mPending.empty()) {
+            delete mPending.top().evt;
+            mPending.pop();
+        }
+    }
+
+    bool empty() const { return mPending.empty(); }
+    const StreamEvent& head() const { return mPending.top(); }
+
+    StreamEvent pop() {
+        StreamEvent result = mPending.top();
+        mPending.pop();
+        fill();
+        return result;
+    }
+
+private:
+    void fill() {
+        while(mStream && (mPending.empty() || (mNewest - mPending.top().evt->time) < mReorderWindow)) {
+            uint16 type_hint;
+            if (!read_record(mStream, &type_hint, &mRecord)) break;
+            Event* evt = Event::parse(type_hint, mRecord, mServer);
+            if (evt == NULL) continue;
+
+            if (evt->time > mNewest) mNewest = evt->time;
+            mPending.push(StreamEvent(evt, mServer, mSeq++));
+            (*mBuffered)++;
+        }
+    }
+
+    typedef std::priority_queue<StreamEvent, std::vector<StreamEvent>, StreamEventLater> EventHeap;
+
+    std::ifstream mStream;
+    ServerID mServer;
+    Duration mReorderWindow;
+    Time mNewest;
+    uint64 mSeq;
+    std::string mRecord;
+    EventHeap mPending;
+    AtomicValue<uint64>* mBuffered;
+};
+
+// Orders readers by their next event, latest first, for the k-way merge
+struct ReaderLater {
+    bool operator()(const TraceFileReader* lhs, const TraceFileReader* rhs) const {
+        return StreamEventLater()(lhs->head(), rhs->head());
+    }
+};
+
+typedef std::vector<StreamEvent> EventBatch;
+typedef std::tr1::shared_ptr<EventBatch> EventBatchPtr;
+
+// Batches are shared by all the analysis threads and the events are freed by
+// whichever thread finishes with the batch last.
+void destroyBatch(EventBatch* batch, AtomicValue<uint64>* buffered) {
+    for(EventBatch::iterator it = batch->begin(); it != batch->end(); it++)
+        delete it->evt;
+    (*buffered) -= (uint64)batch->size();
+    delete batch;
+}
+
+/** Bounded queue of batches feeding a single analysis thread. An empty batch
+ *  pointer marks the end of the stream.
+ */
+class BatchQueue {
+public:
+    BatchQueue(uint32 capacity)
+     : mCapacity(std::max(capacity, (uint32)1))
+    {}
+
+    void push(EventBatchPtr batch) {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        while(mBatches.size() >= mCapacity)
+            mNotFull.wait(lock);
+        mBatches.push_back(batch);
+        mNotEmpty.notify_one();
+    }
+
+    EventBatchPtr pop() {
+        boost::unique_lock<boost::mutex> lock(mMutex);
+        while(mBatches.empty())
+            mNotEmpty.wait(lock);
+        EventBatchPtr result = mBatches.front();
+        mBatches.pop_front();
+        mNotFull.notify_one();
+        return result;
+    }
+
+private:
+    const uint32 mCapacity;
+    boost::mutex mMutex;
+    boost::condition_variable mNotEmpty;
+    boost::condition_variable mNotFull;
+    std::deque<EventBatchPtr> mBatches;
+};
+
+void analysisThread(StreamingAnalysis* analysis, BatchQueue* queue) {
+    while(true) {
+        EventBatchPtr batch = queue->pop();
+        if (!batch) break;
+        for(EventBatch::const_iterator it = batch->begin(); it != batch->end(); it++)
+            analysis->process(it->evt, it->server);
+    }
+}
+
+
+class SampleStats {
+public:
+    SampleStats()
+     : mSum(0), mSum2(0), mCount(0)
+    {}
+
+    void sample(double v) {
+        mSum += v;
+        mSum2 += v*v;
+        mCount++;
+    }
+
+    uint64 count() const { return mCount; }
+    double average() const { return mCount ? mSum / mCount : 0; }
+    double stddev() const {
+        if (mCount == 0) return 0;
+        double avg = average();
+        double var = mSum2 / mCount - avg*avg;
+        return var > 0 ? sqrt(var) : 0;
+    }
+
+private:
+    double mSum;
+    double mSum2;
+    uint64 mCount;
+};
+
+
+/** Per server pair send and receive totals and peak rates, computed the same
+ *  way as BandwidthAnalysis::computeSendRate but without keeping any events.
+ */
+class StreamingBandwidthAnalysis : public StreamingAnalysis {
+public:
+    virtual const char* name() const { return "bandwidth"; }
+
+    virtual void process(const Event* evt, const ServerID& trace_server) {
+        const DatagramSentEvent* sent = dynamic_cast<const DatagramSentEvent*>(evt);
+        if (sent != NULL) {
+            mSendRates[ServerPair(sent->data.source_server(), sent->data.dest_server())].sample(evt->time, sent->data.size());
+            return;
+        }
+        const DatagramReceivedEvent* received = dynamic_cast<const DatagramReceivedEvent*>(evt);
+        if (received != NULL)
+            mReceiveRates[ServerPair(received->data.source_server(), received->data.dest_server())].sample(evt->time, received->data.size());
+    }
+
+    virtual void finish(std::ostream& out) {
+        out << "Send rates" << std::endl;
+        report(mSendRates, out);
+        out << "Receive rates" << std::endl;
+        report(mReceiveRates, out);
+    }
+
+private:
+    struct RateState {
+        RateState()
+         : total_bytes(0),
+           last_bytes(0),
+           last_time(Time::null()),
+           max_bandwidth(0)
+        {}
+
+        void sample(const Time& t, uint32 size) {
+            total_bytes += size;
+            if (t != last_time) {
+                if (last_bytes > 0 && last_duration.toSeconds() > 0) {
+                    double bandwidth = (double)last_bytes / last_duration.toSeconds();
+                    if (bandwidth > max_bandwidth)
+                        max_bandwidth = bandwidth;
+                }
+                last_bytes = 0;
+                last_duration = t - last_time;
+                last_time = t;
+            }
+            last_bytes += size;
+        }
+
+        uint64 total_bytes;
+        uint32 last_bytes;
+        Duration last_duration;
+        Time last_time;
+        double max_bandwidth;
+    };
+    typedef std::pair<ServerID, ServerID> ServerPair;
+    typedef std::map<ServerPair, RateState> RateMap;
+
+    void report(const RateMap& rates, std::ostream& out) {
+        for(RateMap::const_iterator it = rates.begin(); it != rates.end(); it++)
+            out << it->first.first << " to " << it->first.second << ": " << it->second.total_bytes << " total, " << it->second.max_bandwidth << " max" << std::endl;
+    }
+
+    RateMap mSendRates;
+    RateMap mReceiveRates;
+};
+
+
+/** Message stage latencies. Only packets which are still in flight are
+ *  tracked: a packet is finished when it reaches a terminal stage or when no
+ *  stamps have been seen for it for latency_window. Unlike
+ *  MessageLatencyAnalysis this doesn't match stamps against the stage graph,
+ *  which needs a packet's complete history, but reports the time between
+ *  consecutive stamps of each packet.
+ */
+class StreamingMessageLatencyAnalysis : public StreamingAnalysis {
+public:
+    StreamingMessageLatencyAnalysis(const Duration& window)
+     : mWindow(window),
+       mPeakInFlight(0),
+       mCompleted(0),
+       mExpired(0)
+    {}
+
+    virtual const char* name() const { return "latency"; }
+
+    virtual void process(const Event* evt, const ServerID& trace_server) {
+        const MessageTimestampEvent* tevt = dynamic_cast<const MessageTimestampEvent*>(evt);
+        if (tevt == NULL) return;
+
+        expire(tevt->time);
+
+        PacketIndex::iterator idx_it = mIndex.find(tevt->uid);
+        PacketList::iterator pkt_it;
+        if (idx_it == mIndex.end()) {
+            pkt_it = mInFlight.insert(mInFlight.end(), InFlightPacket(tevt->uid));
+            mIndex[tevt->uid] = pkt_it;
+            if (mIndex.size() > mPeakInFlight) mPeakInFlight = mIndex.size();
+        }
+        else {
+            // Keep the list ordered by last activity so expiry only has to
+            // look at the front
+            pkt_it = idx_it->second;
+            mInFlight.splice(mInFlight.end(), mInFlight, pkt_it);
+        }
+
+        pkt_it->last_seen = tevt->time;
+        pkt_it->stamps.push_back(PacketStamp(tevt->time, tevt->path));
+
+        if (isTerminal(tevt->path)) {
+            mCompleted++;
+            complete(pkt_it);
+        }
+    }
+
+    virtual void finish(std::ostream& out) {
+        mExpired += mInFlight.size();
+        while(!mInFlight.empty())
+            complete(mInFlight.begin());
+
+        for(StageMap::const_iterator it = mStages.begin(); it != mStages.end(); it++) {
+            out << "Stage " << getPacketStageName(it->first.first) << " - " << getPacketStageName(it->first.second) << ":"
+                << it->second.average() << "us stddev " << it->second.stddev() << "us #" << it->second.count() << std::endl;
+        }
+        out << "End to end: " << mEndToEnd.average() << "us stddev " << mEndToEnd.stddev() << "us #" << mEndToEnd.count() << std::endl;
+        out << "Packets completed " << mCompleted << ", expired " << mExpired << ", peak in flight " << mPeakInFlight << std::endl;
+    }
+
+private:
+    struct PacketStamp {
+        PacketStamp(const Time& t, Trace::MessagePath p)
+         : time(t), path(p)
+        {}
+        Time time;
+        Trace::MessagePath path;
+    };
+    struct InFlightPacket {
+        InFlightPacket(uint64 id)
+         : uid(id), last_seen(Time::null())
+        {}
+        uint64 uid;
+        Time last_seen;
+        std::vector<PacketStamp> stamps;
+    };
+    typedef std::list<InFlightPacket> PacketList;
+    typedef std::tr1::unordered_map<uint64, PacketList::iterator> PacketIndex;
+    typedef std::pair<Trace::MessagePath, Trace::MessagePath> StagePair;
+    typedef std::map<StagePair, SampleStats> StageMap;
+
+    static bool isTerminal(Trace::MessagePath path) {
+        switch(path) {
+          case Trace::DESTROYED:
+          case Trace::OH_DROPPED_AT_SEND:
+          case Trace::OH_DROPPED_AT_RECEIVE_QUEUE:
+          case Trace::SPACE_DROPPED_AT_MAIN_STRAND_CROSSING:
+          case Trace::DROPPED_AT_FORWARDED_LOCALLY:
+          case Trace::DROPPED_DURING_FORWARDING:
+          case Trace::DROPPED_AT_SPACE_ENQUEUED:
+            return true;
+          default:
+            return false;
+        }
+    }
+
+    void expire(const Time& now) {
+        while(!mInFlight.empty() && (now - mInFlight.front().last_seen) > mWindow) {
+            mExpired++;
+            complete(mInFlight.begin());
+        }
+    }
+
+    void complete(PacketList::iterator pkt_it) {
+        // Stamps arrive in time order, so consecutive stamps are consecutive
+        // stages
+        const std::vector<PacketStamp>& stamps = pkt_it->stamps;
+        for(uint32 i = 1; i < stamps.size(); i++) {
+            mStages[StagePair(stamps[i-1].path, stamps[i].path)].sample(
+                (stamps[i].time - stamps[i-1].time).toMicroseconds()
+            );
+        }
+        if (stamps.size() > 1 && stamps.front().path == Trace::CREATED && stamps.back().path == Trace::DESTROYED)
+            mEndToEnd.sample( (stamps.back().time - stamps.front().time).toMicroseconds() );
+
+        mIndex.erase(pkt_it->uid);
+        mInFlight.erase(pkt_it);
+    }
+
+    Duration mWindow;
+    PacketList mInFlight;
+    PacketIndex mIndex;
+    StageMap mStages;
+    SampleStats mEndToEnd;
+    std::size_t mPeakInFlight;
+    uint64 mCompleted;
+    uint64 mExpired;
+};
+
+
+/** Summary OSeg statistics: request counts, processing and round trip times,
+ *  and the totals servers report at shutdown.
+ */
+class StreamingOSegAnalysis : public StreamingAnalysis {
+public:
+    StreamingOSegAnalysis()
+     : mCraqRequests(0),
+       mCacheResponses(0),
+       mInvalidLookups(0),
+       mMigrationsBegun(0),
+       mMigrationsAcked(0),
+       mShutdownLookups(0),
+       mShutdownLocalLookups(0),
+       mShutdownCacheHits(0),
+       mShutdownCraqLookups(0)
+    {}
+
+    virtual const char* name() const { return "oseg"; }
+
+    virtual void process(const Event* evt, const ServerID& trace_server) {
+        if (dynamic_cast<const OSegCraqRequestEvent*>(evt) != NULL) {
+            mCraqRequests++;
+        }
+        else if (const OSegProcessedRequestEvent* pevt = dynamic_cast<const OSegProcessedRequestEvent*>(evt)) {
+            mProcessTime.sample(pevt->data.dtime());
+            mProcessQueued.sample(pevt->data.queued());
+        }
+        else if (const OSegTrackedSetResultsEvent* tevt = dynamic_cast<const OSegTrackedSetResultsEvent*>(evt)) {
+            mRoundTrip.sample(tevt->data.roundtrip().toMicroseconds());
+        }
+        else if (dynamic_cast<const OSegCacheResponseEvent*>(evt) != NULL) {
+            mCacheResponses++;
+        }
+        else if (dynamic_cast<const OSegInvalidLookupEvent*>(evt) != NULL) {
+            mInvalidLookups++;
+        }
+        else if (dynamic_cast<const MigrationBeginEvent*>(evt) != NULL) {
+            mMigrationsBegun++;
+        }
+        else if (dynamic_cast<const MigrationAckEvent*>(evt) != NULL) {
+            mMigrationsAcked++;
+        }
+        else if (const OSegShutdownEvent* sevt = dynamic_cast<const OSegShutdownEvent*>(evt)) {
+            mShutdownLookups += sevt->data.lookups();
+            mShutdownLocalLookups += sevt->data.local_lookups();
+            mShutdownCacheHits += sevt->data.cache_hits();
+            mShutdownCraqLookups += sevt->data.craq_lookups();
+        }
+    }
+
+    virtual void finish(std::ostream& out) {
+        out << "OSeg craq requests: " << mCraqRequests << std::endl;
+        out << "OSeg processed requests: " << mProcessTime.count()
+            << ", avg time " << mProcessTime.average() << " avg queued " << mProcessQueued.average() << std::endl;
+        out << "OSeg tracked set round trip: " << mRoundTrip.average() << "us stddev " << mRoundTrip.stddev() << "us #" << mRoundTrip.count() << std::endl;
+        out << "OSeg cache responses: " << mCacheResponses << ", invalid lookups: " << mInvalidLookups << std::endl;
+        out << "Migrations begun: " << mMigrationsBegun << ", acked: " << mMigrationsAcked << std::endl;
+        out << "Shutdown totals: lookups " << mShutdownLookups << " local " << mShutdownLocalLookups
+            << " cache hits " << mShutdownCacheHits << " craq " << mShutdownCraqLookups << std::endl;
+    }
+
+private:
+    uint64 mCraqRequests;
+    SampleStats mProcessTime;
+    SampleStats mProcessQueued;
+    SampleStats mRoundTrip;
+    uint64 mCacheResponses;
+    uint64 mInvalidLookups;
+    uint64 mMigrationsBegun;
+    uint64 mMigrationsAcked;
+    uint64 mShutdownLookups;
+    uint64 mShutdownLocalLookups;
+    uint64 mShutdownCacheHits;
+    uint64 mShutdownCraqLookups;
+};
+
+
+void writeRawRecord(std::ostream& os, uint16 type_hint, const std::string& payload) {
+    uint32 size = payload.size();
+    os.write((const char*)&size, sizeof(size));
+    os.write((const char*)&type_hint, sizeof(type_hint));
+    os.write(payload.data(), size);
+}
+
+void writeTimestamp(std::ostream& os, const Time& t, uint64 uid, Trace::MessagePath path) {
+    std::string payload;
+    payload.append((const char*)&t, sizeof(t));
+    payload.append((const char*)&uid, sizeof(uid));
+    payload.append((const char*)&path, sizeof(path));
+    writeRawRecord(os, MessageTimestampTag, payload);
+}
+
+} // namespace
+
+
+std::vector<StreamingAnalysis*> CreateStreamingAnalyses(const String& names, const Duration& latency_window) {
+    std::vector<StreamingAnalysis*> result;
+
+    std::size_t pos = 0;
+    while(pos <= names.size()) {
+        std::size_t end = names.find(',', pos);
+        if (end == String::npos) end = names.size();
+        String name = names.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (name.empty())
+            continue;
+        else if (name == "bandwidth")
+            result.push_back(new StreamingBandwidthAnalysis());
+        else if (name == "latency")
+            result.push_back(new StreamingMessageLatencyAnalysis(latency_window));
+        else if (name == "oseg")
+            result.push_back(new StreamingOSegAnalysis());
+        else
+            SILOG(analysis,error,"Unknown streaming analysis: " << name);
+    }
+
+    return result;
+}
+
+StreamingAnalysisStats StreamingAnalysisRun(
+    const std::vector<String>& trace_files, const std::vector<ServerID>& servers,
+    std::vector<StreamingAnalysis*>& analyses, std::ostream& out,
+    const Duration& reorder_window, uint32 batch_size, uint32 max_queued_batches)
+{
+    assert(trace_files.size() == servers.size());
+
+    StreamingAnalysisStats stats;
+    AtomicValue<uint64> buffered(0);
+    batch_size = std::max(batch_size, (uint32)1);
+
+    // One thread per analysis, each with its own queue so a slow analysis
+    // only holds up the reader once its queue fills
+    std::vector<BatchQueue*> queues;
+    boost::thread_group threads;
+    for(uint32 i = 0; i < analyses.size(); i++) {
+        queues.push_back(new BatchQueue(max_queued_batches));
+        threads.create_thread(std::tr1::bind(&analysisThread, analyses[i], queues[i]));
+    }
+
+    std::vector<TraceFileReader*> readers;
+    std::priority_queue<TraceFileReader*, std::vector<TraceFileReader*>, ReaderLater> heads;
+    for(uint32 i = 0; i < trace_files.size(); i++) {
+        TraceFileReader* reader = new TraceFileReader(trace_files[i], servers[i], reorder_window, &buffered);
+        readers.push_back(reader);
+        if (!reader->empty())
+            heads.push(reader);
+    }
+
+    using std::tr1::placeholders::_1;
+    EventBatchPtr batch(new EventBatch(), std::tr1::bind(&destroyBatch, _1, &buffered));
+    batch->reserve(batch_size);
+    while(true) {
+        if (heads.empty() || batch->size() >= batch_size) {
+            if (!batch->empty()) {
+                for(uint32 i = 0; i < queues.size(); i++)
+                    queues[i]->push(batch);
+                stats.batches++;
+            }
+            if (heads.empty()) break;
+            batch = EventBatchPtr(new EventBatch(), std::tr1::bind(&destroyBatch, _1, &buffered));
+            batch->reserve(batch_size);
+        }
+
+        TraceFileReader* reader = heads.top();
+        heads.pop();
+        batch->push_back(reader->pop());
+        stats.events++;
+        if (!reader->empty())
+            heads.push(reader);
+
+        uint64 cur_buffered = buffered.read();
+        if (cur_buffered > stats.max_buffered_events)
+            stats.max_buffered_events = cur_buffered;
+    }
+    batch.reset();
+
+    for(uint32 i = 0; i < queues.size(); i++)
+        queues[i]->push(EventBatchPtr());
+    threads.join_all();
+
+    for(uint32 i = 0; i < analyses.size(); i++)
+        analyses[i]->finish(out);
+
+    for(uint32 i = 0; i < readers.size(); i++)
+        delete readers[i];
+    for(uint32 i = 0; i < queues.size(); i++)
+        delete queues[i];
+
+    return stats;
+}
+
+StreamingAnalysisStats StreamingAnalysisRun(
+    const char* opt_name, const uint32 nservers,
+    std::vector<StreamingAnalysis*>& analyses, std::ostream& out,
+    const Duration& reorder_window, uint32 batch_size, uint32 max_queued_batches)
+{
+    std::vector<String> trace_files;
+    std::vector<ServerID> servers;
+    for(uint32 server_id = 1; server_id <= nservers; server_id++) {
+        trace_files.push_back(GetPerServerFile(opt_name, server_id));
+        servers.push_back(server_id);
+    }
+    return StreamingAnalysisRun(trace_files, servers, analyses, out, reorder_window, batch_size, max_queued_batches);
+}
+
+void StreamingAnalysisBenchmark(
+    const String& trace_file, const uint32 nservers, const uint32 events_per_server,
+    const String& analysis_names, const Duration& reorder_window, uint32 batch_size, uint32 max_queued_batches)
+{
+    if (nservers == 0) {
+        SILOG(analysis,error,"Streaming analysis benchmark needs at least one server");
+        return;
+    }
+
+    std::vector<String> trace_files;
+    std::vector<ServerID> servers;
+    std::vector<std::ofstream*> streams;
+    for(uint32 server_id = 1; server_id <= nservers; server_id++) {
+        trace_files.push_back(GetPerServerString(trace_file, server_id));
+        servers.push_back(server_id);
+        streams.push_back(new std::ofstream(trace_files.back().c_str(), std::ios::out | std::ios::binary));
+    }
+
+    // Each packet is created on one server and delivered on another, writing
+    // 4 timestamps and a datagram event on each side. Stamps for the receiver
+    // are written ahead of the sender's later events, so files are only
+    // approximately sorted, like real multi-threaded traces.
+    const uint32 events_per_packet = 5;
+    uint64 npackets = ((uint64)events_per_server * nservers) / (2 * events_per_packet);
+    Time t = Time::null() + Duration::seconds(1.f);
+    Duration tick = Duration::microseconds(100);
+    for(uint64 uid = 1; uid <= npackets; uid++) {
+        uint32 src = (uint32)(uid % nservers);
+        uint32 dst = (uint32)((uid * 7 + 3) % nservers);
+        std::ostream& src_os = *streams[src];
+        std::ostream& dst_os = *streams[dst];
+        Time sent = t + Duration::microseconds(40);
+        Time received = sent + Duration::microseconds(300 + (int64)(uid % 500));
+
+        writeTimestamp(src_os, t, uid, Trace::CREATED);
+        writeTimestamp(src_os, t + Duration::microseconds(10), uid, Trace::HANDLE_OBJECT_HOST_MESSAGE);
+        writeTimestamp(src_os, t + Duration::microseconds(25), uid, Trace::SPACE_TO_SPACE_ENQUEUED);
+        writeTimestamp(src_os, sent, uid, Trace::SPACE_TO_SPACE_HIT_NETWORK);
+
+        Trace::Datagram::Sent sent_rec;
+        sent_rec.set_t(sent);
+        sent_rec.set_dest_server(dst + 1);
+        sent_rec.set_uid(uid);
+        sent_rec.set_size(256);
+        sent_rec.set_start_time(sent);
+        sent_rec.set_end_time(sent);
+        writeRawRecord(src_os, ServerDatagramSentTag, serializePBJMessage(sent_rec));
+
+        Trace::Datagram::Received recv_rec;
+        recv_rec.set_t(received);
+        recv_rec.set_source_server(src + 1);
+        recv_rec.set_uid(uid);
+        recv_rec.set_size(256);
+        recv_rec.set_start_time(received);
+        recv_rec.set_end_time(received);
+        writeRawRecord(dst_os, ServerDatagramReceivedTag, serializePBJMessage(recv_rec));
+
+        writeTimestamp(dst_os, received, uid, Trace::SPACE_TO_SPACE_READ_FROM_NET);
+        writeTimestamp(dst_os, received + Duration::microseconds(15), uid, Trace::SPACE_TO_OH_ENQUEUED);
+        writeTimestamp(dst_os, received + Duration::microseconds(200), uid, Trace::OH_RECEIVED);
+        writeTimestamp(dst_os, received + Duration::microseconds(210), uid, Trace::DESTROYED);
+
+        t += tick;
+    }
+    for(uint32 i = 0; i < streams.size(); i++) {
+        streams[i]->close();
+        delete streams[i];
+    }
+
+    std::vector<StreamingAnalysis*> analyses = CreateStreamingAnalyses(analysis_names, Duration::seconds(10.f));
+    Time start = Timer::now();
+    StreamingAnalysisStats stats = StreamingAnalysisRun(trace_files, servers, analyses, std::cout, reorder_window, batch_size, max_queued_batches);
+    Duration elapsed = Timer::now() - start;
+
+    SILOG(analysis,info,
+        "Streaming analysis benchmark: " << stats.events << " events in " << stats.batches << " batches from "
+        << nservers << " servers with " << analyses.size() << " analyses in " << elapsed
+        << " (" << (stats.events / std::max(elapsed.toSeconds(), 0.000001)) << " events/s), at most "
+        << stats.max_buffered_events << " events buffered"
+    );
+
+    for(uint32 i = 0; i < analyses.size(); i++)
+        delete analyses[i];
+    for(uint32 i = 0; i < trace_files.size(); i++)
+        remove(trace_files[i].c_str());
+}
+
+} // namespace Sirikata
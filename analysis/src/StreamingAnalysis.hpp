@@ -0,0 +1,84 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _ANALYSIS_STREAMING_ANALYSIS_HPP_
+#define _ANALYSIS_STREAMING_ANALYSIS_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/Time.hpp>
+
+namespace Sirikata {
+
+struct Event;
+
+/** An analysis which sees every event from every server's trace exactly once,
+ *  in global time order, and only keeps a bounded amount of state. Each
+ *  analysis runs in its own thread, so implementations don't need to be
+ *  thread safe but must not share state with each other.
+ */
+class StreamingAnalysis {
+public:
+    virtual ~StreamingAnalysis() {}
+
+    virtual const char* name() const = 0;
+    /** Process the next event. trace_server is the server whose trace file
+     *  contained the event.
+     */
+    virtual void process(const Event* evt, const ServerID& trace_server) = 0;
+    /** Called after the last event, to flush remaining state and report. */
+    virtual void finish(std::ostream& out) = 0;
+};
+
+/** Creates the streaming analyses named in a comma separated list. Valid
+ *  names are bandwidth, latency and oseg. Unknown names are logged and
+ *  ignored. Ownership of the analyses passes to the caller.
+ */
+std::vector<StreamingAnalysis*> CreateStreamingAnalyses(const String& names, const Duration& latency_window);
+
+struct StreamingAnalysisStats {
+    StreamingAnalysisStats()
+     : events(0),
+       batches(0),
+       max_buffered_events(0)
+    {}
+
+    uint64 events;
+    uint64 batches;
+    // The most events in memory at once, across readers and queued batches
+    uint64 max_buffered_events;
+};
+
+/** Streams the given trace files through the analyses. Each file is read
+ *  incrementally and events within it are reordered by time inside a window
+ *  of reorder_window, since traces are written by multiple threads and are
+ *  only approximately sorted. The files are then merged into a single time
+ *  ordered stream which is split into batches of batch_size events and handed
+ *  to each analysis' thread. At most max_queued_batches batches are
+ *  outstanding, which bounds memory use regardless of trace length.
+ */
+StreamingAnalysisStats StreamingAnalysisRun(
+    const std::vector<String>& trace_files, const std::vector<ServerID>& servers,
+    std::vector<StreamingAnalysis*>& analyses, std::ostream& out,
+    const Duration& reorder_window, uint32 batch_size, uint32 max_queued_batches);
+
+/** Convenience wrapper which streams the per-server trace files for the option
+ *  opt_name, i.e. the same files the other analyses load.
+ */
+StreamingAnalysisStats StreamingAnalysisRun(
+    const char* opt_name, const uint32 nservers,
+    std::vector<StreamingAnalysis*>& analyses, std::ostream& out,
+    const Duration& reorder_window, uint32 batch_size, uint32 max_queued_batches);
+
+/** Writes synthetic traces for nservers servers with events_per_server message
+ *  timestamp and datagram events each, runs the streaming analyses over them
+ *  and reports throughput. Trace files are written using trace_file as a
+ *  template, as GetPerServerString does, and are removed afterwards.
+ */
+void StreamingAnalysisBenchmark(
+    const String& trace_file, const uint32 nservers, const uint32 events_per_server,
+    const String& analyses, const Duration& reorder_window, uint32 batch_size, uint32 max_queued_batches);
+
+} // namespace Sirikata
+
+#endif //_ANALYSIS_STREAMING_ANALYSIS_HPP_
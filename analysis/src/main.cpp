@@ -44,6 +44,7 @@
 #include "MessageLatency.hpp"
 #include "ObjectLatency.hpp"
 #include "FlowStats.hpp"
+#include "StreamingAnalysis.hpp"
 //#include "Visualization.hpp"
 
 void *main_loop(void *);
@@ -62,7 +63,9 @@ bool is_analysis() {
         GetOptionValue<bool>(ANALYSIS_OBJECT_LATENCY) ||
         GetOptionValue<bool>(ANALYSIS_LOC_LATENCY) ||
         !GetOptionValue<String>(ANALYSIS_PROX_DUMP).empty() ||
-        GetOptionValue<bool>(ANALYSIS_FLOW_STATS))
+        GetOptionValue<bool>(ANALYSIS_FLOW_STATS) ||
+        !GetOptionValue<String>(ANALYSIS_STREAMING).empty() ||
+        GetOptionValue<uint32>(ANALYSIS_STREAMING_BENCHMARK) != 0)
         return true;
 
     return false;
@@ -118,7 +121,34 @@ int main(int argc, char** argv) {
 
     srand( GetOptionValue<uint32>("rand-seed") );
 
-    if ( GetOptionValue<bool>(ANALYSIS_LOC) ) {
+    if ( GetOptionValue<uint32>(ANALYSIS_STREAMING_BENCHMARK) != 0 ) {
+        String analyses = GetOptionValue<String>(ANALYSIS_STREAMING);
+        if (analyses.empty()) analyses = "bandwidth,latency,oseg";
+        StreamingAnalysisBenchmark(
+            "streaming_benchmark.trace", std::max(nservers, (uint32)1),
+            GetOptionValue<uint32>(ANALYSIS_STREAMING_BENCHMARK), analyses,
+            GetOptionValue<Duration>(ANALYSIS_STREAMING_REORDER_WINDOW),
+            GetOptionValue<uint32>(ANALYSIS_STREAMING_BATCH_SIZE),
+            GetOptionValue<uint32>(ANALYSIS_STREAMING_MAX_QUEUED_BATCHES)
+        );
+        exit(0);
+    }
+    else if ( !GetOptionValue<String>(ANALYSIS_STREAMING).empty() ) {
+        std::vector<StreamingAnalysis*> analyses = CreateStreamingAnalyses(
+            GetOptionValue<String>(ANALYSIS_STREAMING),
+            GetOptionValue<Duration>(ANALYSIS_STREAMING_LATENCY_WINDOW)
+        );
+        StreamingAnalysisRun(
+            STATS_TRACE_FILE, nservers, analyses, std::cout,
+            GetOptionValue<Duration>(ANALYSIS_STREAMING_REORDER_WINDOW),
+            GetOptionValue<uint32>(ANALYSIS_STREAMING_BATCH_SIZE),
+            GetOptionValue<uint32>(ANALYSIS_STREAMING_MAX_QUEUED_BATCHES)
+        );
+        for(uint32 i = 0; i < analyses.size(); i++)
+            delete analyses[i];
+        exit(0);
+    }
+    else if ( GetOptionValue<bool>(ANALYSIS_LOC) ) {
         LocationErrorAnalysis lea(STATS_TRACE_FILE, nservers);
         printf("Total error: %f\n", (float)lea.globalAverageError( Duration::milliseconds((int64)10)));
         exit(0);
@@ -0,0 +1,44 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_IO_PROFILER_BENCHMARK_HPP_
+#define _SIRIKATA_IO_PROFILER_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** IOProfilerBenchmark measures the cost IOProfiler adds to posting and
+ *  dispatching handlers on an IOStrand. The same handlers are run with
+ *  sampling off, at a typical sample rate and with every handler sampled,
+ *  and the time per handler and overhead relative to sampling being off are
+ *  reported. The parameter is the typical sample rate, 100 by default.
+ */
+class IOProfilerBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new IOProfilerBenchmark(finished_cb, param);
+    }
+
+    IOProfilerBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    // Runs the handlers with the given sample rate, returning how long they
+    // took
+    Duration runHandlers(uint32 sample_rate, bool dispatch);
+
+    bool mForceStop;
+    uint32 mSampleRate;
+}; // class IOProfilerBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_IO_PROFILER_BENCHMARK_HPP_
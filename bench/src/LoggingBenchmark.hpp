@@ -0,0 +1,38 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LOGGING_BENCHMARK_HPP_
+#define _SIRIKATA_LOGGING_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** LoggingBenchmark tests the cost of SILOG statements for a module whose
+ *  level is disabled, comparing the per-module level table against looking up
+ *  the module's level by name in the moduleloglevel map, as was done
+ *  previously.
+ */
+class LoggingBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& _param) {
+        return new LoggingBenchmark(finished_cb);
+    }
+
+    LoggingBenchmark(const FinishedCallback& finished_cb);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+}; // class LoggingBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LOGGING_BENCHMARK_HPP_
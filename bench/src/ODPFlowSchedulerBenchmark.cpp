@@ -0,0 +1,190 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ODPFlowSchedulerBenchmark.hpp"
+#include <sirikata/core/queue/FairQueue.hpp>
+#include <sirikata/core/queue/DRRQueue.hpp>
+#include <sirikata/core/util/RegionWeightCalculator.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define ITERATIONS 200000
+#define DEFAULT_NUM_FLOWS 1000
+// Messages kept queued, so the schedulers always have a choice to make
+#define BACKLOG 4096
+// How often the batch pass recomputes weights, in messages
+#define REFRESH_INTERVAL 10000
+#define MIN_MESSAGE_SIZE 64
+#define MAX_MESSAGE_SIZE 1024
+#define QUANTUM 1024
+#define WORLD_SIZE 1000.f
+
+namespace Sirikata {
+
+namespace {
+
+struct SyntheticMessage {
+    uint32 flow;
+    uint32 bytes;
+
+    uint32 size() const {
+        return bytes;
+    }
+};
+typedef Queue<SyntheticMessage*> SyntheticMessageQueue;
+typedef FairQueue<SyntheticMessage, uint32, SyntheticMessageQueue> PerMessageQueue;
+typedef DRRQueue<SyntheticMessage*, uint32> BatchQueue;
+
+struct SyntheticFlow {
+    BoundingBox3f source;
+    BoundingBox3f dest;
+};
+
+// Stand in for the weight plugins, which the benchmark doesn't load: weight
+// falls off with the square of the distance between the regions' centers.
+double InverseSquareWeight(const Vector3d& src_min, const Vector3d& src_max, const Vector3d& dst_min, const Vector3d& dst_max) {
+    double dist2 = (((src_min + src_max) - (dst_min + dst_max)) * .5).lengthSquared();
+    return 1.0 / std::max(dist2, 1.0);
+}
+
+float32 randomFloat(float32 max) {
+    return max * (rand() / (float32)RAND_MAX);
+}
+
+BoundingBox3f randomObjectBox() {
+    Vector3f center(randomFloat(WORLD_SIZE), randomFloat(WORLD_SIZE), randomFloat(WORLD_SIZE));
+    float32 radius = 1.f + randomFloat(9.f);
+    return BoundingBox3f(center, radius);
+}
+
+}
+
+ODPFlowSchedulerBenchmark::ODPFlowSchedulerBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumFlows(DEFAULT_NUM_FLOWS)
+{
+    if (!param.empty()) {
+        try {
+            mNumFlows = std::max(boost::lexical_cast<uint32>(param), (uint32)1);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of flows: " << param);
+        }
+    }
+}
+
+String ODPFlowSchedulerBenchmark::name() {
+    return "odp-flow-scheduling";
+}
+
+void ODPFlowSchedulerBenchmark::start() {
+    mForceStop = false;
+
+    RegionWeightCalculator calculator(&InverseSquareWeight);
+
+    srand(0);
+    std::vector<SyntheticFlow> flows(mNumFlows);
+    for(uint32 i = 0; i < mNumFlows; i++) {
+        flows[i].source = randomObjectBox();
+        flows[i].dest = randomObjectBox();
+    }
+    // Generate the messages up front so both runs see the same traffic. A
+    // few flows send most of the messages, like a handful of chatty objects.
+    std::vector<SyntheticMessage> messages(ITERATIONS);
+    for(uint32 i = 0; i < ITERATIONS; i++) {
+        float32 r = randomFloat(1.f);
+        messages[i].flow = std::min((uint32)(r * r * mNumFlows), mNumFlows-1);
+        messages[i].bytes = MIN_MESSAGE_SIZE + rand() % (MAX_MESSAGE_SIZE - MIN_MESSAGE_SIZE);
+    }
+
+    // Per-message weights, ordered by virtual finish time
+    uint64 per_message_weights = 0;
+    uint32 per_message_popped = 0;
+    {
+        PerMessageQueue queue;
+        Time start_time = Timer::now();
+        for(uint32 i = 0; i < ITERATIONS && !mForceStop; i++) {
+            SyntheticMessage* msg = &messages[i];
+            SyntheticFlow& flow = flows[msg->flow];
+            float32 weight = (float32)calculator.weight(flow.source, flow.dest);
+            per_message_weights++;
+            if (queue.hasQueue(msg->flow))
+                queue.setQueueWeight(msg->flow, weight);
+            else
+                queue.addQueue(new SyntheticMessageQueue(1 << 30), msg->flow, weight);
+            queue.push(msg->flow, msg);
+
+            if (i >= BACKLOG && queue.pop() != NULL)
+                per_message_popped++;
+        }
+        while(!mForceStop && queue.pop() != NULL)
+            per_message_popped++;
+        Duration per_message_dur = Timer::now() - start_time;
+
+        if (mForceStop)
+            return;
+
+        SILOG(benchmark,info,
+              ITERATIONS << " messages over " << mNumFlows << " flows, weights per message: " << per_message_dur << ": "
+              << (per_message_dur.toMicroseconds()*1000/float(ITERATIONS)) << "ns/message, "
+              << per_message_weights << " weights computed");
+    }
+
+    // Deficit round robin, weights recomputed in batches
+    uint64 batch_weights = 0;
+    uint32 batch_popped = 0;
+    {
+        BatchQueue queue(1 << 30, QUANTUM);
+        BatchQueue::FlowStatsList stats;
+        std::vector<double> weights;
+        SyntheticMessage* popped = NULL;
+        Time start_time = Timer::now();
+        for(uint32 i = 0; i < ITERATIONS && !mForceStop; i++) {
+            SyntheticMessage* msg = &messages[i];
+            queue.push(msg->flow, msg, msg->bytes);
+
+            if (i >= BACKLOG && queue.pop(&popped))
+                batch_popped++;
+
+            if (i % REFRESH_INTERVAL == 0) {
+                stats.clear();
+                queue.collectStats(&stats);
+                weights.resize(stats.size());
+                double min_weight = 0.0;
+                for(uint32 f = 0; f < stats.size(); f++) {
+                    SyntheticFlow& flow = flows[stats[f].key];
+                    weights[f] = calculator.weight(flow.source, flow.dest);
+                    if (weights[f] > 0 && (min_weight == 0 || weights[f] < min_weight))
+                        min_weight = weights[f];
+                }
+                batch_weights += stats.size();
+                for(uint32 f = 0; f < stats.size(); f++)
+                    queue.setWeight(stats[f].key, std::max((float32)(min_weight > 0 ? weights[f] / min_weight : 1.0), 1.f));
+            }
+        }
+        while(!mForceStop && queue.pop(&popped))
+            batch_popped++;
+        Duration batch_dur = Timer::now() - start_time;
+
+        if (mForceStop)
+            return;
+
+        SILOG(benchmark,info,
+              ITERATIONS << " messages over " << mNumFlows << " flows, batched weights with DRR: " << batch_dur << ": "
+              << (batch_dur.toMicroseconds()*1000/float(ITERATIONS)) << "ns/message, "
+              << batch_weights << " weights computed");
+    }
+
+    if (per_message_popped != ITERATIONS || batch_popped != ITERATIONS)
+        SILOG(benchmark,error,"Lost messages: " << per_message_popped << " and " << batch_popped << " of " << ITERATIONS << " delivered");
+
+    notifyFinished();
+}
+
+void ODPFlowSchedulerBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
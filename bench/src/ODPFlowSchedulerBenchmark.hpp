@@ -0,0 +1,43 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_ODP_FLOW_SCHEDULER_BENCHMARK_HPP_
+#define _SIRIKATA_ODP_FLOW_SCHEDULER_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** ODPFlowSchedulerBenchmark runs a synthetic stream of messages between
+ *  pairs of objects through the two ways an ODP flow scheduler can weight
+ *  flows: computing a flow's weight as each message is queued and ordering
+ *  messages with a FairQueue, as the region and CSFQ schedulers do, or
+ *  queueing with deficit round robin and recomputing all weights in a batch
+ *  every so often, as the DRR scheduler does. It reports the time per
+ *  message and how many weights were computed. The parameter is the number
+ *  of flows, 1000 by default.
+ */
+class ODPFlowSchedulerBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new ODPFlowSchedulerBenchmark(finished_cb, param);
+    }
+
+    ODPFlowSchedulerBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+    uint32 mNumFlows;
+}; // class ODPFlowSchedulerBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_ODP_FLOW_SCHEDULER_BENCHMARK_HPP_
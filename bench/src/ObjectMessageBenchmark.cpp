@@ -0,0 +1,151 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ObjectMessageBenchmark.hpp"
+#include <sirikata/core/network/ObjectMessage.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define ITERATIONS 100000
+#define DEFAULT_PAYLOAD_SIZE 1024
+
+namespace Sirikata {
+
+namespace {
+
+// Each echo sends a message from a to b, which parses it and sends the
+// payload straight back, like an ODP port replying with the data it was
+// delivered. wire stands in for the stream's send buffer, which copies the
+// data in both cases, so it isn't counted.
+struct EchoStats {
+    EchoStats() : copied(0), mismatched(0) {}
+
+    // Payload bytes copied before reaching the wire
+    uint64 copied;
+    // Echoes where the payload didn't survive the trip
+    uint32 mismatched;
+};
+
+// The previous path: the MemoryReference from the port is turned into a
+// string, copied into the ObjectMessage and then serialized with it.
+void sendCopying(const UUID& src, const UUID& dst, MemoryReference payload, std::string* wire, EchoStats* stats) {
+    std::string payload_str((const char*)payload.data(), payload.size());
+    ObjectMessage msg;
+    createObjectHostMessage(ObjectHostID(), src, 1, dst, 1, payload_str, &msg);
+    std::string data;
+    msg.serialize(&data);
+    stats->copied += payload_str.size() + msg.payload().size() + data.size();
+
+    wire->assign(data);
+}
+
+// Only the header is serialized and the payload is sent from the caller's
+// buffer.
+void sendSpliced(const UUID& src, const UUID& dst, MemoryReference payload, std::string* wire, EchoStats* stats) {
+    ObjectMessage msg;
+    createObjectHostMessageHeader(ObjectHostID(), src, 1, dst, 1, &msg);
+    std::string header;
+    if (!serializeObjectMessageHeader(msg, payload.size(), &header)) {
+        sendCopying(src, dst, payload, wire, stats);
+        return;
+    }
+    stats->copied += header.size();
+
+    wire->assign(header);
+    wire->append((const char*)payload.data(), payload.size());
+}
+
+}
+
+ObjectMessageBenchmark::ObjectMessageBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mPayloadSize(DEFAULT_PAYLOAD_SIZE)
+{
+    if (!param.empty()) {
+        try {
+            mPayloadSize = boost::lexical_cast<uint32>(param);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid payload size: " << param);
+        }
+    }
+}
+
+String ObjectMessageBenchmark::name() {
+    return "object-message-echo";
+}
+
+void ObjectMessageBenchmark::start() {
+    mForceStop = false;
+
+    UUID a = UUID::random(), b = UUID::random();
+    std::string payload(mPayloadSize, 'x');
+    std::string wire;
+
+    // Copying path, receiving into a newly allocated message each time
+    EchoStats copying;
+    Time start_time = Timer::now();
+    for(uint32 ii = 0; ii < ITERATIONS && !mForceStop; ii++) {
+        sendCopying(a, b, MemoryReference(payload), &wire, &copying);
+        Sirikata::Protocol::Object::ObjectMessage* received = new Sirikata::Protocol::Object::ObjectMessage();
+        received->ParseFromString(wire);
+        sendCopying(b, a, MemoryReference(received->payload()), &wire, &copying);
+        delete received;
+
+        received = new Sirikata::Protocol::Object::ObjectMessage();
+        received->ParseFromString(wire);
+        if (received->payload().size() != payload.size()) copying.mismatched++;
+        delete received;
+    }
+    Duration copying_dur = Timer::now() - start_time;
+
+    if (mForceStop)
+        return;
+
+    // Spliced path, receiving into pooled messages
+    EchoStats spliced;
+    uint64 start_allocations = objectMessageAllocations();
+    start_time = Timer::now();
+    for(uint32 ii = 0; ii < ITERATIONS && !mForceStop; ii++) {
+        sendSpliced(a, b, MemoryReference(payload), &wire, &spliced);
+        Sirikata::Protocol::Object::ObjectMessage* received = acquireObjectMessage();
+        received->ParseFromString(wire);
+        sendSpliced(b, a, MemoryReference(received->payload()), &wire, &spliced);
+        releaseObjectMessage(received);
+
+        received = acquireObjectMessage();
+        received->ParseFromString(wire);
+        if (received->payload().size() != payload.size()) spliced.mismatched++;
+        releaseObjectMessage(received);
+    }
+    Duration spliced_dur = Timer::now() - start_time;
+    uint64 spliced_allocations = objectMessageAllocations() - start_allocations;
+
+    if (mForceStop)
+        return;
+
+    if (copying.mismatched > 0 || spliced.mismatched > 0)
+        SILOG(benchmark,error,"Echoed payloads didn't match: " << copying.mismatched << " copying, " << spliced.mismatched << " spliced");
+
+    float sent = 2.f * ITERATIONS;
+    float payload_bytes = sent * mPayloadSize;
+    SILOG(benchmark,info,
+          ITERATIONS << " echoes of " << mPayloadSize << " byte payloads, copying payload: " << copying_dur << ": "
+          << (copying_dur.toMicroseconds()*1000/float(ITERATIONS)) << "ns/echo, "
+          << (copying.copied / payload_bytes) << " payload copies/message");
+    SILOG(benchmark,info,
+          ITERATIONS << " echoes of " << mPayloadSize << " byte payloads, header only: " << spliced_dur << ": "
+          << (spliced_dur.toMicroseconds()*1000/float(ITERATIONS)) << "ns/echo, "
+          << (spliced.copied / payload_bytes) << " payload copies/message, "
+          << spliced_allocations << " received messages allocated");
+
+    notifyFinished();
+}
+
+void ObjectMessageBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
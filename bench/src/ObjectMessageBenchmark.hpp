@@ -0,0 +1,41 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_OBJECT_MESSAGE_BENCHMARK_HPP_
+#define _SIRIKATA_OBJECT_MESSAGE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** ObjectMessageBenchmark echoes ObjectMessages the way an object host sends
+ *  and receives them, comparing copying the payload into the message before
+ *  serializing it against serializing only the header and sending the
+ *  payload from the caller's buffer. It reports the time per echo and how
+ *  many times the payload was copied per message before reaching the
+ *  network. The parameter is the payload size in bytes, 1024 by default.
+ */
+class ObjectMessageBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new ObjectMessageBenchmark(finished_cb, param);
+    }
+
+    ObjectMessageBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+    uint32 mPayloadSize;
+}; // class ObjectMessageBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_OBJECT_MESSAGE_BENCHMARK_HPP_
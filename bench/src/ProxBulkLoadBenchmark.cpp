@@ -0,0 +1,261 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ProxBulkLoadBenchmark.hpp"
+#include "ProxSimulationTraits.hpp"
+#include <sirikata/core/prox/BulkLoad.hpp>
+#include <sirikata/core/prox/QueryHandlerFactory.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Random.hpp>
+#include <prox/base/LocationServiceCache.hpp>
+#include <prox/base/QueryEventListener.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define DEFAULT_OBJECTS 100000
+#define LEAF_SIZE 10
+// The default object query handler used by the space server
+#define HANDLER_TYPE "rtreecut"
+#define OBJECT_RADIUS 1.f
+#define WORLD_SIZE 10000.f
+#define NUM_CLUSTERS 100
+#define CLUSTER_SIZE 200.f
+
+namespace Sirikata {
+
+namespace {
+
+#define EXTRACT_ITERATOR(x) (*((ObjectMap::iterator*)x.data))
+#define EXTRACT_ITERATOR_DATA(x) (EXTRACT_ITERATOR(x)->second)
+
+typedef BulkLoadEntry<UUID> Entry;
+typedef std::vector<Entry> EntryList;
+
+typedef Prox::QueryHandler<ObjectProxSimulationTraits> ProxQueryHandler;
+typedef Prox::Query<ObjectProxSimulationTraits> ProxQuery;
+
+/* Location cache for a fixed set of stationary objects. Objects are announced
+ * to the query handlers all at once, in the order they are given, the way
+ * CBRLocationServiceCache announces a batch of new objects.
+ */
+class BenchLocationServiceCache : public Prox::LocationServiceCache<ObjectProxSimulationTraits> {
+public:
+    typedef Prox::LocationUpdateListener<ObjectProxSimulationTraits> LocationUpdateListener;
+
+    void announce(const EntryList& entries) {
+        for(EntryList::const_iterator entry_it = entries.begin(); entry_it != entries.end(); entry_it++) {
+            ObjectData& data = mObjects[entry_it->id];
+            data.location = TimedMotionVector3f(Time::null(), MotionVector3f(entry_it->pos, Vector3f(0, 0, 0)));
+            data.tracking = false;
+            for(ListenerSet::iterator listen_it = mListeners.begin(); listen_it != mListeners.end(); listen_it++)
+                (*listen_it)->locationConnected(entry_it->id, false, true, data.location, BoundingSphere3f(Vector3f(0, 0, 0), 0.f), OBJECT_RADIUS);
+        }
+    }
+
+    virtual void addPlaceholderImposter(
+        const ObjectID& id,
+        const Vector3f& center_offset,
+        const float32 center_bounds_radius,
+        const float32 max_size,
+        const String& zernike,
+        const String& mesh
+    ) {
+        // No aggregates are generated for the fixed set of objects
+    }
+
+    virtual Iterator startTracking(const ObjectID& id) {
+        ObjectMap::iterator it = mObjects.find(id);
+        assert(it != mObjects.end());
+        it->second.tracking = true;
+        return Iterator( new ObjectMap::iterator(it) );
+    }
+    virtual void stopTracking(const Iterator& id) {
+        EXTRACT_ITERATOR_DATA(id).tracking = false;
+    }
+
+    virtual TimedMotionVector3f location(const Iterator& id) {
+        return EXTRACT_ITERATOR_DATA(id).location;
+    }
+    virtual Vector3f centerOffset(const Iterator& id) {
+        return Vector3f(0, 0, 0);
+    }
+    virtual float32 centerBoundsRadius(const Iterator& id) {
+        return 0.f;
+    }
+    virtual float32 maxSize(const Iterator& id) {
+        return OBJECT_RADIUS;
+    }
+    virtual bool isLocal(const Iterator& id) {
+        return true;
+    }
+    Prox::ZernikeDescriptor& zernikeDescriptor(const Iterator& id) {
+        return Prox::ZernikeDescriptor::null();
+    }
+    String mesh(const Iterator& id) {
+        return String("");
+    }
+
+    virtual const UUID& iteratorID(const Iterator& id) {
+        return EXTRACT_ITERATOR(id)->first;
+    }
+
+    virtual void addUpdateListener(LocationUpdateListener* listener) {
+        mListeners.insert(listener);
+    }
+    virtual void removeUpdateListener(LocationUpdateListener* listener) {
+        mListeners.erase(listener);
+    }
+
+private:
+    struct ObjectData {
+        TimedMotionVector3f location;
+        bool tracking;
+    };
+    typedef std::tr1::unordered_map<UUID, ObjectData, UUID::Hasher> ObjectMap;
+    typedef std::set<LocationUpdateListener*> ListenerSet;
+
+    ObjectMap mObjects;
+    ListenerSet mListeners;
+};
+
+// Query results aren't used, they just need to be drained
+class DiscardQueryEvents : public Prox::QueryEventListener<ObjectProxSimulationTraits, ProxQuery> {
+public:
+    virtual void queryHasEvents(ProxQuery* query) {
+        std::deque<Prox::QueryEvent<ObjectProxSimulationTraits> > evts;
+        query->popEvents(evts);
+    }
+};
+
+EntryList uniformObjects(uint32 n) {
+    EntryList entries;
+    entries.reserve(n);
+    for(uint32 i = 0; i < n; i++)
+        entries.push_back(Entry(UUID::random(), Vector3f(randFloat(0, WORLD_SIZE), randFloat(0, WORLD_SIZE), randFloat(0, WORLD_SIZE))));
+    return entries;
+}
+
+// Objects gathered in dense clusters, like buildings in towns, with the
+// clusters spread uniformly. Objects are generated in random order so they
+// don't arrive grouped by cluster.
+EntryList clusteredObjects(uint32 n) {
+    std::vector<Vector3f> centers;
+    for(uint32 i = 0; i < NUM_CLUSTERS; i++)
+        centers.push_back(Vector3f(randFloat(0, WORLD_SIZE), randFloat(0, WORLD_SIZE), randFloat(0, WORLD_SIZE)));
+
+    EntryList entries;
+    entries.reserve(n);
+    for(uint32 i = 0; i < n; i++) {
+        const Vector3f& center = centers[randInt<uint32>(0, NUM_CLUSTERS-1)];
+        // Sum of uniforms gives a roughly normal falloff from the center
+        Vector3f offset(0, 0, 0);
+        for(int k = 0; k < 3; k++)
+            offset += Vector3f(randFloat(-1, 1), randFloat(-1, 1), randFloat(-1, 1));
+        entries.push_back(Entry(UUID::random(), center + offset * (CLUSTER_SIZE / 3.f)));
+    }
+    return entries;
+}
+
+// Average extent of the bounding box of each group of LEAF_SIZE consecutive
+// objects, i.e. the leaves an R-tree filled in this order would get.
+float32 averageLeafExtent(const EntryList& entries) {
+    float64 total = 0;
+    uint32 leaves = 0;
+    for(uint32 start = 0; start < entries.size(); start += LEAF_SIZE) {
+        Vector3f lo = entries[start].pos, hi = entries[start].pos;
+        uint32 end = std::min((uint32)entries.size(), start + LEAF_SIZE);
+        for(uint32 i = start + 1; i < end; i++) {
+            lo = lo.min(entries[i].pos);
+            hi = hi.max(entries[i].pos);
+        }
+        total += (hi - lo).length();
+        leaves++;
+    }
+    return (float32)(total / leaves);
+}
+
+} // namespace
+
+ProxBulkLoadBenchmark::ProxBulkLoadBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumObjects(DEFAULT_OBJECTS)
+{
+    if (!param.empty()) {
+        try {
+            mNumObjects = boost::lexical_cast<uint32>(param);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of objects: " << param);
+        }
+    }
+}
+
+String ProxBulkLoadBenchmark::name() {
+    return "prox-bulk-load";
+}
+
+void ProxBulkLoadBenchmark::start() {
+    mForceStop = false;
+
+    const char* dist_names[] = { "uniform", "clustered" };
+    BulkLoadOrder orders[] = { BULK_LOAD_NONE, BULK_LOAD_HILBERT, BULK_LOAD_STR };
+
+    for(int dist = 0; dist < 2 && !mForceStop; dist++) {
+        EntryList objects = (dist == 0) ? uniformObjects(mNumObjects) : clusteredObjects(mNumObjects);
+
+        for(int oi = 0; oi < 3 && !mForceStop; oi++) {
+            EntryList entries = objects;
+            BenchLocationServiceCache loc_cache;
+            DiscardQueryEvents query_listener;
+
+            // Everything a proximity handler does before it can answer its
+            // first query: create the handler, order the objects, insert
+            // them and evaluate the first tick.
+            Time start_time = Timer::now();
+            ProxQueryHandler* handler = QueryHandlerFactory<ObjectProxSimulationTraits>(HANDLER_TYPE, String("--branching=") + boost::lexical_cast<String>(LEAF_SIZE));
+            handler->initialize(&loc_cache, &loc_cache, false /* static */, false /* not replicated */);
+            // Only the largest objects are returned, so evaluating the query
+            // doesn't dominate building the tree
+            ProxQuery* query = handler->registerQuery(
+                TimedMotionVector3f(Time::null(), MotionVector3f(Vector3f(WORLD_SIZE/2, WORLD_SIZE/2, WORLD_SIZE/2), Vector3f(0, 0, 0))),
+                BoundingSphere3f(Vector3f(0, 0, 0), 0.f), 0.f, SolidAngle::Max
+            );
+            query->setEventListener(&query_listener);
+
+            Time sort_start = Timer::now();
+            BulkLoadSort(entries, orders[oi], LEAF_SIZE);
+            Duration sort_dur = Timer::now() - sort_start;
+
+            Time insert_start = Timer::now();
+            loc_cache.announce(entries);
+            Duration insert_dur = Timer::now() - insert_start;
+
+            handler->tick(Time::null() + Duration::seconds(1.f));
+            Duration dur = Timer::now() - start_time;
+
+            delete query;
+            delete handler;
+
+            SILOG(benchmark,info,
+                mNumObjects << " " << dist_names[dist] << " objects, "
+                << BulkLoadOrderToString(orders[oi]) << " order: "
+                << dur << " to build, "
+                << (dur.toMicroseconds()*1000/float(mNumObjects)) << "ns/object, "
+                << sort_dur << " ordering, "
+                << insert_dur << " inserting, "
+                << "average leaf extent " << averageLeafExtent(entries));
+        }
+    }
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void ProxBulkLoadBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,41 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_PROX_BULK_LOAD_BENCHMARK_HPP_
+#define _SIRIKATA_PROX_BULK_LOAD_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** ProxBulkLoadBenchmark measures the startup cost of building a query
+ *  handler over a large, synthetic set of objects inserted in each bulk load
+ *  order: creating the handler, ordering and inserting the objects and
+ *  evaluating the first tick. It also reports how tightly each order packs
+ *  neighbouring objects into leaves. The parameter is the number of objects,
+ *  100000 by default.
+ */
+class ProxBulkLoadBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new ProxBulkLoadBenchmark(finished_cb, param);
+    }
+
+    ProxBulkLoadBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+    uint32 mNumObjects;
+}; // class ProxBulkLoadBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_PROX_BULK_LOAD_BENCHMARK_HPP_
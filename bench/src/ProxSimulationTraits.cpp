@@ -0,0 +1,15 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "ProxSimulationTraits.hpp"
+
+#include <float.h>
+
+namespace Sirikata {
+
+const ProxSimulationTraits::realType ProxSimulationTraits::InfiniteRadius = FLT_MAX;
+
+const ProxSimulationTraits::intType ProxSimulationTraits::InfiniteResults = INT_MAX;
+
+} // namespace Sirikata
@@ -0,0 +1,145 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "RaytraceBenchmark.hpp"
+#include <sirikata/mesh/Raytrace.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/Random.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define DEFAULT_TRIANGLES 100000
+#define NUM_RAYS 100000
+#define RAY_BATCH_SIZE 1000
+
+namespace Sirikata {
+
+using namespace Sirikata::Mesh;
+
+namespace {
+
+// A randomly bumpy height field with about ntris triangles, spanning [0,1] in
+// x and y. Indices are unsigned shorts, so large meshes are split into
+// multiple primitives, each with its own vertices.
+MeshdataPtr createTerrain(uint32 ntris) {
+    MeshdataPtr mesh(new Meshdata());
+    mesh->globalTransform = Matrix4x4f::identity();
+
+    uint32 n = std::max((uint32)2, (uint32)sqrt(ntris / 2.0) + 1);
+    // Rows per primitive, keeping indices in range
+    uint32 rows_per_prim = std::max((uint32)1, (uint32)(65535 / (2 * n)) - 1);
+    std::vector<float32> heights(n * n);
+    for(uint32 i = 0; i < heights.size(); i++)
+        heights[i] = randFloat(0, 0.01f);
+
+    SubMeshGeometry geo;
+    for(uint32 row_start = 0; row_start + 1 < n; row_start += rows_per_prim) {
+        uint32 row_end = std::min(n - 1, row_start + rows_per_prim);
+        SubMeshGeometry::Primitive prim;
+        prim.primitiveType = SubMeshGeometry::Primitive::TRIANGLES;
+        prim.materialId = 0;
+        uint32 base = geo.positions.size();
+        for(uint32 y = row_start; y <= row_end; y++)
+            for(uint32 x = 0; x < n; x++)
+                geo.positions.push_back(Vector3f(x / float32(n - 1), y / float32(n - 1), heights[y * n + x]));
+        for(uint32 y = 0; y < row_end - row_start; y++) {
+            for(uint32 x = 0; x + 1 < n; x++) {
+                uint32 i = base + y * n + x;
+                prim.indices.push_back(i - base); prim.indices.push_back(i + 1 - base); prim.indices.push_back(i + n - base);
+                prim.indices.push_back(i + 1 - base); prim.indices.push_back(i + n + 1 - base); prim.indices.push_back(i + n - base);
+            }
+        }
+        geo.primitives.push_back(prim);
+    }
+    geo.recomputeBounds();
+    mesh->geometry.push_back(geo);
+
+    Node node(Matrix4x4f::identity());
+    node.containsInstanceController = false;
+    mesh->nodes.push_back(node);
+    mesh->rootNodes.push_back(0);
+    GeometryInstance inst;
+    inst.geometryIndex = 0;
+    inst.parentNode = 0;
+    mesh->instances.push_back(inst);
+    return mesh;
+}
+
+} // namespace
+
+RaytraceBenchmark::RaytraceBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumTriangles(DEFAULT_TRIANGLES)
+{
+    if (!param.empty()) {
+        try {
+            mNumTriangles = boost::lexical_cast<uint32>(param);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of triangles: " << param);
+        }
+    }
+}
+
+String RaytraceBenchmark::name() {
+    return "raytrace";
+}
+
+void RaytraceBenchmark::start() {
+    mForceStop = false;
+
+    MeshdataPtr mesh = createTerrain(mNumTriangles);
+    Matrix4x4f xform(Matrix4x4f::identity());
+
+    // Rays from above, angled slightly so they don't line up with the grid
+    std::vector<Vector3f> starts, dirs;
+    for(uint32 i = 0; i < NUM_RAYS; i++) {
+        starts.push_back(Vector3f(randFloat(0, 1), randFloat(0, 1), 1.f));
+        dirs.push_back(Vector3f(randFloat(-0.1f, 0.1f), randFloat(-0.1f, 0.1f), -1.f));
+    }
+
+    // The first trace builds and caches the acceleration structure
+    Time start_time = Timer::now();
+    Raytrace(mesh, xform, starts[0], dirs[0], NULL, NULL);
+    Duration build_dur = Timer::now() - start_time;
+    SILOG(benchmark,info, mNumTriangles << " triangles, first trace (including build): " << build_dur);
+
+    uint32 hits = 0;
+    start_time = Timer::now();
+    for(uint32 i = 0; i < NUM_RAYS && !mForceStop; i++) {
+        if (Raytrace(mesh, xform, starts[i], dirs[i], NULL, NULL))
+            hits++;
+    }
+    Duration single_dur = Timer::now() - start_time;
+    if (mForceStop)
+        return;
+    SILOG(benchmark,info,
+        NUM_RAYS << " single rays: " << single_dur << ", "
+        << (single_dur.toMicroseconds()*1000/float(NUM_RAYS)) << "ns/ray, "
+        << hits << " hits");
+
+    hits = 0;
+    start_time = Timer::now();
+    for(uint32 batch_start = 0; batch_start < NUM_RAYS && !mForceStop; batch_start += RAY_BATCH_SIZE) {
+        uint32 batch_end = std::min((uint32)NUM_RAYS, batch_start + RAY_BATCH_SIZE);
+        std::vector<Vector3f> batch_starts(starts.begin() + batch_start, starts.begin() + batch_end);
+        std::vector<Vector3f> batch_dirs(dirs.begin() + batch_start, dirs.begin() + batch_end);
+        hits += RaytraceMany(mesh, xform, batch_starts, batch_dirs, NULL, NULL);
+    }
+    Duration many_dur = Timer::now() - start_time;
+    if (mForceStop)
+        return;
+    SILOG(benchmark,info,
+        NUM_RAYS << " rays in batches of " << RAY_BATCH_SIZE << ": " << many_dur << ", "
+        << (many_dur.toMicroseconds()*1000/float(NUM_RAYS)) << "ns/ray, "
+        << hits << " hits");
+
+    notifyFinished();
+}
+
+void RaytraceBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
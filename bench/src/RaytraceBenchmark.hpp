@@ -0,0 +1,40 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_RAYTRACE_BENCHMARK_HPP_
+#define _SIRIKATA_RAYTRACE_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** RaytraceBenchmark measures mesh raytracing against a large synthetic
+ *  terrain mesh: the cost of building the acceleration structure on the first
+ *  trace, and the throughput of single rays and of batches traced with
+ *  RaytraceMany. The parameter is the approximate number of triangles,
+ *  100000 by default.
+ */
+class RaytraceBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new RaytraceBenchmark(finished_cb, param);
+    }
+
+    RaytraceBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+    uint32 mNumTriangles;
+}; // class RaytraceBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_RAYTRACE_BENCHMARK_HPP_
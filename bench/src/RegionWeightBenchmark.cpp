@@ -0,0 +1,125 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "RegionWeightBenchmark.hpp"
+#include <sirikata/core/util/RegionWeightCalculator.hpp>
+#include <sirikata/core/util/PluginManager.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define ITERATIONS 100
+#define DEFAULT_NUM_PAIRS 1000
+#define WORLD_SIZE 1000.f
+#define WEIGHT_ARGS "--flatness=0.01"
+
+namespace Sirikata {
+
+namespace {
+
+float32 randomFloat(float32 max) {
+    return max * (rand() / (float32)RAND_MAX);
+}
+
+BoundingBox3f randomRegion() {
+    Vector3f center(randomFloat(WORLD_SIZE), randomFloat(WORLD_SIZE), randomFloat(WORLD_SIZE));
+    return BoundingBox3f(center, 1.f + randomFloat(50.f));
+}
+
+// Time computing the weights of all the regions ITERATIONS times, one pair at
+// a time or in a batch
+Duration timeWeights(RegionWeightCalculator* calc, const BoundingBoxList& sources, BoundingBoxList& dests, const RegionPairs& pairs, bool batch, std::vector<float64>* results, const bool& force_stop) {
+    results->resize(sources.size());
+    Time start_time = Timer::now();
+    for(uint32 it = 0; it < ITERATIONS && !force_stop; it++) {
+        if (batch) {
+            calc->weights(pairs, results);
+        }
+        else {
+            for(uint32 i = 0; i < sources.size(); i++)
+                (*results)[i] = calc->weight(sources[i], dests[i]);
+        }
+    }
+    return Timer::now() - start_time;
+}
+
+}
+
+RegionWeightBenchmark::RegionWeightBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumPairs(DEFAULT_NUM_PAIRS)
+{
+    if (!param.empty()) {
+        try {
+            mNumPairs = std::max(boost::lexical_cast<uint32>(param), (uint32)1);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of pairs: " << param);
+        }
+    }
+}
+
+String RegionWeightBenchmark::name() {
+    return "region-weights";
+}
+
+void RegionWeightBenchmark::start() {
+    mForceStop = false;
+
+    static PluginManager plugins;
+    plugins.load("weight-exp");
+    if (!RegionWeightCalculatorFactory::getSingleton().hasConstructor("gaussian")) {
+        SILOG(benchmark,error,"The gaussian region weight calculator isn't available");
+        notifyFinished();
+        return;
+    }
+    RegionWeightCalculator* exact = RegionWeightCalculatorFactory::getSingleton().getConstructor("gaussian")(WEIGHT_ARGS " --table=false");
+    RegionWeightCalculator* table = RegionWeightCalculatorFactory::getSingleton().getConstructor("gaussian")(WEIGHT_ARGS " --table=true");
+
+    srand(0);
+    BoundingBoxList sources, dests;
+    for(uint32 i = 0; i < mNumPairs; i++) {
+        sources.push_back(randomRegion());
+        dests.push_back(randomRegion());
+    }
+    RegionPairs pairs(sources, dests);
+
+    std::vector<float64> exact_weights, table_weights;
+    Duration exact_dur = timeWeights(exact, sources, dests, pairs, false, &exact_weights, mForceStop);
+    Duration exact_batch_dur = timeWeights(exact, sources, dests, pairs, true, &exact_weights, mForceStop);
+    Duration table_dur = timeWeights(table, sources, dests, pairs, false, &table_weights, mForceStop);
+    Duration table_batch_dur = timeWeights(table, sources, dests, pairs, true, &table_weights, mForceStop);
+    delete exact;
+    delete table;
+
+    if (mForceStop)
+        return;
+
+    // Error relative to the largest weight, since tiny weights for distant
+    // pairs are swamped by the others anyway
+    float64 max_weight = 0, max_error = 0;
+    for(uint32 i = 0; i < mNumPairs; i++) {
+        max_weight = std::max(max_weight, fabs(exact_weights[i]));
+        max_error = std::max(max_error, fabs(table_weights[i] - exact_weights[i]));
+    }
+
+    float pairs_computed = float(ITERATIONS) * mNumPairs;
+    SILOG(benchmark,info,
+          ITERATIONS << "x" << mNumPairs << " gaussian weights, exact: "
+          << (exact_dur.toMicroseconds()*1000/pairs_computed) << "ns/pair, "
+          << (exact_batch_dur.toMicroseconds()*1000/pairs_computed) << "ns/pair batched");
+    SILOG(benchmark,info,
+          ITERATIONS << "x" << mNumPairs << " gaussian weights, table: "
+          << (table_dur.toMicroseconds()*1000/pairs_computed) << "ns/pair, "
+          << (table_batch_dur.toMicroseconds()*1000/pairs_computed) << "ns/pair batched, "
+          << "max error " << (max_weight > 0 ? max_error / max_weight : 0) << " of largest weight");
+
+    notifyFinished();
+}
+
+void RegionWeightBenchmark::stop() {
+    mForceStop = true;
+}
+
+} // namespace Sirikata
@@ -0,0 +1,40 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_REGION_WEIGHT_BENCHMARK_HPP_
+#define _SIRIKATA_REGION_WEIGHT_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+
+namespace Sirikata {
+
+/** RegionWeightBenchmark computes gaussian region weights for random pairs
+ *  of regions, exactly and with a table, one pair at a time and in batches.
+ *  It reports the time per pair and the largest error of the table relative
+ *  to the exact integral. The parameter is the number of pairs in each
+ *  batch, 1000 by default.
+ */
+class RegionWeightBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new RegionWeightBenchmark(finished_cb, param);
+    }
+
+    RegionWeightBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+    uint32 mNumPairs;
+}; // class RegionWeightBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_REGION_WEIGHT_BENCHMARK_HPP_
@@ -0,0 +1,465 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "SSTStressBenchmark.hpp"
+#include <sirikata/core/network/SSTImpl.hpp>
+#include <sirikata/core/network/IOStrand.hpp>
+#include <sirikata/core/network/IOWork.hpp>
+#include <sirikata/core/util/Thread.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <boost/lexical_cast.hpp>
+
+#define DEFAULT_STREAMS 10000
+#define NUM_THREADS 4
+// Streams are opened in batches so the main strand keeps servicing the
+// streams that are already connecting.
+#define LAUNCH_BATCH 500
+#define LISTEN_PORT 1
+#define PING_SIZE 100
+#define NUM_PINGS 3
+
+namespace Sirikata {
+
+namespace SSTStress {
+
+/** Identifies a node on the LoopbackNetwork. Meets the requirements SST has of
+ *  an endpoint type.
+ */
+class LoopbackNode {
+public:
+    LoopbackNode() : mID(0) {}
+    explicit LoopbackNode(uint32 id) : mID(id) {}
+
+    bool operator==(const LoopbackNode& rhs) const { return mID == rhs.mID; }
+    bool operator!=(const LoopbackNode& rhs) const { return mID != rhs.mID; }
+    bool operator<(const LoopbackNode& rhs) const { return mID < rhs.mID; }
+
+    String toString() const {
+        return boost::lexical_cast<String>(mID);
+    }
+
+    class Hasher {
+    public:
+        size_t operator()(const LoopbackNode& n) const {
+            return std::tr1::hash<uint32>()(n.mID);
+        }
+    };
+
+private:
+    uint32 mID;
+};
+
+typedef SST::EndPoint<LoopbackNode> Endpoint;
+
+/** Delivers datagrams between endpoints in this process. Each delivery is
+ *  posted to the IOService, so packets are handled on whichever thread picks
+ *  them up, as they would be when arriving from the network.
+ */
+class LoopbackNetwork {
+public:
+    typedef std::tr1::function<void(const Endpoint&, const Endpoint&, const std::string&)> ReceiveHandler;
+
+    LoopbackNetwork(Network::IOService* ios)
+     : mIOService(ios),
+       mNextPort(LISTEN_PORT + 1)
+    {}
+
+    void bind(const Endpoint& ep, const ReceiveHandler& handler) {
+        mBindings.set(ep, handler);
+    }
+
+    void unbind(const Endpoint& ep) {
+        mBindings.erase(ep);
+    }
+
+    void send(const Endpoint& src, const Endpoint& dst, void* data, int len) {
+        ReceiveHandler handler;
+        if (!mBindings.get(dst, &handler)) return;
+        mIOService->post(
+            std::tr1::bind(handler, src, dst, std::string((const char*)data, len)),
+            "LoopbackNetwork::deliver"
+        );
+    }
+
+    uint32 unusedPort() {
+        boost::mutex::scoped_lock lock(mPortMutex);
+        return mNextPort++;
+    }
+
+private:
+    Network::IOService* mIOService;
+    ConcurrentHashMap<Endpoint, ReceiveHandler, Endpoint::Hasher> mBindings;
+    boost::mutex mPortMutex;
+    uint32 mNextPort;
+};
+
+} // namespace SSTStress
+
+namespace SST {
+
+template <>
+class BaseDatagramLayer<SSTStress::LoopbackNode>
+{
+  private:
+    typedef SSTStress::LoopbackNode EndPointType;
+
+  public:
+    typedef std::tr1::shared_ptr<BaseDatagramLayer<EndPointType> > Ptr;
+    typedef Ptr BaseDatagramLayerPtr;
+
+    typedef std::tr1::function<void(void*, int)> DataCallback;
+
+    static BaseDatagramLayerPtr getDatagramLayer(ConnectionVariables<EndPointType>* sstConnVars,
+                                                 EndPointType endPoint)
+    {
+        return sstConnVars->getDatagramLayer(endPoint);
+    }
+
+    static BaseDatagramLayerPtr createDatagramLayer(
+        ConnectionVariables<EndPointType>* sstConnVars,
+        EndPointType endPoint,
+        const Context* ctx,
+        SSTStress::LoopbackNetwork* network)
+    {
+        BaseDatagramLayerPtr datagramLayer = getDatagramLayer(sstConnVars, endPoint);
+        if (datagramLayer) return datagramLayer;
+
+        datagramLayer = BaseDatagramLayerPtr(
+            new BaseDatagramLayer(sstConnVars, ctx, network)
+        );
+        sstConnVars->addDatagramLayer(endPoint, datagramLayer);
+
+        return datagramLayer;
+    }
+
+    static void stopListening(ConnectionVariables<EndPointType>* sstConnVars, EndPoint<EndPointType>& listeningEndPoint) {
+        BaseDatagramLayerPtr bdl = sstConnVars->getDatagramLayer(listeningEndPoint.endPoint);
+        if (!bdl) return;
+        bdl->unlisten(listeningEndPoint);
+    }
+
+    void listenOn(EndPoint<EndPointType>& listeningEndPoint, DataCallback cb) {
+        mNetwork->bind(
+            listeningEndPoint,
+            std::tr1::bind(&BaseDatagramLayer::receiveMessageToCallback,
+                std::tr1::placeholders::_1,
+                std::tr1::placeholders::_2,
+                std::tr1::placeholders::_3,
+                cb
+            )
+        );
+    }
+
+    void listenOn(const EndPoint<EndPointType>& listeningEndPoint) {
+        mNetwork->bind(
+            listeningEndPoint,
+            std::tr1::bind(&BaseDatagramLayer::receiveMessage, this,
+                std::tr1::placeholders::_1,
+                std::tr1::placeholders::_2,
+                std::tr1::placeholders::_3
+            )
+        );
+    }
+
+    void unlisten(EndPoint<EndPointType>& ep) {
+        mNetwork->unbind(ep);
+    }
+
+    void send(EndPoint<EndPointType>* src, EndPoint<EndPointType>* dest, void* data, int len) {
+        mNetwork->send(*src, *dest, data, len);
+    }
+
+    const Context* context() {
+        return mContext;
+    }
+
+    uint32 getUnusedPort(const EndPointType& ep) {
+        return mNetwork->unusedPort();
+    }
+
+  private:
+    BaseDatagramLayer(ConnectionVariables<EndPointType>* sstConnVars, const Context* ctx, SSTStress::LoopbackNetwork* network)
+        : mContext(ctx),
+          mNetwork(network),
+          mSSTConnVars(sstConnVars)
+        {
+        }
+
+    void receiveMessage(const EndPoint<EndPointType>& src, const EndPoint<EndPointType>& dst, const std::string& payload) {
+        Connection<EndPointType>::handleReceive(
+            mSSTConnVars, src, dst,
+            (void*) payload.data(), payload.size()
+        );
+    }
+
+    static void receiveMessageToCallback(const EndPoint<EndPointType>& src, const EndPoint<EndPointType>& dst, const std::string& payload, DataCallback cb) {
+        cb((void*) payload.data(), payload.size());
+    }
+
+    const Context* mContext;
+    SSTStress::LoopbackNetwork* mNetwork;
+    ConnectionVariables<EndPointType>* mSSTConnVars;
+};
+
+} // namespace SST
+
+namespace SSTStress {
+
+typedef SST::ConnectionManager<LoopbackNode> ConnectionManager;
+typedef SST::Stream<LoopbackNode> Stream;
+
+/** State for one run. The callbacks here are application callbacks, which SST
+ *  invokes from each connection's strand, so state shared between streams is
+ *  protected by mMutex. A stream's own state is only touched by its
+ *  connection's callbacks. The lock isn't held while calling into SST.
+ */
+class StressRun {
+public:
+    StressRun(Context* ctx, ConnectionManager* sst, uint32 num_streams)
+     : mContext(ctx),
+       mSST(sst),
+       mNumStreams(num_streams),
+       mLaunched(0),
+       mConnected(0),
+       mFailed(0),
+       mCompleted(0),
+       mStartTime(Time::null()),
+       mConnectedTime(Time::null()),
+       mCompletedTime(Time::null()),
+       mClientStreams(num_streams),
+       mReceived(num_streams, 0)
+    {}
+
+    void start() {
+        mStartTime = Timer::now();
+        mSST->listen(
+            std::tr1::bind(&StressRun::serverStream, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2),
+            Endpoint(LoopbackNode(SERVER_NODE), LISTEN_PORT)
+        );
+        launchBatch();
+    }
+
+    void report(uint32 nthreads) {
+        Time now = Timer::now();
+        SILOG(benchmark,info,
+            mNumStreams << " streams on " << nthreads << " threads: "
+            << mConnected << " connected (" << mFailed << " failed) in "
+            << ((mConnectedTime == Time::null()) ? (now - mStartTime) : (mConnectedTime - mStartTime)) << ", "
+            << mCompleted << " finished " << NUM_PINGS << " pings in "
+            << ((mCompletedTime == Time::null()) ? (now - mStartTime) : (mCompletedTime - mStartTime)));
+        if (mCompletedTime != Time::null())
+            SILOG(benchmark,info, "Stream throughput: " << (mCompleted / (mCompletedTime - mStartTime).toSeconds()) << " streams/s");
+    }
+
+    void clearStreams() {
+        mClientStreams.clear();
+        mServerStreams.clear();
+    }
+
+private:
+    enum {
+        SERVER_NODE = 1,
+        CLIENT_NODE = 2
+    };
+
+    void launchBatch() {
+        uint32 end = std::min(mNumStreams, mLaunched + LAUNCH_BATCH);
+        for(; mLaunched < end; mLaunched++) {
+            bool started = mSST->connectStream(
+                Endpoint(LoopbackNode(CLIENT_NODE), 0),
+                Endpoint(LoopbackNode(SERVER_NODE), LISTEN_PORT),
+                std::tr1::bind(&StressRun::clientConnected, this, mLaunched, std::tr1::placeholders::_1, std::tr1::placeholders::_2)
+            );
+            if (!started) streamFailed();
+        }
+        if (mLaunched < mNumStreams)
+            mContext->mainStrand->post(std::tr1::bind(&StressRun::launchBatch, this), "StressRun::launchBatch");
+    }
+
+    void clientConnected(uint32 idx, int err, Stream::Ptr strm) {
+        if (err != SST_IMPL_SUCCESS || !strm) {
+            streamFailed();
+            return;
+        }
+
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+            mClientStreams[idx] = strm;
+            mConnected++;
+            if (mConnected + mFailed == mNumStreams)
+                mConnectedTime = Timer::now();
+        }
+
+        strm->registerReadCallback(
+            std::tr1::bind(&StressRun::clientRead, this, idx, std::tr1::placeholders::_1, std::tr1::placeholders::_2)
+        );
+        sendPing(strm);
+    }
+
+    void sendPing(Stream::Ptr strm) {
+        uint8 ping[PING_SIZE];
+        memset(ping, 0, PING_SIZE);
+        strm->write(ping, PING_SIZE);
+    }
+
+    void clientRead(uint32 idx, uint8* data, int size) {
+        uint32 before = mReceived[idx] / PING_SIZE;
+        mReceived[idx] += size;
+        uint32 after = mReceived[idx] / PING_SIZE;
+        if (after == before) return;
+
+        if (after < NUM_PINGS) {
+            Stream::Ptr strm;
+            {
+                boost::mutex::scoped_lock lock(mMutex);
+                strm = mClientStreams[idx];
+            }
+            sendPing(strm);
+        }
+        else if (before < NUM_PINGS) {
+            boost::mutex::scoped_lock lock(mMutex);
+            mCompleted++;
+            checkFinished();
+        }
+    }
+
+    void streamFailed() {
+        boost::mutex::scoped_lock lock(mMutex);
+        mFailed++;
+        if (mConnected + mFailed == mNumStreams)
+            mConnectedTime = Timer::now();
+        checkFinished();
+    }
+
+    // mMutex must be held
+    void checkFinished() {
+        if (mCompleted + mFailed < mNumStreams) return;
+        mCompletedTime = Timer::now();
+        mContext->ioService->stop();
+    }
+
+    void serverStream(int err, Stream::Ptr strm) {
+        if (err != SST_IMPL_SUCCESS || !strm) return;
+        {
+            boost::mutex::scoped_lock lock(mMutex);
+            mServerStreams.push_back(strm);
+        }
+        strm->registerReadCallback(
+            std::tr1::bind(&StressRun::serverRead, this, strm.get(), std::tr1::placeholders::_1, std::tr1::placeholders::_2)
+        );
+    }
+
+    void serverRead(Stream* strm, uint8* data, int size) {
+        // Echo. strm stays alive since it's held in mServerStreams.
+        strm->write(data, size);
+    }
+
+    Context* mContext;
+    ConnectionManager* mSST;
+    boost::mutex mMutex;
+    uint32 mNumStreams;
+    uint32 mLaunched;
+    uint32 mConnected;
+    uint32 mFailed;
+    uint32 mCompleted;
+
+    Time mStartTime;
+    Time mConnectedTime;
+    Time mCompletedTime;
+
+    std::vector<Stream::Ptr> mClientStreams;
+    std::vector<uint32> mReceived;
+    std::vector<Stream::Ptr> mServerStreams;
+};
+
+} // namespace SSTStress
+
+SSTStressBenchmark::SSTStressBenchmark(const FinishedCallback& finished_cb, const String& param)
+        : Benchmark(finished_cb),
+          mForceStop(false),
+          mNumStreams(DEFAULT_STREAMS),
+          mIOService(NULL)
+{
+    if (!param.empty()) {
+        try {
+            mNumStreams = boost::lexical_cast<uint32>(param);
+        }
+        catch(boost::bad_lexical_cast&) {
+            SILOG(benchmark,error,"Invalid number of streams: " << param);
+        }
+    }
+}
+
+String SSTStressBenchmark::name() {
+    return "sst-stress";
+}
+
+void SSTStressBenchmark::start() {
+    using namespace SSTStress;
+
+    mForceStop = false;
+
+    Network::IOService* ios = new Network::IOService("SSTStressBenchmark");
+    Network::IOStrand* main_strand = ios->createStrand("SSTStressBenchmark Main");
+    Context* ctx = new Context("SSTStressBenchmark", ios, main_strand, NULL, Timer::now());
+    LoopbackNetwork* network = new LoopbackNetwork(ios);
+    ConnectionManager* sst = new ConnectionManager();
+    sst->createDatagramLayer(LoopbackNode(1), ctx, network);
+    sst->createDatagramLayer(LoopbackNode(2), ctx, network);
+
+    StressRun* run = new StressRun(ctx, sst, mNumStreams);
+    main_strand->post(std::tr1::bind(&StressRun::start, run), "StressRun::start");
+
+    {
+        boost::mutex::scoped_lock lock(mMutex);
+        mIOService = ios;
+    }
+    if (!mForceStop) {
+        // Connection timers keep the IOService busy, so it only stops when
+        // the run finishes or we're stopped.
+        Network::IOWork* work = new Network::IOWork(ios, "SSTStressBenchmark");
+        std::vector<Thread*> threads;
+        for(uint32 i = 1; i < NUM_THREADS; i++)
+            threads.push_back(new Thread("SSTStressBenchmark Worker", std::tr1::bind(&Network::IOService::runNoReturn, ios)));
+        ios->runNoReturn();
+        for(uint32 i = 0; i < threads.size(); i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+        delete work;
+    }
+    {
+        boost::mutex::scoped_lock lock(mMutex);
+        mIOService = NULL;
+    }
+
+    run->report(NUM_THREADS);
+
+    // Connections are still referenced by their pending timers, which are
+    // only released when the IOService is destroyed, so the connection
+    // manager and network have to outlive it.
+    run->clearStreams();
+    sst->stop();
+    delete run;
+    delete ctx;
+    delete main_strand;
+    delete ios;
+    delete sst;
+    delete network;
+
+    if (mForceStop)
+        return;
+
+    notifyFinished();
+}
+
+void SSTStressBenchmark::stop() {
+    mForceStop = true;
+
+    boost::mutex::scoped_lock lock(mMutex);
+    if (mIOService != NULL)
+        mIOService->stop();
+}
+
+} // namespace Sirikata
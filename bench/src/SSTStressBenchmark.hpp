@@ -0,0 +1,47 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SST_STRESS_BENCHMARK_HPP_
+#define _SIRIKATA_SST_STRESS_BENCHMARK_HPP_
+
+#include "Benchmark.hpp"
+#include <sirikata/core/network/IOService.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+/** SSTStressBenchmark opens a large number of SST streams at once over an
+ *  in-process loopback datagram layer and bounces a few pings over each of
+ *  them, with the IOService running on several threads. It measures how long
+ *  it takes to get every stream connected and every ping answered, which is
+ *  dominated by how well connections proceed in parallel. The parameter is
+ *  the number of streams, 10000 by default.
+ */
+class SSTStressBenchmark : public Benchmark {
+  public:
+    typedef std::tr1::function<void()> FinishedCallback;
+
+    static Benchmark* create(const FinishedCallback& finished_cb, const String& param) {
+        return new SSTStressBenchmark(finished_cb, param);
+    }
+
+    SSTStressBenchmark(const FinishedCallback& finished_cb, const String& param);
+
+    virtual String name();
+
+    virtual void start();
+    virtual void stop();
+
+  private:
+    bool mForceStop;
+    uint32 mNumStreams;
+
+    // Protects mIOService, which stop() uses from the runner's thread
+    boost::mutex mMutex;
+    Network::IOService* mIOService;
+}; // class SSTStressBenchmark
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SST_STRESS_BENCHMARK_HPP_
@@ -35,7 +35,15 @@
 #include "TimerSpeedBenchmark.hpp"
 #include "TimerJitterBenchmark.hpp"
 #include "TimerMonotonicityBenchmark.hpp"
+#include "LoggingBenchmark.hpp"
 #include "TCPSSTBenchmark.hpp"
+#include "ProxBulkLoadBenchmark.hpp"
+#include "RaytraceBenchmark.hpp"
+#include "SSTStressBenchmark.hpp"
+#include "ObjectMessageBenchmark.hpp"
+#include "ODPFlowSchedulerBenchmark.hpp"
+#include "RegionWeightBenchmark.hpp"
+#include "IOProfilerBenchmark.hpp"
 
 #include <sirikata/core/util/DynamicLibrary.hpp>
 
@@ -65,8 +73,16 @@ int main(int argc, char** argv) {
     ADD_BENCHMARK(timer-speed, TimerSpeedBenchmark::create);
     ADD_BENCHMARK(timer-jitter, TimerJitterBenchmark::create);
     ADD_BENCHMARK(timer-monotonicity, TimerMonotonicityBenchmark::create);
+    ADD_BENCHMARK(log-disabled, LoggingBenchmark::create);
+    ADD_BENCHMARK(prox-bulk-load, ProxBulkLoadBenchmark::create);
+    ADD_BENCHMARK(raytrace, RaytraceBenchmark::create);
+    ADD_BENCHMARK(object-message-echo, ObjectMessageBenchmark::create);
+    ADD_BENCHMARK(odp-flow-scheduling, ODPFlowSchedulerBenchmark::create);
+    ADD_BENCHMARK(region-weights, RegionWeightBenchmark::create);
+    ADD_BENCHMARK(io-profiler, IOProfilerBenchmark::create);
 
     ADD_BENCHMARK(ping, SSTBenchmark::create);
+    ADD_BENCHMARK(sst-stress, SSTStressBenchmark::create);
     BenchmarkRunner runner(factory, Duration::seconds(30.f));
 
 
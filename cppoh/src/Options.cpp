@@ -52,7 +52,7 @@ void InitCPPOHOptions() {
 #if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX
                 ",nvtt"
 #endif
-                ",common-filters,csvfactory,oh-sqlite,scripting-js,simplecamera"
+                ",common-filters,csvfactory,oh-sqlite,oh-cache-storage,scripting-js,simplecamera"
 #if SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_LINUX || SIRIKATA_PLATFORM == SIRIKATA_PLATFORM_MAC
                 ",oh-cassandra"
 #endif
@@ -85,6 +85,7 @@ void InitCPPOHOptions() {
 
         .addOption(new OptionValue(OPT_OBJECT_QUERY_PROCESSOR,"simple",OptionValueType<String>(),"Type of query processor to use for object queries."))
         .addOption(new OptionValue(OPT_OBJECT_QUERY_PROCESSOR_OPTS,"",OptionValueType<String>(),"Options to the query processor used for object queries."))
+        .addOption(new OptionValue(OPT_OH_SESSION_BATCHING,"false",OptionValueType<bool>(),"If true, session messages are sent to space servers in batches. The space servers must support batched session messages."))
 
         .addOption(new OptionValue(OPT_DEFAULT_SCRIPT_TYPE,"js",OptionValueType<String>(),"If a script is not specified, this type will be instantiated automatically at object creation. If left blank, no script will be started."))
         .addOption(new OptionValue(OPT_DEFAULT_SCRIPT_OPTIONS,"",OptionValueType<String>(),"If a script is not specified, these options will be passed to the default script type."))
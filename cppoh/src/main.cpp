@@ -149,6 +149,7 @@ int main (int argc, char** argv) {
     String timeseries_type = GetOptionValue<String>(OPT_TRACE_TIMESERIES);
     String timeseries_options = GetOptionValue<String>(OPT_TRACE_TIMESERIES_OPTIONS);
     Trace::TimeSeries* time_series = Trace::TimeSeriesFactory::getSingleton().getConstructor(timeseries_type)(ctx, timeseries_options);
+    ctx->metrics->setFlushInterval(GetOptionValue<Duration>(OPT_TRACE_METRICS_INTERVAL));
 
     String commander_type = GetOptionValue<String>(OPT_COMMAND_COMMANDER);
     String commander_options = GetOptionValue<String>(OPT_COMMAND_COMMANDER_OPTIONS);
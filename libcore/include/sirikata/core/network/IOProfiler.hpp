@@ -0,0 +1,81 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_NETWORK_IOPROFILER_HPP_
+#define _SIRIKATA_CORE_NETWORK_IOPROFILER_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/network/IODefs.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <sirikata/core/task/Time.hpp>
+#include <sirikata/core/command/Command.hpp>
+
+namespace Sirikata {
+namespace Network {
+
+/** IOProfiler samples the handlers posted to an event queue, i.e. an IOService
+ *  or IOStrand, recording how long they waited in the queue and how long they
+ *  took to run. Unlike SIRIKATA_TRACK_EVENT_QUEUES it is always compiled in
+ *  and can be turned on and off at runtime. When the sample rate is N, one in
+ *  every N handlers posted to each queue is timed; the rest only pay for an
+ *  atomic increment, and when sampling is off, for a single read.
+ *
+ *  Samples are aggregated by queue name and tag, and the most recent ones are
+ *  kept so they can be dumped as a timeline in the Chrome trace event format,
+ *  viewable with chrome://tracing.
+ */
+class SIRIKATA_EXPORT IOProfiler {
+public:
+    /** Create a profiler for a queue. queue_name must outlive the profiler,
+     *  and is normally the name of the IOService or IOStrand which owns it.
+     */
+    IOProfiler(const String& queue_name);
+
+    /** Returns true if the handler being posted should be sampled. */
+    bool sample() {
+        uint32 rate = sSampleRate.read();
+        if (rate == 0) return false;
+        return (mCounter++ % rate) == 0;
+    }
+
+    /** Wrap a handler so its queueing and execution time is recorded when it
+     *  runs. delay is the time the handler is expected to wait before running,
+     *  e.g. for timers, and is not counted as queueing time.
+     */
+    IOCallback wrap(const IOCallback& handler, const char* tag, const Duration& delay = Duration::zero()) const;
+
+    /** Set the sample rate, i.e. sample 1 in every rate handlers. 0 disables
+     *  sampling.
+     */
+    static void setSampleRate(uint32 rate);
+    static uint32 sampleRate();
+
+    /** Discard all samples collected so far. */
+    static void reset();
+
+    /** Fill in aggregate statistics for each queue and tag. */
+    static void fillCommandResultWithStats(Command::Result& res);
+    /** Fill in recent samples as Chrome trace events, i.e. res will hold a
+     *  traceEvents array and can be written out directly as a trace file.
+     */
+    static void fillCommandResultWithTrace(Command::Result& res);
+
+    // Command handlers. Setting the rate takes a rate parameter and also
+    // resets collected samples if reset is true. Dumping the trace also writes
+    // it to the file given by the optional file parameter.
+    static void commandSetSampleRate(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+    static void commandReportStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+    static void commandDumpTrace(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+
+private:
+    static AtomicValue<uint32> sSampleRate;
+
+    const String& mQueueName;
+    AtomicValue<uint32> mCounter;
+};
+
+} // namespace Network
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_NETWORK_IOPROFILER_HPP_
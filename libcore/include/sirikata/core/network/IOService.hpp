@@ -40,6 +40,7 @@
 #include <sirikata/core/trace/WindowedStats.hpp>
 #include <sirikata/core/task/Time.hpp>
 #include <sirikata/core/command/Command.hpp>
+#include <sirikata/core/network/IOProfiler.hpp>
 
 namespace Sirikata {
 namespace Network {
@@ -56,6 +57,7 @@ namespace Network {
 class SIRIKATA_EXPORT IOService : public Noncopyable {
     InternalIOService* mImpl;
     const String mName;
+    IOProfiler mProfiler;
 
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     typedef std::tr1::function<void(const boost::system::error_code& e)> IOCallbackWithError;
@@ -91,6 +93,12 @@ class SIRIKATA_EXPORT IOService : public Noncopyable {
 
     IOService(const IOService&); // Disabled
 
+    // Strands sample their own handlers, so they post through these to avoid
+    // sampling them twice
+    void dispatchUnprofiled(const IOCallback& handler, const char* tag, const char* tagStat);
+    void postUnprofiled(const IOCallback& handler, const char* tag, const char* tagStat);
+    void postUnprofiled(const Duration& waitFor, const IOCallback& handler, const char* tag, const char* tagStat);
+
     // For construction
     friend class IOServiceFactory;
     // For callbacks to track their lifetimes
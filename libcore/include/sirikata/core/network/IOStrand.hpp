@@ -38,6 +38,7 @@
 #include <sirikata/core/util/Noncopyable.hpp>
 #include <sirikata/core/trace/WindowedStats.hpp>
 #include <sirikata/core/task/Time.hpp>
+#include <sirikata/core/network/IOProfiler.hpp>
 #include <boost/thread.hpp>
 
 namespace Sirikata {
@@ -64,6 +65,7 @@ class SIRIKATA_EXPORT IOStrand : public Noncopyable {
     IOService& mService;
     InternalIOStrand* mImpl;
     const String mName;
+    IOProfiler mProfiler;
 
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     // Track all strands that have been allocated. This needs to be
@@ -88,6 +90,12 @@ class SIRIKATA_EXPORT IOStrand : public Noncopyable {
     /** Construct an IOStrand associated with the given IOService. */
     IOStrand(IOService& io, const String& name);
 
+    // The work of dispatch and post, once the profiler has decided whether
+    // to sample the handler
+    void dispatchUnprofiled(const IOCallback& handler, const char* tag);
+    void postUnprofiled(const IOCallback& handler, const char* tag);
+    void postUnprofiled(const Duration& waitFor, const IOCallback& handler, const char* tag);
+
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     void decrementTimerCount(const Time& start, const Duration& timer_duration, const IOCallback& cb, const char* tag);
     void decrementCount(const Time& start, const IOCallback& cb, const char* tag);
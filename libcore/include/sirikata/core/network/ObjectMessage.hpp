@@ -49,19 +49,51 @@ typedef uint32 ObjectMessagePort;
 #define OBJECT_PORT_PROXIMITY     2
 #define OBJECT_PORT_LOCATION      3
 #define OBJECT_PORT_TIMESYNC      4
+#define OBJECT_PORT_SESSION_BATCH 5
 #define OBJECT_SPACE_PORT         253
 #define OBJECT_PORT_PING          254
 
 #define OBJECT_PORT_SYSTEM_RESERVED_MAX 1024
 #define OBJECT_PORT_SYSTEM_MAX 0xFFFFFFFF
 
+// Limit on the number of session messages sent in one
+// OBJECT_PORT_SESSION_BATCH message, keeping each message a reasonable size
+#define MAX_SESSION_BATCH_ENTRIES 512
+
 #define MESSAGE_ID_SERVER_SHIFT 52
 #define MESSAGE_ID_SERVER_BITS 0xFFF0000000000000LL
 
+/** Get an ObjectMessage, reusing one released by this thread if possible.
+ *  Reused messages keep the contents and buffers of their previous use, so
+ *  the caller must either set every field or parse into the message. Messages
+ *  from here may still be deleted normally.
+ */
+SIRIKATA_FUNCTION_EXPORT Sirikata::Protocol::Object::ObjectMessage* acquireObjectMessage();
+/** Release an ObjectMessage for reuse by this thread, or delete it if this
+ *  thread already has enough cached or its payload buffer is large. The
+ *  payload is cleared. Any ObjectMessage allocated with new may be released
+ *  this way.
+ */
+SIRIKATA_FUNCTION_EXPORT void releaseObjectMessage(Sirikata::Protocol::Object::ObjectMessage* msg);
+/// The number of ObjectMessages acquireObjectMessage has had to allocate
+SIRIKATA_FUNCTION_EXPORT uint64 objectMessageAllocations();
+
 SIRIKATA_FUNCTION_EXPORT Sirikata::Protocol::Object::ObjectMessage* createObjectMessage(ServerID source_server, const SpaceObjectReference& sporef_src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload);
 
 SIRIKATA_FUNCTION_EXPORT Sirikata::Protocol::Object::ObjectMessage* createObjectMessage(ServerID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload);
 
+/// An object and a serialized Sirikata::Protocol::Session::Container for it
+typedef std::pair<UUID, std::string> SessionBatchEntry;
+typedef std::vector<SessionBatchEntry> SessionBatchEntryList;
+/** Encode session messages for many objects as the payload of a single
+ *  OBJECT_PORT_SESSION_BATCH message.
+ */
+SIRIKATA_FUNCTION_EXPORT std::string serializeSessionBatch(const SessionBatchEntryList& entries);
+/** Decode the payload of an OBJECT_PORT_SESSION_BATCH message, appending its
+ *  entries to entries_out. Returns false if the payload couldn't be parsed.
+ */
+SIRIKATA_FUNCTION_EXPORT bool parseSessionBatch(const std::string& payload, SessionBatchEntryList* entries_out);
+
 
 // Wrapper class for Protocol::Object::Message which provides it some missing methods
 // that are useful, e.g. size().
@@ -85,6 +117,23 @@ SIRIKATA_FUNCTION_EXPORT void createObjectHostMessage(ObjectHostID source_server
 
 SIRIKATA_FUNCTION_EXPORT void createObjectHostMessage(ObjectHostID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload, ObjectMessage* result);
 
+/** Fill in every field of result except the payload, for use with
+ *  serializeObjectMessageHeader.
+ */
+SIRIKATA_FUNCTION_EXPORT void createObjectHostMessageHeader(ObjectHostID source_server, const SpaceObjectReference& sporef_src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, ObjectMessage* result);
+
+SIRIKATA_FUNCTION_EXPORT void createObjectHostMessageHeader(ObjectHostID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, ObjectMessage* result);
+
+/** Serialize msg, which must not have a payload set, followed by the framing
+ *  for a payload of payload_size bytes. Sending the result immediately followed
+ *  by the payload is equivalent to sending msg serialized with the payload set,
+ *  but the payload never has to be copied into the message or the serialized
+ *  buffer, e.g. with Network::Stream's two part send. Returns false if the
+ *  header couldn't be serialized, in which case the caller should fall back to
+ *  setting the payload and serializing the whole message.
+ */
+SIRIKATA_FUNCTION_EXPORT bool serializeObjectMessageHeader(const Sirikata::Protocol::Object::ObjectMessage& msg, uint32 payload_size, std::string* result);
+
 
 } // namespace Sirikata
 
@@ -0,0 +1,391 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_NETWORK_SST_CONGESTION_HPP_
+#define _SIRIKATA_CORE_NETWORK_SST_CONGESTION_HPP_
+
+// NOTE: Like SSTImpl.hpp, this is header only. It doesn't depend on the SST
+// protocol headers so the pieces can be tested and simulated in isolation.
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/Time.hpp>
+
+namespace Sirikata {
+namespace SST {
+
+/** Estimates the round trip time of a channel and derives a retransmission
+ *  timeout from it, following RFC 6298: the RTO tracks the smoothed RTT plus
+ *  four times its mean deviation, so it adapts to jittery links instead of
+ *  sitting at a fixed multiple of the average.
+ */
+class RTTEstimator {
+public:
+    static const int64 INITIAL_RTO_MICROSECONDS = 2000000;
+    static const int64 MIN_RTO_MICROSECONDS = 200000;
+    static const int64 MAX_RTO_MICROSECONDS = 20000000;
+
+    RTTEstimator()
+     : mSRTT(0),
+       mRTTVar(0),
+       mRTO(INITIAL_RTO_MICROSECONDS),
+       mHasSample(false)
+    {}
+
+    void sample(int64 rtt) {
+        if (rtt < 0) return;
+
+        if (!mHasSample) {
+            mSRTT = rtt;
+            mRTTVar = rtt / 2;
+            mHasSample = true;
+        }
+        else {
+            int64 err = mSRTT - rtt;
+            if (err < 0) err = -err;
+            mRTTVar = (3 * mRTTVar + err) / 4;
+            mSRTT = (7 * mSRTT + rtt) / 8;
+        }
+        // The variance term is floored at the clock granularity (1ms) so a
+        // perfectly steady link doesn't get an RTO equal to its RTT.
+        mRTO = clamp(mSRTT + std::max((int64)1000, 4 * mRTTVar));
+    }
+
+    /** Exponential backoff after a retransmission timeout. The next valid
+     *  sample resets the RTO to the estimate.
+     */
+    void backoff() {
+        mRTO = clamp(mRTO * 2);
+    }
+
+    int64 rto() const { return mRTO; }
+    int64 srtt() const { return mSRTT; }
+    bool hasSample() const { return mHasSample; }
+
+private:
+    static int64 clamp(int64 rto) {
+        if (rto < MIN_RTO_MICROSECONDS) return MIN_RTO_MICROSECONDS;
+        if (rto > MAX_RTO_MICROSECONDS) return MAX_RTO_MICROSECONDS;
+        return rto;
+    }
+
+    int64 mSRTT;
+    int64 mRTTVar;
+    int64 mRTO;
+    bool mHasSample;
+};
+
+/** Controls how many segments a channel may have outstanding. Subclasses only
+ *  decide how the window grows during congestion avoidance and how it is cut
+ *  on loss; slow start, loss recovery bookkeeping and timeouts are shared.
+ *
+ *  A loss only reduces the window once per round trip: losses of segments sent
+ *  before the last reduction are part of the same congestion event.
+ */
+class CongestionController {
+public:
+    static const uint32 INITIAL_WINDOW = 2;
+    static const uint32 MAX_WINDOW = 65535;
+
+    CongestionController()
+     : mCwnd(INITIAL_WINDOW),
+       mSSThresh(MAX_WINDOW),
+       mRecoveryPoint(0)
+    {}
+    virtual ~CongestionController() {}
+
+    /** Create a controller by name, "newreno" or "cubic". Returns NULL for
+     *  unknown algorithms.
+     */
+    static CongestionController* create(const String& algorithm);
+
+    virtual const char* name() const = 0;
+
+    /// Number of segments which may be outstanding
+    uint32 window() const {
+        return std::max((uint32)1, (uint32)mCwnd);
+    }
+    bool inSlowStart() const {
+        return mCwnd < mSSThresh;
+    }
+    float64 cwnd() const { return mCwnd; }
+    float64 ssthresh() const { return mSSThresh; }
+
+    /// Called when count previously outstanding segments are acknowledged
+    void onAck(uint32 count, const Time& now) {
+        if (count == 0) return;
+        if (inSlowStart())
+            mCwnd = std::min(mCwnd + count, mSSThresh);
+        else
+            congestionAvoidance(count, now);
+        mCwnd = std::min(mCwnd, (float64)MAX_WINDOW);
+    }
+
+    /** Called when segment seqno has been inferred lost because later
+     *  segments were acknowledged. highest_sent is the largest sequence number
+     *  sent so far.
+     */
+    void onLoss(uint64 seqno, uint64 highest_sent, const Time& now) {
+        if (seqno <= mRecoveryPoint) return;
+        mRecoveryPoint = highest_sent;
+        reduce(now);
+        mCwnd = std::max(mCwnd, 1.0);
+    }
+
+    /// Called when the retransmission timer expires with segments outstanding
+    void onTimeout(uint64 highest_sent, const Time& now) {
+        mRecoveryPoint = highest_sent;
+        reduce(now);
+        mCwnd = 1;
+    }
+
+protected:
+    /// Grow the window for count acknowledged segments beyond ssthresh
+    virtual void congestionAvoidance(uint32 count, const Time& now) = 0;
+    /// Set mSSThresh and mCwnd in response to a congestion event
+    virtual void reduce(const Time& now) = 0;
+
+    float64 mCwnd;
+    float64 mSSThresh;
+    uint64 mRecoveryPoint;
+};
+
+/** Classic additive increase, multiplicative decrease: the window grows by
+ *  one segment per round trip and is halved on loss.
+ */
+class NewRenoCongestionController : public CongestionController {
+public:
+    virtual const char* name() const { return "newreno"; }
+
+protected:
+    virtual void congestionAvoidance(uint32 count, const Time& now) {
+        mCwnd += (float64)count / mCwnd;
+    }
+
+    virtual void reduce(const Time& now) {
+        mSSThresh = std::max(mCwnd / 2, 2.0);
+        mCwnd = mSSThresh;
+    }
+};
+
+/** CUBIC (RFC 8312). After a loss the window follows a cubic function of the
+ *  time since the loss, quickly returning to the window where the loss
+ *  happened and then probing beyond it. Growth is independent of the RTT, so
+ *  long-latency links recover much faster than with NewReno, while the Reno
+ *  estimate keeps it at least as aggressive as NewReno on short ones.
+ */
+class CubicCongestionController : public CongestionController {
+public:
+    CubicCongestionController()
+     : mWMax(0),
+       mK(0),
+       mOrigin(0),
+       mRenoEstimate(0),
+       mEpochStart(Time::null())
+    {}
+
+    virtual const char* name() const { return "cubic"; }
+
+protected:
+    static float64 C() { return 0.4; }
+    static float64 Beta() { return 0.7; }
+
+    virtual void congestionAvoidance(uint32 count, const Time& now) {
+        if (mEpochStart == Time::null()) {
+            mEpochStart = now;
+            if (mCwnd < mWMax) {
+                mK = std::pow((mWMax - mCwnd) / C(), 1.0 / 3.0);
+                mOrigin = mWMax;
+            }
+            else {
+                mK = 0;
+                mOrigin = mCwnd;
+            }
+            mRenoEstimate = mCwnd;
+        }
+
+        float64 t = (now - mEpochStart).toSeconds() - mK;
+        float64 target = mOrigin + C() * t * t * t;
+        if (target > mCwnd)
+            mCwnd += count * std::min(target - mCwnd, mCwnd) / mCwnd;
+        else
+            mCwnd += count * 0.01 / mCwnd;
+
+        // TCP friendly region: never grow slower than NewReno would
+        mRenoEstimate += count * (3 * (1 - Beta()) / (1 + Beta())) / mRenoEstimate;
+        if (mRenoEstimate > mCwnd)
+            mCwnd = mRenoEstimate;
+    }
+
+    virtual void reduce(const Time& now) {
+        mEpochStart = Time::null();
+        // Fast convergence: release bandwidth for new flows if this loss
+        // happened below the previous maximum.
+        if (mCwnd < mWMax)
+            mWMax = mCwnd * (1 + Beta()) / 2;
+        else
+            mWMax = mCwnd;
+        mSSThresh = std::max(mCwnd * Beta(), 2.0);
+        mCwnd = mSSThresh;
+    }
+
+    float64 mWMax;
+    float64 mK;
+    float64 mOrigin;
+    float64 mRenoEstimate;
+    Time mEpochStart;
+};
+
+inline CongestionController* CongestionController::create(const String& algorithm) {
+    if (algorithm == "newreno")
+        return new NewRenoCongestionController();
+    else if (algorithm == "cubic")
+        return new CubicCongestionController();
+    return NULL;
+}
+
+/** An outstanding segment is inferred lost once this many segments sent after
+ *  it have been acked.
+ */
+const uint64 LOSS_DETECTION_THRESHOLD = 3;
+
+/** Tracks outstanding segments by sequence number. Acks cover a run of
+ *  sequence numbers ending at the acked one, so a receiver reports everything
+ *  it has received contiguously rather than just the last packet, and a lost
+ *  ack doesn't leave segments outstanding. Losses are inferred from later
+ *  acks, so only the segments that are actually missing need to be
+ *  retransmitted.
+ */
+template<typename SegmentType>
+class SegmentScoreboard {
+public:
+    typedef std::vector< std::pair<uint64, SegmentType> > SegmentList;
+
+    SegmentScoreboard()
+     : mHighestSent(0),
+       mHighestAcked(0)
+    {}
+
+    /// Record that a segment was sent. Resending a seqno replaces it.
+    void sent(uint64 seqno, const SegmentType& segment, const Time& t) {
+        mOutstanding[seqno] = Entry(segment, t);
+        mHighestSent = std::max(mHighestSent, seqno);
+    }
+
+    /** Apply an ack for the count segments ending at seqno. Returns the number
+     *  of outstanding segments it acknowledged and, if seqno itself was
+     *  outstanding, fills rtt_out with its round trip time in microseconds.
+     *  Otherwise rtt_out is set to -1.
+     */
+    uint32 acked(uint64 seqno, uint32 count, const Time& now, int64* rtt_out) {
+        *rtt_out = -1;
+        if (count == 0) return 0;
+
+        uint64 first = (seqno >= count) ? (seqno - count + 1) : 0;
+        typename EntryMap::iterator it = mOutstanding.lower_bound(first);
+        uint32 nacked = 0;
+        while(it != mOutstanding.end() && it->first <= seqno) {
+            if (it->first == seqno)
+                *rtt_out = (now - it->second.transmitTime).toMicroseconds();
+            mOutstanding.erase(it++);
+            nacked++;
+        }
+        if (nacked > 0)
+            mHighestAcked = std::max(mHighestAcked, seqno);
+        return nacked;
+    }
+
+    /** Remove outstanding segments which have been passed by enough acks to
+     *  be considered lost, appending them to lost_out in sequence order.
+     */
+    void detectLosses(SegmentList* lost_out) {
+        typename EntryMap::iterator it = mOutstanding.begin();
+        while(it != mOutstanding.end() && it->first + LOSS_DETECTION_THRESHOLD <= mHighestAcked) {
+            lost_out->push_back(std::make_pair(it->first, it->second.segment));
+            mOutstanding.erase(it++);
+        }
+    }
+
+    /// Remove all outstanding segments, appending them to lost_out
+    void drain(SegmentList* lost_out) {
+        for(typename EntryMap::iterator it = mOutstanding.begin(); it != mOutstanding.end(); it++)
+            lost_out->push_back(std::make_pair(it->first, it->second.segment));
+        mOutstanding.clear();
+    }
+
+    /** Transmit time of the oldest outstanding segment. Segments are sent in
+     *  sequence number order, so this is the lowest outstanding one. Must not
+     *  be empty.
+     */
+    Time oldestTransmitTime() const {
+        return mOutstanding.begin()->second.transmitTime;
+    }
+
+    uint64 highestSent() const { return mHighestSent; }
+    std::size_t size() const { return mOutstanding.size(); }
+    bool empty() const { return mOutstanding.empty(); }
+    void clear() { mOutstanding.clear(); }
+
+private:
+    struct Entry {
+        Entry()
+         : transmitTime(Time::null())
+        {}
+        Entry(const SegmentType& seg, const Time& t)
+         : segment(seg), transmitTime(t)
+        {}
+
+        SegmentType segment;
+        Time transmitTime;
+    };
+    typedef std::map<uint64, Entry> EntryMap;
+
+    EntryMap mOutstanding;
+    uint64 mHighestSent;
+    uint64 mHighestAcked;
+};
+
+/** Tracks the run of consecutive sequence numbers received, ending at the
+ *  last one, which the next ack covers. A segment the receiver drops must
+ *  reject() the run, otherwise an ack for a later segment would report it
+ *  delivered and it would never be resent.
+ */
+class AckRun {
+public:
+    AckRun(uint64 last, uint32 max_length)
+     : mLast(last),
+       mLength(1),
+       mMaxLength(max_length)
+    {}
+
+    void received(uint64 seqno) {
+        if (seqno == mLast + 1)
+            mLength++;
+        else
+            mLength = 1;
+        mLast = seqno;
+    }
+
+    /// The last segment received wasn't accepted, restart the run after it
+    void reject() {
+        mLength = 0;
+    }
+
+    /// The last sequence number received
+    uint64 last() const { return mLast; }
+    /** Number of segments, ending at last(), the next ack covers. This is 0
+     *  after reject(). Peers treat an ack_count of 0 as 1, which only
+     *  acknowledges last() for the channel, not for any stream.
+     */
+    uint32 count() const { return std::min(mLength, mMaxLength); }
+
+private:
+    uint64 mLast;
+    uint32 mLength;
+    uint32 mMaxLength;
+};
+
+} // namespace SST
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_NETWORK_SST_CONGESTION_HPP_
@@ -42,6 +42,9 @@
 
 #include <sirikata/core/network/Message.hpp>
 #include <sirikata/core/network/ObjectMessage.hpp>
+#include <sirikata/core/network/SSTCongestion.hpp>
+#include <sirikata/core/util/ConcurrentHashMap.hpp>
+#include <sirikata/core/options/CommonOptions.hpp>
 #include "Protocol_SSTHeader.pbj.hpp"
 
 #include <boost/lexical_cast.hpp>
@@ -74,27 +77,20 @@ public:
     return this->port < ep.port ;
   }
 
+  bool operator==(const EndPoint &ep) const {
+    return endPoint == ep.endPoint && port == ep.port;
+  }
+
     std::string toString() const {
         return endPoint.toString() + boost::lexical_cast<std::string>(port);
     }
-};
-
-class Mutex {
-public:
-
-  Mutex() {
-
-  }
-
-  Mutex(const Mutex& mutex) {  }
-
-  boost::mutex& getMutex() {
-    return mMutex;
-  }
-
-private:
-  boost::mutex mMutex;
 
+    class Hasher {
+    public:
+        size_t operator()(const EndPoint& ep) const {
+            return typename EndObjectType::Hasher()(ep.endPoint) ^ std::tr1::hash<uint32>()(ep.port);
+        }
+    };
 };
 
 template <class EndPointType>
@@ -155,44 +151,45 @@ public:
 
     BaseDatagramLayerPtr getDatagramLayer(EndPointType& endPoint)
     {
-        if (sDatagramLayerMap.find(endPoint) != sDatagramLayerMap.end()) {
-            return sDatagramLayerMap[endPoint];
-        }
-
-        return BaseDatagramLayerPtr();
+        BaseDatagramLayerPtr result;
+        sDatagramLayerMap.get(endPoint, &result);
+        return result;
     }
 
     void addDatagramLayer(EndPointType& endPoint, BaseDatagramLayerPtr datagramLayer)
     {
-        sDatagramLayerMap[endPoint] = datagramLayer;
+        sDatagramLayerMap.set(endPoint, datagramLayer);
     }
 
     void removeDatagramLayer(EndPointType& endPoint, bool warn = false)
     {
-        typename std::map<EndPointType, BaseDatagramLayerPtr >::iterator wherei = sDatagramLayerMap.find(endPoint);
-        if (wherei != sDatagramLayerMap.end()) {
-            sDatagramLayerMap.erase(wherei);
-        } else if (warn) {
+        if (!sDatagramLayerMap.erase(endPoint) && warn) {
             SILOG(sst,error,"FATAL: Invalidating BaseDatagramLayer that's invalid");
         }
     }
 
 private:
-    std::map<EndPointType, BaseDatagramLayerPtr > sDatagramLayerMap;
+    ConcurrentHashMap<EndPointType, BaseDatagramLayerPtr, typename EndPointType::Hasher> sDatagramLayerMap;
 
 public:
-    typedef std::map<EndPoint<EndPointType>, StreamReturnCallbackFunction> StreamReturnCallbackMap;
+    // These are shared by every connection in the process and are accessed
+    // from each connection's strand, so they are concurrent maps rather than
+    // maps protected by a single lock. Compound operations use insert() and
+    // erase() so the check and the update are atomic.
+    typedef ConcurrentHashMap<EndPoint<EndPointType>, StreamReturnCallbackFunction, typename EndPoint<EndPointType>::Hasher> StreamReturnCallbackMap;
     StreamReturnCallbackMap mStreamReturnCallbackMap;
 
-    typedef std::map<EndPoint<EndPointType>, std::tr1::shared_ptr<Connection<EndPointType> > >  ConnectionMap;
+    typedef ConcurrentHashMap<EndPoint<EndPointType>, std::tr1::shared_ptr<Connection<EndPointType> >, typename EndPoint<EndPointType>::Hasher>  ConnectionMap;
     ConnectionMap sConnectionMap;
 
-    typedef std::map<EndPoint<EndPointType>, ConnectionReturnCallbackFunction>  ConnectionReturnCallbackMap;
+    typedef ConcurrentHashMap<EndPoint<EndPointType>, ConnectionReturnCallbackFunction, typename EndPoint<EndPointType>::Hasher>  ConnectionReturnCallbackMap;
     ConnectionReturnCallbackMap sConnectionReturnCallbackMap;
 
     StreamReturnCallbackMap  sListeningConnectionsCallbackMap;
-    Mutex sStaticMembersLock;
 
+    // Serializes closing connections, so checking a connection's state and
+    // removing it from sConnectionMap happen together.
+    boost::mutex sStaticMembersLock;
 };
 
 // This is just a template definition. The real implementation of BaseDatagramLayer
@@ -340,9 +337,9 @@ private:
   friend class ConnectionManager<EndPointType>;
   friend class BaseDatagramLayer<EndPointType>;
 
-  typedef std::map<EndPoint<EndPointType>, std::tr1::shared_ptr<Connection> >  ConnectionMap;
-  typedef std::map<EndPoint<EndPointType>, ConnectionReturnCallbackFunction>  ConnectionReturnCallbackMap;
-  typedef std::map<EndPoint<EndPointType>, StreamReturnCallbackFunction> StreamReturnCallbackMap;
+  typedef typename ConnectionVariables<EndPointType>::ConnectionMap ConnectionMap;
+  typedef typename ConnectionVariables<EndPointType>::ConnectionReturnCallbackMap ConnectionReturnCallbackMap;
+  typedef typename ConnectionVariables<EndPointType>::StreamReturnCallbackMap StreamReturnCallbackMap;
 
   EndPoint<EndPointType> mLocalEndPoint;
   EndPoint<EndPointType> mRemoteEndPoint;
@@ -355,7 +352,8 @@ private:
   uint32 mLocalChannelID;
 
   uint64 mTransmitSequenceNumber;
-  uint64 mLastReceivedSequenceNumber;   //the last transmit sequence number received from the other side
+  //the last transmit sequence number received from the other side and the run ending at it
+  SST::AckRun mReceivedRun;
 
   typedef std::map<LSID, std::tr1::shared_ptr< Stream<EndPointType> > > LSIDStreamMap;
   std::map<LSID, std::tr1::shared_ptr< Stream<EndPointType> > > mOutgoingSubstreamMap;
@@ -363,6 +361,11 @@ private:
 
   std::map<uint32, StreamReturnCallbackFunction> mListeningStreamsCallbackMap;
   std::map<uint32, std::vector<ReadDatagramCallback> > mReadDatagramCallbacks;
+  // Streams and callbacks are added by the application from its own strand
+  // while mStrand looks them up, so mStreamsMutex guards the substream and
+  // callback maps and mNumStreams. It is never held while calling into a
+  // stream.
+  boost::mutex mStreamsMutex;
   typedef std::vector<std::string> PartialPayloadList;
   typedef std::map<LSID, PartialPayloadList> PartialPayloadMap;
   PartialPayloadMap mPartialReadDatagrams;
@@ -370,19 +373,24 @@ private:
   uint32 mNumStreams;
 
   std::deque< std::tr1::shared_ptr<ChannelSegment> > mQueuedSegments;
-  std::deque< std::tr1::shared_ptr<ChannelSegment> > mOutstandingSegments;
+  typedef SegmentScoreboard< std::tr1::shared_ptr<ChannelSegment> > OutstandingSegments;
+  OutstandingSegments mOutstandingSegments;
   boost::mutex mOutstandingSegmentsMutex;
 
-  uint16 mCwnd;
-  int64 mRTOMicroseconds; // RTO in microseconds
-  bool mFirstRTO;
+  CongestionController* mCongestionController;
+  RTTEstimator mRTT;
+
+  // All of this connection's processing, including its streams' timers, runs
+  // on its own strand so connections don't serialize behind each other on the
+  // context's main strand. Application callbacks are invoked directly from
+  // this strand, as packets are processed.
+  Network::IOStrandPtr mStrand;
 
   boost::mutex mQueueMutex;
 
   uint16 MAX_DATAGRAM_SIZE;
   uint16 MAX_PAYLOAD_SIZE;
   uint32 MAX_QUEUED_SEGMENTS;
-  float  CC_ALPHA;
   Time mLastTransmitTime;
 
   std::tr1::weak_ptr<Connection<EndPointType> > mWeakThis;
@@ -402,20 +410,33 @@ private:
       mSSTConnVars(sstConnVars),
       mState(CONNECTION_DISCONNECTED),
       mRemoteChannelID(0), mLocalChannelID(1), mTransmitSequenceNumber(1),
-      mLastReceivedSequenceNumber(1),
-      mNumStreams(0), mCwnd(1), mRTOMicroseconds(2000000),
-      mFirstRTO(true),  MAX_DATAGRAM_SIZE(1000), MAX_PAYLOAD_SIZE(1300),
+      mReceivedRun(1, 255),
+      mNumStreams(0), mCongestionController(NULL),
+      MAX_DATAGRAM_SIZE(1000), MAX_PAYLOAD_SIZE(1300),
       MAX_QUEUED_SEGMENTS(3000),
-      CC_ALPHA(0.8), mLastTransmitTime(Time::null()),
+      mLastTransmitTime(Time::null()),
       mNumInitialRetransmissionAttempts(0),
       mInSendingMode(true)
   {
       mDatagramLayer = sstConnVars->getDatagramLayer(localEndPoint.endPoint);
+      mStrand = Network::IOStrandPtr(
+          getContext()->ioService->createStrand("SST Connection " + localEndPoint.toString())
+      );
+
+      String cc_algorithm = "cubic";
+      OptionValue* cc_opt = GetOption(OPT_SST_CONGESTION_CONTROL);
+      if (cc_opt != NULL && !cc_opt->get()->empty())
+          cc_algorithm = cc_opt->unsafeAs<String>();
+      mCongestionController = CongestionController::create(cc_algorithm);
+      if (mCongestionController == NULL) {
+          SST_LOG(warn, "Unknown congestion control algorithm " << cc_algorithm << ", using cubic");
+          mCongestionController = CongestionController::create("cubic");
+      }
 
       mDatagramLayer->listenOn(
           localEndPoint,
           std::tr1::bind(
-              &Connection::receiveMessage, this,
+              &Connection::receiveDatagram, this,
               std::tr1::placeholders::_1,
               std::tr1::placeholders::_2
           )
@@ -423,13 +444,18 @@ private:
 
   }
 
+  bool hasStreams() {
+    boost::mutex::scoped_lock lock(mStreamsMutex);
+    return !(mOutgoingSubstreamMap.empty() && mIncomingSubstreamMap.empty());
+  }
+
   void checkIfAlive(std::tr1::shared_ptr<Connection<EndPointType> > conn) {
-    if (mOutgoingSubstreamMap.size() == 0 && mIncomingSubstreamMap.size() == 0) {
+    if (!hasStreams()) {
       close(true);
       return;
     }
 
-    getContext()->mainStrand->post(Duration::seconds(300),
+    mStrand->post(Duration::seconds(300),
         std::tr1::bind(&Connection<EndPointType>::checkIfAlive, this, conn),
         "Connection<EndPointType>::checkIfAlive"
     );
@@ -490,14 +516,16 @@ private:
     if (mInSendingMode) {
       boost::mutex::scoped_lock lock(mQueueMutex);
 
-      for (int i = 0; (!mQueuedSegments.empty()) && mOutstandingSegments.size() <= mCwnd; i++) {
+      while (!mQueuedSegments.empty() && mOutstandingSegments.size() < mCongestionController->window()) {
 	  std::tr1::shared_ptr<ChannelSegment> segment = mQueuedSegments.front();
 
+	  // Piggyback the most recent ack rather than the one current when the
+	  // segment was queued.
 	  Sirikata::Protocol::SST::SSTChannelHeader sstMsg;
 	  sstMsg.set_channel_id( mRemoteChannelID );
 	  sstMsg.set_transmit_sequence_number(segment->mChannelSequenceNumber);
-	  sstMsg.set_ack_count(1);
-	  sstMsg.set_ack_sequence_number(segment->mAckSequenceNumber);
+	  sstMsg.set_ack_count(ackCount());
+	  sstMsg.set_ack_sequence_number(mReceivedRun.last());
 
 	  sstMsg.set_payload(segment->mBuffer, segment->mBufferLength);
 
@@ -513,18 +541,27 @@ private:
           }
 
 	  segment->mTransmitTime = curTime;
-	  mOutstandingSegments.push_back(segment);
+	  mOutstandingSegments.sent(segment->mChannelSequenceNumber, segment, curTime);
 
 	  mLastTransmitTime = curTime;
 
-          if (mState != CONNECTION_PENDING_CONNECT || mNumInitialRetransmissionAttempts > 5) {
-            mInSendingMode = false;
-            mQueuedSegments.pop_front();
+          // Connect requests are retried by the timer below, once per round
+          if (mState == CONNECTION_PENDING_CONNECT && mNumInitialRetransmissionAttempts <= 5) {
+            break;
           }
+
+          mInSendingMode = false;
+          mQueuedSegments.pop_front();
+      }
+
+      // If the window is full, wait for an ack or a timeout before trying
+      // again.
+      if (!mQueuedSegments.empty() && mOutstandingSegments.size() >= mCongestionController->window()) {
+        mInSendingMode = false;
       }
 
       if (!mInSendingMode || mState == CONNECTION_PENDING_CONNECT) {
-        getContext()->mainStrand->post(Duration::microseconds(mRTOMicroseconds*pow(2.0,mNumInitialRetransmissionAttempts)),
+        mStrand->post(Duration::microseconds(mRTT.rto()*pow(2.0,mNumInitialRetransmissionAttempts)),
             std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, mWeakThis.lock()),
             "Connection<EndPointType>::serviceConnectionNoReturn"
         );
@@ -542,19 +579,29 @@ private:
         return false; //the connection was unable to contact the other endpoint.
       }
 
-      if (mOutstandingSegments.size() > 0) {
-        mCwnd /= 2;
-
-        if (mCwnd < 1) {
-          mCwnd = 1;
+      if (!mOutstandingSegments.empty()) {
+        // Acks may have arrived since this timer was set, so only time out if
+        // the oldest outstanding segment has waited a full RTO.
+        Duration waited = curTime - mOutstandingSegments.oldestTransmitTime();
+        Duration rto = Duration::microseconds(mRTT.rto());
+        if (waited < rto) {
+          mStrand->post(rto - waited,
+              std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, mWeakThis.lock()),
+              "Connection<EndPointType>::serviceConnectionNoReturn"
+          );
+          return true;
         }
 
+        // Segments aren't retransmitted at this level; streams resend their
+        // own unacknowledged data.
+        mCongestionController->onTimeout(mOutstandingSegments.highestSent(), curTime);
+        mRTT.backoff();
         mOutstandingSegments.clear();
       }
 
       mInSendingMode = true;
 
-      getContext()->mainStrand->post(Duration::microseconds(1),
+      mStrand->post(Duration::microseconds(1),
           std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, mWeakThis.lock()),
           "Connection<EndPointType>::serviceConnectionNoReturn"
       );
@@ -612,10 +659,10 @@ private:
 			       StreamReturnCallbackFunction scb)
 
   {
-    boost::mutex::scoped_lock lock(sstConnVars->sStaticMembersLock.getMutex());
-
+    // Reserve the endpoint before constructing the connection, since the
+    // constructor starts listening on it.
     ConnectionMap& connectionMap = sstConnVars->sConnectionMap;
-    if (connectionMap.find(localEndPoint) != connectionMap.end()) {
+    if (!connectionMap.insert(localEndPoint, ConnectionPtr())) {
       SST_LOG(warn, "sConnectionMap.find failed for " << localEndPoint.endPoint.toString() << "\n");
 
       return false;
@@ -623,16 +670,16 @@ private:
 
     uint32 availableChannel = sstConnVars->getAvailableChannel(localEndPoint.endPoint);
 
-    if (availableChannel == 0)
+    if (availableChannel == 0) {
+      connectionMap.erase(localEndPoint);
       return false;
+    }
 
     std::tr1::shared_ptr<Connection>  conn =  std::tr1::shared_ptr<Connection> (
                        new Connection(sstConnVars, localEndPoint, remoteEndPoint));
 
-    connectionMap[localEndPoint] = conn;
-    sstConnVars->sConnectionReturnCallbackMap[localEndPoint] = cb;
-
-    lock.unlock();
+    sstConnVars->sConnectionReturnCallbackMap.set(localEndPoint, cb);
+    connectionMap.set(localEndPoint, conn);
 
     conn->setWeakThis(conn);
     conn->setState(CONNECTION_PENDING_CONNECT);
@@ -649,37 +696,40 @@ private:
   static bool listen(ConnectionVariables<EndPointType>* sstConnVars, StreamReturnCallbackFunction cb, EndPoint<EndPointType> listeningEndPoint) {
       sstConnVars->getDatagramLayer(listeningEndPoint.endPoint)->listenOn(listeningEndPoint);
 
-    boost::mutex::scoped_lock lock(sstConnVars->sStaticMembersLock.getMutex());
-
-    StreamReturnCallbackMap& listeningConnectionsCallbackMap = sstConnVars->sListeningConnectionsCallbackMap;
-
-    if (listeningConnectionsCallbackMap.find(listeningEndPoint) != listeningConnectionsCallbackMap.end()){
-      return false;
-    }
-
-    listeningConnectionsCallbackMap[listeningEndPoint] = cb;
-
-    return true;
+    return sstConnVars->sListeningConnectionsCallbackMap.insert(listeningEndPoint, cb);
   }
 
   static bool unlisten(ConnectionVariables<EndPointType>* sstConnVars, EndPoint<EndPointType> listeningEndPoint) {
     BaseDatagramLayer<EndPointType>::stopListening(sstConnVars, listeningEndPoint);
 
-    boost::mutex::scoped_lock lock(sstConnVars->sStaticMembersLock.getMutex());
-
     sstConnVars->sListeningConnectionsCallbackMap.erase(listeningEndPoint);
 
     return true;
   }
 
   void listenStream(uint32 port, StreamReturnCallbackFunction scb) {
+    boost::mutex::scoped_lock lock(mStreamsMutex);
     mListeningStreamsCallbackMap[port] = scb;
   }
 
   void unlistenStream(uint32 port) {
+    boost::mutex::scoped_lock lock(mStreamsMutex);
     mListeningStreamsCallbackMap.erase(port);
   }
 
+  LSID newLSID() {
+    boost::mutex::scoped_lock lock(mStreamsMutex);
+    return ++mNumStreams;
+  }
+
+  std::tr1::shared_ptr< Stream<EndPointType> > getIncomingSubstream(LSID lsid) {
+    boost::mutex::scoped_lock lock(mStreamsMutex);
+    typename LSIDStreamMap::iterator it = mIncomingSubstreamMap.find(lsid);
+    if (it == mIncomingSubstreamMap.end())
+      return std::tr1::shared_ptr< Stream<EndPointType> >();
+    return it->second;
+  }
+
   /* Creates a stream on top of this connection. The function also queues
      up any initial data that needs to be sent on the stream. The function
      does not return a stream immediately since stream  creation might
@@ -714,7 +764,7 @@ private:
                       uint32 local_port, uint32 remote_port, LSID parentLSID)
   {
     USID usid = createNewUSID();
-    LSID lsid = ++mNumStreams;
+    LSID lsid = newLSID();
 
     std::tr1::shared_ptr<Stream<EndPointType> > stream =
       std::tr1::shared_ptr<Stream<EndPointType> >
@@ -722,6 +772,7 @@ private:
     stream->mWeakThis = stream;
     int numBytesBuffered = stream->init(initial_data, length, false, 0);
 
+    boost::mutex::scoped_lock lock(mStreamsMutex);
     mOutgoingSubstreamMap[lsid]=stream;
 
     return numBytesBuffered;
@@ -745,8 +796,8 @@ private:
       Sirikata::Protocol::SST::SSTChannelHeader sstMsg;
       sstMsg.set_channel_id( mRemoteChannelID );
       sstMsg.set_transmit_sequence_number(mTransmitSequenceNumber);
-      sstMsg.set_ack_count(1);
-      sstMsg.set_ack_sequence_number(mLastReceivedSequenceNumber);
+      sstMsg.set_ack_count(ackCount());
+      sstMsg.set_ack_sequence_number(mReceivedRun.last());
 
       sstMsg.set_payload(data, length);
 
@@ -755,10 +806,10 @@ private:
     else {
       if (mQueuedSegments.size() < MAX_QUEUED_SEGMENTS) {
         mQueuedSegments.push_back( std::tr1::shared_ptr<ChannelSegment>(
-                                   new ChannelSegment(data, length, mTransmitSequenceNumber, mLastReceivedSequenceNumber) ) );
+                                   new ChannelSegment(data, length, mTransmitSequenceNumber, mReceivedRun.last()) ) );
 
         if (mInSendingMode) {
-          getContext()->mainStrand->post(Duration::milliseconds(1.0),
+          mStrand->post(Duration::milliseconds(1.0),
               std::tr1::bind(&Connection::serviceConnectionNoReturn, this, mWeakThis.lock()),
               "Connection::serviceConnectionNoReturn"
           );
@@ -792,7 +843,7 @@ private:
   void setWeakThis( std::tr1::shared_ptr<Connection>  conn) {
     mWeakThis = conn;
 
-    getContext()->mainStrand->post(Duration::seconds(300),
+    mStrand->post(Duration::seconds(300),
         std::tr1::bind(&Connection<EndPointType>::checkIfAlive, this, conn),
         "Connection<EndPointType>::checkIfAlive"
     );
@@ -806,49 +857,48 @@ private:
     return id;
   }
 
-  void markAcknowledgedPacket(uint64 receivedAckNum) {
-    boost::mutex::scoped_lock lock(mOutstandingSegmentsMutex);
+  /* Number of consecutive sequence numbers, ending at the last one
+     received, to acknowledge in the next packet. */
+  uint32 ackCount() {
+    return mReceivedRun.count();
+  }
 
-    for (std::deque< std::tr1::shared_ptr<ChannelSegment> >::iterator it = mOutstandingSegments.begin();
-         it != mOutstandingSegments.end(); it++)
-    {
-        std::tr1::shared_ptr<ChannelSegment> segment = *it;
+  /* Called by a stream, while handling the segment on mStrand, when it drops
+     the last segment received, so acks for later segments don't cover it. */
+  void rejectReceivedSegment() {
+    mReceivedRun.reject();
+  }
 
-        if (!segment) {
-          mOutstandingSegments.erase(it);
-          it = mOutstandingSegments.begin();
-          continue;
-        }
+  /* Handles an ack for the ackCount segments ending at receivedAckNum. Any
+     segments that later acks have passed are considered lost. */
+  void markAcknowledgedPacket(uint64 receivedAckNum, uint32 ackCount) {
+    boost::mutex::scoped_lock lock(mOutstandingSegmentsMutex);
 
-        if (segment->mChannelSequenceNumber == receivedAckNum) {
-          segment->mAckTime = Timer::now();
+    const Time curTime = Timer::now();
 
-          if (mFirstRTO ) {
-	         mRTOMicroseconds = ((segment->mAckTime - segment->mTransmitTime).toMicroseconds()) ;
-	         mFirstRTO = false;
-          }
-          else {
-            mRTOMicroseconds = CC_ALPHA * mRTOMicroseconds +
-              (1.0-CC_ALPHA) * (segment->mAckTime - segment->mTransmitTime).toMicroseconds();
-          }
+    int64 rtt;
+    uint32 nacked = mOutstandingSegments.acked(receivedAckNum, ackCount, curTime, &rtt);
+    if (nacked == 0) return;
 
-          mInSendingMode = true;
+    if (rtt >= 0) {
+      mRTT.sample(rtt);
+    }
+    mCongestionController->onAck(nacked, curTime);
 
-          std::tr1::shared_ptr<Connection<EndPointType> > conn = mWeakThis.lock();
-          if (conn) {
-            getContext()->mainStrand->post(
-                std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, conn),
-                "Connection<EndPointType>::serviceConnectionNoReturn"
-            );
-          }
+    OutstandingSegments::SegmentList lost;
+    mOutstandingSegments.detectLosses(&lost);
+    for (uint32 i = 0; i < lost.size(); i++) {
+      mCongestionController->onLoss(lost[i].first, mOutstandingSegments.highestSent(), curTime);
+    }
 
-          if (rand() % mCwnd == 0)  {
-            mCwnd += 1;
-          }
+    mInSendingMode = true;
 
-          mOutstandingSegments.erase(it);
-          break;
-        }
+    std::tr1::shared_ptr<Connection<EndPointType> > conn = mWeakThis.lock();
+    if (conn) {
+      mStrand->post(
+          std::tr1::bind(&Connection<EndPointType>::serviceConnectionNoReturn, this, conn),
+          "Connection<EndPointType>::serviceConnectionNoReturn"
+      );
     }
   }
 
@@ -880,13 +930,22 @@ private:
   void handleInitPacket(Sirikata::Protocol::SST::SSTStreamHeader* received_stream_msg) {
     LSID incomingLsid = received_stream_msg->lsid();
 
-    if (mIncomingSubstreamMap.find(incomingLsid) == mIncomingSubstreamMap.end()) {
-      if (mListeningStreamsCallbackMap.find(received_stream_msg->dest_port()) !=
-	  mListeningStreamsCallbackMap.end())
+    std::tr1::shared_ptr< Stream<EndPointType> > existing = getIncomingSubstream(incomingLsid);
+    if (!existing) {
+      StreamReturnCallbackFunction listeningCallback = NULL;
+      {
+        boost::mutex::scoped_lock lock(mStreamsMutex);
+        typename std::map<uint32, StreamReturnCallbackFunction>::iterator it =
+          mListeningStreamsCallbackMap.find(received_stream_msg->dest_port());
+        if (it != mListeningStreamsCallbackMap.end())
+          listeningCallback = it->second;
+      }
+
+      if (listeningCallback != NULL)
       {
 	//create a new stream
 	USID usid = createNewUSID();
-	LSID newLSID = ++mNumStreams;
+	LSID newLSID = this->newLSID();
 
 	std::tr1::shared_ptr<Stream<EndPointType> > stream =
 	  std::tr1::shared_ptr<Stream<EndPointType> >
@@ -898,10 +957,13 @@ private:
         stream->mWeakThis = stream;
         stream->init(NULL, 0, true, incomingLsid);
 
-	mOutgoingSubstreamMap[newLSID] = stream;
-	mIncomingSubstreamMap[incomingLsid] = stream;
+        {
+          boost::mutex::scoped_lock lock(mStreamsMutex);
+          mOutgoingSubstreamMap[newLSID] = stream;
+          mIncomingSubstreamMap[incomingLsid] = stream;
+        }
 
-	mListeningStreamsCallbackMap[received_stream_msg->dest_port()](0, stream);
+	listeningCallback(0, stream);
 
 	stream->receiveData(received_stream_msg, received_stream_msg->payload().data(),
 			    received_stream_msg->bsn(),
@@ -912,19 +974,21 @@ private:
       }
     }
     else {
-      mIncomingSubstreamMap[incomingLsid]->sendReplyPacket(NULL, 0, incomingLsid);
+      existing->sendReplyPacket(NULL, 0, incomingLsid);
     }
   }
 
   void handleReplyPacket(Sirikata::Protocol::SST::SSTStreamHeader* received_stream_msg) {
     LSID incomingLsid = received_stream_msg->lsid();
 
+    boost::mutex::scoped_lock lock(mStreamsMutex);
     if (mIncomingSubstreamMap.find(incomingLsid) == mIncomingSubstreamMap.end()) {
       LSID initiatingLSID = received_stream_msg->rsid();
 
       if (mOutgoingSubstreamMap.find(initiatingLSID) != mOutgoingSubstreamMap.end()) {
 	std::tr1::shared_ptr< Stream<EndPointType> > stream = mOutgoingSubstreamMap[initiatingLSID];
 	mIncomingSubstreamMap[incomingLsid] = stream;
+        lock.unlock();
         stream->initRemoteLSID(incomingLsid);
 
 	if (stream->mStreamReturnCallback != NULL){
@@ -944,15 +1008,18 @@ private:
   void handleDataPacket(Sirikata::Protocol::SST::SSTStreamHeader* received_stream_msg) {
     LSID incomingLsid = received_stream_msg->lsid();
 
-    if (mIncomingSubstreamMap.find(incomingLsid) != mIncomingSubstreamMap.end()) {
-      std::tr1::shared_ptr< Stream<EndPointType> > stream_ptr =
-	mIncomingSubstreamMap[incomingLsid];
+    std::tr1::shared_ptr< Stream<EndPointType> > stream_ptr = getIncomingSubstream(incomingLsid);
+    if (stream_ptr) {
       stream_ptr->receiveData( received_stream_msg,
 			       received_stream_msg->payload().data(),
 			       received_stream_msg->bsn(),
 			       received_stream_msg->payload().size()
 			       );
     }
+    else {
+      // Nobody will ack it, so later acks mustn't either
+      rejectReceivedSegment();
+    }
   }
 
   void handleAckPacket(Sirikata::Protocol::SST::SSTChannelHeader* received_channel_msg,
@@ -961,13 +1028,13 @@ private:
     //printf("ACK received : offset = %d\n", (int)received_channel_msg->ack_sequence_number() );
     LSID incomingLsid = received_stream_msg->lsid();
 
-    if (mIncomingSubstreamMap.find(incomingLsid) != mIncomingSubstreamMap.end()) {
-      std::tr1::shared_ptr< Stream<EndPointType> > stream_ptr =
-	mIncomingSubstreamMap[incomingLsid];
+    std::tr1::shared_ptr< Stream<EndPointType> > stream_ptr = getIncomingSubstream(incomingLsid);
+    if (stream_ptr) {
       stream_ptr->receiveData( received_stream_msg,
 			       received_stream_msg->payload().data(),
 			       received_channel_msg->ack_sequence_number(),
-			       received_stream_msg->payload().size()
+			       received_stream_msg->payload().size(),
+			       std::max((uint32)received_channel_msg->ack_count(), (uint32)1)
 			       );
     }
   }
@@ -983,8 +1050,11 @@ private:
           // Extract dispatch information
           uint32 dest_port = received_stream_msg->dest_port();
           std::vector<ReadDatagramCallback> datagramCallbacks;
-          if (mReadDatagramCallbacks.find(dest_port) != mReadDatagramCallbacks.end()) {
-              datagramCallbacks = mReadDatagramCallbacks[dest_port];
+          {
+              boost::mutex::scoped_lock lock(mStreamsMutex);
+              if (mReadDatagramCallbacks.find(dest_port) != mReadDatagramCallbacks.end()) {
+                  datagramCallbacks = mReadDatagramCallbacks[dest_port];
+              }
           }
 
           // The datagram is all here, just deliver
@@ -1020,27 +1090,38 @@ private:
     Sirikata::Protocol::SST::SSTChannelHeader sstMsg;
     sstMsg.set_channel_id( mRemoteChannelID );
     sstMsg.set_transmit_sequence_number(mTransmitSequenceNumber);
-    sstMsg.set_ack_count(1);
-    sstMsg.set_ack_sequence_number(mLastReceivedSequenceNumber);
+    sstMsg.set_ack_count(ackCount());
+    sstMsg.set_ack_sequence_number(mReceivedRun.last());
 
     sendSSTChannelPacket(sstMsg);
 
     mTransmitSequenceNumber++;
   }
 
-  void receiveMessage(void* recv_buff, int len) {
-    uint8* data = (uint8*) recv_buff;
-    std::string str = std::string((char*) data, len);
+  /* Called by the datagram layer, possibly from another strand, when a
+     packet arrives for this connection. Processing moves onto this
+     connection's strand. */
+  void receiveDatagram(void* recv_buff, int len) {
+    std::tr1::shared_ptr<Connection<EndPointType> > conn = mWeakThis.lock();
+    if (!conn) return;
+
+    mStrand->post(
+        std::tr1::bind(&Connection<EndPointType>::receiveMessage, this, conn, std::string((char*) recv_buff, len)),
+        "Connection<EndPointType>::receiveMessage"
+    );
+  }
 
+  void receiveMessage(std::tr1::shared_ptr<Connection<EndPointType> > conn, const std::string& str) {
     Sirikata::Protocol::SST::SSTChannelHeader* received_msg =
                        new Sirikata::Protocol::SST::SSTChannelHeader();
     bool parsed = parsePBJMessage(received_msg, str);
 
-    mLastReceivedSequenceNumber = received_msg->transmit_sequence_number();
+    mReceivedRun.received(received_msg->transmit_sequence_number());
 
     uint64 receivedAckNum = received_msg->ack_sequence_number();
 
-    markAcknowledgedPacket(receivedAckNum);
+    // Peers which don't report runs always send an ack_count of 1.
+    markAcknowledgedPacket(receivedAckNum, std::max((uint32)received_msg->ack_count(), (uint32)1));
 
     if (mState == CONNECTION_PENDING_CONNECT) {
       mState = CONNECTION_CONNECTED;
@@ -1055,19 +1136,11 @@ private:
 
       sendData( received_payload, 0, false );
 
-      boost::mutex::scoped_lock lock(mSSTConnVars->sStaticMembersLock.getMutex());
-
-      ConnectionReturnCallbackMap& connectionReturnCallbackMap = mSSTConnVars->sConnectionReturnCallbackMap;
-      ConnectionMap& connectionMap = mSSTConnVars->sConnectionMap;
-
-      if (connectionReturnCallbackMap.find(mLocalEndPoint) != connectionReturnCallbackMap.end())
+      ConnectionReturnCallbackFunction cb;
+      if (mSSTConnVars->sConnectionReturnCallbackMap.erase(mLocalEndPoint, &cb)
+          && mSSTConnVars->sConnectionMap.contains(mLocalEndPoint))
       {
-        if (connectionMap.find(mLocalEndPoint) != connectionMap.end()) {
-          std::tr1::shared_ptr<Connection> conn = connectionMap[mLocalEndPoint];
-
-          connectionReturnCallbackMap[mLocalEndPoint] (SST_IMPL_SUCCESS, conn);
-        }
-        connectionReturnCallbackMap.erase(mLocalEndPoint);
+        cb(SST_IMPL_SUCCESS, conn);
       }
     }
     else if (mState == CONNECTION_PENDING_RECEIVE_CONNECT) {
@@ -1083,14 +1156,29 @@ private:
   }
 
   uint64 getRTOMicroseconds() {
-    return mRTOMicroseconds;
+    return mRTT.rto();
   }
 
   void eraseDisconnectedStream(Stream<EndPointType>* s) {
-    mOutgoingSubstreamMap.erase(s->getLSID());
-    mIncomingSubstreamMap.erase(s->getRemoteLSID());
+    // The erased references may be the stream's last, and destroying a stream
+    // calls back in here, so release them after unlocking.
+    std::tr1::shared_ptr< Stream<EndPointType> > outgoing, incoming;
+
+    boost::mutex::scoped_lock lock(mStreamsMutex);
+    typename LSIDStreamMap::iterator it = mOutgoingSubstreamMap.find(s->getLSID());
+    if (it != mOutgoingSubstreamMap.end()) {
+      outgoing = it->second;
+      mOutgoingSubstreamMap.erase(it);
+    }
+    it = mIncomingSubstreamMap.find(s->getRemoteLSID());
+    if (it != mIncomingSubstreamMap.end()) {
+      incoming = it->second;
+      mIncomingSubstreamMap.erase(it);
+    }
+    bool empty = mOutgoingSubstreamMap.empty() && mIncomingSubstreamMap.empty();
+    lock.unlock();
 
-    if (mOutgoingSubstreamMap.size() == 0 && mIncomingSubstreamMap.size() == 0) {
+    if (empty) {
       close(true);
     }
   }
@@ -1107,17 +1195,12 @@ private:
       //This is in contrast to the case where the connection got connected, but
       //the connection's root stream was unable to do so.
 
-       boost::mutex::scoped_lock lock(conn->mSSTConnVars->sStaticMembersLock.getMutex());
+       boost::mutex::scoped_lock lock(conn->mSSTConnVars->sStaticMembersLock);
        ConnectionReturnCallbackFunction cb = NULL;
-
-       ConnectionReturnCallbackMap& connectionReturnCallbackMap = conn->mSSTConnVars->sConnectionReturnCallbackMap;
-       if (connectionReturnCallbackMap.find(conn->localEndPoint()) != connectionReturnCallbackMap.end()) {
-         cb = connectionReturnCallbackMap[conn->localEndPoint()];
-       }
+       conn->mSSTConnVars->sConnectionReturnCallbackMap.erase(conn->localEndPoint(), &cb);
 
        std::tr1::shared_ptr<Connection>  failed_conn = conn;
 
-       connectionReturnCallbackMap.erase(conn->localEndPoint());
        conn->mSSTConnVars->sConnectionMap.erase(conn->localEndPoint());
 
        lock.unlock();
@@ -1133,7 +1216,7 @@ private:
 
    // This version should only be called by the destructor!
    void finalCleanup() {
-     boost::mutex::scoped_lock lock(mSSTConnVars->sStaticMembersLock.getMutex());
+     boost::mutex::scoped_lock lock(mSSTConnVars->sStaticMembersLock);
 
      mDatagramLayer->unlisten(mLocalEndPoint);
 
@@ -1146,26 +1229,10 @@ private:
    }
 
    static void closeConnections(ConnectionVariables<EndPointType>* sstConnVars) {
-       // We have to be careful with this function. Because it is going to free
-       // the connections, we have to make sure not to let them get freed where
-       // the deleter will modify sConnectionMap while we're still modifying it.
-       //
-       // Our approach is to just pick out the first connection, make a copy of
-       // its shared_ptr to make sure it doesn't get freed until we want it to,
-       // remove it from sConnectionMap, and then get rid of the shared_ptr to
-       // allow the connection to be freed.
-       //
-       // Note that we don't lock sStaticMembers lock. At this point, that
-       // shouldn't be a problem since we should be the only thread still
-       // modifying this data. If we did lock it, we'd deadlock since the
-       // destructor will also, indirectly, lock it.
-       while(!sstConnVars->sConnectionMap.empty()) {
-           ConnectionMap& connectionMap = sstConnVars->sConnectionMap;
-
-           ConnectionPtr saved = connectionMap.begin()->second;
-           connectionMap.erase(connectionMap.begin());
-           saved.reset();
-       }
+       // Freeing a connection removes it from sConnectionMap. clear() only
+       // releases the connections after unlocking, so the destructors can
+       // safely modify the map.
+       sstConnVars->sConnectionMap.clear();
    }
 
    static void handleReceive(ConnectionVariables<EndPointType>* sstConnVars,
@@ -1180,27 +1247,26 @@ private:
 
      uint8 channelID = received_msg->channel_id();
 
-     boost::mutex::scoped_lock lock(sstConnVars->sStaticMembersLock.getMutex());
-
      ConnectionMap& connectionMap = sstConnVars->sConnectionMap;
-     if (connectionMap.find(localEndPoint) != connectionMap.end()) {
+     std::tr1::shared_ptr<Connection<EndPointType> > conn;
+     StreamReturnCallbackFunction listeningCallback;
+     if (connectionMap.get(localEndPoint, &conn)) {
        if (channelID == 0) {
  	/*Someone's already connected at this port. Either don't reply or
  	  send back a request rejected message. */
 
         SST_LOG(info, "Someone's already connected at this port on object " << localEndPoint.endPoint.toString() << "\n");
- 	return;
        }
-       std::tr1::shared_ptr<Connection<EndPointType> > conn = connectionMap[localEndPoint];
-
-       conn->receiveMessage(data, len);
+       else if (conn) {
+         // conn is NULL while createConnection is still setting it up
+         conn->receiveDatagram(data, len);
+       }
      }
      else if (channelID == 0) {
        /* it's a new channel request negotiation protocol
  	        packet ; allocate a new channel.*/
 
-       StreamReturnCallbackMap& listeningConnectionsCallbackMap = sstConnVars->sListeningConnectionsCallbackMap;
-       if (listeningConnectionsCallbackMap.find(localEndPoint) != listeningConnectionsCallbackMap.end()) {
+       if (sstConnVars->sListeningConnectionsCallbackMap.get(localEndPoint, &listeningCallback)) {
          uint32* received_payload = (uint32*) received_msg->payload().data();
 
          uint32 payload[2];
@@ -1213,14 +1279,13 @@ private:
          payload[1] = htonl(availablePort);
 
          EndPoint<EndPointType> newLocalEndPoint(localEndPoint.endPoint, availablePort);
-         std::tr1::shared_ptr<Connection>  conn =
-                    std::tr1::shared_ptr<Connection>(
+         conn = std::tr1::shared_ptr<Connection>(
                          new Connection(sstConnVars, newLocalEndPoint, remoteEndPoint));
 
 
-         conn->listenStream(newLocalEndPoint.port, listeningConnectionsCallbackMap[localEndPoint]);
+         conn->listenStream(newLocalEndPoint.port, listeningCallback);
          conn->setWeakThis(conn);
-         connectionMap[newLocalEndPoint] = conn;
+         connectionMap.set(newLocalEndPoint, conn);
 
          conn->setLocalChannelID(availableChannel);
          if (received_msg->payload().size()>=sizeof(uint32)) {
@@ -1243,6 +1308,8 @@ private:
    virtual ~Connection() {
        // Make sure we've fully cleaned up
        finalCleanup();
+
+       delete mCongestionController;
    }
 
 
@@ -1278,7 +1345,7 @@ private:
       return false;
     }
 
-    LSID lsid = ++mNumStreams;
+    LSID lsid = newLSID();
 
     while (currOffset < length) {
         // Because the header is variable size, we have to have this
@@ -1355,6 +1422,7 @@ private:
     @return true if the callback was successfully registered.
   */
   virtual bool registerReadDatagramCallback(uint32 port, ReadDatagramCallback cb) {
+    boost::mutex::scoped_lock lock(mStreamsMutex);
     if (mReadDatagramCallbacks.find(port) == mReadDatagramCallbacks.end()) {
       mReadDatagramCallbacks[port] = std::vector<ReadDatagramCallback>();
     }
@@ -1389,7 +1457,10 @@ private:
              remote end point.
   */
   virtual void close(bool force) {
-      boost::mutex::scoped_lock lock(mSSTConnVars->sStaticMembersLock.getMutex());
+      // Keep this connection alive until the lock is released, since
+      // removing it from sConnectionMap may drop the last reference.
+      std::tr1::shared_ptr<Connection<EndPointType> > self = mWeakThis.lock();
+      boost::mutex::scoped_lock lock(mSSTConnVars->sStaticMembersLock);
       iClose(force);
   }
 
@@ -1473,7 +1544,7 @@ public:
     typedef typename CBTypes::StreamReturnCallbackFunction StreamReturnCallbackFunction;
     typedef typename CBTypes::ReadCallback ReadCallback;
 
-    typedef std::map<EndPoint<EndPointType>, StreamReturnCallbackFunction> StreamReturnCallbackMap;
+    typedef typename ConnectionVariables<EndPointType>::StreamReturnCallbackMap StreamReturnCallbackMap;
 
    enum StreamStates {
        DISCONNECTED = 1,
@@ -1512,16 +1583,16 @@ public:
       }
 
       StreamReturnCallbackMap& streamReturnCallbackMap = sstConnVars->mStreamReturnCallbackMap;
-      if (streamReturnCallbackMap.find(localEndPoint) != streamReturnCallbackMap.end()) {
+      if (!streamReturnCallbackMap.insert(localEndPoint, cb)) {
         return false;
       }
 
-      streamReturnCallbackMap[localEndPoint] = cb;
-
       bool result = Connection<EndPointType>::createConnection(sstConnVars,
                                                                localEndPoint,
                                                                remoteEndPoint,
                                                                connectionCreated, cb);
+      if (!result)
+        streamReturnCallbackMap.erase(localEndPoint);
       return result;
   }
 
@@ -1595,7 +1666,7 @@ public:
 
       std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
       if (conn)
-        getContext()->mainStrand->post(Duration::seconds(0.01),
+        mStrand->post(Duration::seconds(0.01),
             std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
             "Stream<EndPointType>::serviceStreamNoReturn"
         );
@@ -1624,7 +1695,7 @@ public:
 
       std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
       if (conn)
-        getContext()->mainStrand->post(Duration::seconds(0.01),
+        mStrand->post(Duration::seconds(0.01),
             std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
             "Stream<EndPointType>::serviceStreamNoReturn"
         );
@@ -1680,9 +1751,9 @@ public:
     @return true if the callback was successfully registered.
   */
   virtual bool registerReadCallback( ReadCallback callback) {
-    mReadCallback = callback;
-
     boost::recursive_mutex::scoped_lock lock(mReceiveBufferMutex);
+
+    mReadCallback = callback;
     sendToApp(0);
 
     return true;
@@ -1713,7 +1784,7 @@ public:
     else {
       mState = PENDING_DISCONNECT;
       if (conn) {
-          getContext()->mainStrand->post(
+          mStrand->post(
               std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
               "Stream<EndPointType>::serviceStreamNoReturn"
           );
@@ -1830,9 +1901,7 @@ private:
     MAX_PAYLOAD_SIZE(1000),
     MAX_QUEUE_LENGTH(4000000),
     MAX_RECEIVE_WINDOW(10000),
-    mFirstRTO(true),
-    mStreamRTOMicroseconds(2000000),
-    FL_ALPHA(0.8),
+    mHighestAckedChannelID(0),
     mTransmitWindowSize(MAX_RECEIVE_WINDOW),
     mReceiveWindowSize(MAX_RECEIVE_WINDOW),
     mNumOutstandingBytes(0),
@@ -1855,6 +1924,8 @@ private:
     mCurrentQueueLength = 0;
 
     std::tr1::shared_ptr<Connection<EndPointType> > locked_conn = mConnection.lock();
+    mContext = locked_conn->getContext();
+    mStrand = locked_conn->mStrand;
     mRemoteEndPoint = EndPoint<EndPointType> (locked_conn->remoteEndPoint().endPoint, mRemotePort);
     mLocalEndPoint = EndPoint<EndPointType> (locked_conn->localEndPoint().endPoint, mLocalPort);
 
@@ -1906,7 +1977,7 @@ private:
     /** Post a keep-alive task...  **/
     std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
     if (conn) {
-      getContext()->mainStrand->post(Duration::seconds(60),
+      mStrand->post(Duration::seconds(60),
           std::tr1::bind(&Stream<EndPointType>::sendKeepAlive, this, mWeakThis, conn),
           "Stream<EndPointType>::sendKeepAlive"
       );
@@ -1946,7 +2017,7 @@ private:
 
     write(buf, 0);
 
-    getContext()->mainStrand->post(Duration::seconds(60),
+    mStrand->post(Duration::seconds(60),
         std::tr1::bind(&Stream<EndPointType>::sendKeepAlive, this, wstrm, conn),
         "Stream<EndPointType>::sendKeepAlive"
     );
@@ -1954,22 +2025,19 @@ private:
 
   static void connectionCreated( int errCode, std::tr1::shared_ptr<Connection<EndPointType> > c) {
     StreamReturnCallbackMap& streamReturnCallbackMap = c->mSSTConnVars->mStreamReturnCallbackMap;
-    assert(streamReturnCallbackMap.find(c->localEndPoint()) != streamReturnCallbackMap.end());
+    assert(streamReturnCallbackMap.contains(c->localEndPoint()));
 
-    if (errCode != SST_IMPL_SUCCESS) {
-
-      StreamReturnCallbackFunction cb = streamReturnCallbackMap[c->localEndPoint()];
-      streamReturnCallbackMap.erase(c->localEndPoint());
+    StreamReturnCallbackFunction cb;
+    streamReturnCallbackMap.erase(c->localEndPoint(), &cb);
 
+    if (errCode != SST_IMPL_SUCCESS) {
       cb(SST_IMPL_FAILURE, StreamPtr() );
 
       return;
     }
 
-    c->stream(streamReturnCallbackMap[c->localEndPoint()], NULL , 0,
+    c->stream(cb, NULL , 0,
 	      c->localEndPoint().port, c->remoteEndPoint().port);
-
-    streamReturnCallbackMap.erase(c->localEndPoint());
   }
 
   void serviceStreamNoReturn(std::tr1::shared_ptr<Stream<EndPointType> > strm, std::tr1::shared_ptr<Connection<EndPointType> > conn) {
@@ -2041,7 +2109,7 @@ private:
         // connection request.
         std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
         if (conn)
-            getContext()->mainStrand->post(
+            mStrand->post(
                 std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
                 "Stream<EndPointType>::serviceStreamNoReturn"
             );
@@ -2050,14 +2118,14 @@ private:
     else {
       if (mState != DISCONNECTED) {
 
-        //if the stream has been waiting for an ACK for > 2*mStreamRTOMicroseconds,
+        //if the stream has been waiting for an ACK for longer than the RTO,
         //resend the unacked packets. We don't actually check if we
         //have anything to ack here, that happens in resendUnackedPackets. Also,
         //'resending' really just means sticking them back at the front of
         //mQueuedBuffers, so the code that follows and actually sends data will
         //ensure that we trigger a re-servicing sometime in the future.
         if ( mLastSendTime != Time::null()
-             && (curTime - mLastSendTime).toMicroseconds() > 2*mStreamRTOMicroseconds)
+             && (curTime - mLastSendTime).toMicroseconds() > mStreamRTT.rto())
         {
             resendUnackedPackets();
             mLastSendTime = curTime;
@@ -2111,7 +2179,7 @@ private:
         if (sentSomething) {
           std::tr1::shared_ptr<Connection<EndPointType> > conn =  mConnection.lock();
           if (conn)
-            getContext()->mainStrand->post(Duration::microseconds(2*mStreamRTOMicroseconds),
+            mStrand->post(Duration::microseconds(mStreamRTT.rto()),
                 std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
                 "Stream<EndPointType>::serviceStreamNoReturn"
             );
@@ -2152,13 +2220,39 @@ private:
     mNumOutstandingBytes = 0;
 
     if (!mChannelToBufferMap.empty()) {
-      if (mStreamRTOMicroseconds < 20000000) {
-        mStreamRTOMicroseconds *= 2;
-      }
+      mStreamRTT.backoff();
       mChannelToBufferMap.clear();
     }
   }
 
+  /* Requeues only the buffers whose channel segments have been passed by
+     enough later acks to be considered lost, rather than waiting for the RTO
+     and resending everything outstanding. mQueueMutex must be locked. */
+  void resendLostPackets() {
+    std::vector< std::tr1::shared_ptr<StreamBuffer> > lost;
+
+    std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >::iterator it = mChannelToBufferMap.begin();
+    while (it != mChannelToBufferMap.end() &&
+           it->first + LOSS_DETECTION_THRESHOLD <= mHighestAckedChannelID)
+    {
+      lost.push_back(it->second);
+      if (mNumOutstandingBytes >= it->second->mBufferLength)
+        mNumOutstandingBytes -= it->second->mBufferLength;
+      else
+        mNumOutstandingBytes = 0;
+      mChannelToBufferMap.erase(it++);
+    }
+
+    for (uint32 i = lost.size(); i > 0; i--) {
+      mQueuedBuffers.push_front(lost[i-1]);
+      mCurrentQueueLength += lost[i-1]->mBufferLength;
+    }
+
+    if (!lost.empty() && mTransmitWindowSize < lost[0]->mBufferLength) {
+      mTransmitWindowSize = lost[0]->mBufferLength;
+    }
+  }
+
   /* This function sends received data up to the application interface.
      mReceiveBufferMutex must be locked before calling this function. */
   void sendToApp(uint32 skipLength) {
@@ -2199,8 +2293,11 @@ private:
     }
   }
 
+  /* For ACK packets, offset is the channel sequence number being acked and
+     ackCount is the number of consecutive channel segments, ending at offset,
+     that the remote end has received. */
   void receiveData( Sirikata::Protocol::SST::SSTStreamHeader* streamMsg,
-		    const void* buffer, uint64 offset, uint32 len )
+		    const void* buffer, uint64 offset, uint32 len, uint32 ackCount = 1 )
   {
     const Time curTime = Timer::now();
     mLastReceiveTime = curTime;
@@ -2238,6 +2335,7 @@ private:
 	}
         else {
            //dont ack this packet.. its falling outside the receive window.
+          rejectSegment();
 	  sendToApp(0);
         }
       }
@@ -2258,6 +2356,7 @@ private:
 	}
 	else {
 	  //dont ack this packet.. its falling outside the receive window.
+          rejectSegment();
 	  sendToApp(0);
 	}
       }
@@ -2268,19 +2367,60 @@ private:
           // keep alive packets.
           sendAckPacket();
       }
+      else {
+          rejectSegment();
+      }
     }
 
     //handle any ACKS that might be included in the message...
     boost::mutex::scoped_lock lock(mQueueMutex);
 
     bool acked_msgs = false;
-    if (mChannelToBufferMap.find(offset) != mChannelToBufferMap.end()) {
-      uint64 dataOffset = mChannelToBufferMap[offset]->mOffset;
-      mNumOutstandingBytes -= mChannelToBufferMap[offset]->mBufferLength;
+    uint64 firstAcked = (offset >= ackCount) ? (offset - ackCount + 1) : 0;
+    for (uint64 channelID = firstAcked; channelID <= offset; channelID++) {
+      if (markAcknowledged(channelID, streamMsg, curTime)) {
+        acked_msgs = true;
+      }
+    }
 
-      mChannelToBufferMap[offset]->mAckTime = curTime;
+    if (acked_msgs && streamMsg->type() == streamMsg->ACK) {
+      resendLostPackets();
+    }
 
-      updateRTO(mChannelToBufferMap[offset]->mTransmitTime, mChannelToBufferMap[offset]->mAckTime);
+    // If we acked messages, we've cleared space in the transmit
+    // buffer (the receiver cleared something out of its receive
+    // buffer). We can send more data, so schedule servicing if we
+    // have anything queued.
+    // TODO(ewencp) maybe only schedule something new when this
+    // started as a full transmit buffer? Have to be careful about
+    // this though since mTransmitWindowSize might not be 0 even if it
+    // was 'full' since the next packet couldn't fit on.
+    if (acked_msgs && !mQueuedBuffers.empty()) {
+        std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
+        if (conn) {
+            mStrand->post(
+                std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
+                "Stream<EndPointType>::serviceStreamNoReturn"
+            );
+        }
+    }
+  }
+
+  /* Handles an ack for a single channel segment. Returns true if it
+     acknowledged any outstanding data. mQueueMutex must be locked. */
+  bool markAcknowledged(uint64 channelID, Sirikata::Protocol::SST::SSTStreamHeader* streamMsg, const Time& curTime) {
+    bool acked_msgs = false;
+    if (mChannelToBufferMap.find(channelID) != mChannelToBufferMap.end()) {
+      uint64 dataOffset = mChannelToBufferMap[channelID]->mOffset;
+      mNumOutstandingBytes -= mChannelToBufferMap[channelID]->mBufferLength;
+
+      mChannelToBufferMap[channelID]->mAckTime = curTime;
+
+      updateRTO(mChannelToBufferMap[channelID]->mTransmitTime, mChannelToBufferMap[channelID]->mAckTime);
+
+      if (streamMsg->type() == streamMsg->ACK && channelID > mHighestAckedChannelID) {
+        mHighestAckedChannelID = channelID;
+      }
 
       if ( (int) (pow(2.0, streamMsg->window()) - mNumOutstandingBytes) > 0 ) {
         assert( pow(2.0, streamMsg->window()) - mNumOutstandingBytes > 0);
@@ -2290,10 +2430,10 @@ private:
         mTransmitWindowSize = 0;
       }
 
-      //printf("REMOVED ack packet at offset %d\n", (int)mChannelToBufferMap[offset]->mOffset);
+      //printf("REMOVED ack packet at offset %d\n", (int)mChannelToBufferMap[channelID]->mOffset);
 
       acked_msgs = true;
-      mChannelToBufferMap.erase(offset);
+      mChannelToBufferMap.erase(channelID);
 
       std::vector <uint64> channelOffsets;
       for(std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >::iterator it = mChannelToBufferMap.begin();
@@ -2310,10 +2450,10 @@ private:
     }
     else {
       // ACK received but not found in mChannelToBufferMap
-      if (mChannelToStreamOffsetMap.find(offset) != mChannelToStreamOffsetMap.end()) {
-        uint64 dataOffset = mChannelToStreamOffsetMap[offset];
+      if (mChannelToStreamOffsetMap.find(channelID) != mChannelToStreamOffsetMap.end()) {
+        uint64 dataOffset = mChannelToStreamOffsetMap[channelID];
         acked_msgs = true;
-        mChannelToStreamOffsetMap.erase(offset);
+        mChannelToStreamOffsetMap.erase(channelID);
 
         std::vector <uint64> channelOffsets;
         for(std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >::iterator it = mChannelToBufferMap.begin();
@@ -2330,23 +2470,7 @@ private:
       }
     }
 
-    // If we acked messages, we've cleared space in the transmit
-    // buffer (the receiver cleared something out of its receive
-    // buffer). We can send more data, so schedule servicing if we
-    // have anything queued.
-    // TODO(ewencp) maybe only schedule something new when this
-    // started as a full transmit buffer? Have to be careful about
-    // this though since mTransmitWindowSize might not be 0 even if it
-    // was 'full' since the next packet couldn't fit on.
-    if (acked_msgs && !mQueuedBuffers.empty()) {
-        std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
-        if (conn) {
-            getContext()->mainStrand->post(
-                std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
-                "Stream<EndPointType>::serviceStreamNoReturn"
-            );
-        }
-    }
+    return acked_msgs;
   }
 
   LSID getLSID() {
@@ -2358,23 +2482,12 @@ private:
   }
 
   void updateRTO(Time sampleStartTime, Time sampleEndTime) {
-
-
     if (sampleStartTime > sampleEndTime ) {
       SST_LOG(insane, "Bad sample\n");
       return;
     }
 
-    if (mFirstRTO) {
-      mStreamRTOMicroseconds = (sampleEndTime - sampleStartTime).toMicroseconds() ;
-      mFirstRTO = false;
-    }
-    else {
-
-      mStreamRTOMicroseconds = FL_ALPHA * mStreamRTOMicroseconds +
-	(1.0-FL_ALPHA) * (sampleEndTime - sampleStartTime).toMicroseconds();
-    }
-
+    mStreamRTT.sample((sampleEndTime - sampleStartTime).toMicroseconds());
   }
 
   void sendInitPacket(void* data, uint32 len) {
@@ -2401,14 +2514,22 @@ private:
 
     conn->sendData( buffer.data(), buffer.size(), false );
 
-    getContext()->mainStrand->post(
-        Duration::microseconds(pow(2.0,mNumInitRetransmissions)*mStreamRTOMicroseconds),
+    mStrand->post(
+        Duration::microseconds(pow(2.0,mNumInitRetransmissions)*mStreamRTT.rto()),
         std::tr1::bind(&Stream<EndPointType>::serviceStreamNoReturn, this, mWeakThis.lock(), conn),
         "Stream<EndPointType>::serviceStreamNoReturn"
     );
 
   }
 
+  /* Keeps the connection's ack runs from covering a segment this stream
+     isn't acking. */
+  void rejectSegment() {
+    std::tr1::shared_ptr<Connection<EndPointType> > conn = mConnection.lock();
+    if (conn)
+      conn->rejectReceivedSegment();
+  }
+
   void sendAckPacket() {
     Sirikata::Protocol::SST::SSTStreamHeader sstMsg;
     sstMsg.set_lsid( mLSID );
@@ -2478,6 +2599,9 @@ private:
   //weak_ptr to avoid circular dependency between Connection and Stream classes
   std::tr1::weak_ptr<Connection<EndPointType> > mConnection;
   const Context* mContext;
+  // The connection's strand, kept so timers can still be posted while the
+  // connection is being torn down
+  Network::IOStrandPtr mStrand;
 
   std::map<uint64, std::tr1::shared_ptr<StreamBuffer> >  mChannelToBufferMap;
   std::map<uint64, uint32> mChannelToStreamOffsetMap;
@@ -2495,9 +2619,10 @@ private:
 
   boost::mutex mQueueMutex;
 
-  bool mFirstRTO;
-  int64 mStreamRTOMicroseconds;
-  float FL_ALPHA;
+  RTTEstimator mStreamRTT;
+  // Highest channel sequence number acked by the remote stream, used to
+  // infer which outstanding segments were lost
+  uint64 mHighestAckedChannelID;
 
 
   uint32 mTransmitWindowSize;
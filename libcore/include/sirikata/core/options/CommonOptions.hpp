@@ -54,8 +54,17 @@
 #define OPT_CDN_UPLOAD_URI_PREFIX   "cdn.upload.prefix"
 #define OPT_CDN_UPLOAD_STATUS_URI_PREFIX   "cdn.upload.status.prefix"
 
+#define OPT_HTTP_THREADS                    "http.threads"
+#define OPT_HTTP_MAX_CONNECTIONS            "http.max-connections"
+#define OPT_HTTP_MAX_ENDPOINT_CONNECTIONS   "http.max-endpoint-connections"
+#define OPT_HTTP_PIPELINE_DEPTH             "http.pipeline-depth"
+
+#define OPT_SST_CONGESTION_CONTROL          "sst.congestion-control"
+
 #define OPT_TRACE_TIMESERIES           "trace.timeseries"
 #define OPT_TRACE_TIMESERIES_OPTIONS   "trace.timeseries-options"
+#define OPT_TRACE_METRICS_INTERVAL     "trace.metrics-interval"
+#define OPT_PROFILE_SAMPLE_RATE        "profile.sample-rate"
 
 #define OPT_COMMAND_COMMANDER           "command.commander"
 #define OPT_COMMAND_COMMANDER_OPTIONS   "command.commander-options"
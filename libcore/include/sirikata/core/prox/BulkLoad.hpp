@@ -0,0 +1,187 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_LIBCORE_PROX_BULK_LOAD_HPP_
+#define _SIRIKATA_LIBCORE_PROX_BULK_LOAD_HPP_
+
+// NOTE: Like QueryHandlerFactory, this is used by libspace plugins, liboh
+// plugins, and pinto, so it must remain header only.
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** Orders in which a batch of objects can be inserted into a query handler.
+ *  R-trees grown by inserting objects one at a time in arbitrary order end up
+ *  with loosely packed, heavily overlapping nodes. Inserting a large batch in
+ *  an order that keeps nearby objects together fills each leaf with
+ *  neighbouring objects, approximating a tree built by a packing bulk load.
+ */
+enum BulkLoadOrder {
+    BULK_LOAD_NONE,
+    // Position along a 3D Hilbert curve through the batch's bounding box
+    BULK_LOAD_HILBERT,
+    // Sort-tile-recursive: slabs along x, then runs along y, then z
+    BULK_LOAD_STR
+};
+
+/** Parse "none", "hilbert" or "str". Returns false for anything else. */
+inline bool BulkLoadOrderFromString(const String& str, BulkLoadOrder* order_out) {
+    if (str == "none") *order_out = BULK_LOAD_NONE;
+    else if (str == "hilbert") *order_out = BULK_LOAD_HILBERT;
+    else if (str == "str") *order_out = BULK_LOAD_STR;
+    else return false;
+    return true;
+}
+
+inline String BulkLoadOrderToString(BulkLoadOrder order) {
+    switch(order) {
+      case BULK_LOAD_HILBERT: return "hilbert";
+      case BULK_LOAD_STR: return "str";
+      default: return "none";
+    }
+}
+
+/** An object to be bulk loaded and the point used to order it. */
+template<typename IDType>
+struct BulkLoadEntry {
+    BulkLoadEntry()
+     : key(0)
+    {}
+    BulkLoadEntry(const IDType& _id, const Vector3f& _pos)
+     : id(_id), pos(_pos), key(0)
+    {}
+
+    IDType id;
+    Vector3f pos;
+    // Scratch space for orderings which sort by a computed key
+    uint64 key;
+};
+
+namespace BulkLoad {
+
+/** Index of the point (x, y, z) along a 3D Hilbert curve covering a grid with
+ *  2^bits cells along each axis. bits must be at most 21 so the index fits in
+ *  64 bits. Uses Skilling's transpose algorithm.
+ */
+inline uint64 HilbertIndex(uint32 x, uint32 y, uint32 z, uint32 bits) {
+    uint32 X[3] = { x, y, z };
+    uint32 M = 1u << (bits - 1);
+
+    // Inverse undo excess work
+    for(uint32 Q = M; Q > 1; Q >>= 1) {
+        uint32 P = Q - 1;
+        for(int i = 0; i < 3; i++) {
+            if (X[i] & Q) {
+                X[0] ^= P;
+            }
+            else {
+                uint32 t = (X[0] ^ X[i]) & P;
+                X[0] ^= t;
+                X[i] ^= t;
+            }
+        }
+    }
+
+    // Gray encode
+    for(int i = 1; i < 3; i++)
+        X[i] ^= X[i-1];
+    uint32 t = 0;
+    for(uint32 Q = M; Q > 1; Q >>= 1)
+        if (X[2] & Q) t ^= Q - 1;
+    for(int i = 0; i < 3; i++)
+        X[i] ^= t;
+
+    // Interleave the transposed form into a single index
+    uint64 index = 0;
+    for(int b = (int)bits - 1; b >= 0; b--)
+        for(int i = 0; i < 3; i++)
+            index = (index << 1) | ((X[i] >> b) & 1);
+    return index;
+}
+
+template<typename IDType>
+struct EntryKeyLess {
+    bool operator()(const BulkLoadEntry<IDType>& lhs, const BulkLoadEntry<IDType>& rhs) const {
+        return lhs.key < rhs.key;
+    }
+};
+
+template<typename IDType>
+struct EntryAxisLess {
+    EntryAxisLess(int _axis) : axis(_axis) {}
+    bool operator()(const BulkLoadEntry<IDType>& lhs, const BulkLoadEntry<IDType>& rhs) const {
+        return lhs.pos[axis] < rhs.pos[axis];
+    }
+    int axis;
+};
+
+template<typename IDType>
+void SortHilbert(std::vector< BulkLoadEntry<IDType> >& entries) {
+    typedef typename std::vector< BulkLoadEntry<IDType> >::iterator EntryIterator;
+    const uint32 bits = 21;
+    const float64 cells = (float64)((1u << bits) - 1);
+
+    Vector3f lo = entries[0].pos, hi = entries[0].pos;
+    for(EntryIterator it = entries.begin(); it != entries.end(); it++) {
+        lo = lo.min(it->pos);
+        hi = hi.max(it->pos);
+    }
+    Vector3f extents = hi - lo;
+    // Use the same scale on all axes so the curve doesn't get stretched
+    float64 scale = std::max(extents.x, std::max(extents.y, extents.z));
+    scale = (scale > 0) ? (cells / scale) : 0;
+
+    for(EntryIterator it = entries.begin(); it != entries.end(); it++) {
+        Vector3f rel = it->pos - lo;
+        it->key = HilbertIndex(
+            (uint32)(rel.x * scale), (uint32)(rel.y * scale), (uint32)(rel.z * scale),
+            bits
+        );
+    }
+    std::sort(entries.begin(), entries.end(), EntryKeyLess<IDType>());
+}
+
+template<typename IDType>
+void SortSTR(typename std::vector< BulkLoadEntry<IDType> >::iterator begin, typename std::vector< BulkLoadEntry<IDType> >::iterator end, int axis, uint32 leaf_size) {
+    std::sort(begin, end, EntryAxisLess<IDType>(axis));
+    if (axis == 2) return;
+
+    // Split into S slabs, where S is chosen so the remaining axes split each
+    // slab into roughly square tiles of full leaves.
+    uint32 n = end - begin;
+    uint32 leaves = (n + leaf_size - 1) / leaf_size;
+    uint32 remaining_axes = 3 - axis;
+    uint32 slabs = (uint32)std::ceil(std::pow((float64)leaves, 1.0 / remaining_axes) - 1e-9);
+    if (slabs < 1) slabs = 1;
+    uint32 slab_size = ((leaves + slabs - 1) / slabs) * leaf_size;
+
+    for(uint32 off = 0; off < n; off += slab_size)
+        SortSTR<IDType>(begin + off, begin + std::min(n, off + slab_size), axis + 1, leaf_size);
+}
+
+} // namespace BulkLoad
+
+/** Reorder entries for insertion in the given order. leaf_size should be the
+ *  number of children per node of the target tree and is only used by STR.
+ */
+template<typename IDType>
+void BulkLoadSort(std::vector< BulkLoadEntry<IDType> >& entries, BulkLoadOrder order, uint32 leaf_size) {
+    if (entries.size() < 2) return;
+
+    switch(order) {
+      case BULK_LOAD_HILBERT:
+        BulkLoad::SortHilbert<IDType>(entries);
+        break;
+      case BULK_LOAD_STR:
+        BulkLoad::SortSTR<IDType>(entries.begin(), entries.end(), 0, std::max(leaf_size, (uint32)1));
+        break;
+      default:
+        break;
+    }
+}
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_LIBCORE_PROX_BULK_LOAD_HPP_
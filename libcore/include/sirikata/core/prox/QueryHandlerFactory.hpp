@@ -9,6 +9,7 @@
 
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/core/options/Options.hpp>
+#include <sirikata/core/prox/BulkLoad.hpp>
 
 #include <prox/geom/BruteForceQueryHandler.hpp>
 #include <prox/geom/RTreeAngleQueryHandler.hpp>
@@ -25,12 +26,15 @@ template<typename SimulationTraits>
 Prox::QueryHandler<SimulationTraits>* QueryHandlerFactory(const String& type, const String& args, bool rebuilding = true) {
     static OptionValue* branching = NULL;
     static OptionValue* rebuild_batch_size = NULL;
+    static OptionValue* bulk_load = NULL;
     if (branching == NULL) {
         branching = new OptionValue("branching", "10", Sirikata::OptionValueType<uint32>(), "Number of children each node should have.");
         rebuild_batch_size = new OptionValue("rebuild-batch-size", "10", Sirikata::OptionValueType<uint32>(), "Number of queries to transition on each iteration when rebuilding. Keep this small to avoid long latencies between updates.");
+        bulk_load = new OptionValue("bulk-load", "none", Sirikata::OptionValueType<String>(), "Order to insert batches of new objects in, packing nearby objects into the same nodes: none, hilbert, or str (sort-tile-recursive). none inserts objects one at a time as they arrive. Only used by location caches which batch new objects.");
         Sirikata::InitializeClassOptions ico("query_handler", NULL,
             branching,
             rebuild_batch_size,
+            bulk_load,
             NULL);
     }
 
@@ -39,6 +43,7 @@ Prox::QueryHandler<SimulationTraits>* QueryHandlerFactory(const String& type, co
     // Since these options end up being shared if you instantiate multiple
     // QueryHandlers, reset them each time.
     branching->unsafeAs<uint32>() = 10;
+    bulk_load->unsafeAs<String>() = "none";
 
     OptionSet* optionsSet = OptionSet::getOptions("query_handler", NULL);
     optionsSet->parse(args);
@@ -89,4 +94,20 @@ Prox::QueryHandler<SimulationTraits>* QueryHandlerFactory(const String& type, co
     }
 }
 
+/** Get the order in which batches of new objects should be inserted into a
+ *  query handler created with the given arguments, and the leaf size to pack
+ *  them for. Must be called after QueryHandlerFactory, which registers the
+ *  options.
+ */
+inline void QueryHandlerBulkLoadSettings(const String& args, BulkLoadOrder* order_out, uint32* leaf_size_out) {
+    OptionSet* optionsSet = OptionSet::getOptions("query_handler", NULL);
+    optionsSet->referenceOption("branching")->unsafeAs<uint32>() = 10;
+    optionsSet->referenceOption("bulk-load")->unsafeAs<String>() = "none";
+    optionsSet->parse(args);
+
+    *leaf_size_out = optionsSet->referenceOption("branching")->as<uint32>();
+    if (!BulkLoadOrderFromString(optionsSet->referenceOption("bulk-load")->as<String>(), order_out))
+        *order_out = BULK_LOAD_NONE;
+}
+
 } // namespace Sirikata
@@ -0,0 +1,217 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_QUEUE_DRR_QUEUE_HPP_
+#define _SIRIKATA_CORE_QUEUE_DRR_QUEUE_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+
+namespace Sirikata {
+
+/** Weighted fair queue using deficit round robin, with one FIFO of Messages
+ *  per Key. Unlike FairQueue, which orders messages by virtual finish time,
+ *  push and pop take constant time regardless of the number of flows. Flows
+ *  are created as messages arrive for them and backlogged flows are visited
+ *  in turn, each sending messages while its deficit covers them and then
+ *  earning another quantum scaled by its weight.
+ *
+ *  Weights are relative to a flow which earns quantum bytes per round. For
+ *  pop() to stay constant time, weights should be normalized so the smallest
+ *  is around 1 and quantum should be at least the typical message size, so a
+ *  flow can send at least one message whenever it is visited.
+ *
+ *  Flows are kept until they have been idle for a whole period between
+ *  calls to collectStats(), so their weights survive brief pauses.
+ *  Messages are not owned by the queue. Not thread safe.
+ */
+template <class Message, class Key, class Hasher = std::tr1::hash<Key> >
+class DRRQueue {
+public:
+    struct FlowStats {
+        Key key;
+        float32 weight;
+        // Bytes popped since the last call to collectStats
+        uint64 sent;
+        uint32 queuedBytes;
+    };
+    typedef std::vector<FlowStats> FlowStatsList;
+    typedef std::vector<Key> KeyList;
+
+    DRRQueue(uint32 max_bytes, uint32 quantum)
+     : mMaxBytes(max_bytes),
+       mQuantum(std::max(quantum, (uint32)1)),
+       mDefaultWeight(1.f),
+       mQueuedBytes(0)
+    {
+    }
+
+    /** Queue msg in key's flow, creating the flow with the default weight if
+     *  it doesn't exist yet. Returns false if the queue is full.
+     */
+    bool push(const Key& key, const Message& msg, uint32 size) {
+        if (mQueuedBytes + size > mMaxBytes)
+            return false;
+
+        typename FlowMap::iterator it = mFlows.find(key);
+        if (it == mFlows.end())
+            it = mFlows.insert( typename FlowMap::value_type(key, Flow(key, mDefaultWeight, quantumFor(mDefaultWeight))) ).first;
+        Flow* flow = &(it->second);
+
+        flow->messages.push_back( QueuedMessage(msg, size) );
+        flow->queuedBytes += size;
+        mQueuedBytes += size;
+
+        if (!flow->active) {
+            // A flow becoming backlogged gets its quantum for this round
+            // immediately
+            flow->active = true;
+            flow->deficit = flow->quantum;
+            mActive.push_back(flow);
+        }
+        return true;
+    }
+
+    /** Remove the next message, returning false if the queue is empty. */
+    bool pop(Message* msg_out, Key* key_out = NULL) {
+        while(!mActive.empty()) {
+            Flow* flow = mActive.front();
+            QueuedMessage& head = flow->messages.front();
+            if (flow->deficit < head.size) {
+                // Out of credit for this round, move on to the next flow
+                flow->deficit += flow->quantum;
+                mActive.pop_front();
+                mActive.push_back(flow);
+                continue;
+            }
+
+            flow->deficit -= head.size;
+            flow->queuedBytes -= head.size;
+            flow->sent += head.size;
+            mQueuedBytes -= head.size;
+            *msg_out = head.msg;
+            if (key_out != NULL)
+                *key_out = flow->key;
+            flow->messages.pop_front();
+
+            // Idle flows don't get to save up credit
+            if (flow->messages.empty()) {
+                flow->active = false;
+                flow->deficit = 0;
+                mActive.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool empty() const {
+        return mActive.empty();
+    }
+
+    /** Total size of queued messages in bytes. */
+    uint32 size() const {
+        return mQueuedBytes;
+    }
+
+    uint32 numFlows() const {
+        return mFlows.size();
+    }
+
+    /** Set the weight of key's flow. Returns false if there is no such flow. */
+    bool setWeight(const Key& key, float32 weight) {
+        typename FlowMap::iterator it = mFlows.find(key);
+        if (it == mFlows.end())
+            return false;
+        it->second.weight = weight;
+        it->second.quantum = quantumFor(weight);
+        return true;
+    }
+
+    /** Set the weight given to new flows. */
+    void setDefaultWeight(float32 weight) {
+        mDefaultWeight = weight;
+    }
+
+    /** Get statistics for every flow and reset their sent counts. Flows which
+     *  have been idle since the last call are removed instead, and their keys
+     *  added to removed_out if it isn't NULL.
+     */
+    void collectStats(FlowStatsList* stats_out, KeyList* removed_out = NULL) {
+        typename FlowMap::iterator it = mFlows.begin();
+        while(it != mFlows.end()) {
+            Flow& flow = it->second;
+            if (!flow.active && flow.sent == 0) {
+                if (removed_out != NULL)
+                    removed_out->push_back(it->first);
+                mFlows.erase(it++);
+                continue;
+            }
+
+            FlowStats stats;
+            stats.key = it->first;
+            stats.weight = flow.weight;
+            stats.sent = flow.sent;
+            stats.queuedBytes = flow.queuedBytes;
+            stats_out->push_back(stats);
+
+            flow.sent = 0;
+            it++;
+        }
+    }
+
+private:
+    struct QueuedMessage {
+        QueuedMessage(const Message& m, uint32 s)
+         : msg(m), size(s)
+        {}
+
+        Message msg;
+        uint32 size;
+    };
+
+    struct Flow {
+        Flow(const Key& k, float32 w, uint32 q)
+         : key(k),
+           weight(w),
+           quantum(q),
+           deficit(0),
+           queuedBytes(0),
+           sent(0),
+           active(false)
+        {}
+
+        Key key;
+        std::deque<QueuedMessage> messages;
+        float32 weight;
+        uint32 quantum;
+        uint64 deficit;
+        uint32 queuedBytes;
+        uint64 sent;
+        // Whether the flow is backlogged, i.e. in mActive
+        bool active;
+    };
+    // Elements of an unordered_map aren't moved by rehashing, so mActive can
+    // point directly at them
+    typedef std::tr1::unordered_map<Key, Flow, Hasher> FlowMap;
+
+    // A quantum larger than the whole queue is no different from one equal to
+    // it, and capping it keeps large weight ratios from overflowing
+    uint32 quantumFor(float32 weight) const {
+        float64 quantum = std::min((float64)weight * mQuantum, (float64)std::max(mMaxBytes, mQuantum));
+        return std::max((uint32)1, (uint32)quantum);
+    }
+
+    const uint32 mMaxBytes;
+    const uint32 mQuantum;
+    float32 mDefaultWeight;
+    uint32 mQueuedBytes;
+
+    FlowMap mFlows;
+    // Backlogged flows in round robin order
+    std::deque<Flow*> mActive;
+}; // class DRRQueue
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_QUEUE_DRR_QUEUE_HPP_
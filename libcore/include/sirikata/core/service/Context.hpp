@@ -42,6 +42,7 @@
 #include "Service.hpp"
 #include "Signal.hpp"
 #include <sirikata/core/trace/TimeSeries.hpp>
+#include <sirikata/core/trace/Metrics.hpp>
 
 #define FORCE_MONOTONIC_CLOCK 1
 
@@ -166,6 +167,8 @@ public:
     TimeProfiler* profiler;
 
     Trace::TimeSeries* timeSeries;
+    // Flushed to timeSeries periodically while the Context is running
+    Trace::MetricsRegistry* metrics;
 protected:
 
     // Main Lifetime Management
@@ -0,0 +1,186 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_TRACE_METRICS_HPP_
+#define _SIRIKATA_CORE_TRACE_METRICS_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <sirikata/core/trace/TimeSeries.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+class Poller;
+
+namespace Trace {
+
+/** A count of events, e.g. messages forwarded, which is reported as a rate per
+ *  second over each flush interval. Updating it is a single atomic add.
+ */
+class SIRIKATA_EXPORT MetricCounter : Noncopyable {
+public:
+    MetricCounter()
+     : mCount(0),
+       mTaken(0)
+    {}
+
+    void operator++(int) { mCount++; }
+    void operator+=(uint64 n) { mCount += n; }
+
+    /// The total count since the counter was created
+    uint64 total() const { return mCount.read(); }
+
+    /** Get the count since the last call. Only the registry should call this,
+     *  since each call consumes the count.
+     */
+    uint64 take() {
+        uint64 cur = mCount.read();
+        uint64 val = cur - mTaken;
+        mTaken = cur;
+        return val;
+    }
+
+private:
+    AtomicValue<uint64> mCount;
+    // Only touched when flushing
+    uint64 mTaken;
+};
+
+/** A value sampled at each flush, e.g. a queue length. Only the most recent
+ *  value set before a flush is reported.
+ */
+class SIRIKATA_EXPORT MetricGauge : Noncopyable {
+public:
+    MetricGauge()
+     : mBits(0)
+    {}
+
+    void set(float64 val) {
+        uint64 bits;
+        memcpy(&bits, &val, sizeof(bits));
+        mBits = bits;
+    }
+    float64 read() const {
+        uint64 bits = mBits.read();
+        float64 val;
+        memcpy(&val, &bits, sizeof(val));
+        return val;
+    }
+
+private:
+    // Stored as raw bits since there are no atomic floating point types
+    AtomicValue<uint64> mBits;
+};
+
+/** A distribution of non-negative integer values, e.g. latencies in
+ *  microseconds, using log-linear buckets as HDR histograms do: each power of
+ *  two range is split into SUB_BUCKETS/2 equal buckets, so any value is
+ *  recorded to within about 6% using a fixed, small amount of memory.
+ *  Recording a value is a couple of atomic adds. Each flush reports the
+ *  count, mean, 50th, 90th and 99th percentiles and max of the values recorded
+ *  during that interval.
+ */
+class SIRIKATA_EXPORT MetricHistogram : Noncopyable {
+public:
+    enum {
+        SUB_BUCKET_BITS = 5,
+        SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+        // Larger values are clamped
+        MAX_VALUE_BITS = 40,
+        NUM_BUCKETS = SUB_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * (SUB_BUCKETS / 2)
+    };
+
+    MetricHistogram();
+
+    void record(uint64 val);
+    void record(const Duration& dur) {
+        int64 us = dur.toMicroseconds();
+        record(us < 0 ? 0 : (uint64)us);
+    }
+
+    struct Summary {
+        Summary()
+         : count(0), mean(0), p50(0), p90(0), p99(0), max(0)
+        {}
+        uint64 count;
+        float64 mean;
+        uint64 p50, p90, p99, max;
+    };
+    /** Summarize the values recorded since the last call and reset. Values
+     *  recorded concurrently may be split across two summaries but are never
+     *  lost. Reported percentiles and max are the upper bounds of buckets.
+     */
+    Summary take();
+
+    static uint32 bucketIndex(uint64 val);
+    /// The largest value which falls into the given bucket.
+    static uint64 bucketUpperBound(uint32 idx);
+
+private:
+    AtomicValue<uint32> mBuckets[NUM_BUCKETS];
+    AtomicValue<uint64> mSum;
+};
+
+/** MetricsRegistry holds the metrics for a Context. Components look up their
+ *  metrics by name once, usually when they're constructed, and then update
+ *  them directly, which is cheap enough to do on every event. Periodically the
+ *  registry aggregates every metric and hands them to the Context's TimeSeries
+ *  as a single batch, so the amount of data reported depends only on the
+ *  number of metrics and the flush interval, not on how often they're updated.
+ *
+ *  Metric names follow the same hierarchical convention as TimeSeries keys.
+ *  Looking up an existing name returns the same metric. Metrics live as long
+ *  as the registry.
+ */
+class SIRIKATA_EXPORT MetricsRegistry : Noncopyable {
+public:
+    MetricsRegistry(Context* ctx, const Duration& interval = Duration::seconds(1));
+    ~MetricsRegistry();
+
+    MetricCounter* counter(const String& name);
+    MetricGauge* gauge(const String& name);
+    MetricHistogram* histogram(const String& name);
+
+    /** Set how often metrics are flushed. Takes effect the next time the
+     *  registry is started.
+     */
+    void setFlushInterval(const Duration& interval);
+
+    void start();
+    /** Stops periodic flushing and flushes whatever has accumulated since the
+     *  last interval.
+     */
+    void stop();
+
+    /** Aggregate all metrics and report them. Normally called periodically,
+     *  but may be called directly, e.g. to get results before shutting down.
+     */
+    void flush();
+
+private:
+    template<typename MetricType>
+    MetricType* lookup(std::map<String, MetricType*>& metrics, const String& name);
+
+    Context* mContext;
+    Duration mInterval;
+    Poller* mFlushPoller;
+    Time mLastFlush;
+
+    // Protects the maps, not the metrics, which are updated without locking
+    boost::mutex mMutex;
+    typedef std::map<String, MetricCounter*> CounterMap;
+    CounterMap mCounters;
+    typedef std::map<String, MetricGauge*> GaugeMap;
+    GaugeMap mGauges;
+    typedef std::map<String, MetricHistogram*> HistogramMap;
+    HistogramMap mHistograms;
+
+    TimeSeries::SampleList mSamples;
+};
+
+} // namespace Trace
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_TRACE_METRICS_HPP_
@@ -58,7 +58,29 @@ class SIRIKATA_EXPORT TimeSeries {
 
     virtual void report(const String& name, float64 val);
 
+    struct Sample {
+        Sample(const String& n, float64 v)
+         : name(n), value(v)
+        {}
+        String name;
+        float64 value;
+    };
+    typedef std::vector<Sample> SampleList;
+    /** Report a set of values for the same point in time, e.g. the contents of
+     *  a MetricsRegistry. Implementations which send data elsewhere should
+     *  override this to send the whole batch at once. The default just calls
+     *  report() for each sample.
+     */
+    virtual void reportBatch(const SampleList& samples);
+
   protected:
+    /// The current real time as seconds since the Unix epoch.
+    int64 unixTimestamp() const;
+    /** Append a sample in Graphite's plaintext format, i.e. a
+     *  "name value timestamp" line, to out.
+     */
+    static void appendPlaintext(String* out, const String& name, float64 val, int64 timestamp);
+
     Context* mContext;
 }; // class TimeSeries
 
@@ -32,6 +32,7 @@ public:
     virtual void addRequest(TransferRequestPtr req) {
         if (!req) {
             mDeltaQueue.push(req);
+            notifyRequestsAvailable();
             return;
         }
 
@@ -102,6 +103,7 @@ public:
         setRequestPriority(it->second.aggregateRequest, mAggregationAlgorithm->aggregate(it->second.inputRequests));
 
         mDeltaQueue.push(it->second.aggregateRequest);
+        notifyRequestsAvailable();
     }
 
     //Updates priority of a request in the pool
@@ -123,6 +125,7 @@ public:
         // Update aggregate priority
         setRequestPriority(it->second.aggregateRequest, mAggregationAlgorithm->aggregate(it->second.inputRequests));
         mDeltaQueue.push(it->second.aggregateRequest);
+        notifyRequestsAvailable();
     }
 
     //Updates priority of a request in the pool
@@ -159,6 +162,7 @@ public:
             setRequestPriority(it->second.aggregateRequest, mAggregationAlgorithm->aggregate(it->second.inputRequests));
             mDeltaQueue.push(it->second.aggregateRequest);
         }
+        notifyRequestsAvailable();
 
     }
 
@@ -173,11 +177,9 @@ private:
         mAggregationAlgorithm = new MaxPriorityAggregation();
     }
 
-    //Returns an item from the pool. Blocks if pool is empty.
-    inline std::tr1::shared_ptr<TransferRequest> getRequest() {
-        std::tr1::shared_ptr<TransferRequest> retval;
-        mDeltaQueue.blockingPop(retval);
-        return retval;
+    //Returns all items currently in the pool. Never blocks.
+    inline void getRequests(std::deque<TransferRequestPtr>* reqs) {
+        mDeltaQueue.popAll(reqs);
     }
 
 
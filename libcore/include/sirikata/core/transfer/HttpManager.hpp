@@ -54,6 +54,11 @@
 #include <sirikata/core/network/Asio.hpp>
 #include <sirikata/core/network/Address.hpp>
 #include <sirikata/core/transfer/TransferData.hpp>
+#include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/util/Time.hpp>
+
+// Avoid pulling zlib into everything that uses HttpManager
+struct z_stream_s;
 
 
 // This is a hack around a problem created by different packages
@@ -162,10 +167,13 @@ public:
         LAST_HEADER_CB mLastCallback;
         bool mHeaderComplete;
         bool mMessageComplete;
-        http_parser_settings mHttpSettings;
-        http_parser mHttpParser;
         bool mGzip;
-        std::stringstream mCompressedStream;
+        // Incremental gzip decoder, created when the first compressed body
+        // data arrives.
+        z_stream_s* mInflater;
+        bool mInflateComplete;
+        // Number of body bytes received, before decompression
+        uint64 mBodyBytes;
         //
 
         Headers mHeaders;
@@ -173,10 +181,10 @@ public:
         ssize_t mContentLength;
         unsigned short mStatusCode;
 
-        HttpResponse()
-            : mLastCallback(NONE), mHeaderComplete(false), mMessageComplete(false),
-              mGzip(false), mContentLength(0), mStatusCode(0) {}
+        HttpResponse();
     public:
+        ~HttpResponse();
+
         inline std::tr1::shared_ptr<DenseData> getData() { return mData; }
         inline const Headers& getHeaders() { return mHeaders; }
         inline StringDictionary getRawHeaders() {
@@ -346,34 +354,127 @@ private:
         LAST_HEADER_CB mLastCallback;
         bool mHeaderComplete;
         Headers mHeaders;
+        //When the request was written to a connection
+        Time mSentTime;
+        //When the server could start on this request, i.e. the later of
+        //mSentTime and the previous response on the connection finishing
+        Time mServiceStart;
+        //When response headers arrived and when the response finished
+        Time mHeadersTime;
+        Time mCompleteTime;
+    };
+
+    typedef std::tr1::shared_ptr<HttpRequest> HttpRequestPtr;
+
+    /* A persistent connection to a single host:port pair. Requests assigned
+     * to a connection are written immediately, even if earlier requests
+     * haven't received a response yet (pipelining), and responses are parsed
+     * from the socket in order with a single parser.
+     */
+    class HttpConnection {
+    public:
+        HttpConnection(const Sirikata::Network::Address& _addr, Sirikata::Network::IOService* service);
+
+        const Sirikata::Network::Address addr;
+        std::tr1::shared_ptr<TCPSocket> socket;
+
+        //Lock this to access any of the fields below
+        boost::mutex mMutex;
+        //False until the socket has connected
+        bool mConnected;
+        //Once closed, no more requests will be assigned to the connection
+        bool mClosed;
+        //Set when a response asked for the connection to be closed
+        bool mCloseAfterResponse;
+        //Requests assigned to this connection which haven't received a full response
+        std::deque<HttpRequestPtr> mPending;
+        //Requests which haven't been written to the socket yet
+        std::deque<HttpRequestPtr> mWriteQueue;
+        bool mWriting;
+        //Responses finished by the parser, waiting to be dispatched
+        std::deque<std::pair<HttpRequestPtr, HttpResponsePtr> > mCompleted;
+        //Number of responses received on this connection
+        uint32 mNumServed;
+        //When the last response finished, used to measure service time of
+        //pipelined requests
+        Time mLastComplete;
+
+        //The parser persists across responses on the same connection
+        http_parser_settings mHttpSettings;
+        http_parser mHttpParser;
+        HttpResponsePtr mResponse;
+        std::vector<unsigned char> mReadBuffer;
     };
+    typedef std::tr1::shared_ptr<HttpConnection> HttpConnectionPtr;
 
     //Holds a queue of requests to be made
-    typedef std::list<std::tr1::shared_ptr<HttpRequest> > RequestQueueType;
+    typedef std::list<HttpRequestPtr> RequestQueueType;
     RequestQueueType mRequestQueue;
     //Lock this to access mRequestQueue
     boost::mutex mRequestQueueLock;
 
-    //TODO: should get these from settings
-    static const uint32 MAX_CONNECTIONS_PER_ENDPOINT = 8;  
-    static const uint32 MAX_TOTAL_CONNECTIONS = 40;  
     static const uint32 SOCKET_BUFFER_SIZE = 10240;
-
+    //Number of times a request is retried after connection failures
+    static const uint32 MAX_REQUEST_TRIES = 10;
+    //Upper bound on how much space is preallocated for a response body
+    static const uint32 MAX_PREALLOCATE_SIZE = 64*1024*1024;
+    //Expected ratio of decompressed to compressed size of gzip'd responses
+    static const uint32 GZIP_EXPANSION_ESTIMATE = 4;
+    //Size of the output window used when inflating gzip'd responses
+    static const uint32 INFLATE_CHUNK_SIZE = 16384;
+
+    //Limits, from the http.* options
+    uint32 mMaxConnectionsPerEndpoint;
+    uint32 mMaxTotalConnections;
+    uint32 mMaxPipelineDepth;
+
+    //All open (or opening) connections, per host:port pair
+    typedef std::list<HttpConnectionPtr> ConnectionList;
+    typedef std::map<Sirikata::Network::Address, ConnectionList> ConnectionMap;
+    ConnectionMap mConnections;
     //Keeps track of the total number of connections currently open
     uint32 mNumTotalConnections;
+    //Lock this to access mConnections or mNumTotalConnections. If a
+    //connection's lock is also needed, this must be acquired first.
+    boost::mutex mConnectionsLock;
+
+public:
+    /* Statistics for requests made to a single host:port pair. RTT is
+     * measured from when a request is sent (or the previous response on the
+     * same connection finishes, if later) to when the response headers
+     * arrive. Throughput covers the response body over the same period.
+     * Both are exponentially weighted moving averages.
+     */
+    struct EndpointStats {
+        EndpointStats()
+         : connections(0), responses(0), reused(0), pipelined(0),
+           failures(0), bytes(0), rtt(Duration::zero()), throughput(0)
+        {}
+
+        uint32 connections;
+        uint32 responses;
+        // Requests sent on a connection which already served a response
+        uint32 reused;
+        // Requests sent while another was still outstanding on the connection
+        uint32 pipelined;
+        uint32 failures;
+        uint64 bytes;
+        Duration rtt;
+        // Bytes per second
+        double throughput;
+    };
+    typedef std::map<String, EndpointStats> EndpointStatsMap;
 
-    //Keeps track of the number of connections open per host:port pair
-    typedef std::map<Sirikata::Network::Address, uint32> NumConnsType;
-    NumConnsType mNumConnsPerAddr;
-    //Lock this to access mNumTotalConnections or mNumConnsPerAddr
-    boost::mutex mNumConnsLock;
+    /** Get a snapshot of the per-endpoint statistics, keyed by host:port. */
+    EndpointStatsMap getEndpointStats();
 
-    //Holds connections that are open but not being used
-    typedef std::map<Sirikata::Network::Address,
-        std::queue<std::tr1::shared_ptr<TCPSocket> > > RecycleBinType;
-    RecycleBinType mRecycleBin;
-    //Lock this to access mRecycleBin
-    boost::mutex mRecycleBinLock;
+    /** Commander handler which reports per-endpoint statistics. */
+    void commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+
+private:
+    EndpointStatsMap mStats;
+    //Lock this to access mStats
+    boost::mutex mStatsLock;
 
     IOServicePool* mServicePool;
     TCPResolver* mResolver;
@@ -382,19 +483,35 @@ private:
 
     void processQueue();
 
-    void add_req(std::tr1::shared_ptr<HttpRequest> req);
-    void decrement_connection(const Sirikata::Network::Address& addr);
-    void write_request(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req);
-
-    void handle_resolve(std::tr1::shared_ptr<HttpRequest> req, const boost::system::error_code& err,
+    void add_req(HttpRequestPtr req);
+    //Tries to find or open a connection for req. Must hold mConnectionsLock.
+    bool assign_request(HttpRequestPtr req);
+    //Adds req to conn. Must hold conn->mMutex.
+    void assign_to_connection(HttpConnectionPtr conn, HttpRequestPtr req);
+    //Starts writing any unwritten requests. Must hold conn->mMutex.
+    void start_write(HttpConnectionPtr conn);
+    void start_read(HttpConnectionPtr conn);
+    //Closes the connection, retrying any requests still outstanding on it
+    void close_connection(HttpConnectionPtr conn, const boost::system::error_code& err);
+    void retry_or_fail(HttpRequestPtr req, const boost::system::error_code& err);
+    void handle_response(HttpRequestPtr req, HttpResponsePtr resp);
+    static void reset_response(HttpConnection* conn);
+
+    void handle_resolve(HttpConnectionPtr conn, const boost::system::error_code& err,
             TCPResolver::iterator endpoint_iterator);
-    void handle_connect(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req,
-            const boost::system::error_code& err, TCPResolver::iterator endpoint_iterator);
-    void handle_write_request(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req,
+    void handle_connect(HttpConnectionPtr conn, const boost::system::error_code& err,
+            TCPResolver::iterator endpoint_iterator);
+    void handle_write_request(HttpConnectionPtr conn, std::vector<HttpRequestPtr> written,
             const boost::system::error_code& err, std::tr1::shared_ptr<boost::asio::streambuf> request_stream);
-    void handle_read(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req,
-            std::tr1::shared_ptr<std::vector<unsigned char> > vecbuf, std::tr1::shared_ptr<HttpResponse> respPtr,
-            const boost::system::error_code& err, std::size_t bytes_transferred);
+    void handle_read(HttpConnectionPtr conn, const boost::system::error_code& err, std::size_t bytes_transferred);
+
+    void record_connection(const Sirikata::Network::Address& addr);
+    void record_failure(const Sirikata::Network::Address& addr);
+    void record_sent(const Sirikata::Network::Address& addr, bool reused, bool pipelined);
+    void record_response(const Sirikata::Network::Address& addr, const Duration& rtt, const Duration& total, uint64 bytes);
+
+    //Decompresses gzip'd body data into resp->mData as it arrives
+    static bool inflate_body(HttpResponse* resp, const char* at, size_t len);
 
     static int on_header_field(http_parser *_, const char *at, size_t len);
     static int on_header_value(http_parser *_, const char *at, size_t len);
@@ -415,7 +532,7 @@ private:
       , F_SKIPBODY = 1 << 5
       };
 
-    static void print_flags(std::tr1::shared_ptr<HttpResponse> resp);
+    static void print_flags(const http_parser& parser, std::tr1::shared_ptr<HttpResponse> resp);
 
 public:
 
@@ -0,0 +1,183 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_TRANSFER_SEGMENTED_DISK_CACHE_LAYER_HPP_
+#define _SIRIKATA_CORE_TRANSFER_SEGMENTED_DISK_CACHE_LAYER_HPP_
+
+#include <sirikata/core/transfer/CacheLayer.hpp>
+#include <sirikata/core/transfer/CacheMap.hpp>
+#include <sirikata/core/queue/ThreadSafeQueue.hpp>
+#include <sirikata/core/util/Thread.hpp>
+
+namespace Sirikata {
+namespace Transfer {
+
+/** Disk cache which stores data in a few large, append-only segment files
+ *  rather than one file per fingerprint. Each piece of data written to the
+ *  cache is appended to a segment and recorded in a compact binary index, so
+ *  startup only needs to replay the index rather than scan and re-read every
+ *  cached file.
+ *
+ *  Fingerprints are divided into shards. Each shard has its own segments,
+ *  index file and worker thread, so reads and writes for different shards
+ *  proceed in parallel. Where supported, segments are memory mapped and reads
+ *  return DenseData referring directly to the mapping instead of copying.
+ *
+ *  Evicted data leaves holes in the segments. When a shard is idle, segments
+ *  that are mostly dead are compacted by copying their remaining data to the
+ *  current segment and deleting them.
+ */
+class SIRIKATA_EXPORT SegmentedDiskCacheLayer : public CacheLayer {
+public:
+    /// Default maximum size of a single segment file
+    static const cache_usize_type DEFAULT_SEGMENT_SIZE;
+
+    /** Create a SegmentedDiskCacheLayer.
+     *  @param policy CachePolicy which limits the space used by this layer
+     *  @param prefix directory to store data in. Relative paths are placed in
+     *         the temporary directory.
+     *  @param tryNext the next layer to try if data isn't cached here
+     *  @param num_shards number of shards, and therefore I/O threads
+     *  @param segment_size maximum size of a single segment file
+     */
+    SegmentedDiskCacheLayer(CachePolicy *policy, const std::string &prefix, CacheLayer *tryNext,
+        uint32 num_shards = 4, cache_usize_type segment_size = DEFAULT_SEGMENT_SIZE);
+    virtual ~SegmentedDiskCacheLayer();
+
+    virtual void purgeFromCache(const Fingerprint &fileId);
+    virtual void getData(const Fingerprint &fileId, const Range &requestedRange,
+        const TransferCallback&callback);
+
+protected:
+    virtual void populateCache(const Fingerprint& fileId, const DenseDataPtr &data);
+    virtual void destroyCacheEntry(const Fingerprint &fileId, CacheEntry *cacheLayerData, cache_usize_type releaseSize);
+
+private:
+    // A contiguous block of data stored in a segment
+    struct Piece {
+        Piece(uint32 seg, cache_usize_type off, const Range& r)
+         : segment(seg), offset(off), range(r)
+        {}
+
+        uint32 segment;
+        cache_usize_type offset;
+        Range range;
+    };
+    typedef std::vector<Piece> PieceList;
+
+    struct CacheData : public CacheEntry {
+        PieceList mPieces;
+        RangeList mRanges;
+
+        bool contains(const Range &range) const {
+            return range.isContainedBy(mRanges);
+        }
+    };
+
+    // A single append-only segment file
+    struct Segment {
+        Segment(uint32 _id, int _fd, cache_usize_type _size, cache_usize_type _capacity);
+        ~Segment();
+
+        uint32 id;
+        int fd;
+        // Bytes written, bytes still referenced by the index and maximum size
+        cache_usize_type size;
+        cache_usize_type live;
+        cache_usize_type capacity;
+        // Read-only mapping of the entire capacity, or NULL if mapping isn't
+        // supported or failed
+        const unsigned char* map;
+    };
+    typedef std::tr1::shared_ptr<Segment> SegmentPtr;
+    typedef std::map<uint32, SegmentPtr> SegmentMap;
+
+    struct DiskRequest {
+        enum Operation {OPREAD, OPWRITE, OPDELETE, OPEXIT} op;
+
+        DiskRequest(Operation _op, const Fingerprint &id)
+         : op(_op), fileId(id), toRead(true)
+        {}
+
+        Fingerprint fileId;
+        Range toRead;
+        TransferCallback finished;
+        DenseDataPtr data;
+        // Pieces to remove for OPDELETE
+        PieceList pieces;
+    };
+    typedef std::tr1::shared_ptr<DiskRequest> DiskRequestPtr;
+
+    // All state in a Shard other than the queue is only accessed by its worker
+    // thread, or before the workers are started.
+    struct Shard {
+        Shard(uint32 _index)
+         : index(_index), indexFd(-1), nextSegment(0),
+           indexRecords(0), livePieces(0), worker(NULL)
+        {}
+
+        uint32 index;
+        SegmentMap segments;
+        SegmentPtr active;
+        int indexFd;
+        uint32 nextSegment;
+        // Records in the index file vs. pieces still live, used to decide
+        // when the index should be rewritten
+        uint64 indexRecords;
+        uint64 livePieces;
+
+        ThreadSafeQueue<DiskRequestPtr> queue;
+        Thread* worker;
+    };
+    typedef std::vector<Shard*> ShardList;
+
+    // Operations recorded in the index
+    enum IndexOp {
+        INDEX_PUT = 1,
+        INDEX_DELETE = 2
+    };
+
+    Shard* getShard(const Fingerprint& fileId);
+
+    std::string segmentPath(uint32 shard, uint32 segment) const;
+    std::string indexPath(uint32 shard) const;
+
+    // Startup
+    void load(Shard* shard);
+    SegmentPtr openSegment(Shard* shard, uint32 id, bool create, cache_usize_type capacity);
+
+    // Worker thread and request handlers
+    void workerThread(Shard* shard);
+    void handleRead(Shard* shard, DiskRequestPtr req);
+    void handleWrite(Shard* shard, DiskRequestPtr req);
+    void handleDelete(Shard* shard, DiskRequestPtr req);
+
+    // Appends data to the active segment, creating a new one if necessary.
+    bool appendData(Shard* shard, const unsigned char* data, cache_usize_type len, Piece* piece_out);
+    DenseDataPtr readPiece(Shard* shard, const Piece& piece);
+
+    void appendIndex(Shard* shard, IndexOp op, const Fingerprint& fileId, const Piece& piece);
+    // Rewrites the index file with only the live pieces
+    void rewriteIndex(Shard* shard);
+    // Collects all pieces belonging to the shard, optionally only those in
+    // a single segment.
+    void collectPieces(Shard* shard, std::vector<std::pair<Fingerprint, Piece> >* out, bool all, uint32 segment);
+
+    // Compacts at most one segment with a low fraction of live data. Returns
+    // true if a segment was compacted.
+    bool compactOne(Shard* shard);
+    void removeSegment(Shard* shard, SegmentMap::iterator it);
+
+    CacheMap mFiles;
+    std::string mPrefix; // directory name with trailing slash.
+    const cache_usize_type mSegmentSize;
+
+    ShardList mShards;
+    bool mCleaningUp; // do not delete any data.
+};
+
+}
+}
+
+#endif //_SIRIKATA_CORE_TRANSFER_SEGMENTED_DISK_CACHE_LAYER_HPP_
@@ -43,40 +43,64 @@ namespace Transfer {
 /// Represents a single block of data, and also knows the range of the file it came from.
 class DenseData : Noncopyable, public Range {
 	std::vector<unsigned char> mData;
+	// Data owned by another object, e.g. a memory mapped file, which is kept
+	// alive by mExternalOwner. It is copied into mData before any
+	// modification.
+	const unsigned char* mExternal;
+	std::tr1::shared_ptr<void> mExternalOwner;
 
     // All too easy to mix up string constructors (binarydata,length) with (string,startbyte)
-	DenseData(const char *str, size_t len) : Range(false) {}
-	DenseData(const unsigned char *str, size_t len) : Range(false) {}
+	DenseData(const char *str, size_t len) : Range(false), mExternal(NULL) {}
+	DenseData(const unsigned char *str, size_t len) : Range(false), mExternal(NULL) {}
+
+	inline void copyExternal() {
+		if (mExternal == NULL) return;
+		mData.assign(mExternal, mExternal + (size_t)length());
+		mExternal = NULL;
+		mExternalOwner.reset();
+	}
 
 public:
 	DenseData(const Range &range)
-			:Range(range) {
+			:Range(range), mExternal(NULL) {
 		if (range.length()) {
 			mData.resize((std::vector<unsigned char>::size_type)range.length());
 		}
 	}
 
 	DenseData(const std::string &str, Range::base_type start=0, bool wholeFile=true)
-			:Range(start, str.length(), LENGTH, wholeFile) {
+			:Range(start, str.length(), LENGTH, wholeFile), mExternal(NULL) {
 		setLength(str.length(), wholeFile);
 		std::copy(str.begin(), str.end(), writableData());
 	}
 
 	DenseData(const Range& range, const char* str)
-        : Range(range), mData(str, str+range.length()) {
+        : Range(range), mData(str, str+range.length()), mExternal(NULL) {
 	    if(range.length() == 0)
 	        throw std::invalid_argument("Tried to create DenseData with length of 0");
 	}
 
 	DenseData(const Range& range, const std::vector<unsigned char>& data)
-        : Range(range), mData(data) {
+        : Range(range), mData(data), mExternal(NULL) {
 	    if(range.length() != data.size()) {
 	        throw std::invalid_argument("Tried to create DenseData with vector length not equal to Range");
 	    }
 	}
 
+	/** Wraps range.length() bytes at data without copying them. owner must
+	 *  keep the data valid and is held until this DenseData is destroyed or
+	 *  modified.
+	 */
+	DenseData(const Range& range, const unsigned char* data, const std::tr1::shared_ptr<void>& owner)
+        : Range(range), mExternal(data), mExternalOwner(owner) {
+	    if(range.length() == 0)
+	        throw std::invalid_argument("Tried to create DenseData with length of 0");
+	}
+
 	/// equals dataAt(startbyte()).
 	inline const unsigned char *data() const {
+	    if (mExternal != NULL)
+	        return mExternal;
 	    if(mData.size() == 0)
 	        throw std::length_error("Tried to get a const pointer to DenseData with 0 length");
 		return &(mData[0]);
@@ -92,6 +116,7 @@ public:
 
 	/// Returns a non-const data, starting at startbyte().
 	inline unsigned char *writableData() {
+	    copyExternal();
 	    if(mData.size() == 0)
 	        throw std::length_error("Tried to get a writable pointer to DenseData with 0 length");
 		return &(mData[0]);
@@ -104,6 +129,8 @@ public:
 	inline const unsigned char *dataAt(base_type offset) const {
 		if (offset > endbyte() || offset < startbyte())
 		    return NULL;
+		if (mExternal != NULL)
+		    return mExternal + (size_t)(offset-startbyte());
 		return &(mData[(std::vector<unsigned char>::size_type)(offset-startbyte())]);
 	}
 
@@ -113,13 +140,21 @@ public:
 
 	/// Sets the length of the range, as well as allocates more space in the data vector.
 	inline void setLength(size_t len, bool is_npos) {
+		copyExternal();
 		Range::setLength(len, is_npos);
 		mData.resize(len);
 	}
 
+	/// Allocates space for len bytes of data without changing the length.
+	inline void reserve(size_t len) {
+		copyExternal();
+		mData.reserve(len);
+	}
+
 	//Appends len bytes from data to internal data vector and adds to length of range
 	inline void append(const char* data, size_t len, bool is_npos) {
 	    if(len <= 0) return;
+	    copyExternal();
 	    size_t prev_end = length();
 	    Range::setLength(prev_end + len, is_npos);
 	    mData.resize(prev_end + len, 0);
@@ -140,6 +175,7 @@ public:
 	       return;
 	   }
 
+	   copyExternal();
 	   Range::setLength(length() + (end-begin), is_npos);
 	   mData.insert(mData.end(), begin, end);
 	}
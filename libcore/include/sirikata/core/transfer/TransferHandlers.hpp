@@ -37,6 +37,7 @@
 #include <sirikata/core/transfer/RemoteFileMetadata.hpp>
 #include <sirikata/core/transfer/TransferData.hpp>
 #include <sirikata/core/transfer/DiskCacheLayer.hpp>
+#include <sirikata/core/transfer/SegmentedDiskCacheLayer.hpp>
 #include <sirikata/core/transfer/MemoryCacheLayer.hpp>
 #include <sirikata/core/transfer/LRUPolicy.hpp>
 #include <sirikata/core/transfer/TransferRequest.hpp>
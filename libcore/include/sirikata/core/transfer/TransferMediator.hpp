@@ -56,6 +56,13 @@ using namespace boost::multi_index;
 
 /*
  * Mediates requests for name lookups and chunk downloads
+ *
+ * Requests are collected from the registered pools and dispatched by a single
+ * thread which sleeps until a pool signals that it has new requests or an
+ * executing request finishes. The number of requests executing concurrently
+ * is limited per type of handler (see TransferRequest::getHandlerType), so a
+ * burst of slow HTTP requests doesn't stop local files or data URIs from
+ * being serviced.
  */
 class SIRIKATA_EXPORT TransferMediator
     : public AutoSingleton<TransferMediator> {
@@ -76,6 +83,8 @@ class SIRIKATA_EXPORT TransferMediator
 	private:
 		//Maps each client's string ID to the original TransferRequest object
 		std::map<std::string, std::tr1::shared_ptr<TransferRequest> > mTransferReqs;
+		//Time each client first requested this resource, for statistics
+		std::map<std::string, Time> mClientAdded;
 
 		//Aggregated request unique identifier
 		const std::string mIdentifier;
@@ -102,6 +111,9 @@ class SIRIKATA_EXPORT TransferMediator
 		//Returns the aggregated priority value
 		Priority getPriority() const;
 
+		//Returns the time the client first requested this resource
+		Time getClientAddedTime(const std::string& clientID) const;
+
 		//Pass in the first client's request
 		AggregateRequest(std::tr1::shared_ptr<TransferRequest> req);
 	};
@@ -132,58 +144,58 @@ class SIRIKATA_EXPORT TransferMediator
 	typedef AggregateList::index<tagID>::type AggregateListByID;
 	typedef AggregateList::index<tagPriority>::type AggregateListByPriority;
 
-	/*
-	 * Used to process the queue of requests coming from a single client.
-	 * There is one PoolWorker for each client, and this makes it so that the client's
-	 * thread doesn't have to block when inserting a request. Instead, the PoolWorkers
-	 * block against each other when inserting the request into the aggregated list.
-	 */
-	class PoolWorker {
-	private:
-	    //The TransferPool associated with this worker
-		std::tr1::shared_ptr<TransferPool> mTransferPool;
-
-		//The worker's thread
-		Thread * mWorkerThread;
-
-		//Set to true when worker should shut down
-		bool mCleanup;
-
-		//Runs the worker thread
-	    void run();
-
-	public:
-		//Initialize with the associated TransferPool
-		PoolWorker(std::tr1::shared_ptr<TransferPool> transferPool);
-
-		//Returns the TransferPool this was initialized with
-		std::tr1::shared_ptr<TransferPool> getTransferPool() const;
-
-		//Returns the worker's thread
-		Thread * getThread() const;
-
-		//Signal to shut down
-		void cleanup();
-	};
-
-    friend class PoolWorker;
-    //Helper for compatibility with compilers where TransferPool declaring
-    //TransferMediator as a friend does not give PoolWorker access
-    static inline std::tr1::shared_ptr<TransferRequest> getRequest(std::tr1::shared_ptr<TransferPool> pool) {
-        return pool->getRequest();
-    }
-
-	//Maps a client ID string to the PoolWorker class
-	typedef std::map<std::string, std::tr1::shared_ptr<PoolWorker> > PoolType;
+	//Maps a client ID string to its TransferPool
+	typedef std::map<std::string, TransferPoolPtr> PoolType;
 	//Stores the list of pools
 	PoolType mPools;
 	//lock this to access mPools
 	boost::shared_mutex mPoolMutex;
 
+	//Statistics for requests from a single pool. Protected by mAggMutex.
+	struct PoolStats {
+	    PoolStats()
+	     : received(0), completed(0), cancelled(0),
+	       totalLatency(Duration::zero()), maxLatency(Duration::zero())
+	    {}
+
+	    //Number of requests and updates received from the pool
+	    uint32 received;
+	    //Number of requests which finished or were cancelled
+	    uint32 completed;
+	    uint32 cancelled;
+	    //Time from a request being received to it finishing
+	    Duration totalLatency;
+	    Duration maxLatency;
+	};
+	typedef std::map<std::string, PoolStats> PoolStatsMap;
+	PoolStatsMap mPoolStats;
+
+	//Limit and current number of executing requests for a type of
+	//handler. Protected by mAggMutex.
+	struct HandlerSlots {
+	    HandlerSlots()
+	     : limit(0), outstanding(0)
+	    {}
+	    HandlerSlots(uint32 lim)
+	     : limit(lim), outstanding(0)
+	    {}
+
+	    uint32 limit;
+	    uint32 outstanding;
+	};
+	typedef std::map<String, HandlerSlots> HandlerSlotsMap;
+	HandlerSlotsMap mHandlerSlots;
+	//Limit used for handler types which haven't been configured
+	uint32 mDefaultHandlerLimit;
+
 	//Set to true to signal shutdown
 	bool mCleanup;
-	//Number of outstanding requests
-	uint32 mNumOutstanding;
+	//Set when the mediator thread has work to do, i.e. pools have new
+	//requests or a request finished. Both are protected by mWakeMutex,
+	//which is never held while acquiring any other lock.
+	bool mWorkAvailable;
+	boost::mutex mWakeMutex;
+	boost::condition_variable mWakeCondition;
 
 	//TransferMediator's worker thread
 	Thread* mThread;
@@ -193,9 +205,17 @@ class SIRIKATA_EXPORT TransferMediator
 
     //Main thread that handles the input pools
     void mediatorThread();
+    //Wakes up the mediator thread. Safe to call from any thread.
+    void notifyWork();
+    //Collects new requests from all pools and merges them into mAggregateList
+    void processPools();
+    void processRequest(std::tr1::shared_ptr<TransferRequest> req);
 
     //Callback for when an executed request finishes
-    void execute_finished(std::tr1::shared_ptr<TransferRequest> req, std::string id);
+    void execute_finished(std::tr1::shared_ptr<TransferRequest> req, std::string id, String handler);
+
+    //Get the slots for a handler type, creating it with the default limit if needed
+    HandlerSlots& getHandlerSlots(const String& handler);
 
     //Check our internal queue to see what request to process next
     void checkQueue();
@@ -204,6 +224,8 @@ class SIRIKATA_EXPORT TransferMediator
 
 
     void commandListRequests(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+    void commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
+    void commandHttpStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
 public:
     static TransferMediator& getSingleton();
     static void destroy();
@@ -218,6 +240,11 @@ public:
      */
     void registerContext(Context* ctx);
 
+    /** Set the maximum number of requests which may execute concurrently for
+     *  a type of handler, e.g. "http" or "file".
+     */
+    void setHandlerLimit(const String& handler, uint32 limit);
+
     /** Used to register a client that has a pool of requests it needs
      *  serviced by the transfer mediator
      *
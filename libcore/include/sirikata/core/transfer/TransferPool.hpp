@@ -94,11 +94,24 @@ protected:
     // Friend in TransferMediator so it can construct, call getRequest
     friend class TransferMediator;
 
+    typedef std::tr1::function<void()> RequestsAvailableCallback;
+
     TransferPool(const std::string& clientID)
      : mClientID(clientID)
     {}
 
-    virtual TransferRequestPtr getRequest() = 0;
+    /// Pops all the requests currently waiting in the pool. Never blocks.
+    virtual void getRequests(std::deque<TransferRequestPtr>* reqs) = 0;
+
+    /// Invoked by the TransferMediator when the pool is registered.
+    void setRequestsAvailableCallback(const RequestsAvailableCallback& cb) {
+        mRequestsAvailable = cb;
+    }
+    /// Implementations must call this after queuing up a request so the
+    /// TransferMediator will wake up and collect it.
+    void notifyRequestsAvailable() {
+        if (mRequestsAvailable) mRequestsAvailable();
+    }
 
     // Utility methods because they require being friended by
     // TransferRequest but that doesn't extend to subclasses
@@ -113,6 +126,7 @@ protected:
     }
 
     const std::string mClientID;
+    RequestsAvailableCallback mRequestsAvailable;
 };
 typedef std::tr1::shared_ptr<TransferPool> TransferPoolPtr;
 
@@ -128,18 +142,21 @@ public:
         if (req)
             setRequestClientID(req);
         mDeltaQueue.push(req);
+        notifyRequestsAvailable();
     }
 
     //Updates priority of a request in the pool
     virtual void updatePriority(TransferRequestPtr req, Priority p) {
         setRequestPriority(req, p);
         mDeltaQueue.push(req);
+        notifyRequestsAvailable();
     }
 
     //Updates priority of a request in the pool
     inline void deleteRequest(TransferRequestPtr req) {
         setRequestDeletion(req);
         mDeltaQueue.push(req);
+        notifyRequestsAvailable();
     }
 
 private:
@@ -153,11 +170,9 @@ private:
     {
     }
 
-    //Returns an item from the pool. Blocks if pool is empty.
-    inline std::tr1::shared_ptr<TransferRequest> getRequest() {
-        std::tr1::shared_ptr<TransferRequest> retval;
-        mDeltaQueue.blockingPop(retval);
-        return retval;
+    //Returns all items currently in the pool. Never blocks.
+    inline void getRequests(std::deque<TransferRequestPtr>* reqs) {
+        mDeltaQueue.popAll(reqs);
     }
 };
 
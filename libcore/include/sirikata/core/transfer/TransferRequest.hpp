@@ -53,6 +53,11 @@ public:
 
     virtual void notifyCaller(TransferRequestPtr me, TransferRequestPtr from) = 0;
 
+    /// Get the type of handler that will service this request, e.g. "http"
+    /// or "file". The TransferMediator limits the number of concurrently
+    /// executing requests for each type of handler.
+    virtual String getHandlerType() const = 0;
+
 	virtual ~TransferRequest() {}
 
 	friend class TransferPool;
@@ -105,6 +110,10 @@ public:
         return mURI;
     }
 
+    virtual String getHandlerType() const {
+        return mURI.scheme();
+    }
+
     void execute(std::tr1::shared_ptr<TransferRequest> req, ExecuteFinished cb);
 
     inline void notifyCaller(TransferRequestPtr me, TransferRequestPtr from) {
@@ -180,6 +189,11 @@ public:
         return mID;
     }
 
+    // Direct chunk requests are always serviced by the meerkat handler
+    virtual String getHandlerType() const {
+        return "meerkat";
+    }
+
     void execute(std::tr1::shared_ptr<TransferRequest> req, ExecuteFinished cb);
 
     void execute_finished(std::tr1::shared_ptr<const DenseData> response, ExecuteFinished cb);
@@ -225,6 +239,12 @@ public:
 		return *mChunk;
 	}
 
+    // Chunks are retrieved by the handler for the metadata's URI, not the
+    // request URI
+    virtual String getHandlerType() const {
+        return mMetadata->getURI().scheme();
+    }
+
     void execute(std::tr1::shared_ptr<TransferRequest> req, ExecuteFinished cb);
 
     void execute_finished(std::tr1::shared_ptr<const DenseData> response, ExecuteFinished cb);
@@ -275,6 +295,7 @@ class SIRIKATA_EXPORT UploadRequest : public TransferRequest {
     virtual const std::string& getIdentifier() const;
     virtual void execute(TransferRequestPtr req, ExecuteFinished cb);
     virtual void notifyCaller(TransferRequestPtr me, TransferRequestPtr from);
+    virtual String getHandlerType() const { return "upload"; }
 
     OAuthParamsPtr oauth() { return mOAuth; }
     const StringMap& files() { return mFiles; }
@@ -0,0 +1,159 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_UTIL_CONCURRENT_HASH_MAP_HPP_
+#define _SIRIKATA_CORE_UTIL_CONCURRENT_HASH_MAP_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+/** A hash map which can be used from multiple threads. Keys are spread over a
+ *  fixed number of shards, each an unordered_map with its own lock, so
+ *  operations on different keys rarely contend and no operation ever holds
+ *  more than one lock.
+ *
+ *  Only whole operations are atomic, so there are no iterators. Values are
+ *  copied in and out and are destroyed outside the shard lock, which means a
+ *  value's destructor may safely access the map again, e.g. a connection
+ *  removing itself when its last reference is erased.
+ */
+template<typename Key, typename Value, typename Hasher = std::tr1::hash<Key> >
+class ConcurrentHashMap : Noncopyable {
+public:
+    typedef std::pair<Key, Value> Entry;
+    typedef std::vector<Entry> EntryList;
+
+    enum {
+        NUM_SHARDS = 64
+    };
+
+    ConcurrentHashMap() {}
+
+    /** Lookup key, copying its value into value_out if it is present.
+     *  value_out may be NULL to just check for presence.
+     */
+    bool get(const Key& key, Value* value_out) const {
+        const Shard& shard = shardFor(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        typename Map::const_iterator it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        if (value_out != NULL) *value_out = it->second;
+        return true;
+    }
+
+    bool contains(const Key& key) const {
+        return get(key, NULL);
+    }
+
+    /** Insert the value if key isn't already present. Returns true if the
+     *  value was inserted.
+     */
+    bool insert(const Key& key, const Value& value) {
+        Shard& shard = shardFor(key);
+        boost::mutex::scoped_lock lock(shard.mutex);
+        return shard.map.insert(typename Map::value_type(key, value)).second;
+    }
+
+    /** Insert or replace the value for key. */
+    void set(const Key& key, const Value& value) {
+        Value old;
+        {
+            Shard& shard = shardFor(key);
+            boost::mutex::scoped_lock lock(shard.mutex);
+            std::pair<typename Map::iterator, bool> result =
+                shard.map.insert(typename Map::value_type(key, value));
+            if (!result.second) {
+                // Keep the old value alive until the lock is released
+                std::swap(old, result.first->second);
+                result.first->second = value;
+            }
+        }
+    }
+
+    /** Remove key, copying its value into value_out if it was present.
+     *  value_out may be NULL. Returns true if key was present.
+     */
+    bool erase(const Key& key, Value* value_out = NULL) {
+        Value old;
+        {
+            Shard& shard = shardFor(key);
+            boost::mutex::scoped_lock lock(shard.mutex);
+            typename Map::iterator it = shard.map.find(key);
+            if (it == shard.map.end()) return false;
+            old = it->second;
+            shard.map.erase(it);
+        }
+        if (value_out != NULL) *value_out = old;
+        return true;
+    }
+
+    /** Remove all entries, appending them to entries_out if it isn't NULL.
+     *  Entries inserted concurrently may or may not be removed.
+     */
+    void clear(EntryList* entries_out = NULL) {
+        for(uint32 i = 0; i < NUM_SHARDS; i++) {
+            Map removed;
+            {
+                boost::mutex::scoped_lock lock(mShards[i].mutex);
+                removed.swap(mShards[i].map);
+            }
+            if (entries_out != NULL)
+                entries_out->insert(entries_out->end(), removed.begin(), removed.end());
+        }
+    }
+
+    /** Copy all entries into entries_out. The copy isn't an atomic snapshot
+     *  of the whole map, only of each shard.
+     */
+    void entries(EntryList* entries_out) const {
+        for(uint32 i = 0; i < NUM_SHARDS; i++) {
+            boost::mutex::scoped_lock lock(mShards[i].mutex);
+            entries_out->insert(entries_out->end(), mShards[i].map.begin(), mShards[i].map.end());
+        }
+    }
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        for(uint32 i = 0; i < NUM_SHARDS; i++) {
+            boost::mutex::scoped_lock lock(mShards[i].mutex);
+            result += mShards[i].map.size();
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    typedef std::tr1::unordered_map<Key, Value, Hasher> Map;
+
+    struct Shard {
+        mutable boost::mutex mutex;
+        Map map;
+    };
+
+    Shard& shardFor(const Key& key) {
+        return mShards[ shardIndex(key) ];
+    }
+    const Shard& shardFor(const Key& key) const {
+        return mShards[ shardIndex(key) ];
+    }
+    static std::size_t shardIndex(const Key& key) {
+        // Hashers here often just xor fields together, so mix the high bits
+        // in before picking a shard.
+        std::size_t h = Hasher()(key);
+        h ^= (h >> 16);
+        h ^= (h >> 8);
+        return h % NUM_SHARDS;
+    }
+
+    Shard mShards[NUM_SHARDS];
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_UTIL_CONCURRENT_HASH_MAP_HPP_
@@ -0,0 +1,77 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CORE_UTIL_FREE_LIST_HPP_
+#define _SIRIKATA_CORE_UTIL_FREE_LIST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Sirikata {
+
+/** A cache of released items, either whole objects or raw memory blocks, kept
+ *  separately for each thread so that taking and returning items usually
+ *  doesn't need a lock. Items often flow between threads, e.g. allocated by
+ *  one thread and released by another, so when a thread's list fills up half
+ *  of it is handed off in a batch to a shared list, from which threads with
+ *  empty lists refill. Once the shared list is also full, push() fails and
+ *  the caller frees the item normally.
+ *
+ *  Since items released into a thread's list may outlive the FreeList if it
+ *  is destroyed during static destruction, FreeLists used from operator
+ *  new/delete should be heap allocated and never destroyed.
+ */
+class SIRIKATA_EXPORT FreeList : Noncopyable {
+public:
+    typedef void(*DestroyFunction)(void* item);
+
+    /** Create a FreeList.
+     *  \param max_per_thread the maximum number of items cached by each thread
+     *  \param destroy frees an item, used to clean up a thread's list when the
+     *         thread exits
+     */
+    FreeList(uint32 max_per_thread, DestroyFunction destroy);
+    ~FreeList();
+
+    /** Take an item from this thread's list, or return NULL if it is empty. A
+     *  NULL result is counted as an allocation since the caller will have to
+     *  allocate a new item.
+     */
+    void* pop();
+    /** Return an item to this thread's list. Returns false if the list is
+     *  full, in which case the caller is still responsible for the item.
+     */
+    bool push(void* item);
+
+    /// The number of times pop() couldn't provide an item
+    uint64 allocations() const { return mAllocations.read(); }
+
+private:
+    enum {
+        MAX_TRANSFER_BATCHES = 64
+    };
+
+    typedef std::vector<void*> Batch;
+    typedef std::vector<Batch> BatchList;
+
+    struct ThreadList;
+    static void destroyThreadList(ThreadList* tl);
+    ThreadList* threadList();
+
+    const uint32 mMaxPerThread;
+    DestroyFunction mDestroy;
+    boost::thread_specific_ptr<ThreadList> mThreadLists;
+
+    boost::mutex mTransferMutex;
+    BatchList mTransfers;
+
+    // Only misses are counted so the common path doesn't touch shared state
+    AtomicValue<uint64> mAllocations;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_CORE_UTIL_FREE_LIST_HPP_
@@ -56,6 +56,38 @@ enum LOGGING_LEVEL {
 SIRIKATA_FUNCTION_EXPORT const String& LogModuleString(const char* base);
 SIRIKATA_FUNCTION_EXPORT const char* LogLevelString(LOGGING_LEVEL lvl, const char* lvl_as_string);
 
+/** Index of a logging module (the first parameter to SILOG) in
+ *  SirikataLogModuleLevels. Each SILOG call site registers its module the
+ *  first time it runs, so afterwards checking whether it is enabled is just a
+ *  table lookup rather than a string hash.
+ */
+typedef uint32 LogModuleID;
+#define SIRIKATA_MAX_LOG_MODULES 512
+
+/** Get the ID for the module, registering it if necessary. If too many modules
+ *  are registered the ID of a shared slot using the default level is
+ *  returned.
+ */
+SIRIKATA_FUNCTION_EXPORT LogModuleID RegisterLogModule(const char* module);
+/** Recomputes the level of every registered module from the loglevel,
+ *  maxloglevel and moduleloglevel options. Must be called if those options are
+ *  changed directly rather than through SetLogLevel.
+ */
+SIRIKATA_FUNCTION_EXPORT void UpdateLogLevels();
+/** Set the level for a single module, or the default level if module is
+ *  empty. This can be used at any time, e.g. in response to a command. */
+SIRIKATA_FUNCTION_EXPORT void SetLogLevel(const String& module, LOGGING_LEVEL lvl);
+/** Parse the name of a level, e.g. "debug". Returns false if it isn't valid. */
+SIRIKATA_FUNCTION_EXPORT bool ParseLogLevel(const String& name, LOGGING_LEVEL* lvl_out);
+/** Get the level currently used for each registered module. */
+typedef std::map<String, LOGGING_LEVEL> LogLevelMap;
+SIRIKATA_FUNCTION_EXPORT LogLevelMap GetLogLevels();
+
+// The level each module is currently logging at, i.e. its own (or the default)
+// level, capped by maxloglevel. Indexed by LogModuleID. Public so the macros can
+// check it directly.
+extern "C" SIRIKATA_EXPORT int32 SirikataLogModuleLevels[SIRIKATA_MAX_LOG_MODULES];
+
 // Public so the macros work efficiently instead of another call
 extern "C" SIRIKATA_EXPORT std::ostream* SirikataLogStream;
 
@@ -66,22 +98,27 @@ SIRIKATA_FUNCTION_EXPORT void finishLog();
 } }
 #if 1
 # ifdef DEBUG_ALL
-#  define SILOGP(module,lvl) true
+#  define SILOG_MODULE_ENABLED(module_id,lvl) true
+# else
+#  define SILOG_MODULE_ENABLED(module_id,lvl) \
+    (Sirikata::Logging::SirikataLogModuleLevels[module_id] >= Sirikata::Logging::lvl)
+# endif
+// Both macros cache the module's ID in a static local. SILOGP needs to be an
+// expression, which is only possible with GCC's statement expressions, so
+// elsewhere it falls back to looking up the ID every time.
+# if defined(__GNUC__)
+#  define SILOGP(module,lvl)                                            \
+    __extension__ ({                                                    \
+        static const Sirikata::Logging::LogModuleID __log_module_id = Sirikata::Logging::RegisterLogModule(#module); \
+        SILOG_MODULE_ENABLED(__log_module_id,lvl);                      \
+    })
 # else
-//needs to use unsafeAs because the LOGGING_LEVEL typeinfos are not preserved across dll lines
-#  define SILOGP(module,lvl) \
-    ( \
-     std::max( reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_atLeastLevel)->unsafeAs<Sirikata::Logging::LOGGING_LEVEL>(), \
-	       reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_defaultLevel)->unsafeAs<Sirikata::Logging::LOGGING_LEVEL>()) \
-     >=Sirikata::Logging::lvl &&					\
-        ( (reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_moduleLevel)->unsafeAs<std::tr1::unordered_map<std::string,Sirikata::Logging::LOGGING_LEVEL> >().find(#module)==reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_moduleLevel)->unsafeAs<std::tr1::unordered_map<std::string,Sirikata::Logging::LOGGING_LEVEL> >().end() && \
-           reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_defaultLevel)->unsafeAs<Sirikata::Logging::LOGGING_LEVEL>()>=(Sirikata::Logging::lvl)) \
-		   || (reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_moduleLevel)->unsafeAs<std::tr1::unordered_map<std::string,Sirikata::Logging::LOGGING_LEVEL> >().find(#module)!=reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_moduleLevel)->unsafeAs<std::tr1::unordered_map<std::string,Sirikata::Logging::LOGGING_LEVEL> >().end() && \
-              reinterpret_cast<Sirikata::OptionValue*>(Sirikata_Logging_OptionValue_moduleLevel)->unsafeAs<std::tr1::unordered_map<std::string,Sirikata::Logging::LOGGING_LEVEL> >()[#module]>=Sirikata::Logging::lvl)))
+#  define SILOGP(module,lvl) SILOG_MODULE_ENABLED(Sirikata::Logging::RegisterLogModule(#module),lvl)
 # endif
 # define SILOGBARE(module,lvl,value)                                    \
     do {                                                                \
-        if (SILOGP(module,lvl)) {                                       \
+        static const Sirikata::Logging::LogModuleID __log_module_id = Sirikata::Logging::RegisterLogModule(#module); \
+        if (SILOG_MODULE_ENABLED(__log_module_id,lvl)) {                \
             std::ostringstream __log_stream;                            \
             __log_stream << value;                                      \
             (*Sirikata::Logging::SirikataLogStream) << __log_stream.str() << std::endl; \
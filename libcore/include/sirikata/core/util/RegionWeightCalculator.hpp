@@ -38,16 +38,44 @@
 
 namespace Sirikata {
 
+/** Pairs of regions to compute weights for in one batch. Each coordinate is
+ *  stored in its own array, e.g. sourceMin[0][i] is the x coordinate of the
+ *  minimum corner of the i'th source region, so a batch weight function can
+ *  run the same arithmetic over consecutive pairs.
+ */
+struct SIRIKATA_EXPORT RegionPairs {
+    RegionPairs();
+    RegionPairs(const BoundingBoxList& sources, const BoundingBoxList& dests);
+
+    void add(const BoundingBox3f& source_bbox, const BoundingBox3f& dest_bbox);
+    void clear();
+    size_t size() const { return sourceMin[0].size(); }
+
+    std::vector<double> sourceMin[3];
+    std::vector<double> sourceMax[3];
+    std::vector<double> destMin[3];
+    std::vector<double> destMax[3];
+};
+
 class SIRIKATA_EXPORT RegionWeightCalculator {
 public:
     typedef std::tr1::function<double(const Vector3d&,const Vector3d&,const Vector3d&, const Vector3d&)> WeightFunction;
+    // Fills in results[i] with the weight of the i'th pair
+    typedef std::tr1::function<void(const RegionPairs&, double* results)> BatchWeightFunction;
 
     RegionWeightCalculator(const WeightFunction& weightFunc);
+    RegionWeightCalculator(const WeightFunction& weightFunc, const BatchWeightFunction& batchWeightFunc);
     ~RegionWeightCalculator();
 
     float64 weight(const BoundingBox3f& source_bbox, BoundingBox3f& dest_bbox);
+    /** Compute the weights of many pairs of regions at once. If the weight
+     *  function doesn't have a batch version, falls back to computing them
+     *  one at a time.
+     */
+    void weights(const RegionPairs& pairs, std::vector<float64>* results);
 private:
     WeightFunction mWeightFunc;
+    BatchWeightFunction mBatchWeightFunc;
 }; // class RegionWeightCalculator
 
 class SIRIKATA_EXPORT RegionWeightCalculatorFactory
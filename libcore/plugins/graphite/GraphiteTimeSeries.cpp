@@ -47,11 +47,13 @@ GraphiteTimeSeries::GraphiteTimeSeries(Context* ctx, const String& host, uint16
    mResolver(NULL),
    mSocket(NULL),
    mConnecting(false),
-   mTransmitting(false)
+   mTransmitting(false),
+   mDroppedBytes(0)
 {
 }
 
 GraphiteTimeSeries::~GraphiteTimeSeries() {
+    boost::mutex::scoped_lock lock(mMutex);
     cleanup();
 }
 
@@ -71,6 +73,7 @@ void GraphiteTimeSeries::connect() {
 
 
 void GraphiteTimeSeries::handleResolve(const boost::system::error_code& err, Network::TCPResolver::iterator endpoint_iterator) {
+    boost::mutex::scoped_lock lock(mMutex);
     if (err) {
         GRAPHITE_LOG(error, "Failed to resolve hostname " << mHost);
         cleanup();
@@ -90,9 +93,11 @@ void GraphiteTimeSeries::tryConnect(Network::TCPResolver::iterator endpoint_iter
 }
 
 void GraphiteTimeSeries::handleConnect(const boost::system::error_code& err, Network::TCPResolver::iterator endpoint_iterator) {
-    // Success
+    boost::mutex::scoped_lock lock(mMutex);
+    // Success, send anything that was reported while we were connecting
     if (!err) {
         mConnecting = false;
+        if (!mPending.empty()) startSend();
         return;
     }
 
@@ -110,36 +115,55 @@ void GraphiteTimeSeries::handleConnect(const boost::system::error_code& err, Net
 }
 
 void GraphiteTimeSeries::report(const String& name, float64 val) {
-    // If we're connecting, ignore this update
-    if (mConnecting) return;
+    String data;
+    appendPlaintext(&data, name, val, unixTimestamp());
+
+    boost::mutex::scoped_lock lock(mMutex);
+    enqueue(data);
+}
+
+void GraphiteTimeSeries::reportBatch(const SampleList& samples) {
+    String data;
+    int64 timestamp = unixTimestamp();
+    for(SampleList::const_iterator it = samples.begin(); it != samples.end(); it++)
+        appendPlaintext(&data, it->name, it->value, timestamp);
+
+    boost::mutex::scoped_lock lock(mMutex);
+    enqueue(data);
+}
+
+void GraphiteTimeSeries::enqueue(const String& data) {
+    if (mPending.size() + data.size() > MAX_PENDING_BYTES) {
+        if (mDroppedBytes == 0)
+            GRAPHITE_LOG(warn, "Too much data queued for " << mHost << ", dropping updates.");
+        mDroppedBytes += data.size();
+        return;
+    }
+    mPending.append(data);
 
-    // We're just fully disconnected, trigger a connection request and
-    // drop this update
-    if (!mConnecting && (mSocket == NULL || !mSocket->is_open())) {
+    // Once connected, the data will be sent
+    if (mConnecting) return;
+    if (mSocket == NULL || !mSocket->is_open()) {
         connect();
         return;
     }
 
-    // If we have too many outstanding updates, drop it
-    if (mUpdates.size() > 50) return;
-
-    // Otherwise, we should be fine to transmit
-    static Time unix_epoch = Timer::getSpecifiedDate(String("1970-01-01 00:00:00.000"));
-    String data =
-        name + " " +
-        boost::lexical_cast<String>(val) + " " +
-        boost::lexical_cast<String>((int64)(mContext->recentRealTime() - unix_epoch).seconds()) + "\n";
-    mUpdates.push(data);
-    if (!mTransmitting && !mUpdates.empty()) startSend();
+    if (!mTransmitting) startSend();
 }
 
 void GraphiteTimeSeries::startSend() {
     using namespace boost::asio;
 
-    assert(!mConnecting && mSocket && mSocket->is_open() && !mUpdates.empty());
+    assert(!mConnecting && mSocket && mSocket->is_open() && !mPending.empty());
 
-    mCurrentUpdate = mUpdates.front();
-    mUpdates.pop();
+    if (mDroppedBytes > 0) {
+        GRAPHITE_LOG(warn, "Dropped " << mDroppedBytes << " bytes of updates for " << mHost);
+        mDroppedBytes = 0;
+    }
+
+    mTransmitting = true;
+    mCurrentUpdate.swap(mPending);
+    mPending.clear();
 
     boost::asio::async_write(
         *mSocket,
@@ -149,18 +173,22 @@ void GraphiteTimeSeries::startSend() {
 }
 
 void GraphiteTimeSeries::handleSent(const boost::system::error_code& err) {
+    boost::mutex::scoped_lock lock(mMutex);
+
     if (err) {
+        // The next report will reconnect and send anything still pending
         GRAPHITE_LOG(error, "Error while sending update, resetting.");
         cleanup();
+        return;
     }
 
     // If we're out of updates, mark as ready to transmit
-    if (mUpdates.empty()) {
+    if (mPending.empty()) {
         mTransmitting = false;
         return;
     }
 
-    // Otherwise, process next message
+    // Otherwise, send everything that accumulated during the last write
     startSend();
 }
 
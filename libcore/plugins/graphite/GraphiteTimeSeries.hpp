@@ -35,6 +35,7 @@
 
 #include <sirikata/core/trace/TimeSeries.hpp>
 #include <sirikata/core/network/Asio.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace Sirikata {
 namespace Trace {
@@ -51,8 +52,17 @@ class GraphiteTimeSeries : public TimeSeries {
     virtual ~GraphiteTimeSeries();
 
     virtual void report(const String& name, float64 val);
+    virtual void reportBatch(const SampleList& samples);
 
   private:
+    // Maximum amount of unsent data. Data reported while we're connecting or
+    // while a write is outstanding is held until it can be sent, but if
+    // Graphite can't keep up new data is dropped.
+    static const uint32 MAX_PENDING_BYTES = 256*1024;
+
+    // Adds data to mPending and starts sending if possible. Requires mMutex.
+    void enqueue(const String& data);
+
     void connect();
 
     void handleResolve(const boost::system::error_code& err, Network::TCPResolver::iterator endpoint_iterator);
@@ -67,6 +77,9 @@ class GraphiteTimeSeries : public TimeSeries {
     String mHost;
     uint16 mPort;
 
+    // Reports may come from any thread
+    boost::mutex mMutex;
+
     // Data is reported to graphite using a simple text based format sent over a
     // TCP connection
     Network::TCPResolver* mResolver;
@@ -74,8 +87,11 @@ class GraphiteTimeSeries : public TimeSeries {
     bool mConnecting;
     bool mTransmitting;
 
-    std::queue<String> mUpdates;
-    String mCurrentUpdate; // To avoid realloc issues with the queue during writes
+    // Everything reported since the last write started, sent together as
+    // soon as it finishes
+    String mPending;
+    String mCurrentUpdate; // Data for the outstanding write
+    uint64 mDroppedBytes;
 }; // class GraphiteTimeSeries
 
 } // namespace Trace
@@ -82,10 +82,123 @@ static double integralExpFunction(double k, double xmin, double xmax, double ymi
             + (exp(-k*square(m - r)) - exp(-k*square(m - s)))/(sqrt(k)*sqrt(pi)*sqrtloge)
             + (-exp(-k*square(n - r)) + exp(-k*square(n - s)))/(sqrt(k)*sqrt(pi)*sqrtloge));
 }
+
+// Along each axis, the integral is a sum of edgeFunction(sqrt(k)*d) over
+// the distances d between the edges of the two regions, scaled by
+// 1/sqrt(k). edgeFunction is even and its derivative is erf.
+static double edgeFunction(double t) {
+    double pi=3.1415926535897931;
+    t=fabs(t);
+    return t*myerf(t)+exp(-t*t)/sqrt(pi);
+}
+// Past this, erf(t) is 1 and exp(-t*t) is 0 to double precision, leaving t
+#define EDGE_FUNCTION_LIMIT 6.0
+
 namespace Sirikata {
 double integralExpFunction(double k, const Vector3d& xymin, const Vector3d& xymax, const Vector3d& uvmin, const Vector3d& uvmax){
     return ::integralExpFunction(k,xymin.x,xymax.x,xymin.y,xymax.y,uvmin.x,uvmax.x,uvmin.y,uvmax.y);
 }
+
+namespace {
+struct ExactEdgeFunction {
+    double operator()(double t) const {
+        return edgeFunction(t);
+    }
+};
+struct TableEdgeFunction {
+    TableEdgeFunction(const ExpIntegralTable& t) : table(t) {}
+    double operator()(double t) const {
+        return table.lookup(t);
+    }
+    const ExpIntegralTable& table;
+};
+
+// Computes the integral for every pair one axis at a time. The distances
+// are computed for all pairs in a separate pass with no branches or calls so
+// the compiler can vectorize it.
+template<typename EdgeFunc>
+void batchIntegral(double k, const RegionPairs& pairs, const EdgeFunc& edge, double* results) {
+    double pi=3.1415926535897931;
+    size_t count=pairs.size();
+    double sqrtk=sqrt(k);
+    double scale=pi/(4*k*k);
+    std::vector<double> dist(4*count);
+    double* jp=&dist[0];
+    double* lp=jp+count;
+    double* jq=lp+count;
+    double* lq=jq+count;
+    for (size_t i=0;i<count;++i) {
+        results[i]=scale;
+    }
+    for (int axis=0;axis<2;++axis) {
+        const double* j=&pairs.sourceMin[axis][0];
+        const double* l=&pairs.sourceMax[axis][0];
+        const double* p=&pairs.destMin[axis][0];
+        const double* q=&pairs.destMax[axis][0];
+        for (size_t i=0;i<count;++i) {
+            jp[i]=sqrtk*(j[i]-p[i]);
+            lp[i]=sqrtk*(l[i]-p[i]);
+            jq[i]=sqrtk*(j[i]-q[i]);
+            lq[i]=sqrtk*(l[i]-q[i]);
+        }
+        for (size_t i=0;i<count;++i) {
+            results[i]*=edge(jp[i])-edge(lp[i])-edge(jq[i])+edge(lq[i]);
+        }
+    }
+}
+}
+
+void integralExpFunctionBatch(double k, const RegionPairs& pairs, double* results) {
+    if (pairs.size()==0) return;
+    batchIntegral(k,pairs,ExactEdgeFunction(),results);
+}
+
+ExpIntegralTable::ExpIntegralTable(double k, uint32 size)
+ : mK(k),
+   mSqrtK(sqrt(k)),
+   mStep(EDGE_FUNCTION_LIMIT/std::max(size,(uint32)1)),
+   mInvStep(std::max(size,(uint32)1)/EDGE_FUNCTION_LIMIT)
+{
+    size=std::max(size,(uint32)1);
+    // One extra entry so lookups never need to check the upper neighbor
+    mValues.resize(size+2);
+    mSlopes.resize(size+2);
+    for (uint32 i=0;i<size+2;++i) {
+        double t=i*mStep;
+        mValues[i]=edgeFunction(t);
+        mSlopes[i]=myerf(t)*mStep;
+    }
+}
+
+double ExpIntegralTable::lookup(double t) const {
+    t=fabs(t);
+    if (t>=EDGE_FUNCTION_LIMIT) return t;
+    double x=t*mInvStep;
+    size_t idx=(size_t)x;
+    double u=x-idx;
+    double u2=u*u;
+    double u3=u2*u;
+    // Cubic Hermite interpolation between the neighboring entries
+    return (2*u3-3*u2+1)*mValues[idx]
+        + (u3-2*u2+u)*mSlopes[idx]
+        + (-2*u3+3*u2)*mValues[idx+1]
+        + (u3-u2)*mSlopes[idx+1];
+}
+
+double ExpIntegralTable::operator()(const Vector3d& xymin, const Vector3d& xymax, const Vector3d& uvmin, const Vector3d& uvmax) const {
+    double pi=3.1415926535897931;
+    double x=lookup(mSqrtK*(xymin.x-uvmin.x))-lookup(mSqrtK*(xymax.x-uvmin.x))
+        -lookup(mSqrtK*(xymin.x-uvmax.x))+lookup(mSqrtK*(xymax.x-uvmax.x));
+    double y=lookup(mSqrtK*(xymin.y-uvmin.y))-lookup(mSqrtK*(xymax.y-uvmin.y))
+        -lookup(mSqrtK*(xymin.y-uvmax.y))+lookup(mSqrtK*(xymax.y-uvmax.y));
+    return pi/(4*mK*mK)*x*y;
+}
+
+void ExpIntegralTable::batch(const RegionPairs& pairs, double* results) const {
+    if (pairs.size()==0) return;
+    batchIntegral(mK,pairs,TableEdgeFunction(*this),results);
+}
+
 }
 int maino (int argc, char**argv) {
     float k=atof(argv[1]);
@@ -49,7 +49,34 @@
 #endif
 
 
+#include <sirikata/core/util/RegionWeightCalculator.hpp>
+
 namespace Sirikata {
 double integralExpFunction(double k, const Vector3d& xymin, const Vector3d& xymax, const Vector3d& uvmin, const Vector3d& uvmax);
+// Same as integralExpFunction, for many pairs at once
+void integralExpFunctionBatch(double k, const RegionPairs& pairs, double* results);
+
+/** Approximates integralExpFunction using a table. The integral along each
+ *  axis is a sum of one function of the distances between the regions'
+ *  edges, scaled by sqrt(k), which is tabulated once and evaluated with
+ *  cubic interpolation, avoiding the calls to erf and exp.
+ */
+class ExpIntegralTable {
+public:
+    ExpIntegralTable(double k, uint32 size);
+
+    double operator()(const Vector3d& xymin, const Vector3d& xymax, const Vector3d& uvmin, const Vector3d& uvmax) const;
+    void batch(const RegionPairs& pairs, double* results) const;
+
+    // Evaluate the tabulated function at normalized distance t
+    double lookup(double t) const;
+private:
+    double mK;
+    double mSqrtK;
+    double mStep;
+    double mInvStep;
+    std::vector<double> mValues;
+    std::vector<double> mSlopes;
+};
 }
 #endif
@@ -42,6 +42,8 @@ namespace Sirikata {
 static void InitPluginOptions() {
     Sirikata::InitializeClassOptions ico("weightexp",NULL,
         new Sirikata::OptionValue("flatness", "8", Sirikata::OptionValueType<double>(), "k where e^-kx is the bandwidth function and x is the distance between 2 server points"),
+        new Sirikata::OptionValue("table", "false", Sirikata::OptionValueType<bool>(), "approximate the integral with a precomputed table instead of evaluating it exactly"),
+        new Sirikata::OptionValue("table-size", "1024", Sirikata::OptionValueType<uint32>(), "number of entries in the table"),
         NULL);
 }
 
@@ -50,6 +52,26 @@ static RegionWeightCalculator* createRegionWeightCalculator(const String& args)
     optionsSet->parse(args);
 
     double flatness = optionsSet->referenceOption("flatness")->as<double>();
+    bool table = optionsSet->referenceOption("table")->as<bool>();
+    uint32 table_size = optionsSet->referenceOption("table-size")->as<uint32>();
+
+    if (table) {
+        // Shared by both functions, which keep it alive as long as the
+        // calculator
+        std::tr1::shared_ptr<ExpIntegralTable> integral(new ExpIntegralTable(flatness, table_size));
+        return new RegionWeightCalculator(
+            std::tr1::bind(&ExpIntegralTable::operator(),
+                integral,
+                std::tr1::placeholders::_1,
+                std::tr1::placeholders::_2,
+                std::tr1::placeholders::_3,
+                std::tr1::placeholders::_4),
+            std::tr1::bind(&ExpIntegralTable::batch,
+                integral,
+                std::tr1::placeholders::_1,
+                std::tr1::placeholders::_2)
+        );
+    }
 
     RegionWeightCalculator* result =
         new RegionWeightCalculator(
@@ -58,7 +80,11 @@ static RegionWeightCalculator* createRegionWeightCalculator(const String& args)
                 std::tr1::placeholders::_1,
                 std::tr1::placeholders::_2,
                 std::tr1::placeholders::_3,
-                std::tr1::placeholders::_4)
+                std::tr1::placeholders::_4),
+            std::tr1::bind(&integralExpFunctionBatch,
+                flatness,
+                std::tr1::placeholders::_1,
+                std::tr1::placeholders::_2)
         );
     return result;
 }
@@ -0,0 +1,219 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/network/IOProfiler.hpp>
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/command/Commander.hpp>
+#include <boost/thread/mutex.hpp>
+#include <fstream>
+
+namespace Sirikata {
+namespace Network {
+
+namespace {
+
+struct TagStats {
+    TagStats()
+     : count(0)
+    {}
+
+    uint64 count;
+    Duration waitTotal;
+    Duration waitMax;
+    Duration execTotal;
+    Duration execMax;
+};
+typedef std::map<String, TagStats> TagStatsMap;
+typedef std::map<String, TagStatsMap> QueueStatsMap;
+
+struct Sample {
+    String queue;
+    const char* tag;
+    Time start;
+    Duration wait;
+    Duration exec;
+};
+
+// Enough for a useful timeline without holding on to much memory
+const uint32 MAX_RECENT_SAMPLES = 16384;
+
+// Only touched for sampled handlers, so contention is rare
+boost::mutex gSamplesMutex;
+QueueStatsMap gStats;
+std::vector<Sample> gRecentSamples;
+uint32 gNextSample = 0;
+
+void recordSample(const String& queue, const char* tag, const Time& start, const Duration& wait, const Duration& exec) {
+    boost::mutex::scoped_lock lock(gSamplesMutex);
+
+    TagStats& stats = gStats[queue][tag == NULL ? "(NULL)" : tag];
+    stats.count++;
+    stats.waitTotal += wait;
+    if (wait > stats.waitMax) stats.waitMax = wait;
+    stats.execTotal += exec;
+    if (exec > stats.execMax) stats.execMax = exec;
+
+    Sample* sample;
+    if (gRecentSamples.size() < MAX_RECENT_SAMPLES) {
+        gRecentSamples.push_back(Sample());
+        sample = &gRecentSamples.back();
+    }
+    else {
+        sample = &gRecentSamples[gNextSample];
+        gNextSample = (gNextSample + 1) % MAX_RECENT_SAMPLES;
+    }
+    sample->queue = queue;
+    sample->tag = tag;
+    sample->start = start;
+    sample->wait = wait;
+    sample->exec = exec;
+}
+
+void runSampled(const String& queue, const Time& enqueued, const Duration& delay, const IOCallback& handler, const char* tag) {
+    Time start = Timer::now();
+    handler();
+    Time end = Timer::now();
+
+    Duration wait = (start - enqueued) - delay;
+    if (wait < Duration::zero()) wait = Duration::zero();
+    recordSample(queue, tag, start, wait, end - start);
+}
+
+} // namespace
+
+AtomicValue<uint32> IOProfiler::sSampleRate(0);
+
+IOProfiler::IOProfiler(const String& queue_name)
+ : mQueueName(queue_name),
+   mCounter(0)
+{
+}
+
+IOCallback IOProfiler::wrap(const IOCallback& handler, const char* tag, const Duration& delay) const {
+    return std::tr1::bind(&runSampled, mQueueName, Timer::now(), delay, handler, tag);
+}
+
+void IOProfiler::setSampleRate(uint32 rate) {
+    sSampleRate = rate;
+}
+
+uint32 IOProfiler::sampleRate() {
+    return sSampleRate.read();
+}
+
+void IOProfiler::reset() {
+    boost::mutex::scoped_lock lock(gSamplesMutex);
+    gStats.clear();
+    gRecentSamples.clear();
+    gNextSample = 0;
+}
+
+void IOProfiler::fillCommandResultWithStats(Command::Result& res) {
+    boost::mutex::scoped_lock lock(gSamplesMutex);
+
+    res.put("rate", sampleRate());
+    res.put("queues", Command::Array());
+    Command::Array& queues = res.getArray("queues");
+    for(QueueStatsMap::const_iterator queue_it = gStats.begin(); queue_it != gStats.end(); queue_it++) {
+        queues.push_back(Command::Object());
+        Command::Result& queue = queues.back();
+        queue.put("name", queue_it->first);
+        queue.put("tags", Command::Array());
+        Command::Array& tags = queue.getArray("tags");
+        for(TagStatsMap::const_iterator tag_it = queue_it->second.begin(); tag_it != queue_it->second.end(); tag_it++) {
+            const TagStats& stats = tag_it->second;
+            tags.push_back(Command::Object());
+            tags.back().put("tag", tag_it->first);
+            tags.back().put("samples", stats.count);
+            tags.back().put("wait.average", (stats.waitTotal / (float64)stats.count).toString());
+            tags.back().put("wait.max", stats.waitMax.toString());
+            tags.back().put("exec.average", (stats.execTotal / (float64)stats.count).toString());
+            tags.back().put("exec.max", stats.execMax.toString());
+            tags.back().put("exec.total", stats.execTotal.toString());
+        }
+    }
+}
+
+void IOProfiler::fillCommandResultWithTrace(Command::Result& res) {
+    boost::mutex::scoped_lock lock(gSamplesMutex);
+
+    res.put("traceEvents", Command::Array());
+    Command::Array& events = res.getArray("traceEvents");
+
+    // Each queue gets its own row in the timeline, labelled with its name
+    std::map<String, uint32> queue_ids;
+    for(uint32 i = 0; i < gRecentSamples.size(); i++) {
+        const Sample& sample = gRecentSamples[i];
+        std::map<String, uint32>::iterator id_it = queue_ids.find(sample.queue);
+        if (id_it == queue_ids.end()) {
+            id_it = queue_ids.insert(std::make_pair(sample.queue, (uint32)queue_ids.size())).first;
+            events.push_back(Command::Object());
+            events.back().put("name", "thread_name");
+            events.back().put("ph", "M");
+            events.back().put("pid", 0);
+            events.back().put("tid", id_it->second);
+            events.back().put("args.name", sample.queue);
+        }
+
+        events.push_back(Command::Object());
+        Command::Result& evt = events.back();
+        evt.put("name", sample.tag == NULL ? "(NULL)" : sample.tag);
+        evt.put("cat", "handler");
+        evt.put("ph", "X");
+        evt.put("pid", 0);
+        evt.put("tid", id_it->second);
+        evt.put("ts", (sample.start - Time::epoch()).toMicroseconds());
+        evt.put("dur", sample.exec.toMicroseconds());
+        evt.put("args.wait_us", sample.wait.toMicroseconds());
+    }
+}
+
+void IOProfiler::commandSetSampleRate(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+
+    if (!cmd.contains("rate")) {
+        result.put("error", "Ill-formatted request: rate not specified.");
+        cmdr->result(cmdid, result);
+        return;
+    }
+
+    int64 rate = cmd.getInt("rate", 0);
+    if (rate < 0) rate = 0;
+    setSampleRate((uint32)rate);
+    if (cmd.getBool("reset", false))
+        reset();
+
+    result.put("success", true);
+    result.put("rate", sampleRate());
+    cmdr->result(cmdid, result);
+}
+
+void IOProfiler::commandReportStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+    fillCommandResultWithStats(result);
+    cmdr->result(cmdid, result);
+}
+
+void IOProfiler::commandDumpTrace(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+    fillCommandResultWithTrace(result);
+
+    String filename = cmd.getString("file", "");
+    if (!filename.empty()) {
+        std::ofstream trace_file(filename.c_str(), std::ios::out | std::ios::trunc);
+        if (!trace_file) {
+            Command::Result error = Command::EmptyResult();
+            error.put("error", String("Couldn't open trace file ") + filename);
+            cmdr->result(cmdid, error);
+            return;
+        }
+        trace_file << json_spirit::write(result);
+    }
+
+    cmdr->result(cmdid, result);
+}
+
+} // namespace Network
+} // namespace Sirikata
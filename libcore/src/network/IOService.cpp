@@ -66,7 +66,8 @@ AllIOServicesSet gAllIOServices;
 
 
 IOService::IOService(const String& name)
- : mName(name)
+ : mName(name),
+   mProfiler(mName)
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
    ,
    mTimersEnqueued(0),
@@ -132,6 +133,15 @@ void IOService::reset() {
 
 void IOService::dispatch(
     const IOCallback& handler, const char* tag, const char* tagStat)
+{
+    if (mProfiler.sample())
+        dispatchUnprofiled(mProfiler.wrap(handler, tag), tag, tagStat);
+    else
+        dispatchUnprofiled(handler, tag, tagStat);
+}
+
+void IOService::dispatchUnprofiled(
+    const IOCallback& handler, const char* tag, const char* tagStat)
 {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mEnqueued++;
@@ -151,6 +161,15 @@ void IOService::dispatch(
 
 void IOService::post(
     const IOCallback& handler, const char* tag, const char* tagStat)
+{
+    if (mProfiler.sample())
+        postUnprofiled(mProfiler.wrap(handler, tag), tag, tagStat);
+    else
+        postUnprofiled(handler, tag, tagStat);
+}
+
+void IOService::postUnprofiled(
+    const IOCallback& handler, const char* tag, const char* tagStat)
 {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mEnqueued++;
@@ -178,6 +197,13 @@ void handle_deadline_timer(const boost::system::error_code&e, const deadline_tim
 } // namespace
 
 void IOService::post(const Duration& waitFor, const IOCallback& handler, const char* tag, const char* tagStat) {
+    if (mProfiler.sample())
+        postUnprofiled(waitFor, mProfiler.wrap(handler, tag, waitFor), tag, tagStat);
+    else
+        postUnprofiled(waitFor, handler, tag, tagStat);
+}
+
+void IOService::postUnprofiled(const Duration& waitFor, const IOCallback& handler, const char* tag, const char* tagStat) {
 #if BOOST_VERSION==103900
     static bool warnOnce=true;
     if (warnOnce) {
@@ -41,7 +41,8 @@ namespace Network {
 
 IOStrand::IOStrand(IOService& io, const String& name)
  : mService(io),
-   mName(name)
+   mName(name),
+   mProfiler(mName)
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
    ,
    mTimersEnqueued(0),
@@ -65,6 +66,13 @@ IOService& IOStrand::service() const {
 }
 
 void IOStrand::dispatch(const IOCallback& handler, const char* tag) {
+    if (mProfiler.sample())
+        dispatchUnprofiled(mProfiler.wrap(handler, tag), tag);
+    else
+        dispatchUnprofiled(handler, tag);
+}
+
+void IOStrand::dispatchUnprofiled(const IOCallback& handler, const char* tag) {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mEnqueued++;
     {
@@ -73,18 +81,25 @@ void IOStrand::dispatch(const IOCallback& handler, const char* tag) {
             mTagCounts[tag] = 0;
         mTagCounts[tag]++;
     }
-    mService.dispatch(
+    mService.dispatchUnprofiled(
         mImpl->wrap(
             std::tr1::bind(&IOStrand::decrementCount, this, Timer::now(), handler, tag)
         ),
         "(IOStrands)",tag
     );
 #else
-    mService.dispatch( mImpl->wrap( handler ) );
+    mService.dispatchUnprofiled( mImpl->wrap( handler ), NULL, NULL );
 #endif
 }
 
 void IOStrand::post(const IOCallback& handler, const char* tag) {
+    if (mProfiler.sample())
+        postUnprofiled(mProfiler.wrap(handler, tag), tag);
+    else
+        postUnprofiled(handler, tag);
+}
+
+void IOStrand::postUnprofiled(const IOCallback& handler, const char* tag) {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mEnqueued++;
     {
@@ -93,18 +108,25 @@ void IOStrand::post(const IOCallback& handler, const char* tag) {
             mTagCounts[tag] = 0;
         mTagCounts[tag]++;
     }
-    mService.post(
+    mService.postUnprofiled(
         mImpl->wrap(
             std::tr1::bind(&IOStrand::decrementCount, this, Timer::now(), handler, tag)
         ),
         "(IOStrands)", tag
     );
 #else
-    mService.post( mImpl->wrap( handler ) );
+    mService.postUnprofiled( mImpl->wrap( handler ), NULL, NULL );
 #endif
 }
 
 void IOStrand::post(const Duration& waitFor, const IOCallback& handler, const char* tag) {
+    if (mProfiler.sample())
+        postUnprofiled(waitFor, mProfiler.wrap(handler, tag, waitFor), tag);
+    else
+        postUnprofiled(waitFor, handler, tag);
+}
+
+void IOStrand::postUnprofiled(const Duration& waitFor, const IOCallback& handler, const char* tag) {
 #ifdef SIRIKATA_TRACK_EVENT_QUEUES
     mTimersEnqueued++;
     {
@@ -113,7 +135,7 @@ void IOStrand::post(const Duration& waitFor, const IOCallback& handler, const ch
             mTagCounts[tag] = 0;
         mTagCounts[tag]++;
     }
-    mService.post(
+    mService.postUnprofiled(
         waitFor,
         mImpl->wrap(
             std::tr1::bind(&IOStrand::decrementTimerCount, this, Timer::now(), waitFor, handler, tag)
@@ -121,7 +143,7 @@ void IOStrand::post(const Duration& waitFor, const IOCallback& handler, const ch
         "(IOStrands)",tag
     );
 #else
-    mService.post(waitFor, mImpl->wrap( handler ) );
+    mService.postUnprofiled(waitFor, mImpl->wrap( handler ), NULL, NULL );
 #endif
 }
 
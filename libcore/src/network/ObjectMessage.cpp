@@ -32,22 +32,70 @@
 
 #include <sirikata/core/network/ObjectMessage.hpp>
 #include <sirikata/core/util/SpaceObjectReference.hpp>
+#include <sirikata/core/util/FreeList.hpp>
+#include "Protocol_SessionBatch.pbj.hpp"
 
 namespace Sirikata {
 
+namespace {
+// Enough to cover a burst of messages between a thread releasing them and
+// allocating more, without holding on to much memory per thread
+#define OBJECT_MESSAGE_CACHE_PER_THREAD 1024
+
+void destroyObjectMessage(void* msg) {
+    delete static_cast<Sirikata::Protocol::Object::ObjectMessage*>(msg);
+}
+
+// Never freed, since messages may be released during static destruction
+FreeList* sObjectMessagePool = new FreeList(OBJECT_MESSAGE_CACHE_PER_THREAD, destroyObjectMessage);
+
+// Pooled messages whose payload buffer has grown past this are deleted rather
+// than cached, so a burst of large messages doesn't leave every cached message
+// holding a large buffer
+#define OBJECT_MESSAGE_MAX_CACHED_PAYLOAD 4096
+
+// Field number of ObjectMessage.payload in Protocol_ObjectMessage.pbj. This
+// must be kept in sync with the protocol, which ObjectMessageTest checks.
+#define OBJECT_MESSAGE_PAYLOAD_FIELD 6
+// Wire type 2, length delimited
+#define OBJECT_MESSAGE_PAYLOAD_TAG ((OBJECT_MESSAGE_PAYLOAD_FIELD << 3) | 2)
+}
+
+Sirikata::Protocol::Object::ObjectMessage* acquireObjectMessage() {
+    void* cached = sObjectMessagePool->pop();
+    if (cached != NULL)
+        return static_cast<Sirikata::Protocol::Object::ObjectMessage*>(cached);
+    return new Sirikata::Protocol::Object::ObjectMessage();
+}
+
+void releaseObjectMessage(Sirikata::Protocol::Object::ObjectMessage* msg) {
+    if (msg == NULL) return;
+    if (msg->payload().capacity() > OBJECT_MESSAGE_MAX_CACHED_PAYLOAD) {
+        delete msg;
+        return;
+    }
+    msg->clear_payload();
+    if (!sObjectMessagePool->push(msg))
+        delete msg;
+}
+
+uint64 objectMessageAllocations() {
+    return sObjectMessagePool->allocations();
+}
+
+void createObjectHostMessageHeader(ObjectHostID source_server, const SpaceObjectReference& sporef_src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, ObjectMessage* result) {
+    createObjectHostMessageHeader(source_server, sporef_src.object().getAsUUID(), src_port, dest, dest_port, result);
+}
+
 void createObjectHostMessage(ObjectHostID source_server, const SpaceObjectReference& sporef_src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload, ObjectMessage* result) {
     if (result == NULL) return;
 
-    result->set_source_object(sporef_src.object().getAsUUID());
-    result->set_source_port(src_port);
-    result->set_dest_object(dest);
-    result->set_dest_port(dest_port);
-    result->set_unique(GenerateUniqueID(source_server));
+    createObjectHostMessageHeader(source_server, sporef_src, src_port, dest, dest_port, result);
     result->set_payload(payload);
 }
 
 Sirikata::Protocol::Object::ObjectMessage* createObjectMessage(ServerID source_server, const SpaceObjectReference& sporef_src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload) {
-    Sirikata::Protocol::Object::ObjectMessage* result = new Sirikata::Protocol::Object::ObjectMessage();
+    Sirikata::Protocol::Object::ObjectMessage* result = acquireObjectMessage();
 
     result->set_source_object(sporef_src.object().getAsUUID());
     result->set_source_port(src_port);
@@ -60,7 +108,7 @@ Sirikata::Protocol::Object::ObjectMessage* createObjectMessage(ServerID source_s
 }
 
 
-void createObjectHostMessage(ObjectHostID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload, ObjectMessage* result) {
+void createObjectHostMessageHeader(ObjectHostID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, ObjectMessage* result) {
     if (result == NULL) return;
 
     result->set_source_object(src);
@@ -68,12 +116,18 @@ void createObjectHostMessage(ObjectHostID source_server, const UUID& src, Object
     result->set_dest_object(dest);
     result->set_dest_port(dest_port);
     result->set_unique(GenerateUniqueID(source_server));
+}
+
+void createObjectHostMessage(ObjectHostID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload, ObjectMessage* result) {
+    if (result == NULL) return;
+
+    createObjectHostMessageHeader(source_server, src, src_port, dest, dest_port, result);
     result->set_payload(payload);
 }
 
 
 Sirikata::Protocol::Object::ObjectMessage* createObjectMessage(ServerID source_server, const UUID& src, ObjectMessagePort src_port, const UUID& dest, ObjectMessagePort dest_port, const std::string& payload) {
-    Sirikata::Protocol::Object::ObjectMessage* result = new Sirikata::Protocol::Object::ObjectMessage();
+    Sirikata::Protocol::Object::ObjectMessage* result = acquireObjectMessage();
 
     result->set_source_object(src);
     result->set_source_port(src_port);
@@ -85,6 +139,43 @@ Sirikata::Protocol::Object::ObjectMessage* createObjectMessage(ServerID source_s
     return result;
 }
 
+std::string serializeSessionBatch(const SessionBatchEntryList& entries) {
+    Sirikata::Protocol::SessionBatch::Batch batch;
+    for(SessionBatchEntryList::const_iterator it = entries.begin(); it != entries.end(); it++) {
+        Sirikata::Protocol::SessionBatch::IEntry entry = batch.add_entries();
+        entry.set_object(it->first);
+        entry.set_session(it->second);
+    }
+    return serializePBJMessage(batch);
+}
+
+bool parseSessionBatch(const std::string& payload, SessionBatchEntryList* entries_out) {
+    Sirikata::Protocol::SessionBatch::Batch batch;
+    if (!batch.ParseFromString(payload))
+        return false;
+
+    entries_out->reserve(entries_out->size() + batch.entries_size());
+    for(int32 i = 0; i < batch.entries_size(); i++) {
+        Sirikata::Protocol::SessionBatch::Entry entry = batch.entries(i);
+        entries_out->push_back(SessionBatchEntry(entry.object(), entry.session()));
+    }
+    return true;
+}
+
 
+bool serializeObjectMessageHeader(const Sirikata::Protocol::Object::ObjectMessage& msg, uint32 payload_size, std::string* result) {
+    assert(!msg.has_payload());
+    if (!serializePBJMessage(result, msg))
+        return false;
+
+    result->push_back((char)OBJECT_MESSAGE_PAYLOAD_TAG);
+    uint32 len = payload_size;
+    while(len >= 0x80) {
+        result->push_back((char)((len & 0x7F) | 0x80));
+        len >>= 7;
+    }
+    result->push_back((char)len);
+    return true;
+}
 
 } // namespace Sirikata
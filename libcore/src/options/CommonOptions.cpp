@@ -34,6 +34,7 @@
 #include <sirikata/core/options/Options.hpp>
 #include <sirikata/core/util/Time.hpp>
 #include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/network/IOProfiler.hpp>
 
 namespace Sirikata {
 
@@ -96,8 +97,17 @@ void InitOptions() {
         .addOption(new OptionValue(OPT_CDN_UPLOAD_URI_PREFIX, "/api/upload", Sirikata::OptionValueType<String>(), "URI prefix for CDN HTTP uploads."))
         .addOption(new OptionValue(OPT_CDN_UPLOAD_STATUS_URI_PREFIX, "/upload/processing", Sirikata::OptionValueType<String>(), "URI prefix for CDN HTTP upload status checks."))
 
+        .addOption(new OptionValue(OPT_HTTP_THREADS, "2", Sirikata::OptionValueType<uint32>(), "Number of threads handling HTTP connections."))
+        .addOption(new OptionValue(OPT_HTTP_MAX_CONNECTIONS, "40", Sirikata::OptionValueType<uint32>(), "Maximum number of open HTTP connections."))
+        .addOption(new OptionValue(OPT_HTTP_MAX_ENDPOINT_CONNECTIONS, "8", Sirikata::OptionValueType<uint32>(), "Maximum number of open HTTP connections to a single host:port."))
+        .addOption(new OptionValue(OPT_HTTP_PIPELINE_DEPTH, "4", Sirikata::OptionValueType<uint32>(), "Maximum number of GET and HEAD requests outstanding on a single HTTP connection. 1 disables pipelining."))
+
+        .addOption(new OptionValue(OPT_SST_CONGESTION_CONTROL, "cubic", Sirikata::OptionValueType<String>(), "Congestion control algorithm for SST connections: cubic or newreno."))
+
         .addOption(new OptionValue(OPT_TRACE_TIMESERIES, "null", Sirikata::OptionValueType<String>(), "Service to report TimeSeries data to."))
         .addOption(new OptionValue(OPT_TRACE_TIMESERIES_OPTIONS, "", Sirikata::OptionValueType<String>(), "Options for TimeSeries reporting service."))
+        .addOption(new OptionValue(OPT_TRACE_METRICS_INTERVAL, "1s", Sirikata::OptionValueType<Duration>(), "How often aggregated metrics are reported to the TimeSeries service."))
+        .addOption(new OptionValue(OPT_PROFILE_SAMPLE_RATE, "0", Sirikata::OptionValueType<uint32>(), "Sample 1 in every N event handlers, recording their queueing and execution times. 0 disables sampling, which can also be turned on at runtime."))
 
         .addOption(new OptionValue(OPT_COMMAND_COMMANDER, "", Sirikata::OptionValueType<String>(), "Commander service to start"))
         .addOption(new OptionValue(OPT_COMMAND_COMMANDER_OPTIONS, "", Sirikata::OptionValueType<String>(), "Options for the Commander service"))
@@ -106,6 +116,9 @@ void InitOptions() {
 
 namespace {
 void setLogOutput() {
+    // Log levels may have changed as well
+    Sirikata::Logging::UpdateLogLevels();
+
     String logfile = GetOptionValue<String>(OPT_LOG_FILE);
     if (logfile != "" && logfile != "-") {
         // Try to open the log file
@@ -119,24 +132,31 @@ void setLogOutput() {
     Sirikata::Logging::SirikataLogStream = &std::cerr;
 }
 
+void setProfilerSampleRate() {
+    Sirikata::Network::IOProfiler::setSampleRate(GetOptionValue<uint32>(OPT_PROFILE_SAMPLE_RATE));
+}
+
 }
 
 void FakeParseOptions() {
     OptionSet* options = OptionSet::getOptions(SIRIKATA_OPTIONS_MODULE,NULL);
     int argc = 1; const char* argv[2] = { "bogus", NULL };
     options->parse(argc, argv);
+    Sirikata::Logging::UpdateLogLevels();
 }
 
 void ParseOptions(int argc, char** argv, UnregisteredOptionBehavior unreg) {
     OptionSet* options = OptionSet::getOptions(SIRIKATA_OPTIONS_MODULE,NULL);
     options->parse(argc, argv, true, false, (unreg == AllowUnregisteredOptions));
     setLogOutput();
+    setProfilerSampleRate();
 }
 
 void ParseOptionsFile(const String& fname, bool required, UnregisteredOptionBehavior unreg) {
     OptionSet* options = OptionSet::getOptions(SIRIKATA_OPTIONS_MODULE,NULL);
     options->parseFile(fname, required, true, false, (unreg == AllowUnregisteredOptions));
     setLogOutput();
+    setProfilerSampleRate();
 }
 
 void ParseOptions(int argc, char** argv, const String& config_file_option, UnregisteredOptionBehavior unreg) {
@@ -158,6 +178,7 @@ void ParseOptions(int argc, char** argv, const String& config_file_option, Unreg
     options->parse(argc, argv, false, false, (unreg == AllowUnregisteredOptions));
 
     setLogOutput();
+    setProfilerSampleRate();
 }
 
 void FillMissingOptionDefaults() {
@@ -166,6 +187,7 @@ void FillMissingOptionDefaults() {
     // Parse command line once to make sure we have the right config
     // file. On this pass, use defaults so everything gets filled in.
     options->fillMissingDefaults();
+    Sirikata::Logging::UpdateLogLevels();
 }
 
 OptionValue* GetOption(const char* name) {
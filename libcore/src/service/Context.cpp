@@ -35,6 +35,7 @@
 #include <sirikata/core/network/IOStrandImpl.hpp>
 #include <boost/asio.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string.hpp>
 #include <sirikata/core/service/Breakpad.hpp>
 #include <sirikata/core/command/Commander.hpp>
 
@@ -48,6 +49,7 @@ Context::Context(const String& name_, Network::IOService* ios, Network::IOStrand
    mainStrand(strand),
    profiler(NULL),
    timeSeries(NULL),
+   metrics(NULL),
    mFinishedTimer( Network::IOTimer::create(ios) ),
    mTrace(_trace),
    mCommander(NULL),
@@ -62,10 +64,12 @@ Context::Context(const String& name_, Network::IOService* ios, Network::IOStrand
     CTX_LOG(info, "Creating context");
   Breakpad::init();
   profiler = new TimeProfiler(this, name);
+  metrics = new Trace::MetricsRegistry(this);
 }
 
 Context::~Context() {
     CTX_LOG(info, "Destroying context");
+    delete metrics;
     delete profiler;
 }
 
@@ -74,6 +78,8 @@ void Context::start() {
         std::tr1::bind(&Context::handleSignal, this, std::tr1::placeholders::_1)
     );
 
+    metrics->start();
+
     if (mSimDuration == Duration::zero())
         return;
 
@@ -145,6 +151,7 @@ void Context::stop() {
     if (!mStopRequested.read()) {
         mStopRequested = true;
         mFinishedTimer.reset();
+        metrics->stop();
         startForceQuitTimer();
     }
 }
@@ -201,6 +208,30 @@ void commandShutdown(Context* ctx, const Command::Command& cmd, Command::Command
     cmdr->result(cmdid, result);
     ctx->shutdown();
 }
+
+void commandLogLevels(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+    Logging::LogLevelMap levels = Logging::GetLogLevels();
+    for(Logging::LogLevelMap::iterator it = levels.begin(); it != levels.end(); it++)
+        result.put(String("modules.") + it->first, boost::to_lower_copy(boost::trim_copy(String(Logging::LogLevelString(it->second, "unknown")))));
+    cmdr->result(cmdid, result);
+}
+
+void commandSetLogLevel(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+
+    Logging::LOGGING_LEVEL lvl;
+    if (!cmd.contains("level") || !Logging::ParseLogLevel(cmd.getString("level"), &lvl)) {
+        result.put("error", "Ill-formatted request: level not specified or invalid.");
+        cmdr->result(cmdid, result);
+        return;
+    }
+
+    // No module sets the default level
+    Logging::SetLogLevel(cmd.getString("module", ""), lvl);
+    result.put("success", true);
+    cmdr->result(cmdid, result);
+}
 }
 
 void Context::setCommander(Command::Commander* c) {
@@ -208,6 +239,11 @@ void Context::setCommander(Command::Commander* c) {
         mCommander->unregisterCommand("context.shutdown");
         mCommander->unregisterCommand("context.report-stats");
         mCommander->unregisterCommand("context.report-all-stats");
+        mCommander->unregisterCommand("context.profile-sampling");
+        mCommander->unregisterCommand("context.profile-report");
+        mCommander->unregisterCommand("context.profile-trace");
+        mCommander->unregisterCommand("logging.levels");
+        mCommander->unregisterCommand("logging.set-level");
     }
 
     mCommander = c;
@@ -226,6 +262,27 @@ void Context::setCommander(Command::Commander* c) {
             "context.report-all-stats",
             std::tr1::bind(&Network::IOService::commandReportAllStats, _1, _2, _3)
         );
+        mCommander->registerCommand(
+            "context.profile-sampling",
+            std::tr1::bind(&Network::IOProfiler::commandSetSampleRate, _1, _2, _3)
+        );
+        mCommander->registerCommand(
+            "context.profile-report",
+            std::tr1::bind(&Network::IOProfiler::commandReportStats, _1, _2, _3)
+        );
+        mCommander->registerCommand(
+            "context.profile-trace",
+            std::tr1::bind(&Network::IOProfiler::commandDumpTrace, _1, _2, _3)
+        );
+
+        mCommander->registerCommand(
+            "logging.levels",
+            std::tr1::bind(commandLogLevels, _1, _2, _3)
+        );
+        mCommander->registerCommand(
+            "logging.set-level",
+            std::tr1::bind(commandSetLogLevel, _1, _2, _3)
+        );
     }
 }
 
@@ -0,0 +1,176 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/trace/Metrics.hpp>
+#include <sirikata/core/service/Context.hpp>
+#include <sirikata/core/service/Poller.hpp>
+
+namespace Sirikata {
+namespace Trace {
+
+MetricHistogram::MetricHistogram()
+ : mSum(0)
+{
+    for(uint32 i = 0; i < NUM_BUCKETS; i++)
+        mBuckets[i] = 0;
+}
+
+uint32 MetricHistogram::bucketIndex(uint64 val) {
+    const uint64 max_val = ((uint64)1 << MAX_VALUE_BITS) - 1;
+    if (val > max_val) val = max_val;
+    if (val < SUB_BUCKETS) return (uint32)val;
+
+    uint32 msb = 0;
+    for(uint64 v = val; v > 1; v >>= 1) msb++;
+    // Shift so the top SUB_BUCKET_BITS bits remain, leaving a value in
+    // [SUB_BUCKETS/2, SUB_BUCKETS)
+    uint32 shift = msb - (SUB_BUCKET_BITS - 1);
+    uint32 sub = (uint32)(val >> shift) - SUB_BUCKETS / 2;
+    return SUB_BUCKETS + (shift - 1) * (SUB_BUCKETS / 2) + sub;
+}
+
+uint64 MetricHistogram::bucketUpperBound(uint32 idx) {
+    if (idx < SUB_BUCKETS) return idx;
+    uint32 k = idx - SUB_BUCKETS;
+    uint32 shift = k / (SUB_BUCKETS / 2) + 1;
+    uint64 sub = k % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2;
+    return ((sub + 1) << shift) - 1;
+}
+
+void MetricHistogram::record(uint64 val) {
+    mBuckets[bucketIndex(val)]++;
+    mSum += val;
+}
+
+MetricHistogram::Summary MetricHistogram::take() {
+    Summary result;
+
+    uint32 counts[NUM_BUCKETS];
+    for(uint32 i = 0; i < NUM_BUCKETS; i++) {
+        counts[i] = mBuckets[i].read();
+        mBuckets[i] -= counts[i];
+        result.count += counts[i];
+    }
+    uint64 sum = mSum.read();
+    mSum -= sum;
+    if (result.count == 0) return result;
+
+    result.mean = sum / (float64)result.count;
+
+    // Smallest bucket whose cumulative count reaches each percentile
+    uint64 p50_rank = (result.count * 50 + 99) / 100;
+    uint64 p90_rank = (result.count * 90 + 99) / 100;
+    uint64 p99_rank = (result.count * 99 + 99) / 100;
+    uint64 cumulative = 0;
+    for(uint32 i = 0; i < NUM_BUCKETS; i++) {
+        if (counts[i] == 0) continue;
+        uint64 prev = cumulative;
+        cumulative += counts[i];
+        uint64 bound = bucketUpperBound(i);
+        if (prev < p50_rank && cumulative >= p50_rank) result.p50 = bound;
+        if (prev < p90_rank && cumulative >= p90_rank) result.p90 = bound;
+        if (prev < p99_rank && cumulative >= p99_rank) result.p99 = bound;
+        result.max = bound;
+    }
+    return result;
+}
+
+
+
+MetricsRegistry::MetricsRegistry(Context* ctx, const Duration& interval)
+ : mContext(ctx),
+   mInterval(interval),
+   mFlushPoller(NULL)
+{
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    delete mFlushPoller;
+
+    for(CounterMap::iterator it = mCounters.begin(); it != mCounters.end(); it++)
+        delete it->second;
+    for(GaugeMap::iterator it = mGauges.begin(); it != mGauges.end(); it++)
+        delete it->second;
+    for(HistogramMap::iterator it = mHistograms.begin(); it != mHistograms.end(); it++)
+        delete it->second;
+}
+
+template<typename MetricType>
+MetricType* MetricsRegistry::lookup(std::map<String, MetricType*>& metrics, const String& name) {
+    boost::mutex::scoped_lock lock(mMutex);
+    typename std::map<String, MetricType*>::iterator it = metrics.find(name);
+    if (it != metrics.end()) return it->second;
+    MetricType* result = new MetricType();
+    metrics[name] = result;
+    return result;
+}
+
+MetricCounter* MetricsRegistry::counter(const String& name) {
+    return lookup(mCounters, name);
+}
+
+MetricGauge* MetricsRegistry::gauge(const String& name) {
+    return lookup(mGauges, name);
+}
+
+MetricHistogram* MetricsRegistry::histogram(const String& name) {
+    return lookup(mHistograms, name);
+}
+
+void MetricsRegistry::setFlushInterval(const Duration& interval) {
+    mInterval = interval;
+}
+
+void MetricsRegistry::start() {
+    if (mFlushPoller != NULL) return;
+
+    mLastFlush = mContext->simTime();
+    mFlushPoller = new Poller(
+        mContext->mainStrand,
+        std::tr1::bind(&MetricsRegistry::flush, this),
+        "MetricsRegistry::flush",
+        mInterval
+    );
+    mFlushPoller->start();
+}
+
+void MetricsRegistry::stop() {
+    if (mFlushPoller == NULL) return;
+
+    mFlushPoller->stop();
+    flush();
+}
+
+void MetricsRegistry::flush() {
+    Time tnow = mContext->simTime();
+    float64 since_last_seconds = (tnow - mLastFlush).toSeconds();
+    mLastFlush = tnow;
+    if (since_last_seconds <= 0) return;
+
+    boost::mutex::scoped_lock lock(mMutex);
+    mSamples.clear();
+    for(CounterMap::iterator it = mCounters.begin(); it != mCounters.end(); it++)
+        mSamples.push_back(TimeSeries::Sample(it->first, it->second->take() / since_last_seconds));
+    for(GaugeMap::iterator it = mGauges.begin(); it != mGauges.end(); it++)
+        mSamples.push_back(TimeSeries::Sample(it->first, it->second->read()));
+    for(HistogramMap::iterator it = mHistograms.begin(); it != mHistograms.end(); it++) {
+        MetricHistogram::Summary summary = it->second->take();
+        mSamples.push_back(TimeSeries::Sample(it->first + ".count", summary.count));
+        // Percentiles of an empty interval are meaningless, so leave gaps
+        // rather than reporting zeros
+        if (summary.count == 0) continue;
+        mSamples.push_back(TimeSeries::Sample(it->first + ".mean", summary.mean));
+        mSamples.push_back(TimeSeries::Sample(it->first + ".p50", summary.p50));
+        mSamples.push_back(TimeSeries::Sample(it->first + ".p90", summary.p90));
+        mSamples.push_back(TimeSeries::Sample(it->first + ".p99", summary.p99));
+        mSamples.push_back(TimeSeries::Sample(it->first + ".max", summary.max));
+    }
+
+    if (mContext->timeSeries != NULL && !mSamples.empty())
+        mContext->timeSeries->reportBatch(mSamples);
+}
+
+} // namespace Trace
+} // namespace Sirikata
@@ -33,6 +33,8 @@
 #include <sirikata/core/util/Standard.hh>
 #include <sirikata/core/trace/TimeSeries.hpp>
 #include <sirikata/core/service/Context.hpp>
+#include <boost/thread/mutex.hpp>
+#include <fstream>
 
 AUTO_SINGLETON_INSTANCE(Sirikata::Trace::TimeSeriesFactory);
 
@@ -51,11 +53,74 @@ TimeSeries::~TimeSeries() {
 void TimeSeries::report(const String& name, float64 val) {
 }
 
+void TimeSeries::reportBatch(const SampleList& samples) {
+    for(SampleList::const_iterator it = samples.begin(); it != samples.end(); it++)
+        report(it->name, it->value);
+}
+
+int64 TimeSeries::unixTimestamp() const {
+    static Time unix_epoch = Timer::getSpecifiedDate(String("1970-01-01 00:00:00.000"));
+    return (int64)(mContext->recentRealTime() - unix_epoch).seconds();
+}
+
+void TimeSeries::appendPlaintext(String* out, const String& name, float64 val, int64 timestamp) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), " %.10g %lld\n", val, (long long)timestamp);
+    out->append(name);
+    out->append(buf, std::min(len, (int)sizeof(buf) - 1));
+}
+
 
 namespace {
+
+/** Writes samples to a local file in Graphite's plaintext format, one write
+ *  per batch. Useful for collecting data without running Graphite, or for
+ *  loading it later.
+ */
+class FileTimeSeries : public TimeSeries {
+  public:
+    FileTimeSeries(Context* ctx, const String& filename)
+     : TimeSeries(ctx),
+       mFile(filename.c_str(), std::ios::out | std::ios::app)
+    {
+        if (!mFile)
+            SILOG(timeseries, error, "Couldn't open " << filename << " for TimeSeries data");
+    }
+
+    virtual void report(const String& name, float64 val) {
+        SampleList samples;
+        samples.push_back(Sample(name, val));
+        reportBatch(samples);
+    }
+
+    virtual void reportBatch(const SampleList& samples) {
+        if (!mFile) return;
+
+        String data;
+        int64 timestamp = unixTimestamp();
+        for(SampleList::const_iterator it = samples.begin(); it != samples.end(); it++)
+            appendPlaintext(&data, it->name, it->value, timestamp);
+
+        boost::mutex::scoped_lock lock(mMutex);
+        mFile.write(data.data(), data.size());
+        mFile.flush();
+    }
+
+  private:
+    boost::mutex mMutex;
+    std::ofstream mFile;
+};
+
 TimeSeries* createNullTimeSeries(Context* ctx, const String& opts) {
     return new TimeSeries(ctx);
 }
+
+// The options are just the name of the file to write to
+TimeSeries* createFileTimeSeries(Context* ctx, const String& opts) {
+    String filename = opts.empty() ? String("timeseries.txt") : opts;
+    return new FileTimeSeries(ctx, filename);
+}
+
 }
 
 TimeSeriesFactory::TimeSeriesFactory() {
@@ -66,6 +131,10 @@ TimeSeriesFactory::TimeSeriesFactory() {
         createNullTimeSeries,
         true
     );
+    registerConstructor(
+        "file",
+        createFileTimeSeries
+    );
 }
 
 TimeSeriesFactory::~TimeSeriesFactory() {
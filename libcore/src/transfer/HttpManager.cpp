@@ -35,8 +35,11 @@
 #include <sirikata/core/transfer/URL.hpp>
 #include <sirikata/core/network/Address.hpp>
 #include <liboauthcpp/liboauthcpp.h>
+#include <sirikata/core/options/CommonOptions.hpp>
+#include <sirikata/core/util/Timer.hpp>
 
 #include <boost/lexical_cast.hpp>
+#include <zlib.h>
 #include <sirikata/core/util/UUID.hpp>
 
 AUTO_SINGLETON_INSTANCE(Sirikata::Transfer::HttpManager);
@@ -51,6 +54,45 @@ void HttpManager::destroy() {
     AutoSingleton<HttpManager>::destroy();
 }
 
+namespace {
+// HttpManager may be used without the common options having been initialized,
+// e.g. by the crash reporter, so fall back to defaults if they are missing.
+uint32 GetHttpOption(const char* name, uint32 default_value) {
+    OptionValue* opt = GetOption(name);
+    if (opt == NULL || opt->get()->empty())
+        return default_value;
+    return opt->unsafeAs<uint32>();
+}
+}
+
+HttpManager::HttpResponse::HttpResponse()
+ : mLastCallback(NONE), mHeaderComplete(false), mMessageComplete(false),
+   mGzip(false), mInflater(NULL), mInflateComplete(false), mBodyBytes(0),
+   mData(new DenseData(Range(true))),
+   mContentLength(0), mStatusCode(0)
+{
+}
+
+HttpManager::HttpResponse::~HttpResponse() {
+    if (mInflater != NULL) {
+        inflateEnd(mInflater);
+        delete mInflater;
+    }
+}
+
+HttpManager::HttpConnection::HttpConnection(const Sirikata::Network::Address& _addr, Sirikata::Network::IOService* service)
+ : addr(_addr),
+   socket(new TCPSocket(*service)),
+   mConnected(false),
+   mClosed(false),
+   mCloseAfterResponse(false),
+   mWriting(false),
+   mNumServed(0),
+   mLastComplete(Time::null()),
+   mReadBuffer(SOCKET_BUFFER_SIZE)
+{
+}
+
 HttpManager::HttpManager()
     : mNumTotalConnections(0) {
 
@@ -65,13 +107,17 @@ HttpManager::HttpManager()
     EMPTY_PARSER_SETTINGS.on_headers_complete = 0;
     EMPTY_PARSER_SETTINGS.on_message_complete = 0;
 
-    //Making a single thread IOService to handle requests
-    mServicePool = new IOServicePool("HttpManager", 2);
+    mMaxConnectionsPerEndpoint = std::max(GetHttpOption(OPT_HTTP_MAX_ENDPOINT_CONNECTIONS, 8), (uint32)1);
+    mMaxTotalConnections = std::max(GetHttpOption(OPT_HTTP_MAX_CONNECTIONS, 40), (uint32)1);
+    mMaxPipelineDepth = std::max(GetHttpOption(OPT_HTTP_PIPELINE_DEPTH, 4), (uint32)1);
+    uint32 nthreads = std::max(GetHttpOption(OPT_HTTP_THREADS, 2), (uint32)1);
+
+    mServicePool = new IOServicePool("HttpManager", nthreads);
 
     //Add a dummy IOWork so that the IOService stays running
     mServicePool->startWork();
 
-    //This runs an IOService in a new thread
+    //This runs the IOService in the pool's threads
     mServicePool->run();
 
     //Used to resolve host:port names to IP addresses
@@ -90,7 +136,7 @@ HttpManager::~HttpManager() {
     //Clean up any data we still have to make sure anything
     //referencing the service pool is dead
     mRequestQueue.clear();
-    mRecycleBin.clear();
+    mConnections.clear();
 
     //Delete dummy worker and service pool
     mServicePool->stopWork();
@@ -309,321 +355,435 @@ void HttpManager::postMultipartForm(
 
 
 void HttpManager::processQueue() {
+    boost::unique_lock<boost::mutex> lockQueue(mRequestQueueLock);
+    boost::unique_lock<boost::mutex> lockConns(mConnectionsLock);
+
     SILOG(transfer, insane, "processQueue called, mNumTotalConnections = "
-            << mNumTotalConnections << " and recycle bin size = " << mRecycleBin.size()
-            << " and size of hosts = " << mNumConnsPerAddr.size()
+            << mNumTotalConnections << " and size of hosts = " << mConnections.size()
             << " and request queue size = " << mRequestQueue.size());
 
-    boost::unique_lock<boost::mutex> lockQueue(mRequestQueueLock);
-    boost::unique_lock<boost::mutex> lockNumConns(mNumConnsLock, boost::defer_lock);
-
     for (RequestQueueType::iterator req = mRequestQueue.begin(); req != mRequestQueue.end(); ) {
+        if (assign_request(*req))
+            req = mRequestQueue.erase(req);
+        else
+            req++;
+    }
+}
+
+bool HttpManager::assign_request(HttpRequestPtr req) {
+    ConnectionMap::iterator findConns = mConnections.find(req->addr);
 
-        std::tr1::shared_ptr<TCPSocket> sock;
-
-        //First check the recycle bin to see if there's a connection already open we can use
-        boost::unique_lock<boost::mutex> lockRB(mRecycleBinLock); {
-            RecycleBinType::iterator findRec = mRecycleBin.find((*req)->addr);
-            if (findRec != mRecycleBin.end()) {
-                sock = findRec->second.front();
-                findRec->second.pop();
-                if (findRec->second.size() == 0) {
-                    mRecycleBin.erase(findRec);
-                }
+    //Connections to this endpoint which could take the request if we don't
+    //open a new one: the one with the fewest outstanding requests
+    HttpConnectionPtr pipelineConn;
+    size_t pipelineDepth = 0;
+
+    if (findConns != mConnections.end()) {
+        for(ConnectionList::iterator it = findConns->second.begin(); it != findConns->second.end(); it++) {
+            HttpConnectionPtr conn = *it;
+            boost::unique_lock<boost::mutex> lockConn(conn->mMutex);
+            if (conn->mClosed || conn->mCloseAfterResponse) continue;
+
+            //An idle connection is always the best choice
+            if (conn->mPending.empty()) {
+                assign_to_connection(conn, req);
+                return true;
+            }
+
+            //Only idempotent requests are pipelined, and never behind a
+            //request that isn't, so a failed connection can always be
+            //retried safely.
+            if (req->method == POST || conn->mPending.back()->method == POST)
+                continue;
+            if (conn->mPending.size() >= mMaxPipelineDepth)
+                continue;
+            if (!pipelineConn || conn->mPending.size() < pipelineDepth) {
+                pipelineConn = conn;
+                pipelineDepth = conn->mPending.size();
             }
         }
-        lockRB.unlock();
+    }
 
-        if (sock) {
-            //SILOG(transfer, debug, "Reusing a connection for " << (*req)->addr.toString());
-            write_request(sock, *req);
-            req = mRequestQueue.erase(req);
-        } else {
-
-            lockNumConns.lock(); {
-                //If nothing in the recycle bin, let's see if we can open a new connection
-                if (mNumTotalConnections < MAX_TOTAL_CONNECTIONS) {
-                    NumConnsType::iterator findNumC = mNumConnsPerAddr.find((*req)->addr);
-                    if (mNumTotalConnections < MAX_TOTAL_CONNECTIONS &&
-                            (findNumC == mNumConnsPerAddr.end() || findNumC->second < MAX_CONNECTIONS_PER_ENDPOINT)) {
-
-                        //We are safe to open a new connection, but increase counts first
-                        mNumTotalConnections++;
-                        if (findNumC == mNumConnsPerAddr.end()) {
-                           mNumConnsPerAddr[(*req)->addr] = 1;
-                        } else {
-                            mNumConnsPerAddr[(*req)->addr] = findNumC->second + 1;
-                        }
-
-                        //SILOG(transfer, debug, "Creating a new connection for " << (*req)->addr.toString());
-                        TCPResolver::query query((*req)->addr.getHostName(), (*req)->addr.getService(), Network::TCPResolver::query::all_matching);
-                        mResolver->async_resolve(query, boost::bind(&HttpManager::handle_resolve, this, *req,
-                                                boost::asio::placeholders::error, boost::asio::placeholders::iterator));
-
-                        req = mRequestQueue.erase(req);
-                    } else {
-                        //No available recycled connections, can't open a new one, so do nothing
-                        req++;
-                    }
-                } else {
-                    //No available recycled connections, can't open a new one, so do nothing
-                    req++;
-                }
-            } lockNumConns.unlock();
+    //Prefer a new connection, which avoids waiting behind other responses
+    uint32 endpointConns = (findConns == mConnections.end() ? 0 : findConns->second.size());
+    if (mNumTotalConnections < mMaxTotalConnections && endpointConns < mMaxConnectionsPerEndpoint) {
+        HttpConnectionPtr conn(new HttpConnection(req->addr, mServicePool->service()));
+        mConnections[req->addr].push_back(conn);
+        mNumTotalConnections++;
+        record_connection(req->addr);
+
+        conn->mHttpSettings = EMPTY_PARSER_SETTINGS;
+        conn->mHttpSettings.on_header_field = &HttpManager::on_header_field;
+        conn->mHttpSettings.on_header_value = &HttpManager::on_header_value;
+        conn->mHttpSettings.on_body = &HttpManager::on_body;
+        conn->mHttpSettings.on_headers_complete = &HttpManager::on_headers_complete;
+        conn->mHttpSettings.on_message_complete = &HttpManager::on_message_complete;
+        http_parser_init(&(conn->mHttpParser), HTTP_RESPONSE);
+        /*
+         * http-parser library uses this void * parameter to callbacks for user-defined data
+         * Store a pointer to the HttpConnection object so we can access it during static callbacks
+         */
+        conn->mHttpParser.data = static_cast<void *>(conn.get());
+        reset_response(conn.get());
+
+        {
+            boost::unique_lock<boost::mutex> lockConn(conn->mMutex);
+            assign_to_connection(conn, req);
         }
+
+        //SILOG(transfer, debug, "Creating a new connection for " << req->addr.toString());
+        TCPResolver::query query(req->addr.getHostName(), req->addr.getService(), Network::TCPResolver::query::all_matching);
+        mResolver->async_resolve(query, boost::bind(&HttpManager::handle_resolve, this, conn,
+                boost::asio::placeholders::error, boost::asio::placeholders::iterator));
+        return true;
     }
 
-    lockQueue.unlock();
+    if (pipelineConn) {
+        boost::unique_lock<boost::mutex> lockConn(pipelineConn->mMutex);
+        if (!pipelineConn->mClosed && !pipelineConn->mCloseAfterResponse) {
+            assign_to_connection(pipelineConn, req);
+            return true;
+        }
+    }
+
+    //No available connections, can't open a new one, so do nothing
+    return false;
 }
 
-void HttpManager::decrement_connection(const Sirikata::Network::Address& addr) {
-    //SILOG(transfer, debug, "Reducing number of connections by 1 for " << addr.toString());
-    boost::unique_lock<boost::mutex> lockNumConns(mNumConnsLock); {
-        mNumTotalConnections--;
-        NumConnsType::iterator findNumC = mNumConnsPerAddr.find(addr);
-        if (findNumC != mNumConnsPerAddr.end()) {
-            if (findNumC->second == 1) {
-                mNumConnsPerAddr.erase(findNumC);
-            } else {
-                mNumConnsPerAddr[addr] = findNumC->second - 1;
-            }
-        }
+void HttpManager::assign_to_connection(HttpConnectionPtr conn, HttpRequestPtr req) {
+    record_sent(conn->addr, conn->mNumServed > 0 && conn->mPending.empty(), !conn->mPending.empty());
+
+    conn->mPending.push_back(req);
+    conn->mWriteQueue.push_back(req);
+    if (conn->mConnected)
+        start_write(conn);
+}
+
+void HttpManager::start_write(HttpConnectionPtr conn) {
+    //Only one write may be outstanding on a socket. Anything queued while it
+    //is in progress is sent in a single batch when it finishes.
+    if (conn->mWriting || conn->mWriteQueue.empty())
+        return;
+
+    std::tr1::shared_ptr<boost::asio::streambuf> request_ptr(new boost::asio::streambuf());
+    std::ostream request_stream(request_ptr.get());
+    std::vector<HttpRequestPtr> written;
+    Time now = Timer::now();
+    while(!conn->mWriteQueue.empty()) {
+        HttpRequestPtr req = conn->mWriteQueue.front();
+        conn->mWriteQueue.pop_front();
+        req->mSentTime = now;
+        request_stream << req->req;
+        written.push_back(req);
     }
-    lockNumConns.unlock();
+
+    conn->mWriting = true;
+    boost::asio::async_write(*(conn->socket), *request_ptr, boost::bind(
+            &HttpManager::handle_write_request, this, conn, written,
+            boost::asio::placeholders::error, request_ptr));
+}
+
+void HttpManager::start_read(HttpConnectionPtr conn) {
+    conn->socket->async_read_some(boost::asio::buffer(conn->mReadBuffer), boost::bind(
+            &HttpManager::handle_read, this, conn,
+            boost::asio::placeholders::error,
+            boost::asio::placeholders::bytes_transferred));
 }
 
-void HttpManager::add_req(std::tr1::shared_ptr<HttpRequest> req) {
+void HttpManager::add_req(HttpRequestPtr req) {
     boost::unique_lock<boost::mutex> lockQueue(mRequestQueueLock);
     mRequestQueue.push_back(req);
     lockQueue.unlock();
 }
 
-void HttpManager::handle_resolve(std::tr1::shared_ptr<HttpRequest> req, const boost::system::error_code& err,
+void HttpManager::retry_or_fail(HttpRequestPtr req, const boost::system::error_code& err) {
+    req->mNumTries++;
+    if (req->mNumTries > MAX_REQUEST_TRIES) {
+        //This means this request has gotten an error too many times. Let's stop trying
+        req->cb(std::tr1::shared_ptr<HttpResponse>(), BOOST_ERROR, err);
+    } else {
+        add_req(req);
+    }
+}
+
+void HttpManager::close_connection(HttpConnectionPtr conn, const boost::system::error_code& err) {
+    std::deque<HttpRequestPtr> orphaned;
+    {
+        boost::unique_lock<boost::mutex> lockConn(conn->mMutex);
+        if (conn->mClosed) return;
+        conn->mClosed = true;
+        orphaned.swap(conn->mPending);
+        conn->mWriteQueue.clear();
+        boost::system::error_code ignored;
+        conn->socket->close(ignored);
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lockConns(mConnectionsLock);
+        ConnectionMap::iterator findConns = mConnections.find(conn->addr);
+        if (findConns != mConnections.end()) {
+            ConnectionList::iterator it = std::find(findConns->second.begin(), findConns->second.end(), conn);
+            if (it != findConns->second.end()) {
+                findConns->second.erase(it);
+                mNumTotalConnections--;
+            }
+            if (findConns->second.empty())
+                mConnections.erase(findConns);
+        }
+    }
+
+    if (!orphaned.empty()) {
+        SILOG(transfer, detailed, "Connection to " << conn->addr.toString() << " closed with "
+            << orphaned.size() << " outstanding requests. Error = " << err.message());
+        record_failure(conn->addr);
+    }
+    for(std::deque<HttpRequestPtr>::iterator it = orphaned.begin(); it != orphaned.end(); it++)
+        retry_or_fail(*it, err);
+
+    processQueue();
+}
+
+void HttpManager::handle_resolve(HttpConnectionPtr conn, const boost::system::error_code& err,
         TCPResolver::iterator endpoint_iterator) {
     if (!err) {
         TCPEndPoint endpoint = *endpoint_iterator;
-        std::tr1::shared_ptr<TCPSocket> socket(new TCPSocket(*(mServicePool->service())));
-        socket->async_connect(endpoint, boost::bind(
-                &HttpManager::handle_connect, this, socket, req,
+        conn->socket->async_connect(endpoint, boost::bind(
+                &HttpManager::handle_connect, this, conn,
                 boost::asio::placeholders::error, ++endpoint_iterator));
     } else {
         SILOG(transfer, error, "Failed to resolve hostname. Error = " << err.message());
-        decrement_connection(req->addr);
-
-        req->mNumTries++;
-        if (req->mNumTries > 10) {
-            //This means this connection has gotten an error over 10 times. Let's stop trying
-            //TODO: this should probably be configurable
-            req->cb(std::tr1::shared_ptr<HttpResponse>(), BOOST_ERROR, boost::asio::error::host_not_found);
-        } else {
-            add_req(req);
-        }
-
-        add_req(req);
-        processQueue();
+        close_connection(conn, boost::asio::error::host_not_found);
     }
 }
 
-void HttpManager::write_request(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req) {
-    std::tr1::shared_ptr<boost::asio::streambuf> request_ptr(new boost::asio::streambuf());
-    std::ostream request_stream(request_ptr.get());
-    request_stream << req->req;
-    boost::asio::async_write(*socket, *request_ptr, boost::bind(
-            &HttpManager::handle_write_request, this, socket, req,
-            boost::asio::placeholders::error, request_ptr));
-}
-
-void HttpManager::handle_connect(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req,
+void HttpManager::handle_connect(HttpConnectionPtr conn,
         const boost::system::error_code& err, TCPResolver::iterator endpoint_iterator) {
     if (!err) {
-        write_request(socket, req);
+        boost::unique_lock<boost::mutex> lockConn(conn->mMutex);
+        if (conn->mClosed) return;
+        conn->mConnected = true;
+        start_write(conn);
+        //Always keep a read outstanding so we notice if the server closes
+        //the connection while it is idle
+        start_read(conn);
     } else if (endpoint_iterator != TCPResolver::iterator()) {
-        socket->close();
+        conn->socket->close();
         TCPEndPoint endpoint = *endpoint_iterator;
-        socket->async_connect(endpoint, boost::bind(
-                &HttpManager::handle_connect, this, socket, req,
+        conn->socket->async_connect(endpoint, boost::bind(
+                &HttpManager::handle_connect, this, conn,
                 boost::asio::placeholders::error, ++endpoint_iterator));
     } else {
         SILOG(transfer, error, "Failed to connect. Error = " << err.message());
-        decrement_connection(req->addr);
-
-        req->mNumTries++;
-        if (req->mNumTries > 10) {
-            //This means this connection has gotten an error over 10 times. Let's stop trying
-            //TODO: this should probably be configurable
-            req->cb(std::tr1::shared_ptr<HttpResponse>(), BOOST_ERROR, boost::asio::error::host_unreachable);
-        } else {
-            add_req(req);
-        }
-
-        processQueue();
+        close_connection(conn, boost::asio::error::host_unreachable);
     }
 }
 
-void HttpManager::handle_write_request(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req,
+void HttpManager::handle_write_request(HttpConnectionPtr conn, std::vector<HttpRequestPtr> written,
         const boost::system::error_code& err, std::tr1::shared_ptr<boost::asio::streambuf> request_stream) {
 
     if (err) {
-        socket->close();
-        SILOG(transfer, error, "Failed to write. Error = " << err.message());
-        decrement_connection(req->addr);
-        add_req(req);
-        processQueue();
+        if (err != boost::asio::error::operation_aborted)
+            SILOG(transfer, error, "Failed to write. Error = " << err.message());
+        close_connection(conn, err);
         return;
     }
 
-    //Create a new response object
-    std::tr1::shared_ptr<HttpResponse> respPtr(new HttpResponse());
-
-    //Initiate an empty DenseData
-    std::tr1::shared_ptr<DenseData> emptyData(new DenseData(Range(true)));
-    respPtr->mData = emptyData;
-
-    //Initialize http parser settings callbacks
-    respPtr->mHttpSettings = EMPTY_PARSER_SETTINGS;
-    respPtr->mHttpSettings.on_header_field = &HttpManager::on_header_field;
-    respPtr->mHttpSettings.on_header_value = &HttpManager::on_header_value;
-    respPtr->mHttpSettings.on_body = &HttpManager::on_body;
-    respPtr->mHttpSettings.on_headers_complete = &HttpManager::on_headers_complete;
-    respPtr->mHttpSettings.on_message_complete = &HttpManager::on_message_complete;
-
-    //Initialize the parser for parsing a response
-    http_parser_init(&(respPtr->mHttpParser), HTTP_RESPONSE);
-
-    /*
-     * http-parser library uses this void * parameter to callbacks for user-defined data
-     * Store a pointer to the HttpResponse object so we can access it during static callbacks
-     */
-    respPtr->mHttpParser.data = static_cast<void *>(respPtr.get());
-
-    //Create a buffer for receiving from socket
-    std::tr1::shared_ptr<std::vector<unsigned char> > vecbuf(new std::vector<unsigned char>(SOCKET_BUFFER_SIZE));
-
-    //Read some data
-    socket->async_read_some(boost::asio::buffer(*vecbuf), boost::bind(
-            &HttpManager::handle_read, this, socket, req, vecbuf, respPtr,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::bytes_transferred));
+    boost::unique_lock<boost::mutex> lockConn(conn->mMutex);
+    conn->mWriting = false;
+    if (!conn->mClosed)
+        start_write(conn);
 }
 
-void HttpManager::handle_read(std::tr1::shared_ptr<TCPSocket> socket, std::tr1::shared_ptr<HttpRequest> req,
-        std::tr1::shared_ptr<std::vector<unsigned char> > vecbuf, std::tr1::shared_ptr<HttpResponse> respPtr,
+void HttpManager::handle_read(HttpConnectionPtr conn,
         const boost::system::error_code& err, std::size_t bytes_transferred) {
 
     SILOG(transfer, insane, "handle_read triggered with bytes_transferred = " << bytes_transferred << " EOF? "
             << (err == boost::asio::error::eof ? "Y" : "N"));
 
     if ((err || bytes_transferred == 0) && err != boost::asio::error::eof) {
-        SILOG(transfer, error, "Failed to write. Error = " << err.message());
-        socket->close();
-        decrement_connection(req->addr);
-        add_req(req);
-        processQueue();
+        if (err != boost::asio::error::operation_aborted)
+            SILOG(transfer, error, "Failed to read. Error = " << err.message());
+        close_connection(conn, err);
         return;
     }
 
-    //Parse the data we just got back from the socket
-    size_t nparsed = http_parser_execute(&(respPtr->mHttpParser), &(respPtr->mHttpSettings),
-            (const char *)(&((*vecbuf)[0])), bytes_transferred);
+    bool parse_failed = false;
+    bool eof = (err == boost::asio::error::eof);
+    HttpRequestPtr failedReq;
+    std::deque<std::pair<HttpRequestPtr, HttpResponsePtr> > completed;
+    bool outstanding = false;
+    bool close = false;
+    {
+        boost::unique_lock<boost::mutex> lockConn(conn->mMutex);
+        if (conn->mClosed) return;
+
+        //Parse the data we just got back from the socket. This may finish
+        //several pipelined responses at once.
+        if (bytes_transferred > 0) {
+            size_t nparsed = http_parser_execute(&(conn->mHttpParser), &(conn->mHttpSettings),
+                (const char *)(&(conn->mReadBuffer[0])), bytes_transferred);
+            if (nparsed != bytes_transferred) {
+                SILOG(transfer, warning, "Failed to parse http response. nparsed=" << nparsed << " while bytes_transferred=" << bytes_transferred);
+                parse_failed = true;
+            }
+        }
 
-    boost::system::error_code ec;
-    if (nparsed != bytes_transferred) {
-        SILOG(transfer, warning, "Failed to parse http response. nparsed=" << nparsed << " while bytes_transferred=" << bytes_transferred);
-        req->cb(std::tr1::shared_ptr<HttpResponse>(), RESPONSE_PARSING_FAILED, ec);
-        socket->close();
-        decrement_connection(req->addr);
-        processQueue();
-        return;
-    }
+        if (!parse_failed && eof) {
+            //Pass 0 as fourth parameter to parser to tell it that we got EOF,
+            //which finishes responses delimited by the connection closing
+            size_t nparsed = http_parser_execute(&(conn->mHttpParser), &(conn->mHttpSettings),
+                (const char *)(&(conn->mReadBuffer[0])), 0);
+            if (nparsed != 0) {
+                SILOG(transfer, warning, "Failed to parse http response when giving EOF. nparsed=" << nparsed);
+                parse_failed = true;
+            }
+        }
 
-    if (err == boost::asio::error::eof && bytes_transferred != 0) {
-        //Pass 0 as fourth parameter to parser to tell it that we got EOF
-        size_t nparsed = http_parser_execute(&(respPtr->mHttpParser), &(respPtr->mHttpSettings),
-                (const char *)(&((*vecbuf)[0])), 0);
-        if (nparsed != 0) {
-            SILOG(transfer, warning, "Failed to parse http response when giving EOF. nparsed=" << nparsed);
-            req->cb(std::tr1::shared_ptr<HttpResponse>(), RESPONSE_PARSING_FAILED, ec);
-            socket->close();
-            decrement_connection(req->addr);
-            processQueue();
-            return;
+        completed.swap(conn->mCompleted);
+        if (parse_failed && !conn->mPending.empty()) {
+            failedReq = conn->mPending.front();
+            conn->mPending.pop_front();
         }
+        outstanding = !conn->mPending.empty();
+        close = (parse_failed || eof || conn->mCloseAfterResponse);
+    }
 
+    //Dispatch outside the lock since callbacks may issue new requests
+    for(std::deque<std::pair<HttpRequestPtr, HttpResponsePtr> >::iterator it = completed.begin(); it != completed.end(); it++) {
+        HttpRequestPtr req = it->first;
+        record_response(conn->addr, req->mHeadersTime - req->mServiceStart,
+            req->mCompleteTime - req->mServiceStart, it->second->mBodyBytes);
+        handle_response(req, it->second);
     }
 
-    if ((req->method == HEAD && respPtr->mHeaderComplete) ||
-        ((req->method == GET || req->method == POST) && respPtr->mMessageComplete)) {
-        //We're done
+    if (failedReq) {
+        boost::system::error_code ec;
+        failedReq->cb(std::tr1::shared_ptr<HttpResponse>(), RESPONSE_PARSING_FAILED, ec);
+    }
 
-        //If we didn't get any body data, erase the DenseData pointer
-        if (respPtr->mData->length() == 0) {
-            respPtr->mData.reset();
-        }
+    if (close) {
+        if (eof && outstanding && !parse_failed)
+            SILOG(transfer, warning, "EOF was true and the parser wasn't finished, so connection is broken");
+        close_connection(conn, eof ? boost::asio::error::eof : boost::system::error_code());
+        return;
+    }
 
-        SILOG(transfer, detailed, "Finished http transfer with content length of " << respPtr->getContentLength());
-        Headers::const_iterator findLocation;
-        findLocation = respPtr->mHeaders.find("Location");
-        if (respPtr->getStatusCode() == 301 && findLocation != respPtr->mHeaders.end() && req->allow_redirects) {
-            SILOG(transfer, detailed, "Got a 301 redirect reply and location = " << findLocation->second);
-            std::ostringstream request_stream;
-            std::string request_method = methodAsString(req->method);
-            URL newURI(findLocation->second.c_str());
-            request_stream << request_method << " " << newURI.fullpath() << " HTTP/1.1\r\n";
-            Headers::const_iterator it;
-            for (it = req->mHeaders.begin(); it != req->mHeaders.end(); it++) {
-            	if (it->first == "Host") {
-            		request_stream << "Host: " << newURI.host() << "\r\n";
-            	} else {
-            		request_stream << it->first << ": " << it->second << "\r\n";
-            	}
-            }
-            request_stream << "\r\n";
-            Network::Address newaddr(newURI.host(), newURI.proto());
-            makeRequest(newaddr, req->method, request_stream.str(), req->allow_redirects, req->cb);
-        } else {
-            req->cb(respPtr, SUCCESS, ec);
-        }
+    //Read some more data
+    start_read(conn);
 
-        //If this is Connection: Close or we reached EOF, then close connection, otherwise recycle
-        if ((respPtr->mHttpParser.flags & F_CONNECTION_CLOSE) || err == boost::asio::error::eof) {
-            socket->close();
-            decrement_connection(req->addr);
-        } else {
-            boost::unique_lock<boost::mutex> lockRB(mRecycleBinLock);
-            mRecycleBin[req->addr].push(socket);
-            lockRB.unlock();
-        }
+    if (!completed.empty())
         processQueue();
+}
+
+void HttpManager::handle_response(HttpRequestPtr req, HttpResponsePtr respPtr) {
+    boost::system::error_code ec;
+
+    //If we didn't get any body data, erase the DenseData pointer
+    if (respPtr->mData->length() == 0) {
+        respPtr->mData.reset();
+    }
 
-    } else if(err == boost::asio::error::eof || bytes_transferred == 0) {
-        SILOG(transfer, warning, "EOF was true or bytes_transferred==0 and the parser wasn't finished, so connection is broken");
-        socket->close();
-        decrement_connection(req->addr);
-
-        req->mNumTries++;
-        if (req->mNumTries > 10) {
-            //This means this connection has gotten an error over 10 times. Let's stop trying
-            //TODO: this should probably be configurable
-            req->cb(std::tr1::shared_ptr<HttpResponse>(), BOOST_ERROR, boost::asio::error::eof);
-        } else {
-            add_req(req);
+    SILOG(transfer, detailed, "Finished http transfer with content length of " << respPtr->getContentLength());
+    Headers::const_iterator findLocation;
+    findLocation = respPtr->mHeaders.find("Location");
+    if (respPtr->getStatusCode() == 301 && findLocation != respPtr->mHeaders.end() && req->allow_redirects) {
+        SILOG(transfer, detailed, "Got a 301 redirect reply and location = " << findLocation->second);
+        std::ostringstream request_stream;
+        std::string request_method = methodAsString(req->method);
+        URL newURI(findLocation->second.c_str());
+        request_stream << request_method << " " << newURI.fullpath() << " HTTP/1.1\r\n";
+        Headers::const_iterator it;
+        for (it = req->mHeaders.begin(); it != req->mHeaders.end(); it++) {
+        	if (it->first == "Host") {
+        		request_stream << "Host: " << newURI.host() << "\r\n";
+        	} else {
+        		request_stream << it->first << ": " << it->second << "\r\n";
+        	}
         }
+        request_stream << "\r\n";
+        Network::Address newaddr(newURI.host(), newURI.proto());
+        makeRequest(newaddr, req->method, request_stream.str(), req->allow_redirects, req->cb);
+    } else {
+        req->cb(respPtr, SUCCESS, ec);
+    }
+}
 
-        processQueue();
-        return;
+void HttpManager::reset_response(HttpConnection* conn) {
+    conn->mResponse.reset(new HttpResponse());
+}
+
+HttpManager::EndpointStatsMap HttpManager::getEndpointStats() {
+    boost::unique_lock<boost::mutex> lock(mStatsLock);
+    return mStats;
+}
+
+void HttpManager::record_connection(const Sirikata::Network::Address& addr) {
+    boost::unique_lock<boost::mutex> lock(mStatsLock);
+    mStats[addr.toString()].connections++;
+}
+
+void HttpManager::record_failure(const Sirikata::Network::Address& addr) {
+    boost::unique_lock<boost::mutex> lock(mStatsLock);
+    mStats[addr.toString()].failures++;
+}
+
+void HttpManager::record_sent(const Sirikata::Network::Address& addr, bool reused, bool pipelined) {
+    if (!reused && !pipelined) return;
+    boost::unique_lock<boost::mutex> lock(mStatsLock);
+    EndpointStats& stats = mStats[addr.toString()];
+    if (reused) stats.reused++;
+    if (pipelined) stats.pipelined++;
+}
+
+void HttpManager::record_response(const Sirikata::Network::Address& addr, const Duration& rtt, const Duration& total, uint64 bytes) {
+    boost::unique_lock<boost::mutex> lock(mStatsLock);
+    EndpointStats& stats = mStats[addr.toString()];
+
+    double throughput = (total > Duration::zero() ? (double)bytes / total.toSeconds() : 0);
+    if (stats.responses == 0) {
+        stats.rtt = rtt;
+        stats.throughput = throughput;
     } else {
-        //Read some more data
-        socket->async_read_some(boost::asio::buffer(*vecbuf), boost::bind(
-                &HttpManager::handle_read, this, socket, req, vecbuf, respPtr,
-                boost::asio::placeholders::error,
-                boost::asio::placeholders::bytes_transferred));
+        // Weighted like TCP's smoothed RTT estimate
+        stats.rtt = stats.rtt + (rtt - stats.rtt) / 8;
+        stats.throughput = stats.throughput + (throughput - stats.throughput) / 8;
+    }
+    stats.responses++;
+    stats.bytes += bytes;
+}
+
+void HttpManager::commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+
+    EndpointStatsMap stats = getEndpointStats();
+    result.put( String("endpoints"), Command::Array());
+    Command::Array& endpoints_ary = result.getArray("endpoints");
+    for(EndpointStatsMap::iterator it = stats.begin(); it != stats.end(); it++) {
+        const EndpointStats& ep = it->second;
+        endpoints_ary.push_back(Command::Object());
+        endpoints_ary.back().put("endpoint", it->first);
+        endpoints_ary.back().put("connections", ep.connections);
+        endpoints_ary.back().put("responses", ep.responses);
+        endpoints_ary.back().put("reused", ep.reused);
+        endpoints_ary.back().put("pipelined", ep.pipelined);
+        endpoints_ary.back().put("failures", ep.failures);
+        endpoints_ary.back().put("bytes", ep.bytes);
+        endpoints_ary.back().put("rtt", ep.rtt.toString());
+        endpoints_ary.back().put("throughput", ep.throughput);
     }
 
+    {
+        boost::unique_lock<boost::mutex> lockConns(mConnectionsLock);
+        result.put("connections", mNumTotalConnections);
+    }
+
+    cmdr->result(cmdid, result);
 }
 
 int HttpManager::on_headers_complete(http_parser* _) {
     //SILOG(transfer, debug, "headers complete. content length = " << _->content_length);
-    HttpResponse* curResponse = static_cast<HttpResponse*>(_->data);
+    HttpConnection* conn = static_cast<HttpConnection*>(_->data);
+    HttpResponse* curResponse = conn->mResponse.get();
     curResponse->mContentLength = _->content_length;
     curResponse->mStatusCode = _->status_code;
 
@@ -638,12 +798,29 @@ int HttpManager::on_headers_complete(http_parser* _) {
         curResponse->mGzip = true;
     }
 
+    //Allocate space for the entire body up front so it isn't repeatedly
+    //reallocated as data arrives. For gzip we can only guess the final size.
+    int64 content_length = (int64)_->content_length;
+    if (content_length > 0) {
+        uint64 expected = (uint64)content_length * (curResponse->mGzip ? GZIP_EXPANSION_ESTIMATE : 1);
+        curResponse->mData->reserve((size_t)std::min(expected, (uint64)MAX_PREALLOCATE_SIZE));
+    }
+
     curResponse->mHeaderComplete = true;
+
+    if (!conn->mPending.empty()) {
+        HttpRequestPtr req = conn->mPending.front();
+        req->mHeadersTime = Timer::now();
+        //Responses to HEAD requests never have a body, even if they specify a
+        //Content-Length, so tell the parser to skip it
+        if (req->method == HEAD)
+            return 1;
+    }
     return 0;
 }
 
 int HttpManager::on_header_field(http_parser* _, const char* at, size_t len) {
-    HttpResponse* curResponse = static_cast<HttpResponse*>(_->data);
+    HttpResponse* curResponse = static_cast<HttpConnection*>(_->data)->mResponse.get();
 
     //See http-parser documentation for why this is necessary
     switch (curResponse->mLastCallback) {
@@ -667,7 +844,7 @@ int HttpManager::on_header_field(http_parser* _, const char* at, size_t len) {
 
 int HttpManager::on_header_value(http_parser* _, const char* at, size_t len) {
     //SILOG(transfer, debug, "on_header_value called");
-    HttpResponse* curResponse = static_cast<HttpResponse*>(_->data);
+    HttpResponse* curResponse = static_cast<HttpConnection*>(_->data)->mResponse.get();
 
     //See http-parser documentation for why this is necessary
     switch(curResponse->mLastCallback) {
@@ -751,11 +928,13 @@ int HttpManager::on_request_header_value(http_parser* _, const char* at, size_t
 
 int HttpManager::on_body(http_parser* _, const char* at, size_t len) {
     //SILOG(transfer, debug, "on_body called with length = " << len);
-    HttpResponse* curResponse = static_cast<HttpResponse*>(_->data);
+    HttpResponse* curResponse = static_cast<HttpConnection*>(_->data)->mResponse.get();
+    curResponse->mBodyBytes += len;
 
     if(curResponse->mGzip) {
-        //Gzip encoding, so pass this buffer through a decoder
-        curResponse->mCompressedStream.write(at, len);
+        //Gzip encoding, so decompress this buffer into the response data
+        if (!inflate_body(curResponse, at, len))
+            return 1;
     } else {
         //Raw encoding, so append the bytes in current body pointer directly to the DenseData pointer in our response
         curResponse->mData->append(at, len, true);
@@ -764,27 +943,103 @@ int HttpManager::on_body(http_parser* _, const char* at, size_t len) {
     return 0;
 }
 
+bool HttpManager::inflate_body(HttpResponse* resp, const char* at, size_t len) {
+    //Ignore anything trailing the end of the compressed stream
+    if (resp->mInflateComplete)
+        return true;
+
+    z_stream* zs = resp->mInflater;
+    if (zs == NULL) {
+        zs = new z_stream;
+        zs->zalloc = Z_NULL;
+        zs->zfree = Z_NULL;
+        zs->opaque = Z_NULL;
+        zs->next_in = Z_NULL;
+        zs->avail_in = 0;
+        //16 + MAX_WBITS tells zlib to expect a gzip header rather than zlib's
+        if (inflateInit2(zs, 16 + MAX_WBITS) != Z_OK) {
+            SILOG(transfer, error, "Failed to initialize gzip decoder");
+            delete zs;
+            return false;
+        }
+        resp->mInflater = zs;
+    }
+
+    zs->next_in = (Bytef*)at;
+    zs->avail_in = (uInt)len;
+
+    //Decompress directly onto the end of the response data, a window at a
+    //time. Space for the data was usually already reserved, so this doesn't
+    //reallocate.
+    DenseData* data = resp->mData.get();
+    do {
+        size_t prev_len = (size_t)data->length();
+        data->setLength(prev_len + INFLATE_CHUNK_SIZE, true);
+        zs->next_out = data->writableData() + prev_len;
+        zs->avail_out = INFLATE_CHUNK_SIZE;
+
+        int ret = inflate(zs, Z_NO_FLUSH);
+        data->setLength(prev_len + (INFLATE_CHUNK_SIZE - zs->avail_out), true);
+
+        if (ret == Z_STREAM_END) {
+            resp->mInflateComplete = true;
+            break;
+        }
+        if (ret == Z_BUF_ERROR) {
+            //No progress possible until more input arrives
+            break;
+        }
+        if (ret != Z_OK) {
+            SILOG(transfer, warning, "Failed to decompress gzip'd http response: " << (zs->msg ? zs->msg : "unknown error"));
+            return false;
+        }
+    } while(zs->avail_in > 0 || zs->avail_out == 0);
+
+    return true;
+}
+
 int HttpManager::on_message_complete(http_parser* _) {
     //SILOG(transfer, debug, "message complete. content length = " << _->content_length);
-    HttpResponse* curResponse = static_cast<HttpResponse*>(_->data);
+    HttpConnection* conn = static_cast<HttpConnection*>(_->data);
+    HttpResponsePtr curResponse = conn->mResponse;
 
     if(curResponse->mGzip) {
-        std::stringstream decompressed;
-        boost::iostreams::filtering_streambuf<boost::iostreams::input> out;
-        out.push(boost::iostreams::gzip_decompressor());
-        out.push(curResponse->mCompressedStream);
-        boost::iostreams::copy(out, decompressed);
-        curResponse->mCompressedStream.str("");
-        curResponse->mData->append(decompressed.str().c_str(), decompressed.str().length(), true);
-        curResponse->mContentLength = decompressed.str().length();
+        if (curResponse->mBodyBytes > 0 && !curResponse->mInflateComplete) {
+            SILOG(transfer, warning, "Gzip'd http response ended before the compressed data");
+            return 1;
+        }
+        curResponse->mContentLength = curResponse->mData->length();
     }
 
     curResponse->mMessageComplete = true;
+
+    //If this is Connection: Close, no more responses will follow on this connection
+    if (!http_should_keep_alive(_))
+        conn->mCloseAfterResponse = true;
+
+    //The next response on this connection needs fresh state
+    reset_response(conn);
+
+    if (conn->mPending.empty()) {
+        SILOG(transfer, warning, "Got an http response from " << conn->addr.toString() << " with no outstanding request");
+        return 0;
+    }
+
+    HttpRequestPtr req = conn->mPending.front();
+    conn->mPending.pop_front();
+
+    //Pipelined requests aren't serviced until the previous response finishes
+    req->mServiceStart = (conn->mLastComplete > req->mSentTime ? conn->mLastComplete : req->mSentTime);
+    req->mCompleteTime = Timer::now();
+    conn->mLastComplete = req->mCompleteTime;
+    conn->mNumServed++;
+
+    conn->mCompleted.push_back(std::make_pair(req, curResponse));
     return 0;
 }
 
-void HttpManager::print_flags(std::tr1::shared_ptr<HttpResponse> resp) {
-    char flags = resp->mHttpParser.flags;
+void HttpManager::print_flags(const http_parser& parser, std::tr1::shared_ptr<HttpResponse> resp) {
+    char flags = parser.flags;
     SILOG(transfer, detailed, "Flags are: "
             << (flags & F_CHUNKED ? "F_CHUNKED " : "")
             << (flags & F_CONNECTION_KEEP_ALIVE ? "F_CONNECTION_KEEP_ALIVE " : "")
@@ -0,0 +1,660 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/Standard.hh>
+#include <sirikata/core/transfer/SegmentedDiskCacheLayer.hpp>
+#include <sirikata/core/util/Paths.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#define O_BINARY 0 // Other OS's don't always define this flag.
+#else
+#include <io.h>
+#define open _open
+#define close _close
+#define read _read
+#define write _write
+#define lseek _lseeki64
+#define unlink _unlink
+#define fstat _fstat64
+#define stat _stat64
+#endif
+
+namespace Sirikata {
+namespace Transfer {
+
+const cache_usize_type SegmentedDiskCacheLayer::DEFAULT_SEGMENT_SIZE = 64 * 1024 * 1024;
+
+namespace {
+
+// Index files start with a magic string which doubles as a version number,
+// followed by fixed size records:
+//   uint8 op, uint8 to-end-of-file flag, uint16 unused, uint32 segment,
+//   uint64 offset in segment, uint64 start byte, uint64 length,
+//   32 byte fingerprint
+// Integers are stored in native byte order: the cache is never shared
+// between machines.
+const char INDEX_MAGIC[8] = { 'S', 'S', 'E', 'G', 'I', 'D', 'X', '1' };
+const size_t INDEX_RECORD_SIZE = 64;
+
+struct IndexEntry {
+    uint8 op;
+    bool toEnd;
+    uint32 segment;
+    uint64 offset;
+    uint64 start;
+    uint64 length;
+};
+
+void encodeRecord(unsigned char* buf, const IndexEntry& entry, const Fingerprint& fileId) {
+    memset(buf, 0, INDEX_RECORD_SIZE);
+    buf[0] = entry.op;
+    buf[1] = entry.toEnd ? 1 : 0;
+    memcpy(buf + 4, &entry.segment, sizeof(uint32));
+    memcpy(buf + 8, &entry.offset, sizeof(uint64));
+    memcpy(buf + 16, &entry.start, sizeof(uint64));
+    memcpy(buf + 24, &entry.length, sizeof(uint64));
+    memcpy(buf + 32, fileId.rawData().data(), Fingerprint::static_size);
+}
+
+void decodeRecord(const unsigned char* buf, IndexEntry* entry, Fingerprint* fileId) {
+    entry->op = buf[0];
+    entry->toEnd = (buf[1] != 0);
+    memcpy(&entry->segment, buf + 4, sizeof(uint32));
+    memcpy(&entry->offset, buf + 8, sizeof(uint64));
+    memcpy(&entry->start, buf + 16, sizeof(uint64));
+    memcpy(&entry->length, buf + 24, sizeof(uint64));
+    *fileId = Fingerprint::convertFromBinary(buf + 32);
+}
+
+bool writeAll(int fd, const unsigned char* data, cache_usize_type len) {
+    while(len > 0) {
+        int chunk = (int)std::min(len, (cache_usize_type)(1 << 30));
+        int written = write(fd, data, chunk);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        len -= written;
+    }
+    return true;
+}
+
+bool readAll(int fd, unsigned char* data, cache_usize_type len) {
+    while(len > 0) {
+        int chunk = (int)std::min(len, (cache_usize_type)(1 << 30));
+        int nread = read(fd, data, chunk);
+        if (nread < 0 && errno == EINTR) continue;
+        if (nread <= 0) return false;
+        data += nread;
+        len -= nread;
+    }
+    return true;
+}
+
+cache_usize_type fileSize(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return 0;
+    return (cache_usize_type)st.st_size;
+}
+
+} // namespace
+
+
+SegmentedDiskCacheLayer::Segment::Segment(uint32 _id, int _fd, cache_usize_type _size, cache_usize_type _capacity)
+ : id(_id),
+   fd(_fd),
+   size(_size),
+   live(0),
+   capacity(_capacity),
+   map(NULL)
+{
+#ifndef _WIN32
+    // Mapping beyond the end of the file is fine as long as we only touch
+    // the parts that have been written. Writes through fd are visible
+    // through the mapping, so the active segment only needs to be mapped
+    // once.
+    if (capacity > 0) {
+        void* mapped = mmap(NULL, (size_t)capacity, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped != MAP_FAILED)
+            map = (const unsigned char*)mapped;
+    }
+#endif
+}
+
+SegmentedDiskCacheLayer::Segment::~Segment() {
+#ifndef _WIN32
+    if (map != NULL)
+        munmap((void*)map, (size_t)capacity);
+#endif
+    close(fd);
+}
+
+
+SegmentedDiskCacheLayer::SegmentedDiskCacheLayer(CachePolicy *policy, const std::string &prefix, CacheLayer *tryNext, uint32 num_shards, cache_usize_type segment_size)
+ : CacheLayer(tryNext),
+   mFiles(NULL, policy),
+   mPrefix(),
+   mSegmentSize(segment_size),
+   mCleaningUp(false)
+{
+    // If absolute, use directly. Otherwise, append to temp directory
+    mPrefix = Path::Get(Path::DIR_TEMP, prefix);
+    if (mPrefix[mPrefix.size()-1] != '/')
+        mPrefix += '/';
+
+    mFiles.setOwner(this);
+
+    try {
+        boost::filesystem::create_directories(mPrefix.substr(0, mPrefix.size()-1));
+    } catch (...) {
+        SILOG(transfer,error,"Failed to create disk cache directory " << mPrefix);
+    }
+
+    if (num_shards == 0) num_shards = 1;
+    for(uint32 i = 0; i < num_shards; i++)
+        mShards.push_back(new Shard(i));
+    // Everything needs to be loaded before any workers start since loading
+    // entries may evict entries from other shards.
+    for(uint32 i = 0; i < num_shards; i++)
+        load(mShards[i]);
+    for(uint32 i = 0; i < num_shards; i++)
+        mShards[i]->worker = new Thread("SegmentedDiskCacheLayer", std::tr1::bind(&SegmentedDiskCacheLayer::workerThread, this, mShards[i]));
+}
+
+SegmentedDiskCacheLayer::~SegmentedDiskCacheLayer() {
+    for(ShardList::iterator it = mShards.begin(); it != mShards.end(); it++)
+        (*it)->queue.push(DiskRequestPtr(new DiskRequest(DiskRequest::OPEXIT, Fingerprint())));
+    for(ShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        (*it)->worker->join();
+        delete (*it)->worker;
+    }
+
+    mCleaningUp = true; // don't allow destroyCacheEntry to delete data.
+    {
+        // Clear out entries now since destroyCacheEntry can't be called
+        // after the shards are gone
+        CacheMap::write_iterator writer(mFiles);
+        writer.eraseAll();
+    }
+
+    for(ShardList::iterator it = mShards.begin(); it != mShards.end(); it++) {
+        if ((*it)->indexFd >= 0)
+            close((*it)->indexFd);
+        delete *it;
+    }
+    mShards.clear();
+}
+
+SegmentedDiskCacheLayer::Shard* SegmentedDiskCacheLayer::getShard(const Fingerprint& fileId) {
+    return mShards[fileId.rawData().data()[0] % mShards.size()];
+}
+
+std::string SegmentedDiskCacheLayer::segmentPath(uint32 shard, uint32 segment) const {
+    std::ostringstream os;
+    os << mPrefix << "s" << shard << "-" << segment << ".seg";
+    return os.str();
+}
+
+std::string SegmentedDiskCacheLayer::indexPath(uint32 shard) const {
+    std::ostringstream os;
+    os << mPrefix << "s" << shard << ".idx";
+    return os.str();
+}
+
+SegmentedDiskCacheLayer::SegmentPtr SegmentedDiskCacheLayer::openSegment(Shard* shard, uint32 id, bool create, cache_usize_type capacity) {
+    std::string path = segmentPath(shard->index, id);
+    int flags = O_RDWR|O_BINARY;
+    if (create) flags |= O_CREAT|O_TRUNC;
+    int fd = open(path.c_str(), flags, 0666);
+    if (fd < 0) {
+        if (create)
+            SILOG(transfer,error,"Failed to open " << path << " for writing; reason: " << errno);
+        return SegmentPtr();
+    }
+
+    cache_usize_type size = fileSize(fd);
+    // Existing segments are never appended to, so only map what's there
+    if (!create) capacity = size;
+    SegmentPtr seg(new Segment(id, fd, size, capacity));
+    shard->segments[id] = seg;
+    return seg;
+}
+
+void SegmentedDiskCacheLayer::load(Shard* shard) {
+    // Replay the index to find the live pieces
+    typedef std::map<Fingerprint, PieceList> LoadedPieces;
+    LoadedPieces loaded;
+    uint32 max_segment = 0;
+    bool any_segment = false;
+
+    std::string index_path = indexPath(shard->index);
+    int fd = open(index_path.c_str(), O_RDONLY|O_BINARY);
+    if (fd >= 0) {
+        char magic[sizeof(INDEX_MAGIC)];
+        if (!readAll(fd, (unsigned char*)magic, sizeof(INDEX_MAGIC)) ||
+            memcmp(magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+            SILOG(transfer,warn,"Ignoring invalid disk cache index " << index_path);
+        }
+        else {
+            unsigned char buf[INDEX_RECORD_SIZE];
+            IndexEntry entry;
+            Fingerprint fileId;
+            // A partial record at the end is the result of a crash and is
+            // ignored.
+            while(readAll(fd, buf, INDEX_RECORD_SIZE)) {
+                decodeRecord(buf, &entry, &fileId);
+                any_segment = true;
+                max_segment = std::max(max_segment, entry.segment);
+                if (entry.op == INDEX_PUT) {
+                    loaded[fileId].push_back(
+                        Piece(entry.segment, entry.offset, Range(entry.start, entry.length, LENGTH, entry.toEnd))
+                    );
+                }
+                else if (entry.op == INDEX_DELETE) {
+                    LoadedPieces::iterator it = loaded.find(fileId);
+                    if (it == loaded.end()) continue;
+                    for(PieceList::iterator pit = it->second.begin(); pit != it->second.end(); pit++) {
+                        if (pit->segment == entry.segment && pit->offset == entry.offset) {
+                            it->second.erase(pit);
+                            break;
+                        }
+                    }
+                    if (it->second.empty())
+                        loaded.erase(it);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    // Add the pieces whose data actually made it to disk to the cache
+    for(LoadedPieces::iterator it = loaded.begin(); it != loaded.end(); it++) {
+        CacheData* cdata = new CacheData();
+        cache_usize_type total = 0;
+        for(PieceList::iterator pit = it->second.begin(); pit != it->second.end(); pit++) {
+            SegmentMap::iterator seg_it = shard->segments.find(pit->segment);
+            SegmentPtr seg = (seg_it != shard->segments.end()) ? seg_it->second : openSegment(shard, pit->segment, false, 0);
+            if (!seg || pit->offset + pit->range.length() > seg->size)
+                continue;
+            cdata->mPieces.push_back(*pit);
+            pit->range.addToList(pit->range, cdata->mRanges);
+            total += pit->range.length();
+        }
+        if (cdata->mPieces.empty()) {
+            delete cdata;
+            continue;
+        }
+
+        CacheMap::write_iterator writer(mFiles);
+        if (!mFiles.alloc(total, writer) || !writer.insert(it->first, total)) {
+            delete cdata;
+            continue;
+        }
+        *writer = cdata;
+        writer.use();
+        for(PieceList::iterator pit = cdata->mPieces.begin(); pit != cdata->mPieces.end(); pit++)
+            shard->segments[pit->segment]->live += pit->range.length();
+    }
+
+    // Clean out anything that isn't referenced anymore: segments with no
+    // live data and files we don't know about.
+    for(SegmentMap::iterator it = shard->segments.begin(); it != shard->segments.end(); ) {
+        SegmentMap::iterator cur = it++;
+        if (cur->second->live == 0)
+            removeSegment(shard, cur);
+    }
+    try {
+        boost::filesystem::directory_iterator end_it;
+        for(boost::filesystem::directory_iterator dir_it(mPrefix); dir_it != end_it; dir_it++) {
+            std::string path = dir_it->path().string();
+            std::string leaf = path.substr(path.find_last_of("/\\") + 1);
+            uint32 file_shard = 0, file_segment = 0;
+            if (sscanf(leaf.c_str(), "s%u-%u.seg", &file_shard, &file_segment) != 2 || file_shard != shard->index)
+                continue;
+            any_segment = true;
+            max_segment = std::max(max_segment, file_segment);
+            if (shard->segments.find(file_segment) == shard->segments.end())
+                unlink(path.c_str());
+        }
+    } catch (...) {
+        SILOG(transfer,error,"Failed to scan disk cache directory " << mPrefix);
+    }
+    shard->nextSegment = any_segment ? max_segment + 1 : 0;
+
+    // Start with a compact index containing only what we actually loaded
+    rewriteIndex(shard);
+}
+
+void SegmentedDiskCacheLayer::workerThread(Shard* shard) {
+    while (true) {
+        DiskRequestPtr req;
+        if (!shard->queue.pop(req)) {
+            // Nothing to do, use the time to clean up
+            if (compactOne(shard))
+                continue;
+            if (shard->indexRecords > 2 * shard->livePieces + 1024)
+                rewriteIndex(shard);
+            shard->queue.blockingPop(req);
+        }
+
+        if (req->op == DiskRequest::OPEXIT)
+            break;
+        else if (req->op == DiskRequest::OPREAD)
+            handleRead(shard, req);
+        else if (req->op == DiskRequest::OPWRITE)
+            handleWrite(shard, req);
+        else if (req->op == DiskRequest::OPDELETE)
+            handleDelete(shard, req);
+    }
+}
+
+void SegmentedDiskCacheLayer::handleRead(Shard* shard, DiskRequestPtr req) {
+    PieceList pieces;
+    {
+        CacheMap::read_iterator iter(mFiles);
+        if (iter.find(req->fileId)) {
+            const CacheData* cdata = static_cast<const CacheData*>(*iter);
+            if (cdata->contains(req->toRead))
+                pieces = cdata->mPieces;
+        }
+    }
+    if (pieces.empty()) {
+        // Evicted since the request was made
+        CacheLayer::getData(req->fileId, req->toRead, req->finished);
+        return;
+    }
+
+    // Pieces are cheap to return when mapped, so just return everything
+    SparseData data;
+    for(PieceList::iterator it = pieces.begin(); it != pieces.end(); it++) {
+        DenseDataPtr datum = readPiece(shard, *it);
+        if (!datum) {
+            CacheLayer::getData(req->fileId, req->toRead, req->finished);
+            return;
+        }
+        CacheLayer::populateParentCaches(req->fileId, datum);
+        data.addValidData(datum);
+    }
+    req->finished(&data);
+}
+
+void SegmentedDiskCacheLayer::handleWrite(Shard* shard, DiskRequestPtr req) {
+    // Note: CacheLayer::populateParentCaches has already been called.
+    const DenseDataPtr& data = req->data;
+    if (data->length() == 0) return;
+
+    {
+        CacheMap::read_iterator iter(mFiles);
+        if (iter.find(req->fileId) &&
+            static_cast<const CacheData*>(*iter)->contains(*data))
+            return; // this range is already written to disk.
+    }
+
+    Piece piece(0, 0, *data);
+    if (!appendData(shard, data->data(), data->length(), &piece))
+        return;
+
+    {
+        CacheMap::write_iterator writer(mFiles);
+        // If the entry is not cachable the data is left as garbage in the
+        // segment.
+        if (!mFiles.alloc(data->length(), writer))
+            return;
+
+        if (writer.insert(req->fileId, data->length())) {
+            *writer = new CacheData;
+            writer.use();
+        } else {
+            writer.update(writer.getSize() + data->length());
+        }
+        CacheData* cdata = static_cast<CacheData*>(*writer);
+        cdata->mPieces.push_back(piece);
+        data->addToList(*data, cdata->mRanges);
+    }
+
+    shard->segments[piece.segment]->live += piece.range.length();
+    shard->livePieces++;
+    appendIndex(shard, INDEX_PUT, req->fileId, piece);
+}
+
+void SegmentedDiskCacheLayer::handleDelete(Shard* shard, DiskRequestPtr req) {
+    for(PieceList::iterator it = req->pieces.begin(); it != req->pieces.end(); it++) {
+        appendIndex(shard, INDEX_DELETE, req->fileId, *it);
+        if (shard->livePieces > 0) shard->livePieces--;
+
+        // Segment may already have been compacted
+        SegmentMap::iterator seg_it = shard->segments.find(it->segment);
+        if (seg_it == shard->segments.end()) continue;
+        SegmentPtr seg = seg_it->second;
+        seg->live -= std::min(seg->live, it->range.length());
+        if (seg->live == 0 && seg != shard->active)
+            removeSegment(shard, seg_it);
+    }
+}
+
+bool SegmentedDiskCacheLayer::appendData(Shard* shard, const unsigned char* data, cache_usize_type len, Piece* piece_out) {
+    if (!shard->active || shard->active->size + len > shard->active->capacity) {
+        SegmentPtr old_active = shard->active;
+        // Data larger than a segment gets a segment to itself
+        SegmentPtr seg = openSegment(shard, shard->nextSegment++, true, std::max(mSegmentSize, len));
+        if (!seg) return false;
+        shard->active = seg;
+
+        if (old_active && old_active->live == 0)
+            removeSegment(shard, shard->segments.find(old_active->id));
+    }
+
+    SegmentPtr seg = shard->active;
+    if (lseek(seg->fd, seg->size, SEEK_SET) < 0 ||
+        !writeAll(seg->fd, data, len)) {
+        SILOG(transfer,error,"Failed to write to disk cache segment " << segmentPath(shard->index, seg->id) << "; reason: " << errno);
+        return false;
+    }
+
+    *piece_out = Piece(seg->id, seg->size, piece_out->range);
+    seg->size += len;
+    return true;
+}
+
+DenseDataPtr SegmentedDiskCacheLayer::readPiece(Shard* shard, const Piece& piece) {
+    SegmentMap::iterator seg_it = shard->segments.find(piece.segment);
+    if (seg_it == shard->segments.end()) return DenseDataPtr();
+    SegmentPtr seg = seg_it->second;
+
+    // The DenseData keeps the segment, and therefore the mapping, alive even
+    // if the segment is compacted away.
+    if (seg->map != NULL)
+        return DenseDataPtr(new DenseData(piece.range, seg->map + piece.offset, seg));
+
+    MutableDenseDataPtr datum(new DenseData(piece.range));
+    if (lseek(seg->fd, piece.offset, SEEK_SET) < 0 ||
+        !readAll(seg->fd, datum->writableData(), piece.range.length())) {
+        SILOG(transfer,error,"Failed to read from disk cache segment " << segmentPath(shard->index, seg->id) << "; reason: " << errno);
+        return DenseDataPtr();
+    }
+    return datum;
+}
+
+void SegmentedDiskCacheLayer::appendIndex(Shard* shard, IndexOp op, const Fingerprint& fileId, const Piece& piece) {
+    if (shard->indexFd < 0) return;
+
+    IndexEntry entry;
+    entry.op = (uint8)op;
+    entry.toEnd = piece.range.goesToEndOfFile();
+    entry.segment = piece.segment;
+    entry.offset = piece.offset;
+    entry.start = piece.range.startbyte();
+    entry.length = piece.range.length();
+
+    unsigned char buf[INDEX_RECORD_SIZE];
+    encodeRecord(buf, entry, fileId);
+    shard->indexRecords++;
+    if (!writeAll(shard->indexFd, buf, INDEX_RECORD_SIZE))
+        SILOG(transfer,error,"Failed to write disk cache index " << indexPath(shard->index) << "; reason: " << errno);
+}
+
+void SegmentedDiskCacheLayer::rewriteIndex(Shard* shard) {
+    if (shard->indexFd >= 0) {
+        close(shard->indexFd);
+        shard->indexFd = -1;
+    }
+
+    std::vector<std::pair<Fingerprint, Piece> > pieces;
+    collectPieces(shard, &pieces, true, 0);
+
+    // Write to a temporary file and move it into place so we always have a
+    // valid index.
+    std::string path = indexPath(shard->index);
+    std::string temp_path = path + ".temp";
+    shard->indexFd = open(temp_path.c_str(), O_CREAT|O_TRUNC|O_WRONLY|O_BINARY, 0666);
+    if (shard->indexFd < 0) {
+        SILOG(transfer,error,"Failed to open " << temp_path << " for writing; reason: " << errno);
+        return;
+    }
+    writeAll(shard->indexFd, (const unsigned char*)INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    shard->indexRecords = 0;
+    for(std::vector<std::pair<Fingerprint, Piece> >::iterator it = pieces.begin(); it != pieces.end(); it++)
+        appendIndex(shard, INDEX_PUT, it->first, it->second);
+    shard->livePieces = pieces.size();
+
+    unlink(path.c_str()); // rename won't replace existing files on Windows
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+        SILOG(transfer,error,"Failed to move disk cache index into place " << path << "; reason: " << errno);
+}
+
+void SegmentedDiskCacheLayer::collectPieces(Shard* shard, std::vector<std::pair<Fingerprint, Piece> >* out, bool all, uint32 segment) {
+    CacheMap::read_iterator iter(mFiles);
+    while(iter.iterate()) {
+        if (getShard(iter.getId()) != shard) continue;
+        const CacheData* cdata = static_cast<const CacheData*>(*iter);
+        for(PieceList::const_iterator it = cdata->mPieces.begin(); it != cdata->mPieces.end(); it++) {
+            if (all || it->segment == segment)
+                out->push_back(std::make_pair(iter.getId(), *it));
+        }
+    }
+}
+
+bool SegmentedDiskCacheLayer::compactOne(Shard* shard) {
+    // Pick the sealed segment with the least live data, as long as less than
+    // half of it is live.
+    SegmentPtr victim;
+    for(SegmentMap::iterator it = shard->segments.begin(); it != shard->segments.end(); it++) {
+        SegmentPtr seg = it->second;
+        if (seg == shard->active || seg->live * 2 >= seg->size) continue;
+        if (!victim || seg->live * victim->size < victim->live * seg->size)
+            victim = seg;
+    }
+    if (!victim) return false;
+
+    std::vector<std::pair<Fingerprint, Piece> > pieces;
+    collectPieces(shard, &pieces, false, victim->id);
+    for(std::vector<std::pair<Fingerprint, Piece> >::iterator it = pieces.begin(); it != pieces.end(); it++) {
+        const Piece& old_piece = it->second;
+        DenseDataPtr datum = readPiece(shard, old_piece);
+        Piece new_piece(0, 0, old_piece.range);
+        if (!datum || !appendData(shard, datum->data(), old_piece.range.length(), &new_piece))
+            return false;
+
+        bool moved = false;
+        {
+            CacheMap::write_iterator writer(mFiles);
+            // May have been evicted while we were copying
+            if (writer.find(it->first)) {
+                CacheData* cdata = static_cast<CacheData*>(*writer);
+                for(PieceList::iterator pit = cdata->mPieces.begin(); pit != cdata->mPieces.end(); pit++) {
+                    if (pit->segment == old_piece.segment && pit->offset == old_piece.offset) {
+                        *pit = new_piece;
+                        moved = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (moved) {
+            shard->segments[new_piece.segment]->live += new_piece.range.length();
+            appendIndex(shard, INDEX_PUT, it->first, new_piece);
+            appendIndex(shard, INDEX_DELETE, it->first, old_piece);
+        }
+    }
+
+    SILOG(transfer,detailed,"Compacted disk cache segment " << segmentPath(shard->index, victim->id));
+    removeSegment(shard, shard->segments.find(victim->id));
+    // Compaction is also a good time to drop the dead records from the index
+    rewriteIndex(shard);
+    return true;
+}
+
+void SegmentedDiskCacheLayer::removeSegment(Shard* shard, SegmentMap::iterator it) {
+    if (it == shard->segments.end()) return;
+    // Outstanding DenseData may still refer to the mapping, which stays valid
+    // after the file is unlinked.
+    unlink(segmentPath(shard->index, it->first).c_str());
+    if (shard->active == it->second)
+        shard->active.reset();
+    shard->segments.erase(it);
+}
+
+void SegmentedDiskCacheLayer::populateCache(const Fingerprint& fileId, const DenseDataPtr &data) {
+    DiskRequestPtr req(new DiskRequest(DiskRequest::OPWRITE, fileId));
+    req->data = data;
+    getShard(fileId)->queue.push(req);
+
+    CacheLayer::populateParentCaches(fileId, data);
+}
+
+void SegmentedDiskCacheLayer::destroyCacheEntry(const Fingerprint &fileId, CacheEntry *cacheLayerData, cache_usize_type releaseSize) {
+    CacheData *toDelete = static_cast<CacheData*>(cacheLayerData);
+    if (!mCleaningUp) {
+        // don't want to erase the disk cache when exiting the program.
+        DiskRequestPtr req(new DiskRequest(DiskRequest::OPDELETE, fileId));
+        req->pieces = toDelete->mPieces;
+        getShard(fileId)->queue.push(req);
+    }
+    delete toDelete;
+}
+
+void SegmentedDiskCacheLayer::purgeFromCache(const Fingerprint &fileId) {
+    {
+        CacheMap::write_iterator iter(mFiles);
+        if (iter.find(fileId)) {
+            iter.erase();
+        }
+    }
+    CacheLayer::purgeFromCache(fileId);
+}
+
+void SegmentedDiskCacheLayer::getData(const Fingerprint &fileId, const Range &requestedRange, const TransferCallback&callback) {
+    bool haveRange = false;
+    {
+        CacheMap::read_iterator iter(mFiles);
+        if (iter.find(fileId)) {
+            haveRange = static_cast<const CacheData*>(*iter)->contains(requestedRange);
+        }
+        if (haveRange) {
+            iter.use();
+        }
+    }
+
+    if (haveRange) {
+        DiskRequestPtr req(new DiskRequest(DiskRequest::OPREAD, fileId));
+        req->toRead = requestedRange;
+        req->finished = callback;
+        getShard(fileId)->queue.push(req);
+    } else {
+        CacheLayer::getData(fileId, requestedRange, callback);
+    }
+}
+
+}
+}
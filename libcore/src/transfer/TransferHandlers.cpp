@@ -20,7 +20,7 @@ SharedChunkCache::SharedChunkCache() {
     mMemoryCachePolicy = new LRUPolicy(MEMORY_LRU_CACHE_SIZE);
 
     //Make a disk cache as the bottom cache layer
-    CacheLayer* diskCache = new DiskCacheLayer(mDiskCachePolicy, "HttpChunkHandlerCache", NULL);
+    CacheLayer* diskCache = new SegmentedDiskCacheLayer(mDiskCachePolicy, "HttpChunkHandlerSegmentCache", NULL);
     mCacheLayers.push_back(diskCache);
 
     //Make a mem cache on top of the disk cache
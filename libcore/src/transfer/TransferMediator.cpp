@@ -5,6 +5,7 @@
 #include <sirikata/core/util/Timer.hpp>
 #include <stdio.h>
 #include <sirikata/core/transfer/TransferHandlers.hpp>
+#include <sirikata/core/transfer/HttpManager.hpp>
 
 using namespace std;
 
@@ -31,8 +32,18 @@ void TransferMediator::destroy() {
 
 TransferMediator::TransferMediator() {
     mCleanup = false;
-    mNumOutstanding = 0;
+    mWorkAvailable = false;
     mAggregationAlgorithm = new MaxPriorityAggregation();
+
+    // Local files hit the disk and data URIs are decoded in memory, so they
+    // get their own slots rather than waiting behind slow network requests.
+    mDefaultHandlerLimit = 4;
+    mHandlerSlots["file"] = HandlerSlots(4);
+    mHandlerSlots["data"] = HandlerSlots(16);
+    mHandlerSlots["http"] = HandlerSlots(8);
+    mHandlerSlots["meerkat"] = HandlerSlots(8);
+    mHandlerSlots["upload"] = HandlerSlots(2);
+
     mThread = new Thread("TransferMediator", std::tr1::bind(&TransferMediator::mediatorThread, this));
 }
 
@@ -43,110 +54,237 @@ TransferMediator::~TransferMediator() {
 }
 
 void TransferMediator::mediatorThread() {
-    while(!mCleanup) {
-        checkQueue();
+    while(true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mWakeMutex);
+            while(!mWorkAvailable && !mCleanup)
+                mWakeCondition.wait(lock);
+            if (mCleanup) break;
+            mWorkAvailable = false;
+        }
 
-        /**
-           Ewen and I weren't able to identify why the below call caused a
-           deadlock on the shared space hosted on sns30 (could not reproduce on
-           other machines).  With the below line, in gdb, with bulletphysics on,
-           and servermap-options set to port 6880, we'd get 4 calls to
-           checkQueue, followed by no follow up calls.  Not sure what to say.
-         */
-        //boost::this_thread::sleep(boost::posix_time::milliseconds(5));
-        Timer::sleep(Duration::milliseconds(5));
-    }
-    for(PoolType::iterator pool = mPools.begin(); pool != mPools.end(); pool++) {
-        pool->second->cleanup();
-        pool->second->getTransferPool()->addRequest(std::tr1::shared_ptr<TransferRequest>());
+        processPools();
+        checkQueue();
     }
-    for(PoolType::iterator pool = mPools.begin(); pool != mPools.end(); pool++) {
-        pool->second->getThread()->join();
+}
+
+void TransferMediator::notifyWork() {
+    {
+        boost::unique_lock<boost::mutex> lock(mWakeMutex);
+        mWorkAvailable = true;
     }
+    mWakeCondition.notify_one();
 }
 
 void TransferMediator::registerPool(TransferPoolPtr pool) {
-    //Lock exclusive to access map
-    boost::upgrade_lock<boost::shared_mutex> lock(mPoolMutex);
-    boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(lock);
+    {
+        //Lock exclusive to access map
+        boost::upgrade_lock<boost::shared_mutex> lock(mPoolMutex);
+        boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(lock);
+
+        //ensure client id doesnt already exist, they should be unique
+        PoolType::iterator findClientId = mPools.find(pool->getClientID());
+        assert(findClientId == mPools.end());
 
-    //ensure client id doesnt already exist, they should be unique
-    PoolType::iterator findClientId = mPools.find(pool->getClientID());
-    assert(findClientId == mPools.end());
+        pool->setRequestsAvailableCallback(
+            std::tr1::bind(&TransferMediator::notifyWork, this)
+        );
+        mPools.insert(PoolType::value_type(pool->getClientID(), pool));
+    }
 
-    std::tr1::shared_ptr<PoolWorker> worker(new PoolWorker(pool));
-    mPools.insert(PoolType::value_type(pool->getClientID(), worker));
+    boost::unique_lock<boost::mutex> lock(mAggMutex);
+    mPoolStats[pool->getClientID()] = PoolStats();
 }
 
-void TransferMediator::cleanup() {
-    if (mCleanup) return;
+void TransferMediator::setHandlerLimit(const String& handler, uint32 limit) {
+    {
+        boost::unique_lock<boost::mutex> lock(mAggMutex);
+        getHandlerSlots(handler).limit = limit;
+    }
+    // A higher limit may allow more requests to start
+    notifyWork();
+}
+
+TransferMediator::HandlerSlots& TransferMediator::getHandlerSlots(const String& handler) {
+    HandlerSlotsMap::iterator it = mHandlerSlots.find(handler);
+    if (it == mHandlerSlots.end())
+        it = mHandlerSlots.insert(HandlerSlotsMap::value_type(handler, HandlerSlots(mDefaultHandlerLimit))).first;
+    return it->second;
+}
 
-    mCleanup = true;
+void TransferMediator::cleanup() {
+    {
+        boost::unique_lock<boost::mutex> lock(mWakeMutex);
+        if (mCleanup) return;
+        mCleanup = true;
+    }
+    mWakeCondition.notify_one();
     mThread->join();
+
+    // Pools may outlive us, make sure they don't try to wake us up anymore
+    boost::unique_lock<boost::shared_mutex> lock(mPoolMutex);
+    for(PoolType::iterator pool = mPools.begin(); pool != mPools.end(); pool++)
+        pool->second->setRequestsAvailableCallback(TransferPool::RequestsAvailableCallback());
 }
 
-void TransferMediator::execute_finished(std::tr1::shared_ptr<TransferRequest> req, std::string id) {
-    boost::unique_lock<boost::mutex> lock(mAggMutex, boost::defer_lock_t());
-    lock.lock();
+void TransferMediator::processPools() {
+    // Grab everything that's waiting first so we only hold each lock briefly
+    std::deque<std::tr1::shared_ptr<TransferRequest> > reqs, pool_reqs;
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mPoolMutex);
+        for(PoolType::iterator pool = mPools.begin(); pool != mPools.end(); pool++) {
+            pool->second->getRequests(&pool_reqs);
+            reqs.insert(reqs.end(), pool_reqs.begin(), pool_reqs.end());
+        }
+    }
+    if (reqs.empty()) return;
+
+    boost::unique_lock<boost::mutex> lock(mAggMutex);
+    for(std::deque<std::tr1::shared_ptr<TransferRequest> >::iterator it = reqs.begin(); it != reqs.end(); it++) {
+        if (*it) processRequest(*it);
+    }
+}
+
+void TransferMediator::processRequest(std::tr1::shared_ptr<TransferRequest> req) {
+    // mAggMutex must be held
+    mPoolStats[req->getClientID()].received++;
 
     AggregateListByID& idIndex = mAggregateList.get<tagID>();
-    AggregateListByID::iterator findID = idIndex.find(id);
-    if(findID == idIndex.end()) {
-        //This can happen now if a request was canceled but it was already outstanding
-        mNumOutstanding--;
-        lock.unlock();
-        checkQueue();
-        return;
+    AggregateListByID::iterator findID = idIndex.find(req->getIdentifier());
+
+    //Check if this request already exists
+    if(findID != idIndex.end()) {
+        //Check if this request is for deleting
+        if(req->isDeletionRequest()) {
+            const std::map<std::string, std::tr1::shared_ptr<TransferRequest> >&
+                allReqs = (*findID)->getTransferRequests();
+
+            std::map<std::string,
+                std::tr1::shared_ptr<TransferRequest> >::const_iterator findClient =
+                allReqs.find(req->getClientID());
+
+            /* If the client isn't in the aggregated request, it must have already
+             * been deleted, or the deletion request is invalid
+             */
+            if(findClient == allReqs.end()) {
+                return;
+            }
+
+            mPoolStats[req->getClientID()].cancelled++;
+            if(allReqs.size() > 1) {
+                /* If there are more than one, we need to just delete the single client
+                 * from the aggregate request
+                 */
+                (*findID)->removeClient(req->getClientID());
+            } else {
+                // If only one in the list, we can erase the entire request
+                mAggregateList.erase(findID);
+            }
+        } else {
+            //store original aggregated priority for later
+            Priority oldAggPriority = (*findID)->getPriority();
+
+            //Update the priority of this client
+            (*findID)->setClientPriority(req);
+
+            //And check if it's changed, we need to update the index
+            Priority newAggPriority = (*findID)->getPriority();
+            if(oldAggPriority != newAggPriority) {
+                //Convert the iterator to the priority one and update
+                AggregateListByPriority::iterator byPriority =
+                    mAggregateList.project<tagPriority>(findID);
+                AggregateListByPriority & priorityIndex =
+                    mAggregateList.get<tagPriority>();
+                priorityIndex.modify_key(byPriority, boost::lambda::_1=newAggPriority);
+            }
+        }
+    } else if (!req->isDeletionRequest()) {
+        //Make a new one and insert it
+        std::tr1::shared_ptr<AggregateRequest> newAggReq(new AggregateRequest(req));
+        mAggregateList.insert(newAggReq);
     }
+}
+
+void TransferMediator::execute_finished(std::tr1::shared_ptr<TransferRequest> req, std::string id, String handler) {
+    std::map<std::string, std::tr1::shared_ptr<TransferRequest> > allReqs;
+    {
+        boost::unique_lock<boost::mutex> lock(mAggMutex);
+
+        getHandlerSlots(handler).outstanding--;
 
-    const std::map<std::string, std::tr1::shared_ptr<TransferRequest> >&
-        allReqs = (*findID)->getTransferRequests();
+        AggregateListByID& idIndex = mAggregateList.get<tagID>();
+        AggregateListByID::iterator findID = idIndex.find(id);
+        //This can fail if a request was canceled but it was already outstanding
+        if(findID != idIndex.end()) {
+            allReqs = (*findID)->getTransferRequests();
+
+            Time now = Timer::now();
+            for(std::map<std::string, std::tr1::shared_ptr<TransferRequest> >::const_iterator
+                    it = allReqs.begin(); it != allReqs.end(); it++) {
+                PoolStats& stats = mPoolStats[it->first];
+                Duration latency = now - (*findID)->getClientAddedTime(it->first);
+                stats.completed++;
+                stats.totalLatency += latency;
+                if (latency > stats.maxLatency) stats.maxLatency = latency;
+            }
 
+            mAggregateList.erase(findID);
+        }
+    }
+
+    // Callers may add new requests from their callbacks, so they must be
+    // notified without holding any locks
     for(std::map<std::string, std::tr1::shared_ptr<TransferRequest> >::const_iterator
             it = allReqs.begin(); it != allReqs.end(); it++) {
         SILOG(transfer, detailed, "Notifying a caller that TransferRequest is complete");
         it->second->notifyCaller(it->second, req);
     }
 
-    mAggregateList.erase(findID);
-
-    mNumOutstanding--;
-    lock.unlock();
     SILOG(transfer, detailed, "done transfer mediator execute_finished");
-    checkQueue();
+    // A slot was freed up, let the mediator start the next request
+    notifyWork();
 }
 
 void TransferMediator::checkQueue() {
-    boost::unique_lock<boost::mutex> lock(mAggMutex, boost::defer_lock_t());
-
-    lock.lock();
+    typedef std::vector< std::pair<std::tr1::shared_ptr<TransferRequest>, std::string> > StartList;
+    StartList to_start;
+    {
+        boost::unique_lock<boost::mutex> lock(mAggMutex);
 
-    AggregateListByPriority & priorityIndex = mAggregateList.get<tagPriority>();
-    AggregateListByPriority::iterator findTop = priorityIndex.begin();
+        AggregateListByPriority & priorityIndex = mAggregateList.get<tagPriority>();
+        AggregateListByPriority::iterator findTop = priorityIndex.begin();
 
-    if(findTop != priorityIndex.end()) {
-        std::string topId = (*findTop)->getIdentifier();
-        SILOG(transfer, detailed, priorityIndex.size() << " length agg list, top priority "
+        if(findTop != priorityIndex.end()) {
+            std::string topId = (*findTop)->getIdentifier();
+            SILOG(transfer, detailed, priorityIndex.size() << " length agg list, top priority "
                 << (*findTop)->getPriority() << " id " << topId);
-    }
+        }
+
+        // Scan for items that haven't been started yet, in priority order,
+        // and start any whose handler has a free slot.
+        for(; findTop != priorityIndex.end(); findTop++) {
+            if ((*findTop)->mExecuting) continue;
 
-    // While we have free slots and there are items left, scan for items that
-    // haven't been started yet that we can process.
-    while(findTop != priorityIndex.end() && mNumOutstanding < 10) {
-        if (!(*findTop)->mExecuting) {
-            mNumOutstanding++;
-            (*findTop)->mExecuting = true;
             std::tr1::shared_ptr<TransferRequest> req = (*findTop)->getSingleRequest();
-            req->execute(
-                req,
-                std::tr1::bind(&TransferMediator::execute_finished, this,
-                    req, (*findTop)->getIdentifier())
-            );
+            HandlerSlots& slots = getHandlerSlots(req->getHandlerType());
+            if (slots.outstanding >= slots.limit) continue;
+
+            slots.outstanding++;
+            (*findTop)->mExecuting = true;
+            to_start.push_back(std::make_pair(req, (*findTop)->getIdentifier()));
         }
-        findTop++;
     }
 
-    lock.unlock();
+    // Handlers may finish immediately, invoking execute_finished, so
+    // requests are started after releasing the lock
+    for(StartList::iterator it = to_start.begin(); it != to_start.end(); it++) {
+        std::tr1::shared_ptr<TransferRequest> req = it->first;
+        req->execute(
+            req,
+            std::tr1::bind(&TransferMediator::execute_finished, this,
+                req, it->second, req->getHandlerType())
+        );
+    }
 }
 
 
@@ -173,6 +311,7 @@ void TransferMediator::AggregateRequest::setClientPriority(std::tr1::shared_ptr<
     std::map<std::string, std::tr1::shared_ptr<TransferRequest> >::iterator findClient = mTransferReqs.find(clientID);
     if(findClient == mTransferReqs.end()) {
         mTransferReqs[clientID] = req;
+        mClientAdded[clientID] = Timer::now();
         updateAggregatePriority();
     } else if(findClient->second->getPriority() != req->getPriority()) {
         findClient->second = req;
@@ -186,6 +325,7 @@ void TransferMediator::AggregateRequest::removeClient(std::string clientID) {
     std::map<std::string, std::tr1::shared_ptr<TransferRequest> >::iterator findClient = mTransferReqs.find(clientID);
     if(findClient != mTransferReqs.end()) {
         mTransferReqs.erase(findClient);
+        mClientAdded.erase(clientID);
     }
 }
 
@@ -197,6 +337,12 @@ Priority TransferMediator::AggregateRequest::getPriority() const {
     return mPriority;
 }
 
+Time TransferMediator::AggregateRequest::getClientAddedTime(const std::string& clientID) const {
+    std::map<std::string, Time>::const_iterator it = mClientAdded.find(clientID);
+    assert(it != mClientAdded.end());
+    return it->second;
+}
+
 TransferMediator::AggregateRequest::AggregateRequest(std::tr1::shared_ptr<TransferRequest> req)
  : mExecuting(false),
    mIdentifier(req->getIdentifier())
@@ -204,100 +350,20 @@ TransferMediator::AggregateRequest::AggregateRequest(std::tr1::shared_ptr<Transf
     setClientPriority(req);
 }
 
-/*
- * TransferMediator::PoolWorker definitions
- */
-
-TransferMediator::PoolWorker::PoolWorker(std::tr1::shared_ptr<TransferPool> transferPool)
-    : mTransferPool(transferPool), mCleanup(false) {
-    mWorkerThread = new Thread("TransferMediator Worker", std::tr1::bind(&PoolWorker::run, this));
-}
-
-std::tr1::shared_ptr<TransferPool> TransferMediator::PoolWorker::getTransferPool() const {
-    return mTransferPool;
-}
-
-Thread * TransferMediator::PoolWorker::getThread() const {
-    return mWorkerThread;
-}
-
-void TransferMediator::PoolWorker::cleanup() {
-    mCleanup = true;
-}
-
-void TransferMediator::PoolWorker::run() {
-    while(!mCleanup) {
-        std::tr1::shared_ptr<TransferRequest> req = TransferMediator::getRequest(mTransferPool);
-        if(req == NULL) {
-            continue;
-        }
-        //SILOG(transfer, debug, "worker got one!");
-
-        boost::unique_lock<boost::mutex> lock(TransferMediator::getSingleton().mAggMutex);
-        AggregateListByID& idIndex = TransferMediator::getSingleton().mAggregateList.get<tagID>();
-        AggregateListByID::iterator findID = idIndex.find(req->getIdentifier());
-
-        //Check if this request already exists
-        if(findID != idIndex.end()) {
-            //Check if this request is for deleting
-            if(req->isDeletionRequest()) {
-                const std::map<std::string, std::tr1::shared_ptr<TransferRequest> >&
-                    allReqs = (*findID)->getTransferRequests();
-
-                std::map<std::string,
-                    std::tr1::shared_ptr<TransferRequest> >::const_iterator findClient =
-                    allReqs.find(req->getClientID());
-
-                /* If the client isn't in the aggregated request, it must have already
-                 * been deleted, or the deletion request is invalid
-                 */
-                if(findClient == allReqs.end()) {
-                    continue;
-                }
-
-                if(allReqs.size() > 1) {
-                    /* If there are more than one, we need to just delete the single client
-                     * from the aggregate request
-                     */
-                    (*findID)->removeClient(req->getClientID());
-                } else {
-                    // If only one in the list, we can erase the entire request
-                    TransferMediator::getSingleton().mAggregateList.erase(findID);
-                }
-            } else {
-                //store original aggregated priority for later
-                Priority oldAggPriority = (*findID)->getPriority();
-
-                //Update the priority of this client
-                (*findID)->setClientPriority(req);
-
-                //And check if it's changed, we need to update the index
-                Priority newAggPriority = (*findID)->getPriority();
-                if(oldAggPriority != newAggPriority) {
-                    //Convert the iterator to the priority one and update
-                    AggregateListByPriority::iterator byPriority =
-                            TransferMediator::getSingleton().mAggregateList.project<tagPriority>(findID);
-                    AggregateListByPriority & priorityIndex =
-                            TransferMediator::getSingleton().mAggregateList.get<tagPriority>();
-                    priorityIndex.modify_key(byPriority, boost::lambda::_1=newAggPriority);
-                }
-            }
-        } else {
-            //Make a new one and insert it
-            //SILOG(transfer, debug, "worker id " << mTransferPool->getClientID() << " adding url " << req->getIdentifier());
-            std::tr1::shared_ptr<AggregateRequest> newAggReq(new AggregateRequest(req));
-            TransferMediator::getSingleton().mAggregateList.insert(newAggReq);
-        }
-
-    }
-}
-
 void TransferMediator::registerContext(Context* ctx) {
     if (ctx->commander()) {
         ctx->commander()->registerCommand(
             "transfer.mediator.requests.list",
             std::tr1::bind(&TransferMediator::commandListRequests, this, _1, _2, _3)
         );
+        ctx->commander()->registerCommand(
+            "transfer.mediator.stats",
+            std::tr1::bind(&TransferMediator::commandStats, this, _1, _2, _3)
+        );
+        ctx->commander()->registerCommand(
+            "transfer.http.stats",
+            std::tr1::bind(&TransferMediator::commandHttpStats, this, _1, _2, _3)
+        );
     }
 }
 
@@ -317,5 +383,55 @@ void TransferMediator::commandListRequests(const Command::Command& cmd, Command:
     cmdr->result(cmdid, result);
 }
 
+void TransferMediator::commandHttpStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    HttpManager::getSingleton().commandStats(cmd, cmdr, cmdid);
+}
+
+void TransferMediator::commandStats(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
+    Command::Result result = Command::EmptyResult();
+
+    boost::unique_lock<boost::mutex> lock(mAggMutex);
+
+    // Queue depths aren't tracked incrementally, just compute them from the
+    // current set of requests.
+    std::map<std::string, uint32> queued, active;
+    AggregateListByID& idIndex = mAggregateList.get<tagID>();
+    for(AggregateListByID::iterator req_it = idIndex.begin(); req_it != idIndex.end(); req_it++) {
+        const std::map<std::string, std::tr1::shared_ptr<TransferRequest> >& reqs = (*req_it)->getTransferRequests();
+        for(std::map<std::string, std::tr1::shared_ptr<TransferRequest> >::const_iterator it = reqs.begin(); it != reqs.end(); it++) {
+            if ((*req_it)->mExecuting)
+                active[it->first]++;
+            else
+                queued[it->first]++;
+        }
+    }
+
+    result.put( String("pools"), Command::Array());
+    Command::Array& pools_ary = result.getArray("pools");
+    for(PoolStatsMap::iterator it = mPoolStats.begin(); it != mPoolStats.end(); it++) {
+        const PoolStats& stats = it->second;
+        pools_ary.push_back(Command::Object());
+        pools_ary.back().put("id", it->first);
+        pools_ary.back().put("received", stats.received);
+        pools_ary.back().put("completed", stats.completed);
+        pools_ary.back().put("cancelled", stats.cancelled);
+        pools_ary.back().put("queued", queued[it->first]);
+        pools_ary.back().put("active", active[it->first]);
+        pools_ary.back().put("latency.average", (stats.completed > 0 ? stats.totalLatency / stats.completed : Duration::zero()).toString());
+        pools_ary.back().put("latency.max", stats.maxLatency.toString());
+    }
+
+    result.put( String("handlers"), Command::Array());
+    Command::Array& handlers_ary = result.getArray("handlers");
+    for(HandlerSlotsMap::iterator it = mHandlerSlots.begin(); it != mHandlerSlots.end(); it++) {
+        handlers_ary.push_back(Command::Object());
+        handlers_ary.back().put("type", it->first);
+        handlers_ary.back().put("limit", it->second.limit);
+        handlers_ary.back().put("outstanding", it->second.outstanding);
+    }
+
+    cmdr->result(cmdid, result);
+}
+
 }
 }
@@ -0,0 +1,86 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/core/util/FreeList.hpp>
+
+namespace Sirikata {
+
+struct FreeList::ThreadList {
+    ThreadList(DestroyFunction d) : destroy(d) {}
+
+    DestroyFunction destroy;
+    Batch items;
+};
+
+void FreeList::destroyThreadList(ThreadList* tl) {
+    for(Batch::iterator it = tl->items.begin(); it != tl->items.end(); it++)
+        tl->destroy(*it);
+    delete tl;
+}
+
+FreeList::FreeList(uint32 max_per_thread, DestroyFunction destroy)
+ : mMaxPerThread(std::max(max_per_thread, (uint32)2)),
+   mDestroy(destroy),
+   mThreadLists(&FreeList::destroyThreadList),
+   mAllocations(0)
+{
+}
+
+FreeList::~FreeList() {
+    // Other threads' lists are cleaned up as they exit, but
+    // thread_specific_ptr only cleans up the current thread's on destruction.
+    for(BatchList::iterator bit = mTransfers.begin(); bit != mTransfers.end(); bit++) {
+        for(Batch::iterator it = bit->begin(); it != bit->end(); it++)
+            mDestroy(*it);
+    }
+}
+
+FreeList::ThreadList* FreeList::threadList() {
+    ThreadList* tl = mThreadLists.get();
+    if (tl == NULL) {
+        tl = new ThreadList(mDestroy);
+        tl->items.reserve(mMaxPerThread);
+        mThreadLists.reset(tl);
+    }
+    return tl;
+}
+
+void* FreeList::pop() {
+    ThreadList* tl = threadList();
+    if (tl->items.empty()) {
+        // Items commonly flow from one thread to another, e.g. allocated by
+        // the thread that parses messages and released by the one that sends
+        // them, so refill from what other threads have handed back.
+        boost::mutex::scoped_lock lock(mTransferMutex);
+        if (!mTransfers.empty()) {
+            tl->items.swap(mTransfers.back());
+            mTransfers.pop_back();
+        }
+    }
+    if (tl->items.empty()) {
+        mAllocations++;
+        return NULL;
+    }
+    void* result = tl->items.back();
+    tl->items.pop_back();
+    return result;
+}
+
+bool FreeList::push(void* item) {
+    ThreadList* tl = threadList();
+    if (tl->items.size() >= mMaxPerThread) {
+        // Hand half of this thread's items to other threads, keeping the rest
+        // so alternating push/pop doesn't hit the lock every time.
+        boost::mutex::scoped_lock lock(mTransferMutex);
+        if (mTransfers.size() >= MAX_TRANSFER_BATCHES)
+            return false;
+        uint32 batch_size = mMaxPerThread / 2;
+        mTransfers.push_back(Batch(tl->items.end() - batch_size, tl->items.end()));
+        tl->items.resize(tl->items.size() - batch_size);
+    }
+    tl->items.push_back(item);
+    return true;
+}
+
+} // namespace Sirikata
@@ -33,6 +33,7 @@
 #include <sirikata/core/util/Standard.hh>
 #include <sirikata/core/options/Options.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/mutex.hpp>
 
 extern "C" {
 void *Sirikata_Logging_OptionValue_defaultLevel;
@@ -43,6 +44,7 @@ namespace Sirikata { namespace Logging {
 
 extern "C" {
 std::ostream* SirikataLogStream = &std::cerr;
+int32 SirikataLogModuleLevels[SIRIKATA_MAX_LOG_MODULES];
 }
 
 void setLogStream(std::ostream* logfs) {
@@ -166,4 +168,125 @@ InitializeGlobalOptions o("",
 
 std::tr1::unordered_map<std::string,LOGGING_LEVEL> module_level;
 
+namespace {
+
+typedef std::tr1::unordered_map<std::string,LOGGING_LEVEL> ModuleLevelMap;
+
+// Registered modules. Only needed when registering a module or changing
+// levels -- checking a level only reads SirikataLogModuleLevels.
+struct LogModuleRegistry {
+    LogModuleRegistry() {
+        // Slot 0 is shared by any modules beyond SIRIKATA_MAX_LOG_MODULES
+        names.push_back("");
+    }
+
+    boost::mutex mutex;
+    typedef std::tr1::unordered_map<String, LogModuleID> IDMap;
+    IDMap ids;
+    std::vector<String> names;
+};
+
+// Never freed so logging still works during static destruction
+LogModuleRegistry& GetLogModuleRegistry() {
+    static LogModuleRegistry* registry = new LogModuleRegistry();
+    return *registry;
+}
+
+LOGGING_LEVEL GetLevelOption(void* opt, LOGGING_LEVEL default_level) {
+    if (opt == NULL || reinterpret_cast<OptionValue*>(opt)->get()->empty())
+        return default_level;
+    return reinterpret_cast<OptionValue*>(opt)->unsafeAs<LOGGING_LEVEL>();
+}
+
+ModuleLevelMap* GetModuleLevelOption() {
+    OptionValue* opt = reinterpret_cast<OptionValue*>(Sirikata_Logging_OptionValue_moduleLevel);
+    if (opt == NULL || opt->get()->empty())
+        return NULL;
+    return &(opt->unsafeAs<ModuleLevelMap>());
+}
+
+// Computes the level a module should log at. Must hold the registry lock.
+int32 ComputeLogLevel(const String& module) {
+#ifdef NDEBUG
+    LOGGING_LEVEL default_level = GetLevelOption(Sirikata_Logging_OptionValue_defaultLevel, info);
+    LOGGING_LEVEL max_level = GetLevelOption(Sirikata_Logging_OptionValue_atLeastLevel, info);
+#else
+    LOGGING_LEVEL default_level = GetLevelOption(Sirikata_Logging_OptionValue_defaultLevel, debug);
+    LOGGING_LEVEL max_level = GetLevelOption(Sirikata_Logging_OptionValue_atLeastLevel, insane);
+#endif
+    LOGGING_LEVEL module_level = default_level;
+    ModuleLevelMap* module_levels = GetModuleLevelOption();
+    if (module_levels != NULL && !module.empty()) {
+        ModuleLevelMap::const_iterator it = module_levels->find(module);
+        if (it != module_levels->end())
+            module_level = it->second;
+    }
+    return std::min((int32)std::max(max_level, default_level), (int32)module_level);
+}
+
+} // namespace
+
+LogModuleID RegisterLogModule(const char* module) {
+    LogModuleRegistry& registry = GetLogModuleRegistry();
+    boost::unique_lock<boost::mutex> lock(registry.mutex);
+
+    String module_str(module);
+    LogModuleRegistry::IDMap::iterator it = registry.ids.find(module_str);
+    if (it != registry.ids.end())
+        return it->second;
+
+    if (registry.names.size() >= SIRIKATA_MAX_LOG_MODULES) {
+        SirikataLogModuleLevels[0] = ComputeLogLevel("");
+        return 0;
+    }
+
+    LogModuleID id = registry.names.size();
+    registry.names.push_back(module_str);
+    registry.ids[module_str] = id;
+    SirikataLogModuleLevels[id] = ComputeLogLevel(module_str);
+    return id;
+}
+
+void UpdateLogLevels() {
+    LogModuleRegistry& registry = GetLogModuleRegistry();
+    boost::unique_lock<boost::mutex> lock(registry.mutex);
+    for(LogModuleID id = 0; id < registry.names.size(); id++)
+        SirikataLogModuleLevels[id] = ComputeLogLevel(registry.names[id]);
+}
+
+void SetLogLevel(const String& module, LOGGING_LEVEL lvl) {
+    {
+        LogModuleRegistry& registry = GetLogModuleRegistry();
+        boost::unique_lock<boost::mutex> lock(registry.mutex);
+        if (module.empty()) {
+            OptionValue* opt = reinterpret_cast<OptionValue*>(Sirikata_Logging_OptionValue_defaultLevel);
+            if (opt != NULL && !opt->get()->empty())
+                opt->unsafeAs<LOGGING_LEVEL>() = lvl;
+        }
+        else {
+            ModuleLevelMap* module_levels = GetModuleLevelOption();
+            if (module_levels != NULL)
+                (*module_levels)[module] = lvl;
+        }
+    }
+    UpdateLogLevels();
+}
+
+bool ParseLogLevel(const String& name, LOGGING_LEVEL* lvl_out) {
+    if (name != "insane" && LogLevelParser::lex_cast(name) == insane)
+        return false;
+    *lvl_out = LogLevelParser::lex_cast(name);
+    return true;
+}
+
+LogLevelMap GetLogLevels() {
+    LogModuleRegistry& registry = GetLogModuleRegistry();
+    boost::unique_lock<boost::mutex> lock(registry.mutex);
+    LogLevelMap result;
+    // Skip the shared overflow slot
+    for(LogModuleID id = 1; id < registry.names.size(); id++)
+        result[registry.names[id]] = (LOGGING_LEVEL)SirikataLogModuleLevels[id];
+    return result;
+}
+
 } }
@@ -46,11 +46,51 @@ void RegionWeightCalculatorFactory::destroy() {
 }
 
 
+RegionPairs::RegionPairs() {
+}
+
+RegionPairs::RegionPairs(const BoundingBoxList& sources, const BoundingBoxList& dests) {
+    size_t count = std::min(sources.size(), dests.size());
+    for(int c = 0; c < 3; c++) {
+        sourceMin[c].reserve(count);
+        sourceMax[c].reserve(count);
+        destMin[c].reserve(count);
+        destMax[c].reserve(count);
+    }
+    for(size_t i = 0; i < count; i++)
+        add(sources[i], dests[i]);
+}
+
+void RegionPairs::add(const BoundingBox3f& source_bbox, const BoundingBox3f& dest_bbox) {
+    for(int c = 0; c < 3; c++) {
+        sourceMin[c].push_back(source_bbox.min()[c]);
+        sourceMax[c].push_back(source_bbox.max()[c]);
+        destMin[c].push_back(dest_bbox.min()[c]);
+        destMax[c].push_back(dest_bbox.max()[c]);
+    }
+}
+
+void RegionPairs::clear() {
+    for(int c = 0; c < 3; c++) {
+        sourceMin[c].clear();
+        sourceMax[c].clear();
+        destMin[c].clear();
+        destMax[c].clear();
+    }
+}
+
+
 RegionWeightCalculator::RegionWeightCalculator(const WeightFunction& weightFunc)
  : mWeightFunc(weightFunc)
 {
 }
 
+RegionWeightCalculator::RegionWeightCalculator(const WeightFunction& weightFunc, const BatchWeightFunction& batchWeightFunc)
+ : mWeightFunc(weightFunc),
+   mBatchWeightFunc(batchWeightFunc)
+{
+}
+
 RegionWeightCalculator::~RegionWeightCalculator() {
 }
 
@@ -58,4 +98,24 @@ float64 RegionWeightCalculator::weight(const BoundingBox3f& source_bbox, Boundin
     return mWeightFunc(Vector3d(source_bbox.min()),Vector3d(source_bbox.max()),Vector3d(dest_bbox.min()),Vector3d(dest_bbox.max()));
 }
 
+void RegionWeightCalculator::weights(const RegionPairs& pairs, std::vector<float64>* results) {
+    results->resize(pairs.size());
+    if (pairs.size() == 0)
+        return;
+
+    if (mBatchWeightFunc) {
+        mBatchWeightFunc(pairs, &(*results)[0]);
+        return;
+    }
+
+    for(size_t i = 0; i < pairs.size(); i++) {
+        (*results)[i] = mWeightFunc(
+            Vector3d(pairs.sourceMin[0][i], pairs.sourceMin[1][i], pairs.sourceMin[2][i]),
+            Vector3d(pairs.sourceMax[0][i], pairs.sourceMax[1][i], pairs.sourceMax[2][i]),
+            Vector3d(pairs.destMin[0][i], pairs.destMin[1][i], pairs.destMin[2][i]),
+            Vector3d(pairs.destMax[0][i], pairs.destMax[1][i], pairs.destMax[2][i])
+        );
+    }
+}
+
 } // namespace Sirikata
@@ -38,6 +38,7 @@
 #include <sirikata/core/transfer/RemoteFileMetadata.hpp>
 #include "LightInfo.hpp"
 #include <stack>
+#include <boost/thread/mutex.hpp>
 
 namespace Sirikata {
 namespace Mesh {
@@ -80,6 +81,42 @@ struct SIRIKATA_MESH_EXPORT SkinController {
 };
 typedef std::vector<SkinController> SkinControllerList;
 
+class TriangleBVH;
+typedef std::tr1::shared_ptr<TriangleBVH> TriangleBVHPtr;
+
+/** Acceleration structures derived from a SubMeshGeometry, built lazily by
+ *  their users, e.g. Raytrace. The cache isn't carried along when geometry is
+ *  copied, since copies are usually made in order to modify them. Code which
+ *  modifies geometry in place should call reset(); recomputeBounds() and
+ *  append() do so.
+ */
+class SIRIKATA_MESH_EXPORT SubMeshGeometryCache {
+public:
+    SubMeshGeometryCache() {}
+    SubMeshGeometryCache(const SubMeshGeometryCache&) {}
+    SubMeshGeometryCache& operator=(const SubMeshGeometryCache&) {
+        reset();
+        return *this;
+    }
+
+    TriangleBVHPtr bvh() const {
+        boost::mutex::scoped_lock lock(mMutex);
+        return mBVH;
+    }
+    void setBVH(TriangleBVHPtr bvh) {
+        boost::mutex::scoped_lock lock(mMutex);
+        mBVH = bvh;
+    }
+
+    void reset() {
+        setBVH(TriangleBVHPtr());
+    }
+
+private:
+    mutable boost::mutex mMutex;
+    TriangleBVHPtr mBVH;
+};
+
 struct SIRIKATA_MESH_EXPORT SubMeshGeometry {
     std::string name;
 
@@ -115,6 +152,7 @@ struct SIRIKATA_MESH_EXPORT SubMeshGeometry {
 
     SkinControllerList skinControllers;
 
+    mutable SubMeshGeometryCache cache;
 
     /** Append the given SubMeshGeometry to the end of this one. Use the given
      *  transformation to transform the geometry before adding it.  This is a
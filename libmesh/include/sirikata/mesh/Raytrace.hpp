@@ -58,6 +58,21 @@ SIRIKATA_MESH_FUNCTION_EXPORT bool Raytrace(VisualPtr vis, const Matrix4x4f& vis
 SIRIKATA_MESH_FUNCTION_EXPORT bool RaytraceType(MeshdataPtr vis, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out);
 SIRIKATA_MESH_FUNCTION_EXPORT bool RaytraceType(BillboardPtr vis, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out);
 
+/** Traces many rays against the same mesh, which is much cheaper than calling
+ *  Raytrace for each since per-instance setup is done once for all of them.
+ *  Each ray is traced independently, exactly as Raytrace would.
+ *
+ *  \param vis the mesh to test the rays against
+ *  \param vis_xform transformation to apply to the mesh
+ *  \param ray_starts the starting positions of the rays
+ *  \param ray_dirs the directions of the rays, one per entry in ray_starts
+ *  \param t_out if non-NULL, resized to hold the parametric value of each
+ *  ray's collision. Only valid for rays which hit.
+ *  \param hit_out if non-NULL, resized to hold whether each ray hit
+ *  \returns the number of rays which hit
+ */
+SIRIKATA_MESH_FUNCTION_EXPORT uint32 RaytraceMany(VisualPtr vis, const Matrix4x4f& vis_xform, const std::vector<Vector3f>& ray_starts, const std::vector<Vector3f>& ray_dirs, std::vector<float32>* t_out, std::vector<bool>* hit_out);
+
 } // namespace Mesh
 } // namespace Sirikata
 
@@ -792,6 +792,7 @@ void MeshSimplifier::simplify(Mesh::MeshdataPtr agg_mesh, int32 numFacesLeft) {
     }
 
     curGeometry.positions = positions;
+    curGeometry.cache.reset();
     curGeometry.normals = normals;
     curGeometry.texUVs = texUVs;
   }
@@ -57,6 +57,7 @@ Node::Node(const Matrix4x4f& xform)
 }
 
 void SubMeshGeometry::append(const SubMeshGeometry& rhs, const Matrix4x4f& xform) {
+    cache.reset();
     Matrix3x3f normal_xform = xform.extract3x3().inverseTranspose();
 
     int32 index_offset = this->positions.size();
@@ -132,6 +133,7 @@ void SubMeshGeometry::append(const SubMeshGeometry& rhs, const Matrix4x4f& xform
 }
 
 void SubMeshGeometry::recomputeBounds() {
+    cache.reset();
     aabb = BoundingBox3f3f::null();
     radius = 0.;
     for(uint32 pi = 0; pi < primitives.size(); pi++) {
@@ -33,6 +33,8 @@
 #include <sirikata/mesh/Platform.hpp>
 #include <sirikata/mesh/Bounds.hpp>
 #include <sirikata/mesh/Raytrace.hpp>
+#include <limits>
+#include <cstring>
 
 namespace Sirikata {
 namespace Mesh {
@@ -308,101 +310,481 @@ bool SIRIKATA_MESH_FUNCTION_EXPORT Raytrace(VisualPtr vis, const Matrix4x4f& vis
     return false;
 }
 
-bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(MeshdataPtr mesh, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out) {
-    bool found_hit = false;
+namespace {
 
-    bool have_hit = false;
-    float32 t = 1000000.0;
+// Calls cb(i1, i2, i3) with the position indices of each triangle in geo.
+template<typename TriangleCallback>
+void forEachTriangle(const SubMeshGeometry& geo, TriangleCallback& cb) {
+    for(uint32 pi = 0; pi < geo.primitives.size(); pi++) {
+        const SubMeshGeometry::Primitive& prim = geo.primitives[pi];
+        const std::vector<unsigned short>& idx = prim.indices;
+        switch(prim.primitiveType) {
+          case SubMeshGeometry::Primitive::TRIANGLES:
+            for(uint32 ii = 0; ii + 2 < idx.size(); ii += 3)
+                cb(idx[ii], idx[ii+1], idx[ii+2]);
+            break;
+          case SubMeshGeometry::Primitive::TRISTRIPS:
+            for(uint32 ii = 0; ii + 2 < idx.size(); ii++) {
+                uint32 i1 = (ii % 2 == 0) ? ii : ii+1;
+                uint32 i2 = (ii % 2 == 0) ? ii+1 : ii;
+                cb(idx[i1], idx[i2], idx[ii+2]);
+            }
+            break;
+          case SubMeshGeometry::Primitive::TRIFANS:
+            for(uint32 ii = 1; ii + 1 < idx.size(); ii++)
+                cb(idx[0], idx[ii], idx[ii+1]);
+            break;
+          case SubMeshGeometry::Primitive::LINES:
+          case SubMeshGeometry::Primitive::POINTS:
+          case SubMeshGeometry::Primitive::LINESTRIPS:
+            break;
+        }
+    }
+}
+
+struct TriangleCollector {
+    TriangleCollector(const std::vector<Vector3f>& p, std::vector<Vector3f>* out)
+     : positions(p), triangles(out)
+    {}
+
+    void operator()(uint32 i1, uint32 i2, uint32 i3) {
+        triangles->push_back(positions[i1]);
+        triangles->push_back(positions[i2]);
+        triangles->push_back(positions[i3]);
+    }
+
+    const std::vector<Vector3f>& positions;
+    std::vector<Vector3f>* triangles;
+};
+
+// Tests triangles which have already been transformed into the ray's space.
+struct TransformedTriangleTester {
+    TransformedTriangleTester(const std::vector<Vector3f>& p, const Vector3f& start, const Vector3f& dir, float32* t_io)
+     : positions(p), ray_start(start), ray_dir(dir), t(t_io), hit(false)
+    {}
 
-    // For each instanced geometry
+    void operator()(uint32 i1, uint32 i2, uint32 i3) {
+        if (RaytraceTriangle(positions[i1], positions[i2], positions[i3], ray_start, ray_dir, t))
+            hit = true;
+    }
+
+    const std::vector<Vector3f>& positions;
+    const Vector3f& ray_start;
+    const Vector3f& ray_dir;
+    float32* t;
+    bool hit;
+};
+
+uint32 countIndices(const SubMeshGeometry& geo) {
+    uint32 result = 0;
+    for(uint32 pi = 0; pi < geo.primitives.size(); pi++)
+        result += geo.primitives[pi].indices.size();
+    return result;
+}
+
+// Initial t for traces, i.e. the maximum distance, matching the original brute
+// force implementation.
+const float32 MAX_RAY_T = 1000000.0f;
+
+} // namespace
+
+/** A bounding volume hierarchy over the triangles of a single SubMeshGeometry,
+ *  in the geometry's own coordinate space, split using the surface area
+ *  heuristic. Nodes are stored in a flat array in depth first order, so a
+ *  node's left child immediately follows it. Leaf triangles are packed 4 at a
+ *  time in structure-of-arrays form so each group is tested with a simple
+ *  4-wide loop the compiler can vectorize.
+ */
+class TriangleBVH {
+public:
+    TriangleBVH(const SubMeshGeometry& geo);
+
+    /// Whether this BVH may have been built from geo. Catches most in place
+    /// modifications that didn't reset the cache.
+    bool matches(const SubMeshGeometry& geo) const {
+        return mNumPositions == geo.positions.size() && mNumIndices == countIndices(geo);
+    }
+
+    /** Trace a ray, updating t and returning true if a hit is found at or
+     *  before the current value of t.
+     */
+    bool raytrace(const Vector3f& ray_start, const Vector3f& ray_dir, float32* t) const;
+
+private:
+    enum {
+        LANES = 4,
+        MAX_LEAF_TRIANGLES = 8,
+        SAH_BINS = 16,
+        MAX_DEPTH = 48
+    };
+
+    struct Node {
+        float32 lo[3];
+        float32 hi[3];
+        // For leaves, the first quad. For interior nodes, the right child.
+        uint32 offset;
+        // 0 for interior nodes
+        uint16 quadCount;
+        uint16 axis;
+    };
+
+    struct TriangleQuad {
+        float32 v0[3][LANES];
+        float32 e1[3][LANES];
+        float32 e2[3][LANES];
+    };
+
+    struct BuildTriangle {
+        Vector3f lo, hi, centroid;
+        uint32 index;
+    };
+
+    static uint32 binIndex(float32 c, float32 lo, float32 extent) {
+        return std::min((uint32)(SAH_BINS * (c - lo) / extent), (uint32)SAH_BINS - 1);
+    }
+
+    struct SplitPredicate {
+        SplitPredicate(int a, float32 l, float32 e, uint32 s)
+         : axis(a), lo(l), extent(e), split(s)
+        {}
+        bool operator()(const BuildTriangle& tri) const {
+            return binIndex(tri.centroid[axis], lo, extent) <= split;
+        }
+        int axis;
+        float32 lo, extent;
+        uint32 split;
+    };
+
+    static float32 area(const Vector3f& lo, const Vector3f& hi) {
+        Vector3f d = hi - lo;
+        return d.x*d.y + d.y*d.z + d.z*d.x;
+    }
+
+    uint32 build(std::vector<BuildTriangle>& tris, uint32 begin, uint32 end, const std::vector<Vector3f>& verts, uint32 depth);
+    void makeLeaf(uint32 node_idx, const std::vector<BuildTriangle>& tris, uint32 begin, uint32 end, const std::vector<Vector3f>& verts);
+    bool intersectBox(const Node& node, const Vector3f& o, const float32* inv_dir, float32 t) const;
+    bool intersectQuad(const TriangleQuad& quad, const Vector3f& o, const Vector3f& d, float32* t) const;
+
+    std::vector<Node> mNodes;
+    std::vector<TriangleQuad> mQuads;
+    std::size_t mNumPositions;
+    uint32 mNumIndices;
+};
+
+TriangleBVH::TriangleBVH(const SubMeshGeometry& geo)
+ : mNumPositions(geo.positions.size()),
+   mNumIndices(countIndices(geo))
+{
+    std::vector<Vector3f> verts;
+    TriangleCollector collector(geo.positions, &verts);
+    forEachTriangle(geo, collector);
+
+    uint32 ntris = verts.size() / 3;
+    if (ntris == 0) return;
+
+    std::vector<BuildTriangle> tris(ntris);
+    for(uint32 i = 0; i < ntris; i++) {
+        const Vector3f& a = verts[3*i];
+        const Vector3f& b = verts[3*i+1];
+        const Vector3f& c = verts[3*i+2];
+        tris[i].lo = a.min(b).min(c);
+        tris[i].hi = a.max(b).max(c);
+        tris[i].centroid = (tris[i].lo + tris[i].hi) * 0.5f;
+        tris[i].index = i;
+    }
+
+    mNodes.reserve(2 * (ntris / LANES) + 1);
+    mQuads.reserve(ntris / LANES + 1);
+    build(tris, 0, ntris, verts, 0);
+}
+
+uint32 TriangleBVH::build(std::vector<BuildTriangle>& tris, uint32 begin, uint32 end, const std::vector<Vector3f>& verts, uint32 depth) {
+    uint32 node_idx = mNodes.size();
+    mNodes.push_back(Node());
+
+    Vector3f lo = tris[begin].lo, hi = tris[begin].hi;
+    Vector3f clo = tris[begin].centroid, chi = tris[begin].centroid;
+    for(uint32 i = begin + 1; i < end; i++) {
+        lo = lo.min(tris[i].lo);
+        hi = hi.max(tris[i].hi);
+        clo = clo.min(tris[i].centroid);
+        chi = chi.max(tris[i].centroid);
+    }
+    for(int k = 0; k < 3; k++) {
+        mNodes[node_idx].lo[k] = lo[k];
+        mNodes[node_idx].hi[k] = hi[k];
+    }
+
+    uint32 count = end - begin;
+    if (count <= LANES || depth >= MAX_DEPTH - 1) {
+        makeLeaf(node_idx, tris, begin, end, verts);
+        return node_idx;
+    }
+
+    // Binned SAH: try SAH_BINS-1 candidate splits along each axis and keep
+    // the cheapest, with costs in units of triangle tests.
+    float32 best_cost = std::numeric_limits<float32>::max();
+    int best_axis = -1;
+    uint32 best_split = 0;
+    for(int axis = 0; axis < 3; axis++) {
+        float32 extent = chi[axis] - clo[axis];
+        if (extent <= 0) continue;
+
+        uint32 bin_count[SAH_BINS];
+        Vector3f bin_lo[SAH_BINS], bin_hi[SAH_BINS];
+        for(uint32 b = 0; b < SAH_BINS; b++) bin_count[b] = 0;
+        for(uint32 i = begin; i < end; i++) {
+            uint32 b = binIndex(tris[i].centroid[axis], clo[axis], extent);
+            bin_lo[b] = (bin_count[b] == 0) ? tris[i].lo : bin_lo[b].min(tris[i].lo);
+            bin_hi[b] = (bin_count[b] == 0) ? tris[i].hi : bin_hi[b].max(tris[i].hi);
+            bin_count[b]++;
+        }
+
+        // Sweep from the right for the cost of everything right of each split
+        float32 right_area[SAH_BINS];
+        uint32 right_count[SAH_BINS];
+        Vector3f rlo(0, 0, 0), rhi(0, 0, 0);
+        uint32 rcount = 0;
+        for(uint32 b = SAH_BINS - 1; b > 0; b--) {
+            if (bin_count[b] > 0) {
+                rlo = (rcount == 0) ? bin_lo[b] : rlo.min(bin_lo[b]);
+                rhi = (rcount == 0) ? bin_hi[b] : rhi.max(bin_hi[b]);
+                rcount += bin_count[b];
+            }
+            right_count[b] = rcount;
+            right_area[b] = (rcount == 0) ? 0 : area(rlo, rhi);
+        }
+
+        Vector3f llo(0, 0, 0), lhi(0, 0, 0);
+        uint32 lcount = 0;
+        for(uint32 b = 0; b < SAH_BINS - 1; b++) {
+            if (bin_count[b] > 0) {
+                llo = (lcount == 0) ? bin_lo[b] : llo.min(bin_lo[b]);
+                lhi = (lcount == 0) ? bin_hi[b] : lhi.max(bin_hi[b]);
+                lcount += bin_count[b];
+            }
+            if (lcount == 0 || right_count[b+1] == 0) continue;
+            float32 cost = area(llo, lhi) * lcount + right_area[b+1] * right_count[b+1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // Splitting costs about one extra node test, so small sets which don't
+    // split well become leaves.
+    float32 node_area = area(lo, hi);
+    if (count <= MAX_LEAF_TRIANGLES && (best_axis == -1 || best_cost + node_area >= node_area * count)) {
+        makeLeaf(node_idx, tris, begin, end, verts);
+        return node_idx;
+    }
+
+    uint32 mid = begin + count / 2;
+    if (best_axis != -1) {
+        BuildTriangle* first = &tris[0] + begin;
+        BuildTriangle* last = &tris[0] + end;
+        BuildTriangle* split = std::partition(first, last, SplitPredicate(best_axis, clo[best_axis], chi[best_axis] - clo[best_axis], best_split));
+        if (split != first && split != last)
+            mid = begin + (split - first);
+    }
+    // Otherwise all the centroids coincide and there are too many triangles
+    // for a leaf, so just split them in half.
+
+    build(tris, begin, mid, verts, depth + 1);
+    uint32 right = build(tris, mid, end, verts, depth + 1);
+    mNodes[node_idx].offset = right;
+    mNodes[node_idx].quadCount = 0;
+    mNodes[node_idx].axis = (best_axis == -1) ? 0 : best_axis;
+    return node_idx;
+}
+
+void TriangleBVH::makeLeaf(uint32 node_idx, const std::vector<BuildTriangle>& tris, uint32 begin, uint32 end, const std::vector<Vector3f>& verts) {
+    uint32 nquads = (end - begin + LANES - 1) / LANES;
+    mNodes[node_idx].offset = mQuads.size();
+    mNodes[node_idx].quadCount = nquads;
+    mNodes[node_idx].axis = 0;
+
+    for(uint32 q = 0; q < nquads; q++) {
+        // Unused lanes are left as degenerate triangles, which never hit
+        TriangleQuad quad;
+        memset(&quad, 0, sizeof(quad));
+        for(uint32 l = 0; l < LANES; l++) {
+            uint32 i = begin + q * LANES + l;
+            if (i >= end) break;
+            const Vector3f& a = verts[3 * tris[i].index];
+            Vector3f e1 = verts[3 * tris[i].index + 1] - a;
+            Vector3f e2 = verts[3 * tris[i].index + 2] - a;
+            for(int k = 0; k < 3; k++) {
+                quad.v0[k][l] = a[k];
+                quad.e1[k][l] = e1[k];
+                quad.e2[k][l] = e2[k];
+            }
+        }
+        mQuads.push_back(quad);
+    }
+}
+
+bool TriangleBVH::intersectBox(const Node& node, const Vector3f& o, const float32* inv_dir, float32 t) const {
+    float32 tmin = 0, tmax = t;
+    for(int k = 0; k < 3; k++) {
+        float32 t1 = (node.lo[k] - o[k]) * inv_dir[k];
+        float32 t2 = (node.hi[k] - o[k]) * inv_dir[k];
+        if (t1 > t2) std::swap(t1, t2);
+        if (t1 > tmin) tmin = t1;
+        if (t2 < tmax) tmax = t2;
+        if (tmin > tmax) return false;
+    }
+    return true;
+}
+
+bool TriangleBVH::intersectQuad(const TriangleQuad& q, const Vector3f& o, const Vector3f& d, float32* t) const {
+    // Moller-Trumbore, two sided, with the same edge tolerance as
+    // RaytraceTriangle. Written without branches so each lane is independent.
+    const float32 EPSILON = 1e-6f;
+    float32 lane_t[LANES];
+    for(int l = 0; l < LANES; l++) {
+        float32 px = d.y * q.e2[2][l] - d.z * q.e2[1][l];
+        float32 py = d.z * q.e2[0][l] - d.x * q.e2[2][l];
+        float32 pz = d.x * q.e2[1][l] - d.y * q.e2[0][l];
+        float32 det = q.e1[0][l] * px + q.e1[1][l] * py + q.e1[2][l] * pz;
+        float32 inv_det = (det != 0) ? 1.f / det : 0.f;
+
+        float32 tx = o.x - q.v0[0][l];
+        float32 ty = o.y - q.v0[1][l];
+        float32 tz = o.z - q.v0[2][l];
+        float32 u = (tx * px + ty * py + tz * pz) * inv_det;
+
+        float32 qx = ty * q.e1[2][l] - tz * q.e1[1][l];
+        float32 qy = tz * q.e1[0][l] - tx * q.e1[2][l];
+        float32 qz = tx * q.e1[1][l] - ty * q.e1[0][l];
+        float32 v = (d.x * qx + d.y * qy + d.z * qz) * inv_det;
+        float32 lt = (q.e2[0][l] * qx + q.e2[1][l] * qy + q.e2[2][l] * qz) * inv_det;
+
+        bool lane_hit = (det != 0) & (u >= -EPSILON) & (v >= -EPSILON) & (u + v <= 1 + EPSILON) & (lt >= 0);
+        lane_t[l] = lane_hit ? lt : std::numeric_limits<float32>::max();
+    }
+
+    float32 best = std::min(std::min(lane_t[0], lane_t[1]), std::min(lane_t[2], lane_t[3]));
+    if (best > *t) return false;
+    *t = best;
+    return true;
+}
+
+bool TriangleBVH::raytrace(const Vector3f& ray_start, const Vector3f& ray_dir, float32* t) const {
+    if (mNodes.empty()) return false;
+
+    float32 inv_dir[3];
+    for(int k = 0; k < 3; k++) {
+        // Avoid infinities so 0 * inv_dir stays well defined
+        float32 dk = ray_dir[k];
+        if (fabs(dk) < 1e-20f) dk = (dk < 0) ? -1e-20f : 1e-20f;
+        inv_dir[k] = 1.f / dk;
+    }
+
+    bool hit = false;
+    uint32 stack[2 * MAX_DEPTH];
+    uint32 stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size > 0) {
+        uint32 node_idx = stack[--stack_size];
+        const Node& node = mNodes[node_idx];
+        if (!intersectBox(node, ray_start, inv_dir, *t)) continue;
+
+        if (node.quadCount > 0) {
+            for(uint32 q = node.offset; q < node.offset + node.quadCount; q++) {
+                if (intersectQuad(mQuads[q], ray_start, ray_dir, t))
+                    hit = true;
+            }
+            continue;
+        }
+
+        // Push the far child first so the near one is visited first and
+        // shrinks t for the far one
+        uint32 left = node_idx + 1, right = node.offset;
+        if (ray_dir[node.axis] < 0) {
+            stack[stack_size++] = left;
+            stack[stack_size++] = right;
+        }
+        else {
+            stack[stack_size++] = right;
+            stack[stack_size++] = left;
+        }
+    }
+    return hit;
+}
+
+namespace {
+
+// Gets the cached BVH for geo, building it if necessary. Concurrent callers
+// may each build one, in which case the last one wins.
+TriangleBVHPtr getBVH(const SubMeshGeometry& geo) {
+    TriangleBVHPtr bvh = geo.cache.bvh();
+    if (!bvh || !bvh->matches(geo)) {
+        bvh = TriangleBVHPtr(new TriangleBVH(geo));
+        geo.cache.setBVH(bvh);
+    }
+    return bvh;
+}
+
+struct RayResult {
+    RayResult()
+     : t(MAX_RAY_T), hit(false)
+    {}
+    float32 t;
+    bool hit;
+};
+
+// Traces nrays rays against all instances of the mesh. Rays are transformed
+// into each instance's space rather than transforming the geometry, which
+// leaves t unchanged since the transformation is affine.
+void raytraceMeshdata(MeshdataPtr mesh, const Matrix4x4f& vis_xform, uint32 nrays, const Vector3f* ray_starts, const Vector3f* ray_dirs, RayResult* results) {
     Meshdata::GeometryInstanceIterator geoIter = mesh->getGeometryInstanceIterator();
     uint32 indexInstance; Matrix4x4f transformInstance;
     while(geoIter.next(&indexInstance, &transformInstance)) {
         GeometryInstance& geoInst = mesh->instances[indexInstance];
         const SubMeshGeometry& geo = mesh->geometry[ geoInst.geometryIndex ];
 
-        // We would transform all vertex data up front, but if we only have line
-        // or point data there's no point. Do it on demand, but transform
-        // everything at once when we know we need it.
-        // FIXME its probably better to invert transformInstance and transform
-        // the ray instead of the triangles.
-        std::vector<Vector3f> pos;
-
-        // Check each primitive in this geometry
-        for(uint32 pi = 0; pi < geo.primitives.size(); pi++) {
-            const SubMeshGeometry::Primitive& prim = geo.primitives[pi];
-            if (prim.primitiveType == SubMeshGeometry::Primitive::LINES ||
-                prim.primitiveType == SubMeshGeometry::Primitive::POINTS ||
-                prim.primitiveType == SubMeshGeometry::Primitive::LINESTRIPS)
-                continue;
-
-            // Transform all the positions on demand the first time we encounter
-            // a real need for them.
-            if (pos.empty()) {
-                pos.resize(geo.positions.size());
-                for(uint32 i = 0; i < geo.positions.size(); i++)
-                    pos[i] = vis_xform * transformInstance * geo.positions[i];
+        Matrix4x4f xform = vis_xform * transformInstance;
+        Matrix4x4f inv_xform;
+        if (xform.invert(inv_xform) == 0) {
+            // Singular, e.g. scaled to nothing along one axis, so we can't
+            // move the ray into instance space. Fall back to transforming
+            // the triangles.
+            std::vector<Vector3f> pos(geo.positions.size());
+            for(uint32 i = 0; i < geo.positions.size(); i++)
+                pos[i] = xform * geo.positions[i];
+            for(uint32 r = 0; r < nrays; r++) {
+                TransformedTriangleTester tester(pos, ray_starts[r], ray_dirs[r], &results[r].t);
+                forEachTriangle(geo, tester);
+                if (tester.hit) results[r].hit = true;
             }
+            continue;
+        }
 
-            // Now we actually perform checks against transformed
-            // triangles. Each of these will just generate a list of triangle
-            // and defer to a helper to check for intersection and update the
-            // state.
-            switch(prim.primitiveType) {
-              case SubMeshGeometry::Primitive::TRIANGLES:
-                for(uint32 ii = 0; ii < prim.indices.size()/3; ii++) {
-                    have_hit = have_hit ||
-                        RaytraceTriangle(
-                            pos[prim.indices[3*ii]],
-                            pos[prim.indices[3*ii+1]],
-                            pos[prim.indices[3*ii+2]],
-                            ray_start, ray_dir,
-                            &t
-                        );
-                }
-                break;
-              case SubMeshGeometry::Primitive::TRISTRIPS:
-                for(uint32 ii = 0; ii < prim.indices.size()-2; ii++) {
-                    uint32 i1 = (ii % 2 == 0) ? ii : ii+1;
-                    uint32 i2 = (ii % 2 == 0) ? ii+1 : ii;
-                    uint32 i3 = ii+2;
-                    have_hit = have_hit ||
-                        RaytraceTriangle(
-                            pos[prim.indices[i1]],
-                            pos[prim.indices[i2]],
-                            pos[prim.indices[i3]],
-                            ray_start, ray_dir,
-                            &t
-                        );
-                }
-                break;
-              case SubMeshGeometry::Primitive::TRIFANS:
-                for(uint32 ii = 1; ii < prim.indices.size()-1; ii++) {
-                    have_hit = have_hit ||
-                        RaytraceTriangle(
-                            pos[prim.indices[0]],
-                            pos[prim.indices[ii]],
-                            pos[prim.indices[ii+1]],
-                            ray_start, ray_dir,
-                            &t
-                        );
-                }
-                break;
-              case SubMeshGeometry::Primitive::LINES:
-              case SubMeshGeometry::Primitive::POINTS:
-              case SubMeshGeometry::Primitive::LINESTRIPS:
-                assert(false && "Shouldn't reach these cases since they were handled earlier.");
-                break;
-            }
+        TriangleBVHPtr bvh = getBVH(geo);
+        for(uint32 r = 0; r < nrays; r++) {
+            Vector3f local_start = inv_xform * ray_starts[r];
+            Vector3f local_dir = inv_xform * (ray_starts[r] + ray_dirs[r]) - local_start;
+            if (bvh->raytrace(local_start, local_dir, &results[r].t))
+                results[r].hit = true;
         }
     }
+}
+
+} // namespace
+
+bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(MeshdataPtr mesh, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out) {
+    RayResult result;
+    raytraceMeshdata(mesh, vis_xform, 1, &ray_start, &ray_dir, &result);
 
     // Provide output
-    if (have_hit) {
-        if (t_out != NULL) *t_out = t;
-        if (hit_out != NULL) *hit_out = ray_start + ray_dir * t;
+    if (result.hit) {
+        if (t_out != NULL) *t_out = result.t;
+        if (hit_out != NULL) *hit_out = ray_start + ray_dir * result.t;
     }
-    return have_hit;
+    return result.hit;
 }
 
 bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(BillboardPtr bboard, const Matrix4x4f& vis_xform, const Vector3f& ray_start, const Vector3f& ray_dir, float32* t_out, Vector3f* hit_out) {
@@ -465,5 +847,31 @@ bool SIRIKATA_MESH_FUNCTION_EXPORT RaytraceType(BillboardPtr bboard, const Matri
     return have_hit;
 }
 
+uint32 SIRIKATA_MESH_FUNCTION_EXPORT RaytraceMany(VisualPtr vis, const Matrix4x4f& vis_xform, const std::vector<Vector3f>& ray_starts, const std::vector<Vector3f>& ray_dirs, std::vector<float32>* t_out, std::vector<bool>* hit_out) {
+    assert(ray_starts.size() == ray_dirs.size());
+    uint32 nrays = ray_starts.size();
+    std::vector<RayResult> results(nrays);
+
+    MeshdataPtr md(std::tr1::dynamic_pointer_cast<Meshdata>(vis));
+    if (md && nrays > 0) {
+        raytraceMeshdata(md, vis_xform, nrays, &ray_starts[0], &ray_dirs[0], &results[0]);
+    }
+    else {
+        BillboardPtr bboard(std::tr1::dynamic_pointer_cast<Billboard>(vis));
+        for(uint32 r = 0; bboard && r < nrays; r++)
+            results[r].hit = RaytraceType(bboard, vis_xform, ray_starts[r], ray_dirs[r], &results[r].t, NULL);
+    }
+
+    uint32 nhits = 0;
+    if (t_out != NULL) t_out->resize(nrays);
+    if (hit_out != NULL) hit_out->resize(nrays);
+    for(uint32 r = 0; r < nrays; r++) {
+        if (results[r].hit) nhits++;
+        if (t_out != NULL) (*t_out)[r] = results[r].t;
+        if (hit_out != NULL) (*hit_out)[r] = results[r].hit;
+    }
+    return nhits;
+}
+
 } // namespace Mesh
 } // namespace Sirikata
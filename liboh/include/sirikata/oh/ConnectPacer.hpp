@@ -0,0 +1,79 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_OH_CONNECT_PACER_HPP_
+#define _SIRIKATA_OH_CONNECT_PACER_HPP_
+
+#include <sirikata/oh/Platform.hpp>
+#include <sirikata/oh/ObjectHost.hpp>
+
+namespace Sirikata {
+
+/** ConnectPacer paces bulk loading of objects, e.g. by an ObjectFactory, so a
+ *  large set of objects comes up as quickly as the space can accept them
+ *  without flooding it with session requests.
+ *
+ *  Every tick the loader is asked to start another batch of objects. The
+ *  number of session requests allowed to be outstanding works like TCP's
+ *  congestion window: it grows additively while the space's smoothed response
+ *  latency stays under a target, and is halved when it goes over. The rate
+ *  can also be capped explicitly.
+ */
+class SIRIKATA_OH_EXPORT ConnectPacer {
+public:
+    /** Starts up to count more objects. Returns false once there are no more
+     *  objects to start.
+     */
+    typedef std::tr1::function<bool(uint32 count)> StartBatchCallback;
+
+    /** Create a pacer for loading objects into space.
+     *  \param max_rate maximum number of objects to start per second
+     *  \param target_latency session request latency to aim for
+     *  \param cb invoked from the main strand to start each batch
+     */
+    ConnectPacer(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, uint32 max_rate, const Duration& target_latency, StartBatchCallback cb);
+
+    /** Start the first batch immediately, continuing until the callback
+     *  reports it is done or the context stops.
+     */
+    void start();
+
+    /** Update the window with the latest session statistics and get the
+     *  number of objects which may be started now.
+     */
+    uint32 nextBatchSize(const SessionManager::ConnectStats& stats, const Time& now);
+
+    uint32 window() const { return mWindow; }
+
+private:
+    void tick();
+
+    ObjectHostContext* mContext;
+    ObjectHost* mOH;
+    SpaceID mSpace;
+    StartBatchCallback mCallback;
+
+    // Objects per second and the most credit, in objects, that can build up
+    // while the window or the loader holds things up
+    const double mMaxRate;
+    const double mMaxCredit;
+    const Duration mTargetLatency;
+
+    // Objects which may be started under the rate cap. Fractional credit is
+    // carried over between ticks so low rates aren't rounded up.
+    double mCredit;
+    Time mLastRefill;
+
+    // Number of session requests allowed to be outstanding
+    uint32 mWindow;
+    // Number of latency samples we've already responded to
+    uint64 mLastSamples;
+    // Only back off once per round trip, since the smoothed latency takes a
+    // while to reflect the effect of the last decrease
+    Time mLastDecrease;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_OH_CONNECT_PACER_HPP_
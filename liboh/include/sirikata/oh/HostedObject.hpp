@@ -269,7 +269,7 @@ public:
 
     /// Receive an ObjectMessage from the space via the ObjectHost. Translate it
     /// to our runtime ODP structure and deliver it.
-    void receiveMessage(const SpaceID& space, const Protocol::Object::ObjectMessage* msg);
+    void receiveMessage(const SpaceID& space, Protocol::Object::ObjectMessage* msg);
 
 
     HostedObjectPtr getSharedPtr() {
@@ -219,6 +219,12 @@ public:
      * is just a utility, is always -serverTimeOffset(). */
     Duration clientTimeOffset(const SpaceID& space) const;
 
+    /** Get statistics about session requests to the given space, e.g. for
+     *  pacing bulk connections. Empty if no objects have tried to connect to
+     *  the space yet.
+     */
+    SessionManager::ConnectStats connectStats(const SpaceID& space) const;
+
     /** Convert a local time into a time for the given space.
      *  \param space the space to translate to
      *  \param t the local time to convert
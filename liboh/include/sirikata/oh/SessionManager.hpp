@@ -143,6 +143,26 @@ class SIRIKATA_OH_EXPORT SessionManager
     /** Disconnect the object from the space. */
     void disconnect(const SpaceObjectReference& id);
 
+    /** Statistics about object session requests, allowing bulk loaders to
+     *  pace how quickly they connect objects (see ConnectPacer).
+     */
+    struct ConnectStats {
+        ConnectStats()
+         : pending(0),
+           samples(0)
+        {}
+
+        // Session requests which haven't gotten a response yet
+        uint32 pending;
+        // Smoothed time between requesting a session and the space server
+        // accepting it
+        Duration latency;
+        // Number of responses latency has been computed from, so callers can
+        // tell whether it has been updated
+        uint64 samples;
+    };
+    ConnectStats connectStats() const;
+
     /** Get offset of server time from client time for the given space. Should
      * only be called by objects with an active connection to that space.
      */
@@ -165,6 +185,9 @@ class SIRIKATA_OH_EXPORT SessionManager
     // (no callback from SpaceNodeConnection yet) so we can build OHDP::SST
     // streams as part of the connection process.
     bool send(const SpaceObjectReference& sporef_objid, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload, ServerID dest_server = NullServerID);
+    // The payload is sent directly from the caller's buffer, without copying
+    // it into an ObjectMessage first.
+    bool send(const SpaceObjectReference& sporef_objid, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, MemoryReference payload, ServerID dest_server = NullServerID);
 
     SSTStreamPtr getSpaceStream(const ObjectReference& objectID);
 
@@ -199,10 +222,13 @@ private:
     void handleServerMessages(Liveness::Token alive, SpaceNodeConnection* conn);
     // Starting point for handling of all messages from the server -- either handled as a special case, such as
     // for session management, or dispatched to the object
-    void handleServerMessage(ObjectMessage* msg, ServerID sid);
+    void handleServerMessage(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID sid);
 
     // Handles session messages received from the server -- connection replies, migration requests, etc.
     void handleSessionMessage(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID from_server);
+    // Handles a batch of session messages for many objects from the server
+    void handleSessionBatch(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID from_server);
+    void handleSessionContainer(ServerID from_server, const SpaceObjectReference& sporef_obj, Sirikata::Protocol::Session::Container& session_msg);
     // Handlers for specific parts of session messages
     void handleSessionMessageConnectResponseSuccess(ServerID from_server, const SpaceObjectReference& sporef_obj, Sirikata::Protocol::Session::Container& session_msg);
     void handleSessionMessageConnectResponseRedirect(ServerID from_server, const SpaceObjectReference& sporef_obj, Sirikata::Protocol::Session::Container& session_msg);
@@ -230,6 +256,13 @@ private:
     // the connection success response back).
     void sendDisconnectMessage(const SpaceObjectReference& sporef, ServerID connected_to, uint64 session_seqno);
 
+    // Session messages which don't need to be sent immediately, like acks and
+    // disconnects. If batching is enabled they are collected per server and
+    // sent in batches once the current handler finishes, so connecting or
+    // disconnecting many objects doesn't require a message for each.
+    void queueSessionMessage(const SpaceObjectReference& sporef, ServerID dest_server, const Sirikata::Protocol::Session::Container& session_msg);
+    void flushSessionMessages(ServerID dest_server);
+
     // Utility method which keeps trying to resend a message
     void sendRetryingMessage(const SpaceObjectReference& sporef_src, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload, ServerID dest_server, Network::IOStrand* strand, const Duration& rate);
 
@@ -274,6 +307,19 @@ private:
     // request can be identified if it was retransmitted because it took too
     // long to get a response but was received
     void checkConnectedAndRetry(const SpaceObjectReference& sporef_uuid, ServerID connTo);
+    // Batched version of checkConnectedAndRetry, so a burst of session
+    // requests only needs a single timer
+    void checkConnectedAndRetryBatch(const std::vector<SpaceObjectReference>& sporefs, ServerID connTo);
+
+    // Session requests are queued per space server and sent together in
+    // batches from a single handler, rather than each getting its own message,
+    // handler and retry timers. If the connection can't accept them all, the
+    // rest wait and are retried in order.
+    void flushConnectRequests(ServerID sid);
+    // Builds the session request for the object.
+    void fillConnectRequest(const SpaceObjectReference& sporef_uuid, Sirikata::Protocol::Session::Container* session_msg);
+    // Records a response to a session request, updating ConnectStats
+    void recordConnectResponse(const SpaceObjectReference& sporef_uuid, bool success);
 
 
     /** Object session migration. */
@@ -392,6 +438,8 @@ private:
 
         ServerID getMigratingToServer(const SpaceObjectReference& sporef_obj_id);
 
+        ConnectingInfo& getConnectingInfo(const SpaceObjectReference& sporef_obj_id);
+
         //UUID getInternalID(const ObjectReference& space_objid) const;
 
         // We have to defer some callbacks sometimes for time
@@ -458,16 +506,28 @@ private:
     void spaceConnectCallback(int err, SSTStreamPtr s, SpaceObjectReference obj, ConnectionEvent after);
     std::map<ObjectReference, SSTStreamPtr> mObjectToSpaceStreams;
 
+    // Session requests waiting to be sent, per space server
+    typedef std::tr1::unordered_map<ServerID, std::deque<SpaceObjectReference> > ConnectRequestQueueMap;
+    ConnectRequestQueueMap mConnectRequests;
+    // Whether session messages are sent in batches, from oh.session-batching
+    bool mBatchSessionMessages;
+    // Serialized session messages waiting to be sent in a batch, per space
+    // server
+    typedef std::tr1::unordered_map<ServerID, SessionBatchEntryList> SessionMessageListMap;
+    SessionMessageListMap mOutgoingSessionMessages;
+    // Start time of session requests which haven't gotten a response yet
+    typedef std::tr1::unordered_map<SpaceObjectReference, Time, SpaceObjectReference::Hasher> ConnectStartTimeMap;
+    ConnectStartTimeMap mConnectStartTimes;
+    ConnectStats mConnectStats;
+    Trace::MetricHistogram* mConnectLatency;
+
 #ifdef PROFILE_OH_PACKET_RTT
     // Track outstanding packets for computing RTTs
     typedef std::tr1::unordered_map<uint64, Time> OutstandingPacketMap;
     OutstandingPacketMap mOutstandingPackets;
     uint8 mClearOutstandingCount;
-    // And stats
-    Duration mLatencySum;
-    uint32 mLatencyCount;
-    // And some helpers for reporting
-    const String mTimeSeriesOHRTT;
+    // And stats, in microseconds
+    Trace::MetricHistogram* mRTT;
 #endif
 }; // class SessionManager
 
@@ -66,9 +66,15 @@ struct SIRIKATA_OH_EXPORT SpaceNodeConnection : public Liveness {
 
     // Push a packet to be sent out
     bool push(const ObjectMessage& msg);
+    // Push a packet to be sent out, with the payload kept separate from the
+    // rest of the message, which must have an empty payload. This avoids
+    // copying the payload into the message and its serialized form.
+    bool push(const ObjectMessage& header, MemoryReference payload);
 
-    // Pull a packet from the receive queue
-    ObjectMessage* pull();
+    // Pull a packet from the receive queue. Messages come from
+    // acquireObjectMessage, so they should be released with
+    // releaseObjectMessage when they are no longer needed.
+    Sirikata::Protocol::Object::ObjectMessage* pull();
 
     bool empty();
     void shutdown();
@@ -110,7 +116,7 @@ struct SIRIKATA_OH_EXPORT SpaceNodeConnection : public Liveness {
     bool mConnecting;
 
     // IO Strand
-    QueueRouterElement<ObjectMessage> receive_queue;
+    QueueRouterElement<Sirikata::Protocol::Object::ObjectMessage> receive_queue;
 
     ConnectionEventCallback mConnectCB;
     ReceiveCallback mReceiveCB;
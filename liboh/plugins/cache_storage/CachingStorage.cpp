@@ -0,0 +1,844 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "CachingStorage.hpp"
+#include <sirikata/oh/ObjectHostContext.hpp>
+
+// Bounds used to cover an entire bucket. Keys are UTF-8 strings, which never
+// contain a 0xff byte, so this sorts after every valid key.
+#define BUCKET_START_KEY ""
+#define BUCKET_END_KEY "\xff"
+
+namespace Sirikata {
+namespace OH {
+
+/** Implementation Notes
+ *  --------------------
+ *
+ *  Each leased bucket has a map of cached entries. A bucket becomes 'complete'
+ *  once a range read over the entire bucket (issued when the lease is taken)
+ *  returns, after which any key missing from the map is known not to exist and
+ *  range operations and counts can be answered from memory. Evicting any entry
+ *  from a bucket makes it incomplete again.
+ *
+ *  Writes and erases are always applied locally and marked dirty. Dirty keys
+ *  are sent to the backend in a single transaction per bucket when the flush
+ *  timer fires, when too many keys are waiting to be sent, or ahead of any
+ *  transaction that has to be forwarded to the backend (so the backend sees
+ *  the same data the cache does). Repeated writes to a key before it is sent
+ *  only result in one backend write.
+ *
+ *  We rely on the backend committing transactions for a bucket in the order
+ *  they were submitted, which the SQLite backend does by processing them from
+ *  a single queue. Under that assumption a later commit never needs to wait
+ *  for the result of an earlier one.
+ */
+
+CachingStorage::CachingStorage(ObjectHostContext* ctx, Storage* backend, uint32 max_entries, uint32 max_dirty, const Duration& flush_interval, bool preload, bool durable_callbacks)
+ : mContext(ctx),
+   mBackend(backend),
+   mEntries(0),
+   mPending(0),
+   mVersion(0),
+   mMaxEntries(max_entries),
+   mMaxDirty(max_dirty),
+   mFlushInterval(flush_interval),
+   mPreload(preload),
+   mDurableCallbacks(durable_callbacks),
+   mFlushTimer(),
+   mFlushScheduled(false)
+{
+}
+
+CachingStorage::~CachingStorage() {
+    for(BucketTransactions::iterator it = mTransactions.begin(); it != mTransactions.end(); it++)
+        delete it->second;
+    mTransactions.clear();
+
+    for(BucketDataMap::iterator it = mBuckets.begin(); it != mBuckets.end(); it++)
+        delete it->second;
+    mBuckets.clear();
+
+    delete mBackend;
+}
+
+void CachingStorage::start() {
+    mFlushTimer = Network::IOTimer::create(
+        mContext->mainStrand,
+        std::tr1::bind(&CachingStorage::handleFlushTimer, this)
+    );
+
+    mBackend->start();
+}
+
+void CachingStorage::stop() {
+    if (mFlushTimer) {
+        mFlushTimer->cancel();
+        mFlushTimer.reset();
+    }
+    mFlushScheduled = false;
+
+    // This is our last chance to get dirty data to the backend. Queue it all
+    // up, along with any releases that were waiting on it, before stopping the
+    // backend, which completes outstanding transactions before returning.
+    flushAll();
+    FlushedCallbackList durable_cbs;
+    for(BucketDataMap::iterator it = mBuckets.begin(); it != mBuckets.end(); ) {
+        BucketData* bd = it->second;
+        if (!bd->releasing) {
+            it++;
+            continue;
+        }
+        // Dropping the bucket's data now means the flush completing won't
+        // trigger checkRelease, so this is the only release the backend sees.
+        mBackend->releaseBucket(it->first);
+        while(!bd->entries.empty())
+            removeEntry(bd, bd->entries.begin());
+        for(DurableCallbackQueue::iterator cb_it = bd->durableCallbacks.begin(); cb_it != bd->durableCallbacks.end(); cb_it++)
+            durable_cbs.push_back(cb_it->second);
+        mBuckets.erase(it++);
+        delete bd;
+    }
+
+    mBackend->stop();
+
+    // The flushes they were waiting on have been committed now
+    for(FlushedCallbackList::iterator it = durable_cbs.begin(); it != durable_cbs.end(); it++)
+        (*it)();
+}
+
+CachingStorage::BucketData* CachingStorage::getLeasedBucket(const Bucket& bucket) {
+    BucketDataMap::iterator it = mBuckets.find(bucket);
+    if (it == mBuckets.end() || !it->second->leased) return NULL;
+    return it->second;
+}
+
+void CachingStorage::leaseBucket(const Bucket& bucket) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doLeaseBucket, this, bucket),
+        "CachingStorage::doLeaseBucket"
+    );
+}
+
+void CachingStorage::doLeaseBucket(const Bucket& bucket) {
+    BucketData*& bd = mBuckets[bucket];
+    if (bd == NULL) bd = new BucketData();
+
+    // Re-leasing a bucket we're still releasing just cancels the release
+    if (bd->leased) {
+        bd->releasing = false;
+        return;
+    }
+
+    bd->leased = true;
+    mBackend->leaseBucket(bucket);
+
+    if (mPreload) {
+        mBackend->rangeRead(
+            bucket, BUCKET_START_KEY, BUCKET_END_KEY,
+            std::tr1::bind(&CachingStorage::handlePreload, this, bucket, _1, _2)
+        );
+    }
+}
+
+void CachingStorage::handlePreload(const Bucket& bucket, Result result, ReadSet* rs) {
+    BucketData* bd = getLeasedBucket(bucket);
+    if (bd == NULL) {
+        delete rs;
+        return;
+    }
+
+    if (result == SUCCESS) {
+        // Mark as complete first so evictions while filling in the data
+        // correctly mark it incomplete again.
+        bd->complete = true;
+        if (rs != NULL) {
+            for(ReadSet::iterator it = rs->begin(); it != rs->end(); it++)
+                setClean(bucket, bd, it->first, true, it->second, 0);
+        }
+    }
+    else if (result == TRANSACTION_ERROR) {
+        // Range reads report an empty range as an error, so we need to check
+        // whether the bucket is actually empty.
+        mBackend->count(
+            bucket, BUCKET_START_KEY, BUCKET_END_KEY,
+            std::tr1::bind(&CachingStorage::handlePreloadCount, this, bucket, _1, _2)
+        );
+    }
+
+    delete rs;
+}
+
+void CachingStorage::handlePreloadCount(const Bucket& bucket, Result result, int32 count) {
+    BucketData* bd = getLeasedBucket(bucket);
+    if (bd == NULL) return;
+
+    // Anything we've added in the meantime is already cached, so an empty
+    // backend means we have everything.
+    if (result == SUCCESS && count == 0)
+        bd->complete = true;
+}
+
+void CachingStorage::releaseBucket(const Bucket& bucket) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doReleaseBucket, this, bucket),
+        "CachingStorage::doReleaseBucket"
+    );
+}
+
+void CachingStorage::doReleaseBucket(const Bucket& bucket) {
+    BucketData* bd = getLeasedBucket(bucket);
+    if (bd == NULL) {
+        mBackend->releaseBucket(bucket);
+        return;
+    }
+
+    // Dirty data needs to get to the backend before we give up the lease, so
+    // flush and wait for it to complete.
+    bd->releasing = true;
+    flushBucket(bucket, bd);
+    checkRelease(bucket, bd);
+}
+
+void CachingStorage::checkRelease(const Bucket& bucket, BucketData* bd) {
+    if (!bd->releasing || bd->dirty > 0) return;
+
+    while(!bd->entries.empty())
+        removeEntry(bd, bd->entries.begin());
+    notifyDurable(bd);
+
+    mBuckets.erase(bucket);
+    delete bd;
+
+    mBackend->releaseBucket(bucket);
+}
+
+void CachingStorage::beginTransaction(const Bucket& bucket) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doBeginTransaction, this, bucket),
+        "CachingStorage::doBeginTransaction"
+    );
+}
+
+void CachingStorage::doBeginTransaction(const Bucket& bucket) {
+    // FIXME should probably throw an exception if one already exists
+    if (mTransactions.find(bucket) == mTransactions.end())
+        mTransactions[bucket] = new Transaction();
+}
+
+void CachingStorage::commitTransaction(const Bucket& bucket, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doCommitTransaction, this, bucket, cb),
+        "CachingStorage::doCommitTransaction"
+    );
+}
+
+bool CachingStorage::erase(const Bucket& bucket, const Key& key, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doOperation, this, bucket, Operation(Operation::Erase, key), cb),
+        "CachingStorage::doOperation"
+    );
+    return true;
+}
+
+bool CachingStorage::write(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doOperation, this, bucket, Operation(Operation::Write, key, Key(), value), cb),
+        "CachingStorage::doOperation"
+    );
+    return true;
+}
+
+bool CachingStorage::read(const Bucket& bucket, const Key& key, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doOperation, this, bucket, Operation(Operation::Read, key), cb),
+        "CachingStorage::doOperation"
+    );
+    return true;
+}
+
+bool CachingStorage::compare(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doOperation, this, bucket, Operation(Operation::Compare, key, Key(), value), cb),
+        "CachingStorage::doOperation"
+    );
+    return true;
+}
+
+bool CachingStorage::rangeRead(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doOperation, this, bucket, Operation(Operation::ReadRange, start, finish), cb),
+        "CachingStorage::doOperation"
+    );
+    return true;
+}
+
+bool CachingStorage::rangeErase(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doOperation, this, bucket, Operation(Operation::EraseRange, start, finish), cb),
+        "CachingStorage::doOperation"
+    );
+    return true;
+}
+
+bool CachingStorage::count(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb, const String& timestamp) {
+    mContext->mainStrand->post(
+        std::tr1::bind(&CachingStorage::doCount, this, bucket, start, finish, cb),
+        "CachingStorage::doCount"
+    );
+    return true;
+}
+
+void CachingStorage::doOperation(const Bucket& bucket, const Operation& op, const CommitCallback& cb) {
+    BucketTransactions::iterator it = mTransactions.find(bucket);
+    if (it != mTransactions.end()) {
+        it->second->push_back(op);
+        return;
+    }
+
+    // Run commit if this is a one-off transaction
+    mTransactions[bucket] = new Transaction(1, op);
+    doCommitTransaction(bucket, cb);
+}
+
+void CachingStorage::doCommitTransaction(const Bucket& bucket, const CommitCallback& cb) {
+    Transaction* trans = NULL;
+    BucketTransactions::iterator it = mTransactions.find(bucket);
+    if (it != mTransactions.end()) {
+        trans = it->second;
+        mTransactions.erase(it);
+    }
+
+    // Short cut for empty transactions.
+    if (trans == NULL || trans->empty()) {
+        delete trans;
+        ReadSet* rs = NULL;
+        if (cb) cb(SUCCESS, rs);
+        return;
+    }
+
+    BucketData* bd = getLeasedBucket(bucket);
+    Result result = SUCCESS;
+    ReadSet* rs = NULL;
+    if (bd == NULL || !tryLocalCommit(bucket, bd, *trans, &result, &rs)) {
+        forwardCommit(bucket, bd, trans, cb);
+        return;
+    }
+
+    bool wrote = false;
+    for(Transaction::iterator op_it = trans->begin(); op_it != trans->end(); op_it++) {
+        if (op_it->type == Operation::Write ||
+            op_it->type == Operation::Erase ||
+            op_it->type == Operation::EraseRange)
+            wrote = true;
+    }
+    delete trans;
+
+    // All of the transaction's changes have versions up to mVersion, so the
+    // callback can run once everything up to that version is durable. Changes
+    // made later don't hold it up.
+    if (mDurableCallbacks && wrote && result == SUCCESS && bd->dirty > 0) {
+        if (cb)
+            bd->durableCallbacks.push_back(std::make_pair(mVersion, std::tr1::bind(cb, result, rs)));
+        else
+            delete rs;
+    }
+    else {
+        if (cb)
+            cb(result, rs);
+        else
+            delete rs;
+    }
+
+    if (mPending >= mMaxDirty)
+        flushAll();
+    else
+        scheduleFlush();
+}
+
+bool CachingStorage::localValue(BucketData* bd, const Overlay& overlay, const Key& key, bool* present_out, String* value_out) {
+    Overlay::const_iterator ov_it = overlay.find(key);
+    if (ov_it != overlay.end()) {
+        *present_out = ov_it->second.first;
+        *value_out = ov_it->second.second;
+        return true;
+    }
+
+    Entry* entry = lookup(bd, key);
+    if (entry != NULL) {
+        *present_out = entry->present;
+        *value_out = entry->value;
+        return true;
+    }
+
+    if (bd->complete) {
+        *present_out = false;
+        return true;
+    }
+
+    return false;
+}
+
+void CachingStorage::localRange(BucketData* bd, const Overlay& overlay, const Key& start, const Key& finish, ReadSet* out) {
+    assert(bd->complete);
+    if (finish < start) return;
+
+    for(EntryMap::iterator it = bd->entries.lower_bound(start);
+        it != bd->entries.end() && it->first <= finish;
+        it++)
+    {
+        if (it->second.present)
+            (*out)[it->first] = it->second.value;
+    }
+
+    for(Overlay::const_iterator it = overlay.lower_bound(start);
+        it != overlay.end() && it->first <= finish;
+        it++)
+    {
+        if (it->second.first)
+            (*out)[it->first] = it->second.second;
+        else
+            out->erase(it->first);
+    }
+}
+
+bool CachingStorage::tryLocalCommit(const Bucket& bucket, BucketData* bd, const Transaction& trans, Result* result_out, ReadSet** rs_out) {
+    // Changes are accumulated in an overlay so later operations in the
+    // transaction see earlier ones, but nothing is applied unless the entire
+    // transaction succeeds.
+    Overlay overlay;
+    ReadSet* rs = new ReadSet;
+    bool success = true;
+
+    for(Transaction::const_iterator it = trans.begin(); success && it != trans.end(); it++) {
+        const Operation& op = *it;
+        switch(op.type) {
+          case Operation::Read:
+          case Operation::Compare:
+              {
+                  bool present = false;
+                  String value;
+                  if (!localValue(bd, overlay, op.key, &present, &value)) {
+                      delete rs;
+                      return false;
+                  }
+                  // Missing keys cause both reads and compares to fail
+                  if (!present)
+                      success = false;
+                  else if (op.type == Operation::Read)
+                      (*rs)[op.key] = value;
+                  else
+                      success = (value == op.value);
+              }
+            break;
+
+          case Operation::ReadRange:
+              {
+                  if (!bd->complete) {
+                      delete rs;
+                      return false;
+                  }
+                  ReadSet range;
+                  localRange(bd, overlay, op.key, op.keyEnd, &range);
+                  // Like the backends, an empty range is reported as an error
+                  if (range.empty())
+                      success = false;
+                  for(ReadSet::iterator rit = range.begin(); rit != range.end(); rit++)
+                      (*rs)[rit->first] = rit->second;
+              }
+            break;
+
+          case Operation::Write:
+            overlay[op.key] = std::make_pair(true, op.value);
+            break;
+
+          case Operation::Erase:
+            overlay[op.key] = std::make_pair(false, String());
+            break;
+
+          case Operation::EraseRange:
+              {
+                  if (!bd->complete) {
+                      delete rs;
+                      return false;
+                  }
+                  ReadSet range;
+                  localRange(bd, overlay, op.key, op.keyEnd, &range);
+                  for(ReadSet::iterator rit = range.begin(); rit != range.end(); rit++)
+                      overlay[rit->first] = std::make_pair(false, String());
+              }
+            break;
+        }
+    }
+
+    if (!success) {
+        delete rs;
+        *rs_out = NULL;
+        *result_out = TRANSACTION_ERROR;
+        return true;
+    }
+
+    for(Overlay::iterator it = overlay.begin(); it != overlay.end(); it++)
+        setLocal(bucket, bd, it->first, it->second.first, it->second.second);
+
+    if (rs->empty()) {
+        delete rs;
+        rs = NULL;
+    }
+    *rs_out = rs;
+    *result_out = SUCCESS;
+    return true;
+}
+
+void CachingStorage::forwardCommit(const Bucket& bucket, BucketData* bd, Transaction* trans, const CommitCallback& cb) {
+    SentVersions sent;
+    uint64 issued_version = mVersion;
+
+    mBackend->beginTransaction(bucket);
+    // The backend needs to see any local changes before it can evaluate the
+    // transaction, so send them along with it.
+    if (bd != NULL)
+        addPendingEntries(bucket, bd, &sent);
+
+    for(Transaction::iterator it = trans->begin(); it != trans->end(); it++) {
+        const Operation& op = *it;
+        switch(op.type) {
+          case Operation::Read:
+            mBackend->read(bucket, op.key);
+            break;
+          case Operation::ReadRange:
+            mBackend->rangeRead(bucket, op.key, op.keyEnd);
+            break;
+          case Operation::Compare:
+            mBackend->compare(bucket, op.key, op.value);
+            break;
+          case Operation::Write:
+            mBackend->write(bucket, op.key, op.value);
+            break;
+          case Operation::Erase:
+            mBackend->erase(bucket, op.key);
+            break;
+          case Operation::EraseRange:
+            mBackend->rangeErase(bucket, op.key, op.keyEnd);
+            break;
+        }
+    }
+
+    mBackend->commitTransaction(
+        bucket,
+        std::tr1::bind(&CachingStorage::handleForwardedCommit, this, bucket, issued_version, sent, trans, cb, _1, _2)
+    );
+}
+
+void CachingStorage::handleForwardedCommit(const Bucket& bucket, uint64 issued_version, SentVersions sent, Transaction* trans, const CommitCallback& cb, Result result, ReadSet* rs) {
+    BucketData* bd = getLeasedBucket(bucket);
+    if (bd != NULL && result != SUCCESS) {
+        markUnsent(bucket, bd, sent);
+    }
+    else if (bd != NULL) {
+        markFlushed(bucket, bd, sent);
+
+        // Apply the transaction's changes, unless they've been superseded by
+        // local changes made since it was forwarded.
+        for(Transaction::iterator it = trans->begin(); it != trans->end(); it++) {
+            const Operation& op = *it;
+            if (op.type == Operation::Write) {
+                setClean(bucket, bd, op.key, true, op.value, issued_version);
+            }
+            else if (op.type == Operation::Erase) {
+                setClean(bucket, bd, op.key, false, String(), issued_version);
+            }
+            else if (op.type == Operation::EraseRange && !(op.keyEnd < op.key)) {
+                KeySet erased;
+                for(EntryMap::iterator eit = bd->entries.lower_bound(op.key);
+                    eit != bd->entries.end() && eit->first <= op.keyEnd;
+                    eit++)
+                    erased.insert(eit->first);
+                for(KeySet::iterator kit = erased.begin(); kit != erased.end(); kit++)
+                    setClean(bucket, bd, *kit, false, String(), issued_version);
+            }
+        }
+
+        // And cache anything we read that we didn't already know about
+        if (rs != NULL) {
+            for(ReadSet::iterator it = rs->begin(); it != rs->end(); it++)
+                setClean(bucket, bd, it->first, true, it->second, 0);
+        }
+
+        notifyDurable(bd);
+    }
+    delete trans;
+
+    if (cb)
+        cb(result, rs);
+    else
+        delete rs;
+
+    if (bd != NULL)
+        checkRelease(bucket, bd);
+}
+
+void CachingStorage::addPendingEntries(const Bucket& bucket, BucketData* bd, SentVersions* sent) {
+    for(KeySet::iterator it = bd->pending.begin(); it != bd->pending.end(); it++) {
+        EntryMap::iterator eit = bd->entries.find(*it);
+        assert(eit != bd->entries.end());
+        Entry& entry = eit->second;
+
+        if (entry.present)
+            mBackend->write(bucket, *it, entry.value);
+        else
+            mBackend->erase(bucket, *it);
+        entry.sent = entry.version;
+        sent->push_back(std::make_pair(*it, entry.version));
+    }
+    mPending -= bd->pending.size();
+    bd->pending.clear();
+}
+
+void CachingStorage::markFlushed(const Bucket& bucket, BucketData* bd, const SentVersions& sent) {
+    for(SentVersions::const_iterator it = sent.begin(); it != sent.end(); it++) {
+        EntryMap::iterator eit = bd->entries.find(it->first);
+        if (eit == bd->entries.end()) continue;
+        Entry& entry = eit->second;
+
+        if (it->second <= entry.flushed) continue;
+        bool was_dirty = entry.dirty();
+        entry.flushed = it->second;
+        if (was_dirty && !entry.dirty()) {
+            bd->dirty--;
+            clearUnflushed(bd, entry);
+        }
+        else if (entry.dirty() && entry.unflushed <= entry.flushed) {
+            // Only versions after the confirmed one are still outstanding
+            setUnflushed(bd, entry, entry.flushed + 1);
+        }
+
+        // Clean erases carry no information in a complete bucket
+        if (!entry.dirty() && !entry.present && bd->complete)
+            removeEntry(bd, eit);
+    }
+
+    notifyDurable(bd);
+}
+
+void CachingStorage::markUnsent(const Bucket& bucket, BucketData* bd, const SentVersions& sent) {
+    for(SentVersions::const_iterator it = sent.begin(); it != sent.end(); it++) {
+        EntryMap::iterator eit = bd->entries.find(it->first);
+        if (eit == bd->entries.end()) continue;
+        Entry& entry = eit->second;
+
+        // If it has been modified since, it's already pending again
+        if (entry.sent != it->second || !entry.dirty()) continue;
+        entry.sent = entry.flushed;
+        if (bd->pending.insert(it->first).second)
+            mPending++;
+    }
+    scheduleFlush();
+}
+
+void CachingStorage::notifyDurable(BucketData* bd) {
+    // Collect callbacks first since they may issue new requests
+    FlushedCallbackList cbs;
+    while(!bd->durableCallbacks.empty() &&
+        (bd->unflushed.empty() || bd->durableCallbacks.front().first < *(bd->unflushed.begin())))
+    {
+        cbs.push_back(bd->durableCallbacks.front().second);
+        bd->durableCallbacks.pop_front();
+    }
+    for(FlushedCallbackList::iterator it = cbs.begin(); it != cbs.end(); it++)
+        (*it)();
+}
+
+void CachingStorage::setUnflushed(BucketData* bd, Entry& entry, uint64 version) {
+    if (entry.unflushed != 0)
+        clearUnflushed(bd, entry);
+    entry.unflushed = version;
+    bd->unflushed.insert(version);
+}
+
+void CachingStorage::clearUnflushed(BucketData* bd, Entry& entry) {
+    VersionSet::iterator it = bd->unflushed.find(entry.unflushed);
+    assert(it != bd->unflushed.end());
+    bd->unflushed.erase(it);
+    entry.unflushed = 0;
+}
+
+
+
+
+CachingStorage::Entry* CachingStorage::lookup(BucketData* bd, const Key& key) {
+    EntryMap::iterator it = bd->entries.find(key);
+    if (it == bd->entries.end()) return NULL;
+
+    mLRU.splice(mLRU.begin(), mLRU, it->second.lru);
+    return &(it->second);
+}
+
+void CachingStorage::setLocal(const Bucket& bucket, BucketData* bd, const Key& key, bool present, const String& value) {
+    EntryMap::iterator it = bd->entries.find(key);
+    if (it == bd->entries.end()) {
+        it = bd->entries.insert(std::make_pair(key, Entry())).first;
+        it->second.lru = mLRU.insert(mLRU.begin(), std::make_pair(bucket, key));
+        mEntries++;
+    }
+    else {
+        mLRU.splice(mLRU.begin(), mLRU, it->second.lru);
+    }
+
+    Entry& entry = it->second;
+    bool was_dirty = entry.dirty();
+    entry.value = value;
+    entry.present = present;
+    entry.version = ++mVersion;
+    if (!was_dirty) {
+        bd->dirty++;
+        setUnflushed(bd, entry, entry.version);
+    }
+    if (bd->pending.insert(key).second)
+        mPending++;
+
+    evict();
+}
+
+void CachingStorage::setClean(const Bucket& bucket, BucketData* bd, const Key& key, bool present, const String& value, uint64 max_version) {
+    EntryMap::iterator it = bd->entries.find(key);
+    if (it == bd->entries.end()) {
+        // No need to remember missing keys in complete buckets
+        if (!present && bd->complete) return;
+
+        it = bd->entries.insert(std::make_pair(key, Entry())).first;
+        it->second.lru = mLRU.insert(mLRU.begin(), std::make_pair(bucket, key));
+        mEntries++;
+    }
+    else {
+        mLRU.splice(mLRU.begin(), mLRU, it->second.lru);
+        if (it->second.version > max_version) return;
+    }
+
+    Entry& entry = it->second;
+    if (entry.dirty()) {
+        bd->dirty--;
+        clearUnflushed(bd, entry);
+    }
+    if (bd->pending.erase(key) > 0)
+        mPending--;
+    entry.value = value;
+    entry.present = present;
+    entry.version = entry.sent = entry.flushed = ++mVersion;
+
+    evict();
+}
+
+void CachingStorage::removeEntry(BucketData* bd, EntryMap::iterator it) {
+    Entry& entry = it->second;
+    if (entry.dirty()) {
+        bd->dirty--;
+        clearUnflushed(bd, entry);
+    }
+    if (bd->pending.erase(it->first) > 0)
+        mPending--;
+    mLRU.erase(entry.lru);
+    bd->entries.erase(it);
+    mEntries--;
+}
+
+void CachingStorage::evict() {
+    // Work back from the least recently used entry, skipping dirty entries,
+    // which can't be dropped until they reach the backend.
+    LRUList::iterator it = mLRU.end();
+    while(mEntries > mMaxEntries && it != mLRU.begin()) {
+        LRUList::iterator cur = it;
+        cur--;
+
+        BucketData* bd = mBuckets[cur->first];
+        EntryMap::iterator eit = bd->entries.find(cur->second);
+        assert(eit != bd->entries.end());
+        if (eit->second.dirty()) {
+            it = cur;
+            continue;
+        }
+
+        bd->complete = false;
+        removeEntry(bd, eit);
+    }
+}
+
+void CachingStorage::doCount(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb) {
+    BucketData* bd = getLeasedBucket(bucket);
+    if (bd != NULL && bd->complete) {
+        ReadSet range;
+        localRange(bd, Overlay(), start, finish, &range);
+        if (cb) cb(SUCCESS, (int32)range.size());
+        return;
+    }
+
+    // Counts don't fit into transactions, so local changes need to be flushed
+    // before the backend can count for us.
+    if (bd != NULL && bd->dirty > 0) {
+        flushBucket(
+            bucket, bd,
+            std::tr1::bind(&Storage::count, mBackend, bucket, start, finish, cb, "current")
+        );
+        return;
+    }
+
+    mBackend->count(bucket, start, finish, cb);
+}
+
+void CachingStorage::scheduleFlush() {
+    if (mFlushScheduled || mPending == 0 || !mFlushTimer) return;
+
+    mFlushScheduled = true;
+    mFlushTimer->wait(mFlushInterval);
+}
+
+void CachingStorage::handleFlushTimer() {
+    mFlushScheduled = false;
+    flushAll();
+}
+
+void CachingStorage::flushAll() {
+    if (mPending == 0) return;
+
+    for(BucketDataMap::iterator it = mBuckets.begin(); it != mBuckets.end(); it++)
+        flushBucket(it->first, it->second);
+}
+
+void CachingStorage::flushBucket(const Bucket& bucket, BucketData* bd, const FlushedCallback& then) {
+    // Anything not pending has already been sent and will be committed before
+    // anything we submit now.
+    if (bd->pending.empty()) {
+        if (then) then();
+        return;
+    }
+
+    SentVersions sent;
+    mBackend->beginTransaction(bucket);
+    addPendingEntries(bucket, bd, &sent);
+    mBackend->commitTransaction(
+        bucket,
+        std::tr1::bind(&CachingStorage::handleFlush, this, bucket, sent, then, _1, _2)
+    );
+}
+
+void CachingStorage::handleFlush(const Bucket& bucket, SentVersions sent, FlushedCallback then, Result result, ReadSet* rs) {
+    delete rs;
+
+    BucketData* bd = getLeasedBucket(bucket);
+    if (bd != NULL) {
+        if (result == SUCCESS) {
+            markFlushed(bucket, bd, sent);
+        }
+        else {
+            SILOG(cache-storage, warn, "Failed to flush " << sent.size() << " keys for bucket " << bucket << ", will retry.");
+            markUnsent(bucket, bd, sent);
+        }
+        checkRelease(bucket, bd);
+    }
+
+    if (then) then();
+}
+
+} // namespace OH
+} // namespace Sirikata
@@ -0,0 +1,234 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_OH_CACHING_STORAGE_HPP_
+#define _SIRIKATA_OH_CACHING_STORAGE_HPP_
+
+#include <sirikata/oh/Storage.hpp>
+#include <sirikata/core/network/IOTimer.hpp>
+
+namespace Sirikata {
+namespace OH {
+
+/** CachingStorage is a write-behind decorator for another Storage
+ *  implementation. While a bucket is leased, it keeps an in-memory copy of the
+ *  bucket's keys, answers reads, range reads and counts from memory when it
+ *  can, coalesces repeated writes to the same key and flushes them to the
+ *  wrapped backend in the background. Buckets which aren't leased are passed
+ *  straight through to the backend.
+ *
+ *  Durability is bounded by two settings: dirty data is never held in memory
+ *  longer than the flush interval, and a flush is forced as soon as the number
+ *  of dirty keys reaches a limit. If durable callbacks are requested, commit
+ *  callbacks for transactions containing writes are held until the data has
+ *  actually been committed to the backend. Otherwise they are invoked as soon
+ *  as the transaction has been applied to the cache.
+ *
+ *  All state is managed on the ObjectHostContext's main strand, the same
+ *  strand the backends deliver their callbacks on, so no locking is required.
+ *  Requests are posted to the main strand in order, so they keep the ordering
+ *  the caller issued them in.
+ */
+class CachingStorage : public Storage
+{
+public:
+    CachingStorage(ObjectHostContext* ctx, Storage* backend, uint32 max_entries, uint32 max_dirty, const Duration& flush_interval, bool preload, bool durable_callbacks);
+    ~CachingStorage();
+
+    virtual void start();
+    virtual void stop();
+
+    virtual void leaseBucket(const Bucket& bucket);
+    virtual void releaseBucket(const Bucket& bucket);
+
+    virtual void beginTransaction(const Bucket& bucket);
+
+    virtual void commitTransaction(const Bucket& bucket, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool erase(const Bucket& bucket, const Key& key, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool write(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool read(const Bucket& bucket, const Key& key, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool compare(const Bucket& bucket, const Key& key, const String& value, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool rangeRead(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool rangeErase(const Bucket& bucket, const Key& start, const Key& finish, const CommitCallback& cb = 0, const String& timestamp="current");
+    virtual bool count(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb = 0, const String& timestamp="current");
+
+private:
+    // Operations are queued up per bucket, just like the backends do, and are
+    // either applied to the cache or forwarded to the backend on commit.
+    struct Operation {
+        enum Type {
+            Read,
+            ReadRange,
+            Compare,
+            Write,
+            Erase,
+            EraseRange
+        };
+
+        Operation(Type t, const Key& k, const Key& kend = Key(), const String& v = String())
+         : type(t), key(k), keyEnd(kend), value(v)
+        {}
+
+        Type type;
+        Key key;
+        Key keyEnd; // Only relevant for *Range
+        String value; // Only relevant for Write and Compare
+    };
+    typedef std::vector<Operation> Transaction;
+    typedef std::tr1::unordered_map<Bucket, Transaction*, Bucket::Hasher> BucketTransactions;
+
+    // LRU order over all cached keys in all buckets. The front is the most
+    // recently used.
+    typedef std::list< std::pair<Bucket, Key> > LRUList;
+
+    // A cached value. Erased keys are kept as entries with present == false
+    // until the erase has been flushed. Versions are taken from a global
+    // counter on each modification. An entry is dirty until the backend has
+    // confirmed a commit of its current version and it can only be evicted
+    // once it is clean.
+    struct Entry {
+        Entry()
+         : value(), present(false), version(0), sent(0), flushed(0), unflushed(0)
+        {}
+
+        bool dirty() const { return flushed < version; }
+
+        String value;
+        bool present;
+        // Current version, last version sent to the backend, and last version
+        // the backend confirmed.
+        uint64 version;
+        uint64 sent;
+        uint64 flushed;
+        // While dirty, a lower bound on the oldest version of this entry the
+        // backend hasn't confirmed yet.
+        uint64 unflushed;
+        LRUList::iterator lru;
+    };
+    typedef std::map<Key, Entry> EntryMap;
+    typedef std::set<Key> KeySet;
+    // Values as seen by an in-progress local transaction, (present, value)
+    typedef std::map<Key, std::pair<bool, String> > Overlay;
+
+    typedef std::tr1::function<void()> FlushedCallback;
+    typedef std::vector<FlushedCallback> FlushedCallbackList;
+    // Durable callbacks, each with the version it waits for, in version order
+    typedef std::deque< std::pair<uint64, FlushedCallback> > DurableCallbackQueue;
+    typedef std::multiset<uint64> VersionSet;
+    typedef std::vector< std::pair<Key, uint64> > SentVersions;
+
+    struct BucketData {
+        BucketData()
+         : leased(false),
+           complete(false),
+           releasing(false),
+           dirty(0)
+        {}
+
+        EntryMap entries;
+        // Whether we hold a lease, i.e. whether we may answer from memory.
+        bool leased;
+        // Whether entries holds the entire contents of the bucket, in which
+        // case misses and ranges can be answered from memory.
+        bool complete;
+        // Whether releaseBucket was called and we're waiting for dirty data
+        // to reach the backend before releasing the backend's lease.
+        bool releasing;
+        // Number of dirty entries, and the subset of keys which have been
+        // modified since they were last sent to the backend.
+        uint32 dirty;
+        KeySet pending;
+        // Entry::unflushed for each dirty entry. Every version below the
+        // smallest one has reached the backend.
+        VersionSet unflushed;
+        // Durable commit callbacks, invoked once every version up to the one
+        // they wait for has reached the backend
+        DurableCallbackQueue durableCallbacks;
+    };
+    typedef std::tr1::unordered_map<Bucket, BucketData*, Bucket::Hasher> BucketDataMap;
+
+    // Main strand implementations of the public interface
+    void doLeaseBucket(const Bucket& bucket);
+    void doReleaseBucket(const Bucket& bucket);
+    void doBeginTransaction(const Bucket& bucket);
+    void doCommitTransaction(const Bucket& bucket, const CommitCallback& cb);
+    void doOperation(const Bucket& bucket, const Operation& op, const CommitCallback& cb);
+    void doCount(const Bucket& bucket, const Key& start, const Key& finish, const CountCallback& cb);
+
+    // Get the cached data for the bucket if it's leased, or NULL
+    BucketData* getLeasedBucket(const Bucket& bucket);
+
+    // Try to evaluate a transaction entirely from memory. Returns false if the
+    // transaction touches data that isn't cached. Otherwise, fills in the
+    // result and read set and, if successful, applies the changes.
+    bool tryLocalCommit(const Bucket& bucket, BucketData* bd, const Transaction& trans, Result* result_out, ReadSet** rs_out);
+    // Get a key's value as seen by a local transaction, returning false if it
+    // isn't known.
+    bool localValue(BucketData* bd, const Overlay& overlay, const Key& key, bool* present_out, String* value_out);
+    // Collect present keys in [start, finish] as seen by a local transaction.
+    // Only valid for complete buckets.
+    void localRange(BucketData* bd, const Overlay& overlay, const Key& start, const Key& finish, ReadSet* out);
+
+    // Forward a transaction to the backend, updating the cache when it
+    // completes.
+    void forwardCommit(const Bucket& bucket, BucketData* bd, Transaction* trans, const CommitCallback& cb);
+    void handleForwardedCommit(const Bucket& bucket, uint64 issued_version, SentVersions sent, Transaction* trans, const CommitCallback& cb, Result result, ReadSet* rs);
+    // Adds all pending entries of the bucket to the backend's current
+    // transaction, recording which versions were sent.
+    void addPendingEntries(const Bucket& bucket, BucketData* bd, SentVersions* sent);
+    // Update entries after the backend confirmed or failed a commit which
+    // included the given versions.
+    void markFlushed(const Bucket& bucket, BucketData* bd, const SentVersions& sent);
+    void markUnsent(const Bucket& bucket, BucketData* bd, const SentVersions& sent);
+    void notifyDurable(BucketData* bd);
+    // Track the oldest unflushed version of dirty entries
+    void setUnflushed(BucketData* bd, Entry& entry, uint64 version);
+    void clearUnflushed(BucketData* bd, Entry& entry);
+
+    // Cache manipulation
+    Entry* lookup(BucketData* bd, const Key& key);
+    // Apply a local modification, making the entry dirty
+    void setLocal(const Bucket& bucket, BucketData* bd, const Key& key, bool present, const String& value);
+    // Store a value known to match the backend. Existing entries are only
+    // replaced if their version is no newer than max_version.
+    void setClean(const Bucket& bucket, BucketData* bd, const Key& key, bool present, const String& value, uint64 max_version);
+    void removeEntry(BucketData* bd, EntryMap::iterator it);
+    void evict();
+
+    // Preloading whole buckets
+    void handlePreload(const Bucket& bucket, Result result, ReadSet* rs);
+    void handlePreloadCount(const Bucket& bucket, Result result, int32 count);
+
+    // Flushing
+    void scheduleFlush();
+    void handleFlushTimer();
+    void flushAll();
+    void flushBucket(const Bucket& bucket, BucketData* bd, const FlushedCallback& then = 0);
+    void handleFlush(const Bucket& bucket, SentVersions sent, FlushedCallback then, Result result, ReadSet* rs);
+    void checkRelease(const Bucket& bucket, BucketData* bd);
+
+    ObjectHostContext* mContext;
+    Storage* mBackend;
+
+    BucketTransactions mTransactions;
+    BucketDataMap mBuckets;
+    LRUList mLRU;
+    uint32 mEntries;
+    uint32 mPending;
+    uint64 mVersion;
+
+    const uint32 mMaxEntries;
+    const uint32 mMaxDirty;
+    const Duration mFlushInterval;
+    const bool mPreload;
+    const bool mDurableCallbacks;
+
+    Network::IOTimerPtr mFlushTimer;
+    bool mFlushScheduled;
+};
+
+} // namespace OH
+} // namespace Sirikata
+
+#endif //_SIRIKATA_OH_CACHING_STORAGE_HPP_
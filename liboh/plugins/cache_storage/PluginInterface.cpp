@@ -0,0 +1,77 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/oh/Platform.hpp>
+#include <sirikata/core/options/Options.hpp>
+#include "CachingStorage.hpp"
+
+static int oh_cache_storage_plugin_refcount = 0;
+
+namespace Sirikata {
+
+static void InitPluginOptions() {
+    Sirikata::InitializeClassOptions ico("cachestorage",NULL,
+        new Sirikata::OptionValue("backend", "sqlite", Sirikata::OptionValueType<String>(), "Type of storage to cache. The plugin providing it must also be loaded."),
+        new Sirikata::OptionValue("backend-options", "", Sirikata::OptionValueType<String>(), "Options to pass to the backend storage constructor, e.g. --backend-options=\"--db=storage.db\"."),
+        new Sirikata::OptionValue("max-entries", "100000", Sirikata::OptionValueType<uint32>(), "Maximum number of keys to keep in memory across all buckets. Entries which haven't been flushed yet are never evicted, so this can be exceeded temporarily."),
+        new Sirikata::OptionValue("max-dirty", "1000", Sirikata::OptionValueType<uint32>(), "Number of modified keys waiting to be sent to the backend which forces an immediate flush."),
+        new Sirikata::OptionValue("flush-interval", "1s", Sirikata::OptionValueType<Duration>(), "Maximum time a modification is held in memory before it is flushed to the backend."),
+        new Sirikata::OptionValue("preload", "true", Sirikata::OptionValueType<bool>(), "If true, load the entire contents of a bucket when it is leased so misses, range reads and counts can be answered from memory."),
+        new Sirikata::OptionValue("durable-callbacks", "false", Sirikata::OptionValueType<bool>(), "If true, callbacks for transactions that modify data are only invoked once the data has been committed to the backend. Otherwise they are invoked as soon as the cache has been updated."),
+        NULL);
+}
+
+static OH::Storage* createCachingStorage(ObjectHostContext* ctx, const String& args) {
+    OptionSet* optionsSet = OptionSet::getOptions("cachestorage",NULL);
+    optionsSet->parse(args);
+
+    String backend_type = optionsSet->referenceOption("backend")->as<String>();
+    String backend_options = optionsSet->referenceOption("backend-options")->as<String>();
+    uint32 max_entries = optionsSet->referenceOption("max-entries")->as<uint32>();
+    uint32 max_dirty = optionsSet->referenceOption("max-dirty")->as<uint32>();
+    Duration flush_interval = optionsSet->referenceOption("flush-interval")->as<Duration>();
+    bool preload = optionsSet->referenceOption("preload")->as<bool>();
+    bool durable_callbacks = optionsSet->referenceOption("durable-callbacks")->as<bool>();
+
+    OH::Storage* backend =
+        OH::StorageFactory::getSingleton().getConstructor(backend_type)(ctx, backend_options);
+
+    return new OH::CachingStorage(ctx, backend, max_entries, max_dirty, flush_interval, preload, durable_callbacks);
+}
+
+} // namespace Sirikata
+
+SIRIKATA_PLUGIN_EXPORT_C void init() {
+    using namespace Sirikata;
+    if (oh_cache_storage_plugin_refcount==0) {
+        InitPluginOptions();
+        OH::StorageFactory::getSingleton()
+            .registerConstructor("cache",
+                                 std::tr1::bind(&createCachingStorage, std::tr1::placeholders::_1, std::tr1::placeholders::_2));
+    }
+    oh_cache_storage_plugin_refcount++;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int increfcount() {
+    return ++oh_cache_storage_plugin_refcount;
+}
+SIRIKATA_PLUGIN_EXPORT_C int decrefcount() {
+    assert(oh_cache_storage_plugin_refcount>0);
+    return --oh_cache_storage_plugin_refcount;
+}
+
+SIRIKATA_PLUGIN_EXPORT_C void destroy() {
+    using namespace Sirikata;
+    if (oh_cache_storage_plugin_refcount==0) {
+        OH::StorageFactory::getSingleton().unregisterConstructor("cache");
+    }
+}
+
+SIRIKATA_PLUGIN_EXPORT_C const char* name() {
+    return "oh-cache-storage";
+}
+
+SIRIKATA_PLUGIN_EXPORT_C int refcount() {
+    return oh_cache_storage_plugin_refcount;
+}
@@ -37,13 +37,28 @@
 
 namespace Sirikata {
 
-CSVObjectFactory::CSVObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const std::list<String>& search_paths, const String& filename, int32 max_objects, int32 connect_rate)
+CSVObjectFactory::CSVObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const std::list<String>& search_paths, const String& filename, int32 max_objects, int32 connect_rate, const Duration& target_latency)
  : mContext(ctx),
    mOH(oh),
    mSpace(space),
    mFilename(),
    mMaxObjects(max_objects),
-   mConnectRate(connect_rate)
+   mCount(0),
+   mObjTypeIdx(-1),
+   mPosIdx(-1),
+   mOrientIdx(-1),
+   mVelIdx(-1),
+   mMeshIdx(-1),
+   mQuatVelIdx(-1),
+   mScriptTypeIdx(-1),
+   mScriptOptsIdx(-1),
+   mScriptContentsIdx(-1),
+   mScaleIdx(-1),
+   mObjIDIdx(-1),
+   mQueryIdx(-1),
+   mPhysicsOptsIdx(-1),
+   mPacer(ctx, oh, space, (uint32)std::max(connect_rate, (int32)1), target_latency,
+       std::tr1::bind(&CSVObjectFactory::connectObjects, this, std::tr1::placeholders::_1))
 {
     using namespace boost::filesystem;
 
@@ -154,211 +169,174 @@ void CSVObjectFactory::generate(const String& timestamp)
 {
     if (mFilename.empty()) return;
 
-    int count =0;
-    std::ifstream fp(mFilename.c_str());
-    if (!fp) return;
-
-
-    bool is_first = true;
-    int objtype_idx = -1;
-    int pos_idx = -1;
-    int orient_idx = -1;
-    int vel_idx = -1;
-    int mesh_idx = -1;
-
-    int quat_vel_idx = -1;
-    int script_type_idx = -1;
-    int script_opts_idx = -1;
-    int script_contents_idx = -1;
-    int scale_idx = -1;
-    int objid_idx = -1;
-    int query_idx = -1;
-    int physics_opts_idx = -1;
-
-    // For each line
-    while(fp && (count < mMaxObjects))
-    {
+    mFile.open(mFilename.c_str());
+    if (!mFile) return;
+
+    readHeader();
+    mPacer.start();
+}
+
+bool CSVObjectFactory::readLine(CSVObjectFactory::StringList* line_parts_out) {
+    while(mFile) {
         String line;
-        std::getline(fp, line);
+        std::getline(mFile, line);
         // First char is # and not the first non whitespace char
 	// then this is a comment
         if(line.length() > 0 && line.at(0) == '#')
         {
             continue;
         }
-
+        if (line.empty())
+            continue;
 
         // Split into parts by commas
-        CSVObjectFactory::StringList line_parts = sepCommas(line);
-
-        if (is_first) {
-            for(uint32 idx = 0; idx < line_parts.size(); idx++)
-            {
-
-                if (line_parts[idx] == "objtype") objtype_idx = idx;
-                if (line_parts[idx] == "pos_x") pos_idx = idx;
-                if (line_parts[idx] == "orient_x") orient_idx = idx;
-                if (line_parts[idx] == "vel_x") vel_idx = idx;
-                if (line_parts[idx] == "meshURI") mesh_idx = idx;
-                if (line_parts[idx] == "rot_axis_x") quat_vel_idx = idx;
-                if (line_parts[idx] == "script_type") script_type_idx = idx;
-                if (line_parts[idx] == "script_options") script_opts_idx = idx;
-                if (line_parts[idx] == "script_contents") script_contents_idx = idx;
-                if (line_parts[idx] == "scale") scale_idx = idx;
-                if(line_parts[idx] == "objid")
-                {
-                    objid_idx = idx;
-                }
-                if(line_parts[idx] == "query") query_idx = idx;
-                if (line_parts[idx] == "physics") physics_opts_idx = idx;
-            }
+        *line_parts_out = sepCommas(line);
+        return true;
+    }
+    return false;
+}
 
-            is_first = false;
-        }
-        else {
-            //note: script_file is not required, so not checking it with the assert
-            assert(objtype_idx != -1 && pos_idx != -1 && mesh_idx != -1);
-            //assert(objtype_idx != -1 && pos_idx != -1 && mesh_idx != -1);
-
-            if (line_parts[objtype_idx] == "mesh") {
-                Vector3d pos(
-                    safeLexicalCast<double>(line_parts[pos_idx+0]),
-                    safeLexicalCast<double>(line_parts[pos_idx+1]),
-                    safeLexicalCast<double>(line_parts[pos_idx+2])
-                );
-                Quaternion orient =
-                    orient_idx == -1 ?
-                    Quaternion(0, 0, 0, 1) :
-                    Quaternion(
-                        safeLexicalCast<float>(line_parts[orient_idx+0]),
-                        safeLexicalCast<float>(line_parts[orient_idx+1]),
-                        safeLexicalCast<float>(line_parts[orient_idx+2]),
-                        safeLexicalCast<float>(line_parts[orient_idx+3]),
-                        Quaternion::XYZW()
-                    );
-                Vector3f vel =
-                    vel_idx == -1 ?
-                    Vector3f(0, 0, 0) :
-                    Vector3f(
-                        safeLexicalCast<float>(line_parts[vel_idx+0]),
-                        safeLexicalCast<float>(line_parts[vel_idx+1]),
-                        safeLexicalCast<float>(line_parts[vel_idx+2])
-                    );
-
-                Vector3f rot_axis =
-                    quat_vel_idx == -1 ?
-                    Vector3f(0, 0, 0) :
-                    Vector3f(
-                        safeLexicalCast<float>(line_parts[quat_vel_idx+0]),
-                        safeLexicalCast<float>(line_parts[quat_vel_idx+1]),
-                        safeLexicalCast<float>(line_parts[quat_vel_idx+2])
-                    );
-
-                float angular_speed =
-                    quat_vel_idx == -1 ?
-                    0 :
-                    safeLexicalCast<float>(line_parts[quat_vel_idx+3]);
-
-                String mesh( line_parts[mesh_idx] );
-
-                String scriptType = "";
-                String scriptOpts = "";
-                String scriptContents = "";
-
-              	if(script_type_idx != -1)
-                {
-                    scriptType = line_parts[script_type_idx];
-                }
-                if(script_opts_idx != -1)
-                {
-                    scriptOpts = line_parts[script_opts_idx];
-                }
-                if(script_contents_idx != -1)
-                {
-                    scriptContents = line_parts[script_contents_idx];
-                }
-
-                float scale =
-                    scale_idx == -1 ?
-                    1.f :
-                    safeLexicalCast<float>(line_parts[scale_idx], 1.f);
-
-                String query_opts =
-                    query_idx == -1 ?
-                    "" :
-                    line_parts[query_idx];
-
-                String physics_opts =
-                    physics_opts_idx == -1 ?
-                    "" :
-                    line_parts[physics_opts_idx];
-
-                /*
-
-                  Ticket #134
-
-                */
-                String objid = "";
-                if(objid_idx != -1)
-                {
-                    objid = line_parts[objid_idx];
-                }
-
-                HostedObjectPtr obj;
-
-                if (objid_idx != -1) {
-                    obj = mOH->createObject(
-                        UUID(objid, UUID::HumanReadable()),
-                        scriptType, scriptOpts, scriptContents
-                    );
-                }
-                else {
-                    obj = mOH->createObject(scriptType, scriptOpts, scriptContents);
-                }
-
-                ObjectConnectInfo oci;
-                oci.object = obj;
-                oci.loc = Location( pos, orient, vel, rot_axis, angular_speed);
-                oci.bounds = BoundingSphere3f(Vector3f::zero(), scale);
-                oci.mesh = mesh;
-                oci.query = query_opts;
-                oci.physics = physics_opts;
-                mIncompleteObjects.push(oci);
-
-                count++;
-            }
+void CSVObjectFactory::readHeader() {
+    CSVObjectFactory::StringList line_parts;
+    if (!readLine(&line_parts))
+        return;
+
+    for(uint32 idx = 0; idx < line_parts.size(); idx++)
+    {
+        if (line_parts[idx] == "objtype") mObjTypeIdx = idx;
+        if (line_parts[idx] == "pos_x") mPosIdx = idx;
+        if (line_parts[idx] == "orient_x") mOrientIdx = idx;
+        if (line_parts[idx] == "vel_x") mVelIdx = idx;
+        if (line_parts[idx] == "meshURI") mMeshIdx = idx;
+        if (line_parts[idx] == "rot_axis_x") mQuatVelIdx = idx;
+        if (line_parts[idx] == "script_type") mScriptTypeIdx = idx;
+        if (line_parts[idx] == "script_options") mScriptOptsIdx = idx;
+        if (line_parts[idx] == "script_contents") mScriptContentsIdx = idx;
+        if (line_parts[idx] == "scale") mScaleIdx = idx;
+        if (line_parts[idx] == "objid") mObjIDIdx = idx;
+        if (line_parts[idx] == "query") mQueryIdx = idx;
+        if (line_parts[idx] == "physics") mPhysicsOptsIdx = idx;
+    }
+}
+
+bool CSVObjectFactory::connectObjects(uint32 count) {
+    uint32 connected = 0;
+    CSVObjectFactory::StringList line_parts;
+    while(connected < count && mCount < mMaxObjects && readLine(&line_parts)) {
+        //note: script_file is not required, so not checking it with the assert
+        assert(mObjTypeIdx != -1 && mPosIdx != -1 && mMeshIdx != -1);
+
+        if (line_parts[mObjTypeIdx] == "mesh") {
+            connectObject(line_parts);
+            connected++;
+            mCount++;
         }
     }
 
-    SILOG(csvfactory, detailed, "Generated " << count << " objects from " << mFilename);
+    if (connected == count && mCount < mMaxObjects)
+        return true;
 
-    fp.close();
-    connectObjects();
-    return;
+    SILOG(csvfactory, detailed, "Generated " << mCount << " objects from " << mFilename);
+    mFile.close();
+    return false;
 }
 
+void CSVObjectFactory::connectObject(const CSVObjectFactory::StringList& line_parts) {
+    Vector3d pos(
+        safeLexicalCast<double>(line_parts[mPosIdx+0]),
+        safeLexicalCast<double>(line_parts[mPosIdx+1]),
+        safeLexicalCast<double>(line_parts[mPosIdx+2])
+    );
+    Quaternion orient =
+        mOrientIdx == -1 ?
+        Quaternion(0, 0, 0, 1) :
+        Quaternion(
+            safeLexicalCast<float>(line_parts[mOrientIdx+0]),
+            safeLexicalCast<float>(line_parts[mOrientIdx+1]),
+            safeLexicalCast<float>(line_parts[mOrientIdx+2]),
+            safeLexicalCast<float>(line_parts[mOrientIdx+3]),
+            Quaternion::XYZW()
+        );
+    Vector3f vel =
+        mVelIdx == -1 ?
+        Vector3f(0, 0, 0) :
+        Vector3f(
+            safeLexicalCast<float>(line_parts[mVelIdx+0]),
+            safeLexicalCast<float>(line_parts[mVelIdx+1]),
+            safeLexicalCast<float>(line_parts[mVelIdx+2])
+        );
 
-void CSVObjectFactory::connectObjects()
-{
-    if (mContext->stopped())
-        return;
+    Vector3f rot_axis =
+        mQuatVelIdx == -1 ?
+        Vector3f(0, 0, 0) :
+        Vector3f(
+            safeLexicalCast<float>(line_parts[mQuatVelIdx+0]),
+            safeLexicalCast<float>(line_parts[mQuatVelIdx+1]),
+            safeLexicalCast<float>(line_parts[mQuatVelIdx+2])
+        );
 
-    for(int32 i = 0; i < mConnectRate && !mIncompleteObjects.empty(); i++) {
-        ObjectConnectInfo oci = mIncompleteObjects.front();
-        mIncompleteObjects.pop();
+    float angular_speed =
+        mQuatVelIdx == -1 ?
+        0 :
+        safeLexicalCast<float>(line_parts[mQuatVelIdx+3]);
 
-        oci.object->connect(
-            mSpace,
-            oci.loc, oci.bounds, oci.mesh, oci.physics, oci.query
-        );
+    String mesh( line_parts[mMeshIdx] );
+
+    String scriptType = "";
+    String scriptOpts = "";
+    String scriptContents = "";
+
+    if(mScriptTypeIdx != -1)
+    {
+        scriptType = line_parts[mScriptTypeIdx];
+    }
+    if(mScriptOptsIdx != -1)
+    {
+        scriptOpts = line_parts[mScriptOptsIdx];
+    }
+    if(mScriptContentsIdx != -1)
+    {
+        scriptContents = line_parts[mScriptContentsIdx];
     }
 
-    if (!mIncompleteObjects.empty())
-        mContext->mainStrand->post(
-            Duration::seconds(1.f),
-            std::tr1::bind(&CSVObjectFactory::connectObjects, this),
-            "CSVObjectFactory::connectObjects"
+    float scale =
+        mScaleIdx == -1 ?
+        1.f :
+        safeLexicalCast<float>(line_parts[mScaleIdx], 1.f);
+
+    String query_opts =
+        mQueryIdx == -1 ?
+        "" :
+        line_parts[mQueryIdx];
+
+    String physics_opts =
+        mPhysicsOptsIdx == -1 ?
+        "" :
+        line_parts[mPhysicsOptsIdx];
+
+    /*
+
+      Ticket #134
+
+    */
+    HostedObjectPtr obj;
+
+    if (mObjIDIdx != -1) {
+        obj = mOH->createObject(
+            UUID(line_parts[mObjIDIdx], UUID::HumanReadable()),
+            scriptType, scriptOpts, scriptContents
         );
+    }
+    else {
+        obj = mOH->createObject(scriptType, scriptOpts, scriptContents);
+    }
+
+    obj->connect(
+        mSpace,
+        Location( pos, orient, vel, rot_axis, angular_speed),
+        BoundingSphere3f(Vector3f::zero(), scale),
+        mesh, physics_opts, query_opts
+    );
 }
 
 }
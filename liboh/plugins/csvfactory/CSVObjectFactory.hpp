@@ -37,15 +37,21 @@
 #include <sirikata/oh/ObjectFactory.hpp>
 #include <sirikata/oh/HostedObject.hpp>
 #include <sirikata/oh/SimulationFactory.hpp>
+#include <sirikata/oh/ConnectPacer.hpp>
+#include <fstream>
 
 namespace Sirikata {
 
-/** CSVObjectFactory generates objects from an input CSV file. */
+/** CSVObjectFactory generates objects from an input CSV file. The file is
+ *  streamed: lines are only parsed and their objects created and connected
+ *  when the ConnectPacer asks for another batch, so large files neither sit in
+ *  memory nor connect in a single burst.
+ */
 class CSVObjectFactory : public ObjectFactory {
 public:
     typedef std::vector<String> StringList;
 
-    CSVObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const std::list<String>& search_paths, const String& filename, int32 max_objects, int32 connect_rate);
+    CSVObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const std::list<String>& search_paths, const String& filename, int32 max_objects, int32 connect_rate, const Duration& target_latency);
     virtual ~CSVObjectFactory() {}
 
     virtual void generate(const String& timestamp="current");
@@ -74,25 +80,42 @@ public:
     static CSVObjectFactory::StringList sepCommas(String toSep);
 
 private:
-    // Connects one batch of objects and sets up another callback for more
-    // additions if necessary.
-    void connectObjects();
+    // Reads and parses the next non-comment line, returning false at the end
+    // of the file
+    bool readLine(StringList* line_parts_out);
+    // Reads the header, recording which columns hold each field
+    void readHeader();
+    // Creates and connects up to count more objects from the file. Returns
+    // false once there are no more to connect.
+    bool connectObjects(uint32 count);
+    // Creates and connects the object described by a line of the file
+    void connectObject(const StringList& line_parts);
 
     ObjectHostContext* mContext;
     ObjectHost* mOH;
     SpaceID mSpace;
     String mFilename;
     int32 mMaxObjects;
-    struct ObjectConnectInfo {
-        HostedObjectPtr object;
-        Location loc;
-        BoundingSphere3f bounds;
-        String mesh;
-        String query;
-        String physics;
-    };
-    std::queue<ObjectConnectInfo> mIncompleteObjects;
-    int32 mConnectRate;
+
+    std::ifstream mFile;
+    int32 mCount;
+
+    // Column indices, -1 if the column isn't in the file
+    int mObjTypeIdx;
+    int mPosIdx;
+    int mOrientIdx;
+    int mVelIdx;
+    int mMeshIdx;
+    int mQuatVelIdx;
+    int mScriptTypeIdx;
+    int mScriptOptsIdx;
+    int mScriptContentsIdx;
+    int mScaleIdx;
+    int mObjIDIdx;
+    int mQueryIdx;
+    int mPhysicsOptsIdx;
+
+    ConnectPacer mPacer;
 };
 
 } // namespace Sirikata
@@ -49,8 +49,9 @@ static void InitPluginOptions() {
             Path::Placeholders::DIR_USER,
             Sirikata::OptionValueType<std::list<String> >(), "Search paths for scene files if a relative path is specified"),
         new Sirikata::OptionValue("db", "sirikata.db", Sirikata::OptionValueType<String>(), "File to read objects from."),
-        new Sirikata::OptionValue("rate", "1000000", Sirikata::OptionValueType<int32>(), "Rate to connect objects that are generated by this factory to the space, in objects per second.  Intended to avoid overloading the space server."),
+        new Sirikata::OptionValue("rate", "1000000", Sirikata::OptionValueType<int32>(), "Maximum rate to connect objects that are generated by this factory to the space, in objects per second."),
         new Sirikata::OptionValue("objects", "1000000", Sirikata::OptionValueType<int32>(), "Maximum number of objects to load from the file."),
+        new Sirikata::OptionValue("target-latency", "500ms", Sirikata::OptionValueType<Duration>(), "Session request latency to aim for. Objects are connected as quickly as possible while the space responds to their requests within this time."),
         NULL);
 }
 
@@ -65,8 +66,9 @@ static ObjectFactory* createCSVObjectFactory(ObjectHostContext* ctx, ObjectHost*
     String dbfile = optionsSet->referenceOption("db")->as<String>();
     int32 nobjects = optionsSet->referenceOption("objects")->as<int32>();
     int32 add_rate = optionsSet->referenceOption("rate")->as<int32>();
+    Duration target_latency = optionsSet->referenceOption("target-latency")->as<Duration>();
 
-    return new CSVObjectFactory(ctx, oh, space, search_paths, dbfile, nobjects, add_rate);
+    return new CSVObjectFactory(ctx, oh, space, search_paths, dbfile, nobjects, add_rate, target_latency);
 }
 
 } // namespace Sirikata
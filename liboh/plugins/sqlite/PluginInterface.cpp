@@ -52,6 +52,8 @@ static void InitPluginOptions() {
 
     Sirikata::InitializeClassOptions icof("sqlitefactory",NULL,
         new Sirikata::OptionValue("db", "storage.db", Sirikata::OptionValueType<String>(), "File to read objects from."),
+        new Sirikata::OptionValue("rate", "1", Sirikata::OptionValueType<int32>(), "Maximum rate to create objects from the database, in objects per second."),
+        new Sirikata::OptionValue("target-latency", "500ms", Sirikata::OptionValueType<Duration>(), "Session request latency to aim for. Objects are created as quickly as possible while the space responds to session requests within this time."),
         NULL);
 }
 
@@ -79,8 +81,10 @@ static ObjectFactory* createSQLiteObjectFactory(ObjectHostContext* ctx, ObjectHo
     optionsSet->parse(args);
 
     String dbfile = optionsSet->referenceOption("db")->as<String>();
+    int32 rate = optionsSet->referenceOption("rate")->as<int32>();
+    Duration target_latency = optionsSet->referenceOption("target-latency")->as<Duration>();
 
-    return new SQLiteObjectFactory(ctx, oh, space, dbfile);
+    return new SQLiteObjectFactory(ctx, oh, space, dbfile, rate, target_latency);
 }
 
 } // namespace Sirikata
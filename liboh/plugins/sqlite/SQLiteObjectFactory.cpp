@@ -38,91 +38,94 @@
 
 namespace Sirikata {
 
-SQLiteObjectFactory::SQLiteObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const String& filename)
+SQLiteObjectFactory::SQLiteObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const String& filename, int32 connect_rate, const Duration& target_latency)
  : mContext(ctx),
    mOH(oh),
    mSpace(space),
    mDBFilename(filename),
-   mConnectRate(1)
+   mQueryStmt(NULL),
+   mPacer(ctx, oh, space, (uint32)std::max(connect_rate, (int32)1), target_latency,
+       std::tr1::bind(&SQLiteObjectFactory::connectObjects, this, std::tr1::placeholders::_1))
 {
 }
 
+SQLiteObjectFactory::~SQLiteObjectFactory() {
+    finishQuery();
+}
+
 void SQLiteObjectFactory::generate(const String& timestamp) {
-    SQLiteDBPtr db = SQLite::getSingleton().open(mDBFilename);
-    sqlite3_busy_timeout(db->db(), 1000);
+    mDB = SQLite::getSingleton().open(mDBFilename);
+    sqlite3_busy_timeout(mDB->db(), 1000);
 
 
     String value_query = "SELECT object, script_type, script_args, script_contents FROM ";
     value_query += "\"" TABLE_NAME "\"";
     int rc;
     char* remain;
-    sqlite3_stmt* value_query_stmt;
-    rc = sqlite3_prepare_v2(db->db(), value_query.c_str(), -1, &value_query_stmt, (const char**)&remain);
-    SQLite::check_sql_error(db->db(), rc, NULL, "Error preparing value query statement");
-    if (rc==SQLITE_OK){
-        int step_rc = sqlite3_step(value_query_stmt);
-        while(step_rc == SQLITE_ROW) {
-            String object_str(
-                (const char*)sqlite3_column_text(value_query_stmt, 0),
-                sqlite3_column_bytes(value_query_stmt, 0)
-            );
-            String script_type(
-                (const char*)sqlite3_column_text(value_query_stmt, 1),
-                sqlite3_column_bytes(value_query_stmt, 1)
-            );
-            String script_args(
-                (const char*)sqlite3_column_text(value_query_stmt, 2),
-                sqlite3_column_bytes(value_query_stmt, 2)
-            );
-            String script_contents(
-                (const char*)sqlite3_column_text(value_query_stmt, 3),
-                sqlite3_column_bytes(value_query_stmt, 3)
-            );
-
-            if (!script_type.empty())
-            {
-                ObjectInfo info;
-                info.id = UUID(object_str, UUID::HexString());
-                info.scriptType = script_type;
-                info.scriptArgs = script_args;
-                info.scriptContents = script_contents;
-                mIncompleteObjects.push(info);
-            }
-
-            step_rc = sqlite3_step(value_query_stmt);
-        }
-        if (step_rc != SQLITE_DONE) {
-            // reset the statement so it'll clean up properly
-            rc = sqlite3_reset(value_query_stmt);
-            SQLite::check_sql_error(db->db(), rc, NULL, "Error finalizing value query statement");
-        }
+    rc = sqlite3_prepare_v2(mDB->db(), value_query.c_str(), -1, &mQueryStmt, (const char**)&remain);
+    SQLite::check_sql_error(mDB->db(), rc, NULL, "Error preparing value query statement");
+    if (rc != SQLITE_OK) {
+        finishQuery();
+        return;
     }
 
-    rc = sqlite3_finalize(value_query_stmt);
-    SQLite::check_sql_error(db->db(), rc, NULL, "Error finalizing value query statement");
-
-    connectObjects();
+    mPacer.start();
 }
 
-void SQLiteObjectFactory::connectObjects() {
-    if (mContext->stopped())
-        return;
+bool SQLiteObjectFactory::connectObjects(uint32 count) {
+    uint32 created = 0;
+    int step_rc = SQLITE_ROW;
+    while(created < count) {
+        step_rc = sqlite3_step(mQueryStmt);
+        if (step_rc != SQLITE_ROW)
+            break;
+
+        String object_str(
+            (const char*)sqlite3_column_text(mQueryStmt, 0),
+            sqlite3_column_bytes(mQueryStmt, 0)
+        );
+        String script_type(
+            (const char*)sqlite3_column_text(mQueryStmt, 1),
+            sqlite3_column_bytes(mQueryStmt, 1)
+        );
+        String script_args(
+            (const char*)sqlite3_column_text(mQueryStmt, 2),
+            sqlite3_column_bytes(mQueryStmt, 2)
+        );
+        String script_contents(
+            (const char*)sqlite3_column_text(mQueryStmt, 3),
+            sqlite3_column_bytes(mQueryStmt, 3)
+        );
+
+        // Objects connect themselves from their scripts
+        if (!script_type.empty())
+        {
+            HostedObjectPtr obj = mOH->createObject(
+                UUID(object_str, UUID::HexString()), script_type, script_args, script_contents
+            );
+            created++;
+        }
+    }
 
-    for(int32 i = 0; i < mConnectRate && !mIncompleteObjects.empty(); i++) {
-        ObjectInfo info = mIncompleteObjects.front();
-        mIncompleteObjects.pop();
+    if (step_rc == SQLITE_ROW)
+        return true;
 
-        HostedObjectPtr obj = mOH->createObject(
-            info.id, info.scriptType, info.scriptArgs, info.scriptContents
-        );
+    if (step_rc != SQLITE_DONE) {
+        // reset the statement so it'll clean up properly
+        int rc = sqlite3_reset(mQueryStmt);
+        SQLite::check_sql_error(mDB->db(), rc, NULL, "Error finalizing value query statement");
     }
+    finishQuery();
+    return false;
+}
 
-    if (!mIncompleteObjects.empty())
-        mContext->mainStrand->post(
-            Duration::seconds(1.f),
-            std::tr1::bind(&SQLiteObjectFactory::connectObjects, this),
-            "SQLiteObjectFactory::connectObjects"
-        );
+void SQLiteObjectFactory::finishQuery() {
+    if (mQueryStmt != NULL) {
+        int rc = sqlite3_finalize(mQueryStmt);
+        SQLite::check_sql_error(mDB->db(), rc, NULL, "Error finalizing value query statement");
+        mQueryStmt = NULL;
+    }
+    mDB.reset();
 }
 
 } // namespace Sirikata
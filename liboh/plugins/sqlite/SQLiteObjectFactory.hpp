@@ -36,36 +36,40 @@
 #include <sirikata/oh/ObjectFactory.hpp>
 #include <sirikata/oh/HostedObject.hpp>
 #include <sirikata/oh/SimulationFactory.hpp>
+#include <sirikata/oh/ConnectPacer.hpp>
+#include <sirikata/sqlite/SQLite.hpp>
 
 namespace Sirikata {
 
-/** SQLiteObjectFactory generates objects from an input SQLite file. */
+/** SQLiteObjectFactory generates objects from an input SQLite file. Rows are
+ *  stepped through as the ConnectPacer asks for more objects, so the whole
+ *  table is never loaded at once.
+ */
 class SQLiteObjectFactory : public ObjectFactory {
 public:
     typedef std::vector<String> StringList;
 
-    SQLiteObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const String& filename);
-    virtual ~SQLiteObjectFactory() {}
+    SQLiteObjectFactory(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, const String& filename, int32 connect_rate, const Duration& target_latency);
+    virtual ~SQLiteObjectFactory();
 
     virtual void generate(const String& timestamp="current");
 
 private:
-    void connectObjects();
-
-    struct ObjectInfo {
-        UUID id;
-        String scriptType;
-        String scriptArgs;
-        String scriptContents;
-    };
+    // Creates up to count more objects from the database. Returns false once
+    // there are no more rows.
+    bool connectObjects(uint32 count);
+    void finishQuery();
 
     ObjectHostContext* mContext;
     ObjectHost* mOH;
     SpaceID mSpace;
     String mDBFilename;
-    int32 mConnectRate;
-    typedef std::queue<ObjectInfo> ObjectInfoQueue;
-    ObjectInfoQueue mIncompleteObjects;
+
+    // The query stays open while objects are being created
+    SQLiteDBPtr mDB;
+    sqlite3_stmt* mQueryStmt;
+
+    ConnectPacer mPacer;
 };
 
 } // namespace Sirikata
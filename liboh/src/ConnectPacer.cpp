@@ -0,0 +1,80 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/oh/ConnectPacer.hpp>
+
+namespace Sirikata {
+
+namespace {
+const Duration TICK_INTERVAL = Duration::milliseconds((int64)100);
+// Starting window and additive increase
+const uint32 WINDOW_INCREASE = 16;
+// Beyond this many outstanding requests the space is the bottleneck
+// regardless of latency
+const uint32 MAX_WINDOW = 8192;
+}
+
+ConnectPacer::ConnectPacer(ObjectHostContext* ctx, ObjectHost* oh, const SpaceID& space, uint32 max_rate, const Duration& target_latency, StartBatchCallback cb)
+ : mContext(ctx),
+   mOH(oh),
+   mSpace(space),
+   mCallback(cb),
+   mMaxRate(std::max((uint32)1, max_rate)),
+   mMaxCredit(std::max(1.0, 2 * mMaxRate * TICK_INTERVAL.toSeconds())),
+   mTargetLatency(target_latency),
+   mCredit(1.0),
+   mLastRefill(Time::null()),
+   mWindow(WINDOW_INCREASE),
+   mLastSamples(0),
+   mLastDecrease(Time::null())
+{
+}
+
+void ConnectPacer::start() {
+    tick();
+}
+
+uint32 ConnectPacer::nextBatchSize(const SessionManager::ConnectStats& stats, const Time& now) {
+    if (stats.samples != mLastSamples) {
+        mLastSamples = stats.samples;
+        if (stats.latency > mTargetLatency) {
+            if (now - mLastDecrease > stats.latency) {
+                mWindow = std::max((uint32)1, mWindow / 2);
+                mLastDecrease = now;
+            }
+        }
+        else {
+            mWindow = std::min(MAX_WINDOW, mWindow + WINDOW_INCREASE);
+        }
+    }
+
+    // The first object can always start right away
+    if (mLastRefill != Time::null())
+        mCredit = std::min(mMaxCredit, mCredit + mMaxRate * (now - mLastRefill).toSeconds());
+    mLastRefill = now;
+
+    if (stats.pending >= mWindow)
+        return 0;
+    uint32 batch = std::min(mWindow - stats.pending, (uint32)mCredit);
+    mCredit -= batch;
+    return batch;
+}
+
+void ConnectPacer::tick() {
+    if (mContext->stopped())
+        return;
+
+    uint32 batch = nextBatchSize(mOH->connectStats(mSpace), mContext->simTime());
+    // A zero sized batch just waits for outstanding requests to complete
+    if (batch > 0 && !mCallback(batch))
+        return;
+
+    mContext->mainStrand->post(
+        TICK_INTERVAL,
+        std::tr1::bind(&ConnectPacer::tick, this),
+        "ConnectPacer::tick"
+    );
+}
+
+} // namespace Sirikata
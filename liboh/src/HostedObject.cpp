@@ -681,9 +681,10 @@ void HostedObject::iHandleDisconnected(
 }
 
 
-void HostedObject::receiveMessage(const SpaceID& space, const Protocol::Object::ObjectMessage* msg) {
+void HostedObject::receiveMessage(const SpaceID& space, Protocol::Object::ObjectMessage* msg) {
     if (stopped()) {
         HO_LOG(detailed,"Ignoring received message after system stop requested.");
+        releaseObjectMessage(msg);
         return;
     }
 
@@ -693,11 +694,11 @@ void HostedObject::receiveMessage(const SpaceID& space, const Protocol::Object::
 
     if (mDelegateODPService->deliver(src_ep, dst_ep, MemoryReference(msg->payload()))) {
         // if this was true, it got delivered
-        delete msg;
+        releaseObjectMessage(msg);
     }
     else {
         SILOG(cppoh,detailed,"Undelivered message from " << src_ep << " to " << dst_ep);
-        delete msg;
+        releaseObjectMessage(msg);
     }
 
 }
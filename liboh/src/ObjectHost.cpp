@@ -216,7 +216,7 @@ void ObjectHost::handleObjectMessage(const SpaceObjectReference& sporef_internal
     }
     else {
         OH_LOG(warn, "Got message for " << sporef_internalID << " but no such object exists.");
-        delete msg;
+        releaseObjectMessage(msg);
     }
 }
 
@@ -303,6 +303,13 @@ Duration ObjectHost::clientTimeOffset(const SpaceID& space) const {
     return mSessionManagers.find(space)->second->clientTimeOffset();
 }
 
+SessionManager::ConnectStats ObjectHost::connectStats(const SpaceID& space) const {
+    SpaceSessionManagerMap::const_iterator it = mSessionManagers.find(space);
+    if (it == mSessionManagers.end())
+        return SessionManager::ConnectStats();
+    return it->second->connectStats();
+}
+
 Time ObjectHost::spaceTime(const SpaceID& space, const Time& t) const {
     Duration off = serverTimeOffset(space);
     // FIXME we should probably return a negative time and force the code using
@@ -335,14 +342,11 @@ Time ObjectHost::currentLocalTime() const {
 
 bool ObjectHost::send(SpaceObjectReference& sporef_src, const SpaceID& space, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, MemoryReference payload) {
     Sirikata::SerializationCheck::Scoped sc(&mSessionSerialization);
-
-    std::string payload_str( (char*)payload.begin(), (char*)payload.end() );
-    return send(sporef_src, space, src_port, dest, dest_port, payload_str);
+    return mSessionManagers[space]->send(sporef_src, src_port, dest, dest_port, payload);
 }
 
 bool ObjectHost::send(SpaceObjectReference& sporef_src, const SpaceID& space, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload) {
-    Sirikata::SerializationCheck::Scoped sc(&mSessionSerialization);
-    return mSessionManagers[space]->send(sporef_src, src_port, dest, dest_port, payload);
+    return send(sporef_src, space, src_port, dest, dest_port, MemoryReference(payload));
 }
 
 void ObjectHost::registerHostedObject(const SpaceObjectReference &sporef_uuid, const HostedObjectPtr& obj)
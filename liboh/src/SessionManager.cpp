@@ -155,6 +155,10 @@ void SessionManager::ObjectConnections::startMigration(const SpaceObjectReferenc
     mObjectInfo[sporef_objid].migratedCB(parent->mSpace, sporef_objid.object(), migrating_to);
 }
 
+SessionManager::ConnectingInfo& SessionManager::ObjectConnections::getConnectingInfo(const SpaceObjectReference& sporef_objid) {
+    return mObjectInfo[sporef_objid].connectingInfo;
+}
+
 SessionManager::InternalConnectedCallback& SessionManager::ObjectConnections::getConnectCallback(const SpaceObjectReference& sporef_objid) {
     return mObjectInfo[sporef_objid].connectedCB;
 }
@@ -252,6 +256,7 @@ void SessionManager::ObjectConnections::remove(const SpaceObjectReference& spore
 
     // Remove from main object set
     mObjectInfo.erase(sporef_objid);
+    parent->mConnectStartTimes.erase(sporef_objid);
     // Remove from reverse index // FIXME need real object reference
     //mInternalIDs.erase( ObjectReference(objid) );
 }
@@ -345,17 +350,23 @@ SessionManager::SessionManager(
    mObjectDisconnectedCallback(disconn_cb),
    mObjectConnections(this),
    mTimeSyncClient(NULL),
-   mShuttingDown(false)
+   mShuttingDown(false),
+   mBatchSessionMessages(false),
+   mConnectLatency(ctx->metrics->histogram(String("oh.server") + boost::lexical_cast<String>(ctx->id) + ".connect_latency"))
 #ifdef PROFILE_OH_PACKET_RTT
    ,
    mClearOutstandingCount(0),
-   mLatencySum(),
-   mLatencyCount(0),
-   mTimeSeriesOHRTT(String("oh.server") + boost::lexical_cast<String>(ctx->id) + ".rtt_latency")
+   mRTT(ctx->metrics->histogram(String("oh.server") + boost::lexical_cast<String>(ctx->id) + ".rtt_latency"))
 #endif
 {
     mStreamOptions=Sirikata::Network::StreamFactory::getSingleton().getOptionParser(GetOptionValue<String>("ohstreamlib"))(GetOptionValue<String>("ohstreamoptions"));
 
+    // Space servers which predate batches can't handle them, so batching is
+    // opt in. Not every object host registers the option.
+    OptionValue* batch_opt = GetOption("oh.session-batching");
+    if (batch_opt != NULL)
+        mBatchSessionMessages = batch_opt->unsafeAs<bool>();
+
     mHandleReadProfiler = mContext->profiler->addStage("Handle Read Network");
     mHandleMessageProfiler = mContext->profiler->addStage("Handle Server Message");
 }
@@ -395,11 +406,6 @@ void SessionManager::stop() {
 
 void SessionManager::poll() {
 #ifdef PROFILE_OH_PACKET_RTT
-    mContext->timeSeries->report(
-        mTimeSeriesOHRTT,
-        (mLatencyCount > 0) ? mLatencySum.toMicroseconds() / mLatencyCount : 0.f
-    );
-
     // Not perfect, and assumes we won't see > 5s latencies, but we
     // need to clear it out periodically to make sure we don't eat up
     // too much memory.
@@ -408,9 +414,6 @@ void SessionManager::poll() {
         mOutstandingPackets.clear();
         mClearOutstandingCount = 0;
     }
-
-    mLatencySum = Duration::microseconds(0);
-    mLatencyCount = 0;
 #endif
 }
 
@@ -461,6 +464,7 @@ bool SessionManager::connect(
         ),
         stream_created_cb, disconn_cb
     );
+    mConnectStartTimes[sporef_objid] = mContext->simTime();
 
     // Get a connection to request
     SESSION_LOG(detailed, "Connection starting for " << sporef_objid);
@@ -473,6 +477,9 @@ bool SessionManager::connect(
 void SessionManager::disconnect(const SpaceObjectReference& sporef_objid) {
     Sirikata::SerializationCheck::Scoped sc(&mSerialization);
 
+    // No response is expected anymore if we were still connecting
+    mConnectStartTimes.erase(sporef_objid);
+
     ServerID connected_to = mObjectConnections.getConnectedServer(sporef_objid);
     // The caller may be conservative in calling disconnect, especially to make
     // sure disconnections are actually forced (e.g. for safety in the case of a
@@ -493,6 +500,12 @@ void SessionManager::disconnect(const SpaceObjectReference& sporef_objid) {
     mObjectConnections.gracefulDisconnect(sporef_objid);
 }
 
+SessionManager::ConnectStats SessionManager::connectStats() const {
+    ConnectStats stats = mConnectStats;
+    stats.pending = mConnectStartTimes.size();
+    return stats;
+}
+
 void SessionManager::sendDisconnectMessage(const SpaceObjectReference& sporef_objid, ServerID connected_to, uint64 session_seqno) {
     // Construct and send disconnect message.  This has to happen first so we still have
     // connection information so we know where to send the disconnect
@@ -504,11 +517,46 @@ void SessionManager::sendDisconnectMessage(const SpaceObjectReference& sporef_ob
 
     // We just need to make sure it gets on the queue, once its on the space
     // server guarantees processing since it is a session message
+    queueSessionMessage(sporef_objid, connected_to, session_msg);
+}
+
+void SessionManager::queueSessionMessage(const SpaceObjectReference& sporef, ServerID dest_server, const Sirikata::Protocol::Session::Container& session_msg) {
+    if (!mBatchSessionMessages) {
+        sendRetryingMessage(
+            sporef, OBJECT_PORT_SESSION,
+            UUID::null(), OBJECT_PORT_SESSION,
+            serializePBJMessage(session_msg),
+            dest_server, mContext->mainStrand, Duration::seconds(0.05)
+        );
+        return;
+    }
+
+    SessionBatchEntryList& msgs = mOutgoingSessionMessages[dest_server];
+    if (msgs.empty()) {
+        mContext->mainStrand->post(
+            std::tr1::bind(&SessionManager::flushSessionMessages, this, dest_server),
+            "SessionManager::flushSessionMessages"
+        );
+    }
+    msgs.push_back(SessionBatchEntry(sporef.object().getAsUUID(), serializePBJMessage(session_msg)));
+
+    if (msgs.size() >= MAX_SESSION_BATCH_ENTRIES)
+        flushSessionMessages(dest_server);
+}
+
+void SessionManager::flushSessionMessages(ServerID dest_server) {
+    SessionMessageListMap::iterator it = mOutgoingSessionMessages.find(dest_server);
+    if (it == mOutgoingSessionMessages.end())
+        return;
+
+    std::string payload = serializeSessionBatch(it->second);
+    mOutgoingSessionMessages.erase(it);
+
     sendRetryingMessage(
-        sporef_objid, OBJECT_PORT_SESSION,
-        UUID::null(), OBJECT_PORT_SESSION,
-        serializePBJMessage(session_msg),
-        connected_to, mContext->mainStrand, Duration::seconds(0.05)
+        SpaceObjectReference(mSpace, ObjectReference::null()), OBJECT_PORT_SESSION_BATCH,
+        UUID::null(), OBJECT_PORT_SESSION_BATCH,
+        payload,
+        dest_server, mContext->mainStrand, Duration::seconds(0.05)
     );
 }
 
@@ -538,6 +586,7 @@ void SessionManager::openConnectionStartSession(const SpaceObjectReference& spor
 
     if (conn == NULL) {
         SESSION_LOG(warn,"Couldn't initiate connection for " << sporef_uuid);
+        mConnectStartTimes.erase(sporef_uuid);
         // FIXME disconnect? retry?
 	ConnectingInfo ci;
         mObjectConnections.getConnectCallback(sporef_uuid)(mSpace, ObjectReference::null(), NullServerID, ci);
@@ -545,13 +594,129 @@ void SessionManager::openConnectionStartSession(const SpaceObjectReference& spor
     }
 
     SESSION_LOG(detailed, "Base connection to space server obtained, initiating session " << sporef_uuid);
-    // Send connection msg, store callback info so it can be called when we get a response later in a service call
-    ConnectingInfo ci = mObjectConnections.connectingTo(sporef_uuid, conn->server());
+    // Mark where we're connecting and pick the session seqno now so responses
+    // and retries match this request even though it is sent later, along with
+    // any other requests to the same server.
+    mObjectConnections.connectingTo(sporef_uuid, conn->server());
+    if (!is_retry)
+        mObjectConnections.updateSeqno(sporef_uuid);
+
+    std::deque<SpaceObjectReference>& requests = mConnectRequests[conn->server()];
+    bool flush_scheduled = !requests.empty();
+    requests.push_back(sporef_uuid);
+    if (!flush_scheduled) {
+        mContext->mainStrand->post(
+            std::tr1::bind(&SessionManager::flushConnectRequests, this, conn->server()),
+            "SessionManager::flushConnectRequests"
+        );
+    }
+}
 
-    Sirikata::Protocol::Session::Container session_msg;
-    uint64 seqno = is_retry ? mObjectConnections.getSeqno(sporef_uuid) : mObjectConnections.updateSeqno(sporef_uuid);
-    session_msg.set_seqno(seqno);
-    Sirikata::Protocol::Session::IConnect connect_msg = session_msg.mutable_connect();
+void SessionManager::flushConnectRequests(ServerID sid) {
+    Sirikata::SerializationCheck::Scoped sc(&mSerialization);
+
+    ConnectRequestQueueMap::iterator req_it = mConnectRequests.find(sid);
+    if (req_it == mConnectRequests.end())
+        return;
+    std::deque<SpaceObjectReference>& requests = req_it->second;
+
+    if (mShuttingDown) {
+        mConnectRequests.erase(req_it);
+        return;
+    }
+
+    // If we lost the connection, fall back to getting a new one for each
+    // object individually.
+    if (mConnections.find(sid) == mConnections.end()) {
+        for(std::deque<SpaceObjectReference>::iterator it = requests.begin(); it != requests.end(); it++) {
+            mContext->mainStrand->post(
+                Duration::seconds(0.05),
+                std::tr1::bind(&SessionManager::retryOpenConnection,this,*it,sid),
+                "&SessionManager::retryOpenConnection"
+            );
+        }
+        mConnectRequests.erase(req_it);
+        return;
+    }
+
+    // Without batching each request gets its own message
+    uint32 max_batch = (mBatchSessionMessages ? MAX_SESSION_BATCH_ENTRIES : 1);
+    std::vector<SpaceObjectReference> sent;
+    while(!requests.empty()) {
+        SessionBatchEntryList batch;
+        uint32 consumed = 0;
+        for(std::deque<SpaceObjectReference>::iterator it = requests.begin();
+            it != requests.end() && batch.size() < max_batch;
+            it++, consumed++)
+        {
+            // The object may have disconnected or been redirected since the
+            // request was queued
+            if (!mObjectConnections.exists(*it) || mObjectConnections.getConnectingToServer(*it) != sid)
+                continue;
+
+            Sirikata::Protocol::Session::Container session_msg;
+            fillConnectRequest(*it, &session_msg);
+            batch.push_back(SessionBatchEntry(it->object().getAsUUID(), serializePBJMessage(session_msg)));
+        }
+
+        if (!batch.empty()) {
+            bool pushed;
+            if (mBatchSessionMessages) {
+                pushed = send(
+                    SpaceObjectReference(mSpace, ObjectReference::null()), OBJECT_PORT_SESSION_BATCH,
+                    UUID::null(), OBJECT_PORT_SESSION_BATCH,
+                    serializeSessionBatch(batch),
+                    sid
+                );
+            }
+            else {
+                pushed = send(
+                    SpaceObjectReference(mSpace, ObjectReference(batch[0].first)), OBJECT_PORT_SESSION,
+                    UUID::null(), OBJECT_PORT_SESSION,
+                    batch[0].second,
+                    sid
+                );
+            }
+            if (!pushed)
+                break;
+        }
+
+        for(uint32 i = 0; i < consumed; i++) {
+            const SpaceObjectReference& sporef_uuid = requests.front();
+            if (mObjectConnections.exists(sporef_uuid) && mObjectConnections.getConnectingToServer(sporef_uuid) == sid)
+                sent.push_back(sporef_uuid);
+            requests.pop_front();
+        }
+    }
+
+    if (!sent.empty()) {
+        // Setup a retry in case something gets dropped -- must check status and
+        // retries entire connection process
+        mContext->mainStrand->post(
+            Duration::seconds(3),
+            std::tr1::bind(&SessionManager::checkConnectedAndRetryBatch, this, sent, sid),
+            "SessionManager::checkConnectedAndRetryBatch"
+        );
+    }
+
+    if (requests.empty()) {
+        mConnectRequests.erase(req_it);
+    }
+    else {
+        // The connection is backed up, try the rest again shortly
+        mContext->mainStrand->post(
+            Duration::seconds(0.05),
+            std::tr1::bind(&SessionManager::flushConnectRequests, this, sid),
+            "SessionManager::flushConnectRequests"
+        );
+    }
+}
+
+void SessionManager::fillConnectRequest(const SpaceObjectReference& sporef_uuid, Sirikata::Protocol::Session::Container* session_msg) {
+    const ConnectingInfo& ci = mObjectConnections.getConnectingInfo(sporef_uuid);
+
+    session_msg->set_seqno(mObjectConnections.getSeqno(sporef_uuid));
+    Sirikata::Protocol::Session::IConnect connect_msg = session_msg->mutable_connect();
     fillVersionInfo(connect_msg.mutable_version(), mContext);
     connect_msg.set_type(Sirikata::Protocol::Session::Connect::Fresh);
     connect_msg.set_object(sporef_uuid.object().getAsUUID());
@@ -576,27 +741,24 @@ void SessionManager::openConnectionStartSession(const SpaceObjectReference& spor
 
     if (ci.zernike.size() > 0)
       connect_msg.set_zernike( ci.zernike );
+}
 
-    if (!send(sporef_uuid, OBJECT_PORT_SESSION,
-              UUID::null(), OBJECT_PORT_SESSION,
-              serializePBJMessage(session_msg),
-            conn->server()
-            )) {
-        mContext->mainStrand->post(
-            Duration::seconds(0.05),
-            std::tr1::bind(&SessionManager::retryOpenConnection,this,sporef_uuid,conn->server()),
-            "&SessionManager::retryOpenConnection"
-        );
-    }
-    else {
-        // Setup a retry in case something gets dropped -- must check status and
-        // retries entire connection process
-        mContext->mainStrand->post(
-            Duration::seconds(3),
-            std::tr1::bind(&SessionManager::checkConnectedAndRetry, this, sporef_uuid, conn->server()),
-            "SessionManager::checkConnectedAndRetry"
-        );
+void SessionManager::recordConnectResponse(const SpaceObjectReference& sporef_uuid, bool success) {
+    ConnectStartTimeMap::iterator it = mConnectStartTimes.find(sporef_uuid);
+    if (it == mConnectStartTimes.end())
+        return;
+
+    if (success) {
+        Duration latency = mContext->simTime() - it->second;
+        mConnectLatency->record(latency);
+        // Smooth the same way TCP smooths RTT estimates
+        if (mConnectStats.samples == 0)
+            mConnectStats.latency = latency;
+        else
+            mConnectStats.latency = mConnectStats.latency * 0.875 + latency * 0.125;
+        mConnectStats.samples++;
     }
+    mConnectStartTimes.erase(it);
 }
 
 void SessionManager::checkConnectedAndRetry(const SpaceObjectReference& sporef_uuid, ServerID connTo) {
@@ -611,6 +773,11 @@ void SessionManager::checkConnectedAndRetry(const SpaceObjectReference& sporef_u
 }
 
 
+void SessionManager::checkConnectedAndRetryBatch(const std::vector<SpaceObjectReference>& sporefs, ServerID connTo) {
+    for(std::vector<SpaceObjectReference>::const_iterator it = sporefs.begin(); it != sporefs.end(); it++)
+        checkConnectedAndRetry(*it, connTo);
+}
+
 void SessionManager::migrate(const SpaceObjectReference& sporef_obj_id, ServerID sid) {
     Sirikata::SerializationCheck::Scoped sc(&mSerialization);
 
@@ -707,7 +874,7 @@ bool SessionManager::delegateOHDPPortSend(const OHDP::Endpoint& source_ep, const
     return send(
         SpaceObjectReference(source_ep.space(), ObjectReference(UUID::null())), source_ep.port(),
         UUID::null(), dest_ep.port(),
-        String((char*)payload.data(), payload.size()),
+        payload,
         (ServerID)dest_ep.node()
     );
 }
@@ -718,6 +885,10 @@ void SessionManager::timeSyncUpdated() {
 }
 
 bool SessionManager::send(const SpaceObjectReference& sporef_src, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, const std::string& payload, ServerID dest_server) {
+    return send(sporef_src, src_port, dest, dest_port, MemoryReference(payload), dest_server);
+}
+
+bool SessionManager::send(const SpaceObjectReference& sporef_src, const ObjectMessagePort src_port, const UUID& dest, const ObjectMessagePort dest_port, MemoryReference payload, ServerID dest_server) {
     Sirikata::SerializationCheck::Scoped sc(&mSerialization);
 
     if (mShuttingDown)
@@ -740,11 +911,11 @@ bool SessionManager::send(const SpaceObjectReference& sporef_src, const ObjectMe
     }
     SpaceNodeConnection* conn = it->second;
 
-    // FIXME would be nice not to have to do this alloc/dealloc
+    // The payload is left out of the message and sent from the caller's buffer
     ObjectMessage obj_msg;
-    createObjectHostMessage(mContext->id, sporef_src, src_port, dest, dest_port, payload, &obj_msg);
+    createObjectHostMessageHeader(mContext->id, sporef_src, src_port, dest, dest_port, &obj_msg);
     TIMESTAMP_CREATED((&obj_msg), Trace::CREATED);
-    bool pushed = conn->push(obj_msg);
+    bool pushed = conn->push(obj_msg, payload);
 #ifdef PROFILE_OH_PACKET_RTT
     if (pushed) {
         mOutstandingPackets[obj_msg.unique()] = mContext->simTime();
@@ -1008,7 +1179,7 @@ void SessionManager::handleServerMessages(Liveness::Token alive, SpaceNodeConnec
 
     for(uint32 ii = 0; ii < MAX_HANDLE_SERVER_MESSAGES; ii++) {
         // Pull it off the queue
-        ObjectMessage* msg = conn->pull();
+        Sirikata::Protocol::Object::ObjectMessage* msg = conn->pull();
         if (msg == NULL) {
             mHandleMessageProfiler->finished();
             return;
@@ -1018,8 +1189,7 @@ void SessionManager::handleServerMessages(Liveness::Token alive, SpaceNodeConnec
         if (out_it != mOutstandingPackets.end()) {
             Time start_t = out_it->second;
             Time end_t = mContext->simTime();
-            mLatencySum += end_t - start_t;
-            mLatencyCount++;
+            mRTT->record(end_t - start_t);
             mOutstandingPackets.erase(out_it);
         }
 #endif
@@ -1032,7 +1202,7 @@ void SessionManager::handleServerMessages(Liveness::Token alive, SpaceNodeConnec
     mHandleMessageProfiler->finished();
 }
 
-void SessionManager::handleServerMessage(ObjectMessage* msg, ServerID server_id) {
+void SessionManager::handleServerMessage(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID server_id) {
     TIMESTAMP_START(tstamp, msg);
 
     // Mark as received
@@ -1042,6 +1212,9 @@ void SessionManager::handleServerMessage(ObjectMessage* msg, ServerID server_id)
     if (msg->source_object() == UUID::null() && msg->dest_port() == OBJECT_PORT_SESSION) {
         handleSessionMessage(msg, server_id);
     }
+    else if (msg->source_object() == UUID::null() && msg->dest_port() == OBJECT_PORT_SESSION_BATCH) {
+        handleSessionBatch(msg, server_id);
+    }
     else if (msg->source_object() == UUID::null() && msg->dest_object() == UUID::null()) {
         // Non-session messages between the space and OH, i.e. OHDP. Note that
         // the Session messages must be handled *before* this case since they
@@ -1051,6 +1224,7 @@ void SessionManager::handleServerMessage(ObjectMessage* msg, ServerID server_id)
             OHDP::Endpoint(mSpace, OHDP::NodeID::self(), ODP::PortID(msg->dest_port())),
             MemoryReference(msg->payload())
         );
+        releaseObjectMessage(msg);
     }
     else {
         // Look up internal ID so the OH can find the right object without
@@ -1072,12 +1246,41 @@ void SessionManager::handleSessionMessage(Sirikata::Protocol::Object::ObjectMess
     bool parse_success = session_msg.ParseFromString(msg->payload());
     if (!parse_success) {
         LOG_INVALID_MESSAGE(session, error, msg->payload());
-        delete msg;
+        releaseObjectMessage(msg);
         return;
     }
 
-    assert(!session_msg.has_connect());
     SpaceObjectReference sporef_obj(mSpace,ObjectReference(msg->dest_object()));
+    handleSessionContainer(from_server, sporef_obj, session_msg);
+
+    releaseObjectMessage(msg);
+}
+
+void SessionManager::handleSessionBatch(Sirikata::Protocol::Object::ObjectMessage* msg, ServerID from_server) {
+    Sirikata::SerializationCheck::Scoped sc(&mSerialization);
+
+    SessionBatchEntryList entries;
+    bool parse_success = parseSessionBatch(msg->payload(), &entries);
+    if (!parse_success) {
+        LOG_INVALID_MESSAGE(session, error, msg->payload());
+        releaseObjectMessage(msg);
+        return;
+    }
+
+    for(SessionBatchEntryList::iterator it = entries.begin(); it != entries.end(); it++) {
+        Sirikata::Protocol::Session::Container session_msg;
+        if (!session_msg.ParseFromString(it->second)) {
+            LOG_INVALID_MESSAGE(session, error, it->second);
+            continue;
+        }
+        handleSessionContainer(from_server, SpaceObjectReference(mSpace, ObjectReference(it->first)), session_msg);
+    }
+
+    releaseObjectMessage(msg);
+}
+
+void SessionManager::handleSessionContainer(ServerID from_server, const SpaceObjectReference& sporef_obj, Sirikata::Protocol::Session::Container& session_msg) {
+    assert(!session_msg.has_connect());
 
     // We have to deal with outdated retry messages (as well as just potentially
     // garbage requests). Each of these possibilities should have 2 paths: one
@@ -1104,8 +1307,6 @@ void SessionManager::handleSessionMessage(Sirikata::Protocol::Object::ObjectMess
     if (session_msg.has_init_migration()) {
         handleSessionMessageInitMigration(from_server, sporef_obj, session_msg);
     }
-
-    delete msg;
 }
 
 void SessionManager::handleSessionMessageConnectResponseSuccess(ServerID from_server, const SpaceObjectReference& sporef_obj, Sirikata::Protocol::Session::Container& session_msg) {
@@ -1169,6 +1370,7 @@ void SessionManager::handleSessionMessageConnectResponseSuccess(ServerID from_se
 
         bool time_synced = mTimeSyncClient != NULL && mTimeSyncClient->valid();
 
+        recordConnectResponse(sporef_obj, true);
         ServerID connected_to = mObjectConnections.handleConnectSuccess(sporef_obj, loc, orient, bnds, mesh, phy, time_synced);
 
         sendConnectSuccessAck(sporef_obj, connected_to);
@@ -1228,6 +1430,7 @@ void SessionManager::handleSessionMessageConnectResponseError(ServerID from_serv
     }
 
     SESSION_LOG(error,"Error connecting " << sporef_obj << " to space");
+    recordConnectResponse(sporef_obj, false);
     mObjectConnections.handleConnectError(sporef_obj);
 }
 
@@ -1257,14 +1460,7 @@ void SessionManager::sendConnectSuccessAck(const SpaceObjectReference& sporef, S
     Sirikata::Protocol::Session::Container ack_msg;
     ack_msg.set_seqno( mObjectConnections.getSeqno(sporef) );
     Sirikata::Protocol::Session::IConnectAck connect_ack_msg = ack_msg.mutable_connect_ack();
-    sendRetryingMessage(
-        sporef, OBJECT_PORT_SESSION,
-        UUID::null(), OBJECT_PORT_SESSION,
-        serializePBJMessage(ack_msg),
-        connected_to,
-        mContext->mainStrand,
-        Duration::seconds(0.05)
-    );
+    queueSessionMessage(sporef, connected_to, ack_msg);
 }
 
 void SessionManager::handleObjectFullyConnected(const SpaceID& space, const ObjectReference& obj, ServerID server, const ConnectingInfo& ci, ConnectedCallback real_cb) {
@@ -52,7 +52,7 @@ SpaceNodeConnection::SpaceNodeConnection(ObjectHostContext* ctx, Network::IOStra
    socket(Sirikata::Network::StreamFactory::getSingleton().getConstructor(GetOptionValue<String>("ohstreamlib"))(ioStrand,streamOptions)),
    mAddr(Network::Address::null()),
    mConnecting(false),
-   receive_queue(GetOptionValue<int32>("object-host-receive-buffer"), std::tr1::bind(&ObjectMessage::size, std::tr1::placeholders::_1)),
+   receive_queue(GetOptionValue<int32>("object-host-receive-buffer"), std::tr1::bind(&Sirikata::Protocol::Object::ObjectMessage::ByteSize, std::tr1::placeholders::_1)),
    mConnectCB(ccb),
    mReceiveCB(rcb)
 {
@@ -87,7 +87,33 @@ bool SpaceNodeConnection::push(const ObjectMessage& msg) {
     return success;
 }
 
-ObjectMessage* SpaceNodeConnection::pull() {
+bool SpaceNodeConnection::push(const ObjectMessage& header, MemoryReference payload) {
+    std::string header_data;
+    if (!serializeObjectMessageHeader(header, payload.size(), &header_data)) {
+        ObjectMessage msg(header);
+        msg.set_payload(std::string((const char*)payload.data(), payload.size()));
+        return push(msg);
+    }
+
+    TIMESTAMP_START(tstamp, (&header));
+
+    bool success = socket->send(
+        Sirikata::MemoryReference(header_data),
+        payload,
+        Sirikata::Network::ReliableOrdered
+    );
+    if (success) {
+        TIMESTAMP_END(tstamp, Trace::OH_HIT_NETWORK);
+    }
+    else {
+        TIMESTAMP_END(tstamp, Trace::OH_DROPPED_AT_SEND);
+        TRACE_DROP(OH_DROPPED_AT_SEND);
+    }
+
+    return success;
+}
+
+Sirikata::Protocol::Object::ObjectMessage* SpaceNodeConnection::pull() {
     return receive_queue.pull();
 }
 
@@ -98,12 +124,12 @@ bool SpaceNodeConnection::empty() {
 void SpaceNodeConnection::handleRead(const Chunk& chunk, const Sirikata::Network::Stream::PauseReceiveCallback& pause) {
     mHandleReadStage->started();
 
-    // Parse
-    ObjectMessage* msg = new ObjectMessage();
+    // Parse, reusing a released message (and its payload buffer) if possible
+    Sirikata::Protocol::Object::ObjectMessage* msg = acquireObjectMessage();
     bool parse_success = msg->ParseFromArray(&(*chunk.begin()), chunk.size());
     if (!parse_success) {
         LOG_INVALID_MESSAGE(session, error, chunk);
-        delete msg;
+        releaseObjectMessage(msg);
         return;
     }
 
@@ -127,7 +153,7 @@ void SpaceNodeConnection::handleRead(const Chunk& chunk, const Sirikata::Network
     else {
         TIMESTAMP_END(tstamp, Trace::OH_DROPPED_AT_RECEIVE_QUEUE);
         TRACE_DROP(OH_DROPPED_AT_RECEIVE_QUEUE);
-        delete msg;
+        releaseObjectMessage(msg);
     }
 
     mHandleReadStage->finished();
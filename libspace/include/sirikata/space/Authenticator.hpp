@@ -41,9 +41,11 @@
 
 namespace Sirikata {
 
-class Authenticator : public Service {
+class SIRIKATA_SPACE_EXPORT Authenticator : public Service {
 public:
     typedef std::tr1::function<void(bool)> Callback;
+    // Results for each request in a batch, in the same order
+    typedef std::tr1::function<void(const std::vector<bool>&)> BatchCallback;
 
     virtual ~Authenticator() {}
 
@@ -56,6 +58,15 @@ public:
      *  provide the result, including failure due to timeout.
      */
     virtual void authenticate(const UUID& obj_id, MemoryReference auth, Callback cb) = 0;
+
+    /** Authenticate a batch of requests, e.g. when an object host reconnects
+     *  many objects at once. obj_ids and auths must be the same size. The
+     *  callback is invoked once, with the results for all requests. The
+     *  default implementation just authenticates each request individually;
+     *  implementations which can amortize work across requests should
+     *  override it.
+     */
+    virtual void authenticateBatch(const std::vector<UUID>& obj_ids, const std::vector<String>& auths, BatchCallback cb);
 };
 
 class SIRIKATA_SPACE_EXPORT AuthenticatorFactory
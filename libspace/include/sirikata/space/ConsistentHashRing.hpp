@@ -0,0 +1,63 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SPACE_CONSISTENT_HASH_RING_HPP_
+#define _SIRIKATA_SPACE_CONSISTENT_HASH_RING_HPP_
+
+#include <sirikata/space/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+
+namespace Sirikata {
+
+/** Assigns object IDs to space servers with consistent hashing. Each server
+ *  gets a number of virtual nodes on a ring of 64 bit hashes, and an object
+ *  belongs to the server owning the first virtual node at or after its hash,
+ *  its primary. Optionally the next distinct server clockwise is also
+ *  assigned as a replica.
+ *
+ *  Adding or removing a server only moves the objects in the ranges it gains
+ *  or loses, which rebalance() uses to work out which entries a server has to
+ *  hand off when membership changes.
+ */
+class SIRIKATA_SPACE_EXPORT ConsistentHashRing {
+public:
+    typedef std::set<ServerID> ServerSet;
+
+    ConsistentHashRing(uint32 virtual_nodes, bool replicate);
+
+    void setServers(const ServerSet& servers);
+    const ServerSet& servers() const { return mServers; }
+    bool empty() const { return mRing.empty(); }
+
+    /** Get the servers responsible for obj_id. Either may be NullServerID,
+     *  e.g. the replica if there's only one server or replication is off.
+     */
+    void owners(const UUID& obj_id, ServerID* primary_out, ServerID* replica_out) const;
+
+    /** Determine what self, which stores the entry for obj_id, should do with
+     *  it when the ring changes from old_ring to this one. Each new holder of
+     *  the entry which didn't already have it is sent the entry by exactly
+     *  one server: its old primary, or its old replica if the primary is
+     *  gone. If old_ring is empty, self sends entries to all their holders.
+     *  The servers self needs to send the entry to are appended to
+     *  dests_out. Returns whether self should keep storing the entry.
+     */
+    bool rebalance(const ConsistentHashRing& old_ring, ServerID self, const UUID& obj_id, std::vector<ServerID>* dests_out) const;
+
+    static uint64 hashObject(const UUID& obj_id);
+    static uint64 hashVirtualNode(ServerID server, uint32 vnode);
+
+private:
+    // Maps points on the ring to the server owning the range ending there
+    typedef std::map<uint64, ServerID> Ring;
+
+    const uint32 mVirtualNodes;
+    const bool mReplicate;
+    ServerSet mServers;
+    Ring mRing;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_CONSISTENT_HASH_RING_HPP_
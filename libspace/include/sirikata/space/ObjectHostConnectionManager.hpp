@@ -99,6 +99,12 @@ public:
     WARN_UNUSED
     bool send(const ShortObjectHostConnectionID short_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg);
 
+    /** Send an already serialized ObjectMessage, e.g. one passed through from
+     *  another space server, without parsing it.
+     */
+    WARN_UNUSED
+    bool send(const ObjectHostConnectionID& conn_id, const std::string& serialized_msg);
+
     void shutdown();
 
     Network::IOStrand* const netStrand() const {
@@ -137,6 +143,7 @@ private:
     void handleConnectionRead(ObjectHostConnection* conn, Sirikata::Network::Chunk& chunk, const Sirikata::Network::Stream::PauseReceiveCallback& pause);
 
     bool sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg);
+    bool sendSerializedHelper(ObjectHostConnection* conn, const std::string& serialized_msg);
 
     // Utility methods which we can post to the main strand to ensure they operate safely.
     void insertConnection(ObjectHostConnection* conn);
@@ -146,6 +146,9 @@ protected:
     virtual void handleUpdateOSegMessage(const Sirikata::Protocol::OSeg::UpdateOSegMessage& update_oseg_msg) = 0;
 
 public:
+    // Object IDs and radii of new objects
+    typedef std::vector< std::pair<UUID, float> > NewObjectList;
+
     ObjectSegmentation(SpaceContext* ctx, Network::IOStrand* o_strand);
     virtual ~ObjectSegmentation();
 
@@ -169,6 +172,11 @@ public:
     virtual OSegEntry cacheLookup(const UUID& obj_id) = 0;
     virtual void migrateObject(const UUID& obj_id, const OSegEntry& new_server_id) = 0;
     virtual void addNewObject(const UUID& obj_id, float radius) = 0;
+    /** Add many new objects at once, e.g. for a batch of connections from an
+     *  object host. Results are still reported to the write listener for
+     *  each object. By default, this just adds each object individually.
+     */
+    virtual void addNewObjects(const NewObjectList& objects);
     virtual void addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool) = 0;
     virtual void removeObject(const UUID& obj_id) = 0;
     virtual bool clearToMigrate(const UUID& obj_id) = 0;
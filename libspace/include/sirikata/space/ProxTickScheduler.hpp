@@ -0,0 +1,49 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SPACE_PROX_TICK_SCHEDULER_HPP_
+#define _SIRIKATA_SPACE_PROX_TICK_SCHEDULER_HPP_
+
+#include <sirikata/space/Platform.hpp>
+
+namespace Sirikata {
+
+/** Decides when a set of proximity query handlers needs to be ticked. They
+ *  are checked periodically, and in polling mode every check ticks.
+ *
+ *  In event driven mode a check only ticks if there is work, i.e. objects or
+ *  queries changed, or if max_interval has passed since the last tick, since
+ *  objects keep moving according to their last motion update. Work arriving
+ *  after an idle check is ticked right away, but while there is work at every
+ *  check ticks are spaced at least loaded_interval apart.
+ */
+class SIRIKATA_SPACE_EXPORT ProxTickScheduler {
+public:
+    // Polling mode
+    ProxTickScheduler();
+    // Event driven mode
+    ProxTickScheduler(const Duration& max_interval, const Duration& loaded_interval);
+
+    bool eventDriven() const { return mEventDriven; }
+
+    /** Check whether the handlers should be ticked at time now. If this
+     *  returns true the caller must tick them, since it is recorded as the
+     *  last tick.
+     */
+    bool tickNeeded(bool has_work, const Time& now);
+
+private:
+    bool mEventDriven;
+    Duration mMaxInterval;
+    Duration mLoadedInterval;
+
+    bool mTickedBefore;
+    Time mLastTick;
+    // Whether there was work at every check since the last idle one
+    bool mLoaded;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_PROX_TICK_SCHEDULER_HPP_
@@ -135,11 +135,12 @@ class SIRIKATA_SPACE_EXPORT Proximity :
 
     AggregateManager* mAggregateManager;
 
-    // Stats
+    // Stats, sampled from the main thread since the query counts aren't
+    // thread safe
     Poller mStatsPoller;
-    const String mTimeSeriesObjectQueryCountName;
-    const String mTimeSeriesObjectHostQueryCountName;
-    const String mTimeSeriesServerQueryCountName;
+    Trace::MetricGauge* mObjectQueryCount;
+    Trace::MetricGauge* mObjectHostQueryCount;
+    Trace::MetricGauge* mServerQueryCount;
 
 }; //class Proximity
 
@@ -0,0 +1,37 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SPACE_QUERY_SHARD_ASSIGNMENT_HPP_
+#define _SIRIKATA_SPACE_QUERY_SHARD_ASSIGNMENT_HPP_
+
+#include <sirikata/space/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+
+namespace Sirikata {
+
+/** Assigns queriers to object query shards. Every shard replicates all the
+ *  objects and evaluates only the queries assigned to it, so the results a
+ *  querier gets don't depend on the number of shards. A querier is always
+ *  assigned to the same shard, so all of its requests and results are handled
+ *  in one place.
+ */
+class SIRIKATA_SPACE_EXPORT QueryShardAssignment {
+public:
+    // At least one shard is always used
+    QueryShardAssignment(uint32 nshards);
+
+    uint32 size() const { return mNumShards; }
+
+    /** Get the index of the shard, in [0, size()), that handles querier's
+     *  queries.
+     */
+    uint32 shard(const UUID& querier) const;
+
+private:
+    const uint32 mNumShards;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_QUERY_SHARD_ASSIGNMENT_HPP_
@@ -59,6 +59,7 @@ typedef uint16 ServerMessagePort;
 #define SERVER_PORT_OSEG_MIGRATE_ACKNOWLEDGE   9
 #define SERVER_PORT_OSEG_UPDATE                15
 #define SERVER_PORT_FORWARDER_WEIGHT_UPDATE    16
+#define SERVER_PORT_OSEG_PARTITION             17
 #define SERVER_PORT_UNPROCESSED_PACKET         0xFFFF
 
 /** Base class for messages that go over the network.  Must provide
@@ -66,6 +67,17 @@ typedef uint16 ServerMessagePort;
  */
 class SIRIKATA_SPACE_EXPORT Message {
 public:
+    /** How a Message is encoded between space servers. ProtobufFraming
+     *  serializes the whole Message as a ServerMessage. BinaryFraming writes a
+     *  small fixed header followed by the payload bytes, so the payload isn't
+     *  encoded a second time and the receiver only has to decode the header.
+     *  deserialize() accepts either.
+     */
+    enum Framing {
+        ProtobufFraming,
+        BinaryFraming
+    };
+
     Message(const ServerID& origin);
     Message(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port);
     Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const std::string& pl);
@@ -93,6 +105,13 @@ public:
     std::string payload() const { return mImpl.payload(); }
     void set_payload(const std::string& pl) { mImpl.set_payload(pl); }
 
+    /** For messages wrapping an ObjectMessage, the destination object of that
+     *  message. It is carried in the binary framing header so receivers can
+     *  make routing decisions without parsing the payload.
+     */
+    bool has_dest_object() const { return mHasDestObject; }
+    const UUID& dest_object() const { return mDestObject; }
+
 
     bool ParseFromString(const std::string& data) {
         return mImpl.ParseFromString(data);
@@ -105,10 +124,19 @@ public:
     bool serialize(Network::Chunk* result) const;
     static Message* deserialize(const Network::Chunk& wire);
 
+    bool serialize(Network::Chunk* result, Framing framing) const;
+
     // Deprecated. Remains for backwards compatibility.
     uint32 serializedSize() const;
     uint32 size() const { return serializedSize(); }
 
+    // Messages are created and destroyed for every packet between servers, so
+    // their storage is recycled through per-thread free lists.
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+    /// The number of times a Message couldn't reuse recycled storage
+    static uint64 allocations();
+
 protected:
     // Note: Should only be used for deserialization to ensure unique ID's are handled properly
     Message();
@@ -120,8 +148,13 @@ private:
     void fillMessage(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port);
     void fillMessage(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port, const std::string& pl);
 
+    bool serializeBinary(Network::Chunk* result) const;
+    bool deserializeBinary(const Network::Chunk& wire);
+
     Sirikata::Protocol::Server::ServerMessage mImpl;
     mutable uint32 mCachedSize;
+    bool mHasDestObject;
+    UUID mDestObject;
 }; // class Message
 
 
@@ -0,0 +1,197 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SPACE_SHARED_SERVER_QUERIES_HPP_
+#define _SIRIKATA_SPACE_SHARED_SERVER_QUERIES_HPP_
+
+#include <sirikata/space/Platform.hpp>
+#include <sirikata/core/util/UUID.hpp>
+#include <algorithm>
+#include <iterator>
+
+namespace Sirikata {
+
+/** Current results of a query evaluated once on behalf of one or more
+ *  servers. Results are kept separately for each object class, since an object
+ *  changing class may be added to one class's query before it is removed from
+ *  the other's.
+ */
+class SharedQueryResults {
+public:
+    typedef std::set<UUID> ObjectSet;
+
+    SharedQueryResults(uint32 nclasses)
+     : mResults(nclasses),
+       mEvaluated(false)
+    {}
+    virtual ~SharedQueryResults() {}
+
+    void addResult(uint32 klass, const UUID& objid) {
+        mResults[klass].insert(objid);
+    }
+    void removeResult(uint32 klass, const UUID& objid) {
+        mResults[klass].erase(objid);
+    }
+    // Results of all object classes
+    void getResults(ObjectSet* results_out) const {
+        for(uint32 i = 0; i < mResults.size(); i++)
+            results_out->insert(mResults[i].begin(), mResults[i].end());
+    }
+
+    // Whether the query has been through a tick, i.e. whether the results
+    // reflect what it covers
+    bool evaluated() const { return mEvaluated; }
+    void markEvaluated() { mEvaluated = true; }
+
+private:
+    std::vector<ObjectSet> mResults;
+    bool mEvaluated;
+};
+
+/** Tracks which shared query each server is assigned to and keeps servers'
+ *  results in sync as they move between queries. SharedQuery must derive from
+ *  SharedQueryResults. Servers already have the results of the query they
+ *  were in, so moving only sends them the difference, via the DeltaCallback.
+ *
+ *  A query which hasn't been evaluated yet doesn't know its results, so a
+ *  server moving to one stays in, and keeps getting results from, the query
+ *  it came from until finishMoves() is called after the next tick. This way
+ *  it never sees all its results removed and then added back.
+ *
+ *  The LeaveCallback is invoked when a server no longer needs a query's
+ *  results, so the owner can remove it from the query's members and destroy
+ *  the query if it was the last one.
+ */
+template<typename SharedQuery>
+class SharedServerQueries {
+public:
+    typedef SharedQueryResults::ObjectSet ObjectSet;
+    typedef std::set<SharedQuery*> QuerySet;
+    typedef std::tr1::function<void(const ServerID&, const ObjectSet& additions, const ObjectSet& removals)> DeltaCallback;
+    typedef std::tr1::function<void(SharedQuery*, const ServerID&)> LeaveCallback;
+
+    SharedServerQueries(const DeltaCallback& delta_cb, const LeaveCallback& leave_cb)
+     : mDeltaCallback(delta_cb),
+       mLeaveCallback(leave_cb)
+    {}
+
+    // All shared queries. They are owned by the caller, which adds and
+    // removes them as they are created and destroyed.
+    const QuerySet& queries() const { return mQueries; }
+    void addQuery(SharedQuery* sq) { mQueries.insert(sq); }
+    void removeQuery(SharedQuery* sq) { mQueries.erase(sq); }
+
+    uint32 numServers() const { return mAssignments.size(); }
+
+    // The query server is assigned to, or NULL
+    SharedQuery* assigned(const ServerID& server) const {
+        typename AssignmentMap::const_iterator it = mAssignments.find(server);
+        return (it != mAssignments.end() ? it->second : NULL);
+    }
+
+    /** Assign server to target, sending it the changes to its results and
+     *  leaving the queries it no longer needs.
+     */
+    void assign(const ServerID& server, SharedQuery* target) {
+        SharedQuery* current = assigned(server);
+        if (current == target) return;
+        mAssignments[server] = target;
+
+        // The query whose results the server has, which is only different
+        // from current if it was already waiting to move to current
+        SharedQuery* shown = current;
+        typename AssignmentMap::iterator move_it = mMoves.find(server);
+        if (move_it != mMoves.end()) {
+            shown = move_it->second;
+            mMoves.erase(move_it);
+        }
+
+        bool waiting = (shown != NULL && shown != target && !target->evaluated());
+        if (waiting)
+            mMoves[server] = shown;
+        else if (shown != target)
+            sendMoveDelta(server, shown, target);
+
+        if (current != NULL && current != shown)
+            mLeaveCallback(current, server);
+        if (shown != NULL && shown != target && !waiting)
+            mLeaveCallback(shown, server);
+    }
+
+    // Remove server from its query and any query it is moving away from
+    void remove(const ServerID& server) {
+        typename AssignmentMap::iterator it = mAssignments.find(server);
+        if (it != mAssignments.end()) {
+            SharedQuery* sq = it->second;
+            mAssignments.erase(it);
+            mLeaveCallback(sq, server);
+        }
+        typename AssignmentMap::iterator move_it = mMoves.find(server);
+        if (move_it != mMoves.end()) {
+            SharedQuery* sq = move_it->second;
+            mMoves.erase(move_it);
+            mLeaveCallback(sq, server);
+        }
+    }
+
+    // Whether member of sq should be sent sq's results. Servers still moving
+    // between queries only get results from the one they're moving away from.
+    bool receivesResults(const SharedQuery* sq, const ServerID& member) const {
+        typename AssignmentMap::const_iterator move_it = mMoves.find(member);
+        return (move_it == mMoves.end() || move_it->second == sq);
+    }
+
+    /** Call after every query has been through a tick. Switches servers
+     *  waiting on new queries over to them.
+     */
+    void finishMoves() {
+        for(typename QuerySet::iterator it = mQueries.begin(); it != mQueries.end(); it++)
+            (*it)->markEvaluated();
+
+        AssignmentMap moves;
+        moves.swap(mMoves);
+        for(typename AssignmentMap::iterator it = moves.begin(); it != moves.end(); it++) {
+            SharedQuery* target = assigned(it->first);
+            assert(target != NULL);
+            sendMoveDelta(it->first, it->second, target);
+            mLeaveCallback(it->second, it->first);
+        }
+    }
+
+private:
+    typedef std::tr1::unordered_map<ServerID, SharedQuery*> AssignmentMap;
+
+    // Sends server the changes needed to go from from's results (or nothing if
+    // NULL) to to's results
+    void sendMoveDelta(const ServerID& server, const SharedQuery* from, const SharedQuery* to) {
+        ObjectSet old_results, new_results, additions, removals;
+        if (from != NULL)
+            from->getResults(&old_results);
+        to->getResults(&new_results);
+        std::set_difference(
+            new_results.begin(), new_results.end(),
+            old_results.begin(), old_results.end(),
+            std::inserter(additions, additions.end())
+        );
+        std::set_difference(
+            old_results.begin(), old_results.end(),
+            new_results.begin(), new_results.end(),
+            std::inserter(removals, removals.end())
+        );
+        mDeltaCallback(server, additions, removals);
+    }
+
+    DeltaCallback mDeltaCallback;
+    LeaveCallback mLeaveCallback;
+
+    QuerySet mQueries;
+    AssignmentMap mAssignments;
+    // Servers which moved to a query that hasn't been evaluated yet, and the
+    // query they're moving away from
+    AssignmentMap mMoves;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_SPACE_SHARED_SERVER_QUERIES_HPP_
@@ -0,0 +1,653 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "PartitionedObjectSegmentation.hpp"
+
+#define PARTOSEG_LOG(lvl,msg) SILOG(partitioned_oseg, lvl, msg)
+
+namespace Sirikata {
+
+using Sirikata::Protocol::OSeg::PartitionMessage;
+
+namespace {
+
+// Keeps rebalancing messages reasonably small
+const uint32 MAX_TRANSFER_ENTRIES = 256;
+
+// Number of times a request is sent before giving up on it
+const uint32 MAX_REQUEST_ATTEMPTS = 3;
+
+OSegEntry entryFromMessage(const PartitionMessage& msg, int32 idx) {
+    ServerID server = msg.entries(idx).servid_obj_on();
+    if (server == NullServerID) return OSegEntry::null();
+    return OSegEntry(server, msg.entries(idx).m_objradius());
+}
+
+void addEntry(PartitionMessage* msg, const UUID& obj_id, const OSegEntry& entry) {
+    Sirikata::Protocol::OSeg::IPartitionEntry pentry = msg->add_entries();
+    pentry.set_m_objid(obj_id);
+    pentry.set_servid_obj_on(entry.server());
+    pentry.set_m_objradius(entry.radius());
+}
+
+} // namespace
+
+PartitionedObjectSegmentation::PartitionedObjectSegmentation(SpaceContext* con, Network::IOStrand* o_strand, CoordinateSegmentation* cseg, OSegCache* cache, uint32 virtual_nodes, bool replicate, const Duration& request_timeout)
+ : ObjectSegmentation(con, o_strand),
+   mCSeg(cseg),
+   mCache(cache),
+   mRequestTimeout(request_timeout),
+   mRing(virtual_nodes, replicate),
+   mTimeoutCheckScheduled(false),
+   mSendScheduled(false)
+{
+    mContext->serverDispatcher()->registerMessageRecipient(SERVER_PORT_OSEG_PARTITION, this);
+    mCSeg->addListener(this);
+}
+
+PartitionedObjectSegmentation::~PartitionedObjectSegmentation() {
+    mCSeg->removeListener(this);
+    mContext->serverDispatcher()->unregisterMessageRecipient(SERVER_PORT_OSEG_PARTITION, this);
+
+    for(std::deque<Message*>::iterator it = mOutgoing.begin(); it != mOutgoing.end(); it++)
+        delete *it;
+}
+
+void PartitionedObjectSegmentation::start() {
+    ObjectSegmentation::start();
+
+    // Until we hear otherwise, servers are numbered 1 to numServers()
+    ServerSet servers;
+    uint32 nservers = mCSeg->numServers();
+    for(uint32 i = 1; i <= nservers; i++)
+        servers.insert(i);
+    handleMembershipChange(servers);
+}
+
+void PartitionedObjectSegmentation::updatedSegmentation(CoordinateSegmentation* cseg, const std::vector<SegmentationInfo>& new_segmentation) {
+    ServerSet servers;
+    for(uint32 i = 0; i < new_segmentation.size(); i++)
+        servers.insert(new_segmentation[i].server);
+
+    // May be invoked from another thread
+    mContext->mainStrand->post(
+        std::tr1::bind(&PartitionedObjectSegmentation::handleMembershipChange, this, servers),
+        "PartitionedObjectSegmentation::handleMembershipChange"
+    );
+}
+
+void PartitionedObjectSegmentation::handleMembershipChange(const ServerSet& servers) {
+    if (mStopping || servers == mRing.servers()) return;
+
+    PARTOSEG_LOG(info, "Rebalancing for " << servers.size() << " servers");
+
+    ConsistentHashRing old_ring(mRing);
+    mRing.setServers(servers);
+
+    // Push entries to new holders, then drop the ones we're no longer
+    // responsible for
+    typedef std::map<ServerID, PartitionMessage> TransferMap;
+    TransferMap transfers;
+    uint32 transferred = 0, dropped = 0;
+    std::vector<ServerID> dests;
+    for(OSegMap::iterator it = mStore.begin(); it != mStore.end(); ) {
+        dests.clear();
+        bool keep = mRing.rebalance(old_ring, mContext->id(), it->first, &dests);
+        for(uint32 i = 0; i < dests.size(); i++) {
+            ServerID dest = dests[i];
+            PartitionMessage& transfer = transfers[dest];
+            if (transfer.entries_size() == 0) transfer.set_op(PartitionMessage::Transfer);
+            addEntry(&transfer, it->first, it->second);
+            transferred++;
+            if ((uint32)transfer.entries_size() >= MAX_TRANSFER_ENTRIES) {
+                send(dest, transfer);
+                transfers.erase(dest);
+            }
+        }
+
+        if (!keep) {
+            mStore.erase(it++);
+            dropped++;
+        }
+        else {
+            it++;
+        }
+    }
+    for(TransferMap::iterator it = transfers.begin(); it != transfers.end(); it++)
+        send(it->first, it->second);
+
+    PARTOSEG_LOG(info, "Transferred " << transferred << " entries, dropped " << dropped << ", storing " << mStore.size());
+}
+
+OSegEntry PartitionedObjectSegmentation::cacheLookup(const UUID& obj_id) {
+    // We only check the cache for statistics purposes
+    return mCache->get(obj_id);
+}
+
+OSegEntry PartitionedObjectSegmentation::lookup(const UUID& obj_id) {
+    OSegMap::const_iterator it = mLocal.find(obj_id);
+    if (it != mLocal.end()) return it->second;
+    it = mStore.find(obj_id);
+    if (it != mStore.end()) return it->second;
+
+    if (mStopping) return OSegEntry::null();
+
+    // The answer to an outstanding request completes this lookup too
+    if (mPendingLookups.find(obj_id) != mPendingLookups.end())
+        return OSegEntry::null();
+
+    if (!sendLookup(obj_id)) {
+        // Nobody else to ask. Lookups which return null are expected to
+        // complete later, so report the failure asynchronously.
+        mContext->mainStrand->post(
+            std::tr1::bind(&PartitionedObjectSegmentation::finishLookup, this, obj_id, OSegEntry::null()),
+            "PartitionedObjectSegmentation::finishLookup"
+        );
+        return OSegEntry::null();
+    }
+
+    trackRequest(&mPendingLookups, obj_id);
+    return OSegEntry::null();
+}
+
+bool PartitionedObjectSegmentation::sendLookup(const UUID& obj_id) {
+    ServerID primary, replica;
+    mRing.owners(obj_id, &primary, &replica);
+
+    ServerID target = primary;
+    PartitionMessage msg;
+    msg.set_op(PartitionMessage::Lookup);
+    addEntry(&msg, obj_id, OSegEntry::null());
+    if (primary == mContext->id()) {
+        // We should have it, but if our range just moved here the replica,
+        // which used to own it, may not have transferred it yet.
+        target = replica;
+        msg.set_forwarded(true);
+        msg.set_requester(mContext->id());
+    }
+
+    if (target == NullServerID || target == mContext->id())
+        return false;
+
+    send(target, msg);
+    return true;
+}
+
+void PartitionedObjectSegmentation::finishLookup(const UUID& obj_id, const OSegEntry& entry) {
+    if (mStopping) return;
+
+    if (!entry.isNull()) mCache->insert(obj_id, entry);
+    mLookupListener->osegLookupCompleted(obj_id, entry);
+}
+
+void PartitionedObjectSegmentation::addNewObject(const UUID& obj_id, float radius) {
+    if (mStopping) return;
+
+    OSegEntry entry(mContext->id(), radius);
+    mLocal[obj_id] = entry;
+
+    if (sendAddNew(obj_id, entry))
+        trackRequest(&mPendingAdds, obj_id);
+    else
+        finishAddNew(obj_id, storeNew(obj_id, entry));
+}
+
+bool PartitionedObjectSegmentation::sendAddNew(const UUID& obj_id, const OSegEntry& entry) {
+    ServerID primary, replica;
+    mRing.owners(obj_id, &primary, &replica);
+    if (primary == NullServerID || primary == mContext->id())
+        return false;
+
+    sendEntry(primary, PartitionMessage::AddNew, obj_id, entry);
+    return true;
+}
+
+void PartitionedObjectSegmentation::addNewObjects(const NewObjectList& objects) {
+    if (mStopping) return;
+
+    // Entries owned by other servers are sent in one AddNew per server
+    typedef std::map<ServerID, PartitionMessage> RemoteAddMap;
+    RemoteAddMap remote_adds;
+    for(NewObjectList::const_iterator it = objects.begin(); it != objects.end(); it++) {
+        OSegEntry entry(mContext->id(), it->second);
+        mLocal[it->first] = entry;
+
+        ServerID primary, replica;
+        mRing.owners(it->first, &primary, &replica);
+        if (primary == NullServerID || primary == mContext->id()) {
+            finishAddNew(it->first, storeNew(it->first, entry));
+        }
+        else {
+            trackRequest(&mPendingAdds, it->first);
+            PartitionMessage& msg = remote_adds[primary];
+            msg.set_op(PartitionMessage::AddNew);
+            addEntry(&msg, it->first, entry);
+            if ((uint32)msg.entries_size() >= MAX_TRANSFER_ENTRIES) {
+                send(primary, msg);
+                remote_adds.erase(primary);
+            }
+        }
+    }
+
+    for(RemoteAddMap::iterator it = remote_adds.begin(); it != remote_adds.end(); it++)
+        send(it->first, it->second);
+}
+
+void PartitionedObjectSegmentation::finishAddNew(const UUID& obj_id, OSegWriteListener::OSegAddNewStatus status) {
+    if (mStopping) return;
+
+    OSegMap::iterator it = mLocal.find(obj_id);
+    if (status == OSegWriteListener::SUCCESS) {
+        if (it != mLocal.end())
+            mCache->insert(obj_id, it->second);
+    }
+    else {
+        PARTOSEG_LOG(error, "Failed to register new object " << obj_id.toString() << " with status " << (int)status);
+        if (it != mLocal.end())
+            mLocal.erase(it);
+    }
+
+    mWriteListener->osegAddNewFinished(obj_id, status);
+}
+
+void PartitionedObjectSegmentation::addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool generateAck) {
+    if (mStopping) return;
+
+    OSegEntry entry(mContext->id(), radius);
+    mLocal[obj_id] = entry;
+    ServerID ack_to = (generateAck ? idServerAckTo : NullServerID);
+
+    if (sendAddMigrated(obj_id, entry, ack_to)) {
+        trackRequest(&mPendingMigrations, obj_id, ack_to);
+    }
+    else {
+        store(obj_id, entry);
+        finishAddMigrated(obj_id, ack_to);
+    }
+}
+
+bool PartitionedObjectSegmentation::sendAddMigrated(const UUID& obj_id, const OSegEntry& entry, ServerID ack_to) {
+    ServerID primary, replica;
+    mRing.owners(obj_id, &primary, &replica);
+    if (primary == NullServerID || primary == mContext->id())
+        return false;
+
+    PartitionMessage msg;
+    msg.set_op(PartitionMessage::AddMigrated);
+    addEntry(&msg, obj_id, entry);
+    msg.set_ack_to(ack_to);
+    send(primary, msg);
+    return true;
+}
+
+void PartitionedObjectSegmentation::finishAddMigrated(const UUID& obj_id, ServerID ack_to) {
+    if (mStopping) return;
+
+    OSegMap::iterator it = mLocal.find(obj_id);
+    if (it == mLocal.end()) return;
+    mCache->insert(obj_id, it->second);
+
+    if (ack_to != NullServerID) {
+        Sirikata::Protocol::OSeg::MigrateMessageAcknowledge oseg_ack_msg;
+        oseg_ack_msg.set_m_servid_from(mContext->id());
+        oseg_ack_msg.set_m_servid_to(ack_to);
+        oseg_ack_msg.set_m_message_destination(ack_to);
+        oseg_ack_msg.set_m_message_from(mContext->id());
+        oseg_ack_msg.set_m_objid(obj_id);
+        oseg_ack_msg.set_m_objradius( it->second.radius() );
+        queueMigAck(oseg_ack_msg);
+    }
+}
+
+void PartitionedObjectSegmentation::removeObject(const UUID& obj_id) {
+    if (mStopping) return;
+
+    mLocal.erase(obj_id);
+
+    ServerID primary, replica;
+    mRing.owners(obj_id, &primary, &replica);
+    if (primary == NullServerID || primary == mContext->id())
+        storeRemove(obj_id, mContext->id());
+    else
+        sendEntry(primary, PartitionMessage::Remove, obj_id, OSegEntry(mContext->id(), 0));
+}
+
+bool PartitionedObjectSegmentation::clearToMigrate(const UUID& obj_id) {
+    if (mStopping) return false;
+
+    // If we don't have it, it's either already migrating away or hasn't
+    // finished migrating here
+    return (mLocal.find(obj_id) != mLocal.end());
+}
+
+void PartitionedObjectSegmentation::migrateObject(const UUID& obj_id, const OSegEntry& new_server_id) {
+    if (mStopping) return;
+
+    // The new server is responsible for updating the entry
+    mLocal.erase(obj_id);
+}
+
+void PartitionedObjectSegmentation::handleMigrateMessageAck(const Sirikata::Protocol::OSeg::MigrateMessageAcknowledge& msg) {
+    if (mStopping) return;
+
+    OSegEntry data(msg.m_servid_from(), msg.m_objradius());
+    UUID obj_id = msg.m_objid();
+
+    mCache->insert(obj_id, data);
+
+    // Finally, this lets the server know the migration has been acked and the
+    // object can disconnect
+    mWriteListener->osegMigrationAcknowledged(obj_id);
+}
+
+void PartitionedObjectSegmentation::handleUpdateOSegMessage(const Sirikata::Protocol::OSeg::UpdateOSegMessage& update_oseg_msg) {
+    // Just a cache invalidation/update
+    mCache->insert(update_oseg_msg.m_objid(), OSegEntry(update_oseg_msg.servid_obj_on(), update_oseg_msg.m_objradius()));
+}
+
+OSegWriteListener::OSegAddNewStatus PartitionedObjectSegmentation::storeNew(const UUID& obj_id, const OSegEntry& entry) {
+    // The same server registering the object again is a retry of a request
+    // whose response was lost
+    OSegMap::iterator it = mStore.find(obj_id);
+    if (it != mStore.end())
+        return (it->second.server() == entry.server()) ? OSegWriteListener::SUCCESS : OSegWriteListener::OBJ_ALREADY_REGISTERED;
+    store(obj_id, entry);
+    return OSegWriteListener::SUCCESS;
+}
+
+void PartitionedObjectSegmentation::store(const UUID& obj_id, const OSegEntry& entry) {
+    mStore[obj_id] = entry;
+
+    ServerID primary, replica;
+    mRing.owners(obj_id, &primary, &replica);
+    if (replica != NullServerID && replica != mContext->id())
+        sendEntry(replica, PartitionMessage::Replicate, obj_id, entry);
+}
+
+void PartitionedObjectSegmentation::storeRemove(const UUID& obj_id, ServerID server) {
+    // Only the server the object is on may remove it, so a late removal from
+    // a server the object has since migrated away from is ignored
+    OSegMap::iterator it = mStore.find(obj_id);
+    if (it == mStore.end() || it->second.server() != server) return;
+    mStore.erase(it);
+
+    ServerID primary, replica;
+    mRing.owners(obj_id, &primary, &replica);
+    if (replica != NullServerID && replica != mContext->id())
+        sendEntry(replica, PartitionMessage::ReplicateRemove, obj_id, OSegEntry(server, 0));
+}
+
+void PartitionedObjectSegmentation::receiveMessage(Message* msg) {
+    if (msg->dest_port() != SERVER_PORT_OSEG_PARTITION) {
+        ObjectSegmentation::receiveMessage(msg);
+        return;
+    }
+
+    PartitionMessage partition_msg;
+    bool parsed = parsePBJMessage(&partition_msg, msg->payload());
+    if (parsed && !mStopping)
+        handlePartitionMessage(msg->source_server(), partition_msg);
+    delete msg;
+}
+
+void PartitionedObjectSegmentation::handlePartitionMessage(ServerID source, const PartitionMessage& msg) {
+    bool batched_op = (msg.op() == PartitionMessage::Transfer || msg.op() == PartitionMessage::AddNew || msg.op() == PartitionMessage::AddNewResponse);
+    if (!batched_op && msg.entries_size() != 1) {
+        PARTOSEG_LOG(error, "Ignoring partition message with " << msg.entries_size() << " entries from " << source);
+        return;
+    }
+
+    switch(msg.op()) {
+      case PartitionMessage::Lookup:
+        handleLookup(source, msg);
+        break;
+      case PartitionMessage::LookupResponse:
+        // Responses to requests which already timed out have nobody waiting
+        if (mPendingLookups.erase(msg.entries(0).m_objid()) > 0)
+            finishLookup(msg.entries(0).m_objid(), entryFromMessage(msg, 0));
+        break;
+      case PartitionMessage::AddNew:
+        {
+            PartitionMessage response;
+            response.set_op(PartitionMessage::AddNewResponse);
+            for(int32 i = 0; i < msg.entries_size(); i++) {
+                UUID obj_id = msg.entries(i).m_objid();
+                addEntry(&response, obj_id, entryFromMessage(msg, i));
+                response.add_success( storeNew(obj_id, entryFromMessage(msg, i)) == OSegWriteListener::SUCCESS );
+            }
+            send(source, response);
+        }
+        break;
+      case PartitionMessage::AddNewResponse:
+        for(int32 i = 0; i < msg.entries_size(); i++) {
+            if (mPendingAdds.erase(msg.entries(i).m_objid()) == 0) continue;
+            bool success = i < msg.success_size() && msg.success(i);
+            finishAddNew(
+                msg.entries(i).m_objid(),
+                success ? OSegWriteListener::SUCCESS : OSegWriteListener::OBJ_ALREADY_REGISTERED
+            );
+        }
+        break;
+      case PartitionMessage::AddMigrated:
+        {
+            UUID obj_id = msg.entries(0).m_objid();
+            store(obj_id, entryFromMessage(msg, 0));
+            PartitionMessage response;
+            response.set_op(PartitionMessage::AddMigratedResponse);
+            addEntry(&response, obj_id, entryFromMessage(msg, 0));
+            response.set_ack_to(msg.ack_to());
+            send(source, response);
+        }
+        break;
+      case PartitionMessage::AddMigratedResponse:
+        if (mPendingMigrations.erase(msg.entries(0).m_objid()) > 0)
+            finishAddMigrated(msg.entries(0).m_objid(), msg.ack_to());
+        break;
+      case PartitionMessage::Remove:
+        storeRemove(msg.entries(0).m_objid(), msg.entries(0).servid_obj_on());
+        break;
+      case PartitionMessage::Replicate:
+        mStore[msg.entries(0).m_objid()] = entryFromMessage(msg, 0);
+        break;
+      case PartitionMessage::ReplicateRemove:
+        {
+            OSegMap::iterator it = mStore.find(msg.entries(0).m_objid());
+            if (it != mStore.end() && it->second.server() == msg.entries(0).servid_obj_on())
+                mStore.erase(it);
+        }
+        break;
+      case PartitionMessage::Transfer:
+        // Writes since the ring changed are newer than transferred entries,
+        // so never overwrite
+        for(int32 i = 0; i < msg.entries_size(); i++)
+            mStore.insert( OSegMap::value_type(msg.entries(i).m_objid(), entryFromMessage(msg, i)) );
+        break;
+      default:
+        PARTOSEG_LOG(error, "Unknown partition message operation " << (int)msg.op() << " from " << source);
+        break;
+    }
+}
+
+void PartitionedObjectSegmentation::handleLookup(ServerID source, const PartitionMessage& msg) {
+    UUID obj_id = msg.entries(0).m_objid();
+    ServerID requester = msg.has_requester() ? (ServerID)msg.requester() : source;
+
+    OSegEntry entry = OSegEntry::null();
+    OSegMap::const_iterator it = mLocal.find(obj_id);
+    if (it != mLocal.end()) {
+        entry = it->second;
+    }
+    else {
+        it = mStore.find(obj_id);
+        if (it != mStore.end()) entry = it->second;
+    }
+
+    if (entry.isNull() && !(msg.has_forwarded() && msg.forwarded())) {
+        // Either our range just moved here and the replica may still have the
+        // entry, or the requester's ring disagrees with ours. Try once more.
+        ServerID primary, replica;
+        mRing.owners(obj_id, &primary, &replica);
+        ServerID target = (primary == mContext->id()) ? replica : primary;
+        if (target != NullServerID && target != mContext->id() && target != requester) {
+            PartitionMessage forward;
+            forward.set_op(PartitionMessage::Lookup);
+            addEntry(&forward, obj_id, OSegEntry::null());
+            forward.set_forwarded(true);
+            forward.set_requester(requester);
+            send(target, forward);
+            return;
+        }
+    }
+
+    sendEntry(requester, PartitionMessage::LookupResponse, obj_id, entry);
+}
+
+void PartitionedObjectSegmentation::trackRequest(PendingRequestMap* requests, const UUID& obj_id, ServerID ack_to) {
+    PendingRequest& req = (*requests)[obj_id];
+    req.sent = mContext->simTime();
+    req.attempts++;
+    req.ackTo = ack_to;
+    scheduleTimeoutCheck();
+}
+
+void PartitionedObjectSegmentation::scheduleTimeoutCheck() {
+    if (mTimeoutCheckScheduled) return;
+    mTimeoutCheckScheduled = true;
+    mContext->mainStrand->post(
+        mRequestTimeout,
+        std::tr1::bind(&PartitionedObjectSegmentation::checkTimeouts, this),
+        "PartitionedObjectSegmentation::checkTimeouts"
+    );
+}
+
+void PartitionedObjectSegmentation::checkTimeouts() {
+    mTimeoutCheckScheduled = false;
+    if (mStopping) return;
+
+    Time now = mContext->simTime();
+    PendingRequestMap* all_requests[3] = { &mPendingLookups, &mPendingAdds, &mPendingMigrations };
+    for(uint32 r = 0; r < 3; r++) {
+        PendingRequestMap* requests = all_requests[r];
+
+        // Retries update the requests, so collect the expired ones first
+        std::vector<UUID> expired;
+        for(PendingRequestMap::iterator it = requests->begin(); it != requests->end(); it++) {
+            if (now - it->second.sent >= mRequestTimeout)
+                expired.push_back(it->first);
+        }
+
+        for(uint32 i = 0; i < expired.size(); i++) {
+            const UUID& obj_id = expired[i];
+            PendingRequest req = (*requests)[obj_id];
+            bool retry = (req.attempts < MAX_REQUEST_ATTEMPTS);
+            // Membership may have changed since the request was sent, so
+            // retries go to whoever is responsible now. If that's us, the
+            // request completes immediately.
+            if (requests == &mPendingLookups) {
+                if (retry && sendLookup(obj_id)) {
+                    trackRequest(requests, obj_id);
+                    continue;
+                }
+                requests->erase(obj_id);
+                PARTOSEG_LOG(warn, "Lookup of " << obj_id.toString() << " failed after " << req.attempts << " attempts");
+                finishLookup(obj_id, OSegEntry::null());
+            }
+            else if (requests == &mPendingAdds) {
+                OSegMap::iterator local_it = mLocal.find(obj_id);
+                if (local_it == mLocal.end()) {
+                    // Removed while the request was outstanding
+                    requests->erase(obj_id);
+                    continue;
+                }
+                OSegEntry entry = local_it->second;
+                if (retry && sendAddNew(obj_id, entry)) {
+                    trackRequest(requests, obj_id);
+                    continue;
+                }
+                requests->erase(obj_id);
+                if (retry) {
+                    finishAddNew(obj_id, storeNew(obj_id, entry));
+                    continue;
+                }
+                // The primary may have stored the entry, so make sure it
+                // doesn't outlive the failure
+                ServerID primary, replica;
+                mRing.owners(obj_id, &primary, &replica);
+                if (primary != NullServerID && primary != mContext->id())
+                    sendEntry(primary, PartitionMessage::Remove, obj_id, OSegEntry(mContext->id(), 0));
+                finishAddNew(obj_id, OSegWriteListener::UNKNOWN_ERROR);
+            }
+            else {
+                OSegMap::iterator local_it = mLocal.find(obj_id);
+                if (local_it == mLocal.end()) {
+                    requests->erase(obj_id);
+                    continue;
+                }
+                OSegEntry entry = local_it->second;
+                if (retry && sendAddMigrated(obj_id, entry, req.ackTo)) {
+                    trackRequest(requests, obj_id, req.ackTo);
+                    continue;
+                }
+                requests->erase(obj_id);
+                if (retry) {
+                    store(obj_id, entry);
+                    finishAddMigrated(obj_id, req.ackTo);
+                    continue;
+                }
+                // Nothing to report the failure to, the migration can't be
+                // undone. Lookups sent here still find the object.
+                PARTOSEG_LOG(error, "Failed to register migrated object " << obj_id.toString() << " after " << req.attempts << " attempts");
+            }
+        }
+    }
+
+    if (!mPendingLookups.empty() || !mPendingAdds.empty() || !mPendingMigrations.empty())
+        scheduleTimeoutCheck();
+}
+
+void PartitionedObjectSegmentation::sendEntry(ServerID dest, PartitionMessage::Operation op, const UUID& obj_id, const OSegEntry& entry) {
+    PartitionMessage msg;
+    msg.set_op(op);
+    addEntry(&msg, obj_id, entry);
+    send(dest, msg);
+}
+
+void PartitionedObjectSegmentation::send(ServerID dest, const PartitionMessage& msg) {
+    mOutgoing.push_back(
+        new Message(
+            mContext->id(),
+            SERVER_PORT_OSEG_PARTITION,
+            dest,
+            SERVER_PORT_OSEG_PARTITION,
+            serializePBJMessage(msg)
+        )
+    );
+    // Otherwise a retry is already scheduled
+    if (!mSendScheduled)
+        trySend();
+}
+
+void PartitionedObjectSegmentation::trySend() {
+    mSendScheduled = false;
+    if (mStopping) return;
+
+    while(!mOutgoing.empty()) {
+        bool sent = mOSegServerMessageService->route( mOutgoing.front() );
+        if (!sent)
+            break;
+        mOutgoing.pop_front();
+    }
+
+    if (!mOutgoing.empty() && !mSendScheduled) {
+        // Still have work to do, setup a retry
+        mSendScheduled = true;
+        mContext->mainStrand->post(
+            Duration::microseconds(100),
+            std::tr1::bind(&PartitionedObjectSegmentation::trySend, this),
+            "PartitionedObjectSegmentation::trySend"
+        );
+    }
+}
+
+} // namespace Sirikata
@@ -0,0 +1,129 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_PARTITIONED_OBJECT_SEGMENTATION_HPP_
+#define _SIRIKATA_PARTITIONED_OBJECT_SEGMENTATION_HPP_
+
+#include <sirikata/space/ObjectSegmentation.hpp>
+#include <sirikata/space/ConsistentHashRing.hpp>
+
+namespace Sirikata {
+
+/** An OSeg which needs no external storage: the space servers store the
+ *  entries themselves. Object IDs are hashed onto a consistent hash ring on
+ *  which each server has a number of virtual nodes. The server owning the
+ *  range an object falls in is its primary, which handles all reads and
+ *  writes of its entry and copies them to the next server on the ring, its
+ *  replica. Other servers reach the primary with server to server messages.
+ *
+ *  Membership comes from the CoordinateSegmentation. When servers join or
+ *  leave, entries are pushed to their new primary and replica. Since a
+ *  joining server takes its ranges from the server which follows it on the
+ *  ring, and that server becomes the replica for those ranges, a primary
+ *  which misses on a lookup asks its replica before giving up, covering
+ *  lookups which arrive before the transfer does.
+ *
+ *  Requests to other servers which go unanswered for the request timeout are
+ *  retried against the current ring a few times before failing.
+ *
+ *  All state is only touched from the main strand.
+ */
+class PartitionedObjectSegmentation : public ObjectSegmentation, public CoordinateSegmentation::Listener {
+public:
+    PartitionedObjectSegmentation(SpaceContext* con, Network::IOStrand* o_strand, CoordinateSegmentation* cseg, OSegCache* cache, uint32 virtual_nodes, bool replicate, const Duration& request_timeout);
+    ~PartitionedObjectSegmentation();
+
+    virtual void start();
+
+    virtual OSegEntry cacheLookup(const UUID& obj_id);
+    virtual OSegEntry lookup(const UUID& obj_id);
+
+    virtual void addNewObject(const UUID& obj_id, float radius);
+    virtual void addNewObjects(const NewObjectList& objects);
+    virtual void addMigratedObject(const UUID& obj_id, float radius, ServerID idServerAckTo, bool);
+    virtual void removeObject(const UUID& obj_id);
+
+    virtual bool clearToMigrate(const UUID& obj_id);
+    virtual void migrateObject(const UUID& obj_id, const OSegEntry& new_server_id);
+
+    virtual void handleMigrateMessageAck(const Sirikata::Protocol::OSeg::MigrateMessageAcknowledge& msg);
+    virtual void handleUpdateOSegMessage(const Sirikata::Protocol::OSeg::UpdateOSegMessage& update_oseg_msg);
+
+    // CoordinateSegmentation::Listener Interface
+    virtual void updatedSegmentation(CoordinateSegmentation* cseg, const std::vector<SegmentationInfo>& new_segmentation);
+
+protected:
+    // MessageRecipient Interface
+    virtual void receiveMessage(Message* msg);
+
+private:
+    typedef ConsistentHashRing::ServerSet ServerSet;
+
+    typedef std::tr1::unordered_map<UUID, OSegEntry, UUID::Hasher> OSegMap;
+
+    // A request to another server which hasn't been answered yet
+    struct PendingRequest {
+        PendingRequest()
+         : attempts(0), ackTo(NullServerID)
+        {}
+
+        Time sent;
+        uint32 attempts;
+        // Only used by AddMigrated
+        ServerID ackTo;
+    };
+    typedef std::tr1::unordered_map<UUID, PendingRequest, UUID::Hasher> PendingRequestMap;
+
+    void handleMembershipChange(const ServerSet& servers);
+
+    // Send requests for obj_id to the responsible server, returning false if
+    // there's no other server to ask
+    bool sendLookup(const UUID& obj_id);
+    bool sendAddNew(const UUID& obj_id, const OSegEntry& entry);
+    bool sendAddMigrated(const UUID& obj_id, const OSegEntry& entry, ServerID ack_to);
+    void trackRequest(PendingRequestMap* requests, const UUID& obj_id, ServerID ack_to = NullServerID);
+    void scheduleTimeoutCheck();
+    void checkTimeouts();
+
+    // Operations on the entries this server stores, which replicate
+    // themselves as necessary
+    OSegWriteListener::OSegAddNewStatus storeNew(const UUID& obj_id, const OSegEntry& entry);
+    void store(const UUID& obj_id, const OSegEntry& entry);
+    void storeRemove(const UUID& obj_id, ServerID server);
+
+    void finishLookup(const UUID& obj_id, const OSegEntry& entry);
+    void finishAddNew(const UUID& obj_id, OSegWriteListener::OSegAddNewStatus status);
+    void finishAddMigrated(const UUID& obj_id, ServerID ack_to);
+
+    void handlePartitionMessage(ServerID source, const Sirikata::Protocol::OSeg::PartitionMessage& msg);
+    void handleLookup(ServerID source, const Sirikata::Protocol::OSeg::PartitionMessage& msg);
+
+    void send(ServerID dest, const Sirikata::Protocol::OSeg::PartitionMessage& msg);
+    void sendEntry(ServerID dest, Sirikata::Protocol::OSeg::PartitionMessage::Operation op, const UUID& obj_id, const OSegEntry& entry);
+    void trySend();
+
+    CoordinateSegmentation* mCSeg;
+    OSegCache* mCache;
+    const Duration mRequestTimeout;
+
+    // Objects connected to this server
+    OSegMap mLocal;
+    // Entries for which this server is the primary or replica
+    OSegMap mStore;
+
+    ConsistentHashRing mRing;
+
+    PendingRequestMap mPendingLookups;
+    PendingRequestMap mPendingAdds;
+    PendingRequestMap mPendingMigrations;
+    bool mTimeoutCheckScheduled;
+
+    // Messages waiting for room in the server message queue
+    std::deque<Message*> mOutgoing;
+    bool mSendScheduled;
+};
+
+} // namespace Sirikata
+
+#endif //_SIRIKATA_PARTITIONED_OBJECT_SEGMENTATION_HPP_
@@ -34,6 +34,7 @@
 #include <sirikata/core/options/Options.hpp>
 #include <sirikata/space/ObjectSegmentation.hpp>
 #include "LocalObjectSegmentation.hpp"
+#include "PartitionedObjectSegmentation.hpp"
 #include "LocalPintoServerQuerier.hpp"
 
 static int space_local_plugin_refcount = 0;
@@ -43,6 +44,11 @@ namespace Sirikata {
 static void InitPluginOptions() {
     Sirikata::InitializeClassOptions ico("space_local", NULL,
         NULL);
+    Sirikata::InitializeClassOptions ico_partitioned("space_partitioned_oseg", NULL,
+        new OptionValue("virtual-nodes","64",Sirikata::OptionValueType<uint32>(),"Number of points each server gets on the consistent hash ring. More points spread entries more evenly."),
+        new OptionValue("replicate","true",Sirikata::OptionValueType<bool>(),"If true, each entry is also stored on the next server on the ring."),
+        new OptionValue("request-timeout","1s",Sirikata::OptionValueType<Duration>(),"How long to wait for another server to answer a lookup or registration before retrying it."),
+        NULL);
 }
 
 static ObjectSegmentation* createLocalOSeg(SpaceContext* ctx, Network::IOStrand* oseg_strand, CoordinateSegmentation* cseg, OSegCache* cache, const String& args) {
@@ -52,6 +58,17 @@ static ObjectSegmentation* createLocalOSeg(SpaceContext* ctx, Network::IOStrand*
     return new LocalObjectSegmentation(ctx, oseg_strand, cseg, cache);
 }
 
+static ObjectSegmentation* createPartitionedOSeg(SpaceContext* ctx, Network::IOStrand* oseg_strand, CoordinateSegmentation* cseg, OSegCache* cache, const String& args) {
+    OptionSet* optionsSet = OptionSet::getOptions("space_partitioned_oseg",NULL);
+    optionsSet->parse(args);
+
+    uint32 virtual_nodes = optionsSet->referenceOption("virtual-nodes")->as<uint32>();
+    bool replicate = optionsSet->referenceOption("replicate")->as<bool>();
+    Duration request_timeout = optionsSet->referenceOption("request-timeout")->as<Duration>();
+
+    return new PartitionedObjectSegmentation(ctx, oseg_strand, cseg, cache, virtual_nodes, replicate, request_timeout);
+}
+
 static PintoServerQuerier* createLocalPintoServerQuerier(SpaceContext* ctx, const String& args) {
     OptionSet* optionsSet = OptionSet::getOptions("space_local",NULL);
     optionsSet->parse(args);
@@ -73,6 +90,9 @@ SIRIKATA_PLUGIN_EXPORT_C void init() {
         OSegFactory::getSingleton()
             .registerConstructor("local",
                 std::tr1::bind(&createLocalOSeg, _1, _2, _3, _4, _5));
+        OSegFactory::getSingleton()
+            .registerConstructor("partitioned",
+                std::tr1::bind(&createPartitionedOSeg, _1, _2, _3, _4, _5));
         PintoServerQuerierFactory::getSingleton()
             .registerConstructor("local",
                 std::tr1::bind(&createLocalPintoServerQuerier, _1, _2));
@@ -92,6 +112,7 @@ SIRIKATA_PLUGIN_EXPORT_C void destroy() {
     using namespace Sirikata;
     if (space_local_plugin_refcount==0) {
         OSegFactory::getSingleton().unregisterConstructor("local");
+        OSegFactory::getSingleton().unregisterConstructor("partitioned");
         PintoServerQuerierFactory::getSingleton().unregisterConstructor("local");
     }
 }
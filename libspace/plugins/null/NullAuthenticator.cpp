@@ -45,4 +45,11 @@ void NullAuthenticator::authenticate(const UUID& obj_id, MemoryReference auth, C
     );
 }
 
+void NullAuthenticator::authenticateBatch(const std::vector<UUID>& obj_ids, const std::vector<String>& auths, BatchCallback cb) {
+    mContext->mainStrand->post(
+        std::tr1::bind(cb, std::vector<bool>(obj_ids.size(), true)),
+        "NullAuthenticator::authenticateBatch"
+    );
+}
+
 } // namespace Sirikata
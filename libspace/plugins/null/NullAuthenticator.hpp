@@ -43,6 +43,7 @@ public:
     virtual ~NullAuthenticator() {}
 
     virtual void authenticate(const UUID& obj_id, MemoryReference auth, Callback cb);
+    virtual void authenticateBatch(const std::vector<UUID>& obj_ids, const std::vector<String>& auths, BatchCallback cb);
 
 private:
     SpaceContext* mContext;
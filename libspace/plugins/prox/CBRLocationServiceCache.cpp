@@ -43,7 +43,9 @@ CBRLocationServiceCache::CBRLocationServiceCache(Network::IOStrand* strand, Loca
    mLoc(locservice),
    mListeners(),
    mObjects(),
-   mWithReplicas(replicas)
+   mWithReplicas(replicas),
+   mBulkLoadOrder(BULK_LOAD_NONE),
+   mBulkLoadLeafSize(1)
 {
     assert(mLoc != NULL);
     mLoc->addListener(this, true);
@@ -56,6 +58,43 @@ CBRLocationServiceCache::~CBRLocationServiceCache() {
     mObjects.clear();
 }
 
+void CBRLocationServiceCache::setBulkLoad(BulkLoadOrder order, uint32 leaf_size) {
+    Lock lck(mMutex);
+    assert(mObjects.empty());
+    mBulkLoadOrder = order;
+    mBulkLoadLeafSize = leaf_size;
+}
+
+void CBRLocationServiceCache::announceNewObjects() {
+    Lock lck(mMutex);
+
+    if (mNewObjects.empty()) return;
+
+    typedef BulkLoadEntry<UUID> Entry;
+    std::vector<Entry> entries;
+    entries.reserve(mNewObjects.size());
+    for(std::vector<UUID>::iterator id_it = mNewObjects.begin(); id_it != mNewObjects.end(); id_it++) {
+        ObjectDataMap::iterator it = mObjects.find(*id_it);
+        // Skip objects removed before being announced and duplicates from
+        // objects that were removed and added again
+        if (it == mObjects.end() || !it->second.exists || it->second.announced)
+            continue;
+        it->second.announced = true;
+        entries.push_back(Entry(*id_it, it->second.location.position() + it->second.bounds.centerOffset));
+    }
+    mNewObjects.clear();
+
+    BulkLoadSort(entries, mBulkLoadOrder, mBulkLoadLeafSize);
+
+    for(std::vector<Entry>::iterator entry_it = entries.begin(); entry_it != entries.end(); entry_it++) {
+        ObjectDataMap::iterator it = mObjects.find(entry_it->id);
+        assert(it != mObjects.end());
+        const ObjectData& data = it->second;
+        for(ListenerSet::iterator listen_it = mListeners.begin(); listen_it != mListeners.end(); listen_it++)
+            (*listen_it)->locationConnected(entry_it->id, false, data.isLocal, data.location, data.bounds.centerBounds(), data.bounds.maxObjectRadius);
+    }
+}
+
 void CBRLocationServiceCache::addPlaceholderImposter(
     const ObjectID& uuid,
     const Vector3f& center_offset,
@@ -307,6 +346,7 @@ void CBRLocationServiceCache::objectAdded(const UUID& uuid, bool islocal, bool a
     data.exists = true;
     data.tracking = 0;
     data.isAggregate = agg;
+    data.announced = true;
 
     mStrand->post(
         std::tr1::bind(
@@ -323,6 +363,14 @@ void CBRLocationServiceCache::processObjectAdded(const UUID& uuid, ObjectData da
     if (mObjects.find(uuid) != mObjects.end())
         return;
 
+    // Aggregates are never announced, so only regular objects get batched
+    if (!data.isAggregate && mBulkLoadOrder != BULK_LOAD_NONE) {
+        data.announced = false;
+        mObjects[uuid] = data;
+        mNewObjects.push_back(uuid);
+        return;
+    }
+
     mObjects[uuid] = data;
 
     // TODO(ewencp) at some point, we might want to (optionally) use aggregates
@@ -350,10 +398,12 @@ void CBRLocationServiceCache::processObjectRemoved(const UUID& uuid, bool agg) {
 
     assert(data_it->second.exists);
     data_it->second.exists = false;
+    // Listeners never saw objects that were still waiting to be announced
+    bool announced = data_it->second.announced;
 
     tryRemoveObject(data_it);
 
-    if (!agg)
+    if (!agg && announced)
         for(ListenerSet::iterator it = mListeners.begin(); it != mListeners.end(); it++)
             (*it)->locationDisconnected(uuid);
 }
@@ -377,7 +427,7 @@ void CBRLocationServiceCache::processLocationUpdated(const UUID& uuid, bool agg,
     TimedMotionVector3f oldval = it->second.location;
     it->second.location = newval;
 
-    if (!agg)
+    if (!agg && it->second.announced)
         for(ListenerSet::iterator it = mListeners.begin(); it != mListeners.end(); it++)
             (*it)->locationPositionUpdated(uuid, oldval, newval);
 }
@@ -420,7 +470,7 @@ void CBRLocationServiceCache::processBoundsUpdated(const UUID& uuid, bool agg, c
     AggregateBoundingInfo oldval = it->second.bounds;
     it->second.bounds = newval;
 
-    if (!agg) {
+    if (!agg && it->second.announced) {
         for(ListenerSet::iterator listen_it = mListeners.begin(); listen_it != mListeners.end(); listen_it++) {
             (*listen_it)->locationRegionUpdated(uuid, oldval.centerBounds(), it->second.bounds.centerBounds());
             (*listen_it)->locationMaxSizeUpdated(uuid, oldval.maxObjectRadius, it->second.bounds.maxObjectRadius);
@@ -37,6 +37,7 @@
 #include <sirikata/space/LocationService.hpp>
 #include <prox/base/LocationServiceCache.hpp>
 #include <prox/base/ZernikeDescriptor.hpp>
+#include <sirikata/core/prox/BulkLoad.hpp>
 
 namespace Sirikata {
 
@@ -59,6 +60,17 @@ public:
     CBRLocationServiceCache(Network::IOStrand* strand, LocationService* locservice, bool replicas);
     virtual ~CBRLocationServiceCache();
 
+    /** Batch new objects instead of announcing them to listeners as they
+     *  arrive. Batched objects are announced by announceNewObjects() in the
+     *  given order, so large numbers of objects arriving at once, e.g. at
+     *  startup, are inserted into query handlers with neighbouring objects
+     *  together. Must be called before any objects are added.
+     */
+    void setBulkLoad(BulkLoadOrder order, uint32 leaf_size);
+    // Announce batched objects to listeners. Must be called from the strand,
+    // before ticking the listening query handlers.
+    void announceNewObjects();
+
     /* LocationServiceCache members. */
     virtual void addPlaceholderImposter(
         const ObjectID& id,
@@ -128,6 +140,8 @@ private:
         bool exists; // Exists, i.e. xObjectRemoved hasn't been called
         int16 tracking; // Ref count to support multiple users
         bool isAggregate;
+        // Whether listeners have been told about the object yet
+        bool announced;
     };
 
 
@@ -170,6 +184,12 @@ private:
     ObjectDataMap mObjects;
     bool mWithReplicas;
 
+    BulkLoadOrder mBulkLoadOrder;
+    uint32 mBulkLoadLeafSize;
+    // Objects waiting for announceNewObjects(). May contain objects which have
+    // since been removed or announced.
+    std::vector<UUID> mNewObjects;
+
     bool tryRemoveObject(ObjectDataMap::iterator& obj_it);
 
     // Data contained in our Iterators. We maintain both the UUID and the
@@ -35,6 +35,7 @@
 #include <sirikata/core/options/CommonOptions.hpp>
 
 #include <algorithm>
+#include <iterator>
 
 #include <sirikata/core/prox/QueryHandlerFactory.hpp>
 
@@ -44,7 +45,9 @@
 #include <sirikata/space/AggregateManager.hpp>
 
 #include <sirikata/core/command/Commander.hpp>
+#include <sirikata/core/util/Timer.hpp>
 #include <json_spirit/json_spirit.h>
+#include <boost/lexical_cast.hpp>
 
 #define PROXLOG(level,msg) SILOG(prox,level,msg)
 
@@ -73,6 +76,127 @@ bool parseQueryRequest(const String& query, SolidAngle* qangle_out, uint32* max_
     return true;
 }
 
+// How often the query handler pollers run. In event driven mode they run at
+// the minimum tick interval and decide whether there's any work to do.
+Duration handlerPollRate() {
+    if (GetOptionValue<bool>(OPT_PROX_EVENT_DRIVEN_TICKS))
+        return GetOptionValue<Duration>(OPT_PROX_MIN_TICK_INTERVAL);
+    return Duration::milliseconds((int64)100);
+}
+
+// Pending additions for a querier, sorted by decreasing priority before sending
+typedef std::pair<float32, UUID> PrioritizedObject;
+bool higherPriority(const PrioritizedObject& lhs, const PrioritizedObject& rhs) {
+    return lhs.first > rhs.first;
+}
+
+// Servers only share a query if the largest angle any of them asked for is
+// within this factor of the smallest
+const float32 MAX_SHARED_ANGLE_RATIO = 2.f;
+
+// Fills in the state of an object being reported to another server
+void fillServerResultAddition(CBRLocationServiceCache* loc_cache, const UUID& objid, Sirikata::Protocol::Prox::IObjectAddition& addition) {
+    addition.set_object( objid );
+
+    TimedMotionVector3f loc = loc_cache->location(objid);
+    Sirikata::Protocol::ITimedMotionVector msg_loc = addition.mutable_location();
+    msg_loc.set_t(loc.updateTime());
+    msg_loc.set_position(loc.position());
+    msg_loc.set_velocity(loc.velocity());
+
+    TimedMotionQuaternion orient = loc_cache->orientation(objid);
+    Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
+    msg_orient.set_t(orient.updateTime());
+    msg_orient.set_position(orient.position());
+    msg_orient.set_velocity(orient.velocity());
+
+    Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = addition.mutable_aggregate_bounds();
+    AggregateBoundingInfo bnds = loc_cache->bounds(objid);
+    msg_bounds.set_center_offset(bnds.centerOffset);
+    msg_bounds.set_center_bounds_radius(bnds.centerBoundsRadius);
+    msg_bounds.set_max_object_size(bnds.maxObjectRadius);
+
+    const String& mesh = loc_cache->mesh(objid);
+    if (mesh.size() > 0)
+        addition.set_mesh(mesh);
+    const String& phy = loc_cache->physics(objid);
+    if (phy.size() > 0)
+        addition.set_physics(phy);
+}
+
+}
+
+LibproxProximity::LatencyHistogram::LatencyHistogram()
+ : samples(0),
+   total(Duration::zero()),
+   max(Duration::zero())
+{
+    for(int i = 0; i < NUM_BUCKETS; i++)
+        buckets[i] = 0;
+}
+
+void LibproxProximity::LatencyHistogram::add(const Duration& dt) {
+    int64 ms = dt.toMilliseconds();
+    int bucket = 0;
+    while(bucket < NUM_BUCKETS-1 && ms >= ((int64)1 << bucket))
+        bucket++;
+    buckets[bucket]++;
+    samples++;
+    total += dt;
+    if (dt > max) max = dt;
+}
+
+void LibproxProximity::LatencyHistogram::merge(const LatencyHistogram& other) {
+    for(int i = 0; i < NUM_BUCKETS; i++)
+        buckets[i] += other.buckets[i];
+    samples += other.samples;
+    total += other.total;
+    if (other.max > max) max = other.max;
+}
+
+void LibproxProximity::LatencyHistogram::report(Command::Result& result, const String& prefix) const {
+    result.put(prefix + "samples", samples);
+    result.put(prefix + "average", (samples > 0 ? total / (float32)samples : Duration::zero()).toString());
+    result.put(prefix + "max", max.toString());
+    for(int i = 0; i < NUM_BUCKETS; i++) {
+        String label = (i < NUM_BUCKETS-1) ?
+            (String("under_") + boost::lexical_cast<String>((int64)1 << i) + "ms") :
+            (String("over_") + boost::lexical_cast<String>((int64)1 << (i-1)) + "ms");
+        result.put(prefix + "histogram." + label, buckets[i]);
+    }
+}
+
+LibproxProximity::SharedServerQuery::SharedServerQuery()
+ : SharedQueryResults(NUM_OBJECT_CLASSES)
+{
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++)
+        queries[i] = NULL;
+}
+
+LibproxProximity::ObjectQueryShard::ObjectQueryShard(uint32 idx)
+ : index(idx),
+   strand(NULL),
+   locCache(NULL),
+   poller(NULL),
+   tickEvents(0),
+   numQueries(0),
+   ticks(0),
+   lastTickTime(Duration::zero()),
+   maxTickTime(Duration::zero()),
+   avgTickTime(0),
+   lastTickEvents(0),
+   avgTickEvents(0),
+   skippedTicks(0),
+   pendingResultCount(0),
+   cancelledResults(0),
+   throttledFlushes(0)
+{
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        handlers[i].handler = NULL;
+        handlerQueries[i] = 0;
+        handlerObjects[i] = 0;
+        handlerNodes[i] = 0;
+    }
 }
 
 LibproxProximity::LibproxProximity(SpaceContext* ctx, LocationService* locservice, CoordinateSegmentation* cseg, SpaceNetwork* net, AggregateManager* aggmgr)
@@ -81,12 +205,27 @@ LibproxProximity::LibproxProximity(SpaceContext* ctx, LocationService* locservic
    mMaxObject(0.0f),
    mMinObjectQueryAngle(SolidAngle::Max),
    mMaxMaxCount(1),
-   mServerQueries(),
+   mSharedServerQueries(
+       std::tr1::bind(&LibproxProximity::sendServerQueryMoveDelta, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2, std::tr1::placeholders::_3),
+       std::tr1::bind(&LibproxProximity::leaveSharedServerQuery, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2)
+   ),
    mServerDistance(false),
-   mServerHandlerPoller(mProxStrand, std::tr1::bind(&LibproxProximity::tickQueryHandler, this, mServerQueryHandler), "LibproxProximity ServerHandler Poll", Duration::milliseconds((int64)100)),
-   mObjectQueries(),
+   mShareServerQueries(GetOptionValue<bool>(OPT_PROX_SERVER_SHARE_QUERIES)),
+   mServerQueryShareRadius(std::max(GetOptionValue<float32>(OPT_PROX_SERVER_SHARE_RADIUS), 1.f)),
+   mServerHandlerPoller(mProxStrand, std::tr1::bind(&LibproxProximity::tickServerQueryHandler, this), "LibproxProximity ServerHandler Poll", handlerPollRate()),
+   mServerTickUpdates(),
+   mServerResultLatency(),
+   mServerTicks(0),
+   mServerSkippedTicks(0),
+   mObjectShardAssignment(GetOptionValue<uint32>(OPT_PROX_OBJECT_QUERY_SHARDS)),
+   mObjectShards(),
+   mObjectShardService(NULL),
    mObjectDistance(false),
-   mObjectHandlerPoller(mProxStrand, std::tr1::bind(&LibproxProximity::tickQueryHandler, this, mObjectQueryHandler), "LibproxProximity ObjectHandler Poll", Duration::milliseconds((int64)100)),
+   mMaxOutstandingResults(GetOptionValue<uint32>(OPT_PROX_MAX_OUTSTANDING_RESULTS)),
+   mEventDrivenTicks(GetOptionValue<bool>(OPT_PROX_EVENT_DRIVEN_TICKS)),
+   mMinTickInterval(GetOptionValue<Duration>(OPT_PROX_MIN_TICK_INTERVAL)),
+   mMaxTickInterval(GetOptionValue<Duration>(OPT_PROX_MAX_TICK_INTERVAL)),
+   mLoadedTickInterval(GetOptionValue<Duration>(OPT_PROX_LOADED_TICK_INTERVAL)),
    mStaticRebuilderPoller(mProxStrand, std::tr1::bind(&LibproxProximity::rebuildHandler, this, OBJECT_CLASS_STATIC), "LibproxProximity Static Rebuilder Poll", Duration::seconds(172800.f)),
    mDynamicRebuilderPoller(mProxStrand, std::tr1::bind(&LibproxProximity::rebuildHandler, this, OBJECT_CLASS_DYNAMIC), "LibproxProximity Dynamic Rebuilder Poll", Duration::seconds(172800.f))
 {
@@ -117,32 +256,93 @@ LibproxProximity::LibproxProximity(SpaceContext* ctx, LocationService* locservic
         );
     }
     if (server_handler_type == "dist" || server_handler_type == "rtreedist") mServerDistance = true;
+    if (mEventDrivenTicks)
+        mServerDirty.ticks = ProxTickScheduler(mMaxTickInterval, mLoadedTickInterval);
 
     // Object Queries
     String object_handler_type = GetOptionValue<String>(OPT_PROX_OBJECT_QUERY_HANDLER_TYPE);
     String object_handler_options = GetOptionValue<String>(OPT_PROX_OBJECT_QUERY_HANDLER_OPTIONS);
-    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (i >= mNumQueryHandlers) {
-            mObjectQueryHandler[i].handler = NULL;
-            continue;
+    uint32 nshards = mObjectShardAssignment.size();
+    if (nshards > 1)
+        mObjectShardService = new Network::IOServicePool("LibproxProximity Object Shards", nshards-1);
+    for(uint32 s = 0; s < nshards; s++) {
+        ObjectQueryShard* shard = new ObjectQueryShard(s);
+        // The first shard uses the prox strand and shared location cache, so
+        // with a single shard everything runs just as it would unsharded.
+        if (s == 0) {
+            shard->strand = mProxStrand;
+            shard->locCache = mLocCache;
         }
-        mObjectQueryHandler[i].handler = QueryHandlerFactory<ObjectProxSimulationTraits>(object_handler_type, object_handler_options);
-        mObjectQueryHandler[i].handler->setAggregateListener(this); // *Must* be before handler->initialize
-        bool object_static_objects = (mSeparateDynamicObjects && i == OBJECT_CLASS_STATIC);
-        mObjectQueryHandler[i].handler->initialize(
-            mLocCache, mLocCache,
-            object_static_objects, false /* not replicated */,
-            std::tr1::bind(&LibproxProximity::handlerShouldHandleObject, this, object_static_objects, true, _1, _2, _3, _4, _5, _6)
-        );
+        else {
+            shard->strand = mObjectShardService->service()->createStrand(String("LibproxProximity Object Shard ") + boost::lexical_cast<String>(s));
+            shard->locCache = new CBRLocationServiceCache(shard->strand, locservice, true);
+        }
+
+        for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+            if (i >= mNumQueryHandlers) {
+                shard->handlers[i].handler = NULL;
+                continue;
+            }
+            shard->handlers[i].handler = QueryHandlerFactory<ObjectProxSimulationTraits>(object_handler_type, object_handler_options);
+            // Every shard replicates the same objects, so only the first one
+            // reports aggregates, just as the unsharded handlers did.
+            if (s == 0)
+                shard->handlers[i].handler->setAggregateListener(this); // *Must* be before handler->initialize
+            bool object_static_objects = (mSeparateDynamicObjects && i == OBJECT_CLASS_STATIC);
+            shard->handlers[i].handler->initialize(
+                shard->locCache, shard->locCache,
+                object_static_objects, false /* not replicated */,
+                std::tr1::bind(&LibproxProximity::handlerShouldHandleObject, this, object_static_objects, true, _1, _2, _3, _4, _5, _6)
+            );
+        }
+
+        if (mEventDrivenTicks)
+            shard->dirty.ticks = ProxTickScheduler(mMaxTickInterval, mLoadedTickInterval);
+        shard->poller = new PollerService(shard->strand, std::tr1::bind(&LibproxProximity::tickObjectQueryShard, this, shard), "LibproxProximity ObjectHandler Poll", handlerPollRate());
+        mObjectShards.push_back(shard);
     }
     if (object_handler_type == "dist" || object_handler_type == "rtreedist") mObjectDistance = true;
+
+    // Batch new objects in the location caches so they get inserted into the
+    // handlers in bulk, in an order that packs neighbouring objects
+    // together. The shared cache feeds both server and object handlers, but
+    // object handlers hold far more objects so their settings are used.
+    BulkLoadOrder bulk_order;
+    uint32 bulk_leaf_size;
+    QueryHandlerBulkLoadSettings(object_handler_options, &bulk_order, &bulk_leaf_size);
+    mLocCache->setBulkLoad(bulk_order, bulk_leaf_size);
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        if ((*it)->locCache != mLocCache)
+            (*it)->locCache->setBulkLoad(bulk_order, bulk_leaf_size);
+    }
 }
 
 LibproxProximity::~LibproxProximity() {
-    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        delete mObjectQueryHandler[i].handler;
-        delete mServerQueryHandler[i].handler;
+    // Make sure the shard threads are finished with the handlers before
+    // destroying them
+    if (mObjectShardService != NULL)
+        mObjectShardService->join();
+
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        ObjectQueryShard* shard = *it;
+        for(int i = 0; i < NUM_OBJECT_CLASSES; i++)
+            delete shard->handlers[i].handler;
+        delete shard->poller;
+        if (shard->strand != mProxStrand) {
+            delete shard->locCache;
+            delete shard->strand;
+        }
+        delete shard;
     }
+    mObjectShards.clear();
+    delete mObjectShardService;
+
+    const SharedServerQueries<SharedServerQuery>::QuerySet& shared_queries = mSharedServerQueries.queries();
+    for(SharedServerQueries<SharedServerQuery>::QuerySet::const_iterator it = shared_queries.begin(); it != shared_queries.end(); it++)
+        delete *it;
+
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++)
+        delete mServerQueryHandler[i].handler;
 }
 
 
@@ -152,9 +352,15 @@ void LibproxProximity::start() {
     LibproxProximityBase::start();
 
     mContext->add(&mServerHandlerPoller);
-    mContext->add(&mObjectHandlerPoller);
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++)
+        mContext->add((*it)->poller);
     mContext->add(&mStaticRebuilderPoller);
     mContext->add(&mDynamicRebuilderPoller);
+
+    if (mObjectShardService != NULL) {
+        mObjectShardService->startWork();
+        mObjectShardService->run();
+    }
 }
 
 
@@ -178,9 +384,10 @@ void LibproxProximity::newSession(ObjectSession* session) {
 }
 
 void LibproxProximity::sessionClosed(ObjectSession* session) {
-    // Prox strand may  have some state to clean up
-    mProxStrand->post(
-        std::tr1::bind(&LibproxProximity::handleDisconnectedObject, this, session->id().getAsUUID()),
+    // Query shard may have some state to clean up
+    ObjectQueryShard* shard = getObjectQueryShard(session->id().getAsUUID());
+    shard->strand->post(
+        std::tr1::bind(&LibproxProximity::handleDisconnectedObject, this, shard, session->id().getAsUUID()),
         "LibproxProximity::handleDisconnectedObject"
     );
 
@@ -437,9 +644,10 @@ void LibproxProximity::addQuery(UUID obj, const String& params) {
 void LibproxProximity::updateQuery(UUID obj, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, SolidAngle sa, uint32 max_results) {
     SeqNoPtr obj_seqno = mContext->objectSessionManager()->getSession(ObjectReference(obj))->getSeqNoPtr();
 
-    // Update the prox thread
-    mProxStrand->post(
-        std::tr1::bind(&LibproxProximity::handleUpdateObjectQuery, this, obj, loc, bounds, sa, max_results, obj_seqno),
+    // Update the query's shard
+    ObjectQueryShard* shard = getObjectQueryShard(obj);
+    shard->strand->post(
+        std::tr1::bind(&LibproxProximity::handleUpdateObjectQuery, this, shard, obj, loc, bounds, sa, max_results, obj_seqno),
         "LibproxProximity::handleUpdateObjectQuery"
     );
 
@@ -477,9 +685,10 @@ void LibproxProximity::removeQuery(UUID obj) {
     uint32 max_count = mObjectQueryMaxCounts[obj];
     mObjectQueryMaxCounts.erase(obj);
 
-    // Update the prox thread
-    mProxStrand->post(
-        std::tr1::bind(&LibproxProximity::handleRemoveObjectQuery, this, obj, true),
+    // Update the query's shard
+    ObjectQueryShard* shard = getObjectQueryShard(obj);
+    shard->strand->post(
+        std::tr1::bind(&LibproxProximity::handleRemoveObjectQuery, this, shard, obj, true),
         "LibproxProximity::handleRemoveObjectQuery"
     );
 
@@ -535,11 +744,16 @@ void LibproxProximity::removeObjectSize(const UUID& obj) {
 
 
 int32 LibproxProximity::objectQueries() const {
-    return mObjectQueries[OBJECT_CLASS_STATIC].size();
+    int32 count = 0;
+    for(ObjectQueryShardList::const_iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        boost::mutex::scoped_lock lock((*it)->statsMutex);
+        count += (*it)->numQueries;
+    }
+    return count;
 }
 
 int32 LibproxProximity::serverQueries() const {
-    return mServerQueries[OBJECT_CLASS_STATIC].size();
+    return mSharedServerQueries.numServers();
 }
 
 void LibproxProximity::poll() {
@@ -575,13 +789,25 @@ void LibproxProximity::poll() {
 
 
 void LibproxProximity::queryHasEvents(Query* query) {
-    if (
-        query->handler() == mServerQueryHandler[OBJECT_CLASS_STATIC].handler ||
-        query->handler() == mServerQueryHandler[OBJECT_CLASS_DYNAMIC].handler
-    )
+    ObjectQueryShard* shard = getObjectQueryShard(query->handler());
+    if (shard == NULL)
         generateServerQueryEvents(query);
     else
-        generateObjectQueryEvents(query);
+        generateObjectQueryEvents(shard, query);
+}
+
+LibproxProximity::ObjectQueryShard* LibproxProximity::getObjectQueryShard(const UUID& obj_id) {
+    return mObjectShards[ mObjectShardAssignment.shard(obj_id) ];
+}
+
+LibproxProximity::ObjectQueryShard* LibproxProximity::getObjectQueryShard(const ProxQueryHandler* handler) {
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+            if ((*it)->handlers[i].handler != NULL && (*it)->handlers[i].handler == handler)
+                return *it;
+        }
+    }
+    return NULL;
 }
 
 
@@ -589,9 +815,11 @@ void LibproxProximity::queryHasEvents(Query* query) {
 // registered queries, allowing us to update those queries as appropriate.  All updating of objects
 // in the prox data structure happens via the LocationServiceCache
 void LibproxProximity::localObjectAdded(const UUID& uuid, bool agg, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& zernike) {
+    markObjectDirty(uuid, true);
     updateObjectSize(uuid, bounds.fullRadius());
 }
 void LibproxProximity::localObjectRemoved(const UUID& uuid, bool agg) {
+    markObjectDirty(uuid, true);
     removeObjectSize(uuid);
 
     mProxStrand->post(
@@ -600,34 +828,102 @@ void LibproxProximity::localObjectRemoved(const UUID& uuid, bool agg) {
     );
 }
 void LibproxProximity::localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval) {
+    markObjectDirty(uuid, true);
     updateQuery(uuid, newval, mLocService->bounds(uuid).fullBounds(), NoUpdateSolidAngle, NoUpdateMaxResults);
     if (mSeparateDynamicObjects)
         checkObjectClass(true, uuid, newval);
 }
 void LibproxProximity::localBoundsUpdated(const UUID& uuid, bool agg, const AggregateBoundingInfo& newval) {
+    markObjectDirty(uuid, true);
     updateQuery(uuid, mLocService->location(uuid), newval.fullBounds(), NoUpdateSolidAngle, NoUpdateMaxResults);
     updateObjectSize(uuid, newval.fullRadius());
 }
+void LibproxProximity::replicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& zernike) {
+    markObjectDirty(uuid, false);
+}
 void LibproxProximity::replicaObjectRemoved(const UUID& uuid) {
+    markObjectDirty(uuid, false);
     mProxStrand->post(
         std::tr1::bind(&LibproxProximity::removeStaticObjectTimeout, this, uuid),
         "LibproxProximity::removeStaticObjectTimeout"
     );
 }
 void LibproxProximity::replicaLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval) {
+    markObjectDirty(uuid, false);
     if (mSeparateDynamicObjects)
         checkObjectClass(false, uuid, newval);
 }
+void LibproxProximity::replicaBoundsUpdated(const UUID& uuid, const AggregateBoundingInfo& newval) {
+    markObjectDirty(uuid, false);
+}
+
+void LibproxProximity::markObjectDirty(const UUID& uuid, bool local) {
+    Time t = Timer::now();
+    if (local)
+        markObjectDirty(&mServerDirty, uuid, t);
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++)
+        markObjectDirty(&(*it)->dirty, uuid, t);
+}
+
+void LibproxProximity::markObjectDirty(DirtyState* dirty, const UUID& uuid, const Time& t) {
+    boost::mutex::scoped_lock lock(dirty->mutex);
+    // Only the first update since the last tick is recorded, so latencies are
+    // measured from the oldest change
+    dirty->objects.insert(ObjectUpdateTimes::value_type(uuid, t));
+}
+
+void LibproxProximity::markQueriesDirty(DirtyState* dirty) {
+    boost::mutex::scoped_lock lock(dirty->mutex);
+    dirty->queries++;
+}
+
+void LibproxProximity::sampleResultLatency(const ObjectUpdateTimes& updates, const UUID& objid, const Time& t, LatencyHistogram* hist) {
+    ObjectUpdateTimes::const_iterator it = updates.find(objid);
+    if (it == updates.end()) return;
+    hist->add(t - it->second);
+}
 
 
 // PROX Thread: Everything after this should only be called from within the prox thread.
 
-void LibproxProximity::tickQueryHandler(ProxQueryHandlerData qh[NUM_OBJECT_CLASSES]) {
+void LibproxProximity::tickServerQueryHandler() {
     // Not really any better place to do this. We'll call this more frequently
     // than necessary by putting it here, but hopefully it doesn't matter since
     // most of the time nothing will be done.
     processExpiredStaticObjectTimeouts();
+    mLocCache->announceNewObjects();
+
+    if (!checkTickNeeded(&mServerDirty, mServerQueryHandler, Timer::now(), &mServerTickUpdates)) {
+        mServerSkippedTicks++;
+        return;
+    }
+    mServerTicks++;
+    tickQueryHandler(mServerQueryHandler);
+    mServerTickUpdates.clear();
+    mSharedServerQueries.finishMoves();
+}
 
+bool LibproxProximity::checkTickNeeded(DirtyState* dirty, ProxQueryHandlerData qh[NUM_OBJECT_CLASSES], const Time& now, ObjectUpdateTimes* updated_out) {
+    boost::mutex::scoped_lock lock(dirty->mutex);
+
+    bool has_work = (!dirty->objects.empty() || dirty->queries > 0);
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        if (qh[i].handler != NULL && (!qh[i].additions.empty() || !qh[i].removals.empty()))
+            has_work = true;
+    }
+    // Every object is replicated to every shard, so one update makes them all
+    // dirty. Under continuous updates the scheduler keeps us from ticking
+    // every handler every mMinTickInterval.
+    if (!dirty->ticks.tickNeeded(has_work, now))
+        return false;
+
+    updated_out->swap(dirty->objects);
+    dirty->objects.clear();
+    dirty->queries = 0;
+    return true;
+}
+
+void LibproxProximity::tickQueryHandler(ProxQueryHandlerData qh[NUM_OBJECT_CLASSES]) {
     // We need to actually swap any objects that the previous step
     // found. However, we need to be careful because just performing
     // the addObject() and removeObject() can result in incorrect
@@ -656,6 +952,21 @@ void LibproxProximity::tickQueryHandler(ProxQueryHandlerData qh[NUM_OBJECT_CLASS
             qh[i].additions.clear();
         }
     }
+}
+
+void LibproxProximity::tickObjectQueryShard(ObjectQueryShard* shard) {
+    Time tick_start = Timer::now();
+    shard->locCache->announceNewObjects();
+    if (!checkTickNeeded(&shard->dirty, shard->handlers, tick_start, &shard->tickUpdates)) {
+        // Results held back earlier may fit in their streams now
+        flushObjectQueryResults(shard);
+        boost::mutex::scoped_lock lock(shard->statsMutex);
+        shard->skippedTicks++;
+        return;
+    }
+    shard->tickEvents = 0;
+
+    tickQueryHandler(shard->handlers);
 
     // We wait until the first full iteration is done for queries so we can
     // coalesce their initial results, skipping intermediate refinement. Now's
@@ -663,10 +974,46 @@ void LibproxProximity::tickQueryHandler(ProxQueryHandlerData qh[NUM_OBJECT_CLASS
     // performing the coalescing.
 
     // copied for safe iteration
-    FirstIterationObjectSet copied_first_its = mObjectQueriesFirstIteration;
+    FirstIterationObjectSet copied_first_its = shard->firstIteration;
     for(FirstIterationObjectSet::const_iterator it = copied_first_its.begin(); it != copied_first_its.end(); it++)
-        generateObjectQueryEvents(*it, true);
-    mObjectQueriesFirstIteration.clear();
+        generateObjectQueryEvents(shard, *it, true);
+    shard->firstIteration.clear();
+    flushObjectQueryResults(shard);
+    shard->tickUpdates.clear();
+
+    Duration tick_time = Timer::now() - tick_start;
+
+    boost::mutex::scoped_lock lock(shard->statsMutex);
+    shard->numQueries = shard->queries[OBJECT_CLASS_STATIC].size();
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        if (shard->handlers[i].handler == NULL) continue;
+        shard->handlerQueries[i] = shard->handlers[i].handler->numQueries();
+        shard->handlerObjects[i] = shard->handlers[i].handler->numObjects();
+        shard->handlerNodes[i] = shard->handlers[i].handler->numNodes();
+    }
+    shard->ticks++;
+    shard->lastTickTime = tick_time;
+    if (tick_time > shard->maxTickTime)
+        shard->maxTickTime = tick_time;
+    shard->lastTickEvents = shard->tickEvents;
+    // Moving averages weight the most recent tick by 1/8
+    if (shard->ticks == 1) {
+        shard->avgTickTime = tick_time.toSeconds();
+        shard->avgTickEvents = shard->tickEvents;
+    }
+    else {
+        shard->avgTickTime += (tick_time.toSeconds() - shard->avgTickTime) / 8.0;
+        shard->avgTickEvents += (shard->tickEvents - shard->avgTickEvents) / 8.0;
+    }
+}
+
+void LibproxProximity::postToObjectQueryShard(ObjectQueryShard* shard, const Network::IOCallback& fn, const char* tag) {
+    // Only called from the prox strand, so the first shard can be handled
+    // immediately
+    if (shard->strand == mProxStrand)
+        fn();
+    else
+        shard->strand->post(fn, tag);
 }
 
 void LibproxProximity::rebuildHandlerType(ProxQueryHandlerData* handler, ObjectClass objtype) {
@@ -676,7 +1023,13 @@ void LibproxProximity::rebuildHandlerType(ProxQueryHandlerData* handler, ObjectC
 
 void LibproxProximity::rebuildHandler(ObjectClass objtype) {
     rebuildHandlerType(mServerQueryHandler, objtype);
-    rebuildHandlerType(mObjectQueryHandler, objtype);
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        postToObjectQueryShard(
+            *it,
+            std::tr1::bind(&LibproxProximity::rebuildHandlerType, this, (*it)->handlers, objtype),
+            "LibproxProximity::rebuildHandlerType"
+        );
+    }
 }
 
 
@@ -686,10 +1039,21 @@ void LibproxProximity::commandProperties(const Command::Command& cmd, Command::C
 
     // Properties/settings
     result.put("name", "libprox");
-    result.put("settings.handlers", mNumQueryHandlers * 2);
+    result.put("settings.handlers", mNumQueryHandlers * (1 + (int32)mObjectShards.size()));
+    result.put("settings.object_shards", (uint32)mObjectShards.size());
     result.put("settings.dynamic_separate", mSeparateDynamicObjects);
     if (mSeparateDynamicObjects)
         result.put("settings.static_heuristic", mMoveToStaticDelay.toString());
+    result.put("settings.event_driven", mEventDrivenTicks);
+    if (mEventDrivenTicks) {
+        result.put("settings.min_tick_interval", mMinTickInterval.toString());
+        result.put("settings.max_tick_interval", mMaxTickInterval.toString());
+        result.put("settings.loaded_tick_interval", mLoadedTickInterval.toString());
+    }
+    result.put("settings.max_outstanding_results", mMaxOutstandingResults);
+    result.put("settings.share_server_queries", mShareServerQueries);
+    if (mShareServerQueries)
+        result.put("settings.server_query_share_radius", mServerQueryShareRadius);
 
     // Current state. Split into two high level parts, objects and servers, and
     // further split by properties of connected objects/servers and queries
@@ -698,16 +1062,18 @@ void LibproxProximity::commandProperties(const Command::Command& cmd, Command::C
     // Properties of objects
     // We don't get this info from loc, we just figure it out based on what the
     // query processors report: server queries only have local objects, object
-    // queries have both
+    // queries have both. Every shard has all the objects, so we only need to
+    // check the first one, which runs on this strand.
+    ProxQueryHandlerData* object_handlers = mObjectShards[0]->handlers;
     int32 server_query_objects = (mNumQueryHandlers == 2 ? (mServerQueryHandler[0].handler->numObjects() + mServerQueryHandler[1].handler->numObjects()) : mServerQueryHandler[0].handler->numObjects());
-    int32 object_query_objects = (mNumQueryHandlers == 2 ? (mObjectQueryHandler[0].handler->numObjects() + mObjectQueryHandler[1].handler->numObjects()) : mObjectQueryHandler[0].handler->numObjects());
+    int32 object_query_objects = (mNumQueryHandlers == 2 ? (object_handlers[0].handler->numObjects() + object_handlers[1].handler->numObjects()) : object_handlers[0].handler->numObjects());
     result.put("objects.properties.local_count", server_query_objects);
     result.put("objects.properties.remote_count", object_query_objects - server_query_objects);
     result.put("objects.properties.count", object_query_objects);
     result.put("objects.properties.max_size", mMaxObject);
 
     // Properties of queries from objects
-    result.put("queries.objects.count", mObjectQueries[0].size());
+    result.put("queries.objects.count", objectQueries());
     result.put("queries.objects.min_solid_angle", mMinObjectQueryAngle.asFloat());
     result.put("queries.objects.max_max_count", mMaxMaxCount);
     if (mObjectDistance)
@@ -718,16 +1084,38 @@ void LibproxProximity::commandProperties(const Command::Command& cmd, Command::C
     for(ObjectProxStreamMap::iterator prox_stream_it = mObjectProxStreams.begin(); prox_stream_it != mObjectProxStreams.end(); prox_stream_it++)
         obj_messages += prox_stream_it->second->outstanding.size();
     result.put("queries.objects.messages", mObjectResults.size() + mObjectResultsToSend.size() + obj_messages);
+    // Per-shard tick stats
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        ObjectQueryShard* shard = *it;
+        String key = String("queries.objects.shards.") + boost::lexical_cast<String>(shard->index) + ".";
+        boost::mutex::scoped_lock lock(shard->statsMutex);
+        result.put(key + "count", shard->numQueries);
+        result.put(key + "ticks", shard->ticks);
+        result.put(key + "tick_time.last", shard->lastTickTime.toString());
+        result.put(key + "tick_time.average", Duration::seconds(shard->avgTickTime).toString());
+        result.put(key + "tick_time.max", shard->maxTickTime.toString());
+        result.put(key + "events_per_tick.last", shard->lastTickEvents);
+        result.put(key + "events_per_tick.average", shard->avgTickEvents);
+        result.put(key + "skipped_ticks", shard->skippedTicks);
+        result.put(key + "results.pending", shard->pendingResultCount);
+        result.put(key + "results.cancelled", shard->cancelledResults);
+        result.put(key + "results.throttled", shard->throttledFlushes);
+        shard->resultLatency.report(result, key + "latency.");
+    }
 
 
     // Properties of servers
     result.put("servers.num_queried", numServersQueried());
 
     // Properties of queries from servers
-    result.put("queries.servers.count", mServerQueries[0].size());
+    result.put("queries.servers.count", mSharedServerQueries.numServers());
+    result.put("queries.servers.shared", (uint32)mSharedServerQueries.queries().size());
     if (mServerDistance)
         result.put("queries.servers.distance", mDistanceQueryDistance);
     result.put("queries.servers.messages", mServerResults.size() + mServerResultsToSend.size());
+    result.put("queries.servers.ticks", mServerTicks);
+    result.put("queries.servers.skipped_ticks", mServerSkippedTicks);
+    mServerResultLatency.report(result, "queries.servers.latency.");
 
     cmdr->result(cmdid, result);
 }
@@ -735,12 +1123,26 @@ void LibproxProximity::commandProperties(const Command::Command& cmd, Command::C
 void LibproxProximity::commandListHandlers(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid) {
     Command::Result result = Command::EmptyResult();
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mObjectQueryHandler[i].handler != NULL) {
+        // Other shards' handlers run on their own strands, so they're reported
+        // as of each shard's last tick. Queries are split between shards, so
+        // the handler reports their total.
+        if (mObjectShards[0]->handlers[i].handler != NULL) {
             String key = String("handlers.object.") + ObjectClassToString((ObjectClass)i) + ".";
             result.put(key + "name", String("object-queries.") + ObjectClassToString((ObjectClass)i) + "-objects");
-            result.put(key + "queries", mObjectQueryHandler[i].handler->numQueries());
-            result.put(key + "objects", mObjectQueryHandler[i].handler->numObjects());
-            result.put(key + "nodes", mObjectQueryHandler[i].handler->numNodes());
+            uint32 total_queries = 0;
+            for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+                ObjectQueryShard* shard = *it;
+                String shard_key = key + "shards." + boost::lexical_cast<String>(shard->index) + ".";
+                boost::mutex::scoped_lock lock(shard->statsMutex);
+                result.put(shard_key + "queries", shard->handlerQueries[i]);
+                result.put(shard_key + "objects", shard->handlerObjects[i]);
+                result.put(shard_key + "nodes", shard->handlerNodes[i]);
+                total_queries += shard->handlerQueries[i];
+            }
+            result.put(key + "queries", total_queries);
+            // Every shard has all the objects
+            result.put(key + "objects", mObjectShards[0]->handlers[i].handler->numObjects());
+            result.put(key + "nodes", mObjectShards[0]->handlers[i].handler->numNodes());
         }
         if (mServerQueryHandler[i].handler != NULL) {
             String key = String("handlers.server.") + ObjectClassToString((ObjectClass)i) + ".";
@@ -763,7 +1165,7 @@ bool LibproxProximity::parseHandlerName(const String& name, ProxQueryHandlerData
     if (handler_part == "server-queries")
         *handlers_out = mServerQueryHandler;
     else if (handler_part == "object-queries")
-        *handlers_out = mObjectQueryHandler;
+        *handlers_out = mObjectShards[0]->handlers;
     else
         return false;
 
@@ -791,7 +1193,19 @@ void LibproxProximity::commandForceRebuild(const Command::Command& cmd, Command:
         return;
     }
 
-    rebuildHandlerType(handlers, klass);
+    if (handlers == mServerQueryHandler) {
+        rebuildHandlerType(handlers, klass);
+    }
+    else {
+        // Object query handlers are replicated in each shard
+        for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+            postToObjectQueryShard(
+                *it,
+                std::tr1::bind(&LibproxProximity::rebuildHandlerType, this, (*it)->handlers, klass),
+                "LibproxProximity::rebuildHandlerType"
+            );
+        }
+    }
     result.put("success", true);
     cmdr->result(cmdid, result);
 }
@@ -829,22 +1243,52 @@ void LibproxProximity::commandListNodes(const Command::Command& cmd, Command::Co
 
 void LibproxProximity::generateServerQueryEvents(Query* query) {
     Time t = mContext->simTime();
-    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
+    Time now = Timer::now();
 
     assert(mInvertedServerQueries.find(query) != mInvertedServerQueries.end());
-    ServerID sid = mInvertedServerQueries[query];
-    SeqNoPtr seqNoPtr = getOrCreateSeqNoInfo(sid);
+    SharedServerQuery* sq = mInvertedServerQueries[query];
+    int klass = 0;
+    while(sq->queries[klass] != query) klass++;
 
     QueryEventList evts;
     query->popEvents(evts);
 
-    while(!evts.empty()) {
+    // Results and latencies are tracked once per event, no matter how many
+    // servers share the query
+    for(QueryEventList::const_iterator evt_it = evts.begin(); evt_it != evts.end(); evt_it++) {
+        const QueryEvent& evt = *evt_it;
+        for(uint32 aidx = 0; aidx < evt.additions().size(); aidx++) {
+            UUID objid = evt.additions()[aidx].id();
+            if (!mLocCache->tracking(objid)) continue;
+            sq->addResult(klass, objid);
+            sampleResultLatency(mServerTickUpdates, objid, now, &mServerResultLatency);
+        }
+        for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
+            UUID objid = evt.removals()[ridx].id();
+            sq->removeResult(klass, objid);
+            sampleResultLatency(mServerTickUpdates, objid, now, &mServerResultLatency);
+        }
+    }
+
+    for(SharedServerQuery::MemberMap::const_iterator it = sq->members.begin(); it != sq->members.end(); it++) {
+        if (!mSharedServerQueries.receivesResults(sq, it->first))
+            continue;
+        sendServerQueryEvents(it->first, evts, t);
+    }
+}
+
+void LibproxProximity::sendServerQueryEvents(ServerID sid, const QueryEventList& evts, const Time& t) {
+    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
+    SeqNoPtr seqNoPtr = getOrCreateSeqNoInfo(sid);
+
+    QueryEventList::const_iterator evt_it = evts.begin();
+    while(evt_it != evts.end()) {
         Sirikata::Protocol::Prox::Container container;
         Sirikata::Protocol::Prox::IProximityResults contents = container.mutable_result();
         contents.set_t(t);
         uint32 count = 0;
-        while(count < max_count && !evts.empty()) {
-            const QueryEvent& evt = evts.front();
+        while(count < max_count && evt_it != evts.end()) {
+            const QueryEvent& evt = *evt_it;
             Sirikata::Protocol::Prox::IProximityUpdate event_results = contents.add_update();
             // Each QueryEvent is made up of additions and
             // removals
@@ -859,35 +1303,9 @@ void LibproxProximity::generateServerQueryEvents(Query* query) {
                     );
 
                     Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
-                    addition.set_object( objid );
-
+                    fillServerResultAddition(mLocCache, objid, addition);
                     uint64 seqNo = (*seqNoPtr)++;
                     addition.set_seqno (seqNo);
-
-                    TimedMotionVector3f loc = mLocCache->location(objid);
-                    Sirikata::Protocol::ITimedMotionVector msg_loc = addition.mutable_location();
-                    msg_loc.set_t(loc.updateTime());
-                    msg_loc.set_position(loc.position());
-                    msg_loc.set_velocity(loc.velocity());
-
-                    TimedMotionQuaternion orient = mLocCache->orientation(objid);
-                    Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
-                    msg_orient.set_t(orient.updateTime());
-                    msg_orient.set_position(orient.position());
-                    msg_orient.set_velocity(orient.velocity());
-
-                    Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = addition.mutable_aggregate_bounds();
-                    AggregateBoundingInfo bnds = mLocCache->bounds(objid);
-                    msg_bounds.set_center_offset(bnds.centerOffset);
-                    msg_bounds.set_center_bounds_radius(bnds.centerBoundsRadius);
-                    msg_bounds.set_max_object_size(bnds.maxObjectRadius);
-
-                    const String& mesh = mLocCache->mesh(objid);
-                    if (mesh.size() > 0)
-                        addition.set_mesh(mesh);
-                    const String& phy = mLocCache->physics(objid);
-                    if (phy.size() > 0)
-                        addition.set_physics(phy);
                 }
             }
             for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
@@ -910,7 +1328,7 @@ void LibproxProximity::generateServerQueryEvents(Query* query) {
                 );
             }
 
-            evts.pop_front();
+            evt_it++;
         }
 
         //PROXLOG(insane,"Reporting " << contents.addition_size() << " additions, " << contents.removal_size() << " removals to server " << sid);
@@ -926,108 +1344,295 @@ void LibproxProximity::generateServerQueryEvents(Query* query) {
     }
 }
 
-void LibproxProximity::generateObjectQueryEvents(Query* query, bool do_first) {
+void LibproxProximity::sendServerQueryDelta(ServerID sid, const ObjectSet& additions, const ObjectSet& removals, const Time& t) {
+    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
+    SeqNoPtr seqNoPtr = getOrCreateSeqNoInfo(sid);
+
+    ObjectSet::const_iterator rem_it = removals.begin(), add_it = additions.begin();
+    while(rem_it != removals.end() || add_it != additions.end()) {
+        Sirikata::Protocol::Prox::Container container;
+        Sirikata::Protocol::Prox::IProximityResults contents = container.mutable_result();
+        contents.set_t(t);
+        Sirikata::Protocol::Prox::IProximityUpdate event_results = contents.add_update();
+        uint32 count = 0;
+        // Removals first so the server never sees more than either set
+        for(; count < max_count && rem_it != removals.end(); rem_it++) {
+            UUID objid = *rem_it;
+            count++;
+
+            mContext->mainStrand->post(
+                std::tr1::bind(&LibproxProximity::handleRemoveServerLocSubscription, this, sid, objid),
+                "LibproxProximity::handleRemoveServerLocSubscription"
+            );
+
+            Sirikata::Protocol::Prox::IObjectRemoval removal = event_results.add_removal();
+            removal.set_object(objid);
+            uint64 seqNo = (*seqNoPtr)++;
+            removal.set_seqno (seqNo);
+            removal.set_type(Sirikata::Protocol::Prox::ObjectRemoval::Transient);
+        }
+        for(; count < max_count && add_it != additions.end(); add_it++) {
+            UUID objid = *add_it;
+            if (!mLocCache->tracking(objid)) continue;
+            count++;
+
+            mContext->mainStrand->post(
+                std::tr1::bind(&LibproxProximity::handleAddServerLocSubscription, this, sid, objid, seqNoPtr),
+                "LibproxProximity::handleAddServerLocSubscription"
+            );
+
+            Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
+            fillServerResultAddition(mLocCache, objid, addition);
+            uint64 seqNo = (*seqNoPtr)++;
+            addition.set_seqno (seqNo);
+        }
+        if (count == 0) continue;
+
+        Message* msg = new Message(
+            mContext->id(),
+            SERVER_PORT_PROX,
+            sid,
+            SERVER_PORT_PROX,
+            serializePBJMessage(container)
+        );
+        mServerResults.push(msg);
+    }
+}
+
+void LibproxProximity::generateObjectQueryEvents(ObjectQueryShard* shard, Query* query, bool do_first) {
     // If we're waiting for the first iteration to finish, we ignore the
     // notification, waiting until we get out of the first tick to manually
     // trigger updates.
-    bool is_first = (mObjectQueriesFirstIteration.find(query) != mObjectQueriesFirstIteration.end());
+    bool is_first = (shard->firstIteration.find(query) != shard->firstIteration.end());
     if (!do_first && is_first) return;
 
-    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
-
-    assert(mInvertedObjectQueries.find(query) != mInvertedObjectQueries.end());
-    UUID query_id = mInvertedObjectQueries[query];
-    SeqNoPtr seqNoPtr = getSeqNoInfo(query_id);
+    assert(shard->invertedQueries.find(query) != shard->invertedQueries.end());
+    UUID query_id = shard->invertedQueries[query];
 
     QueryEventList evts;
     query->popEvents(evts);
 
-    if (is_first) {
-        coalesceEvents(evts, 10);
-        mObjectQueriesFirstIteration.erase(query);
+    if (is_first)
+        shard->firstIteration.erase(query);
+    shard->tickEvents += evts.size();
+
+    // Events are merged into the querier's pending results rather than sent
+    // immediately. Events for an object always alternate between additions
+    // and removals, so finding the opposite type still pending means the
+    // querier never saw it and both can be dropped. This also takes care of
+    // coalescing the intermediate results from the first iteration.
+    PendingResults& pending = shard->pendingResults[query_id];
+    uint32 cancelled = 0;
+    for(QueryEventList::const_iterator evt_it = evts.begin(); evt_it != evts.end(); evt_it++) {
+        const QueryEvent& evt = *evt_it;
+        for(uint32 aidx = 0; aidx < evt.additions().size(); aidx++) {
+            UUID objid = evt.additions()[aidx].id();
+            PendingResults::RemovalMap::iterator rem_it = pending.removals.find(objid);
+            if (rem_it != pending.removals.end()) {
+                pending.removals.erase(rem_it);
+                cancelled += 2;
+                continue;
+            }
+            ObjectUpdateTimes::const_iterator up_it = shard->tickUpdates.find(objid);
+            pending.additions[objid] = (up_it != shard->tickUpdates.end() ? up_it->second : Time::null());
+        }
+        for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
+            UUID objid = evt.removals()[ridx].id();
+            PendingResults::AdditionMap::iterator add_it = pending.additions.find(objid);
+            if (add_it != pending.additions.end()) {
+                pending.additions.erase(add_it);
+                cancelled += 2;
+                continue;
+            }
+            ObjectUpdateTimes::const_iterator up_it = shard->tickUpdates.find(objid);
+            pending.removals[objid] = std::make_pair(
+                (evt.removals()[ridx].permanent() == QueryEvent::Permanent),
+                (up_it != shard->tickUpdates.end() ? up_it->second : Time::null())
+            );
+        }
+    }
+
+    if (cancelled > 0) {
+        boost::mutex::scoped_lock lock(shard->statsMutex);
+        shard->cancelledResults += cancelled;
     }
+}
+
+void LibproxProximity::flushObjectQueryResults(ObjectQueryShard* shard) {
+    LatencyHistogram latencies;
+    uint32 pending_count = 0;
+    uint32 throttled = 0;
+
+    for(PendingResultsMap::iterator it = shard->pendingResults.begin(); it != shard->pendingResults.end(); ) {
+        const UUID& query_id = it->first;
+        PendingResults& pending = it->second;
+
+        // Limit the results we hand off to what the querier's stream has room
+        // for. Anything left over waits, so later additions and removals can
+        // still cancel it and more important objects can jump ahead of it.
+        uint32 max_messages = 0;
+        bool has_room = true;
+        if (mMaxOutstandingResults > 0) {
+            uint32 in_flight = 0;
+            {
+                boost::mutex::scoped_lock lock(shard->inFlightMutex);
+                ResultCountMap::iterator flight_it = shard->inFlight.find(query_id);
+                if (flight_it != shard->inFlight.end())
+                    in_flight = flight_it->second;
+            }
+            has_room = (in_flight < mMaxOutstandingResults);
+            max_messages = mMaxOutstandingResults - in_flight;
+        }
+
+        if (has_room && !pending.empty())
+            sendPendingResults(shard, query_id, pending, max_messages, &latencies);
 
-    while(!evts.empty()) {
+        if (pending.empty()) {
+            shard->pendingResults.erase(it++);
+        }
+        else {
+            throttled++;
+            pending_count += pending.additions.size() + pending.removals.size();
+            it++;
+        }
+    }
+
+    boost::mutex::scoped_lock lock(shard->statsMutex);
+    shard->pendingResultCount = pending_count;
+    shard->throttledFlushes += throttled;
+    if (latencies.samples > 0)
+        shard->resultLatency.merge(latencies);
+}
+
+uint32 LibproxProximity::sendPendingResults(ObjectQueryShard* shard, const UUID& query_id, PendingResults& pending, uint32 max_messages, LatencyHistogram* latencies) {
+    uint32 max_count = GetOptionValue<uint32>(PROX_MAX_PER_RESULT);
+    CBRLocationServiceCache* loc_cache = shard->locCache;
+    Time now = Timer::now();
+    Time t = mContext->simTime();
+    SeqNoPtr seqNoPtr = getSeqNoInfo(shard, query_id);
+
+    // Number of results we can send, or 0 for all of them
+    uint32 capacity = max_messages * max_count;
+
+    // Removals are always sent first since they are cheap for the querier and
+    // free up resources it's using for objects it no longer needs.
+    std::vector<UUID> removals;
+    for(PendingResults::RemovalMap::const_iterator it = pending.removals.begin(); it != pending.removals.end(); it++) {
+        if (capacity > 0 && removals.size() >= capacity) break;
+        removals.push_back(it->first);
+    }
+
+    // Additions are sent most important first, by distance for distance
+    // queries and by (approximate) solid angle otherwise. If the cache lost
+    // the object, we can't do anything with it.
+    std::vector<PrioritizedObject> additions;
+    bool have_querier = loc_cache->tracking(query_id);
+    Vector3f querier_pos = have_querier ? loc_cache->location(query_id).position(t) : Vector3f(0, 0, 0);
+    for(PendingResults::AdditionMap::iterator it = pending.additions.begin(); it != pending.additions.end(); ) {
+        if (!loc_cache->tracking(it->first)) {
+            pending.additions.erase(it++);
+            continue;
+        }
+        float32 priority = 0.f;
+        if (have_querier) {
+            AggregateBoundingInfo bnds = loc_cache->bounds(it->first);
+            Vector3f center = loc_cache->location(it->first).position(t) + bnds.centerOffset;
+            float32 dist2 = (center - querier_pos).lengthSquared();
+            float32 radius = bnds.fullRadius();
+            priority = mObjectDistance ? -dist2 : (radius * radius / std::max(dist2, 1e-6f));
+        }
+        additions.push_back(PrioritizedObject(priority, it->first));
+        it++;
+    }
+    uint32 num_additions = additions.size();
+    if (capacity > 0)
+        num_additions = std::min(num_additions, (uint32)(capacity - removals.size()));
+    if (have_querier)
+        std::partial_sort(additions.begin(), additions.begin() + num_additions, additions.end(), higherPriority);
+
+    uint32 sent = 0;
+    uint32 ridx = 0, aidx = 0;
+    while(ridx < removals.size() || aidx < num_additions) {
         Sirikata::Protocol::Prox::ProximityResults prox_results;
-        prox_results.set_t(mContext->simTime());
+        prox_results.set_t(t);
+        Sirikata::Protocol::Prox::IProximityUpdate event_results = prox_results.add_update();
 
         uint32 count = 0;
-        while(count < max_count && !evts.empty()) {
-            const QueryEvent& evt = evts.front();
-            Sirikata::Protocol::Prox::IProximityUpdate event_results = prox_results.add_update();
-
-            for(uint32 aidx = 0; aidx < evt.additions().size(); aidx++) {
-                UUID objid = evt.additions()[aidx].id();
-                if (mLocCache->tracking(objid)) { // If the cache already lost it, we can't do anything
-                    count++;
+        for(; count < max_count && ridx < removals.size(); count++, ridx++) {
+            const UUID& objid = removals[ridx];
+            PendingResults::RemovalMap::iterator rem_it = pending.removals.find(objid);
+            if (rem_it->second.second != Time::null())
+                latencies->add(now - rem_it->second.second);
+
+            // Clear out seqno and let main strand remove loc
+            // subcription
+            mContext->mainStrand->post(
+                std::tr1::bind(&LibproxProximity::handleRemoveObjectLocSubscription, this, query_id, objid),
+                "LibproxProximity::handleRemoveObjectLocSubscription"
+            );
 
-                    mContext->mainStrand->post(
-                        std::tr1::bind(&LibproxProximity::handleAddObjectLocSubscription, this, query_id, objid),
-                        "LibproxProximity::handleAddObjectLocSubscription"
-                    );
+            Sirikata::Protocol::Prox::IObjectRemoval removal = event_results.add_removal();
+            removal.set_object( objid );
+            uint64 seqNo = (*seqNoPtr)++;
+            removal.set_seqno (seqNo);
+            removal.set_type(
+                rem_it->second.first
+                ? Sirikata::Protocol::Prox::ObjectRemoval::Permanent
+                : Sirikata::Protocol::Prox::ObjectRemoval::Transient
+            );
+            pending.removals.erase(rem_it);
+        }
+        for(; count < max_count && aidx < num_additions; count++, aidx++) {
+            const UUID& objid = additions[aidx].second;
+            PendingResults::AdditionMap::iterator add_it = pending.additions.find(objid);
+            if (add_it->second != Time::null())
+                latencies->add(now - add_it->second);
+            pending.additions.erase(add_it);
+
+            mContext->mainStrand->post(
+                std::tr1::bind(&LibproxProximity::handleAddObjectLocSubscription, this, query_id, objid),
+                "LibproxProximity::handleAddObjectLocSubscription"
+            );
 
-                    Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
-                    addition.set_object( objid );
+            Sirikata::Protocol::Prox::IObjectAddition addition = event_results.add_addition();
+            addition.set_object( objid );
 
-                    //query_id contains the uuid of the object that is receiving
-                    //the proximity message that obj_id has been added.
-                    uint64 seqNo = (*seqNoPtr)++;
-                    addition.set_seqno (seqNo);
+            //query_id contains the uuid of the object that is receiving
+            //the proximity message that obj_id has been added.
+            uint64 seqNo = (*seqNoPtr)++;
+            addition.set_seqno (seqNo);
 
-                    if (mLocCache->isAggregate(objid)) {
-                      addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Aggregate);
-                    }
-                    else {
-                      addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Object);
-                    }
-
-                    Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
-                    TimedMotionVector3f loc = mLocCache->location(objid);
-                    motion.set_t(loc.updateTime());
-                    motion.set_position(loc.position());
-                    motion.set_velocity(loc.velocity());
-
-                    TimedMotionQuaternion orient = mLocCache->orientation(objid);
-                    Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
-                    msg_orient.set_t(orient.updateTime());
-                    msg_orient.set_position(orient.position());
-                    msg_orient.set_velocity(orient.velocity());
-
-                    Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = addition.mutable_aggregate_bounds();
-                    AggregateBoundingInfo bnds = mLocCache->bounds(objid);
-                    msg_bounds.set_center_offset(bnds.centerOffset);
-                    msg_bounds.set_center_bounds_radius(bnds.centerBoundsRadius);
-                    msg_bounds.set_max_object_size(bnds.maxObjectRadius);
-
-                    const String& mesh = mLocCache->mesh(objid);
-                    if (mesh.size() > 0)
-                        addition.set_mesh(mesh);
-                    const String& phy = mLocCache->physics(objid);
-                    if (phy.size() > 0)
-                        addition.set_physics(phy);
-                }
+            if (loc_cache->isAggregate(objid)) {
+              addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Aggregate);
             }
-            for(uint32 ridx = 0; ridx < evt.removals().size(); ridx++) {
-                UUID objid = evt.removals()[ridx].id();
-                count++;
-                // Clear out seqno and let main strand remove loc
-                // subcription
-                mContext->mainStrand->post(
-                    std::tr1::bind(&LibproxProximity::handleRemoveObjectLocSubscription, this, query_id, objid),
-                    "LibproxProximity::handleRemoveObjectLocSubscription"
-                );
-
-                Sirikata::Protocol::Prox::IObjectRemoval removal = event_results.add_removal();
-                removal.set_object( objid );
-                uint64 seqNo = (*seqNoPtr)++;
-                removal.set_seqno (seqNo);
-                removal.set_type(
-                    (evt.removals()[ridx].permanent() == QueryEvent::Permanent)
-                    ? Sirikata::Protocol::Prox::ObjectRemoval::Permanent
-                    : Sirikata::Protocol::Prox::ObjectRemoval::Transient
-                );
+            else {
+              addition.set_type(Sirikata::Protocol::Prox::ObjectAddition::Object);
             }
-            evts.pop_front();
+
+            Sirikata::Protocol::ITimedMotionVector motion = addition.mutable_location();
+            TimedMotionVector3f loc = loc_cache->location(objid);
+            motion.set_t(loc.updateTime());
+            motion.set_position(loc.position());
+            motion.set_velocity(loc.velocity());
+
+            TimedMotionQuaternion orient = loc_cache->orientation(objid);
+            Sirikata::Protocol::ITimedMotionQuaternion msg_orient = addition.mutable_orientation();
+            msg_orient.set_t(orient.updateTime());
+            msg_orient.set_position(orient.position());
+            msg_orient.set_velocity(orient.velocity());
+
+            Sirikata::Protocol::IAggregateBoundingInfo msg_bounds = addition.mutable_aggregate_bounds();
+            AggregateBoundingInfo bnds = loc_cache->bounds(objid);
+            msg_bounds.set_center_offset(bnds.centerOffset);
+            msg_bounds.set_center_bounds_radius(bnds.centerBoundsRadius);
+            msg_bounds.set_max_object_size(bnds.maxObjectRadius);
+
+            const String& mesh = loc_cache->mesh(objid);
+            if (mesh.size() > 0)
+                addition.set_mesh(mesh);
+            const String& phy = loc_cache->physics(objid);
+            if (phy.size() > 0)
+                addition.set_physics(phy);
         }
 
         Sirikata::Protocol::Object::ObjectMessage* obj_msg = createObjectMessage(
@@ -1037,7 +1642,23 @@ void LibproxProximity::generateObjectQueryEvents(Query* query, bool do_first) {
             serializePBJMessage(prox_results)
         );
         mObjectResults.push(obj_msg);
+        sent++;
+    }
+
+    if (sent > 0) {
+        boost::mutex::scoped_lock lock(shard->inFlightMutex);
+        shard->inFlight[query_id] += sent;
     }
+    return sent;
+}
+
+void LibproxProximity::objectResultsSent(const UUID& querier, uint32 count) {
+    ObjectQueryShard* shard = getObjectQueryShard(querier);
+    boost::mutex::scoped_lock lock(shard->inFlightMutex);
+    ResultCountMap::iterator it = shard->inFlight.find(querier);
+    // The query may have been removed while results were still being sent
+    if (it == shard->inFlight.end()) return;
+    it->second = (it->second > count ? it->second - count : 0);
 }
 
 
@@ -1059,79 +1680,183 @@ void LibproxProximity::eraseSeqNoInfo(const ServerID server_id)
 }
 
 
-SeqNoPtr LibproxProximity::getSeqNoInfo(const UUID& obj_id)
+SeqNoPtr LibproxProximity::getSeqNoInfo(ObjectQueryShard* shard, const UUID& obj_id)
 {
     // obj_id == querier
-    ObjectSeqNoInfoMap::iterator proxSeqNoIt = mObjectSeqNos.find(obj_id);
-    assert(proxSeqNoIt != mObjectSeqNos.end());
+    ObjectSeqNoInfoMap::iterator proxSeqNoIt = shard->seqNos.find(obj_id);
+    assert(proxSeqNoIt != shard->seqNos.end());
     return proxSeqNoIt->second;
 }
 
-void LibproxProximity::eraseSeqNoInfo(const UUID& obj_id)
+void LibproxProximity::eraseSeqNoInfo(ObjectQueryShard* shard, const UUID& obj_id)
 {
     // obj_id == querier
-    ObjectSeqNoInfoMap::iterator proxSeqNoIt = mObjectSeqNos.find(obj_id);
-    if (proxSeqNoIt == mObjectSeqNos.end()) return;
-    mObjectSeqNos.erase(proxSeqNoIt);
+    ObjectSeqNoInfoMap::iterator proxSeqNoIt = shard->seqNos.find(obj_id);
+    if (proxSeqNoIt == shard->seqNos.end()) return;
+    shard->seqNos.erase(proxSeqNoIt);
 }
 
 
 void LibproxProximity::handleUpdateServerQuery(const ServerID& server, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, const uint32 max_results) {
-    BoundingSphere3f region(bounds.center(), 0);
-    float ms = bounds.radius();
+    markQueriesDirty(&mServerDirty);
+
+    SharedServerQuery* current = mSharedServerQueries.assigned(server);
+
+    ServerQueryParams params;
+    params.loc = loc;
+    params.bounds = bounds;
+    params.angle = angle;
+    params.maxResults = max_results;
+    if (max_results == NoUpdateMaxResults || max_results == 0)
+        params.maxResults = (current != NULL ? current->members[server].maxResults : 0);
+
+    // Stay in the current query if it can still cover this server
+    ServerQueryParams combined;
+    if (current != NULL && combineServerQueryParams(current, server, &params, &combined)) {
+        PROXLOG(debug,"Update server query from " << server << ", min angle " << angle.asFloat() << ", shared by " << current->members.size() << " servers");
+        current->members[server] = params;
+        applyServerQueryParams(current, combined);
+        return;
+    }
+
+    // Otherwise join another query covering similar servers, or start a new one
+    SharedServerQuery* target = NULL;
+    if (mShareServerQueries) {
+        const SharedServerQueries<SharedServerQuery>::QuerySet& shared_queries = mSharedServerQueries.queries();
+        for(SharedServerQueries<SharedServerQuery>::QuerySet::const_iterator sit = shared_queries.begin(); sit != shared_queries.end(); sit++) {
+            if (*sit == current) continue;
+            if (combineServerQueryParams(*sit, server, &params, &combined)) {
+                target = *sit;
+                break;
+            }
+        }
+    }
+    if (target == NULL) {
+        target = new SharedServerQuery();
+        mSharedServerQueries.addQuery(target);
+        combined = params;
+    }
+    PROXLOG(debug,(current == NULL ? "Add" : "Move") << " server query from " << server << ", min angle " << angle.asFloat() << ", shared with " << target->members.size() << " servers");
+
+    target->members[server] = params;
+    applyServerQueryParams(target, combined);
+    mSharedServerQueries.assign(server, target);
+}
+
+void LibproxProximity::sendServerQueryMoveDelta(const ServerID& server, const ObjectSet& additions, const ObjectSet& removals) {
+    sendServerQueryDelta(server, additions, removals, mContext->simTime());
+}
+
+void LibproxProximity::handleRemoveServerQuery(const ServerID& server) {
+    PROXLOG(debug,"Remove server query from " << server);
+    markQueriesDirty(&mServerDirty);
+
+    mSharedServerQueries.remove(server);
+
+    // Clear out sequence numbers
+    eraseSeqNoInfo(server);
+
+    mContext->mainStrand->post(
+        std::tr1::bind(&LibproxProximity::handleRemoveAllServerLocSubscription, this, server),
+        "LibproxProximity::handleRemoveAllServerLocSubscription"
+    );
+}
+
+bool LibproxProximity::combineServerQueryParams(const SharedServerQuery* sq, const ServerID& member, const ServerQueryParams* params, ServerQueryParams* combined_out) {
+    std::vector<const ServerQueryParams*> all;
+    for(SharedServerQuery::MemberMap::const_iterator it = sq->members.begin(); it != sq->members.end(); it++) {
+        if (it->first != member)
+            all.push_back(&it->second);
+    }
+    if (params != NULL)
+        all.push_back(params);
+    if (all.empty() || (all.size() > 1 && !mShareServerQueries))
+        return false;
+
+    ServerQueryParams combined;
+    combined.loc = all[0]->loc;
+    combined.angle = SolidAngle::Max;
+    combined.maxResults = 0;
+    SolidAngle max_angle = SolidAngle::Min;
+    float32 max_radius = 0.f;
+    bool unlimited = false;
+    for(uint32 i = 0; i < all.size(); i++) {
+        const ServerQueryParams& p = *all[i];
+        combined.bounds.mergeIn(p.bounds);
+        max_radius = std::max(max_radius, p.bounds.radius());
+        if (p.angle < combined.angle) combined.angle = p.angle;
+        if (p.angle > max_angle) max_angle = p.angle;
+        // Any server without a limit needs all the results
+        if (p.maxResults == 0) unlimited = true;
+        combined.maxResults = std::max(combined.maxResults, p.maxResults);
+    }
+    if (unlimited)
+        combined.maxResults = 0;
+
+    if (all.size() > 1) {
+        if (max_angle.asFloat() > combined.angle.asFloat() * MAX_SHARED_ANGLE_RATIO)
+            return false;
+        if (combined.bounds.radius() > max_radius * mServerQueryShareRadius)
+            return false;
+    }
+
+    *combined_out = combined;
+    return true;
+}
+
+void LibproxProximity::applyServerQueryParams(SharedServerQuery* sq, const ServerQueryParams& params) {
+    BoundingSphere3f region(params.bounds.center(), 0);
+    float ms = params.bounds.radius();
 
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
         if (mServerQueryHandler[i].handler == NULL) continue;
 
-        ServerQueryMap::iterator it = mServerQueries[i].find(server);
-        if (it == mServerQueries[i].end()) {
-            PROXLOG(debug,"Add server query from " << server << ", min angle " << angle.asFloat() << ", object class " << ObjectClassToString((ObjectClass)i));
-
-            Query* q = mServerDistance ?
-                mServerQueryHandler[i].handler->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
-                mServerQueryHandler[i].handler->registerQuery(loc, region, ms, angle) ;
-            if (max_results != NoUpdateMaxResults && max_results > 0)
-                q->maxResults(max_results);
-            mServerQueries[i][server] = q;
-            mInvertedServerQueries[q] = server;
+        Query* q = sq->queries[i];
+        if (q == NULL) {
+            q = mServerDistance ?
+                mServerQueryHandler[i].handler->registerQuery(params.loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
+                mServerQueryHandler[i].handler->registerQuery(params.loc, region, ms, params.angle) ;
+            if (params.maxResults > 0)
+                q->maxResults(params.maxResults);
+            sq->queries[i] = q;
+            mInvertedServerQueries[q] = sq;
             q->setEventListener(this);
         }
         else {
-            PROXLOG(debug,"Update server query from " << server << ", min angle " << angle.asFloat() << ", object class " << ObjectClassToString((ObjectClass)i));
-
-            Query* q = it->second;
-            q->position(loc);
+            q->position(params.loc);
             q->region( region );
             q->maxSize( ms );
-            q->angle(angle);
-            if (max_results != NoUpdateMaxResults && max_results > 0)
-                q->maxResults(max_results);
+            q->angle(params.angle);
+            if (params.maxResults > 0)
+                q->maxResults(params.maxResults);
         }
     }
 }
 
-void LibproxProximity::handleRemoveServerQuery(const ServerID& server) {
-    PROXLOG(debug,"Remove server query from " << server);
-
-    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mServerQueryHandler[i].handler == NULL) continue;
+void LibproxProximity::leaveSharedServerQuery(SharedServerQuery* sq, const ServerID& server) {
+    // If the remaining servers are no longer similar enough to share, the
+    // query keeps covering the departed server until they next update
+    ServerQueryParams combined;
+    bool shrink = combineServerQueryParams(sq, server, NULL, &combined);
 
-        ServerQueryMap::iterator it = mServerQueries[i].find(server);
-        if (it == mServerQueries[i].end()) continue;
+    sq->members.erase(server);
+    if (sq->members.empty()) {
+        destroySharedServerQuery(sq);
+        return;
+    }
+    if (shrink)
+        applyServerQueryParams(sq, combined);
+}
 
-        Query* q = it->second;
-        mServerQueries[i].erase(it);
+void LibproxProximity::destroySharedServerQuery(SharedServerQuery* sq) {
+    for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
+        Query* q = sq->queries[i];
+        if (q == NULL) continue;
         mInvertedServerQueries.erase(q);
         delete q; // Note: Deleting query notifies QueryHandler and unsubscribes.
     }
-
-    // Clear out sequence numbers
-    eraseSeqNoInfo(server);
-
-    mContext->mainStrand->post(
-        std::tr1::bind(&LibproxProximity::handleRemoveAllServerLocSubscription, this, server),
-        "LibproxProximity::handleRemoveAllServerLocSubscription"
-    );
+    mSharedServerQueries.removeQuery(sq);
+    delete sq;
 }
 
 
@@ -1150,7 +1875,7 @@ void LibproxProximity::handleForcedDisconnection(ServerID sid) {
         mLocService->removeReplicaObject(t, *it);
 }
 
-void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno) {
+void LibproxProximity::handleUpdateObjectQuery(ObjectQueryShard* shard, const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno) {
     BoundingSphere3f region(bounds.center(), 0);
     float ms = bounds.radius();
 
@@ -1160,14 +1885,15 @@ void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMo
     // objects triggering movement.
     bool explicit_query_params_update = ((angle != NoUpdateSolidAngle) || (max_results != NoUpdateMaxResults));
 
-    if (mObjectSeqNos.find(object) == mObjectSeqNos.end()) {
+    if (shard->seqNos.find(object) == shard->seqNos.end()) {
         // If there's no existing query, so this was just because of a
         // location update -- don't record a query since it wouldn't
         // do anything anyway.
         if (!explicit_query_params_update) return;
 
-        mObjectSeqNos.insert( ObjectSeqNoInfoMap::value_type(object, seqno) );
+        shard->seqNos.insert( ObjectSeqNoInfoMap::value_type(object, seqno) );
     }
+    markQueriesDirty(&shard->dirty);
 
     // Log, but only if this isn't just due to object movement
     if (explicit_query_params_update)
@@ -1175,23 +1901,23 @@ void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMo
 
 
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mObjectQueryHandler[i].handler == NULL) continue;
+        if (shard->handlers[i].handler == NULL) continue;
 
-        ObjectQueryMap::iterator it = mObjectQueries[i].find(object);
+        ObjectQueryMap::iterator it = shard->queries[i].find(object);
 
-        if (it == mObjectQueries[i].end()) {
+        if (it == shard->queries[i].end()) {
             // We only add if we actually have all the necessary info, most importantly a real minimum angle.
             // This is necessary because we get this update for all location updates, even those for objects
             // which don't have subscriptions.
             if (angle != NoUpdateSolidAngle) {
                 Query* q = mObjectDistance ?
-                    mObjectQueryHandler[i].handler->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
-                    mObjectQueryHandler[i].handler->registerQuery(loc, region, ms, angle);
+                    shard->handlers[i].handler->registerQuery(loc, region, ms, SolidAngle::Min, mDistanceQueryDistance) :
+                    shard->handlers[i].handler->registerQuery(loc, region, ms, angle);
                 if (max_results != NoUpdateMaxResults && max_results > 0)
                     q->maxResults(max_results);
-                mObjectQueries[i][object] = q;
-                mInvertedObjectQueries[q] = object;
-                mObjectQueriesFirstIteration.insert(q);
+                shard->queries[i][object] = q;
+                shard->invertedQueries[q] = object;
+                shard->firstIteration.insert(q);
                 q->setEventListener(this);
             }
         }
@@ -1208,23 +1934,30 @@ void LibproxProximity::handleUpdateObjectQuery(const UUID& object, const TimedMo
     }
 }
 
-void LibproxProximity::handleRemoveObjectQuery(const UUID& object, bool notify_main_thread) {
+void LibproxProximity::handleRemoveObjectQuery(ObjectQueryShard* shard, const UUID& object, bool notify_main_thread) {
+    markQueriesDirty(&shard->dirty);
+
     // Clear out queries
     for(int i = 0; i < NUM_OBJECT_CLASSES; i++) {
-        if (mObjectQueryHandler[i].handler == NULL) continue;
+        if (shard->handlers[i].handler == NULL) continue;
 
-        ObjectQueryMap::iterator it = mObjectQueries[i].find(object);
-        if (it == mObjectQueries[i].end()) continue;
+        ObjectQueryMap::iterator it = shard->queries[i].find(object);
+        if (it == shard->queries[i].end()) continue;
 
         Query* q = it->second;
-        mObjectQueries[i].erase(it);
-        mInvertedObjectQueries.erase(q);
-        mObjectQueriesFirstIteration.erase(q);
+        shard->queries[i].erase(it);
+        shard->invertedQueries.erase(q);
+        shard->firstIteration.erase(q);
         delete q; // Note: Deleting query notifies QueryHandler and unsubscribes.
     }
 
-    // Clear out sequence numbers
-    eraseSeqNoInfo(object);
+    // Clear out sequence numbers and results that haven't been sent
+    eraseSeqNoInfo(shard, object);
+    shard->pendingResults.erase(object);
+    {
+        boost::mutex::scoped_lock lock(shard->inFlightMutex);
+        shard->inFlight.erase(object);
+    }
 
     // Optionally let the main thread know to clear its communication state
     if (notify_main_thread) {
@@ -1237,9 +1970,9 @@ void LibproxProximity::handleRemoveObjectQuery(const UUID& object, bool notify_m
     }
 }
 
-void LibproxProximity::handleDisconnectedObject(const UUID& object) {
+void LibproxProximity::handleDisconnectedObject(ObjectQueryShard* shard, const UUID& object) {
     // Clear out query state if it exists
-    handleRemoveObjectQuery(object, false);
+    handleRemoveObjectQuery(shard, object, false);
 }
 
 bool LibproxProximity::handlerShouldHandleObject(bool is_static_handler, bool is_global_handler, const UUID& obj_id, bool is_local, bool is_aggregate, const TimedMotionVector3f& pos, const BoundingSphere3f& region, float maxSize) {
@@ -1267,29 +2000,38 @@ bool LibproxProximity::handlerShouldHandleObject(bool is_static_handler, bool is
         return false;
 }
 
-void LibproxProximity::handleCheckObjectClassForHandlers(const UUID& objid, bool is_static, ProxQueryHandlerData handlers[NUM_OBJECT_CLASSES]) {
+void LibproxProximity::handleCheckObjectClassForHandlers(const UUID& objid, bool is_static, ProxQueryHandlerData handlers[NUM_OBJECT_CLASSES], bool shard_replica) {
     if ( (is_static && handlers[OBJECT_CLASS_STATIC].handler->containsObject(objid)) ||
         (!is_static && handlers[OBJECT_CLASS_DYNAMIC].handler->containsObject(objid)) )
         return;
 
-    // Validate that the other handler has the object.
-    assert(
-        (is_static && handlers[OBJECT_CLASS_DYNAMIC].handler->containsObject(objid)) ||
-        (!is_static && handlers[OBJECT_CLASS_STATIC].handler->containsObject(objid))
-    );
-
     // If it wasn't in the right place, switch it.
     int swap_out = is_static ? OBJECT_CLASS_DYNAMIC : OBJECT_CLASS_STATIC;
     int swap_in = is_static ? OBJECT_CLASS_STATIC : OBJECT_CLASS_DYNAMIC;
+
+    // Shards with their own location cache may not have seen the object
+    // yet. In that case the handlers pick the right class when it gets added,
+    // so there's nothing to swap.
+    if (shard_replica && !handlers[swap_out].handler->containsObject(objid))
+        return;
+
+    // Validate that the other handler has the object.
+    assert(handlers[swap_out].handler->containsObject(objid));
     PROXLOG(debug, "Swapping " << objid.toString() << " from " << ObjectClassToString((ObjectClass)swap_out) << " to " << ObjectClassToString((ObjectClass)swap_in));
     handlers[swap_out].removals.insert(objid);
     handlers[swap_in].additions.insert(objid);
 }
 
 void LibproxProximity::trySwapHandlers(bool is_local, const UUID& objid, bool is_static) {
-    handleCheckObjectClassForHandlers(objid, is_static, mObjectQueryHandler);
+    for(ObjectQueryShardList::iterator it = mObjectShards.begin(); it != mObjectShards.end(); it++) {
+        postToObjectQueryShard(
+            *it,
+            std::tr1::bind(&LibproxProximity::handleCheckObjectClassForHandlers, this, objid, is_static, (*it)->handlers, (*it)->locCache != mLocCache),
+            "LibproxProximity::handleCheckObjectClassForHandlers"
+        );
+    }
     if (is_local)
-        handleCheckObjectClassForHandlers(objid, is_static, mServerQueryHandler);
+        handleCheckObjectClassForHandlers(objid, is_static, mServerQueryHandler, false);
 }
 
 } // namespace Sirikata
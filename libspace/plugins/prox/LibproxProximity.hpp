@@ -41,6 +41,11 @@
 
 #include <sirikata/core/network/SSTImpl.hpp>
 #include <sirikata/core/queue/ThreadSafeQueue.hpp>
+#include <sirikata/core/network/IOServicePool.hpp>
+#include <sirikata/core/command/Command.hpp>
+#include <sirikata/space/QueryShardAssignment.hpp>
+#include <sirikata/space/ProxTickScheduler.hpp>
+#include <sirikata/space/SharedServerQueries.hpp>
 
 namespace Sirikata {
 
@@ -82,8 +87,10 @@ public:
     virtual void localObjectRemoved(const UUID& uuid, bool agg);
     virtual void localLocationUpdated(const UUID& uuid, bool agg, const TimedMotionVector3f& newval);
     virtual void localBoundsUpdated(const UUID& uuid, bool agg, const AggregateBoundingInfo& newval);
+    virtual void replicaObjectAdded(const UUID& uuid, const TimedMotionVector3f& loc, const TimedMotionQuaternion& orient, const AggregateBoundingInfo& bounds, const String& mesh, const String& physics, const String& zernike);
     virtual void replicaObjectRemoved(const UUID& uuid);
     virtual void replicaLocationUpdated(const UUID& uuid, const TimedMotionVector3f& newval);
+    virtual void replicaBoundsUpdated(const UUID& uuid, const AggregateBoundingInfo& newval);
 
     // MessageRecipient Interface
     virtual void receiveMessage(Message* msg);
@@ -110,6 +117,12 @@ public:
 
 private:
     struct ProxQueryHandlerData;
+    struct SharedServerQuery;
+    struct ObjectQueryShard;
+    struct DirtyState;
+    struct LatencyHistogram;
+    typedef std::tr1::unordered_map<UUID, Time, UUID::Hasher> ObjectUpdateTimes;
+    typedef std::set<UUID> ObjectSet;
 
     void handleObjectProximityMessage(const UUID& objid, void* buffer, uint32 length);
 
@@ -135,6 +148,10 @@ private:
     // update
     void sendQueryRequests();
 
+    // Record that an object changed so the handlers that may contain it get
+    // ticked. Server query handlers only contain local objects.
+    void markObjectDirty(const UUID& uuid, bool local);
+
 
     // PROX Thread: These are utility methods which should only be called from the prox thread.
 
@@ -145,18 +162,30 @@ private:
     // Override for forced disconnections
     virtual void handleForcedDisconnection(ServerID server);
 
-    void handleUpdateObjectQuery(const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno);
-    void handleRemoveObjectQuery(const UUID& object, bool notify_main_thread);
-    void handleDisconnectedObject(const UUID& object);
+    // SHARD Threads: These are called on the strand of the shard that owns the
+    // object's query.
+    void handleUpdateObjectQuery(ObjectQueryShard* shard, const UUID& object, const TimedMotionVector3f& loc, const BoundingSphere3f& bounds, const SolidAngle& angle, uint32 max_results, SeqNoPtr seqno);
+    void handleRemoveObjectQuery(ObjectQueryShard* shard, const UUID& object, bool notify_main_thread);
+    void handleDisconnectedObject(ObjectQueryShard* shard, const UUID& object);
 
     // Generate query events based on results collected from query handlers
     void generateServerQueryEvents(Query* query);
-    void generateObjectQueryEvents(Query* query, bool do_first=false);
+    void generateObjectQueryEvents(ObjectQueryShard* shard, Query* query, bool do_first=false);
+    // Send events from a shared query to one of the servers sharing it
+    void sendServerQueryEvents(ServerID sid, const QueryEventList& evts, const Time& t);
+    // Send the difference between two result sets to a server, e.g. when it
+    // joins or leaves a shared query
+    void sendServerQueryDelta(ServerID sid, const ObjectSet& additions, const ObjectSet& removals, const Time& t);
+    // Send pending object query results for all queriers in the shard that
+    // have room in their streams
+    void flushObjectQueryResults(ObjectQueryShard* shard);
 
     // Decides whether a query handler should handle a particular object.
     bool handlerShouldHandleObject(bool is_static_handler, bool is_global_handler, const UUID& obj_id, bool local, bool aggregate, const TimedMotionVector3f& pos, const BoundingSphere3f& region, float maxSize);
-    // The real handler for moving objects between static/dynamic
-    void handleCheckObjectClassForHandlers(const UUID& objid, bool is_static, ProxQueryHandlerData handlers[NUM_OBJECT_CLASSES]);
+    // The real handler for moving objects between static/dynamic. Handlers
+    // fed by their own location cache (shard_replica) may not have seen the
+    // object yet.
+    void handleCheckObjectClassForHandlers(const UUID& objid, bool is_static, ProxQueryHandlerData handlers[NUM_OBJECT_CLASSES], bool shard_replica);
     virtual void trySwapHandlers(bool is_local, const UUID& objid, bool is_static);
 
     /**
@@ -167,12 +196,21 @@ private:
      */
     SeqNoPtr getOrCreateSeqNoInfo(const ServerID server_id);
     void eraseSeqNoInfo(const ServerID server_id);
-    SeqNoPtr getSeqNoInfo(const UUID& obj_id);
-    void eraseSeqNoInfo(const UUID& obj_id);
+    SeqNoPtr getSeqNoInfo(ObjectQueryShard* shard, const UUID& obj_id);
+    void eraseSeqNoInfo(ObjectQueryShard* shard, const UUID& obj_id);
 
-    typedef std::set<UUID> ObjectSet;
-    typedef std::tr1::unordered_map<ServerID, Query*> ServerQueryMap;
-    typedef std::tr1::unordered_map<Query*, ServerID> InvertedServerQueryMap;
+    // MAIN Thread: Invoked as result messages are written to a querier's
+    // stream, returning capacity to the querier's shard.
+    virtual void objectResultsSent(const UUID& querier, uint32 count);
+
+    // Object queries are assigned to shards by the querier's ID, so all
+    // requests and results for one querier are handled by a single shard
+    ObjectQueryShard* getObjectQueryShard(const UUID& obj_id);
+    // Get the shard that owns the query handler, or NULL for server query
+    // handlers
+    ObjectQueryShard* getObjectQueryShard(const ProxQueryHandler* handler);
+
+    typedef std::tr1::unordered_map<Query*, SharedServerQuery*> InvertedServerQueryMap;
     typedef std::tr1::unordered_map<UUID, Query*, UUID::Hasher> ObjectQueryMap;
     typedef std::tr1::unordered_set<Query*> FirstIterationObjectSet;
     typedef std::tr1::unordered_map<Query*, UUID> InvertedObjectQueryMap;
@@ -217,8 +255,18 @@ private:
     // PROX Thread - Should only be accessed in methods used by the prox thread
 
     void tickQueryHandler(ProxQueryHandlerData qh[NUM_OBJECT_CLASSES]);
+    void tickServerQueryHandler();
     void rebuildHandlerType(ProxQueryHandlerData* handler, ObjectClass objtype);
     void rebuildHandler(ObjectClass objtype);
+    // Runs on the shard's strand
+    void tickObjectQueryShard(ObjectQueryShard* shard);
+    // Runs fn on the shard's strand, directly if it is the prox strand
+    void postToObjectQueryShard(ObjectQueryShard* shard, const Network::IOCallback& fn, const char* tag);
+
+    // Decides whether a set of handlers needs a tick now. If it does, the
+    // objects updated since the last tick are moved into updated_out and the
+    // dirty state is reset. In polling mode this always returns true.
+    bool checkTickNeeded(DirtyState* dirty, ProxQueryHandlerData qh[NUM_OBJECT_CLASSES], const Time& now, ObjectUpdateTimes* updated_out);
 
     // Command handlers
     virtual void commandProperties(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
@@ -227,6 +275,48 @@ private:
     virtual void commandForceRebuild(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
     virtual void commandListNodes(const Command::Command& cmd, Command::Commander* cmdr, Command::CommandID cmdid);
 
+    // Tracks objects and queries which changed since a set of handlers was
+    // last ticked, so that in event driven mode we only tick when there is
+    // work to do. Objects are marked from the main thread, so everything but
+    // ticks is protected by the mutex.
+    struct DirtyState {
+        DirtyState()
+         : queries(0)
+        {}
+
+        boost::mutex mutex;
+        // Time of each object's first update since the last tick
+        ObjectUpdateTimes objects;
+        uint32 queries;
+        // Only accessed when ticking
+        ProxTickScheduler ticks;
+    };
+    static void markObjectDirty(DirtyState* dirty, const UUID& uuid, const Time& t);
+    static void markQueriesDirty(DirtyState* dirty);
+
+    // Histogram of the time between an object update and a result reporting
+    // the resulting change to a querier. Buckets are powers of two
+    // milliseconds, the first holding everything under 1ms and the last
+    // everything over the largest bound.
+    struct LatencyHistogram {
+        enum {
+            NUM_BUCKETS = 12
+        };
+
+        LatencyHistogram();
+
+        void add(const Duration& dt);
+        void merge(const LatencyHistogram& other);
+        void report(Command::Result& result, const String& prefix) const;
+
+        uint32 buckets[NUM_BUCKETS];
+        uint32 samples;
+        Duration total;
+        Duration max;
+    };
+    // Adds a sample to hist if objid was updated before the current tick
+    static void sampleResultLatency(const ObjectUpdateTimes& updates, const UUID& objid, const Time& t, LatencyHistogram* hist);
+
     typedef std::tr1::unordered_set<UUID, UUID::Hasher> ObjectIDSet;
     struct ProxQueryHandlerData {
         ProxQueryHandler* handler;
@@ -239,25 +329,156 @@ private:
         ObjectIDSet additions;
         ObjectIDSet removals;
     };
+
+    // Parameters of a query from another server
+    struct ServerQueryParams {
+        TimedMotionVector3f loc;
+        BoundingSphere3f bounds;
+        SolidAngle angle;
+        uint32 maxResults;
+    };
+    // A query evaluated once on behalf of one or more servers. Servers asking
+    // for similar angles from nearby regions can share a single query
+    // covering all their regions with the smallest angle any of them asked
+    // for, so results are computed once and the changes sent to each of
+    // them. The current results are kept so a server joining or leaving only
+    // needs to be sent the difference, see SharedServerQueries.
+    struct SharedServerQuery : public SharedQueryResults {
+        SharedServerQuery();
+
+        typedef std::tr1::unordered_map<ServerID, ServerQueryParams> MemberMap;
+        MemberMap members;
+        Query* queries[NUM_OBJECT_CLASSES];
+    };
+
+    // Computes the parameters of sq's query with member's parameters replaced
+    // by params, or member removed if params is NULL. Returns false if the
+    // remaining members are too different to share a query.
+    bool combineServerQueryParams(const SharedServerQuery* sq, const ServerID& member, const ServerQueryParams* params, ServerQueryParams* combined_out);
+    // Registers or updates sq's queries in the handlers
+    void applyServerQueryParams(SharedServerQuery* sq, const ServerQueryParams& params);
+    // Removes server from sq, destroying it if it was the last member
+    void leaveSharedServerQuery(SharedServerQuery* sq, const ServerID& server);
+    void destroySharedServerQuery(SharedServerQuery* sq);
+    // Sends the changes to a server's results when it moves between queries
+    void sendServerQueryMoveDelta(const ServerID& server, const ObjectSet& additions, const ObjectSet& removals);
+
     // These track local objects and answer queries from other
     // servers.
-    ServerQueryMap mServerQueries[NUM_OBJECT_CLASSES];
+    SharedServerQueries<SharedServerQuery> mSharedServerQueries;
     InvertedServerQueryMap mInvertedServerQueries;
     ProxQueryHandlerData mServerQueryHandler[NUM_OBJECT_CLASSES];
     bool mServerDistance; // Using distance queries
+    // Whether servers with similar queries share them and the largest factor
+    // a server's region may be grown by to share another's query
+    bool mShareServerQueries;
+    float32 mServerQueryShareRadius;
     // Results from queries to other servers, so we know what we need to remove
     // on forceful disconnection
     ServerQueryResultSet mServerQueryResults;
     PollerService mServerHandlerPoller;
+    DirtyState mServerDirty;
+    ObjectUpdateTimes mServerTickUpdates; // Objects updated before the current tick
+    LatencyHistogram mServerResultLatency;
+    uint32 mServerTicks;
+    uint32 mServerSkippedTicks;
+
+    typedef std::tr1::unordered_map<UUID, SeqNoPtr, UUID::Hasher> ObjectSeqNoInfoMap;
 
-    // These track all objects being reported to this server and
-    // answer queries for objects connected to this server.
-    ObjectQueryMap mObjectQueries[NUM_OBJECT_CLASSES];
-    InvertedObjectQueryMap mInvertedObjectQueries;
-    FirstIterationObjectSet mObjectQueriesFirstIteration;
-    ProxQueryHandlerData mObjectQueryHandler[NUM_OBJECT_CLASSES];
+    // Results for a single querier which have been generated but not sent
+    // yet. An addition and a removal of the same object cancel each other, so
+    // each object appears at most once. Each entry records when the object was
+    // updated, or Time::null() if the result wasn't due to an update.
+    struct PendingResults {
+        typedef std::tr1::unordered_map<UUID, Time, UUID::Hasher> AdditionMap;
+        // Object -> (permanent, update time)
+        typedef std::tr1::unordered_map<UUID, std::pair<bool, Time>, UUID::Hasher> RemovalMap;
+
+        bool empty() const { return additions.empty() && removals.empty(); }
+
+        AdditionMap additions;
+        RemovalMap removals;
+    };
+    typedef std::tr1::unordered_map<UUID, PendingResults, UUID::Hasher> PendingResultsMap;
+    typedef std::tr1::unordered_map<UUID, uint32, UUID::Hasher> ResultCountMap;
+
+    // Sends up to max_messages of the querier's pending results, removals
+    // first and then additions in priority order. Returns the number of
+    // messages sent.
+    uint32 sendPendingResults(ObjectQueryShard* shard, const UUID& query_id, PendingResults& pending, uint32 max_messages, LatencyHistogram* latencies);
+
+    // These track all objects being reported to this server and answer
+    // queries for objects connected to this server. Queries are partitioned
+    // across shards, each with its own replica of the query handlers and
+    // location cache, so they can be ticked in parallel. Results from all
+    // shards are merged into mObjectResults. Shard 0 always runs on the prox
+    // strand; the others run on mObjectShardService. Except for the stats,
+    // shard state is only accessed from the shard's strand.
+    struct ObjectQueryShard {
+        ObjectQueryShard(uint32 idx);
+
+        uint32 index;
+        Network::IOStrand* strand;
+        CBRLocationServiceCache* locCache;
+        PollerService* poller;
+
+        ObjectQueryMap queries[NUM_OBJECT_CLASSES];
+        InvertedObjectQueryMap invertedQueries;
+        FirstIterationObjectSet firstIteration;
+        ProxQueryHandlerData handlers[NUM_OBJECT_CLASSES];
+        ObjectSeqNoInfoMap seqNos;
+
+        DirtyState dirty;
+        // Objects updated before the current tick
+        ObjectUpdateTimes tickUpdates;
+        // Query events generated during the current tick
+        uint32 tickEvents;
+        // Results waiting for room in the querier's stream
+        PendingResultsMap pendingResults;
+
+        // Result messages handed to the main thread for each querier that
+        // haven't been written to its stream yet. Decremented by the main
+        // thread, so protected by its own mutex.
+        boost::mutex inFlightMutex;
+        ResultCountMap inFlight;
+
+        // Stats, updated at the end of each tick and read by the main thread
+        // and commands
+        boost::mutex statsMutex;
+        uint32 numQueries;
+        uint32 ticks;
+        Duration lastTickTime;
+        Duration maxTickTime;
+        float64 avgTickTime; // seconds, moving average
+        uint32 lastTickEvents;
+        float64 avgTickEvents; // moving average
+        uint32 skippedTicks;
+        LatencyHistogram resultLatency;
+        uint32 pendingResultCount;
+        uint64 cancelledResults;
+        uint64 throttledFlushes; // Queriers left waiting for stream capacity
+        // Handler sizes as of the last tick, for listing handlers
+        uint32 handlerQueries[NUM_OBJECT_CLASSES];
+        uint32 handlerObjects[NUM_OBJECT_CLASSES];
+        uint32 handlerNodes[NUM_OBJECT_CLASSES];
+    };
+    typedef std::vector<ObjectQueryShard*> ObjectQueryShardList;
+    QueryShardAssignment mObjectShardAssignment;
+    ObjectQueryShardList mObjectShards;
+    Network::IOServicePool* mObjectShardService;
     bool mObjectDistance; // Using distance queries
-    PollerService mObjectHandlerPoller;
+    // Maximum number of result messages per querier that may be waiting to be
+    // written to its stream, or 0 for no limit
+    uint32 mMaxOutstandingResults;
+
+    // In event driven mode, handlers are checked every mMinTickInterval but
+    // only ticked if objects or queries changed or mMaxTickInterval has passed
+    // since their last tick. While changes keep arriving, ticks are spaced at
+    // least mLoadedTickInterval apart.
+    bool mEventDrivenTicks;
+    Duration mMinTickInterval;
+    Duration mMaxTickInterval;
+    Duration mLoadedTickInterval;
 
     // Pollers that trigger rebuilding of query data structures
     PollerService mStaticRebuilderPoller;
@@ -266,8 +487,6 @@ private:
     // Track SeqNo info for each querier
     typedef std::tr1::unordered_map<ServerID, SeqNoPtr> ServerSeqNoInfoMap;
     ServerSeqNoInfoMap mServerSeqNos;
-    typedef std::tr1::unordered_map<UUID, SeqNoPtr, UUID::Hasher> ObjectSeqNoInfoMap;
-    ObjectSeqNoInfoMap mObjectSeqNos;
 
 
     // Threads: Thread-safe data used for exchange between threads
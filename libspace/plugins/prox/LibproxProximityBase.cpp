@@ -63,6 +63,7 @@ void LibproxProximityBase::ProxStreamInfo<EndpointType, StreamType>::writeSomeOb
     }
 
     // Otherwise, keep sending until we run out or
+    uint32 frames_written = 0;
     while(!prox_stream->outstanding.empty()) {
         std::string& framed_prox_msg = prox_stream->outstanding.front();
         int bytes_written = prox_stream->iostream->write((const uint8*)framed_prox_msg.data(), framed_prox_msg.size());
@@ -76,9 +77,13 @@ void LibproxProximityBase::ProxStreamInfo<EndpointType, StreamType>::writeSomeOb
         }
         else {
             prox_stream->outstanding.pop();
+            frames_written++;
         }
     }
 
+    if (frames_written > 0 && prox_stream->sentcb)
+        prox_stream->sentcb(frames_written);
+
     if (prox_stream->outstanding.empty())
         prox_stream->writing = false;
     else
@@ -431,6 +436,8 @@ void LibproxProximityBase::sendObjectResult(Sirikata::Protocol::Object::ObjectMe
         );
     }
     ProxObjectStreamInfoPtr prox_stream = prox_stream_it->second;
+    if (!prox_stream->sentcb)
+        prox_stream->sentcb = std::tr1::bind(&LibproxProximityBase::objectResultsSent, this, msg->dest_object(), _1);
 
     // If we don't have a stream yet, try to build it
     if (!prox_stream->iostream_requested)
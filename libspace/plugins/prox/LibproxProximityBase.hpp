@@ -160,6 +160,9 @@ protected:
         bool writing;
         // Stored callback for writing
         std::tr1::function<void()> writecb;
+        // Optional callback invoked with the number of frames that have been
+        // completely written to the stream
+        std::tr1::function<void(uint32)> sentcb;
 
         // Stored callback for reading frames
         FrameReceivedCallback read_frame_cb;
@@ -197,6 +200,10 @@ protected:
     // Utility for poll.  Queues a message for delivery, encoding it and putting
     // it on the send stream.  If necessary, starts send processing on the stream.
     void sendObjectResult(Sirikata::Protocol::Object::ObjectMessage*);
+    // Invoked as results queued by sendObjectResult are written to the
+    // querier's stream. Implementations can use this to avoid generating
+    // results faster than the stream can carry them.
+    virtual void objectResultsSent(const UUID& querier, uint32 count) {}
     void sendObjectHostResult(const OHDP::NodeID& node, Sirikata::Protocol::Object::ObjectMessage*);
 
     // Helpers that are protocol-specific
@@ -10,10 +10,18 @@
 #define OPT_PROX_QUERY_RANGE       "prox.range"
 #define PROX_MAX_PER_RESULT        "prox.max-per-result"
 #define OPT_PROX_SPLIT_DYNAMIC     "prox.split-dynamic"
+#define OPT_PROX_EVENT_DRIVEN_TICKS "prox.event-driven"
+#define OPT_PROX_MIN_TICK_INTERVAL  "prox.min-tick-interval"
+#define OPT_PROX_MAX_TICK_INTERVAL  "prox.max-tick-interval"
+#define OPT_PROX_LOADED_TICK_INTERVAL "prox.loaded-tick-interval"
 
 #define OPT_PROX_SERVER_QUERY_HANDLER_TYPE         "prox.server.handler"
 #define OPT_PROX_SERVER_QUERY_HANDLER_OPTIONS      "prox.server.handler-options"
+#define OPT_PROX_SERVER_SHARE_QUERIES              "prox.server.share-queries"
+#define OPT_PROX_SERVER_SHARE_RADIUS               "prox.server.share-radius"
 #define OPT_PROX_OBJECT_QUERY_HANDLER_TYPE         "prox.object.handler"
 #define OPT_PROX_OBJECT_QUERY_HANDLER_OPTIONS      "prox.object.handler-options"
+#define OPT_PROX_OBJECT_QUERY_SHARDS               "prox.object.shards"
+#define OPT_PROX_MAX_OUTSTANDING_RESULTS           "prox.object.max-outstanding-results"
 
 #endif //_SIRIKATA_SPACE_PROX_OPTIONS_HPP_
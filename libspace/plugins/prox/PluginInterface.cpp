@@ -54,13 +54,22 @@ static void InitPluginOptions() {
 
         .addOption(new OptionValue(OPT_PROX_SPLIT_DYNAMIC, "true", Sirikata::OptionValueType<bool>(), "If true, separate query handlers will be used for static and dynamic objects."))
 
+        .addOption(new OptionValue(OPT_PROX_EVENT_DRIVEN_TICKS, "false", Sirikata::OptionValueType<bool>(), "If true, query handlers are only ticked when objects or queries have changed, instead of at a fixed rate."))
+        .addOption(new OptionValue(OPT_PROX_MIN_TICK_INTERVAL, "10ms", Sirikata::OptionValueType<Duration>(), "In event driven mode, the minimum time between ticks of a query handler."))
+        .addOption(new OptionValue(OPT_PROX_MAX_TICK_INTERVAL, "1s", Sirikata::OptionValueType<Duration>(), "In event driven mode, the maximum time between ticks of a query handler. Objects moving without sending updates are only reevaluated this often."))
+        .addOption(new OptionValue(OPT_PROX_LOADED_TICK_INTERVAL, "100ms", Sirikata::OptionValueType<Duration>(), "In event driven mode, the minimum time between ticks of a query handler when changes keep arriving, so continuous updates don't tick it faster than the fixed rate would."))
+
         .addOption(new OptionValue(OPT_PROX_QUERY_RANGE, "100", Sirikata::OptionValueType<float32>(), "The range of queries when using range queries instead of solid angle queries."))
 
         .addOption(new OptionValue(OPT_PROX_SERVER_QUERY_HANDLER_TYPE, "rtreecut", Sirikata::OptionValueType<String>(), "Type of libprox query handler to use for queries from servers."))
         .addOption(new OptionValue(OPT_PROX_SERVER_QUERY_HANDLER_OPTIONS, "", Sirikata::OptionValueType<String>(), "Options for the query handler."))
+        .addOption(new OptionValue(OPT_PROX_SERVER_SHARE_QUERIES, "false", Sirikata::OptionValueType<bool>(), "If true, queries from servers with similar angles and nearby regions are evaluated once and their results shared."))
+        .addOption(new OptionValue(OPT_PROX_SERVER_SHARE_RADIUS, "1.5", Sirikata::OptionValueType<float32>(), "Largest factor by which a server's query region may be grown to share another server's query."))
 
         .addOption(new OptionValue(OPT_PROX_OBJECT_QUERY_HANDLER_TYPE, "rtreecut", Sirikata::OptionValueType<String>(), "Type of libprox query handler to use for queries from servers."))
         .addOption(new OptionValue(OPT_PROX_OBJECT_QUERY_HANDLER_OPTIONS, "", Sirikata::OptionValueType<String>(), "Options for the query handler."))
+        .addOption(new OptionValue(OPT_PROX_OBJECT_QUERY_SHARDS, "1", Sirikata::OptionValueType<uint32>(), "Number of shards to split queries from objects across. Each shard has its own copy of the object query handlers and is ticked in parallel on its own thread."))
+        .addOption(new OptionValue(OPT_PROX_MAX_OUTSTANDING_RESULTS, "16", Sirikata::OptionValueType<uint32>(), "Maximum number of result messages per querier waiting to be written to its stream. Further results are held back, cancelling additions and removals of the same object and sending the most important objects first once there's room. 0 means no limit."))
 
         ;
 }
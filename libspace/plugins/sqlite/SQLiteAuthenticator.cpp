@@ -132,10 +132,46 @@ void SQLiteAuthenticator::authenticate(const UUID& obj_id, MemoryReference auth,
     // Treat the auth data as just a string. We should have some encoding and .
     String auth_ticket((const char*)auth.data(), (size_t)auth.size());
 
-    bool found_ticket = checkTicket(auth_ticket);
-    if (found_ticket) deleteTicket(auth_ticket);
+    respond(cb, useTicket(auth_ticket));
+}
+
+bool SQLiteAuthenticator::useTicket(const String& ticket) {
+    bool found_ticket = checkTicket(ticket);
+    if (found_ticket) deleteTicket(ticket);
+    return found_ticket;
+}
+
+void SQLiteAuthenticator::authenticateBatch(const std::vector<UUID>& obj_ids, const std::vector<String>& auths, BatchCallback cb) {
+    std::vector<bool> results(auths.size(), false);
+    if (!mDB) {
+        mContext->mainStrand->post(
+            std::tr1::bind(cb, results),
+            "SQLiteAuthenticator::authenticateBatch"
+        );
+        return;
+    }
+
+    // Run all the lookups and deletions in one transaction so the batch only
+    // pays for one commit instead of one per ticket
+    int rc = sqlite3_exec(mDB->db(), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    bool in_transaction = !checkSQLiteError(rc, "Error beginning authentication transaction");
+
+    for(uint32 i = 0; i < auths.size(); i++)
+        results[i] = useTicket(auths[i]);
+
+    if (in_transaction) {
+        rc = sqlite3_exec(mDB->db(), "COMMIT TRANSACTION", NULL, NULL, NULL);
+        if (checkSQLiteError(rc, "Error committing authentication transaction")) {
+            // Tickets weren't consumed, so don't let them be used
+            sqlite3_exec(mDB->db(), "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+            results.assign(auths.size(), false);
+        }
+    }
 
-    respond(cb, found_ticket);
+    mContext->mainStrand->post(
+        std::tr1::bind(cb, results),
+        "SQLiteAuthenticator::authenticateBatch"
+    );
 }
 
 } // namespace Sirikata
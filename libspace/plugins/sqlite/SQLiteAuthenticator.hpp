@@ -47,6 +47,7 @@ public:
     virtual void stop();
 
     virtual void authenticate(const UUID& obj_id, MemoryReference auth, Callback cb);
+    virtual void authenticateBatch(const std::vector<UUID>& obj_ids, const std::vector<String>& auths, BatchCallback cb);
 
 private:
     // Helper that checks and logs errors, then returns bool indicating
@@ -59,6 +60,8 @@ private:
     void deleteTicket(const String& ticket);
     // Generate the response to the auth request
     void respond(Callback cb, bool result);
+    // Check and consume a ticket, returning whether it was valid
+    bool useTicket(const String& ticket);
 
     SpaceContext* mContext;
     String mDBFile;
@@ -47,22 +47,12 @@ void InitAlwaysLocationUpdatePolicyOptions() {
 
 AlwaysLocationUpdatePolicy::AlwaysLocationUpdatePolicy(SpaceContext* ctx, const String& args)
  : LocationUpdatePolicy(),
-   mStatsPoller(
-       ctx->mainStrand,
-       std::tr1::bind(&AlwaysLocationUpdatePolicy::reportStats, this),
-       "AlwaysLocationUpdatePolicy Stats Poll",
-       Duration::seconds((int64)1)
-   ),
-   mLastStatsTime(ctx->simTime()),
-   mTimeSeriesServerUpdatesName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.server_updates_per_second"),
-   mServerUpdatesPerSecond(0),
-   mTimeSeriesOHUpdatesName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.oh_updates_per_second"),
-   mOHUpdatesPerSecond(0),
-   mTimeSeriesObjectUpdatesName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.object_updates_per_second"),
-   mObjectUpdatesPerSecond(0),
-   mServerSubscriptions(this, mServerUpdatesPerSecond),
-   mOHSubscriptions(this, mOHUpdatesPerSecond),
-   mObjectSubscriptions(this, mObjectUpdatesPerSecond)
+   mServerUpdates(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.server_updates_per_second")),
+   mOHUpdates(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.oh_updates_per_second")),
+   mObjectUpdates(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".loc.object_updates_per_second")),
+   mServerSubscriptions(this, *mServerUpdates),
+   mOHSubscriptions(this, *mOHUpdates),
+   mObjectSubscriptions(this, *mObjectUpdates)
 {
     OptionSet* optionsSet = OptionSet::getOptions(ALWAYS_POLICY_OPTIONS,NULL);
     optionsSet->parse(args);
@@ -72,38 +62,11 @@ AlwaysLocationUpdatePolicy::~AlwaysLocationUpdatePolicy() {
 }
 
 void AlwaysLocationUpdatePolicy::start() {
-    mStatsPoller.start();
 }
 
 void AlwaysLocationUpdatePolicy::stop() {
-    mStatsPoller.stop();
 }
 
-void AlwaysLocationUpdatePolicy::reportStats() {
-    Time tnow = mLocService->context()->recentSimTime();
-    float32 since_last_seconds = (tnow - mLastStatsTime).seconds();
-    mLastStatsTime = tnow;
-
-    mLocService->context()->timeSeries->report(
-        mTimeSeriesServerUpdatesName,
-        mServerUpdatesPerSecond.read() / since_last_seconds
-    );
-    mServerUpdatesPerSecond = 0;
-
-    mLocService->context()->timeSeries->report(
-        mTimeSeriesOHUpdatesName,
-        mOHUpdatesPerSecond.read() / since_last_seconds
-    );
-    mOHUpdatesPerSecond = 0;
-
-    mLocService->context()->timeSeries->report(
-        mTimeSeriesObjectUpdatesName,
-        mObjectUpdatesPerSecond.read() / since_last_seconds
-    );
-    mObjectUpdatesPerSecond = 0;
-}
-
-
 // Server subscriptions
 
 void AlwaysLocationUpdatePolicy::subscribe(ServerID remote, const UUID& uuid, SeqNoPtr seqnoPtr)
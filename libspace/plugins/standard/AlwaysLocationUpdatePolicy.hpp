@@ -93,7 +93,6 @@ public:
     virtual void service();
 
 private:
-    void reportStats();
 
 
     struct UpdateInfo {
@@ -157,7 +156,7 @@ private:
     template<typename SubscriberType>
     struct SubscriberIndex {
         AlwaysLocationUpdatePolicy* parent;
-        AtomicValue<uint32>& sent_count;
+        Trace::MetricCounter& sent_count;
         typedef std::set<SubscriberType> SubscriberSet;
         typedef std::tr1::shared_ptr<SubscriberInfo> SubscriberInfoPtr;
         // Forward index: Subscriber -> Objects + Updates
@@ -167,7 +166,7 @@ private:
         typedef std::map<UUID, SubscriberSet*> ObjectSubscribersMap;
         ObjectSubscribersMap mObjectSubscribers;
 
-        SubscriberIndex(AlwaysLocationUpdatePolicy* p, AtomicValue<uint32>& _sent_count)
+        SubscriberIndex(AlwaysLocationUpdatePolicy* p, Trace::MetricCounter& _sent_count)
          : parent(p),
            sent_count(_sent_count)
         {
@@ -515,14 +514,10 @@ private:
     bool trySend(const UUID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount);
     bool trySend(const OHDP::NodeID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount);
     bool trySend(const ServerID& dest, const Sirikata::Protocol::Loc::BulkLocationUpdate& blu, const SubscriberInfoPtr& numOutstandingMessageCount);
-    Poller mStatsPoller;
-    Time mLastStatsTime;
-    const String mTimeSeriesServerUpdatesName;
-    AtomicValue<uint32> mServerUpdatesPerSecond;
-    const String mTimeSeriesOHUpdatesName;
-    AtomicValue<uint32> mOHUpdatesPerSecond;
-    const String mTimeSeriesObjectUpdatesName;
-    AtomicValue<uint32> mObjectUpdatesPerSecond;
+    // Updates sent to each type of subscriber, reported per second
+    Trace::MetricCounter* mServerUpdates;
+    Trace::MetricCounter* mOHUpdates;
+    Trace::MetricCounter* mObjectUpdates;
 
     typedef SubscriberIndex<ServerID> ServerSubscriberIndex;
     ServerSubscriberIndex mServerSubscriptions;
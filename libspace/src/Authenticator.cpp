@@ -44,4 +44,40 @@ void AuthenticatorFactory::destroy() {
     AutoSingleton<AuthenticatorFactory>::destroy();
 }
 
+namespace {
+struct BatchAuthState {
+    std::vector<bool> results;
+    uint32 remaining;
+    Authenticator::BatchCallback cb;
+};
+typedef std::tr1::shared_ptr<BatchAuthState> BatchAuthStatePtr;
+
+void handleBatchAuthResult(BatchAuthStatePtr state, uint32 idx, bool result) {
+    state->results[idx] = result;
+    state->remaining--;
+    if (state->remaining == 0)
+        state->cb(state->results);
+}
+}
+
+void Authenticator::authenticateBatch(const std::vector<UUID>& obj_ids, const std::vector<String>& auths, BatchCallback cb) {
+    assert(obj_ids.size() == auths.size());
+
+    if (obj_ids.empty()) {
+        cb(std::vector<bool>());
+        return;
+    }
+
+    BatchAuthStatePtr state(new BatchAuthState());
+    state->results.resize(obj_ids.size(), false);
+    state->remaining = obj_ids.size();
+    state->cb = cb;
+    for(uint32 i = 0; i < obj_ids.size(); i++) {
+        authenticate(
+            obj_ids[i], MemoryReference(auths[i]),
+            std::tr1::bind(&handleBatchAuthResult, state, i, std::tr1::placeholders::_1)
+        );
+    }
+}
+
 } // namespace Sirikata
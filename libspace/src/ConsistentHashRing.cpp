@@ -0,0 +1,92 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/space/ConsistentHashRing.hpp>
+
+namespace Sirikata {
+
+namespace {
+
+// Finalizer from splitmix64, spreads nearby inputs, e.g. consecutive server
+// IDs, evenly over the ring
+uint64 mix64(uint64 x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace
+
+ConsistentHashRing::ConsistentHashRing(uint32 virtual_nodes, bool replicate)
+ : mVirtualNodes(std::max(virtual_nodes, (uint32)1)),
+   mReplicate(replicate)
+{
+}
+
+uint64 ConsistentHashRing::hashObject(const UUID& obj_id) {
+    const UUID::Data& data = obj_id.getArray();
+    uint64 hi = 0, lo = 0;
+    for(uint32 i = 0; i < 8; i++) {
+        hi = (hi << 8) | data[i];
+        lo = (lo << 8) | data[i+8];
+    }
+    return mix64(lo ^ mix64(hi));
+}
+
+uint64 ConsistentHashRing::hashVirtualNode(ServerID server, uint32 vnode) {
+    return mix64( ((uint64)server << 32) | vnode );
+}
+
+void ConsistentHashRing::setServers(const ServerSet& servers) {
+    mServers = servers;
+    mRing.clear();
+    for(ServerSet::const_iterator it = servers.begin(); it != servers.end(); it++) {
+        for(uint32 vn = 0; vn < mVirtualNodes; vn++)
+            mRing[hashVirtualNode(*it, vn)] = *it;
+    }
+}
+
+void ConsistentHashRing::owners(const UUID& obj_id, ServerID* primary_out, ServerID* replica_out) const {
+    *primary_out = NullServerID;
+    *replica_out = NullServerID;
+    if (mRing.empty()) return;
+
+    Ring::const_iterator it = mRing.lower_bound(hashObject(obj_id));
+    if (it == mRing.end()) it = mRing.begin();
+    *primary_out = it->second;
+
+    if (!mReplicate) return;
+    // The replica is the next distinct server clockwise
+    for(uint32 i = 0; i < mRing.size(); i++) {
+        it++;
+        if (it == mRing.end()) it = mRing.begin();
+        if (it->second != *primary_out) {
+            *replica_out = it->second;
+            return;
+        }
+    }
+}
+
+bool ConsistentHashRing::rebalance(const ConsistentHashRing& old_ring, ServerID self, const UUID& obj_id, std::vector<ServerID>* dests_out) const {
+    ServerID old_primary, old_replica, new_primary, new_replica;
+    old_ring.owners(obj_id, &old_primary, &old_replica);
+    owners(obj_id, &new_primary, &new_replica);
+
+    ServerID pusher = (mServers.find(old_primary) != mServers.end()) ? old_primary : old_replica;
+    if (pusher == self || old_ring.empty()) {
+        ServerID dests[2] = { new_primary, new_replica };
+        for(uint32 i = 0; i < 2; i++) {
+            ServerID dest = dests[i];
+            if (dest == NullServerID || dest == self ||
+                dest == old_primary || dest == old_replica)
+                continue;
+            dests_out->push_back(dest);
+        }
+    }
+
+    return (new_primary == self || new_replica == self || new_primary == NullServerID);
+}
+
+} // namespace Sirikata
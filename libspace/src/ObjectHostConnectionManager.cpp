@@ -135,23 +135,43 @@ bool ObjectHostConnectionManager::send(const ShortObjectHostConnectionID short_c
     return sendHelper(conn, msg);
 }
 
-bool ObjectHostConnectionManager::sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg) {
-    if (conn == NULL) {
-        SPACE_LOG(error,"Tried to send over invalid connection.");
+bool ObjectHostConnectionManager::send(const ObjectHostConnectionID& conn_id, const std::string& serialized_msg) {
+    if (mContext->stopped()) {
+        SPACE_LOG(fatal,"Trying to send after shutdown requested.");
+        return false;
+    }
+
+    ObjectHostConnection* conn = conn_id.conn;
+
+    if (mConnections.find(conn) == mConnections.end()) {
+        SPACE_LOG(error,"Tried to send over out-of-date connection ID.");
         return false;
     }
 
+    return sendSerializedHelper(conn, serialized_msg);
+}
+
+bool ObjectHostConnectionManager::sendHelper(ObjectHostConnection* conn, Sirikata::Protocol::Object::ObjectMessage* msg) {
     String data;
     serializePBJMessage(&data, *msg);
-    bool sent = conn->socket->send( Sirikata::MemoryReference(data), Sirikata::Network::ReliableOrdered );
+    bool sent = sendSerializedHelper(conn, data);
 
     if (sent) {
         TIMESTAMP(msg, Trace::SPACE_TO_OH_ENQUEUED);
-        delete msg;
+        releaseObjectMessage(msg);
     }
     return sent;
 }
 
+bool ObjectHostConnectionManager::sendSerializedHelper(ObjectHostConnection* conn, const std::string& serialized_msg) {
+    if (conn == NULL) {
+        SPACE_LOG(error,"Tried to send over invalid connection.");
+        return false;
+    }
+
+    return conn->socket->send( Sirikata::MemoryReference(serialized_msg), Sirikata::Network::ReliableOrdered );
+}
+
 
 ObjectHostConnectionID ObjectHostConnectionManager::conn_id(ObjectHostConnection* c) {
     return ObjectHostConnectionID(c);
@@ -258,12 +278,12 @@ void ObjectHostConnectionManager::handleConnectionEvent(ObjectHostConnection* co
 void ObjectHostConnectionManager::handleConnectionRead(ObjectHostConnection* conn, Sirikata::Network::Chunk& chunk, const Sirikata::Network::Stream::PauseReceiveCallback& pause) {
     SPACE_LOG(insane, "Handling connection read: " << chunk.size() << " bytes");
 
-    Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
+    Sirikata::Protocol::Object::ObjectMessage* obj_msg = acquireObjectMessage();
     bool parse_success = obj_msg->ParseFromArray(&(*chunk.begin()),chunk.size());
 
     if (!parse_success) {
         LOG_INVALID_MESSAGE(space, error, chunk);
-        delete obj_msg;
+        releaseObjectMessage(obj_msg);
         return; // Ignore, treat as dropped. Hopefully this doesn't cascade...
     }
 
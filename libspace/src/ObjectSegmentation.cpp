@@ -76,6 +76,11 @@ ObjectSegmentation::~ObjectSegmentation() {
     delete mOSegServerMessageService;
 }
 
+void ObjectSegmentation::addNewObjects(const NewObjectList& objects) {
+    for(NewObjectList::const_iterator it = objects.begin(); it != objects.end(); it++)
+        addNewObject(it->first, it->second);
+}
+
 void ObjectSegmentation::receiveMessage(Message* msg)
 {
     if (msg->dest_port() == SERVER_PORT_OSEG_MIGRATE_ACKNOWLEDGE) {
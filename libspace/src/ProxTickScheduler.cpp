@@ -0,0 +1,51 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/space/ProxTickScheduler.hpp>
+
+namespace Sirikata {
+
+ProxTickScheduler::ProxTickScheduler()
+ : mEventDriven(false),
+   mMaxInterval(Duration::zero()),
+   mLoadedInterval(Duration::zero()),
+   mTickedBefore(false),
+   mLastTick(Time::null()),
+   mLoaded(false)
+{
+}
+
+ProxTickScheduler::ProxTickScheduler(const Duration& max_interval, const Duration& loaded_interval)
+ : mEventDriven(true),
+   mMaxInterval(max_interval),
+   mLoadedInterval(loaded_interval),
+   mTickedBefore(false),
+   mLastTick(Time::null()),
+   mLoaded(false)
+{
+}
+
+bool ProxTickScheduler::tickNeeded(bool has_work, const Time& now) {
+    if (mEventDriven && mTickedBefore) {
+        if (!has_work) {
+            mLoaded = false;
+            if ((now - mLastTick) < mMaxInterval)
+                return false;
+        }
+        else {
+            if (mLoaded && (now - mLastTick) < mLoadedInterval)
+                return false;
+            mLoaded = true;
+        }
+    }
+    else if (mEventDriven) {
+        mLoaded = has_work;
+    }
+
+    mTickedBefore = true;
+    mLastTick = now;
+    return true;
+}
+
+} // namespace Sirikata
@@ -31,9 +31,9 @@ Proximity::Proximity(SpaceContext* ctx, LocationService* locservice, CoordinateS
        std::tr1::bind(&Proximity::reportStats, this),
        "Proximity Stats Poller",
        Duration::seconds((int64)1)),
-   mTimeSeriesObjectQueryCountName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".prox.object_queries"),
-   mTimeSeriesObjectHostQueryCountName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".prox.object_host_queries"),
-   mTimeSeriesServerQueryCountName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".prox.server_queries")
+   mObjectQueryCount(ctx->metrics->gauge(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".prox.object_queries")),
+   mObjectHostQueryCount(ctx->metrics->gauge(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".prox.object_host_queries")),
+   mServerQueryCount(ctx->metrics->gauge(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".prox.server_queries"))
 {
     net->addListener(this);
     mLocService->addListener(this, false);
@@ -64,18 +64,9 @@ void Proximity::poll() {
 }
 
 void Proximity::reportStats() {
-    mContext->timeSeries->report(
-        mTimeSeriesServerQueryCountName,
-        serverQueries()
-    );
-    mContext->timeSeries->report(
-        mTimeSeriesObjectHostQueryCountName,
-        objectHostQueries()
-    );
-    mContext->timeSeries->report(
-        mTimeSeriesObjectQueryCountName,
-        objectQueries()
-    );
+    mServerQueryCount->set(serverQueries());
+    mObjectHostQueryCount->set(objectHostQueries());
+    mObjectQueryCount->set(objectQueries());
 }
 
 } // namespace Sirikata
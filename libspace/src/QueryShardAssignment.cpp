@@ -0,0 +1,19 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <sirikata/space/QueryShardAssignment.hpp>
+
+namespace Sirikata {
+
+QueryShardAssignment::QueryShardAssignment(uint32 nshards)
+ : mNumShards(std::max(nshards, (uint32)1))
+{
+}
+
+uint32 QueryShardAssignment::shard(const UUID& querier) const {
+    if (mNumShards == 1) return 0;
+    return UUID::Hasher()(querier) % mNumShards;
+}
+
+} // namespace Sirikata
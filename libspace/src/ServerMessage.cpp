@@ -32,6 +32,7 @@
 
 #include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/space/SpaceContext.hpp>
+#include <sirikata/core/util/FreeList.hpp>
 
 namespace Sirikata {
 
@@ -49,31 +50,37 @@ void Message::fillMessage(ServerID src, uint16 src_port, ServerID dest, ServerID
 }
 
 Message::Message()
- : mCachedSize(0)
+ : mCachedSize(0),
+   mHasDestObject(false)
 {
 }
 
 Message::Message(const ServerID& src)
- : mCachedSize(0)
+ : mCachedSize(0),
+   mHasDestObject(false)
 {
     set_source_server(src);
 }
 
 Message::Message(ServerID src, uint16 src_port, ServerID dest, ServerID dest_port)
- : mCachedSize(0)
+ : mCachedSize(0),
+   mHasDestObject(false)
 {
     fillMessage(src, src_port, dest, dest_port);
 }
 
 
 Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const std::string& pl)
- : mCachedSize(0)
+ : mCachedSize(0),
+   mHasDestObject(false)
 {
     fillMessage(src, src_port, dest, dest_port, pl);
 }
 
 Message::Message(ServerID src, uint16 src_port, ServerID dest, uint16 dest_port, const Sirikata::Protocol::Object::ObjectMessage* pl)
- : mCachedSize(0)
+ : mCachedSize(0),
+   mHasDestObject(true),
+   mDestObject(pl->dest_object())
 {
     fillMessage(src, src_port, dest, dest_port, serializePBJMessage(*pl));
     set_payload_id(pl->unique());
@@ -93,6 +100,97 @@ bool Message::serialize(Network::Chunk* output) const {
     memcpy(&((*output)[0]), &(result[0]), sizeof(uint8)*result.size());
     return true;
 }
+
+// Binary framing header. A ServerMessage protobuf always starts with the tag
+// for source_server, 0x08, so the marker distinguishes the two framings.
+// Multi-byte values are big endian, and the payload runs to the end of the
+// chunk since the network layer already frames chunks.
+//   uint8  marker
+//   uint8  flags
+//   uint32 source_server
+//   uint16 source_port
+//   uint32 dest_server
+//   uint16 dest_port
+//   uint64 id
+//   uint64 payload_id
+//   [16 bytes dest_object, if BINARY_FLAG_DEST_OBJECT]
+//   payload
+#define BINARY_FRAMING_MARKER 0xB1
+#define BINARY_FLAG_DEST_OBJECT 0x01
+#define BINARY_HEADER_SIZE (1 + 1 + 4 + 2 + 4 + 2 + 8 + 8)
+
+namespace {
+uint8* writeBigEndian(uint8* out, uint64 val, uint32 nbytes) {
+    for(uint32 i = 0; i < nbytes; i++)
+        out[i] = (uint8)(val >> (8 * (nbytes - 1 - i)));
+    return out + nbytes;
+}
+
+const uint8* readBigEndian(const uint8* in, uint32 nbytes, uint64* val_out) {
+    uint64 val = 0;
+    for(uint32 i = 0; i < nbytes; i++)
+        val = (val << 8) | in[i];
+    *val_out = val;
+    return in + nbytes;
+}
+}
+
+bool Message::serialize(Network::Chunk* output, Framing framing) const {
+    if (framing == BinaryFraming)
+        return serializeBinary(output);
+    return serialize(output);
+}
+
+bool Message::serializeBinary(Network::Chunk* output) const {
+    const std::string& pl = mImpl.payload();
+    uint32 header_size = BINARY_HEADER_SIZE + (mHasDestObject ? UUID::static_size : 0);
+    output->resize(header_size + pl.size());
+
+    uint8* out = &((*output)[0]);
+    *out++ = BINARY_FRAMING_MARKER;
+    *out++ = (mHasDestObject ? BINARY_FLAG_DEST_OBJECT : 0);
+    out = writeBigEndian(out, source_server(), 4);
+    out = writeBigEndian(out, source_port(), 2);
+    out = writeBigEndian(out, dest_server(), 4);
+    out = writeBigEndian(out, dest_port(), 2);
+    out = writeBigEndian(out, id(), 8);
+    out = writeBigEndian(out, payload_id(), 8);
+    if (mHasDestObject) {
+        memcpy(out, mDestObject.getArray().data(), UUID::static_size);
+        out += UUID::static_size;
+    }
+    if (!pl.empty())
+        memcpy(out, pl.data(), pl.size());
+    return true;
+}
+
+bool Message::deserializeBinary(const Network::Chunk& wire) {
+    if (wire.size() < BINARY_HEADER_SIZE) return false;
+
+    const uint8* in = &(wire[0]);
+    const uint8* end = in + wire.size();
+    if (*in++ != BINARY_FRAMING_MARKER) return false;
+    uint8 flags = *in++;
+
+    uint64 val;
+    in = readBigEndian(in, 4, &val); mImpl.set_source_server(val);
+    in = readBigEndian(in, 2, &val); mImpl.set_source_port(val);
+    in = readBigEndian(in, 4, &val); mImpl.set_dest_server(val);
+    in = readBigEndian(in, 2, &val); mImpl.set_dest_port(val);
+    in = readBigEndian(in, 8, &val); mImpl.set_id(val);
+    in = readBigEndian(in, 8, &val); mImpl.set_payload_id(val);
+
+    if (flags & BINARY_FLAG_DEST_OBJECT) {
+        if (end - in < UUID::static_size) return false;
+        mDestObject = UUID(in, UUID::static_size);
+        mHasDestObject = true;
+        in += UUID::static_size;
+    }
+
+    mImpl.set_payload(std::string((const char*)in, end - in));
+    return true;
+}
+
 static char toHex(unsigned char u) {
     if (u<=9) return '0'+u;
     return 'A'+(u-10);
@@ -108,8 +206,12 @@ static void hexPrint(const char *name, const Network::Chunk&data) {
 }
 
 Message* Message::deserialize(const Network::Chunk& wire) {
+    if (wire.empty()) return NULL;
+
     Message* result = new Message();
-    bool parsed = result->ParseFromArray( &(wire[0]), wire.size() );
+    bool parsed = (wire[0] == BINARY_FRAMING_MARKER) ?
+        result->deserializeBinary(wire) :
+        result->ParseFromArray( &(wire[0]), wire.size() );
     if (!parsed) {
         hexPrint("Fail",wire);
         SILOG(msg,warning,"Couldn't parse message.");
@@ -120,6 +222,36 @@ Message* Message::deserialize(const Network::Chunk& wire) {
     return result;
 }
 
+namespace {
+#define MESSAGE_CACHE_PER_THREAD 1024
+
+void destroyMessageStorage(void* ptr) {
+    ::operator delete(ptr);
+}
+
+// Never freed, since Messages may be deleted during static destruction
+FreeList* sMessagePool = new FreeList(MESSAGE_CACHE_PER_THREAD, destroyMessageStorage);
+}
+
+void* Message::operator new(std::size_t size) {
+    // Only exact Messages are recycled, anything else gets fresh storage
+    if (size == sizeof(Message)) {
+        void* cached = sMessagePool->pop();
+        if (cached != NULL) return cached;
+    }
+    return ::operator new(size);
+}
+
+void Message::operator delete(void* ptr, std::size_t size) {
+    if (ptr == NULL) return;
+    if (size != sizeof(Message) || !sMessagePool->push(ptr))
+        ::operator delete(ptr);
+}
+
+uint64 Message::allocations() {
+    return sMessagePool->allocations();
+}
+
 uint32 Message::serializedSize() const {
     if (mCachedSize != 0)
         return mCachedSize;
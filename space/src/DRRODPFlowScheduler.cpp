@@ -0,0 +1,250 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "DRRODPFlowScheduler.hpp"
+#include "Options.hpp"
+#include <sirikata/space/LocationService.hpp>
+#include <sirikata/space/CoordinateSegmentation.hpp>
+
+// Bytes a flow with the smallest weight may send per round. ODP messages are
+// usually smaller, so most visits to a flow send at least one message.
+#define DRR_QUANTUM 1024
+
+#define DRRLOG(level, msg) SILOG(drrodp,level, mContext->id() << "->" << mDestServer << ": " << msg)
+
+namespace Sirikata {
+
+DRRODPFlowScheduler::DRRODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQueue* parent, ServerID sid, uint32 serv_id, uint32 max_size, LocationService* loc)
+ : ODPFlowScheduler(ctx, parent, sid, serv_id),
+   mQueue(max_size, DRR_QUANTUM),
+   mQueueBuffer(NULL),
+   mNeedsNotification(true),
+   mRefreshPending(false),
+   mTotalActiveWeight(0),
+   mTotalUsedWeight(0),
+   mLoc(loc),
+   mRefreshStrand(ctx->ioService->createStrand("DRRODPFlowScheduler Refresh")),
+   mRefreshGuard(new RefreshGuard()),
+   mRefreshPoller(NULL)
+{
+    mRefreshPoller = new Poller(
+        ctx->mainStrand,
+        std::tr1::bind(&DRRODPFlowScheduler::snapshotFlows, this),
+        "DRRODPFlowScheduler::snapshotFlows",
+        GetOptionValue<Duration>(SERVER_ODP_DRR_REFRESH_INTERVAL)
+    );
+    mRefreshPoller->start();
+}
+
+DRRODPFlowScheduler::~DRRODPFlowScheduler() {
+    mRefreshPoller->stop();
+    delete mRefreshPoller;
+
+    // Waits for a running weight pass. Queued ones will find the guard dead.
+    {
+        boost::lock_guard<boost::mutex> lck(mRefreshGuard->mutex);
+        mRefreshGuard->alive = false;
+    }
+    delete mRefreshStrand;
+
+    delete mQueueBuffer;
+    Message* msg = NULL;
+    while(mQueue.pop(&msg))
+        delete msg;
+}
+
+// ODP push interface
+bool DRRODPFlowScheduler::push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry& source_entry, const OSegEntry& dest_entry) {
+    ObjectPair op(msg->source_object(), msg->dest_object());
+    int32 packet_size = msg->ByteSize();
+    Message* serv_msg = createMessageFromODP(msg, mDestServer);
+
+    bool notify = false;
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        if (!mQueue.push(op, serv_msg, packet_size)) {
+            delete serv_msg;
+            return false;
+        }
+        mFlowEndpoints[op] = FlowEndpoints(source_entry, dest_entry);
+
+        if (mNeedsNotification) {
+            mNeedsNotification = false;
+            notify = true;
+        }
+    }
+
+    // Notifying may call back into front(), so it can't be done while
+    // holding the lock
+    if (notify)
+        notifyPushFront();
+    return true;
+}
+
+void DRRODPFlowScheduler::primeFront() const {
+    if (mQueueBuffer != NULL)
+        return;
+    if (!mQueue.pop(&mQueueBuffer)) {
+        mQueueBuffer = NULL;
+        mNeedsNotification = true;
+    }
+}
+
+const DRRODPFlowScheduler::Type& DRRODPFlowScheduler::front() const {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    primeFront();
+    return mQueueBuffer;
+}
+
+DRRODPFlowScheduler::Type& DRRODPFlowScheduler::front() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    primeFront();
+    return mQueueBuffer;
+}
+
+bool DRRODPFlowScheduler::empty() const {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    primeFront();
+    return (mQueueBuffer == NULL);
+}
+
+uint32 DRRODPFlowScheduler::size() const {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return mQueue.size();
+}
+
+DRRODPFlowScheduler::Type DRRODPFlowScheduler::pop() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    primeFront();
+    Message* result = mQueueBuffer;
+    mQueueBuffer = NULL;
+    if (result == NULL)
+        return NULL;
+
+    // Reprime so that, if the queue is now empty, we're marked as needing
+    // notification of the next push
+    primeFront();
+    return result;
+}
+
+
+float DRRODPFlowScheduler::totalActiveWeight() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return mTotalActiveWeight;
+}
+
+float DRRODPFlowScheduler::totalSenderUsedWeight() {
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return mTotalUsedWeight;
+}
+
+float DRRODPFlowScheduler::totalReceiverUsedWeight() {
+    // Without separate feedback from the receiver, used weight is measured
+    // the same way for both
+    boost::lock_guard<boost::mutex> lck(mMutex);
+    return mTotalUsedWeight;
+}
+
+void DRRODPFlowScheduler::snapshotFlows() {
+    FlowSnapshotPtr snapshot(new FlowSnapshot());
+    FlowQueue::FlowStatsList& flows = snapshot->flows;
+    std::vector<FlowEndpoints> endpoints;
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        // Don't pile up passes if they're slower than the refresh interval
+        if (mRefreshPending)
+            return;
+        mRefreshPending = true;
+
+        FlowQueue::KeyList removed;
+        mQueue.collectStats(&flows, &removed);
+        for(FlowQueue::KeyList::iterator it = removed.begin(); it != removed.end(); it++)
+            mFlowEndpoints.erase(*it);
+        endpoints.reserve(flows.size());
+        for(FlowQueue::FlowStatsList::iterator it = flows.begin(); it != flows.end(); it++)
+            endpoints.push_back(mFlowEndpoints[it->key]);
+    }
+
+    for(uint32 i = 0; i < flows.size(); i++) {
+        snapshot->regions.add(
+            getObjectWeightRegion(flows[i].key.source, endpoints[i].source),
+            getObjectWeightRegion(flows[i].key.dest, endpoints[i].dest)
+        );
+    }
+
+    mRefreshStrand->post(
+        std::tr1::bind(&DRRODPFlowScheduler::computeWeightsIfAlive, this, mRefreshGuard, snapshot),
+        "DRRODPFlowScheduler::computeWeights"
+    );
+}
+
+void DRRODPFlowScheduler::computeWeightsIfAlive(DRRODPFlowScheduler* sched, RefreshGuardPtr guard, FlowSnapshotPtr snapshot) {
+    boost::lock_guard<boost::mutex> lck(guard->mutex);
+    if (!guard->alive)
+        return;
+    sched->computeWeights(*snapshot);
+}
+
+void DRRODPFlowScheduler::computeWeights(const FlowSnapshot& snapshot) {
+    const FlowQueue::FlowStatsList& flows = snapshot.flows;
+    std::vector<double> weights;
+    mWeightCalculator->weights(snapshot.regions, &weights);
+
+    double total_weight = 0.0, min_weight = 0.0;
+    uint64 total_sent = 0;
+    for(uint32 i = 0; i < flows.size(); i++) {
+        total_weight += weights[i];
+        if (weights[i] > 0 && (min_weight == 0 || weights[i] < min_weight))
+            min_weight = weights[i];
+        total_sent += flows[i].sent;
+    }
+
+    // A flow which sent less than its fair share of what was sent over the
+    // last period only used part of its weight
+    double used_weight = 0.0;
+    for(uint32 i = 0; i < flows.size(); i++) {
+        if (total_sent == 0 || total_weight == 0) {
+            used_weight += weights[i];
+            continue;
+        }
+        double fair_share = total_sent * (weights[i] / total_weight);
+        used_weight += (fair_share > 0 ? weights[i] * std::min(1.0, flows[i].sent / fair_share) : 0.0);
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lck(mMutex);
+        // Weights are normalized to the smallest so that every flow sends at
+        // least a quantum per round
+        for(uint32 i = 0; i < flows.size(); i++) {
+            float32 normalized = (min_weight > 0 ? weights[i] / min_weight : 1.0);
+            mQueue.setWeight(flows[i].key, std::max(normalized, 1.f));
+        }
+        if (!flows.empty() && min_weight > 0)
+            mQueue.setDefaultWeight( std::max((float32)(total_weight / flows.size() / min_weight), 1.f) );
+        mTotalActiveWeight = total_weight;
+        mTotalUsedWeight = used_weight;
+        mRefreshPending = false;
+    }
+}
+
+BoundingBox3f DRRODPFlowScheduler::getObjectWeightRegion(const UUID& objid, const OSegEntry& info) const {
+    // We might have exact info
+    if (mLoc->contains(objid)) {
+        Vector3f pos = mLoc->currentPosition(objid);
+        BoundingSphere3f bounds = mLoc->bounds(objid).fullBounds();
+        BoundingBox3f bb(pos + bounds.center(), bounds.radius());
+        return bb;
+    }
+
+    if (info.server() == mContext->id())
+        DRRLOG(detailed,"Using approximation for local object");
+    // Otherwise, we need to use server info
+    BoundingBoxList server_bbox_list = mContext->cseg()->serverRegion(info.server());
+    BoundingBox3f server_bbox = BoundingBox3f::null();
+    for(uint32 i = 0; i < server_bbox_list.size(); i++)
+        server_bbox.mergeIn(server_bbox_list[i]);
+    return BoundingBox3f(server_bbox.center(), info.radius());
+}
+
+} // namespace Sirikata
@@ -0,0 +1,142 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _DRR_ODP_FLOW_SCHEDULER_HPP_
+#define _DRR_ODP_FLOW_SCHEDULER_HPP_
+
+#include "ODPFlowScheduler.hpp"
+#include <sirikata/core/queue/DRRQueue.hpp>
+#include <sirikata/core/service/Poller.hpp>
+
+namespace Sirikata {
+
+class LocationService;
+
+/** DRRODPFlowScheduler tracks flows between pairs of objects and shares
+ *  bandwidth between them with deficit round robin, so queueing and
+ *  dequeueing a message take constant time no matter how many flows are
+ *  active. Flow weights aren't computed as messages arrive. Instead, the
+ *  active flows and their regions are periodically snapshotted on the main
+ *  strand and a batch pass on its own strand recomputes the weights of all
+ *  flows and the weight totals reported to the Forwarder, and forgets flows
+ *  which have gone idle. New flows get the average weight until the next
+ *  pass.
+ */
+class DRRODPFlowScheduler : public ODPFlowScheduler {
+public:
+    DRRODPFlowScheduler(SpaceContext* ctx, ForwarderServiceQueue* parent, ServerID sid, uint32 serv_id, uint32 max_size, LocationService* loc);
+    virtual ~DRRODPFlowScheduler();
+
+    // Interface: AbstractQueue<Message*>
+    virtual const Type& front() const;
+    virtual Type& front();
+    virtual Type pop();
+    virtual bool empty() const;
+    virtual uint32 size() const;
+
+    // ODP push interface
+    virtual bool push(Sirikata::Protocol::Object::ObjectMessage* msg, const OSegEntry&, const OSegEntry&);
+    // Get the sum of the weights of active queues.
+    virtual float totalActiveWeight();
+    // Get the total used weight of active queues.  If all flows are saturating,
+    // this should equal totalActiveWeights, otherwise it will be smaller.
+    virtual float totalSenderUsedWeight();
+    // Get the total used weight of active queues.  If all flows are saturating,
+    // this should equal totalActiveWeights, otherwise it will be smaller.
+    virtual float totalReceiverUsedWeight();
+private:
+    struct ObjectPair {
+        ObjectPair()
+        {}
+
+        ObjectPair(const UUID& s, const UUID& d)
+         : source(s), dest(d)
+        {}
+
+        bool operator==(const ObjectPair& rhs) const {
+            return (source == rhs.source && dest == rhs.dest);
+        }
+
+        class Hasher {
+        public:
+            size_t operator() (const ObjectPair& op) const {
+                return *(uint32*)op.source.getArray().data() ^ *(uint32*)op.dest.getArray().data();
+            }
+        };
+
+        UUID source;
+        UUID dest;
+    };
+
+    // Where each end of a flow was last known to be, for computing weights
+    struct FlowEndpoints {
+        FlowEndpoints()
+        {}
+
+        FlowEndpoints(const OSegEntry& s, const OSegEntry& d)
+         : source(s), dest(d)
+        {}
+
+        OSegEntry source;
+        OSegEntry dest;
+    };
+
+    typedef DRRQueue<Message*, ObjectPair, ObjectPair::Hasher> FlowQueue;
+    typedef std::tr1::unordered_map<ObjectPair, FlowEndpoints, ObjectPair::Hasher> FlowEndpointMap;
+
+    // The active flows and their regions, as of the last snapshot
+    struct FlowSnapshot {
+        FlowQueue::FlowStatsList flows;
+        RegionPairs regions;
+    };
+    typedef std::tr1::shared_ptr<FlowSnapshot> FlowSnapshotPtr;
+
+    // Shared with queued weight passes, which may outlive the scheduler. A
+    // pass holds the mutex while it runs and does nothing once alive is
+    // cleared, so the destructor waits for a running pass by clearing it.
+    struct RefreshGuard {
+        RefreshGuard()
+         : alive(true)
+        {}
+
+        boost::mutex mutex;
+        bool alive;
+    };
+    typedef std::tr1::shared_ptr<RefreshGuard> RefreshGuardPtr;
+
+    // Moves the next message into mQueueBuffer if it's empty. Requires mMutex.
+    void primeFront() const;
+
+    // Collects flow stats and regions, runs on the main strand since it uses
+    // the location service and cseg
+    void snapshotFlows();
+    // Batch weight computation, runs on mRefreshStrand
+    static void computeWeightsIfAlive(DRRODPFlowScheduler* sched, RefreshGuardPtr guard, FlowSnapshotPtr snapshot);
+    void computeWeights(const FlowSnapshot& snapshot);
+    // Helper to get the region we compute weight over
+    BoundingBox3f getObjectWeightRegion(const UUID& objid, const OSegEntry& info) const;
+
+    // Protects everything below except the location service and refresh
+    // poller. Weights are computed without it so pushes aren't held up.
+    mutable boost::mutex mMutex;
+    mutable FlowQueue mQueue;
+    mutable Message* mQueueBuffer;
+    mutable bool mNeedsNotification;
+    FlowEndpointMap mFlowEndpoints;
+    // A weight pass has been queued and hasn't finished yet
+    bool mRefreshPending;
+
+    // Totals from the last refresh
+    float mTotalActiveWeight;
+    float mTotalUsedWeight;
+
+    LocationService* mLoc;
+    Network::IOStrand* mRefreshStrand;
+    RefreshGuardPtr mRefreshGuard;
+    Poller* mRefreshPoller;
+}; // class DRRODPFlowScheduler
+
+} // namespace Sirikata
+
+#endif //_DRR_ODP_FLOW_SCHEDULER_HPP_
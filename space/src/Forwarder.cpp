@@ -55,6 +55,7 @@
 #include "ODPFlowScheduler.hpp"
 #include "RegionODPFlowScheduler.hpp"
 #include "CSFQODPFlowScheduler.hpp"
+#include "DRRODPFlowScheduler.hpp"
 
 #include <sirikata/core/odp/DelegateService.hpp>
 
@@ -118,11 +119,14 @@ Forwarder::Forwarder(SpaceContext* ctx)
                  std::tr1::bind(&Forwarder::reportStats, this),
                  "Forwarder::reportStats",
                  Duration::seconds((int64)1)),
-             mLastStatsTime(ctx->simTime()),
-             mTimeSeriesForwardedPerSecondName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".forwarded.remote"),
-             mForwardedPerSecond(0),
-             mTimeSeriesDroppedPerSecondName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".dropped.forwarder"),
-             mDroppedPerSecond(0)
+             mForwarded(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".forwarded.remote")),
+             mDropped(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".dropped.forwarder")),
+             mObjectMessageAllocations(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".allocations.object_message")),
+             mLastObjectMessageAllocations(objectMessageAllocations()),
+             mServerMessageAllocations(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".allocations.server_message")),
+             mLastServerMessageAllocations(Message::allocations()),
+             mAllocationsPerMessage(ctx->metrics->gauge(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".allocations.per_forwarded")),
+             mLastForwarded(0)
 {
     mNullServerIDOSegCallback=std::tr1::bind(&Forwarder::routeObjectMessageToServerNoReturn, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2,std::tr1::placeholders:: _3, NullServerID);
     mOutgoingMessages = new ForwarderServiceQueue(mContext->id(), GetOptionValue<uint32>(FORWARDER_SEND_QUEUE_SIZE), (ForwarderServiceQueue::Listener*)this);
@@ -182,7 +186,7 @@ void Forwarder::dispatchMessage(Sirikata::Protocol::Object::ObjectMessage* obj_m
         ODP::Endpoint(SpaceID::null(), ObjectReference(obj_msg->dest_object()), obj_msg->dest_port()),
         MemoryReference(obj_msg->payload())
     );
-    delete obj_msg;
+    releaseObjectMessage(obj_msg);
 }
 
 void Forwarder::handleObjectMessageLoop(Sirikata::Protocol::Object::ObjectMessage* obj_msg) const {
@@ -201,20 +205,22 @@ void Forwarder::stop() {
 }
 
 void Forwarder::reportStats() {
-    Time tnow = mContext->recentSimTime();
-    float32 since_last_seconds = (tnow - mLastStatsTime).seconds();
-    mLastStatsTime = tnow;
+    uint64 obj_msg_allocs = objectMessageAllocations();
+    uint64 new_obj_msg_allocs = obj_msg_allocs - mLastObjectMessageAllocations;
+    mLastObjectMessageAllocations = obj_msg_allocs;
+    (*mObjectMessageAllocations) += new_obj_msg_allocs;
 
-    mContext->timeSeries->report(
-        mTimeSeriesForwardedPerSecondName,
-        mForwardedPerSecond.read() / since_last_seconds
-    );
-    mForwardedPerSecond = 0;
-    mContext->timeSeries->report(
-        mTimeSeriesDroppedPerSecondName,
-        mDroppedPerSecond.read() / since_last_seconds
-    );
-    mDroppedPerSecond = 0;
+    uint64 server_msg_allocs = Message::allocations();
+    uint64 new_server_msg_allocs = server_msg_allocs - mLastServerMessageAllocations;
+    mLastServerMessageAllocations = server_msg_allocs;
+    (*mServerMessageAllocations) += new_server_msg_allocs;
+
+    uint64 forwarded_total = mForwarded->total();
+    uint64 forwarded = forwarded_total - mLastForwarded;
+    mLastForwarded = forwarded_total;
+    // In steady state this should be close to 0
+    if (forwarded > 0)
+        mAllocationsPerMessage->set((new_obj_msg_allocs + new_server_msg_allocs) / (float64)forwarded);
 }
 
 // -- Object Connection Management - Object connections are available locally,
@@ -296,6 +302,10 @@ ODPFlowScheduler* Forwarder::createODPFlowScheduler(LocationService* loc, Server
         new_flow_scheduler =
             new CSFQODPFlowScheduler(mContext, mOutgoingMessages, remote_server, mServiceIDMap[ODP_SERVER_MESSAGE_SERVICE], max_size, loc);
     }
+    else if (flow_sched_type == "drr") {
+        new_flow_scheduler =
+            new DRRODPFlowScheduler(mContext, mOutgoingMessages, remote_server, mServiceIDMap[ODP_SERVER_MESSAGE_SERVICE], max_size, loc);
+    }
 
     assert(new_flow_scheduler != NULL);
 
@@ -391,10 +401,10 @@ void Forwarder::routeObjectHostMessage(Sirikata::Protocol::Object::ObjectMessage
 
     bool forwarded = forward(obj_msg);
     if (!forwarded) {
-        mDroppedPerSecond++;
+        (*mDropped)++;
         TIMESTAMP(obj_msg, Trace::DROPPED_DURING_FORWARDING);
         TRACE_DROP(DROPPED_DURING_FORWARDING);
-        delete obj_msg;
+        releaseObjectMessage(obj_msg);
     }
 }
 
@@ -413,11 +423,11 @@ void Forwarder::receiveMessage(Message* msg) {
 }
 
 void Forwarder::receiveObjectRoutingMessage(Message* msg) {
-    Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
+    Sirikata::Protocol::Object::ObjectMessage* obj_msg = acquireObjectMessage();
     bool parsed = parsePBJMessage(obj_msg, msg->payload());
     if (!parsed) {
         LOG_INVALID_MESSAGE(forwarder, error, msg->payload());
-        delete obj_msg;
+        releaseObjectMessage(obj_msg);
         delete msg;
         return;
     }
@@ -437,10 +447,10 @@ void Forwarder::receiveObjectRoutingMessage(Message* msg) {
     bool forward_success = forward(obj_msg, msg->source_server());
 
     if (!forward_success) {
-        mDroppedPerSecond++;
+        (*mDropped)++;
         TIMESTAMP(obj_msg, Trace::DROPPED_DURING_FORWARDING);
         TRACE_DROP(DROPPED_DURING_FORWARDING_ROUTING);
-        delete obj_msg;
+        releaseObjectMessage(obj_msg);
     }
 
     delete msg;
@@ -594,12 +604,12 @@ bool Forwarder::routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMes
   }
   bool send_success = flow_sched->push(obj_msg,source_object_data,dest_serv);
   if (!send_success) {
-      mDroppedPerSecond++;
+      (*mDropped)++;
       TIMESTAMP(obj_msg, Trace::DROPPED_AT_SPACE_ENQUEUED);
       TRACE_DROP(DROPPED_AT_SPACE_ENQUEUED);
   }
   else {
-      mForwardedPerSecond++;
+      (*mForwarded)++;
   }
 
   // Note that this is done *after* the real message is sent since it is an optimization and
@@ -628,7 +638,7 @@ bool Forwarder::routeObjectMessageToServer(Sirikata::Protocol::Object::ObjectMes
       // Ignore the success of this send.  If it failed the remote ends cache
       // will just continue to be incorrect, but forwarding will cover the error
   }
-  delete obj_msg;
+  releaseObjectMessage(obj_msg);
   return send_success;
 }
 
@@ -661,12 +671,32 @@ void Forwarder::serverMessageReceived(Message* msg) {
     TIMESTAMP_PAYLOAD(msg, Trace::SPACE_TO_SPACE_SMR_DEQUEUED);
 
     // Routing, check if we can route immediately.
+    if (msg->dest_port() == SERVER_PORT_OBJECT_MESSAGE_ROUTING &&
+        msg->has_dest_object())
+    {
+        // With binary framing the destination is in the header, so we can
+        // pass the serialized message straight to a local object and only
+        // parse it if it needs to be forwarded again.
+        if (mLocalForwarder->tryForward(msg->dest_object(), msg->payload(), msg->payload_id())) {
+            delete msg;
+            return;
+        }
+
+        OSegEntry cached_dest = mOSegLookups->cacheLookup(msg->dest_object());
+        if (cached_dest.isNull() || cached_dest.server() == mContext->id()) {
+            // Nothing more to do here, the main strand will handle it
+            // normally
+            enqueueReceivedServerMessage(msg);
+            return;
+        }
+    }
+
     if (msg->dest_port() == SERVER_PORT_OBJECT_MESSAGE_ROUTING) {
-        Sirikata::Protocol::Object::ObjectMessage* obj_msg = new Sirikata::Protocol::Object::ObjectMessage();
+        Sirikata::Protocol::Object::ObjectMessage* obj_msg = acquireObjectMessage();
         bool parsed = parsePBJMessage(obj_msg, msg->payload());
         if (!parsed) {
             LOG_INVALID_MESSAGE(forwarder, error, msg->payload());
-            delete obj_msg;
+            releaseObjectMessage(obj_msg);
             delete msg;
             return;
         }
@@ -690,9 +720,13 @@ void Forwarder::serverMessageReceived(Message* msg) {
         }
 
         // Couldn't get rid of it, forward normally.
-        delete obj_msg;
+        releaseObjectMessage(obj_msg);
     }
 
+    enqueueReceivedServerMessage(msg);
+}
+
+void Forwarder::enqueueReceivedServerMessage(Message* msg) {
     bool got_empty;
     bool push_success;
     {
@@ -134,11 +134,17 @@ private:
     Sirikata::SizedThreadSafeQueue<Message*> mReceivedMessages;
 
     Poller mTimeSeriesPoller;
-    Time mLastStatsTime;
-    const String mTimeSeriesForwardedPerSecondName;
-    AtomicValue<uint32> mForwardedPerSecond;
-    const String mTimeSeriesDroppedPerSecondName;
-    AtomicValue<uint32> mDroppedPerSecond;
+    Trace::MetricCounter* mForwarded;
+    Trace::MetricCounter* mDropped;
+    // Heap allocations of ObjectMessages and Messages, i.e. those which
+    // couldn't reuse recycled ones. These are process wide counts, so they're
+    // sampled periodically rather than counted directly.
+    Trace::MetricCounter* mObjectMessageAllocations;
+    uint64 mLastObjectMessageAllocations;
+    Trace::MetricCounter* mServerMessageAllocations;
+    uint64 mLastServerMessageAllocations;
+    Trace::MetricGauge* mAllocationsPerMessage;
+    uint64 mLastForwarded;
 
     // -- Boiler plate stuff - initialization, destruction, methods to satisfy interfaces
   public:
@@ -224,6 +230,8 @@ private:
     virtual void serverConnectionReceived(ServerID sid);
     virtual void serverMessageReceived(Message* msg);
 
+    // Queue a message from another server for handling on the main strand
+    void enqueueReceivedServerMessage(Message* msg);
     void scheduleProcessReceivedServerMessages();
     void processReceivedServerMessages();
 
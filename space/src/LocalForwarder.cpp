@@ -37,15 +37,10 @@ namespace Sirikata {
 
 
 LocalForwarder::LocalForwarder(SpaceContext* ctx)
- : PollingService(ctx->mainStrand, "LocalForwarder Poll", Duration::seconds((int64)1), ctx, "Local Forwarder"),
-   mContext(ctx),
-   mLastStatsTime(ctx->simTime()),
-   mTimeSeriesForwardedName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".forwarded.locally"),
-   mNumForwarded(0),
-   mTimeSeriesDroppedName(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".dropped.local_forwarder"),
-   mNumDropped(0)
+ : mContext(ctx),
+   mNumForwarded(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".forwarded.locally")),
+   mNumDropped(ctx->metrics->counter(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".dropped.local_forwarder"))
 {
-    mContext->add(this);
 }
 
 void LocalForwarder::addActiveConnection(ObjectConnection* conn) {
@@ -66,29 +61,30 @@ void LocalForwarder::removeActiveConnection(const UUID& objid) {
     mActiveConnections.erase(it);
 }
 
-bool LocalForwarder::tryForward(Sirikata::Protocol::Object::ObjectMessage* msg) {
-    ObjectConnection* conn = NULL;
-    {
-        boost::lock_guard<boost::mutex> lock(mMutex);
-
-        // Destination connection must exist and be enabled
-        ObjectConnectionMap::iterator it = mActiveConnections.find(msg->dest_object());
-        if (it == mActiveConnections.end())
-            return false;
-
-        conn = it->second;
-
-        // FIXME we can't sanity check here because we use this after
-        // receiving from another space server (in which case we won't
-        // have the source object...).
-        // We only sanity check the source object when we're sure we're going to be able to
-        // ship it.
-        //ObjectConnectionMap::iterator src_it = mActiveConnections.find(msg->source_object());
-        //if (src_it == mActiveConnections.end())
-        //    return false;
-    }
+ObjectConnection* LocalForwarder::getActiveConnection(const UUID& dest) {
+    boost::lock_guard<boost::mutex> lock(mMutex);
 
-    assert(conn != NULL);
+    // Destination connection must exist and be enabled
+    ObjectConnectionMap::iterator it = mActiveConnections.find(dest);
+    if (it == mActiveConnections.end())
+        return NULL;
+
+    // FIXME we can't sanity check here because we use this after
+    // receiving from another space server (in which case we won't
+    // have the source object...).
+    // We only sanity check the source object when we're sure we're going to be able to
+    // ship it.
+    //ObjectConnectionMap::iterator src_it = mActiveConnections.find(msg->source_object());
+    //if (src_it == mActiveConnections.end())
+    //    return false;
+
+    return it->second;
+}
+
+bool LocalForwarder::tryForward(Sirikata::Protocol::Object::ObjectMessage* msg) {
+    ObjectConnection* conn = getActiveConnection(msg->dest_object());
+    if (conn == NULL)
+        return false;
 
     // Finally, with all checks done, we can commit to doing local routing
     TIMESTAMP_START(tstamp, msg);
@@ -99,36 +95,41 @@ bool LocalForwarder::tryForward(Sirikata::Protocol::Object::ObjectMessage* msg)
 
     bool send_success = conn->send(msg);
     if (!send_success) {
-        mNumDropped++;
+        (*mNumDropped)++;
         TIMESTAMP_END(tstamp, Trace::DROPPED_AT_FORWARDED_LOCALLY);
         TRACE_DROP(DROPPED_AT_FORWARDED_LOCALLY);
         // FIXME do anything on failure?
-        delete msg;
+        releaseObjectMessage(msg);
     }
     else {
-        mNumForwarded++;
+        (*mNumForwarded)++;
     }
 
     // At this point we've handled it, regardless of send's success
     return true;
 }
 
-void LocalForwarder::poll() {
-    Time tnow = mContext->recentSimTime();
-    float32 since_last_seconds = (tnow - mLastStatsTime).seconds();
-    mLastStatsTime = tnow;
-
-    mContext->timeSeries->report(
-        mTimeSeriesForwardedName,
-        mNumForwarded.read() / since_last_seconds
-    );
-    mNumForwarded = 0;
-
-    mContext->timeSeries->report(
-        mTimeSeriesDroppedName,
-        mNumDropped.read() / since_last_seconds
-    );
-    mNumDropped = 0;
+bool LocalForwarder::tryForward(const UUID& dest, const std::string& serialized_msg, uint64 unique) {
+    ObjectConnection* conn = getActiveConnection(dest);
+    if (conn == NULL)
+        return false;
+
+    TIMESTAMP_SIMPLE(unique, Trace::FORWARDED_LOCALLY);
+
+    if (mContext->stopped()) return false;
+
+    bool send_success = conn->send(serialized_msg);
+    if (!send_success) {
+        (*mNumDropped)++;
+        TIMESTAMP_SIMPLE(unique, Trace::DROPPED_AT_FORWARDED_LOCALLY);
+        TRACE_DROP(DROPPED_AT_FORWARDED_LOCALLY);
+    }
+    else {
+        (*mNumForwarded)++;
+        TIMESTAMP_SIMPLE(unique, Trace::SPACE_TO_OH_ENQUEUED);
+    }
+
+    return true;
 }
 
 } // namespace Sirikata
@@ -34,8 +34,7 @@
 #define _SIRIKATA_LOCAL_FORWARDER_HPP_
 
 #include <sirikata/core/util/Platform.hpp>
-#include <sirikata/core/service/PollingService.hpp>
-#include <sirikata/core/util/AtomicTypes.hpp>
+#include <sirikata/core/trace/Metrics.hpp>
 #include "ObjectConnection.hpp"
 
 namespace Sirikata {
@@ -45,7 +44,7 @@ namespace Sirikata {
  *  allow very fast forwarding of messages between objects connected to the same
  *  space server.
  */
-class LocalForwarder : public PollingService {
+class LocalForwarder {
   public:
     /** Create a LocalForwarder.
      *  \param ctx SpaceContext for this LocalForwarder to operate in
@@ -71,9 +70,18 @@ class LocalForwarder : public PollingService {
      *  \returns true if the message was forwarded, false otherwise
      */
     bool tryForward(Sirikata::Protocol::Object::ObjectMessage* msg);
-  private:
 
-    virtual void poll();
+    /** Try to forward an already serialized message directly, e.g. one
+     *  received from another space server, without parsing it.
+     *  \param dest the destination object of the message
+     *  \param serialized_msg the serialized ObjectMessage
+     *  \param unique the message's unique ID, for tracing
+     *  \returns true if the message was handled, false otherwise
+     */
+    bool tryForward(const UUID& dest, const std::string& serialized_msg, uint64 unique);
+  private:
+    // Get the enabled connection for an object, or NULL if there isn't one
+    ObjectConnection* getActiveConnection(const UUID& dest);
 
     typedef std::tr1::unordered_map<UUID, ObjectConnection*, UUID::Hasher> ObjectConnectionMap;
 
@@ -81,11 +89,8 @@ class LocalForwarder : public PollingService {
     ObjectConnectionMap mActiveConnections;
     boost::mutex mMutex;
     // Stats, reported as x per second
-    Time mLastStatsTime;
-    const String mTimeSeriesForwardedName;
-    AtomicValue<uint32> mNumForwarded;
-    const String mTimeSeriesDroppedName;
-    AtomicValue<uint32> mNumDropped;
+    Trace::MetricCounter* mNumForwarded;
+    Trace::MetricCounter* mNumDropped;
 };
 
 } // namespace Sirikata
@@ -58,6 +58,13 @@ bool ObjectConnection::send(Sirikata::Protocol::Object::ObjectMessage* msg) {
     return mConnectionManager->send(mOHConnection, msg);
 }
 
+bool ObjectConnection::send(const std::string& serialized_msg) {
+    if (!mEnabled)
+        return false;
+
+    return mConnectionManager->send(mOHConnection, serialized_msg);
+}
+
 void ObjectConnection::enable() {
     mEnabled = true;
 }
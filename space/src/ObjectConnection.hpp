@@ -58,6 +58,9 @@ public:
 
     WARN_UNUSED
     bool send(Sirikata::Protocol::Object::ObjectMessage* msg);
+    /// Send an ObjectMessage which is already serialized
+    WARN_UNUSED
+    bool send(const std::string& serialized_msg);
 
     void enable();
 
@@ -60,7 +60,9 @@ void InitSpaceOptions() {
         .addOption(new OptionValue(SERVER_QUEUE, "fair", Sirikata::OptionValueType<String>(), "The type of ServerMessageQueue to use for routing."))
         .addOption(new OptionValue(SERVER_QUEUE_LENGTH, "8192", Sirikata::OptionValueType<uint32>(), "Length of queue for each server."))
         .addOption(new OptionValue(SERVER_RECEIVER, "fair", Sirikata::OptionValueType<String>(), "The type of ServerMessageReceiver to use for routing."))
-        .addOption(new OptionValue(SERVER_ODP_FLOW_SCHEDULER, "region", Sirikata::OptionValueType<String>(), "The type of ODPFlowScheduler to use for routing."))
+        .addOption(new OptionValue(SERVER_ODP_FLOW_SCHEDULER, "region", Sirikata::OptionValueType<String>(), "The type of ODPFlowScheduler to use for routing: region, csfq or drr."))
+        .addOption(new OptionValue(SERVER_ODP_DRR_REFRESH_INTERVAL, "1s", Sirikata::OptionValueType<Duration>(), "How often the drr ODPFlowScheduler recomputes flow weights."))
+        .addOption(new OptionValue(SERVER_MESSAGE_FRAMING, "protobuf", Sirikata::OptionValueType<String>(), "How messages are framed when sent to other space servers: protobuf (understood by every server) or binary (fixed header, payload passed through, only understood by servers which accept it). Either is accepted when receiving."))
         .addOption(new OptionValue(FORWARDER_RECEIVE_QUEUE_SIZE, "16384", Sirikata::OptionValueType<uint32>(), "The type of ODPFlowScheduler to use for routing."))
         .addOption(new OptionValue(FORWARDER_SEND_QUEUE_SIZE, "65536", Sirikata::OptionValueType<uint32>(), "The type of ODPFlowScheduler to use for routing."))
 
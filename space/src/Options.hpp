@@ -42,6 +42,8 @@
 #define SERVER_QUEUE_LENGTH  "server.queue.length"
 #define SERVER_RECEIVER      "server.receiver"
 #define SERVER_ODP_FLOW_SCHEDULER   "server.odp.flowsched"
+#define SERVER_ODP_DRR_REFRESH_INTERVAL "server.odp.drr.refresh-interval"
+#define SERVER_MESSAGE_FRAMING      "server.message-framing"
 
 #define NETWORK_TYPE         "net"
 
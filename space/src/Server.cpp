@@ -94,7 +94,7 @@ Server::Server(SpaceContext* ctx, Authenticator* auth, Forwarder* forwarder, Loc
    mShutdownRequested(false),
    mObjectHostConnectionManager(NULL),
    mRouteObjectMessage(Sirikata::SizedResourceMonitor(GetOptionValue<size_t>("route-object-message-buffer"))),
-   mTimeSeriesObjects(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".objects")
+   mObjectCount(ctx->metrics->gauge(String("space.server") + boost::lexical_cast<String>(ctx->id()) + ".objects"))
 {
     using std::tr1::placeholders::_1;
     using std::tr1::placeholders::_2;
@@ -238,7 +238,7 @@ bool Server::delegateODPPortSend(const ODP::Endpoint& source_ep, const ODP::Endp
 
     // If the send failed, we need to destroy the message.
     if (!send_success)
-        delete msg;
+        releaseObjectMessage(msg);
 
     return send_success;
 }
@@ -278,7 +278,7 @@ bool Server::delegateOHDPPortSend(const OHDP::Endpoint& source_ep, const OHDP::E
 
     // If the send failed, we need to destroy the message.
     if (!send_success)
-        delete msg;
+        releaseObjectMessage(msg);
 
     return send_success;
 }
@@ -318,7 +318,7 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
     // Note that we need to check this before the connected sanity check since obviously the object won't
     // be connected yet.  We dispatch directly from here since this needs information about the object host
     // connection to be passed along as well.
-    bool session_msg = (obj_msg->dest_port() == OBJECT_PORT_SESSION);
+    bool session_msg = (obj_msg->dest_port() == OBJECT_PORT_SESSION || obj_msg->dest_port() == OBJECT_PORT_SESSION_BATCH);
     if (session_msg)
     {
         bool space_dest = (obj_msg->dest_object() == spaceID);
@@ -365,7 +365,7 @@ bool Server::onObjectHostMessageReceived(const ObjectHostConnectionID& conn_id,
     if (!push_for_processing_success) {
         TIMESTAMP(obj_msg, Trace::SPACE_DROPPED_AT_MAIN_STRAND_CROSSING);
         TRACE_DROP(SPACE_DROPPED_AT_MAIN_STRAND_CROSSING);
-        delete obj_msg;
+        releaseObjectMessage(obj_msg);
     } else {
         if (hit_empty)
             scheduleObjectHostMessageRouting();
@@ -432,7 +432,7 @@ bool Server::handleSingleObjectHostMessageRouting() {
         // non-sensical and we can just discard
         UUID dest_object = front.obj_msg->dest_object();
         if (dest_object != ohdp_ID) {
-            delete front.obj_msg;
+            releaseObjectMessage(front.obj_msg);
             return true;
         }
 
@@ -448,7 +448,7 @@ bool Server::handleSingleObjectHostMessageRouting() {
             OHDP::Endpoint(SpaceID::null(), OHDP::NodeID::null(), front.obj_msg->dest_port()),
             MemoryReference(front.obj_msg->payload())
         );
-        delete front.obj_msg;
+        releaseObjectMessage(front.obj_msg);
 
         return true;
     }
@@ -475,7 +475,7 @@ bool Server::handleSingleObjectHostMessageRouting() {
             SPACE_LOG(warn,"Server got message from object after migration started: " << source_object.toString());
         }
 
-        delete front.obj_msg;
+        releaseObjectMessage(front.obj_msg);
 
         return true;
     }
@@ -488,6 +488,12 @@ bool Server::handleSingleObjectHostMessageRouting() {
 
 // Handle Session messages from an object
 void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg) {
+    if (msg->dest_port() == OBJECT_PORT_SESSION_BATCH) {
+        handleSessionBatch(oh_conn_id, *msg);
+        delete msg;
+        return;
+    }
+
     Sirikata::Protocol::Session::Container session_msg;
     bool parse_success = session_msg.ParseFromString(msg->payload());
     if (!parse_success) {
@@ -496,6 +502,46 @@ void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Siri
         return;
     }
 
+    handleSessionContainer(oh_conn_id, msg->source_object(), session_msg, ConnectRequestListPtr());
+
+    delete msg;
+}
+
+void Server::handleSessionBatch(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& msg) {
+    SessionBatchEntryList entries;
+    bool parse_success = parseSessionBatch(msg.payload(), &entries);
+    if (!parse_success) {
+        LOG_INVALID_MESSAGE(space, error, msg.payload());
+        return;
+    }
+
+    ConnectRequestListPtr connects(new ConnectRequestList());
+    for(SessionBatchEntryList::iterator it = entries.begin(); it != entries.end(); it++) {
+        Sirikata::Protocol::Session::Container session_msg;
+        if (!session_msg.ParseFromString(it->second)) {
+            LOG_INVALID_MESSAGE(space, error, it->second);
+            continue;
+        }
+        handleSessionContainer(oh_conn_id, it->first, session_msg, connects);
+    }
+
+    if (connects->empty()) return;
+
+    std::vector<UUID> obj_ids;
+    std::vector<String> auths;
+    obj_ids.reserve(connects->size());
+    auths.reserve(connects->size());
+    for(ConnectRequestList::iterator it = connects->begin(); it != connects->end(); it++) {
+        obj_ids.push_back(it->obj_id);
+        auths.push_back(it->connect_msg.has_auth() ? it->connect_msg.auth() : String(""));
+    }
+    mAuthenticator->authenticateBatch(
+        obj_ids, auths,
+        std::tr1::bind(&Server::handleConnectBatchAuthResponse, this, oh_conn_id, connects, std::tr1::placeholders::_1)
+    );
+}
+
+void Server::handleSessionContainer(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Container& session_msg, ConnectRequestListPtr batch) {
     // Backwards compatibility note: by defaulting to 0, all the later
     // checks on sequence numbers will always have them matching,
     // meaning we default to the old behavior where requests could end
@@ -511,31 +557,29 @@ void Server::handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Siri
 
         if (session_msg.connect().type() == Sirikata::Protocol::Session::Connect::Fresh)
         {
-            handleConnect(oh_conn_id, *msg, session_msg.connect(), seqno);
+            handleConnect(oh_conn_id, obj_id, session_msg.connect(), seqno, batch);
         }
         else if (session_msg.connect().type() == Sirikata::Protocol::Session::Connect::Migration)
         {
-            handleMigrate(oh_conn_id, *msg, session_msg.connect(), seqno);
+            handleMigrate(oh_conn_id, obj_id, session_msg.connect(), seqno);
         }
         else
             SPACE_LOG(error,"Unknown connection message type");
     }
     else if (session_msg.has_connect_ack()) {
-        handleConnectAck(oh_conn_id, *msg, seqno);
+        handleConnectAck(oh_conn_id, obj_id, seqno);
     }
     else if (session_msg.has_disconnect()) {
         ObjectConnectionMap::iterator it = mObjects.find(session_msg.disconnect().object());
         if (it != mObjects.end()) {
             handleDisconnect(session_msg.disconnect().object(), it->second, seqno);
-            mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+            mObjectCount->set(mObjects.size());
         }
     }
 
     // InitiateMigration messages
     assert(!session_msg.has_connect_response());
     assert(!session_msg.has_init_migration());
-
-    delete msg;
 }
 
 void Server::handleObjectHostConnectionClosed(const ObjectHostConnectionID& oh_conn_id) {
@@ -552,29 +596,69 @@ void Server::handleObjectHostConnectionClosed(const ObjectHostConnectionID& oh_c
         // this will force disconnection
         handleDisconnect(obj_id, obj_conn, obj_conn->sessionID());
     }
-    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+    mObjectCount->set(mObjects.size());
 }
 
-void Server::sendConnectError(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno) {
+void Server::sendConnectError(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno, bool batched) {
     Sirikata::Protocol::Session::Container response_container;
     if (session_request_seqno != 0) response_container.set_seqno(session_request_seqno);
     Sirikata::Protocol::Session::IConnectResponse response = response_container.mutable_connect_response();
     fillVersionInfo(response.mutable_version(), mContext);
     response.set_response( Sirikata::Protocol::Session::ConnectResponse::Error );
 
+    sendSessionResponse(oh_conn_id, obj_id, response_container, batched);
+}
+
+void Server::sendSessionResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Container& response, bool batched) {
+    if (!batched) {
+        Sirikata::Protocol::Object::ObjectMessage* obj_response = createObjectMessage(
+            mContext->id(),
+            UUID::null(), OBJECT_PORT_SESSION,
+            obj_id, OBJECT_PORT_SESSION,
+            serializePBJMessage(response)
+        );
+        sendSessionMessageWithRetry(oh_conn_id, obj_response, Duration::seconds(0.05));
+        return;
+    }
+
+    // Responses generated while handling a batch, or by OSeg registrations
+    // completing together, are collected and sent once the current event
+    // finishes.
+    ShortObjectHostConnectionID short_conn_id = oh_conn_id.shortID();
+    PendingSessionResponsesMap::iterator it = mPendingSessionResponses.find(short_conn_id);
+    if (it == mPendingSessionResponses.end()) {
+        it = mPendingSessionResponses.insert(PendingSessionResponsesMap::value_type(short_conn_id, PendingSessionResponses())).first;
+        it->second.conn_id = oh_conn_id;
+        mContext->mainStrand->post(
+            std::tr1::bind(&Server::flushSessionResponses, this, short_conn_id),
+            "Server::flushSessionResponses"
+        );
+    }
+    it->second.entries.push_back(SessionBatchEntry(obj_id, serializePBJMessage(response)));
+
+    if (it->second.entries.size() >= MAX_SESSION_BATCH_ENTRIES)
+        flushSessionResponses(short_conn_id);
+}
+
+void Server::flushSessionResponses(ShortObjectHostConnectionID short_conn_id) {
+    PendingSessionResponsesMap::iterator it = mPendingSessionResponses.find(short_conn_id);
+    if (it == mPendingSessionResponses.end()) return;
+
     Sirikata::Protocol::Object::ObjectMessage* obj_response = createObjectMessage(
         mContext->id(),
-        UUID::null(), OBJECT_PORT_SESSION,
-        obj_id, OBJECT_PORT_SESSION,
-        serializePBJMessage(response_container)
+        UUID::null(), OBJECT_PORT_SESSION_BATCH,
+        UUID::null(), OBJECT_PORT_SESSION_BATCH,
+        serializeSessionBatch(it->second.entries)
     );
+    ObjectHostConnectionID conn_id = it->second.conn_id;
+    mPendingSessionResponses.erase(it);
 
-    sendSessionMessageWithRetry(oh_conn_id, obj_response, Duration::seconds(0.05));
+    sendSessionMessageWithRetry(conn_id, obj_response, Duration::seconds(0.05));
 }
 
 // Handle Connect message from object
-void Server::handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno) {
-    UUID obj_id = container.source_object();
+void Server::handleConnect(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, ConnectRequestListPtr batch) {
+    bool batched = (batch.get() != NULL);
 
     // If the requested location isn't on this server, redirect
     // Note: on connections, we always ignore the specified time and just use
@@ -595,7 +679,7 @@ void Server::handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirik
             SPACE_LOG(warn,"Connecting object was incorrectly determined to be in our region.");
 
         // Create and send error reply
-        sendConnectError(oh_conn_id, obj_id, seqno);
+        sendConnectError(oh_conn_id, obj_id, seqno, batched);
         return;
     }
 
@@ -611,20 +695,20 @@ void Server::handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirik
         response.set_response( Sirikata::Protocol::Session::ConnectResponse::Redirect );
         response.set_redirect(loc_server);
 
-        Sirikata::Protocol::Object::ObjectMessage* obj_response = createObjectMessage(
-            mContext->id(),
-            UUID::null(), OBJECT_PORT_SESSION,
-            obj_id, OBJECT_PORT_SESSION,
-            serializePBJMessage(response_container)
-        );
-
-        sendSessionMessageWithRetry(oh_conn_id, obj_response, Duration::seconds(0.05));
+        sendSessionResponse(oh_conn_id, obj_id, response_container, batched);
         return;
     }
 
     // FIXME sanity check the new connection
     // -- verify object may connect, i.e. not already in system (e.g. check oseg)
 
+    // Batched requests are authenticated together once the whole batch has
+    // been processed
+    if (batched) {
+        batch->push_back(ConnectRequest(obj_id, connect_msg, seqno));
+        return;
+    }
+
     String auth_data = "";
     if (connect_msg.has_auth())
         auth_data = connect_msg.auth();
@@ -636,10 +720,33 @@ void Server::handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirik
 
 void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, bool authenticated) {
     if (!authenticated) {
-        sendConnectError(oh_conn_id, obj_id, seqno);
+        sendConnectError(oh_conn_id, obj_id, seqno, false);
         return;
     }
 
+    if (admitConnection(oh_conn_id, obj_id, connect_msg, seqno, false))
+        mOSeg->addNewObject(obj_id,connect_msg.bounds().radius());
+}
+
+void Server::handleConnectBatchAuthResponse(const ObjectHostConnectionID& oh_conn_id, ConnectRequestListPtr batch, const std::vector<bool>& authenticated) {
+    assert(authenticated.size() == batch->size());
+
+    ObjectSegmentation::NewObjectList new_objects;
+    for(uint32 i = 0; i < batch->size(); i++) {
+        const ConnectRequest& req = (*batch)[i];
+        if (!authenticated[i]) {
+            sendConnectError(oh_conn_id, req.obj_id, req.seqno, true);
+            continue;
+        }
+        if (admitConnection(oh_conn_id, req.obj_id, req.connect_msg, req.seqno, true))
+            new_objects.push_back(std::make_pair(req.obj_id, (float)req.connect_msg.bounds().radius()));
+    }
+
+    if (!new_objects.empty())
+        mOSeg->addNewObjects(new_objects);
+}
+
+bool Server::admitConnection(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, bool batched) {
     // Because of unreliable messaging, we might get a double connect request
     // (if we got the initial request but the response was dropped). In that
     // case, just send them another one and ignore this
@@ -654,7 +761,7 @@ void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id,
                 (mObjects[obj_id]->sessionID() == seqno))
         {
             // retry, tell them they're fine.
-            sendConnectSuccess(oh_conn_id, obj_id, seqno);
+            sendConnectSuccess(oh_conn_id, obj_id, seqno, batched);
         }
         else if
             // or was connecting, the same oh sending msg, and the same request id
@@ -672,10 +779,10 @@ void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id,
             // be another OH requesting a conflicting connection, could be
             // retries w/ new sequence numbers from the same one, but at this
             // point we can't do anything about it
-            sendConnectError(oh_conn_id, obj_id, seqno);
+            sendConnectError(oh_conn_id, obj_id, seqno, batched);
         }
 
-        return;
+        return false;
     }
 
     // Update our oseg to show that we know that we have this object now. Also
@@ -685,9 +792,10 @@ void Server::handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id,
     sc.conn_id = oh_conn_id;
     sc.conn_msg = connect_msg;
     sc.session_seqno = seqno;
+    sc.batched = batched;
     mStoredConnectionData[obj_id] = sc;
 
-    mOSeg->addNewObject(obj_id,connect_msg.bounds().radius());
+    return true;
 }
 
 void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
@@ -714,7 +822,7 @@ void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
           // Create and store the connection
           ObjectConnection* conn = new ObjectConnection(obj_id, mObjectHostConnectionManager, sc.conn_id, sc.session_seqno);
           mObjects[obj_id] = conn;
-          mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+          mObjectCount->set(mObjects.size());
 
           //TODO: assumes each server process is assigned only one region... perhaps we should enforce this constraint
           //for cleaner semantics?
@@ -750,11 +858,11 @@ void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
           // Stage the connection with the forwarder, but don't enable it until an ack is received
           mForwarder->addObjectConnection(obj_id, conn);
 
-          sendConnectSuccess(conn->connID(), obj_id, sc.session_seqno);
+          sendConnectSuccess(conn->connID(), obj_id, sc.session_seqno, sc.batched);
       }
       else
       {
-          sendConnectError(sc.conn_id , obj_id, sc.session_seqno);
+          sendConnectError(sc.conn_id , obj_id, sc.session_seqno, sc.batched);
       }
       mStoredConnectionData.erase(storedConIter);
   }
@@ -764,7 +872,7 @@ void Server::finishAddObject(const UUID& obj_id, OSegAddNewStatus status)
   }
 }
 
-void Server::sendConnectSuccess(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno) {
+void Server::sendConnectSuccess(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno, bool batched) {
     TimedMotionVector3f loc = mLocationService->location(obj_id);
     TimedMotionQuaternion orient = mLocationService->orientation(obj_id);
     AggregateBoundingInfo bnds = mLocationService->bounds(obj_id);
@@ -788,22 +896,14 @@ void Server::sendConnectSuccess(const ObjectHostConnectionID& oh_conn_id, const
     response.set_bounds(bnds.fullBounds());
     response.set_mesh(obj_mesh);
 
-    Sirikata::Protocol::Object::ObjectMessage* obj_response = createObjectMessage(
-        mContext->id(),
-        UUID::null(), OBJECT_PORT_SESSION,
-        obj_id, OBJECT_PORT_SESSION,
-        serializePBJMessage(response_container)
-    );
     // Sent directly via object host connection manager because ObjectConnection isn't enabled yet
-    sendSessionMessageWithRetry(oh_conn_id, obj_response, Duration::seconds(0.05));
+    sendSessionResponse(oh_conn_id, obj_id, response_container, batched);
 }
 
 // Handle Migrate message from object
 //this is called by the receiving server.
-void Server::handleMigrate(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, const Sirikata::Protocol::Session::Connect& migrate_msg, uint64 seqno)
+void Server::handleMigrate(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& migrate_msg, uint64 seqno)
 {
-    UUID obj_id = container.source_object();
-
     assert( !isObjectConnected(obj_id) );
 
     // FIXME sanity check the new connection
@@ -822,9 +922,7 @@ void Server::handleMigrate(const ObjectHostConnectionID& oh_conn_id, const Sirik
     handleMigration(obj_id);
 }
 
-void Server::handleConnectAck(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, uint64 session_request_seqno) {
-    UUID obj_id = container.source_object();
-
+void Server::handleConnectAck(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno) {
     // Ack must fully match the connection we have
     ObjectConnectionMap::iterator it = mObjects.find(obj_id);
     if (it == mObjects.end()) {
@@ -959,7 +1057,7 @@ void Server::handleMigration(const UUID& obj_id)
 
     // Move from list waiting for migration message to active objects
     mObjects[obj_id] = obj_conn;
-    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+    mObjectCount->set(mObjects.size());
     mLocalForwarder->addActiveConnection(obj_conn);
 
 
@@ -1125,7 +1223,7 @@ void Server::handleMigrationEvent(const UUID& obj_id) {
 
             mLocalForwarder->removeActiveConnection(obj_id);
             mObjects.erase(obj_id);
-            mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+            mObjectCount->set(mObjects.size());
             ObjectReference obj(obj_id);
 
             mObjectSessionManager->removeSession(obj);
@@ -1214,7 +1312,7 @@ void Server::processAlreadyMigrating(const UUID& obj_id)
     mLocalForwarder->removeActiveConnection( obj_id );
     // Move from list waiting for migration message to active objects
     mObjects[obj_id] = obj_conn;
-    mContext->timeSeries->report(mTimeSeriesObjects, mObjects.size());
+    mObjectCount->set(mObjects.size());
     mLocalForwarder->addActiveConnection(obj_conn);
 
 
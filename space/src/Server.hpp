@@ -155,20 +155,49 @@ private:
     // (i.e. needs routing to another node)
     bool handleSingleObjectHostMessageRouting();
 
-    // Handle Session messages from an object
+    // Fresh connection requests from a batch of session messages, which are
+    // authenticated and registered with OSeg together
+    struct ConnectRequest {
+        ConnectRequest(const UUID& _obj_id, const Sirikata::Protocol::Session::Connect& _connect_msg, uint64 _seqno)
+         : obj_id(_obj_id), connect_msg(_connect_msg), seqno(_seqno)
+        {}
+
+        UUID obj_id;
+        Sirikata::Protocol::Session::Connect connect_msg;
+        uint64 seqno;
+    };
+    typedef std::vector<ConnectRequest> ConnectRequestList;
+    typedef std::tr1::shared_ptr<ConnectRequestList> ConnectRequestListPtr;
+
+    // Handle Session messages from an object, or a batch of them from an
+    // object host
     void handleSessionMessage(const ObjectHostConnectionID& oh_conn_id, Sirikata::Protocol::Object::ObjectMessage* msg);
+    void handleSessionBatch(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& msg);
+    // Handle a single session message. If batch is non-NULL, the message came
+    // in a batch: fresh connections are added to batch instead of being
+    // authenticated immediately and responses are batched as well.
+    void handleSessionContainer(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Container& session_msg, ConnectRequestListPtr batch);
     // Handle Connect message from object
-    void handleConnect(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno);
+    void handleConnect(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, ConnectRequestListPtr batch);
     void handleConnectAuthResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, bool authenticated);
-
-    void sendConnectSuccess(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno);
-    void sendConnectError(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno);
+    void handleConnectBatchAuthResponse(const ObjectHostConnectionID& oh_conn_id, ConnectRequestListPtr batch, const std::vector<bool>& authenticated);
+    // Checks an authenticated connection request for conflicts and, if it
+    // can proceed, stores it until OSeg registration completes. Returns true
+    // if the object still needs to be added to OSeg.
+    bool admitConnection(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& connect_msg, uint64 seqno, bool batched);
+
+    void sendConnectSuccess(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno, bool batched);
+    void sendConnectError(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno, bool batched);
+    // Send a session response to an object, either on its own or as part of
+    // the next batch of responses to its object host
+    void sendSessionResponse(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Container& response, bool batched);
+    void flushSessionResponses(ShortObjectHostConnectionID short_conn_id);
 
     // Handle connection ack message from object
-    void handleConnectAck(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, uint64 session_request_seqno);
+    void handleConnectAck(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, uint64 session_request_seqno);
 
     // Handle Migrate message from object
-    void handleMigrate(const ObjectHostConnectionID& oh_conn_id, const Sirikata::Protocol::Object::ObjectMessage& container, const Sirikata::Protocol::Session::Connect& migrate_msg, uint64 seqno);
+    void handleMigrate(const ObjectHostConnectionID& oh_conn_id, const UUID& obj_id, const Sirikata::Protocol::Session::Connect& migrate_msg, uint64 seqno);
 
     // Performs actual migration after all the necessary information is available.
     void handleMigration(const UUID& obj_id);
@@ -260,6 +289,8 @@ private:
         // Sequence number from session request so we can uniquely
         // identify the request
         uint64 session_seqno;
+        // Whether the request arrived in a batch, so the response should too
+        bool batched;
     };
 
     typedef std::map<UUID, StoredConnection> StoredConnectionMap;
@@ -281,9 +312,16 @@ private:
     boost::mutex mRouteObjectMessageMutex;
     Sirikata::SizedThreadSafeQueue<ConnectionIDObjectMessagePair>mRouteObjectMessage;
 
-    // TimeSeries identifiers. Must include the ServerID for uniqueness, so we
-    // cache them so TimeSeries reports are fast
-    String mTimeSeriesObjects;
+    // Session responses waiting to be sent to each object host as a batch
+    struct PendingSessionResponses {
+        ObjectHostConnectionID conn_id;
+        SessionBatchEntryList entries;
+    };
+    typedef std::tr1::unordered_map<ShortObjectHostConnectionID, PendingSessionResponses> PendingSessionResponsesMap;
+    PendingSessionResponsesMap mPendingSessionResponses;
+
+    // Number of connected objects, reported with other metrics
+    Trace::MetricGauge* mObjectCount;
 
 }; // class Server
 
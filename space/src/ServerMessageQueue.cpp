@@ -33,6 +33,7 @@
 #include "ServerMessageQueue.hpp"
 #include <sirikata/core/trace/Trace.hpp>
 #include <sirikata/core/options/CommonOptions.hpp>
+#include "Options.hpp"
 
 namespace Sirikata {
 
@@ -41,6 +42,7 @@ ServerMessageQueue::ServerMessageQueue(SpaceContext* ctx, SpaceNetwork* net, Sen
           mSenderStrand(ctx->ioService->createStrand("ServerMessageQueue SenderStrand")),
           mNetwork(net),
           mSender(sender),
+          mFraming(GetOptionValue<String>(SERVER_MESSAGE_FRAMING) == "protobuf" ? Message::ProtobufFraming : Message::BinaryFraming),
           mUsedWeightSum(0.0),
           mCapacityEstimator(Duration::milliseconds((int64)200).toSeconds()),
           mBlocked(false)
@@ -81,7 +83,7 @@ uint32 ServerMessageQueue::trySend(const ServerID& dest, const Message* msg) {
         return 0;
     }
     Network::Chunk serialized;
-    msg->serialize(&serialized);
+    msg->serialize(&serialized, mFraming);
     uint32 packet_size = serialized.size();
     bool sent_success = strm_out->send(serialized);
 
@@ -36,6 +36,7 @@
 #include <sirikata/core/util/Platform.hpp>
 #include <sirikata/space/SpaceContext.hpp>
 #include <sirikata/space/SpaceNetwork.hpp>
+#include <sirikata/space/ServerMessage.hpp>
 #include <sirikata/space/CoordinateSegmentation.hpp>
 #include "RateEstimator.hpp"
 
@@ -104,6 +105,7 @@ public:
     Sender* mSender;
     typedef std::tr1::unordered_map<ServerID, SpaceNetwork::SendStream*> SendStreamMap;
     SendStreamMap mSendStreams;
+    Message::Framing mFraming;
 
     // Total weights are handled by the main strand since that's the only place
     // they are needed. Handling of used weights is implementation dependent and
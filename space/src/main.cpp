@@ -166,6 +166,7 @@ int main(int argc, char** argv) {
     OHDPSST::ConnectionManager* ohSstConnMgr = new OHDPSST::ConnectionManager();
 
     SpaceContext* space_context = new SpaceContext("space", server_id, sstConnMgr, ohSstConnMgr, ios, mainStrand, start_time, gTrace, duration);
+    space_context->metrics->setFlushInterval(GetOptionValue<Duration>(OPT_TRACE_METRICS_INTERVAL));
 
     String servermap_type = GetOptionValue<String>("servermap");
     String servermap_options = GetOptionValue<String>("servermap-options");
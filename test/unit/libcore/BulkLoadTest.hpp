@@ -0,0 +1,102 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/prox/BulkLoad.hpp>
+
+using namespace Sirikata;
+
+class BulkLoadTest : public CxxTest::TestSuite
+{
+    typedef BulkLoadEntry<uint32> Entry;
+    typedef std::vector<Entry> EntryList;
+
+    // Grid of n^3 points, numbered in x-major order
+    EntryList grid(uint32 n) {
+        EntryList entries;
+        for(uint32 x = 0; x < n; x++)
+            for(uint32 y = 0; y < n; y++)
+                for(uint32 z = 0; z < n; z++)
+                    entries.push_back(Entry(entries.size(), Vector3f(x, y, z)));
+        return entries;
+    }
+
+    void checkPermutation(const EntryList& entries, uint32 count) {
+        TS_ASSERT_EQUALS(entries.size(), count);
+        std::vector<bool> seen(count, false);
+        for(uint32 i = 0; i < entries.size(); i++) {
+            TS_ASSERT(entries[i].id < count);
+            TS_ASSERT(!seen[entries[i].id]);
+            seen[entries[i].id] = true;
+        }
+    }
+
+public:
+    void testParseOrder() {
+        BulkLoadOrder order;
+        TS_ASSERT(BulkLoadOrderFromString("hilbert", &order));
+        TS_ASSERT_EQUALS(order, BULK_LOAD_HILBERT);
+        TS_ASSERT(BulkLoadOrderFromString("str", &order));
+        TS_ASSERT_EQUALS(order, BULK_LOAD_STR);
+        TS_ASSERT(BulkLoadOrderFromString("none", &order));
+        TS_ASSERT_EQUALS(order, BULK_LOAD_NONE);
+        TS_ASSERT(!BulkLoadOrderFromString("zorder", &order));
+    }
+
+    void testHilbertCurve() {
+        // Every cell gets a unique index and consecutive indices are
+        // neighbouring cells.
+        const uint32 bits = 3, n = 1 << bits;
+        std::vector<int32> cells(n*n*n, -1);
+        for(uint32 x = 0; x < n; x++) {
+            for(uint32 y = 0; y < n; y++) {
+                for(uint32 z = 0; z < n; z++) {
+                    uint64 idx = BulkLoad::HilbertIndex(x, y, z, bits);
+                    TS_ASSERT(idx < cells.size());
+                    TS_ASSERT_EQUALS(cells[idx], -1);
+                    cells[idx] = (x * n + y) * n + z;
+                }
+            }
+        }
+
+        for(uint32 i = 1; i < cells.size(); i++) {
+            int32 a = cells[i-1], b = cells[i];
+            int32 dist =
+                abs(a / (n*n) - b / (n*n)) +
+                abs((a / n) % n - (b / n) % n) +
+                abs(a % n - b % n);
+            TS_ASSERT_EQUALS(dist, 1);
+        }
+    }
+
+    void testHilbertSort() {
+        EntryList entries = grid(8);
+        BulkLoadSort(entries, BULK_LOAD_HILBERT, 10);
+        checkPermutation(entries, 512);
+        for(uint32 i = 1; i < entries.size(); i++)
+            TS_ASSERT_EQUALS((entries[i].pos - entries[i-1].pos).lengthSquared(), 1.f);
+    }
+
+    void testSTRSort() {
+        // An 8x8x8 grid with leaves of 8 should be packed into 2x2x2 cubes
+        EntryList entries = grid(8);
+        BulkLoadSort(entries, BULK_LOAD_STR, 8);
+        checkPermutation(entries, 512);
+        for(uint32 leaf = 0; leaf < 64; leaf++) {
+            Vector3f lo = entries[leaf*8].pos, hi = entries[leaf*8].pos;
+            for(uint32 i = 1; i < 8; i++) {
+                lo = lo.min(entries[leaf*8+i].pos);
+                hi = hi.max(entries[leaf*8+i].pos);
+            }
+            TS_ASSERT_EQUALS(hi - lo, Vector3f(1, 1, 1));
+        }
+    }
+
+    void testNoSort() {
+        EntryList entries = grid(3);
+        BulkLoadSort(entries, BULK_LOAD_NONE, 4);
+        for(uint32 i = 0; i < entries.size(); i++)
+            TS_ASSERT_EQUALS(entries[i].id, i);
+    }
+};
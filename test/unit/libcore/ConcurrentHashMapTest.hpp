@@ -0,0 +1,64 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/util/ConcurrentHashMap.hpp>
+#include <boost/thread/thread.hpp>
+
+class ConcurrentHashMapTest : public CxxTest::TestSuite
+{
+    typedef Sirikata::ConcurrentHashMap<int, int> IntMap;
+
+    static void insertRange(IntMap* map, int start, int count) {
+        for(int i = start; i < start + count; i++) {
+            map->insert(i, i*2);
+            if (i % 3 == 0)
+                map->erase(i);
+        }
+    }
+
+public:
+    void testBasicOperations() {
+        IntMap map;
+        int value = 0;
+
+        TS_ASSERT(map.empty());
+        TS_ASSERT(map.insert(1, 10));
+        TS_ASSERT(!map.insert(1, 20));
+        TS_ASSERT(map.get(1, &value));
+        TS_ASSERT_EQUALS(value, 10);
+
+        map.set(1, 30);
+        map.set(2, 40);
+        TS_ASSERT(map.get(1, &value));
+        TS_ASSERT_EQUALS(value, 30);
+        TS_ASSERT_EQUALS(map.size(), (std::size_t)2);
+
+        TS_ASSERT(map.erase(1, &value));
+        TS_ASSERT_EQUALS(value, 30);
+        TS_ASSERT(!map.erase(1));
+        TS_ASSERT(!map.contains(1));
+
+        IntMap::EntryList entries;
+        map.clear(&entries);
+        TS_ASSERT_EQUALS(entries.size(), (std::size_t)1);
+        TS_ASSERT_EQUALS(entries[0].first, 2);
+        TS_ASSERT(map.empty());
+    }
+
+    void testConcurrentInsert() {
+        IntMap map;
+        const int per_thread = 3000;
+        boost::thread_group threads;
+        for(int t = 0; t < 4; t++)
+            threads.create_thread(std::tr1::bind(&insertRange, &map, t*per_thread, per_thread));
+        threads.join_all();
+
+        TS_ASSERT_EQUALS(map.size(), (std::size_t)(4*per_thread - 4*per_thread/3));
+        int value = 0;
+        TS_ASSERT(map.get(1, &value));
+        TS_ASSERT_EQUALS(value, 2);
+        TS_ASSERT(!map.contains(3));
+    }
+};
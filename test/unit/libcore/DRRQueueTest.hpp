@@ -0,0 +1,117 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/queue/DRRQueue.hpp>
+
+using namespace Sirikata;
+
+class DRRQueueTest : public CxxTest::TestSuite
+{
+public:
+    typedef DRRQueue<uint32, uint32> TestQueue;
+
+#define ASSERT_DRR_QUEUE_POP(queue, expected_key, expected_val)        \
+        {                                                               \
+            uint32 result_key = 0, result = 0;                          \
+            TS_ASSERT(queue.pop(&result, &result_key));                 \
+            TS_ASSERT_EQUALS(result_key, (uint32)expected_key);         \
+            TS_ASSERT_EQUALS(result, (uint32)expected_val);             \
+        }
+
+    // Equal weights alternate between flows
+    void testEqualWeights(void) {
+        TestQueue test_queue(1 << 20, 10);
+
+        test_queue.push(0, 1, 10);
+        test_queue.push(0, 2, 10);
+        test_queue.push(1, 3, 10);
+        test_queue.push(1, 4, 10);
+
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 1);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 3);
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 2);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 4);
+        TS_ASSERT(test_queue.empty());
+        TS_ASSERT_EQUALS(test_queue.size(), (uint32)0);
+    }
+
+    // A flow with twice the weight sends twice as many bytes per round
+    void testDifferentWeights(void) {
+        TestQueue test_queue(1 << 20, 10);
+
+        for(uint32 i = 0; i < 4; i++) {
+            test_queue.push(0, i, 10);
+            test_queue.push(1, 10+i, 10);
+        }
+        test_queue.setWeight(1, 2.f);
+
+        // Flow 0 was created first, so goes first in the first round, but
+        // flow 1 only got the quantum for its old weight in that round
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 0);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 10);
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 1);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 11);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 12);
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 2);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 13);
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 3);
+        TS_ASSERT(test_queue.empty());
+    }
+
+    // Messages larger than a quantum wait until the flow saves up enough
+    void testLargeMessages(void) {
+        TestQueue test_queue(1 << 20, 10);
+
+        test_queue.push(0, 1, 25);
+        test_queue.push(1, 2, 10);
+        test_queue.push(1, 3, 10);
+        test_queue.push(1, 4, 10);
+
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 2);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 3);
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 1);
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 4);
+    }
+
+    void testMaxSize(void) {
+        TestQueue test_queue(25, 10);
+
+        TS_ASSERT(test_queue.push(0, 1, 10));
+        TS_ASSERT(test_queue.push(1, 2, 10));
+        TS_ASSERT(!test_queue.push(2, 3, 10));
+        TS_ASSERT_EQUALS(test_queue.size(), (uint32)20);
+    }
+
+    // Idle flows are removed only after a full period without traffic
+    void testCollectStats(void) {
+        TestQueue test_queue(1 << 20, 10);
+
+        test_queue.push(0, 1, 10);
+        test_queue.push(1, 2, 10);
+        ASSERT_DRR_QUEUE_POP(test_queue, 0, 1);
+
+        TestQueue::FlowStatsList stats;
+        TestQueue::KeyList removed;
+        test_queue.collectStats(&stats, &removed);
+        TS_ASSERT_EQUALS(stats.size(), (size_t)2);
+        TS_ASSERT(removed.empty());
+
+        ASSERT_DRR_QUEUE_POP(test_queue, 1, 2);
+        stats.clear();
+        test_queue.collectStats(&stats, &removed);
+        TS_ASSERT_EQUALS(stats.size(), (size_t)1);
+        TS_ASSERT_EQUALS(stats[0].key, (uint32)1);
+        TS_ASSERT_EQUALS(stats[0].sent, (uint64)10);
+        TS_ASSERT_EQUALS(removed.size(), (size_t)1);
+        TS_ASSERT_EQUALS(test_queue.numFlows(), (uint32)1);
+
+        stats.clear();
+        removed.clear();
+        test_queue.collectStats(&stats, &removed);
+        TS_ASSERT(stats.empty());
+        TS_ASSERT_EQUALS(removed.size(), (size_t)1);
+        TS_ASSERT_EQUALS(test_queue.numFlows(), (uint32)0);
+    }
+};
@@ -0,0 +1,162 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_FREE_LIST_TEST_HPP_
+#define _SIRIKATA_FREE_LIST_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/util/FreeList.hpp>
+#include <boost/thread.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+namespace FreeListTestUtil {
+
+typedef std::set<void*> ItemSet;
+
+// Items destroyed by a FreeList, from any thread
+boost::mutex sDestroyedMutex;
+ItemSet sDestroyed;
+
+void destroyItem(void* item) {
+    boost::mutex::scoped_lock lock(sDestroyedMutex);
+    sDestroyed.insert(item);
+    delete (int*)item;
+}
+
+std::vector<void*> makeItems(uint32 n) {
+    std::vector<void*> items;
+    for(uint32 i = 0; i < n; i++)
+        items.push_back(new int(i));
+    return items;
+}
+
+// Pushes all the items from another thread, which then exits
+void pushAll(FreeList* fl, const std::vector<void*>* items, uint32* pushed_out) {
+    for(uint32 i = 0; i < items->size(); i++) {
+        if (fl->push((*items)[i]))
+            (*pushed_out)++;
+    }
+}
+
+} // namespace FreeListTestUtil
+
+class FreeListTest : public CxxTest::TestSuite
+{
+    typedef FreeListTestUtil::ItemSet ItemSet;
+
+    // Must match FreeList::MAX_TRANSFER_BATCHES
+    static const uint32 MAX_TRANSFER_BATCHES = 64;
+
+    ItemSet destroyed() {
+        boost::mutex::scoped_lock lock(FreeListTestUtil::sDestroyedMutex);
+        return FreeListTestUtil::sDestroyed;
+    }
+
+public:
+    void setUp() {
+        boost::mutex::scoped_lock lock(FreeListTestUtil::sDestroyedMutex);
+        FreeListTestUtil::sDestroyed.clear();
+    }
+
+    void testPushPopSameThread() {
+        FreeList fl(8, FreeListTestUtil::destroyItem);
+        std::vector<void*> items = FreeListTestUtil::makeItems(3);
+
+        TS_ASSERT(fl.pop() == NULL);
+        TS_ASSERT_EQUALS(fl.allocations(), (uint64)1);
+
+        for(uint32 i = 0; i < items.size(); i++)
+            TS_ASSERT(fl.push(items[i]));
+        // Most recently released first
+        TS_ASSERT_EQUALS(fl.pop(), items[2]);
+        TS_ASSERT_EQUALS(fl.pop(), items[1]);
+        TS_ASSERT(fl.push(items[2]));
+        TS_ASSERT_EQUALS(fl.pop(), items[2]);
+        TS_ASSERT_EQUALS(fl.pop(), items[0]);
+        // Hits aren't counted
+        TS_ASSERT_EQUALS(fl.allocations(), (uint64)1);
+
+        TS_ASSERT(fl.pop() == NULL);
+        TS_ASSERT_EQUALS(fl.allocations(), (uint64)2);
+        TS_ASSERT(destroyed().empty());
+
+        for(uint32 i = 0; i < items.size(); i++)
+            delete (int*)items[i];
+    }
+
+    void testFullThreadListKeepsAcceptingItems() {
+        // Filling this thread's list hands half of it to the shared list,
+        // and popping gets everything back
+        const uint32 max_per_thread = 8;
+        FreeList fl(max_per_thread, FreeListTestUtil::destroyItem);
+        std::vector<void*> items = FreeListTestUtil::makeItems(max_per_thread * 4);
+        for(uint32 i = 0; i < items.size(); i++)
+            TS_ASSERT(fl.push(items[i]));
+
+        ItemSet popped;
+        void* item;
+        while((item = fl.pop()) != NULL)
+            popped.insert(item);
+        TS_ASSERT_EQUALS(popped, ItemSet(items.begin(), items.end()));
+        TS_ASSERT(destroyed().empty());
+
+        for(uint32 i = 0; i < items.size(); i++)
+            delete (int*)items[i];
+    }
+
+    void testCrossThreadTransfer() {
+        // Items released by one thread are reused by another. Whatever the
+        // releasing thread still holds when it exits is destroyed.
+        const uint32 max_per_thread = 8;
+        FreeList fl(max_per_thread, FreeListTestUtil::destroyItem);
+        std::vector<void*> items = FreeListTestUtil::makeItems(100);
+        uint32 pushed = 0;
+        boost::thread releaser(std::tr1::bind(&FreeListTestUtil::pushAll, &fl, &items, &pushed));
+        releaser.join();
+        TS_ASSERT_EQUALS(pushed, (uint32)items.size());
+
+        ItemSet left_in_thread = destroyed();
+        TS_ASSERT(!left_in_thread.empty());
+        TS_ASSERT(left_in_thread.size() <= max_per_thread);
+
+        ItemSet popped;
+        void* item;
+        while((item = fl.pop()) != NULL) {
+            TS_ASSERT(popped.find(item) == popped.end());
+            TS_ASSERT(left_in_thread.find(item) == left_in_thread.end());
+            popped.insert(item);
+        }
+        TS_ASSERT_EQUALS(popped.size() + left_in_thread.size(), items.size());
+
+        for(ItemSet::iterator it = popped.begin(); it != popped.end(); it++)
+            delete (int*)*it;
+    }
+
+    void testOverCapacity() {
+        // With 2 items per thread, every push past the first two hands a
+        // batch of one to the shared list, until it holds
+        // MAX_TRANSFER_BATCHES and push() fails.
+        FreeList* fl = new FreeList(2, FreeListTestUtil::destroyItem);
+        const uint32 capacity = 2 + MAX_TRANSFER_BATCHES;
+        std::vector<void*> items = FreeListTestUtil::makeItems(capacity + 1);
+        for(uint32 i = 0; i < capacity; i++)
+            TS_ASSERT(fl->push(items[i]));
+
+        // The caller keeps the item and frees it itself
+        void* extra = items[capacity];
+        TS_ASSERT(!fl->push(extra));
+        TS_ASSERT(destroyed().empty());
+        delete (int*)extra;
+
+        // Destroying the list destroys the shared batches and this thread's
+        // items, each exactly once
+        delete fl;
+        ItemSet expected(items.begin(), items.begin() + capacity);
+        TS_ASSERT_EQUALS(destroyed(), expected);
+    }
+};
+
+#endif //_SIRIKATA_FREE_LIST_TEST_HPP_
@@ -0,0 +1,66 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/network/IOProfiler.hpp>
+
+using namespace Sirikata;
+using namespace Sirikata::Network;
+
+namespace {
+void incrementHandler(uint32* count) {
+    (*count)++;
+}
+}
+
+class IOProfilerTest : public CxxTest::TestSuite
+{
+public:
+    void tearDown() {
+        IOProfiler::setSampleRate(0);
+        IOProfiler::reset();
+    }
+
+    void testSampleRate() {
+        String name("test");
+        IOProfiler profiler(name);
+
+        IOProfiler::setSampleRate(0);
+        for(uint32 i = 0; i < 10; i++)
+            TS_ASSERT(!profiler.sample());
+
+        IOProfiler::setSampleRate(4);
+        uint32 sampled = 0;
+        for(uint32 i = 0; i < 100; i++)
+            if (profiler.sample()) sampled++;
+        TS_ASSERT_EQUALS(sampled, 25u);
+    }
+
+    void testRecordsSamples() {
+        String name("test-strand");
+        IOProfiler profiler(name);
+        IOProfiler::setSampleRate(1);
+
+        uint32 count = 0;
+        IOCallback cb = profiler.wrap(std::tr1::bind(&incrementHandler, &count), "test-tag");
+        cb();
+        cb();
+        TS_ASSERT_EQUALS(count, 2u);
+
+        Command::Result stats = Command::EmptyResult();
+        IOProfiler::fillCommandResultWithStats(stats);
+        Command::Array& queues = stats.getArray("queues");
+        TS_ASSERT_EQUALS(queues.size(), 1u);
+        TS_ASSERT_EQUALS(queues[0].getString("name"), "test-strand");
+        Command::Array& tags = queues[0].getArray("tags");
+        TS_ASSERT_EQUALS(tags.size(), 1u);
+        TS_ASSERT_EQUALS(tags[0].getString("tag"), "test-tag");
+        TS_ASSERT_EQUALS(tags[0].getInt("samples", 0), 2);
+
+        // One metadata event naming the queue, then one per sample
+        Command::Result trace = Command::EmptyResult();
+        IOProfiler::fillCommandResultWithTrace(trace);
+        TS_ASSERT_EQUALS(trace.getArray("traceEvents").size(), 3u);
+    }
+};
@@ -0,0 +1,68 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/trace/Metrics.hpp>
+
+using namespace Sirikata;
+using namespace Sirikata::Trace;
+
+class MetricsTest : public CxxTest::TestSuite
+{
+public:
+    void testCounter() {
+        MetricCounter counter;
+        counter++;
+        counter += 10;
+        TS_ASSERT_EQUALS(counter.take(), 11u);
+        TS_ASSERT_EQUALS(counter.take(), 0u);
+        counter++;
+        TS_ASSERT_EQUALS(counter.take(), 1u);
+        TS_ASSERT_EQUALS(counter.total(), 12u);
+    }
+
+    void testGauge() {
+        MetricGauge gauge;
+        TS_ASSERT_EQUALS(gauge.read(), 0.0);
+        gauge.set(-2.5);
+        TS_ASSERT_EQUALS(gauge.read(), -2.5);
+    }
+
+    void testHistogramBuckets() {
+        // Every value must fall in a bucket whose bound is at least the value
+        // and within the advertised precision of it
+        uint64 prev_idx = 0;
+        for(uint64 val = 0; val < 100000; val += 7) {
+            uint32 idx = MetricHistogram::bucketIndex(val);
+            TS_ASSERT(idx < MetricHistogram::NUM_BUCKETS);
+            TS_ASSERT(idx >= prev_idx);
+            prev_idx = idx;
+            uint64 bound = MetricHistogram::bucketUpperBound(idx);
+            TS_ASSERT(bound >= val);
+            TS_ASSERT(bound <= val + val / 16 + 1);
+            if (idx > 0)
+                TS_ASSERT(MetricHistogram::bucketUpperBound(idx - 1) < val);
+        }
+        // Huge values are clamped into the last bucket
+        TS_ASSERT_EQUALS(MetricHistogram::bucketIndex((uint64)-1), (uint32)MetricHistogram::NUM_BUCKETS - 1);
+    }
+
+    void testHistogramSummary() {
+        MetricHistogram hist;
+        for(uint64 i = 1; i <= 1000; i++)
+            hist.record(i);
+
+        MetricHistogram::Summary summary = hist.take();
+        TS_ASSERT_EQUALS(summary.count, 1000u);
+        TS_ASSERT_DELTA(summary.mean, 500.5, 0.001);
+        TS_ASSERT(summary.p50 >= 500 && summary.p50 <= 500 * 17 / 16);
+        TS_ASSERT(summary.p90 >= 900 && summary.p90 <= 900 * 17 / 16);
+        TS_ASSERT(summary.p99 >= 990 && summary.p99 <= 990 * 17 / 16);
+        TS_ASSERT(summary.max >= 1000 && summary.max <= 1000 * 17 / 16);
+
+        // Taking the summary resets the histogram
+        summary = hist.take();
+        TS_ASSERT_EQUALS(summary.count, 0u);
+    }
+};
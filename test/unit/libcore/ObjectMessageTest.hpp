@@ -0,0 +1,38 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_OBJECT_MESSAGE_TEST_HPP_
+#define _SIRIKATA_OBJECT_MESSAGE_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/network/ObjectMessage.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+class ObjectMessageTest : public CxxTest::TestSuite
+{
+public:
+    void testObjectMessageHeaderFraming() {
+        // The header and a separately sent payload should parse as a single
+        // message, which also checks the payload field number is right
+        ObjectMessage header;
+        createObjectHostMessageHeader(ObjectHostID(), UUID::random(), 5, UUID::random(), 6, &header);
+        std::string payload(300, 'x');
+        std::string wire;
+        TS_ASSERT(serializeObjectMessageHeader(header, payload.size(), &wire));
+        wire.append(payload);
+
+        Sirikata::Protocol::Object::ObjectMessage parsed;
+        TS_ASSERT(parsed.ParseFromString(wire));
+        TS_ASSERT_EQUALS(parsed.source_object(), header.source_object());
+        TS_ASSERT_EQUALS(parsed.source_port(), header.source_port());
+        TS_ASSERT_EQUALS(parsed.dest_object(), header.dest_object());
+        TS_ASSERT_EQUALS(parsed.dest_port(), header.dest_port());
+        TS_ASSERT_EQUALS(parsed.unique(), header.unique());
+        TS_ASSERT(parsed.payload() == payload);
+    }
+};
+
+#endif //_SIRIKATA_OBJECT_MESSAGE_TEST_HPP_
@@ -0,0 +1,128 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/util/RegionWeightCalculator.hpp>
+#include <sirikata/core/util/PluginManager.hpp>
+
+using namespace Sirikata;
+
+class RegionWeightCalculatorTest : public CxxTest::TestSuite
+{
+    PluginManager mPlugins;
+    RegionPairs mRegions;
+
+    RegionWeightCalculatorTest() {
+        mPlugins.load("weight-exp");
+
+        // A mix of distant pairs and overlapping ones, where the weight is
+        // largest
+        srand(0);
+        for(uint32 i = 0; i < 1000; i++) {
+            BoundingBox3f source(randomVector(1000.f), 1.f + randomFloat(50.f));
+            BoundingBox3f dest(randomVector(1000.f), 1.f + randomFloat(50.f));
+            if (i % 4 == 0)
+                dest = BoundingBox3f(source.center() + randomVector(20.f), 1.f + randomFloat(50.f));
+            mRegions.add(source, dest);
+        }
+    }
+
+    static float32 randomFloat(float32 max) {
+        return max * (rand() / (float32)RAND_MAX);
+    }
+    static Vector3f randomVector(float32 max) {
+        return Vector3f(randomFloat(max), randomFloat(max), randomFloat(max));
+    }
+    static BoundingBox3f region(const RegionPairs& pairs, size_t i, bool source) {
+        const std::vector<double>* min = (source ? pairs.sourceMin : pairs.destMin);
+        const std::vector<double>* max = (source ? pairs.sourceMax : pairs.destMax);
+        return BoundingBox3f(
+            Vector3f(min[0][i], min[1][i], min[2][i]),
+            Vector3f(max[0][i], max[1][i], max[2][i])
+        );
+    }
+
+    RegionWeightCalculator* createGaussian(const String& args) {
+        if (!RegionWeightCalculatorFactory::getSingleton().hasConstructor("gaussian"))
+            return NULL;
+        return RegionWeightCalculatorFactory::getSingleton().getConstructor("gaussian")(args);
+    }
+
+    // Checks that computing weights one at a time and in a batch agree
+    void checkBatchMatchesSingle(RegionWeightCalculator* calc) {
+        std::vector<float64> batch;
+        calc->weights(mRegions, &batch);
+        TS_ASSERT_EQUALS(batch.size(), mRegions.size());
+        for(size_t i = 0; i < mRegions.size(); i++) {
+            BoundingBox3f dest = region(mRegions, i, false);
+            float64 single = calc->weight(region(mRegions, i, true), dest);
+            TS_ASSERT_DELTA(batch[i], single, 1e-9 * std::max(fabs(single), 1.0));
+        }
+    }
+
+public:
+    static RegionWeightCalculatorTest* createSuite() {
+        return new RegionWeightCalculatorTest;
+    }
+    static void destroySuite(RegionWeightCalculatorTest* suite) {
+        delete suite;
+    }
+
+    void testBatchFallback(void) {
+        RegionWeightCalculator calc(
+            std::tr1::bind(&RegionWeightCalculatorTest::sizeWeight,
+                std::tr1::placeholders::_1,
+                std::tr1::placeholders::_2,
+                std::tr1::placeholders::_3,
+                std::tr1::placeholders::_4)
+        );
+        checkBatchMatchesSingle(&calc);
+    }
+
+    void testGaussianBatch(void) {
+        RegionWeightCalculator* exact = createGaussian("--flatness=0.01 --table=false");
+        if (exact == NULL) {
+            TS_FAIL("gaussian weight calculator from weight-exp isn't available");
+            return;
+        }
+        checkBatchMatchesSingle(exact);
+        delete exact;
+
+        RegionWeightCalculator* table = createGaussian("--flatness=0.01 --table=true");
+        checkBatchMatchesSingle(table);
+        delete table;
+    }
+
+    // The table should be accurate to well below the precision weights are
+    // sent with, across flatness values spanning the regions' sizes
+    void testGaussianTableAccuracy(void) {
+        const char* flatness[] = { "8", "0.01", "0.0001" };
+        for(uint32 fi = 0; fi < sizeof(flatness)/sizeof(flatness[0]); fi++) {
+            String args = String("--flatness=") + flatness[fi];
+            RegionWeightCalculator* exact = createGaussian(args + " --table=false");
+            if (exact == NULL) {
+                TS_FAIL("gaussian weight calculator from weight-exp isn't available");
+                return;
+            }
+            RegionWeightCalculator* table = createGaussian(args + " --table=true --table-size=1024");
+
+            std::vector<float64> exact_weights, table_weights;
+            exact->weights(mRegions, &exact_weights);
+            table->weights(mRegions, &table_weights);
+
+            float64 max_weight = 0;
+            for(size_t i = 0; i < exact_weights.size(); i++)
+                max_weight = std::max(max_weight, fabs(exact_weights[i]));
+            for(size_t i = 0; i < exact_weights.size(); i++)
+                TS_ASSERT_DELTA(table_weights[i], exact_weights[i], std::max(1e-6 * fabs(exact_weights[i]), 1e-9 * max_weight));
+
+            delete exact;
+            delete table;
+        }
+    }
+
+    static double sizeWeight(const Vector3d& src_min, const Vector3d& src_max, const Vector3d& dst_min, const Vector3d& dst_max) {
+        return (src_max - src_min).length() * (dst_max - dst_min).length() / (1.0 + ((src_min + src_max) - (dst_min + dst_max)).lengthSquared());
+    }
+};
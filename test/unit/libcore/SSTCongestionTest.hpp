@@ -0,0 +1,425 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/network/SSTCongestion.hpp>
+#include <queue>
+#include <set>
+
+using namespace Sirikata;
+
+/** Simulates an SST channel sending a fixed amount of data over a loopback
+ *  link with latency, a bottleneck with a drop-tail queue and random loss.
+ *  The sender uses the same scoreboard, congestion controller and RTO
+ *  estimator as Connection, and retransmits segments under new sequence
+ *  numbers as Stream does. Everything runs in simulated time, so results are
+ *  deterministic.
+ */
+class LossyLinkSimulation {
+public:
+    LossyLinkSimulation(const String& algorithm, bool ack_ranges, float64 loss_rate)
+     : segments(10000),
+       oneWayLatency(50000),
+       bottleneckInterval(500),
+       queueLimit(64),
+       lossRate(loss_rate),
+       receiveWindow(0),
+       useAckRanges(ack_ranges),
+       transmissions(0),
+       timeouts(0),
+       mController(SST::CongestionController::create(algorithm)),
+       mNow(0),
+       mNextEventID(0),
+       mRandState(12345),
+       mNextData(0),
+       mChannelSeqno(0),
+       mTimerPending(false),
+       mLinkFree(0),
+       mReceivedRun(0, ack_ranges ? 255 : 1),
+       mNextInOrder(0),
+       mDelivered(0),
+       mFinished(-1)
+    {}
+    ~LossyLinkSimulation() {
+        delete mController;
+    }
+
+    /// Runs until all data is delivered, returning the goodput in segments/s
+    float64 run() {
+        mReceived.assign(segments, false);
+        trySend();
+        // Give up after an hour of simulated time rather than spinning on a
+        // transfer that has stalled
+        while(!mEvents.empty() && mFinished < 0 && mNow < 3600000000LL) {
+            Event evt = mEvents.top();
+            mEvents.pop();
+            mNow = evt.time;
+            switch(evt.type) {
+              case DATA: receiveData(evt.seqno, evt.data); break;
+              case ACK: receiveAck(evt.seqno, evt.data); break;
+              case TIMER: timer(); break;
+            }
+        }
+        if (mFinished <= 0) return 0;
+        return segments / (mFinished / 1000000.0);
+    }
+
+    uint32 delivered() const { return mDelivered; }
+
+    uint32 segments;
+    int64 oneWayLatency;
+    // Time to push a single segment through the bottleneck
+    int64 bottleneckInterval;
+    int64 queueLimit;
+    float64 lossRate;
+    // Segments the receiver buffers past the first one it's missing. Like a
+    // Stream, it drops and doesn't ack anything beyond that. 0 is unlimited.
+    uint32 receiveWindow;
+    bool useAckRanges;
+
+    uint32 transmissions;
+    uint32 timeouts;
+
+private:
+    typedef SST::SegmentScoreboard<uint32> Scoreboard;
+
+    enum EventType { DATA, ACK, TIMER };
+    struct Event {
+        int64 time;
+        uint64 id;
+        EventType type;
+        uint64 seqno;
+        uint32 data;
+
+        bool operator<(const Event& rhs) const {
+            // Reversed for the priority_queue, earliest event first
+            if (time != rhs.time) return time > rhs.time;
+            return id > rhs.id;
+        }
+    };
+
+    void schedule(int64 t, EventType type, uint64 seqno, uint32 data) {
+        Event evt = { t, mNextEventID++, type, seqno, data };
+        mEvents.push(evt);
+    }
+
+    Time now() const { return Time::microseconds(mNow); }
+
+    bool dropRandomly() {
+        mRandState = mRandState * 6364136223846793005ULL + 1442695040888963407ULL;
+        return ((mRandState >> 33) / (float64)(1ULL << 31)) < lossRate;
+    }
+
+    void trySend() {
+        while(mBoard.size() < mController->window() &&
+            (!mRetransmit.empty() || mNextData < segments))
+        {
+            uint32 data;
+            if (!mRetransmit.empty()) {
+                data = *mRetransmit.begin();
+                mRetransmit.erase(mRetransmit.begin());
+            }
+            else {
+                data = mNextData++;
+            }
+            uint64 seqno = ++mChannelSeqno;
+            mBoard.sent(seqno, data, now());
+            transmit(seqno, data);
+        }
+        armTimer();
+    }
+
+    void transmit(uint64 seqno, uint32 data) {
+        transmissions++;
+        int64 departure = std::max(mNow, mLinkFree) + bottleneckInterval;
+        if ((departure - mNow) / bottleneckInterval > queueLimit)
+            return;
+        mLinkFree = departure;
+        if (dropRandomly())
+            return;
+        schedule(departure + oneWayLatency, DATA, seqno, data);
+    }
+
+    void receiveData(uint64 seqno, uint32 data) {
+        mReceivedRun.received(seqno);
+        if (receiveWindow > 0 && data >= mNextInOrder + receiveWindow) {
+            mReceivedRun.reject();
+            return;
+        }
+
+        if (!mReceived[data]) {
+            mReceived[data] = true;
+            mDelivered++;
+            if (mDelivered == segments)
+                mFinished = mNow;
+        }
+        while(mNextInOrder < segments && mReceived[mNextInOrder])
+            mNextInOrder++;
+
+        if (!dropRandomly())
+            schedule(mNow + oneWayLatency, ACK, seqno, mReceivedRun.count());
+    }
+
+    void receiveAck(uint64 seqno, uint32 count) {
+        int64 rtt;
+        uint32 nacked = mBoard.acked(seqno, count, now(), &rtt);
+        if (nacked == 0) return;
+        if (rtt >= 0) mRTT.sample(rtt);
+        mController->onAck(nacked, now());
+
+        Scoreboard::SegmentList lost;
+        mBoard.detectLosses(&lost);
+        for(uint32 i = 0; i < lost.size(); i++) {
+            mRetransmit.insert(lost[i].second);
+            mController->onLoss(lost[i].first, mBoard.highestSent(), now());
+        }
+        trySend();
+    }
+
+    void armTimer() {
+        if (mTimerPending || mBoard.empty()) return;
+        mTimerPending = true;
+        int64 deadline = (mBoard.oldestTransmitTime() - Time::null()).toMicroseconds() + mRTT.rto();
+        schedule(std::max(deadline, mNow), TIMER, 0, 0);
+    }
+
+    void timer() {
+        mTimerPending = false;
+        if (mBoard.empty()) return;
+        if ((now() - mBoard.oldestTransmitTime()).toMicroseconds() >= mRTT.rto()) {
+            timeouts++;
+            Scoreboard::SegmentList lost;
+            mBoard.drain(&lost);
+            for(uint32 i = 0; i < lost.size(); i++)
+                mRetransmit.insert(lost[i].second);
+            mController->onTimeout(mBoard.highestSent(), now());
+            mRTT.backoff();
+        }
+        trySend();
+    }
+
+    SST::CongestionController* mController;
+    SST::RTTEstimator mRTT;
+    Scoreboard mBoard;
+
+    int64 mNow;
+    std::priority_queue<Event> mEvents;
+    uint64 mNextEventID;
+    uint64 mRandState;
+
+    // Sender
+    uint32 mNextData;
+    // Lowest offset first, like a Stream resending its buffers, so the
+    // segment the receiver is waiting on isn't stuck behind ones it drops
+    std::set<uint32> mRetransmit;
+    uint64 mChannelSeqno;
+    bool mTimerPending;
+    int64 mLinkFree;
+
+    // Receiver
+    SST::AckRun mReceivedRun;
+    uint32 mNextInOrder;
+    std::vector<bool> mReceived;
+    uint32 mDelivered;
+    int64 mFinished;
+};
+
+class SSTCongestionTest : public CxxTest::TestSuite
+{
+public:
+    void testRTTEstimator() {
+        SST::RTTEstimator rtt;
+        TS_ASSERT_EQUALS(rtt.rto(), (int64)SST::RTTEstimator::INITIAL_RTO_MICROSECONDS);
+
+        rtt.sample(100000);
+        TS_ASSERT_EQUALS(rtt.srtt(), 100000);
+        TS_ASSERT_EQUALS(rtt.rto(), 300000);
+
+        rtt.backoff();
+        TS_ASSERT_EQUALS(rtt.rto(), 600000);
+
+        // Steady, fast samples converge on the minimum RTO
+        for(int i = 0; i < 100; i++)
+            rtt.sample(1000);
+        TS_ASSERT_EQUALS(rtt.rto(), (int64)SST::RTTEstimator::MIN_RTO_MICROSECONDS);
+
+        for(int i = 0; i < 100; i++)
+            rtt.backoff();
+        TS_ASSERT_EQUALS(rtt.rto(), (int64)SST::RTTEstimator::MAX_RTO_MICROSECONDS);
+    }
+
+    void testNewReno() {
+        SST::NewRenoCongestionController cc;
+        Time t = Time::null();
+        TS_ASSERT_EQUALS(cc.window(), (uint32)SST::CongestionController::INITIAL_WINDOW);
+        TS_ASSERT(cc.inSlowStart());
+
+        // Slow start doubles per round trip
+        cc.onAck(2, t);
+        TS_ASSERT_EQUALS(cc.window(), 4u);
+        cc.onAck(4, t);
+        TS_ASSERT_EQUALS(cc.window(), 8u);
+
+        // Loss halves the window, but only once per round trip
+        cc.onLoss(5, 20, t);
+        TS_ASSERT_EQUALS(cc.window(), 4u);
+        TS_ASSERT(!cc.inSlowStart());
+        cc.onLoss(12, 20, t);
+        TS_ASSERT_EQUALS(cc.window(), 4u);
+
+        // Congestion avoidance adds one segment per window of acks
+        cc.onAck(4, t);
+        TS_ASSERT_EQUALS(cc.window(), 5u);
+
+        cc.onLoss(21, 30, t);
+        TS_ASSERT_EQUALS(cc.window(), 2u);
+
+        // Timeouts restart slow start
+        cc.onTimeout(40, t);
+        TS_ASSERT_EQUALS(cc.window(), 1u);
+        TS_ASSERT(cc.inSlowStart());
+    }
+
+    void testCubicRecovery() {
+        // After a loss at a large window, CUBIC returns to it within a few
+        // seconds regardless of RTT; NewReno needs one RTT per segment.
+        SST::CubicCongestionController cubic;
+        SST::NewRenoCongestionController reno;
+        Time t = Time::null();
+        for(int i = 0; i < 7; i++) {
+            cubic.onAck(cubic.window(), t);
+            reno.onAck(reno.window(), t);
+        }
+        TS_ASSERT_EQUALS(cubic.window(), 256u);
+        cubic.onLoss(1, 256, t);
+        reno.onLoss(1, 256, t);
+        TS_ASSERT_EQUALS(cubic.window(), 179u);
+        TS_ASSERT_EQUALS(reno.window(), 128u);
+
+        // 200ms round trips for 8 seconds
+        for(int i = 1; i <= 40; i++) {
+            t = Time::null() + Duration::milliseconds((int64)i * 200);
+            cubic.onAck(cubic.window(), t);
+            reno.onAck(reno.window(), t);
+        }
+        TS_ASSERT(cubic.window() >= 256u);
+        TS_ASSERT(reno.window() < 200u);
+    }
+
+    void testCreate() {
+        SST::CongestionController* cc = SST::CongestionController::create("cubic");
+        TS_ASSERT(cc != NULL);
+        TS_ASSERT_EQUALS(String(cc->name()), "cubic");
+        delete cc;
+        cc = SST::CongestionController::create("newreno");
+        TS_ASSERT(cc != NULL);
+        TS_ASSERT_EQUALS(String(cc->name()), "newreno");
+        delete cc;
+        TS_ASSERT(SST::CongestionController::create("vegas") == NULL);
+    }
+
+    void testScoreboardAckRanges() {
+        SST::SegmentScoreboard<uint32> board;
+        Time t = Time::null();
+        for(uint32 i = 1; i <= 10; i++)
+            board.sent(i, i * 100, t + Duration::milliseconds((int64)i));
+        TS_ASSERT_EQUALS(board.size(), 10u);
+        TS_ASSERT_EQUALS(board.highestSent(), 10u);
+
+        // A run of 3 ending at 5 acks 3, 4 and 5
+        int64 rtt;
+        TS_ASSERT_EQUALS(board.acked(5, 3, t + Duration::milliseconds((int64)25), &rtt), 3u);
+        TS_ASSERT_EQUALS(rtt, 20000);
+        // Repeated acks are ignored
+        TS_ASSERT_EQUALS(board.acked(5, 3, t, &rtt), 0u);
+        TS_ASSERT_EQUALS(rtt, -1);
+
+        // 1 and 2 have been passed by 3 acks and are lost
+        SST::SegmentScoreboard<uint32>::SegmentList lost;
+        board.detectLosses(&lost);
+        TS_ASSERT_EQUALS(lost.size(), 2u);
+        TS_ASSERT_EQUALS(lost[0].first, 1u);
+        TS_ASSERT_EQUALS(lost[0].second, 100u);
+        TS_ASSERT_EQUALS(lost[1].first, 2u);
+        TS_ASSERT_EQUALS(board.size(), 5u);
+
+        // Only 6 and 7 are far enough behind 10 to be considered lost
+        TS_ASSERT_EQUALS(board.acked(10, 1, t, &rtt), 1u);
+        lost.clear();
+        board.detectLosses(&lost);
+        TS_ASSERT_EQUALS(lost.size(), 2u);
+        TS_ASSERT_EQUALS(lost[1].first, 7u);
+        TS_ASSERT_EQUALS(board.size(), 2u);
+
+        lost.clear();
+        board.drain(&lost);
+        TS_ASSERT_EQUALS(lost.size(), 2u);
+        TS_ASSERT(board.empty());
+    }
+
+    void testAckRun() {
+        SST::AckRun run(1, 4);
+        run.received(2);
+        run.received(3);
+        TS_ASSERT_EQUALS(run.last(), 3u);
+        TS_ASSERT_EQUALS(run.count(), 3u);
+        run.received(4);
+        run.received(5);
+        TS_ASSERT_EQUALS(run.count(), 4u);
+
+        // A gap restarts the run
+        run.received(7);
+        TS_ASSERT_EQUALS(run.count(), 1u);
+
+        // A rejected segment is never covered by later acks
+        run.received(8);
+        run.reject();
+        TS_ASSERT_EQUALS(run.count(), 0u);
+        run.received(9);
+        run.received(10);
+        TS_ASSERT_EQUALS(run.count(), 2u);
+    }
+
+    void testReceiveWindowExceeded() {
+        // The receiver drops segments past its window. If acks for later
+        // segments covered the dropped ones, the sender would forget them and
+        // never finish.
+        LossyLinkSimulation limited("cubic", true, 0.001);
+        limited.receiveWindow = 16;
+        float64 goodput = limited.run();
+        TS_ASSERT_EQUALS(limited.delivered(), limited.segments);
+        TS_ASSERT(goodput > 0);
+        TS_ASSERT(limited.transmissions > limited.segments);
+    }
+
+    void testLossyLinkGoodput() {
+        // 100ms RTT, 2000 segments/s bottleneck. Without loss, only slow start
+        // and overflowing the bottleneck queue keep us from the link rate.
+        LossyLinkSimulation clean("cubic", true, 0);
+        float64 clean_goodput = clean.run();
+        TS_ASSERT_EQUALS(clean.delivered(), clean.segments);
+        TS_ASSERT(clean_goodput > 1000);
+
+        LossyLinkSimulation cubic("cubic", true, 0.01);
+        float64 cubic_goodput = cubic.run();
+        TS_ASSERT_EQUALS(cubic.delivered(), cubic.segments);
+
+        LossyLinkSimulation reno("newreno", true, 0.01);
+        float64 reno_goodput = reno.run();
+        TS_ASSERT_EQUALS(reno.delivered(), reno.segments);
+
+        // Without ack ranges every lost ack looks like lost data, causing
+        // spurious retransmissions and window reductions.
+        LossyLinkSimulation single_acks("cubic", false, 0.01);
+        float64 single_acks_goodput = single_acks.run();
+        TS_ASSERT_EQUALS(single_acks.delivered(), single_acks.segments);
+        TS_ASSERT(cubic.transmissions < single_acks.transmissions);
+        TS_ASSERT(cubic_goodput > single_acks_goodput);
+
+        // Loss costs throughput, but not all of it
+        TS_ASSERT(cubic_goodput < clean_goodput);
+        TS_ASSERT(reno_goodput < clean_goodput);
+        TS_ASSERT(reno_goodput > single_acks_goodput / 2);
+    }
+};
@@ -0,0 +1,274 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SEGMENTED_DISK_CACHE_LAYER_TEST_HPP_
+#define _SIRIKATA_SEGMENTED_DISK_CACHE_LAYER_TEST_HPP_
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/core/transfer/SegmentedDiskCacheLayer.hpp>
+#include <sirikata/core/transfer/MemoryCacheLayer.hpp>
+#include <sirikata/core/transfer/TransferData.hpp>
+#include <sirikata/core/transfer/LRUPolicy.hpp>
+#include <sirikata/core/util/Paths.hpp>
+#include <sirikata/core/util/Timer.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace Sirikata;
+
+#define CACHE_DIR "SegmentedDiskCacheLayerTest"
+
+// The cache layers are asynchronous: writes are handed to I/O threads, so
+// tests wait up to CACHE_WAIT for the data to show up rather than assuming
+// it is there immediately.
+#define CACHE_WAIT Duration::seconds(10)
+
+class SegmentedDiskCacheLayerTest : public CxxTest::TestSuite
+{
+    typedef Transfer::CacheLayer CacheLayer;
+    std::vector< CacheLayer*> mCacheLayers;
+    std::vector< Transfer::CachePolicy*> mCachePolicy;
+
+    boost::mutex wakeMutex;
+    boost::condition_variable wakeCV;
+    bool mFinished;
+    bool mFound;
+    std::string mResult;
+public:
+    SegmentedDiskCacheLayerTest () {
+    }
+
+    virtual void setUp() {
+        boost::filesystem::remove_all(Path::Get(Path::DIR_TEMP, CACHE_DIR));
+    }
+
+    virtual void tearDown() {
+        tearDownCache();
+        boost::filesystem::remove_all(Path::Get(Path::DIR_TEMP, CACHE_DIR));
+    }
+
+    static SegmentedDiskCacheLayerTest * createSuite( void ) {
+        return new SegmentedDiskCacheLayerTest();
+    }
+    static void destroySuite(SegmentedDiskCacheLayerTest * k) {
+        delete k;
+    }
+
+    CacheLayer *createSegmentedCache(CacheLayer *next = NULL,
+                uint32 num_shards = 4,
+                Transfer::cache_usize_type segment_size = Transfer::SegmentedDiskCacheLayer::DEFAULT_SEGMENT_SIZE) {
+        Transfer::CachePolicy *policy = new Transfer::LRUPolicy(1024*1024);
+        CacheLayer *layer = new Transfer::SegmentedDiskCacheLayer(
+                            policy,
+                            CACHE_DIR,
+                            next,
+                            num_shards,
+                            segment_size);
+        mCacheLayers.push_back(layer);
+        mCachePolicy.push_back(policy);
+        return layer;
+    }
+    CacheLayer *createMemoryCache(CacheLayer *next = NULL,
+                int size=32000) {
+        Transfer::CachePolicy *policy = new Transfer::LRUPolicy(size);
+        CacheLayer *layer = new Transfer::MemoryCacheLayer(
+                            policy,
+                            next);
+        mCacheLayers.push_back(layer);
+        mCachePolicy.push_back(policy);
+        return layer;
+    }
+    void tearDownCache() {
+        for (std::vector<Transfer::CacheLayer*>::reverse_iterator iter =
+                     mCacheLayers.rbegin(); iter != mCacheLayers.rend(); ++iter) {
+            delete (*iter);
+        }
+        mCacheLayers.clear();
+        for (std::vector<Transfer::CachePolicy*>::iterator iter =
+                     mCachePolicy.begin(); iter != mCachePolicy.end(); ++iter) {
+            delete (*iter);
+        }
+        mCachePolicy.clear();
+    }
+
+    static Transfer::Fingerprint fileId(int i) {
+        std::ostringstream os;
+        os << "SegmentedDiskCacheLayerTest" << i;
+        return SHA256::computeDigest(os.str());
+    }
+    static std::string fileContents(int i, size_t len) {
+        std::string result(len, 'a' + (i % 26));
+        std::ostringstream os;
+        os << i;
+        result.replace(0, os.str().size(), os.str());
+        return result;
+    }
+
+    void fetchCallback(const Transfer::SparseData *myData) {
+        boost::unique_lock<boost::mutex> wakeup(wakeMutex);
+        mFound = (myData != NULL);
+        mResult.clear();
+        if (myData) {
+            const Transfer::DenseDataList *ddl = myData;
+            for (Transfer::DenseDataList::const_iterator iter = ddl->begin(); iter != ddl->end(); ++iter)
+                mResult += iter->asString();
+        }
+        mFinished = true;
+        wakeCV.notify_one();
+    }
+
+    // Requests the whole file from layer, returning true and filling in
+    // result if it was found.
+    bool fetch(CacheLayer *layer, const Transfer::Fingerprint& id, std::string* result) {
+        using std::tr1::placeholders::_1;
+        {
+            boost::unique_lock<boost::mutex> wakeup(wakeMutex);
+            mFinished = false;
+            mFound = false;
+        }
+        layer->getData(id, Transfer::Range(true),
+            std::tr1::bind(&SegmentedDiskCacheLayerTest::fetchCallback, this, _1));
+
+        boost::unique_lock<boost::mutex> wakeup(wakeMutex);
+        boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds(CACHE_WAIT.toMicro());
+        while (!mFinished) {
+            if (!wakeCV.timed_wait(wakeup, deadline))
+                break;
+        }
+        TS_ASSERT(mFinished);
+        if (mFound && result)
+            *result = mResult;
+        return mFinished && mFound;
+    }
+
+    // Retries fetch until the data has been written, since writes are
+    // queued rather than performed immediately.
+    bool waitForData(CacheLayer *layer, const Transfer::Fingerprint& id, std::string* result) {
+        Time deadline = Timer::now() + CACHE_WAIT;
+        while (Timer::now() < deadline) {
+            if (fetch(layer, id, result))
+                return true;
+            Timer::sleep(Duration::milliseconds(5));
+        }
+        return false;
+    }
+
+    static int countSegments() {
+        int count = 0;
+        boost::filesystem::directory_iterator end_it;
+        for (boost::filesystem::directory_iterator dir_it(Path::Get(Path::DIR_TEMP, CACHE_DIR)); dir_it != end_it; dir_it++) {
+            std::string path = dir_it->path().string();
+            if (path.size() > 4 && path.substr(path.size() - 4) == ".seg")
+                count++;
+        }
+        return count;
+    }
+
+    void testPutGet( void ) {
+        CacheLayer *disk = createSegmentedCache();
+
+        std::string result;
+        TS_ASSERT(!fetch(disk, fileId(0), &result));
+
+        for (int i = 0; i < 20; i++)
+            disk->addToCache(fileId(i), Transfer::DenseDataPtr(new Transfer::DenseData(fileContents(i, 100 + i))));
+        for (int i = 0; i < 20; i++) {
+            TS_ASSERT(waitForData(disk, fileId(i), &result));
+            TS_ASSERT_EQUALS(result, fileContents(i, 100 + i));
+        }
+
+        disk->purgeFromCache(fileId(3));
+        TS_ASSERT(!fetch(disk, fileId(3), &result));
+        TS_ASSERT(fetch(disk, fileId(4), &result));
+        TS_ASSERT_EQUALS(result, fileContents(4, 104));
+    }
+
+    void testPopulatesMemoryCache( void ) {
+        CacheLayer *disk = createSegmentedCache();
+        CacheLayer *memory = createMemoryCache(disk);
+
+        memory->addToCache(fileId(0), Transfer::DenseDataPtr(new Transfer::DenseData(fileContents(0, 100))));
+        std::string result;
+        TS_ASSERT(waitForData(disk, fileId(0), &result));
+
+        // With the disk cache detached, the data must have been passed up
+        // to the memory cache.
+        memory->setNext(NULL);
+        TS_ASSERT(fetch(memory, fileId(0), &result));
+        TS_ASSERT_EQUALS(result, fileContents(0, 100));
+        memory->setNext(disk);
+    }
+
+    void testRestart( void ) {
+        CacheLayer *disk = createSegmentedCache();
+        for (int i = 0; i < 20; i++)
+            disk->addToCache(fileId(i), Transfer::DenseDataPtr(new Transfer::DenseData(fileContents(i, 200))));
+        std::string result;
+        for (int i = 0; i < 20; i++)
+            TS_ASSERT(waitForData(disk, fileId(i), &result));
+        // The delete is queued ahead of the shutdown request, so it always
+        // reaches the index.
+        disk->purgeFromCache(fileId(7));
+        tearDownCache();
+
+        // Everything but the purged entry should be recovered by replaying
+        // the index.
+        disk = createSegmentedCache();
+        for (int i = 0; i < 20; i++) {
+            if (i == 7) {
+                TS_ASSERT(!fetch(disk, fileId(i), &result));
+                continue;
+            }
+            TS_ASSERT(fetch(disk, fileId(i), &result));
+            TS_ASSERT_EQUALS(result, fileContents(i, 200));
+        }
+    }
+
+    void testCompaction( void ) {
+        // One shard with segments that hold four entries each
+        const size_t entry_size = 256;
+        const int num_entries = 16;
+        CacheLayer *disk = createSegmentedCache(NULL, 1, 4 * entry_size);
+        for (int i = 0; i < num_entries; i++)
+            disk->addToCache(fileId(i), Transfer::DenseDataPtr(new Transfer::DenseData(fileContents(i, entry_size))));
+        std::string result;
+        for (int i = 0; i < num_entries; i++)
+            TS_ASSERT(waitForData(disk, fileId(i), &result));
+        TS_ASSERT_EQUALS(countSegments(), num_entries / 4);
+
+        // Leave only one live entry in each segment, which should cause
+        // all of them to be compacted into a single segment once the shard
+        // is idle.
+        for (int i = 0; i < num_entries; i++) {
+            if (i % 4 != 0)
+                disk->purgeFromCache(fileId(i));
+        }
+        Time deadline = Timer::now() + CACHE_WAIT;
+        while (countSegments() > 2 && Timer::now() < deadline)
+            Timer::sleep(Duration::milliseconds(5));
+        TS_ASSERT(countSegments() <= 2);
+
+        for (int i = 0; i < num_entries; i += 4) {
+            TS_ASSERT(fetch(disk, fileId(i), &result));
+            TS_ASSERT_EQUALS(result, fileContents(i, entry_size));
+        }
+
+        // And the compacted layout should survive a restart
+        tearDownCache();
+        disk = createSegmentedCache(NULL, 1, 4 * entry_size);
+        for (int i = 0; i < num_entries; i++) {
+            if (i % 4 != 0) {
+                TS_ASSERT(!fetch(disk, fileId(i), &result));
+                continue;
+            }
+            TS_ASSERT(fetch(disk, fileId(i), &result));
+            TS_ASSERT_EQUALS(result, fileContents(i, entry_size));
+        }
+    }
+
+};
+
+#endif //_SIRIKATA_SEGMENTED_DISK_CACHE_LAYER_TEST_HPP_
@@ -0,0 +1,80 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SESSION_BATCH_TEST_HPP_
+#define _SIRIKATA_SESSION_BATCH_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/core/network/ObjectMessage.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+class SessionBatchTest : public CxxTest::TestSuite
+{
+public:
+    SessionBatchEntryList makeEntries(uint32 count) {
+        SessionBatchEntryList entries;
+        for(uint32 i = 0; i < count; i++) {
+            // Session payloads are opaque to the batch, so they can be any
+            // bytes, including empty and embedded nulls
+            std::string session(i % 7, (char)i);
+            entries.push_back(SessionBatchEntry(UUID::random(), session));
+        }
+        return entries;
+    }
+
+    void roundTrip(const SessionBatchEntryList& entries) {
+        std::string payload = serializeSessionBatch(entries);
+        SessionBatchEntryList parsed;
+        TS_ASSERT(parseSessionBatch(payload, &parsed));
+        TS_ASSERT_EQUALS(parsed.size(), entries.size());
+        if (parsed.size() != entries.size()) return;
+        for(uint32 i = 0; i < entries.size(); i++) {
+            TS_ASSERT_EQUALS(parsed[i].first, entries[i].first);
+            TS_ASSERT(parsed[i].second == entries[i].second);
+        }
+    }
+
+    void testEmptyBatch() {
+        roundTrip(SessionBatchEntryList());
+    }
+
+    void testSmallBatch() {
+        roundTrip(makeEntries(5));
+    }
+
+    void testFullBatch() {
+        roundTrip(makeEntries(MAX_SESSION_BATCH_ENTRIES));
+    }
+
+    void testParseAppends() {
+        SessionBatchEntryList first = makeEntries(3);
+        SessionBatchEntryList second = makeEntries(4);
+
+        SessionBatchEntryList parsed;
+        TS_ASSERT(parseSessionBatch(serializeSessionBatch(first), &parsed));
+        TS_ASSERT(parseSessionBatch(serializeSessionBatch(second), &parsed));
+        TS_ASSERT_EQUALS(parsed.size(), 7u);
+        if (parsed.size() != 7u) return;
+        TS_ASSERT_EQUALS(parsed[0].first, first[0].first);
+        TS_ASSERT_EQUALS(parsed[3].first, second[0].first);
+        TS_ASSERT_EQUALS(parsed[6].first, second[3].first);
+    }
+
+    void testGarbagePayload() {
+        // A field tag with a wire type protobuf doesn't define
+        std::string garbage("\x0f\xff\xff\xff", 4);
+        SessionBatchEntryList parsed;
+        TS_ASSERT(!parseSessionBatch(garbage, &parsed));
+    }
+
+    void testTruncatedPayload() {
+        std::string payload = serializeSessionBatch(makeEntries(5));
+        SessionBatchEntryList parsed;
+        TS_ASSERT(!parseSessionBatch(payload.substr(0, payload.size() - 1), &parsed));
+    }
+};
+
+#endif //_SIRIKATA_SESSION_BATCH_TEST_HPP_
@@ -0,0 +1,151 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include <sirikata/mesh/Raytrace.hpp>
+
+using namespace Sirikata;
+using namespace Sirikata::Mesh;
+
+class RaytraceTest : public CxxTest::TestSuite
+{
+    // A bumpy height field of (n-1)*(n-1)*2 triangles in the xy plane,
+    // spanning [0,n-1] in x and y.
+    MeshdataPtr createGrid(uint32 n, const Matrix4x4f& xform) {
+        MeshdataPtr mesh(new Meshdata());
+        mesh->globalTransform = Matrix4x4f::identity();
+
+        SubMeshGeometry geo;
+        for(uint32 y = 0; y < n; y++)
+            for(uint32 x = 0; x < n; x++)
+                geo.positions.push_back(Vector3f(x, y, ((x * 7 + y * 13) % 5) * 0.25f));
+        SubMeshGeometry::Primitive prim;
+        prim.primitiveType = SubMeshGeometry::Primitive::TRIANGLES;
+        prim.materialId = 0;
+        for(uint32 y = 0; y + 1 < n; y++) {
+            for(uint32 x = 0; x + 1 < n; x++) {
+                unsigned short i = y * n + x;
+                prim.indices.push_back(i); prim.indices.push_back(i + 1); prim.indices.push_back(i + n);
+                prim.indices.push_back(i + 1); prim.indices.push_back(i + n + 1); prim.indices.push_back(i + n);
+            }
+        }
+        geo.primitives.push_back(prim);
+        geo.recomputeBounds();
+        mesh->geometry.push_back(geo);
+
+        Node node(xform);
+        node.containsInstanceController = false;
+        mesh->nodes.push_back(node);
+        mesh->rootNodes.push_back(0);
+        GeometryInstance inst;
+        inst.geometryIndex = 0;
+        inst.parentNode = 0;
+        mesh->instances.push_back(inst);
+        return mesh;
+    }
+
+    // Brute force reference: closest hit over every triangle
+    bool bruteForce(MeshdataPtr mesh, const Vector3f& start, const Vector3f& dir, float32* t_out) {
+        const SubMeshGeometry& geo = mesh->geometry[0];
+        const std::vector<unsigned short>& idx = geo.primitives[0].indices;
+        Matrix4x4f xform = mesh->getTransform(0);
+        bool hit = false;
+        *t_out = 1000000.0f;
+        for(uint32 i = 0; i + 2 < idx.size(); i += 3) {
+            // Trace each triangle on its own and keep the closest
+            Vector3f a = xform * geo.positions[idx[i]], b = xform * geo.positions[idx[i+1]], c = xform * geo.positions[idx[i+2]];
+            Vector3f e1 = b - a, e2 = c - a;
+            Vector3f p = dir.cross(e2);
+            float32 det = e1.dot(p);
+            if (det == 0) continue;
+            Vector3f tv = start - a;
+            float32 u = tv.dot(p) / det;
+            Vector3f q = tv.cross(e1);
+            float32 v = dir.dot(q) / det;
+            float32 t = e2.dot(q) / det;
+            if (u < 0 || v < 0 || u + v > 1 || t < 0) continue;
+            if (t < *t_out) { *t_out = t; hit = true; }
+        }
+        return hit;
+    }
+
+    std::vector<Vector3f> mStarts, mDirs;
+
+public:
+    void setUp( void )
+    {
+        mStarts.clear();
+        mDirs.clear();
+        for(uint32 i = 0; i < 200; i++) {
+            mStarts.push_back(Vector3f( (i * 37 % 101) * 0.2f - 2.f, (i * 53 % 103) * 0.2f - 2.f, 5.f ));
+            mDirs.push_back(Vector3f( (i % 7) * 0.1f - 0.3f, (i % 11) * 0.05f - 0.25f, -1.f ));
+        }
+    }
+
+    void testMatchesBruteForce( void ) {
+        MeshdataPtr mesh = createGrid(17, Matrix4x4f::identity());
+        uint32 hits = 0;
+        for(uint32 i = 0; i < mStarts.size(); i++) {
+            float32 expected_t, t;
+            bool expected = bruteForce(mesh, mStarts[i], mDirs[i], &expected_t);
+            bool hit = Raytrace(mesh, Matrix4x4f::identity(), mStarts[i], mDirs[i], &t, NULL);
+            TS_ASSERT_EQUALS(expected, hit);
+            if (expected && hit) {
+                TS_ASSERT_DELTA(expected_t, t, 0.0001f);
+                hits++;
+            }
+        }
+        // Make sure the test actually exercises hits
+        TS_ASSERT(hits > mStarts.size() / 2);
+    }
+
+    void testTransformedInstance( void ) {
+        Matrix4x4f xform(Matrix4x4f::identity());
+        xform(0,3) = 3.f; xform(1,3) = -2.f; xform(2,3) = 1.f;
+        xform(0,0) = 2.f;
+        MeshdataPtr mesh = createGrid(9, xform);
+        for(uint32 i = 0; i < mStarts.size(); i++) {
+            float32 expected_t, t;
+            bool expected = bruteForce(mesh, mStarts[i], mDirs[i], &expected_t);
+            bool hit = Raytrace(mesh, Matrix4x4f::identity(), mStarts[i], mDirs[i], &t, NULL);
+            TS_ASSERT_EQUALS(expected, hit);
+            if (expected && hit)
+                TS_ASSERT_DELTA(expected_t, t, 0.0001f);
+        }
+    }
+
+    void testRaytraceMany( void ) {
+        MeshdataPtr mesh = createGrid(17, Matrix4x4f::identity());
+        std::vector<float32> ts;
+        std::vector<bool> hits;
+        uint32 nhits = RaytraceMany(mesh, Matrix4x4f::identity(), mStarts, mDirs, &ts, &hits);
+        TS_ASSERT_EQUALS(ts.size(), mStarts.size());
+        TS_ASSERT_EQUALS(hits.size(), mStarts.size());
+
+        uint32 expected_hits = 0;
+        for(uint32 i = 0; i < mStarts.size(); i++) {
+            float32 t;
+            bool hit = Raytrace(mesh, Matrix4x4f::identity(), mStarts[i], mDirs[i], &t, NULL);
+            TS_ASSERT_EQUALS(hit, (bool)hits[i]);
+            if (hit) {
+                TS_ASSERT_EQUALS(t, ts[i]);
+                expected_hits++;
+            }
+        }
+        TS_ASSERT_EQUALS(nhits, expected_hits);
+    }
+
+    void testModifiedGeometry( void ) {
+        // Moving the geometry must invalidate the cached BVH
+        MeshdataPtr mesh = createGrid(9, Matrix4x4f::identity());
+        Vector3f start(4.5f, 4.25f, 5.f), dir(0, 0, -1.f);
+        TS_ASSERT(Raytrace(mesh, Matrix4x4f::identity(), start, dir, NULL, NULL));
+
+        SubMeshGeometry& geo = mesh->geometry[0];
+        for(uint32 i = 0; i < geo.positions.size(); i++)
+            geo.positions[i].x += 100.f;
+        geo.recomputeBounds();
+        TS_ASSERT(!Raytrace(mesh, Matrix4x4f::identity(), start, dir, NULL, NULL));
+    }
+};
@@ -0,0 +1,104 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include <cxxtest/TestSuite.h>
+#include "StorageTestBase.hpp"
+
+/** Runs the standard storage tests against the caching storage layer, backed
+ *  by SQLite. Buckets are leased for every test, so these exercise the
+ *  in-memory paths as well as flushing to the backend between tests.
+ */
+class CachingStorageTest : public CxxTest::TestSuite
+{
+    static const String dbfile;
+    // The backend needs to be loaded in addition to the caching layer
+    PluginManager _backend_pmgr;
+    bool _backend_loaded;
+    StorageTestBase _base;
+public:
+    CachingStorageTest()
+     : _backend_loaded(false),
+       _base("oh-cache-storage", "cache", String("--flush-interval=10ms --backend=sqlite --backend-options=--db=") + dbfile)
+    {
+    }
+
+    // CXXTest is horrible so we have to override this. Since it doesn't use the
+    // preprocessor properly, we can't even make these macros.
+    void setUp() {
+        if (!_backend_loaded) {
+            _backend_loaded = true;
+            _backend_pmgr.load("oh-sqlite");
+        }
+        _base.setUp();
+    }
+    void tearDown() {_base.tearDown(); }
+
+    void testSetupTeardown() {_base.testSetupTeardown(); }
+    void testSingleWrite() {_base.testSingleWrite(); }
+    void testSingleRead() {_base.testSingleRead(); }
+    void testSingleInvalidRead() {_base.testSingleInvalidRead(); }
+    void testSingleCompare() {_base.testSingleCompare(); }
+    void testSingleInvalidCompare() {_base.testSingleInvalidCompare(); }
+    void testSingleErase() {_base.testSingleErase(); }
+
+    void testMultiWrite() {_base.testMultiWrite(); }
+    void testMultiRead() {_base.testMultiRead(); }
+    void testMultiInvalidRead() {_base.testMultiInvalidRead(); }
+    void testMultiSomeInvalidRead() {_base.testMultiSomeInvalidRead(); }
+    void testMultiErase() {_base.testMultiErase(); }
+
+    void testAtomicWrite() {_base.testAtomicWrite(); }
+    void testAtomicWriteErase() {_base.testAtomicWriteErase(); }
+
+    void testRangeRead() {_base.testRangeRead(); }
+    void testCount() {_base.testCount(); }
+    void testRangeErase() {_base.testRangeErase(); }
+
+    void testAllTransaction() {_base.testAllTransaction(); }
+
+    void testRollback() {_base.testRollback(); }
+
+    void testCommitWhileWriting() {_base.testCommitWhileWriting(); }
+};
+
+const String CachingStorageTest::dbfile("cache_test.db");
+
+/** Runs a subset of the storage tests with durable callbacks, where commit
+ *  callbacks wait for the data to reach the backend.
+ */
+class CachingStorageDurableTest : public CxxTest::TestSuite
+{
+    static const String dbfile;
+    PluginManager _backend_pmgr;
+    bool _backend_loaded;
+    StorageTestBase _base;
+public:
+    CachingStorageDurableTest()
+     : _backend_loaded(false),
+       _base("oh-cache-storage", "cache", String("--flush-interval=10ms --durable-callbacks=true --backend=sqlite --backend-options=--db=") + dbfile)
+    {
+    }
+
+    void setUp() {
+        if (!_backend_loaded) {
+            _backend_loaded = true;
+            _backend_pmgr.load("oh-sqlite");
+        }
+        _base.setUp();
+    }
+    void tearDown() {_base.tearDown(); }
+
+    void testSingleWrite() {_base.testSingleWrite(); }
+    void testSingleRead() {_base.testSingleRead(); }
+    void testSingleErase() {_base.testSingleErase(); }
+
+    void testMultiWrite() {_base.testMultiWrite(); }
+    void testMultiRead() {_base.testMultiRead(); }
+
+    void testAtomicWrite() {_base.testAtomicWrite(); }
+
+    void testCommitWhileWriting() {_base.testCommitWhileWriting(); }
+};
+
+const String CachingStorageDurableTest::dbfile("cache_durable_test.db");
@@ -0,0 +1,112 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CONNECT_PACER_TEST_HPP_
+#define _SIRIKATA_CONNECT_PACER_TEST_HPP_
+
+#include <sirikata/oh/Platform.hpp>
+#include <sirikata/oh/ConnectPacer.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+// nextBatchSize doesn't touch the context or object host, so the pacer can
+// be driven directly with made up statistics and times.
+class ConnectPacerTest : public CxxTest::TestSuite
+{
+    typedef SessionManager::ConnectStats ConnectStats;
+
+    static const uint32 UNLIMITED_RATE = 1000000;
+
+    ConnectPacer* createPacer(uint32 max_rate) {
+        return new ConnectPacer(NULL, NULL, SpaceID::null(), max_rate, Duration::milliseconds((int64)500), ConnectPacer::StartBatchCallback());
+    }
+
+    static Time at(int64 ms) {
+        return Time::null() + Duration::milliseconds(ms);
+    }
+
+    static ConnectStats stats(uint32 pending, int64 latency_ms, uint64 samples) {
+        ConnectStats result;
+        result.pending = pending;
+        result.latency = Duration::milliseconds(latency_ms);
+        result.samples = samples;
+        return result;
+    }
+
+public:
+    void testLowRateIsNotRoundedUp() {
+        // At 1 object/s, ticking every 100ms should start one object
+        // immediately and then one every 10 ticks, not one per tick.
+        std::auto_ptr<ConnectPacer> pacer(createPacer(1));
+        uint32 started = 0;
+        for(int64 tick = 0; tick <= 100; tick++)
+            started += pacer->nextBatchSize(stats(0, 0, 0), at(100 + tick * 100));
+        TS_ASSERT(started >= 10);
+        TS_ASSERT(started <= 11);
+    }
+
+    void testRateCapsBatch() {
+        std::auto_ptr<ConnectPacer> pacer(createPacer(50));
+        pacer->nextBatchSize(stats(0, 0, 0), at(100));
+        // 100ms at 50/s, well under the window
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(0, 0, 0), at(200)), (uint32)5);
+        // Nothing has accumulated without time passing
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(0, 0, 0), at(200)), (uint32)0);
+    }
+
+    void testWindowLimitsBatch() {
+        std::auto_ptr<ConnectPacer> pacer(createPacer(UNLIMITED_RATE));
+        uint32 window = pacer->window();
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(0, 0, 0), at(100)), window);
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(window - 3, 0, 0), at(200)), (uint32)3);
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(window, 0, 0), at(300)), (uint32)0);
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(window + 5, 0, 0), at(400)), (uint32)0);
+    }
+
+    void testAdditiveIncrease() {
+        std::auto_ptr<ConnectPacer> pacer(createPacer(UNLIMITED_RATE));
+        uint32 initial = pacer->window();
+        pacer->nextBatchSize(stats(0, 100, 1), at(100));
+        uint32 step = pacer->window() - initial;
+        TS_ASSERT(step > 0);
+
+        // Only new samples change the window
+        pacer->nextBatchSize(stats(0, 100, 1), at(200));
+        TS_ASSERT_EQUALS(pacer->window(), initial + step);
+
+        pacer->nextBatchSize(stats(0, 100, 2), at(300));
+        TS_ASSERT_EQUALS(pacer->window(), initial + 2 * step);
+    }
+
+    void testMultiplicativeDecrease() {
+        std::auto_ptr<ConnectPacer> pacer(createPacer(UNLIMITED_RATE));
+        uint64 samples = 0;
+        for(int i = 0; i < 10; i++)
+            pacer->nextBatchSize(stats(0, 100, ++samples), at(100));
+        uint32 grown = pacer->window();
+
+        // Over the 500ms target, so the window is halved...
+        pacer->nextBatchSize(stats(0, 1000, ++samples), at(10000));
+        TS_ASSERT_EQUALS(pacer->window(), grown / 2);
+        // ...but only once per round trip, since the smoothed latency hasn't
+        // had a chance to reflect the decrease yet
+        pacer->nextBatchSize(stats(0, 1000, ++samples), at(10500));
+        TS_ASSERT_EQUALS(pacer->window(), grown / 2);
+        // After a round trip it can back off again
+        pacer->nextBatchSize(stats(0, 1000, ++samples), at(11500));
+        TS_ASSERT_EQUALS(pacer->window(), grown / 4);
+    }
+
+    void testWindowNeverCloses() {
+        std::auto_ptr<ConnectPacer> pacer(createPacer(UNLIMITED_RATE));
+        uint64 samples = 0;
+        for(int64 t = 0; t < 100; t++)
+            pacer->nextBatchSize(stats(0, 1000, ++samples), at(10000 + t * 2000));
+        TS_ASSERT_EQUALS(pacer->window(), (uint32)1);
+        TS_ASSERT_EQUALS(pacer->nextBatchSize(stats(0, 1000, samples), at(300000)), (uint32)1);
+    }
+};
+
+#endif //_SIRIKATA_CONNECT_PACER_TEST_HPP_
@@ -72,6 +72,8 @@ public:
     void testAllTransaction() {_base.testAllTransaction(); }
 
     void testRollback() {_base.testRollback(); }
+
+    void testCommitWhileWriting() {_base.testCommitWhileWriting(); }
 };
 
 const String SQLiteStorageTest::dbfile("test.db");
@@ -192,6 +192,14 @@ public:
         _cond.wait(lock);
     }
 
+    void markCommitted(bool* committed, Result result, ReadSet* rs) {
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        TS_ASSERT_EQUALS(result, OH::Storage::SUCCESS);
+        delete rs;
+        *committed = true;
+        _cond.notify_one();
+    }
+
     void testSetupTeardown() {
         TS_ASSERT(_storage);
     }
@@ -627,6 +635,29 @@ public:
         verifyRollbackData("baz", "baz");
     }
 
+    void testCommitWhileWriting() {
+        using std::tr1::placeholders::_1;
+        using std::tr1::placeholders::_2;
+
+        // A commit has to be reported even if other writes to the bucket
+        // never stop, i.e. it can't wait for the bucket to be idle.
+        bool committed = false;
+        _storage->write(_buckets[0], "committed", "abcde",
+            std::tr1::bind(&StorageTestBase::markCommitted, this, &committed, _1, _2)
+        );
+
+        Time start = Timer::now();
+        uint32 i = 0;
+        boost::unique_lock<boost::mutex> lock(_mutex);
+        while(!committed && Timer::now() - start < Duration::seconds(10)) {
+            lock.unlock();
+            _storage->write(_buckets[0], "busy", boost::lexical_cast<String>(i++));
+            lock.lock();
+            _cond.timed_wait(lock, boost::posix_time::milliseconds(1));
+        }
+        TS_ASSERT(committed);
+    }
+
 };
 
 const OH::Storage::Bucket StorageTestBase::_buckets[2] = {
@@ -0,0 +1,130 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_AUTHENTICATOR_TEST_HPP_
+#define _SIRIKATA_AUTHENTICATOR_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/Authenticator.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+namespace {
+
+// Accepts requests whose auth data is "ok". Either answers immediately or
+// holds the callbacks until answerDeferred() is called, like an authenticator
+// which has to ask another service.
+class TestAuthenticator : public Authenticator {
+public:
+    TestAuthenticator(bool deferred)
+     : deferred(deferred)
+    {}
+
+    virtual void authenticate(const UUID& obj_id, MemoryReference auth, Callback cb) {
+        requested.push_back(obj_id);
+        bool result = (String((const char*)auth.data(), auth.size()) == "ok");
+        if (deferred)
+            pending.push_back(std::make_pair(cb, result));
+        else
+            cb(result);
+    }
+
+    // Answers outstanding requests, last first, so results don't arrive in
+    // request order
+    void answerDeferred() {
+        while(!pending.empty()) {
+            std::pair<Callback, bool> req = pending.back();
+            pending.pop_back();
+            req.first(req.second);
+        }
+    }
+
+    bool deferred;
+    std::vector<UUID> requested;
+    std::vector< std::pair<Callback, bool> > pending;
+};
+
+struct BatchResults {
+    BatchResults() : calls(0) {}
+    void record(const std::vector<bool>& res) {
+        calls++;
+        results = res;
+    }
+    uint32 calls;
+    std::vector<bool> results;
+};
+
+}
+
+class AuthenticatorTest : public CxxTest::TestSuite
+{
+public:
+    void makeBatch(std::vector<UUID>* obj_ids, std::vector<String>* auths) {
+        const char* auth_data[] = { "ok", "bad", "ok", "", "ok" };
+        for(uint32 i = 0; i < 5; i++) {
+            obj_ids->push_back(UUID::random());
+            auths->push_back(auth_data[i]);
+        }
+    }
+
+    void checkResults(const BatchResults& res) {
+        TS_ASSERT_EQUALS(res.calls, 1u);
+        TS_ASSERT_EQUALS(res.results.size(), 5u);
+        if (res.results.size() != 5u) return;
+        TS_ASSERT(res.results[0]);
+        TS_ASSERT(!res.results[1]);
+        TS_ASSERT(res.results[2]);
+        TS_ASSERT(!res.results[3]);
+        TS_ASSERT(res.results[4]);
+    }
+
+    void testEmptyBatch() {
+        TestAuthenticator auth(false);
+        BatchResults res;
+        auth.authenticateBatch(
+            std::vector<UUID>(), std::vector<String>(),
+            std::tr1::bind(&BatchResults::record, &res, std::tr1::placeholders::_1)
+        );
+        TS_ASSERT_EQUALS(res.calls, 1u);
+        TS_ASSERT(res.results.empty());
+        TS_ASSERT(auth.requested.empty());
+    }
+
+    void testImmediateResults() {
+        TestAuthenticator auth(false);
+        std::vector<UUID> obj_ids;
+        std::vector<String> auths;
+        makeBatch(&obj_ids, &auths);
+
+        BatchResults res;
+        auth.authenticateBatch(
+            obj_ids, auths,
+            std::tr1::bind(&BatchResults::record, &res, std::tr1::placeholders::_1)
+        );
+        TS_ASSERT(auth.requested == obj_ids);
+        checkResults(res);
+    }
+
+    void testDeferredResults() {
+        TestAuthenticator auth(true);
+        std::vector<UUID> obj_ids;
+        std::vector<String> auths;
+        makeBatch(&obj_ids, &auths);
+
+        BatchResults res;
+        auth.authenticateBatch(
+            obj_ids, auths,
+            std::tr1::bind(&BatchResults::record, &res, std::tr1::placeholders::_1)
+        );
+        TS_ASSERT(auth.requested == obj_ids);
+        // Nothing is reported until every request has an answer
+        TS_ASSERT_EQUALS(res.calls, 0u);
+
+        auth.answerDeferred();
+        checkResults(res);
+    }
+};
+
+#endif //_SIRIKATA_AUTHENTICATOR_TEST_HPP_
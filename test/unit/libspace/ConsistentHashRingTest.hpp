@@ -0,0 +1,216 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_CONSISTENT_HASH_RING_TEST_HPP_
+#define _SIRIKATA_CONSISTENT_HASH_RING_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/ConsistentHashRing.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+class ConsistentHashRingTest : public CxxTest::TestSuite
+{
+    typedef ConsistentHashRing::ServerSet ServerSet;
+    // Which servers store each object's entry
+    typedef std::map<UUID, ServerSet> Holders;
+
+    static const uint32 NUM_OBJECTS = 2000;
+    std::vector<UUID> mObjects;
+
+public:
+    void setUp() {
+        mObjects.clear();
+        for(uint32 i = 0; i < NUM_OBJECTS; i++)
+            mObjects.push_back(UUID::random());
+    }
+
+    ServerSet makeServers(ServerID first, ServerID last) {
+        ServerSet servers;
+        for(ServerID s = first; s <= last; s++)
+            servers.insert(s);
+        return servers;
+    }
+
+    // Store each object on its primary and replica in ring
+    Holders place(const ConsistentHashRing& ring) {
+        Holders holders;
+        for(uint32 i = 0; i < mObjects.size(); i++) {
+            ServerID primary, replica;
+            ring.owners(mObjects[i], &primary, &replica);
+            holders[mObjects[i]].insert(primary);
+            if (replica != NullServerID)
+                holders[mObjects[i]].insert(replica);
+        }
+        return holders;
+    }
+
+    // Runs rebalance() on every server holding each entry and checks that
+    // afterwards exactly the new primary and replica hold it, and that nobody
+    // is sent an entry twice or sent one it already had.
+    void checkRebalance(const ConsistentHashRing& old_ring, const ConsistentHashRing& new_ring) {
+        Holders before = place(old_ring);
+        Holders expected = place(new_ring);
+
+        for(Holders::iterator it = before.begin(); it != before.end(); it++) {
+            const UUID& obj_id = it->first;
+            ServerSet after;
+            std::map<ServerID, uint32> received;
+            for(ServerSet::iterator sit = it->second.begin(); sit != it->second.end(); sit++) {
+                // Servers which left don't take part
+                if (new_ring.servers().find(*sit) == new_ring.servers().end()) continue;
+
+                std::vector<ServerID> dests;
+                if (new_ring.rebalance(old_ring, *sit, obj_id, &dests))
+                    after.insert(*sit);
+                for(uint32 d = 0; d < dests.size(); d++) {
+                    TS_ASSERT(it->second.find(dests[d]) == it->second.end());
+                    received[dests[d]]++;
+                }
+            }
+            for(std::map<ServerID, uint32>::iterator rit = received.begin(); rit != received.end(); rit++) {
+                TS_ASSERT_EQUALS(rit->second, 1u);
+                after.insert(rit->first);
+            }
+            TS_ASSERT(after == expected[obj_id]);
+        }
+    }
+
+    void testEmptyRing() {
+        ConsistentHashRing ring(64, true);
+        TS_ASSERT(ring.empty());
+        ServerID primary, replica;
+        ring.owners(mObjects[0], &primary, &replica);
+        TS_ASSERT_EQUALS(primary, NullServerID);
+        TS_ASSERT_EQUALS(replica, NullServerID);
+    }
+
+    void testSingleServer() {
+        ConsistentHashRing ring(64, true);
+        ring.setServers(makeServers(1, 1));
+        for(uint32 i = 0; i < mObjects.size(); i++) {
+            ServerID primary, replica;
+            ring.owners(mObjects[i], &primary, &replica);
+            TS_ASSERT_EQUALS(primary, (ServerID)1);
+            TS_ASSERT_EQUALS(replica, NullServerID);
+        }
+    }
+
+    void testOwners() {
+        ConsistentHashRing ring(64, true);
+        ring.setServers(makeServers(1, 4));
+        ConsistentHashRing same(64, true);
+        same.setServers(makeServers(1, 4));
+        ConsistentHashRing unreplicated(64, false);
+        unreplicated.setServers(makeServers(1, 4));
+
+        for(uint32 i = 0; i < mObjects.size(); i++) {
+            ServerID primary, replica;
+            ring.owners(mObjects[i], &primary, &replica);
+            TS_ASSERT(primary >= 1 && primary <= 4);
+            TS_ASSERT(replica >= 1 && replica <= 4);
+            TS_ASSERT_DIFFERS(primary, replica);
+
+            // Every server has to agree on the owners
+            ServerID same_primary, same_replica;
+            same.owners(mObjects[i], &same_primary, &same_replica);
+            TS_ASSERT_EQUALS(primary, same_primary);
+            TS_ASSERT_EQUALS(replica, same_replica);
+
+            ServerID unrep_primary, unrep_replica;
+            unreplicated.owners(mObjects[i], &unrep_primary, &unrep_replica);
+            TS_ASSERT_EQUALS(primary, unrep_primary);
+            TS_ASSERT_EQUALS(unrep_replica, NullServerID);
+        }
+    }
+
+    void testBalance() {
+        ConsistentHashRing ring(64, true);
+        ring.setServers(makeServers(1, 4));
+
+        std::map<ServerID, uint32> counts;
+        for(uint32 i = 0; i < mObjects.size(); i++) {
+            ServerID primary, replica;
+            ring.owners(mObjects[i], &primary, &replica);
+            counts[primary]++;
+        }
+        // With 64 virtual nodes each server should get close to a quarter
+        TS_ASSERT_EQUALS(counts.size(), 4u);
+        for(std::map<ServerID, uint32>::iterator it = counts.begin(); it != counts.end(); it++) {
+            TS_ASSERT_LESS_THAN(NUM_OBJECTS / 8, it->second);
+            TS_ASSERT_LESS_THAN(it->second, NUM_OBJECTS / 2);
+        }
+    }
+
+    void testJoinOnlyMovesToNewServer() {
+        ConsistentHashRing old_ring(64, false);
+        old_ring.setServers(makeServers(1, 4));
+        ConsistentHashRing new_ring(64, false);
+        new_ring.setServers(makeServers(1, 5));
+
+        uint32 moved = 0;
+        for(uint32 i = 0; i < mObjects.size(); i++) {
+            ServerID old_primary, new_primary, replica;
+            old_ring.owners(mObjects[i], &old_primary, &replica);
+            new_ring.owners(mObjects[i], &new_primary, &replica);
+            if (old_primary != new_primary) {
+                TS_ASSERT_EQUALS(new_primary, (ServerID)5);
+                moved++;
+            }
+        }
+        // Roughly a fifth of the objects move to the new server
+        TS_ASSERT_LESS_THAN(0u, moved);
+        TS_ASSERT_LESS_THAN(moved, NUM_OBJECTS / 2);
+    }
+
+    void testRebalanceJoin() {
+        ConsistentHashRing old_ring(64, true);
+        old_ring.setServers(makeServers(1, 4));
+        ConsistentHashRing new_ring(64, true);
+        new_ring.setServers(makeServers(1, 5));
+        checkRebalance(old_ring, new_ring);
+    }
+
+    void testRebalanceLeave() {
+        ConsistentHashRing old_ring(64, true);
+        old_ring.setServers(makeServers(1, 5));
+        ServerSet servers = makeServers(1, 5);
+        servers.erase(3);
+        ConsistentHashRing new_ring(64, true);
+        new_ring.setServers(servers);
+        checkRebalance(old_ring, new_ring);
+    }
+
+    void testRebalanceWithoutReplicas() {
+        ConsistentHashRing old_ring(64, false);
+        old_ring.setServers(makeServers(1, 3));
+        ConsistentHashRing new_ring(64, false);
+        new_ring.setServers(makeServers(1, 4));
+        checkRebalance(old_ring, new_ring);
+    }
+
+    void testRebalanceFromEmpty() {
+        // Before the first membership update a server stores everything it
+        // registers, and has to hand it all to the right servers
+        ConsistentHashRing old_ring(64, true);
+        ConsistentHashRing new_ring(64, true);
+        new_ring.setServers(makeServers(1, 3));
+
+        for(uint32 i = 0; i < mObjects.size(); i++) {
+            ServerID primary, replica;
+            new_ring.owners(mObjects[i], &primary, &replica);
+            std::vector<ServerID> dests;
+            bool keep = new_ring.rebalance(old_ring, 1, mObjects[i], &dests);
+            TS_ASSERT_EQUALS(keep, primary == 1 || replica == 1);
+            ServerSet sent(dests.begin(), dests.end());
+            ServerSet expected;
+            if (primary != 1) expected.insert(primary);
+            if (replica != 1) expected.insert(replica);
+            TS_ASSERT(sent == expected);
+        }
+    }
+};
+
+#endif //_SIRIKATA_CONSISTENT_HASH_RING_TEST_HPP_
@@ -0,0 +1,94 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_PROX_TICK_SCHEDULER_TEST_HPP_
+#define _SIRIKATA_PROX_TICK_SCHEDULER_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/ProxTickScheduler.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+class ProxTickSchedulerTest : public CxxTest::TestSuite
+{
+    // Checks happen every 10ms and the intervals are the defaults, 1s and 100ms
+    static Time at(int64 ms) {
+        return Time::null() + Duration::seconds(100.f) + Duration::milliseconds(ms);
+    }
+
+    static ProxTickScheduler eventDriven() {
+        return ProxTickScheduler(Duration::milliseconds((int64)1000), Duration::milliseconds((int64)100));
+    }
+
+public:
+    void testPollingAlwaysTicks() {
+        ProxTickScheduler ticks;
+        TS_ASSERT(!ticks.eventDriven());
+        for(int64 ms = 0; ms < 300; ms += 10) {
+            TS_ASSERT(ticks.tickNeeded(false, at(ms)));
+            TS_ASSERT(ticks.tickNeeded(true, at(ms)));
+        }
+    }
+
+    void testFirstCheckTicks() {
+        ProxTickScheduler idle = eventDriven();
+        TS_ASSERT(idle.eventDriven());
+        TS_ASSERT(idle.tickNeeded(false, at(0)));
+
+        ProxTickScheduler busy = eventDriven();
+        TS_ASSERT(busy.tickNeeded(true, at(0)));
+    }
+
+    void testIdleSkippedUntilMaxInterval() {
+        ProxTickScheduler ticks = eventDriven();
+        TS_ASSERT(ticks.tickNeeded(false, at(0)));
+        for(int64 ms = 10; ms < 1000; ms += 10)
+            TS_ASSERT(!ticks.tickNeeded(false, at(ms)));
+        // Forced once the max interval has passed, then idle again
+        TS_ASSERT(ticks.tickNeeded(false, at(1000)));
+        TS_ASSERT(!ticks.tickNeeded(false, at(1010)));
+        TS_ASSERT(ticks.tickNeeded(false, at(2000)));
+    }
+
+    void testWorkAfterIdleTicksImmediately() {
+        ProxTickScheduler ticks = eventDriven();
+        TS_ASSERT(ticks.tickNeeded(false, at(0)));
+        TS_ASSERT(!ticks.tickNeeded(false, at(10)));
+        // Well within both intervals
+        TS_ASSERT(ticks.tickNeeded(true, at(20)));
+        // And again after every idle check
+        TS_ASSERT(!ticks.tickNeeded(false, at(30)));
+        TS_ASSERT(ticks.tickNeeded(true, at(40)));
+    }
+
+    void testContinuousWorkSpacedByLoadedInterval() {
+        ProxTickScheduler ticks = eventDriven();
+        TS_ASSERT(ticks.tickNeeded(true, at(0)));
+        for(int64 ms = 10; ms < 100; ms += 10)
+            TS_ASSERT(!ticks.tickNeeded(true, at(ms)));
+        TS_ASSERT(ticks.tickNeeded(true, at(100)));
+        TS_ASSERT(!ticks.tickNeeded(true, at(110)));
+
+        // Count ticks over a second of work at every check
+        uint32 count = 0;
+        for(int64 ms = 110; ms < 1110; ms += 10) {
+            if (ticks.tickNeeded(true, at(ms)))
+                count++;
+        }
+        TS_ASSERT_EQUALS(count, (uint32)10);
+    }
+
+    void testIdleCheckResetsLoaded() {
+        // Once loaded, a single idle check lets the next change through
+        // without waiting for the loaded interval
+        ProxTickScheduler ticks = eventDriven();
+        TS_ASSERT(ticks.tickNeeded(true, at(0)));
+        TS_ASSERT(!ticks.tickNeeded(true, at(10)));
+        TS_ASSERT(!ticks.tickNeeded(false, at(20)));
+        TS_ASSERT(ticks.tickNeeded(true, at(30)));
+    }
+};
+
+#endif //_SIRIKATA_PROX_TICK_SCHEDULER_TEST_HPP_
@@ -0,0 +1,314 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_QUERY_SHARD_ASSIGNMENT_TEST_HPP_
+#define _SIRIKATA_QUERY_SHARD_ASSIGNMENT_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/QueryShardAssignment.hpp>
+#include <sirikata/core/prox/QueryHandlerFactory.hpp>
+#include <sirikata/core/util/MotionVector.hpp>
+#include <sirikata/core/util/UniqueID.hpp>
+#include <sirikata/core/util/Random.hpp>
+#include <prox/base/LocationServiceCache.hpp>
+#include <prox/base/QueryEventListener.hpp>
+#include <cxxtest/TestSuite.h>
+#include <float.h>
+
+using namespace Sirikata;
+
+namespace QueryShardAssignmentTestUtil {
+
+class TestProxSimulationTraits {
+public:
+    typedef uint32 intType;
+    typedef float32 realType;
+
+    typedef Vector3f Vector3Type;
+    typedef TimedMotionVector3f MotionVector3Type;
+
+    typedef BoundingSphere3f BoundingSphereType;
+
+    typedef SolidAngle SolidAngleType;
+
+    typedef Time TimeType;
+    typedef Duration DurationType;
+
+    const static realType InfiniteRadius;
+    const static intType InfiniteResults;
+
+    typedef UniqueID32 UniqueIDGeneratorType;
+
+    typedef UUID ObjectIDType;
+    typedef UUID::Hasher ObjectIDHasherType;
+    typedef UUID::Null ObjectIDNullType;
+    typedef UUID::Random ObjectIDRandomType;
+};
+
+const TestProxSimulationTraits::realType TestProxSimulationTraits::InfiniteRadius = FLT_MAX;
+const TestProxSimulationTraits::intType TestProxSimulationTraits::InfiniteResults = INT_MAX;
+
+typedef Prox::QueryHandler<TestProxSimulationTraits> ProxQueryHandler;
+typedef Prox::Query<TestProxSimulationTraits> ProxQuery;
+typedef Prox::QueryEvent<TestProxSimulationTraits> ProxQueryEvent;
+
+#define EXTRACT_ITERATOR(x) (*((ObjectMap::iterator*)x.data))
+#define EXTRACT_ITERATOR_DATA(x) (EXTRACT_ITERATOR(x)->second)
+
+// Location cache for stationary objects, each shard gets its own replica just
+// like the shards' CBRLocationServiceCaches
+class TestLocationServiceCache : public Prox::LocationServiceCache<TestProxSimulationTraits> {
+public:
+    typedef Prox::LocationUpdateListener<TestProxSimulationTraits> LocationUpdateListener;
+
+    void addObject(const UUID& id, const Vector3f& pos, float32 radius) {
+        ObjectData& data = mObjects[id];
+        data.location = TimedMotionVector3f(Time::null(), MotionVector3f(pos, Vector3f(0, 0, 0)));
+        data.radius = radius;
+        for(ListenerSet::iterator listen_it = mListeners.begin(); listen_it != mListeners.end(); listen_it++)
+            (*listen_it)->locationConnected(id, false, true, data.location, BoundingSphere3f(Vector3f(0, 0, 0), 0.f), radius);
+    }
+
+    virtual void addPlaceholderImposter(
+        const ObjectID& id,
+        const Vector3f& center_offset,
+        const float32 center_bounds_radius,
+        const float32 max_size,
+        const String& zernike,
+        const String& mesh
+    ) {
+    }
+
+    virtual Iterator startTracking(const ObjectID& id) {
+        ObjectMap::iterator it = mObjects.find(id);
+        assert(it != mObjects.end());
+        return Iterator( new ObjectMap::iterator(it) );
+    }
+    virtual void stopTracking(const Iterator& id) {
+    }
+
+    virtual TimedMotionVector3f location(const Iterator& id) {
+        return EXTRACT_ITERATOR_DATA(id).location;
+    }
+    virtual Vector3f centerOffset(const Iterator& id) {
+        return Vector3f(0, 0, 0);
+    }
+    virtual float32 centerBoundsRadius(const Iterator& id) {
+        return 0.f;
+    }
+    virtual float32 maxSize(const Iterator& id) {
+        return EXTRACT_ITERATOR_DATA(id).radius;
+    }
+    virtual bool isLocal(const Iterator& id) {
+        return true;
+    }
+    Prox::ZernikeDescriptor& zernikeDescriptor(const Iterator& id) {
+        return Prox::ZernikeDescriptor::null();
+    }
+    String mesh(const Iterator& id) {
+        return String("");
+    }
+
+    virtual const UUID& iteratorID(const Iterator& id) {
+        return EXTRACT_ITERATOR(id)->first;
+    }
+
+    virtual void addUpdateListener(LocationUpdateListener* listener) {
+        mListeners.insert(listener);
+    }
+    virtual void removeUpdateListener(LocationUpdateListener* listener) {
+        mListeners.erase(listener);
+    }
+
+private:
+    struct ObjectData {
+        TimedMotionVector3f location;
+        float32 radius;
+    };
+    typedef std::tr1::unordered_map<UUID, ObjectData, UUID::Hasher> ObjectMap;
+    typedef std::set<LocationUpdateListener*> ListenerSet;
+
+    ObjectMap mObjects;
+    ListenerSet mListeners;
+};
+
+#undef EXTRACT_ITERATOR
+#undef EXTRACT_ITERATOR_DATA
+
+typedef std::set<UUID> ObjectSet;
+typedef std::map<UUID, ObjectSet> QuerierResults;
+
+// Applies each query's events to the results of the querier that owns it
+class ResultCollector : public Prox::QueryEventListener<TestProxSimulationTraits, ProxQuery> {
+public:
+    void add(ProxQuery* query, const UUID& querier) {
+        mQueriers[query] = querier;
+        mResults[querier];
+        query->setEventListener(this);
+    }
+
+    virtual void queryHasEvents(ProxQuery* query) {
+        ObjectSet& results = mResults[ mQueriers[query] ];
+        std::deque<ProxQueryEvent> evts;
+        query->popEvents(evts);
+        for(std::deque<ProxQueryEvent>::iterator it = evts.begin(); it != evts.end(); it++) {
+            for(uint32 aidx = 0; aidx < it->additions().size(); aidx++)
+                results.insert(it->additions()[aidx].id());
+            for(uint32 ridx = 0; ridx < it->removals().size(); ridx++)
+                results.erase(it->removals()[ridx].id());
+        }
+    }
+
+    const QuerierResults& results() const { return mResults; }
+
+private:
+    std::map<ProxQuery*, UUID> mQueriers;
+    QuerierResults mResults;
+};
+
+} // namespace QueryShardAssignmentTestUtil
+
+class QueryShardAssignmentTest : public CxxTest::TestSuite
+{
+    typedef QueryShardAssignmentTestUtil::TestLocationServiceCache TestLocationServiceCache;
+    typedef QueryShardAssignmentTestUtil::ProxQueryHandler ProxQueryHandler;
+    typedef QueryShardAssignmentTestUtil::ProxQuery ProxQuery;
+    typedef QueryShardAssignmentTestUtil::ResultCollector ResultCollector;
+    typedef QueryShardAssignmentTestUtil::ObjectSet ObjectSet;
+    typedef QueryShardAssignmentTestUtil::QuerierResults QuerierResults;
+
+    static const uint32 NUM_QUERIERS = 2000;
+    std::vector<UUID> mQueriers;
+
+public:
+    void setUp() {
+        mQueriers.clear();
+        for(uint32 i = 0; i < NUM_QUERIERS; i++)
+            mQueriers.push_back(UUID::random());
+    }
+
+    void testSingleShard() {
+        QueryShardAssignment shards(1);
+        TS_ASSERT_EQUALS(shards.size(), (uint32)1);
+        for(uint32 i = 0; i < mQueriers.size(); i++)
+            TS_ASSERT_EQUALS(shards.shard(mQueriers[i]), (uint32)0);
+
+        // Asking for no shards still gives one
+        QueryShardAssignment none(0);
+        TS_ASSERT_EQUALS(none.size(), (uint32)1);
+        TS_ASSERT_EQUALS(none.shard(mQueriers[0]), (uint32)0);
+    }
+
+    void testStableAndInRange() {
+        QueryShardAssignment shards(5);
+        QueryShardAssignment same(5);
+        for(uint32 i = 0; i < mQueriers.size(); i++) {
+            uint32 s = shards.shard(mQueriers[i]);
+            TS_ASSERT(s < shards.size());
+            TS_ASSERT_EQUALS(shards.shard(mQueriers[i]), s);
+            TS_ASSERT_EQUALS(same.shard(mQueriers[i]), s);
+        }
+    }
+
+    void testBalanced() {
+        const uint32 nshards = 4;
+        QueryShardAssignment shards(nshards);
+        std::vector<uint32> counts(nshards, 0);
+        for(uint32 i = 0; i < mQueriers.size(); i++)
+            counts[shards.shard(mQueriers[i])]++;
+        // Expect 500 each, allow for random variation
+        for(uint32 s = 0; s < nshards; s++) {
+            TS_ASSERT(counts[s] > NUM_QUERIERS / nshards * 3 / 4);
+            TS_ASSERT(counts[s] < NUM_QUERIERS / nshards * 5 / 4);
+        }
+    }
+
+    // Queries partitioned across shards, each with a replica of the objects,
+    // give every querier the same results as a single unsharded handler, both
+    // for the initial results and after more objects are added.
+    void testShardedResultsMatchUnsharded() {
+        const uint32 nshards = 3;
+        const uint32 nqueriers = 50;
+        const float32 world_size = 100.f;
+        QueryShardAssignment shards(nshards);
+
+        TestLocationServiceCache unsharded_cache;
+        std::vector<TestLocationServiceCache*> shard_caches;
+        for(uint32 s = 0; s < nshards; s++)
+            shard_caches.push_back(new TestLocationServiceCache());
+
+        ProxQueryHandler* unsharded = QueryHandlerFactory<QueryShardAssignmentTestUtil::TestProxSimulationTraits>("brute", "", false);
+        unsharded->initialize(&unsharded_cache, &unsharded_cache, false /* static */, false /* not replicated */);
+        std::vector<ProxQueryHandler*> shard_handlers;
+        for(uint32 s = 0; s < nshards; s++) {
+            ProxQueryHandler* handler = QueryHandlerFactory<QueryShardAssignmentTestUtil::TestProxSimulationTraits>("brute", "", false);
+            handler->initialize(shard_caches[s], shard_caches[s], false /* static */, false /* not replicated */);
+            shard_handlers.push_back(handler);
+        }
+
+        ResultCollector unsharded_results, sharded_results;
+        std::vector<ProxQuery*> queries;
+        std::vector<uint32> queries_per_shard(nshards, 0);
+        for(uint32 i = 0; i < nqueriers; i++) {
+            const UUID& querier = mQueriers[i];
+            TimedMotionVector3f loc(Time::null(), MotionVector3f(Vector3f(randFloat(0, world_size), randFloat(0, world_size), randFloat(0, world_size)), Vector3f(0, 0, 0)));
+            BoundingSphere3f region(Vector3f(0, 0, 0), 0.f);
+            SolidAngle angle(0.05f);
+
+            ProxQuery* query = unsharded->registerQuery(loc, region, 0.f, angle);
+            unsharded_results.add(query, querier);
+            queries.push_back(query);
+
+            uint32 s = shards.shard(querier);
+            queries_per_shard[s]++;
+            query = shard_handlers[s]->registerQuery(loc, region, 0.f, angle);
+            sharded_results.add(query, querier);
+            queries.push_back(query);
+        }
+        // Make sure the queries really are split up
+        for(uint32 s = 0; s < nshards; s++)
+            TS_ASSERT(queries_per_shard[s] > 0);
+
+        // Every object goes to every shard's cache
+        for(uint32 round = 0; round < 2; round++) {
+            for(uint32 i = 0; i < 200; i++) {
+                UUID id = UUID::random();
+                Vector3f pos(randFloat(0, world_size), randFloat(0, world_size), randFloat(0, world_size));
+                float32 radius = randFloat(0.5f, 5.f);
+                unsharded_cache.addObject(id, pos, radius);
+                for(uint32 s = 0; s < nshards; s++)
+                    shard_caches[s]->addObject(id, pos, radius);
+            }
+
+            Time t = Time::null() + Duration::seconds((float32)(round + 1));
+            unsharded->tick(t);
+            for(uint32 s = 0; s < nshards; s++)
+                shard_handlers[s]->tick(t);
+
+            const QuerierResults& expected = unsharded_results.results();
+            const QuerierResults& actual = sharded_results.results();
+            TS_ASSERT_EQUALS(actual.size(), expected.size());
+            uint32 total_results = 0;
+            for(QuerierResults::const_iterator it = expected.begin(); it != expected.end(); it++) {
+                QuerierResults::const_iterator actual_it = actual.find(it->first);
+                TS_ASSERT(actual_it != actual.end());
+                if (actual_it == actual.end()) continue;
+                TS_ASSERT(actual_it->second == it->second);
+                total_results += it->second.size();
+            }
+            // Otherwise the comparison doesn't show much
+            TS_ASSERT(total_results > 0);
+        }
+
+        for(uint32 i = 0; i < queries.size(); i++)
+            delete queries[i];
+        delete unsharded;
+        for(uint32 s = 0; s < nshards; s++) {
+            delete shard_handlers[s];
+            delete shard_caches[s];
+        }
+    }
+};
+
+#endif //_SIRIKATA_QUERY_SHARD_ASSIGNMENT_TEST_HPP_
@@ -0,0 +1,91 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SERVER_MESSAGE_TEST_HPP_
+#define _SIRIKATA_SERVER_MESSAGE_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/ServerMessage.hpp>
+#include <sirikata/core/network/ObjectMessage.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+class ServerMessageTest : public CxxTest::TestSuite
+{
+public:
+    // Serializes msg with the given framing, parses it back and checks that
+    // every field survived.
+    void roundTrip(const Message& msg, Message::Framing framing) {
+        Network::Chunk wire;
+        TS_ASSERT(msg.serialize(&wire, framing));
+
+        Message* parsed = Message::deserialize(wire);
+        TS_ASSERT(parsed != NULL);
+        if (parsed == NULL) return;
+
+        TS_ASSERT_EQUALS(parsed->source_server(), msg.source_server());
+        TS_ASSERT_EQUALS(parsed->source_port(), msg.source_port());
+        TS_ASSERT_EQUALS(parsed->dest_server(), msg.dest_server());
+        TS_ASSERT_EQUALS(parsed->dest_port(), msg.dest_port());
+        TS_ASSERT_EQUALS(parsed->id(), msg.id());
+        TS_ASSERT_EQUALS(parsed->payload_id(), msg.payload_id());
+        TS_ASSERT(parsed->payload() == msg.payload());
+        // Only the binary framing carries the destination object
+        if (framing == Message::BinaryFraming) {
+            TS_ASSERT_EQUALS(parsed->has_dest_object(), msg.has_dest_object());
+            if (msg.has_dest_object())
+                TS_ASSERT_EQUALS(parsed->dest_object(), msg.dest_object());
+        }
+        delete parsed;
+    }
+
+    void roundTripBothFramings(const Message& msg) {
+        roundTrip(msg, Message::ProtobufFraming);
+        roundTrip(msg, Message::BinaryFraming);
+    }
+
+    void testEmptyPayload() {
+        Message msg(1, 2, 3, 4, std::string());
+        roundTripBothFramings(msg);
+    }
+
+    void testSmallPayload() {
+        Message msg(1, 2, 3, 4, std::string("hello"));
+        roundTripBothFramings(msg);
+    }
+
+    void testLargePayload() {
+        // Larger than any single network packet, with every byte value
+        std::string payload(1 << 20, '\0');
+        for(uint32 i = 0; i < payload.size(); i++)
+            payload[i] = (char)(i * 7);
+        Message msg(0xFFFFFFFF, 0xFFFF, 0x12345678, 0x8000, payload);
+        roundTripBothFramings(msg);
+    }
+
+    void testObjectMessagePayload() {
+        Sirikata::Protocol::Object::ObjectMessage* obj_msg = createObjectMessage(
+            1, UUID::random(), 5, UUID::random(), 6, std::string("object payload")
+        );
+        Message msg(1, 2, 3, 4, obj_msg);
+        TS_ASSERT(msg.has_dest_object());
+        TS_ASSERT_EQUALS(msg.dest_object(), obj_msg->dest_object());
+        roundTripBothFramings(msg);
+        releaseObjectMessage(obj_msg);
+    }
+
+    void testTruncatedBinaryHeader() {
+        Message msg(1, 2, 3, 4, std::string("hello"));
+        Network::Chunk wire;
+        TS_ASSERT(msg.serialize(&wire, Message::BinaryFraming));
+        // Cut off inside the header
+        wire.resize(10);
+        Message* parsed = Message::deserialize(wire);
+        TS_ASSERT(parsed == NULL);
+        delete parsed;
+    }
+};
+
+#endif //_SIRIKATA_SERVER_MESSAGE_TEST_HPP_
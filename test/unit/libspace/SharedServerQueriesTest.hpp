@@ -0,0 +1,313 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_SHARED_SERVER_QUERIES_TEST_HPP_
+#define _SIRIKATA_SHARED_SERVER_QUERIES_TEST_HPP_
+
+#include <sirikata/core/util/Platform.hpp>
+#include <sirikata/space/SharedServerQueries.hpp>
+#include <cxxtest/TestSuite.h>
+
+using namespace Sirikata;
+
+class SharedServerQueriesTest : public CxxTest::TestSuite
+{
+    // Static and dynamic objects, like LibproxProximity
+    static const uint32 NUM_CLASSES = 2;
+
+    struct TestQuery : public SharedQueryResults {
+        TestQuery() : SharedQueryResults(NUM_CLASSES) {}
+        std::set<ServerID> members;
+    };
+    typedef SharedServerQueries<TestQuery> Queries;
+    typedef SharedQueryResults::ObjectSet ObjectSet;
+
+    struct Delta {
+        Delta() : count(0) {}
+        ObjectSet additions;
+        ObjectSet removals;
+        uint32 count;
+    };
+    typedef std::map<ServerID, Delta> DeltaMap;
+
+    Queries* mQueries;
+    std::vector<UUID> mObjects;
+    DeltaMap mDeltas;
+    // Destroyed queries are kept around so tests can check what happened to
+    // them
+    std::set<TestQuery*> mDestroyed;
+
+    void sendDelta(const ServerID& server, const ObjectSet& additions, const ObjectSet& removals) {
+        Delta& delta = mDeltas[server];
+        delta.additions.insert(additions.begin(), additions.end());
+        delta.removals.insert(removals.begin(), removals.end());
+        delta.count++;
+    }
+
+    void leave(TestQuery* sq, const ServerID& server) {
+        TS_ASSERT(sq->members.find(server) != sq->members.end());
+        sq->members.erase(server);
+        if (sq->members.empty()) {
+            mQueries->removeQuery(sq);
+            mDestroyed.insert(sq);
+        }
+    }
+
+    TestQuery* newQuery() {
+        TestQuery* sq = new TestQuery();
+        mQueries->addQuery(sq);
+        return sq;
+    }
+
+    void join(const ServerID& server, TestQuery* sq) {
+        sq->members.insert(server);
+        mQueries->assign(server, sq);
+    }
+
+    // Objects [first, last)
+    ObjectSet objects(uint32 first, uint32 last) {
+        ObjectSet result;
+        for(uint32 i = first; i < last; i++)
+            result.insert(mObjects[i]);
+        return result;
+    }
+
+    void addResults(TestQuery* sq, uint32 klass, uint32 first, uint32 last) {
+        for(uint32 i = first; i < last; i++)
+            sq->addResult(klass, mObjects[i]);
+    }
+
+    ObjectSet results(const TestQuery* sq) {
+        ObjectSet result;
+        sq->getResults(&result);
+        return result;
+    }
+
+    // An evaluated query with objects [first, last) as results
+    TestQuery* evaluatedQuery(const ServerID& server, uint32 first, uint32 last) {
+        TestQuery* sq = newQuery();
+        join(server, sq);
+        addResults(sq, 0, first, last);
+        mQueries->finishMoves();
+        TS_ASSERT(sq->evaluated());
+        return sq;
+    }
+
+    bool destroyed(TestQuery* sq) {
+        return mDestroyed.find(sq) != mDestroyed.end();
+    }
+
+public:
+    void setUp() {
+        mQueries = new Queries(
+            std::tr1::bind(&SharedServerQueriesTest::sendDelta, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2, std::tr1::placeholders::_3),
+            std::tr1::bind(&SharedServerQueriesTest::leave, this, std::tr1::placeholders::_1, std::tr1::placeholders::_2)
+        );
+        mObjects.clear();
+        for(uint32 i = 0; i < 20; i++)
+            mObjects.push_back(UUID::random());
+        mDeltas.clear();
+    }
+
+    void tearDown() {
+        const Queries::QuerySet& queries = mQueries->queries();
+        for(Queries::QuerySet::const_iterator it = queries.begin(); it != queries.end(); it++)
+            delete *it;
+        for(std::set<TestQuery*>::iterator it = mDestroyed.begin(); it != mDestroyed.end(); it++)
+            delete *it;
+        mDestroyed.clear();
+        delete mQueries;
+    }
+
+    void testNewQueryStartsEmpty() {
+        TestQuery* sq = newQuery();
+        join(1, sq);
+        TS_ASSERT(!sq->evaluated());
+        TS_ASSERT_EQUALS(mQueries->assigned(1), sq);
+        TS_ASSERT_EQUALS(mQueries->numServers(), (uint32)1);
+        TS_ASSERT(mQueries->receivesResults(sq, 1));
+        // Its results arrive as query events once it's evaluated
+        TS_ASSERT(mDeltas[1].additions.empty());
+        TS_ASSERT(mDeltas[1].removals.empty());
+    }
+
+    void testJoinSendsCachedResults() {
+        TestQuery* sq = evaluatedQuery(1, 0, 5);
+        mDeltas.clear();
+
+        join(2, sq);
+        TS_ASSERT(mDeltas[2].additions == objects(0, 5));
+        TS_ASSERT(mDeltas[2].removals.empty());
+        // The existing member already has them
+        TS_ASSERT(mDeltas.find(1) == mDeltas.end());
+        TS_ASSERT(mQueries->receivesResults(sq, 1));
+        TS_ASSERT(mQueries->receivesResults(sq, 2));
+    }
+
+    void testRemovedResultsNotSentToJoiningServer() {
+        TestQuery* sq = evaluatedQuery(1, 0, 5);
+        sq->removeResult(0, mObjects[2]);
+        sq->removeResult(0, mObjects[4]);
+        addResults(sq, 0, 5, 7);
+
+        join(2, sq);
+        ObjectSet expected = objects(0, 7);
+        expected.erase(mObjects[2]);
+        expected.erase(mObjects[4]);
+        TS_ASSERT(mDeltas[2].additions == expected);
+        TS_ASSERT(mDeltas[2].removals.empty());
+    }
+
+    void testResultChangingClass() {
+        // Added as dynamic before it's removed as static, so it's a result
+        // throughout
+        TestQuery* sq = evaluatedQuery(1, 0, 3);
+        sq->addResult(1, mObjects[1]);
+        sq->removeResult(0, mObjects[1]);
+        TS_ASSERT(results(sq) == objects(0, 3));
+
+        join(2, sq);
+        TS_ASSERT(mDeltas[2].additions == objects(0, 3));
+    }
+
+    void testMoveToEvaluatedQuerySendsDifference() {
+        TestQuery* from = evaluatedQuery(1, 0, 6);
+        TestQuery* to = evaluatedQuery(2, 4, 10);
+        mDeltas.clear();
+
+        join(1, to);
+        TS_ASSERT_EQUALS(mQueries->assigned(1), to);
+        TS_ASSERT_EQUALS(mDeltas[1].count, (uint32)1);
+        TS_ASSERT(mDeltas[1].additions == objects(6, 10));
+        TS_ASSERT(mDeltas[1].removals == objects(0, 4));
+        // Server 2 was already in to and is unaffected
+        TS_ASSERT(mDeltas.find(2) == mDeltas.end());
+        TS_ASSERT(destroyed(from));
+        TS_ASSERT(!destroyed(to));
+        TS_ASSERT(mQueries->receivesResults(to, 1));
+        TS_ASSERT(mQueries->receivesResults(to, 2));
+    }
+
+    void testMoveLeavesSharedQueryForOthers() {
+        TestQuery* from = evaluatedQuery(1, 0, 6);
+        join(2, from);
+        TestQuery* to = evaluatedQuery(3, 4, 10);
+        mDeltas.clear();
+
+        join(1, to);
+        TS_ASSERT(!destroyed(from));
+        TS_ASSERT(from->members.find(1) == from->members.end());
+        TS_ASSERT(from->members.find(2) != from->members.end());
+        TS_ASSERT_EQUALS(mQueries->assigned(2), from);
+        TS_ASSERT(mDeltas.find(2) == mDeltas.end());
+        TS_ASSERT(mDeltas[1].additions == objects(6, 10));
+        TS_ASSERT(mDeltas[1].removals == objects(0, 4));
+    }
+
+    void testMoveToNewQueryWaitsForEvaluation() {
+        TestQuery* from = evaluatedQuery(1, 0, 6);
+        mDeltas.clear();
+
+        TestQuery* to = newQuery();
+        join(1, to);
+        // Nothing sent until to has results, and the server keeps getting
+        // from's results until then
+        TS_ASSERT(mDeltas.find(1) == mDeltas.end());
+        TS_ASSERT_EQUALS(mQueries->assigned(1), to);
+        TS_ASSERT(!destroyed(from));
+        TS_ASSERT(from->members.find(1) != from->members.end());
+        TS_ASSERT(mQueries->receivesResults(from, 1));
+        TS_ASSERT(!mQueries->receivesResults(to, 1));
+
+        // A tick changes from's results, which the server gets as events,
+        // and gives to its results
+        from->removeResult(0, mObjects[0]);
+        addResults(from, 0, 6, 8);
+        addResults(to, 0, 3, 10);
+        mQueries->finishMoves();
+
+        // The difference is from from's latest results
+        TS_ASSERT_EQUALS(mDeltas[1].count, (uint32)1);
+        TS_ASSERT(mDeltas[1].additions == objects(8, 10));
+        TS_ASSERT(mDeltas[1].removals == objects(1, 3));
+        TS_ASSERT(destroyed(from));
+        TS_ASSERT(mQueries->receivesResults(to, 1));
+
+        // Only sent once
+        mQueries->finishMoves();
+        TS_ASSERT_EQUALS(mDeltas[1].count, (uint32)1);
+    }
+
+    void testMoveAgainWhileWaiting() {
+        TestQuery* from = evaluatedQuery(1, 0, 6);
+        TestQuery* other = evaluatedQuery(2, 3, 9);
+        mDeltas.clear();
+
+        TestQuery* waiting = newQuery();
+        join(1, waiting);
+        TS_ASSERT(mDeltas.find(1) == mDeltas.end());
+
+        // Moving on to an evaluated query sends the difference from the
+        // results the server actually has and drops the unevaluated query
+        join(1, other);
+        TS_ASSERT(mDeltas[1].additions == objects(6, 9));
+        TS_ASSERT(mDeltas[1].removals == objects(0, 3));
+        TS_ASSERT(destroyed(from));
+        TS_ASSERT(destroyed(waiting));
+        TS_ASSERT(mQueries->receivesResults(other, 1));
+
+        mQueries->finishMoves();
+        TS_ASSERT_EQUALS(mDeltas[1].count, (uint32)1);
+    }
+
+    void testMoveBackWhileWaiting() {
+        TestQuery* from = evaluatedQuery(1, 0, 6);
+        mDeltas.clear();
+
+        TestQuery* waiting = newQuery();
+        join(1, waiting);
+        join(1, from);
+        // The server still has from's results, so nothing is sent
+        TS_ASSERT(mDeltas.find(1) == mDeltas.end());
+        TS_ASSERT_EQUALS(mQueries->assigned(1), from);
+        TS_ASSERT(destroyed(waiting));
+        TS_ASSERT(!destroyed(from));
+        TS_ASSERT(mQueries->receivesResults(from, 1));
+
+        mQueries->finishMoves();
+        TS_ASSERT(mDeltas.find(1) == mDeltas.end());
+    }
+
+    void testRemoveServer() {
+        TestQuery* from = evaluatedQuery(1, 0, 6);
+        TestQuery* to = evaluatedQuery(2, 4, 10);
+        // Still evaluating when server 1 moves
+        TestQuery* waiting = newQuery();
+        join(2, waiting);
+        join(1, waiting);
+        mDeltas.clear();
+
+        mQueries->remove(1);
+        TS_ASSERT(mQueries->assigned(1) == NULL);
+        TS_ASSERT_EQUALS(mQueries->numServers(), (uint32)1);
+        TS_ASSERT(destroyed(from));
+        TS_ASSERT(!destroyed(waiting));
+        TS_ASSERT(waiting->members.find(1) == waiting->members.end());
+
+        // Only server 2 finishes its move
+        addResults(waiting, 0, 5, 12);
+        mQueries->finishMoves();
+        TS_ASSERT(mDeltas.find(1) == mDeltas.end());
+        TS_ASSERT(mDeltas[2].additions == objects(10, 12));
+        TS_ASSERT(mDeltas[2].removals == objects(4, 5));
+        TS_ASSERT(destroyed(to));
+
+        mQueries->remove(2);
+        TS_ASSERT(destroyed(waiting));
+        TS_ASSERT(mQueries->queries().empty());
+        TS_ASSERT_EQUALS(mQueries->numServers(), (uint32)0);
+    }
+};
+
+#endif //_SIRIKATA_SHARED_SERVER_QUERIES_TEST_HPP_
@@ -0,0 +1,207 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#include "Batch.hpp"
+#include <sirikata/core/util/Timer.hpp>
+#include <sirikata/core/util/AtomicTypes.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <fstream>
+
+namespace Sirikata {
+namespace Mesh {
+
+namespace {
+
+struct FilterTiming {
+    FilterTiming()
+     : runs(0), failures(0)
+    {}
+
+    void merge(const FilterTiming& rhs) {
+        runs += rhs.runs;
+        failures += rhs.failures;
+        total += rhs.total;
+        if (rhs.max > max) max = rhs.max;
+    }
+
+    uint32 runs;
+    uint32 failures;
+    Duration total;
+    Duration max;
+};
+// Indexed by position in the chain, since a filter may appear more than once
+typedef std::vector<FilterTiming> ChainTiming;
+
+struct BatchState {
+    BatchState(const FilterChain& c, const std::vector<String>& i)
+     : chain(c), inputs(i), next(0), failed(0)
+    {
+        timing.resize(chain.size());
+    }
+
+    const FilterChain& chain;
+    const std::vector<String>& inputs;
+    AtomicValue<uint32> next;
+    AtomicValue<uint32> failed;
+
+    // Filters may register and parse options in their constructors, which
+    // isn't safe to do from multiple threads at once
+    boost::mutex constructMutex;
+
+    boost::mutex timingMutex;
+    ChainTiming timing;
+};
+
+String baseName(const String& path) {
+    String::size_type slash = path.find_last_of("/\\");
+    return (slash == String::npos) ? path : path.substr(slash + 1);
+}
+
+String substitute(const String& args, const String& key, const String& value) {
+    String result = args;
+    String::size_type pos = 0;
+    while( (pos = result.find(key, pos)) != String::npos ) {
+        result.replace(pos, key.size(), value);
+        pos += value.size();
+    }
+    return result;
+}
+
+String expandArgs(const String& args, const String& input) {
+    String name = baseName(input);
+    String::size_type dot = name.rfind('.');
+    String stem = (dot == String::npos) ? name : name.substr(0, dot);
+
+    String result = substitute(args, "{input}", input);
+    result = substitute(result, "{name}", name);
+    result = substitute(result, "{stem}", stem);
+    return result;
+}
+
+bool processAsset(BatchState* state, const String& input, ChainTiming* timing) {
+    // Construct the whole pipeline up front so the lock is only taken once
+    // per asset
+    std::vector<Filter*> filters;
+    {
+        boost::mutex::scoped_lock lock(state->constructMutex);
+        for(uint32 i = 0; i < state->chain.size(); i++) {
+            const FilterSpec& spec = state->chain[i];
+            filters.push_back( FilterFactory::getSingleton().getConstructor(spec.name)(expandArgs(spec.args, input)) );
+        }
+    }
+
+    bool success = true;
+    FilterDataPtr current_data(new FilterData);
+    for(uint32 i = 0; i < filters.size(); i++) {
+        Time start = Timer::now();
+        current_data = filters[i]->apply(current_data);
+        Duration elapsed = Timer::now() - start;
+
+        FilterTiming& ft = (*timing)[i];
+        ft.runs++;
+        ft.total += elapsed;
+        if (elapsed > ft.max) ft.max = elapsed;
+
+        if (!current_data) {
+            ft.failures++;
+            std::cout << "Filter " << state->chain[i].name << " failed on " << input << std::endl;
+            success = false;
+            break;
+        }
+    }
+
+    for(uint32 i = 0; i < filters.size(); i++)
+        delete filters[i];
+    return success;
+}
+
+void batchWorker(BatchState* state) {
+    ChainTiming timing(state->chain.size());
+
+    while(true) {
+        uint32 idx = state->next++;
+        if (idx >= state->inputs.size()) break;
+        if (!processAsset(state, state->inputs[idx], &timing))
+            state->failed++;
+    }
+
+    boost::mutex::scoped_lock lock(state->timingMutex);
+    for(uint32 i = 0; i < timing.size(); i++)
+        state->timing[i].merge(timing[i]);
+}
+
+bool isColladaFile(const String& path) {
+    if (path.size() < 4) return false;
+    String ext = path.substr(path.size() - 4);
+    for(uint32 i = 0; i < ext.size(); i++)
+        ext[i] = tolower(ext[i]);
+    return ext == ".dae";
+}
+
+} // namespace
+
+bool ListBatchInputs(const String& path, std::vector<String>* inputs_out) {
+    try {
+        if (boost::filesystem::is_directory(path)) {
+            boost::filesystem::recursive_directory_iterator end_it;
+            for(boost::filesystem::recursive_directory_iterator dir_it(path); dir_it != end_it; dir_it++) {
+                if (boost::filesystem::is_directory(dir_it->status())) continue;
+                String file = dir_it->path().string();
+                if (isColladaFile(file))
+                    inputs_out->push_back(file);
+            }
+            std::sort(inputs_out->begin(), inputs_out->end());
+            return true;
+        }
+    } catch (...) {
+        std::cout << "Failed to scan directory " << path << std::endl;
+        return false;
+    }
+
+    std::ifstream manifest(path.c_str());
+    if (!manifest) {
+        std::cout << "Couldn't open batch manifest " << path << std::endl;
+        return false;
+    }
+    String line;
+    while(std::getline(manifest, line)) {
+        // Trim trailing whitespace, including \r from manifests written on
+        // Windows
+        String::size_type end = line.find_last_not_of(" \t\r\n");
+        if (end == String::npos) continue;
+        line = line.substr(0, end + 1);
+        if (line[0] == '#') continue;
+        inputs_out->push_back(line);
+    }
+    return true;
+}
+
+uint32 RunBatch(const FilterChain& chain, const std::vector<String>& inputs, uint32 nthreads, std::ostream& report) {
+    BatchState state(chain, inputs);
+    nthreads = std::max((uint32)1, std::min(nthreads, (uint32)inputs.size()));
+
+    Time start = Timer::now();
+    boost::thread_group workers;
+    for(uint32 i = 0; i < nthreads; i++)
+        workers.create_thread(std::tr1::bind(&batchWorker, &state));
+    workers.join_all();
+    Duration elapsed = Timer::now() - start;
+
+    uint32 failed = state.failed.read();
+    report << "Processed " << inputs.size() << " assets (" << failed << " failed) with "
+           << nthreads << " threads in " << elapsed << std::endl;
+    report << "Filter timing (total / average / max / runs / failures):" << std::endl;
+    for(uint32 i = 0; i < chain.size(); i++) {
+        const FilterTiming& ft = state.timing[i];
+        Duration avg = ft.runs > 0 ? ft.total / ft.runs : Duration::zero();
+        report << "  " << chain[i].name << ": " << ft.total << " / " << avg << " / " << ft.max
+               << " / " << ft.runs << " / " << ft.failures << std::endl;
+    }
+
+    return failed;
+}
+
+} // namespace Mesh
+} // namespace Sirikata
@@ -0,0 +1,42 @@
+// Copyright (c) 2012 Sirikata Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can
+// be found in the LICENSE file.
+
+#ifndef _SIRIKATA_MESHTOOL_BATCH_HPP_
+#define _SIRIKATA_MESHTOOL_BATCH_HPP_
+
+#include <sirikata/mesh/Filter.hpp>
+
+namespace Sirikata {
+namespace Mesh {
+
+/** A filter and the arguments to construct it with. */
+struct FilterSpec {
+    FilterSpec(const String& n, const String& a)
+     : name(n), args(a)
+    {}
+
+    String name;
+    String args;
+};
+typedef std::vector<FilterSpec> FilterChain;
+
+/** Collect the assets to process in batch mode. path is either a directory,
+ *  which is searched recursively for .dae files, or a manifest listing one
+ *  asset per line. Blank lines and lines starting with # are ignored.
+ */
+bool ListBatchInputs(const String& path, std::vector<String>* inputs_out);
+
+/** Run chain over each input, with a pool of nthreads workers each running
+ *  one asset's pipeline at a time, so at most nthreads assets are in memory
+ *  at once. Filter arguments may refer to the current asset with {input}
+ *  (its full path), {name} (its file name) and {stem} (its file name without
+ *  extension). Per-filter timing is written to report. Returns the number of
+ *  assets which failed.
+ */
+uint32 RunBatch(const FilterChain& chain, const std::vector<String>& inputs, uint32 nthreads, std::ostream& report);
+
+} // namespace Mesh
+} // namespace Sirikata
+
+#endif //_SIRIKATA_MESHTOOL_BATCH_HPP_
@@ -34,12 +34,17 @@
 #include <sirikata/core/options/CommonOptions.hpp>
 #include <sirikata/core/util/PluginManager.hpp>
 #include <sirikata/mesh/Filter.hpp>
+#include "Batch.hpp"
+#include <boost/thread.hpp>
 
 void usage() {
-    printf("Usage: meshtool [-h, --help] [--list] --filter1 --filter2=filter,options\n");
+    printf("Usage: meshtool [-h, --help] [--list] [--batch=manifest_or_dir] [--batch-threads=n] --filter1 --filter2=filter,options\n");
     printf("   --help will print this help message\n");
     printf("   --list will print the list of filters\n");
+    printf("   --batch runs the filters over every asset listed in the manifest or found in the directory\n");
+    printf("   --batch-threads sets the number of assets processed in parallel, defaulting to the number of cores\n");
     printf(" Example: meshtool --load=/path/to/file.dae\n");
+    printf(" Example: meshtool --batch=assets.txt --load={input} --compute-normals --save=filename=out/{stem}.dae\n");
 }
 
 int main(int argc, char** argv) {
@@ -97,7 +102,9 @@ int main(int argc, char** argv) {
         }
     }
 
-    FilterDataPtr current_data(new FilterData);
+    String batch_path;
+    uint32 batch_threads = boost::thread::hardware_concurrency();
+    FilterChain chain;
     for(int argi = 1; argi < argc; argi++) {
         std::string arg_str(argv[argi]);
         if (arg_str.substr(0, 2) != "--") {
@@ -118,13 +125,34 @@ int main(int argc, char** argv) {
         }
         if(filter_name == "options")
                continue;
+        if (filter_name == "batch") {
+            batch_path = filter_args;
+            continue;
+        }
+        if (filter_name == "batch-threads") {
+            batch_threads = atoi(filter_args.c_str());
+            continue;
+        }
         // Verify
         if (!FilterFactory::getSingleton().hasConstructor(filter_name)) {
             std::cout << "Couldn't find filter: " << filter_name << std::endl;
             exit(-1);
         }
-        // And apply
-        Filter* filter = FilterFactory::getSingleton().getConstructor(filter_name)(filter_args);
+        chain.push_back(FilterSpec(filter_name, filter_args));
+    }
+
+    if (!batch_path.empty()) {
+        std::vector<String> inputs;
+        if (!ListBatchInputs(batch_path, &inputs))
+            exit(-1);
+        uint32 failed = RunBatch(chain, inputs, batch_threads, std::cout);
+        return (failed == 0) ? 0 : -1;
+    }
+
+    // And apply
+    FilterDataPtr current_data(new FilterData);
+    for(uint32 i = 0; i < chain.size(); i++) {
+        Filter* filter = FilterFactory::getSingleton().getConstructor(chain[i].name)(chain[i].args);
         current_data = filter->apply(current_data);
         delete filter;
     }